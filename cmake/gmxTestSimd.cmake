@@ -249,6 +249,28 @@ elseif(${GMX_SIMD} STREQUAL "AVX2_256")
     set(GMX_SIMD_X86_AVX2_256 1)
     set(SIMD_STATUS_MESSAGE "Enabling 256-bit AVX2 SIMD instructions")
 
+elseif(${GMX_SIMD} STREQUAL "AVX_512")
+
+    gmx_use_clang_as_with_gnu_compilers_on_osx()
+
+    gmx_find_cflag_for_source(CFLAGS_AVX_512 "C compiler AVX-512F flag"
+                              "#include<immintrin.h>
+                              int main(){__m512 y,x=_mm512_set1_ps(0.5);y=_mm512_fmadd_ps(x,x,x);__m128 z=_mm_fmadd_ps(_mm512_castps512_ps128(x),_mm512_castps512_ps128(y),_mm512_castps512_ps128(x));return (int)_mm512_cmp_ps_mask(x,y,_CMP_LT_OQ)+(int)_mm_cvtss_f32(z);}"
+                              SIMD_C_FLAGS
+                              "-xCORE-AVX512" "-mavx512f -mfma" "/arch:AVX" "-hgnu") # no AVX-512-specific flag for MSVC yet
+    gmx_find_cxxflag_for_source(CXXFLAGS_AVX_512 "C++ compiler AVX-512F flag"
+                                "#include<immintrin.h>
+                                int main(){__m512 y,x=_mm512_set1_ps(0.5);y=_mm512_fmadd_ps(x,x,x);__m128 z=_mm_fmadd_ps(_mm512_castps512_ps128(x),_mm512_castps512_ps128(y),_mm512_castps512_ps128(x));return (int)_mm512_cmp_ps_mask(x,y,_CMP_LT_OQ)+(int)_mm_cvtss_f32(z);}"
+                                SIMD_CXX_FLAGS
+                                "-xCORE-AVX512" "-mavx512f -mfma" "/arch:AVX" "-hgnu") # no AVX-512-specific flag for MSVC yet
+
+    if(NOT CFLAGS_AVX_512 OR NOT CXXFLAGS_AVX_512)
+        message(FATAL_ERROR "Cannot find AVX-512F compiler flag. Use a newer compiler, or choose AVX2 SIMD (slower).")
+    endif()
+
+    set(GMX_SIMD_X86_AVX_512 1)
+    set(SIMD_STATUS_MESSAGE "Enabling 512-bit AVX-512F SIMD instructions")
+
 elseif(${GMX_SIMD} STREQUAL "IBM_QPX")
 
     try_compile(TEST_QPX ${CMAKE_BINARY_DIR}
@@ -69,8 +69,9 @@ class AnalysisDataParallelOptions;
  * passing them to the attached modules in the order in which the modules
  * expect them.
  *
- * \todo
- * Parallel implementation is not complete.
+ * Different handles can be used concurrently from different threads, as long
+ * as they operate on different frames.  Frames may then be finished out of
+ * order; modules that do not support parallel data still see them in order.
  *
  * \if internal
  * Special note for MPI implementation: assuming that the initialization of
@@ -223,7 +224,8 @@ class AnalysisDataHandleImpl;
  * However, normally you should only keep one copy of a handle, i.e., treat
  * this type as movable.
  * Several handles created from the same AnalysisData object can exist
- * concurrently, but must currently operate on separate frames.
+ * concurrently and be used from different threads, but must operate on
+ * separate frames.
  *
  * \inpublicapi
  * \ingroup module_analysisdata
@@ -54,6 +54,8 @@
 #include "gromacs/utility/gmxassert.h"
 #include "gromacs/utility/uniqueptr.h"
 
+#include "thread_mpi/mutex.h"
+
 namespace gmx
 {
 
@@ -276,6 +278,15 @@ class AnalysisDataStorageImpl
          * frame (see \a frames_).
          */
         int                     nextIndex_;
+        /*! \brief
+         * Serializes concurrent access from several data handles.
+         *
+         * Frames are built concurrently in parallel analysis, but starting
+         * and finishing frames modify the shared buffers and fire
+         * notifications to the attached modules, so these are done while
+         * holding this mutex.
+         */
+        tMPI::mutex             mutex_;
 };
 
 /********************************************************************
@@ -545,6 +556,7 @@ AnalysisDataStorageImpl::notifyNextFrames(size_t firstLocation)
 void
 AnalysisDataStorageImpl::finishFrame(int index)
 {
+    tMPI::lock_guard<tMPI::mutex> lock(mutex_);
     const int storageIndex = computeStorageLocation(index);
     GMX_RELEASE_ASSERT(storageIndex >= 0, "Out of bounds frame index");
 
@@ -636,6 +648,7 @@ AnalysisDataStorageFrameData::addPointSet(int dataSetIndex, int firstColumn,
                                           dataSetIndex, firstColumn);
     AnalysisDataPointSetRef  pointSet(header(), pointSetInfo,
                                       AnalysisDataValuesRef(begin, end));
+    tMPI::lock_guard<tMPI::mutex> lock(storageImpl().mutex_);
     storageImpl().modules_->notifyParallelPointsAdd(pointSet);
     if (storageImpl().shouldNotifyImmediately())
     {
@@ -885,6 +898,7 @@ AnalysisDataStorageFrame &
 AnalysisDataStorage::startFrame(const AnalysisDataFrameHeader &header)
 {
     GMX_ASSERT(header.isValid(), "Invalid header");
+    tMPI::lock_guard<tMPI::mutex>           lock(impl_->mutex_);
     internal::AnalysisDataStorageFrameData *storedFrame;
     if (impl_->storeAll())
     {
@@ -928,7 +942,8 @@ AnalysisDataStorage::startFrame(int index, real x, real dx)
 AnalysisDataStorageFrame &
 AnalysisDataStorage::currentFrame(int index)
 {
-    const int storageIndex = impl_->computeStorageLocation(index);
+    tMPI::lock_guard<tMPI::mutex> lock(impl_->mutex_);
+    const int                     storageIndex = impl_->computeStorageLocation(index);
     GMX_RELEASE_ASSERT(storageIndex >= 0, "Out of bounds frame index");
 
     internal::AnalysisDataStorageFrameData &storedFrame = *impl_->frames_[storageIndex];
@@ -394,6 +394,34 @@ TYPED_TEST(AnalysisDataCommonTest, CallsModuleCorrectlyWithOutOfOrderFrames)
     ASSERT_NO_THROW_GMX(handle2.finishData());
 }
 
+/*
+ * Tests that data is forwarded correctly (in frame order) to modules when
+ * several frames are in progress at the same time and are finished in
+ * non-increasing order.
+ */
+TYPED_TEST(AnalysisDataCommonTest, CallsModuleCorrectlyWithOutOfOrderFinish)
+{
+    ASSERT_NO_THROW_GMX(AnalysisDataTest::addStaticCheckerModule());
+    ASSERT_NO_THROW_GMX(AnalysisDataTest::addStaticParallelCheckerModule());
+    ASSERT_NO_THROW_GMX(AnalysisDataTest::addStaticColumnCheckerModule(1, 2));
+    gmx::AnalysisDataHandle          handle1;
+    gmx::AnalysisDataHandle          handle2;
+    gmx::AnalysisDataHandle          handle3;
+    gmx::AnalysisDataParallelOptions options(3);
+    ASSERT_NO_THROW_GMX(handle1 = this->data_.startData(options));
+    ASSERT_NO_THROW_GMX(handle2 = this->data_.startData(options));
+    ASSERT_NO_THROW_GMX(handle3 = this->data_.startData(options));
+    ASSERT_NO_THROW_GMX(AnalysisDataTest::startDataFrame(this->input_, 0, handle1));
+    ASSERT_NO_THROW_GMX(AnalysisDataTest::startDataFrame(this->input_, 1, handle2));
+    ASSERT_NO_THROW_GMX(AnalysisDataTest::startDataFrame(this->input_, 2, handle3));
+    ASSERT_NO_THROW_GMX(handle3.finishFrame());
+    ASSERT_NO_THROW_GMX(handle2.finishFrame());
+    ASSERT_NO_THROW_GMX(handle1.finishFrame());
+    ASSERT_NO_THROW_GMX(handle1.finishData());
+    ASSERT_NO_THROW_GMX(handle2.finishData());
+    ASSERT_NO_THROW_GMX(handle3.finishData());
+}
+
 /*
  * Tests that data can be accessed correctly from a module that requests
  * storage using AbstractAnalysisData::requestStorage() with parameter -1.
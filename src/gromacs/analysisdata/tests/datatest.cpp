@@ -219,6 +219,14 @@ void AnalysisDataTestFixture::presentAllData(const AnalysisDataTestInput &input,
 
 void AnalysisDataTestFixture::presentDataFrame(const AnalysisDataTestInput &input,
                                                int row, AnalysisDataHandle handle)
+{
+    startDataFrame(input, row, handle);
+    handle.finishFrame();
+}
+
+
+void AnalysisDataTestFixture::startDataFrame(const AnalysisDataTestInput &input,
+                                             int row, AnalysisDataHandle handle)
 {
     const AnalysisDataTestInputFrame &frame = input.frame(row);
     handle.startFrame(row, frame.x(), frame.dx());
@@ -244,7 +252,6 @@ void AnalysisDataTestFixture::presentDataFrame(const AnalysisDataTestInput &inpu
             handle.finishPointSet();
         }
     }
-    handle.finishFrame();
 }
 
 
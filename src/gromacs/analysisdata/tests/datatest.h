@@ -311,6 +311,15 @@ class AnalysisDataTestFixture : public ::testing::Test
          */
         static void presentDataFrame(const AnalysisDataTestInput &input, int row,
                                      AnalysisDataHandle handle);
+        /*! \brief
+         * Adds a single frame from AnalysisDataTestInput into an AnalysisData
+         * without finishing it.
+         *
+         * The caller should call AnalysisDataHandle::finishFrame() for
+         * \p handle to finish the frame.
+         */
+        static void startDataFrame(const AnalysisDataTestInput &input, int row,
+                                   AnalysisDataHandle handle);
         /*! \brief
          * Initializes an array data object from AnalysisDataTestInput.
          *
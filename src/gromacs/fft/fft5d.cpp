@@ -169,6 +169,40 @@ static int vmax(int* a, int s)
  * lin is allocated by fft5d because size of array is only known after planning phase
  * rlout2 is only used as intermediate buffer - only returned after allocation to reuse for back transform - should not be used by caller
  */
+/* Returns whether the split and transpose need buffers separate from
+ * lin and lout. This is the case with OpenMP threads, to avoid barriers,
+ * and with pipelining, where the input of the next chunk is still needed.
+ */
+static int separate_transpose_buffers(int flags, const int P[2], int nthreads)
+{
+    return (nthreads > 1 ||
+            ((flags & FFT5D_PIPELINE) && (P[0] > 1 || P[1] > 1)));
+}
+
+/* Returns the range of major dimension indices of chunk c.
+ * This range is uniform over the ranks in a transpose communicator.
+ */
+static void pipeline_chunk_range(int K, int nchunk, int c, int *z0, int *z1)
+{
+    *z0 = (c*K)/nchunk;
+    *z1 = ((c + 1)*K)/nchunk;
+}
+
+/* Returns the local 1D FFT line range of thread for chunk c with pipelining */
+static void pipeline_chunk_lines(int pM, int pK, int K, int nchunk, int c,
+                                 int nthreads, int thread,
+                                 int *start, int *end)
+{
+    int z0, z1, nline;
+
+    pipeline_chunk_range(K, nchunk, c, &z0, &z1);
+    z0     = std::min(z0, pK);
+    z1     = std::min(z1, pK);
+    nline  = (z1 - z0)*pM;
+    *start = z0*pM + ( thread   *nline)/nthreads;
+    *end   = z0*pM + ((thread+1)*nline)/nthreads;
+}
+
 fft5d_plan fft5d_plan_3d(int NG, int MG, int KG, MPI_Comm comm[2], int flags, t_complex** rlin, t_complex** rlout, t_complex** rlout2, t_complex** rlout3, int nthreads)
 {
 
@@ -181,6 +215,7 @@ fft5d_plan fft5d_plan_3d(int NG, int MG, int KG, MPI_Comm comm[2], int flags, t_
     t_complex *lin = 0, *lout = 0, *lout2 = 0, *lout3 = 0;
     fft5d_plan plan;
     int        s;
+    int        bSepBuf;
 
     /* comm, prank and P are in the order of the decomposition (plan->cart is in the order of transposes) */
 #ifdef GMX_MPI
@@ -412,11 +447,15 @@ fft5d_plan fft5d_plan_3d(int NG, int MG, int KG, MPI_Comm comm[2], int flags, t_
     /* int lsize = fmax(N[0]*M[0]*K[0]*nP[0],N[1]*M[1]*K[1]*nP[1]); */
     lsize = std::max(N[0]*M[0]*K[0]*nP[0], std::max(N[1]*M[1]*K[1]*nP[1], C[2]*M[2]*K[2]));
     /* int lsize = fmax(C[0]*M[0]*K[0],fmax(C[1]*M[1]*K[1],C[2]*M[2]*K[2])); */
+#if !defined GMX_MPI || defined FFT5D_MPI_TRANSPOSE
+    flags &= ~FFT5D_PIPELINE;
+#endif
+    bSepBuf = separate_transpose_buffers(flags, P, nthreads);
     if (!(flags&FFT5D_NOMALLOC))
     {
         snew_aligned(lin, lsize, 32);
         snew_aligned(lout, lsize, 32);
-        if (nthreads > 1)
+        if (bSepBuf)
         {
             /* We need extra transpose buffers to avoid OpenMP barriers */
             snew_aligned(lout2, lsize, 32);
@@ -433,7 +472,7 @@ fft5d_plan fft5d_plan_3d(int NG, int MG, int KG, MPI_Comm comm[2], int flags, t_
     {
         lin  = *rlin;
         lout = *rlout;
-        if (nthreads > 1)
+        if (bSepBuf)
         {
             lout2 = *rlout2;
             lout3 = *rlout3;
@@ -609,6 +648,54 @@ fft5d_plan fft5d_plan_3d(int NG, int MG, int KG, MPI_Comm comm[2], int flags, t_
         }
     }
 
+    /* With pipelining the first two steps, when parallel, are done in chunks
+     * along the major dimension, for which we need separate 1D plans.
+     */
+    for (s = 0; s < 2; s++)
+    {
+        int nchunk = 0;
+
+        if ((flags&FFT5D_PIPELINE) && nP[s] > 1)
+        {
+            nchunk = std::min(FFT5D_PIPELINE_NCHUNK, K[s]);
+        }
+        plan->nchunk[s] = nchunk;
+        if (nchunk == 0)
+        {
+            continue;
+        }
+        if (debug)
+        {
+            fprintf(debug, "FFT5D: Pipelining step %d in %d chunks\n", s, nchunk);
+        }
+        plan->p1d_chunk[s] = (gmx_fft_t*)malloc(sizeof(gmx_fft_t)*nchunk*nthreads);
+#ifdef GMX_MPI
+        plan->req[s]       = (MPI_Request*)malloc(sizeof(MPI_Request)*2*nP[s]*nchunk);
+#endif
+
+#pragma omp parallel for num_threads(nthreads) schedule(static) ordered
+        for (t = 0; t < nthreads; t++)
+        {
+#pragma omp ordered
+            {
+                int c, tstart, tend;
+
+                for (c = 0; c < nchunk; c++)
+                {
+                    pipeline_chunk_lines(pM[s], pK[s], K[s], nchunk, c, nthreads, t, &tstart, &tend);
+                    if ((flags&FFT5D_REALCOMPLEX) && !(flags&FFT5D_BACKWARD) && s == 0)
+                    {
+                        gmx_fft_init_many_1d_real( &plan->p1d_chunk[s][c*nthreads+t], rC[s], tend-tstart, (flags&FFT5D_NOMEASURE) ? GMX_FFT_FLAG_CONSERVATIVE : 0 );
+                    }
+                    else
+                    {
+                        gmx_fft_init_many_1d     ( &plan->p1d_chunk[s][c*nthreads+t],  C[s], tend-tstart, (flags&FFT5D_NOMEASURE) ? GMX_FFT_FLAG_CONSERVATIVE : 0 );
+                    }
+                }
+            }
+        }
+    }
+
 #ifdef GMX_FFT_FFTW3
 }
 #endif
@@ -957,6 +1044,170 @@ static void print_localdata(const t_complex* lin, const char* txt, int s, fft5d_
     }
 }
 
+#ifdef GMX_MPI
+/* Pipelined FFT, split and transpose of parallel step s.
+ * The local lines are processed in plan->nchunk[s] chunks along the
+ * major dimension. As soon as all threads have done the FFT and split
+ * of a chunk, thread 0 sends it with non-blocking communication, while
+ * all threads continue with the FFT and split of the next chunk.
+ * The receives are posted at the start and completed at the end,
+ * so the caller needs a barrier before using lout3.
+ * Must be called by all threads.
+ */
+static void pipelined_fft_transpose(fft5d_plan plan, int s, int thread, fft5d_time times)
+{
+    t_complex   *lin    = plan->lin;
+    t_complex   *lout   = plan->lout;
+    t_complex   *lout2  = plan->lout2;
+    t_complex   *lout3  = plan->lout3;
+    MPI_Comm     comm   = plan->cart[s];
+    MPI_Request *req    = plan->req[s];
+    int          N      = plan->N[s], M = plan->M[s], K = plan->K[s];
+    int          pM     = plan->pM[s], pK = plan->pK[s], C = plan->C[s], P = plan->P[s];
+    int          nchunk = plan->nchunk[s];
+    int          block, zsize, count, rank = 0, nreq = 0;
+    int          c, i, z0, z1, tstart, tend, offset;
+#ifdef NOGMX
+    double       time = 0;
+#endif
+
+    /* The send/receive block for each rank has size N*M*K and within
+     * a block the major dimension has stride N*M, as in splitaxes.
+     */
+    block = N*M*K;
+    zsize = N*M;
+
+    /* The input lines were written by threads with the unchunked line
+     * division, which differs from the chunked division used here.
+     */
+#pragma omp barrier
+
+    if (thread == 0)
+    {
+#ifdef NOGMX
+        if (times != 0)
+        {
+            time = MPI_Wtime();
+        }
+#else
+        wallcycle_start(times, ewcPME_FFTCOMM);
+#endif
+        MPI_Comm_rank(comm, &rank);
+        for (c = 0; c < nchunk; c++)
+        {
+            pipeline_chunk_range(K, nchunk, c, &z0, &z1);
+            count = (z1 - z0)*zsize*sizeof(t_complex)/sizeof(real);
+            for (i = 0; i < P; i++)
+            {
+                if (i != rank)
+                {
+                    MPI_Irecv((real *)(lout3 + i*block + z0*zsize), count, GMX_MPI_REAL,
+                              i, c, comm, &req[nreq++]);
+                }
+            }
+        }
+#ifdef NOGMX
+        if (times != 0)
+        {
+            (s == 0 ? times->mpi1 : times->mpi2) += MPI_Wtime() - time;
+        }
+#else
+        wallcycle_stop(times, ewcPME_FFTCOMM);
+#endif
+    }
+
+    for (c = 0; c < nchunk; c++)
+    {
+#ifdef NOGMX
+        if (times != 0 && thread == 0)
+        {
+            time = MPI_Wtime();
+        }
+#endif
+        pipeline_chunk_lines(pM, pK, K, nchunk, c, plan->nthreads, thread, &tstart, &tend);
+        if ((plan->flags&FFT5D_REALCOMPLEX) && !(plan->flags&FFT5D_BACKWARD) && s == 0)
+        {
+            gmx_fft_many_1d_real(plan->p1d_chunk[s][c*plan->nthreads+thread], GMX_FFT_REAL_TO_COMPLEX, lin+tstart*C, lout+tstart*C);
+        }
+        else
+        {
+            gmx_fft_many_1d(     plan->p1d_chunk[s][c*plan->nthreads+thread], (plan->flags&FFT5D_BACKWARD) ? GMX_FFT_BACKWARD : GMX_FFT_FORWARD, lin+tstart*C, lout+tstart*C);
+        }
+        if (pM > 0)
+        {
+            splitaxes(lout2, lout, N, M, K, pM, P, C, plan->iNout[s], plan->oNout[s], tstart%pM, tstart/pM, tend%pM, tend/pM);
+        }
+#ifdef NOGMX
+        if (times != 0 && thread == 0)
+        {
+            times->fft += MPI_Wtime() - time;
+        }
+#endif
+#pragma omp barrier /* all threads need to have split this chunk before sending */
+
+        if (thread == 0)
+        {
+#ifdef NOGMX
+            if (times != 0)
+            {
+                time = MPI_Wtime();
+            }
+#else
+            wallcycle_start_nocount(times, ewcPME_FFTCOMM);
+#endif
+            pipeline_chunk_range(K, nchunk, c, &z0, &z1);
+            count = (z1 - z0)*zsize*sizeof(t_complex)/sizeof(real);
+            for (i = 0; i < P; i++)
+            {
+                offset = i*block + z0*zsize;
+                if (i == rank)
+                {
+                    memcpy(lout3 + offset, lout2 + offset, (z1 - z0)*zsize*sizeof(t_complex));
+                }
+                else
+                {
+                    MPI_Isend((real *)(lout2 + offset), count, GMX_MPI_REAL,
+                              i, c, comm, &req[nreq++]);
+                }
+            }
+#ifdef NOGMX
+            if (times != 0)
+            {
+                (s == 0 ? times->mpi1 : times->mpi2) += MPI_Wtime() - time;
+            }
+#else
+            wallcycle_stop(times, ewcPME_FFTCOMM);
+#endif
+        }
+    }
+
+    if (thread == 0)
+    {
+#ifdef NOGMX
+        if (times != 0)
+        {
+            time = MPI_Wtime();
+        }
+#else
+        wallcycle_start_nocount(times, ewcPME_FFTCOMM);
+        wallcycle_sub_start(times, ewcsPME_FFTCOMM_WAIT);
+#endif
+        MPI_Waitall(nreq, req, MPI_STATUSES_IGNORE);
+#ifdef NOGMX
+        if (times != 0)
+        {
+            time = MPI_Wtime() - time;
+            (s == 0 ? times->mpi1 : times->mpi2)   += time;
+            (s == 0 ? times->wait1 : times->wait2) += time;
+        }
+#else
+        wallcycle_sub_stop(times, ewcsPME_FFTCOMM_WAIT);
+        wallcycle_stop(times, ewcPME_FFTCOMM);
+#endif
+    }
+}
+#endif /* GMX_MPI */
+
 void fft5d_execute(fft5d_plan plan, int thread, fft5d_time times)
 {
     t_complex  *lin   = plan->lin;
@@ -1025,118 +1276,128 @@ void fft5d_execute(fft5d_plan plan, int thread, fft5d_time times)
             bParallelDim = 0;
         }
 
-        /* ---------- START FFT ------------ */
-#ifdef NOGMX
-        if (times != 0 && thread == 0)
-        {
-            time = MPI_Wtime();
-        }
-#endif
-
-        if (bParallelDim || plan->nthreads == 1)
+#ifdef GMX_MPI
+        if (bParallelDim && plan->nchunk[s] > 0)
         {
-            fftout = lout;
+            /* FFT, split and transpose in chunks that overlap */
+            pipelined_fft_transpose(plan, s, thread, times);
         }
         else
+#endif
         {
-            if (s == 0)
+            /* ---------- START FFT ------------ */
+#ifdef NOGMX
+            if (times != 0 && thread == 0)
+            {
+                time = MPI_Wtime();
+            }
+#endif
+
+            if (bParallelDim || plan->nthreads == 1)
             {
-                fftout = lout3;
+                fftout = lout;
             }
             else
             {
-                fftout = lout2;
+                if (s == 0)
+                {
+                    fftout = lout3;
+                }
+                else
+                {
+                    fftout = lout2;
+                }
             }
-        }
-
-        tstart = (thread*pM[s]*pK[s]/plan->nthreads)*C[s];
-        if ((plan->flags&FFT5D_REALCOMPLEX) && !(plan->flags&FFT5D_BACKWARD) && s == 0)
-        {
-            gmx_fft_many_1d_real(p1d[s][thread], (plan->flags&FFT5D_BACKWARD) ? GMX_FFT_COMPLEX_TO_REAL : GMX_FFT_REAL_TO_COMPLEX, lin+tstart, fftout+tstart);
-        }
-        else
-        {
-            gmx_fft_many_1d(     p1d[s][thread], (plan->flags&FFT5D_BACKWARD) ? GMX_FFT_BACKWARD : GMX_FFT_FORWARD,               lin+tstart, fftout+tstart);
-
-        }
-
-#ifdef NOGMX
-        if (times != NULL && thread == 0)
-        {
-            time_fft += MPI_Wtime()-time;
-        }
-#endif
-        if (plan->flags&FFT5D_DEBUG && thread == 0)
-        {
-            print_localdata(lout, "%d %d: FFT %d\n", s, plan);
-        }
-        /* ---------- END FFT ------------ */
 
-        /* ---------- START SPLIT + TRANSPOSE------------ (if parallel in in this dimension)*/
-        if (bParallelDim)
-        {
-#ifdef NOGMX
-            if (times != NULL && thread == 0)
+            tstart = (thread*pM[s]*pK[s]/plan->nthreads)*C[s];
+            if ((plan->flags&FFT5D_REALCOMPLEX) && !(plan->flags&FFT5D_BACKWARD) && s == 0)
             {
-                time = MPI_Wtime();
+                gmx_fft_many_1d_real(p1d[s][thread], (plan->flags&FFT5D_BACKWARD) ? GMX_FFT_COMPLEX_TO_REAL : GMX_FFT_REAL_TO_COMPLEX, lin+tstart, fftout+tstart);
             }
-#endif
-            /*prepare for A
-               llToAll
-               1. (most outer) axes (x) is split into P[s] parts of size N[s]
-               for sending*/
-            if (pM[s] > 0)
+            else
             {
-                tend    = ((thread+1)*pM[s]*pK[s]/plan->nthreads);
-                tstart /= C[s];
-                splitaxes(lout2, lout, N[s], M[s], K[s], pM[s], P[s], C[s], iNout[s], oNout[s], tstart%pM[s], tstart/pM[s], tend%pM[s], tend/pM[s]);
+                gmx_fft_many_1d(     p1d[s][thread], (plan->flags&FFT5D_BACKWARD) ? GMX_FFT_BACKWARD : GMX_FFT_FORWARD,               lin+tstart, fftout+tstart);
+
             }
-#pragma omp barrier /*barrier required before AllToAll (all input has to be their) - before timing to make timing more acurate*/
+
 #ifdef NOGMX
             if (times != NULL && thread == 0)
             {
-                time_local += MPI_Wtime()-time;
+                time_fft += MPI_Wtime()-time;
             }
 #endif
+            if (plan->flags&FFT5D_DEBUG && thread == 0)
+            {
+                print_localdata(lout, "%d %d: FFT %d\n", s, plan);
+            }
+            /* ---------- END FFT ------------ */
 
-            /* ---------- END SPLIT , START TRANSPOSE------------ */
-
-            if (thread == 0)
+            /* ---------- START SPLIT + TRANSPOSE------------ (if parallel in in this dimension)*/
+            if (bParallelDim)
             {
 #ifdef NOGMX
-                if (times != 0)
+                if (times != NULL && thread == 0)
                 {
                     time = MPI_Wtime();
                 }
-#else
-                wallcycle_start(times, ewcPME_FFTCOMM);
 #endif
-#ifdef FFT5D_MPI_TRANSPOSE
-                FFTW(execute)(mpip[s]);
-#else
-#ifdef GMX_MPI
-                if ((s == 0 && !(plan->flags&FFT5D_ORDER_YZ)) || (s == 1 && (plan->flags&FFT5D_ORDER_YZ)))
+                /*prepare for A
+                   llToAll
+                   1. (most outer) axes (x) is split into P[s] parts of size N[s]
+                   for sending*/
+                if (pM[s] > 0)
                 {
-                    MPI_Alltoall((real *)lout2, N[s]*pM[s]*K[s]*sizeof(t_complex)/sizeof(real), GMX_MPI_REAL, (real *)lout3, N[s]*pM[s]*K[s]*sizeof(t_complex)/sizeof(real), GMX_MPI_REAL, cart[s]);
+                    tend    = ((thread+1)*pM[s]*pK[s]/plan->nthreads);
+                    tstart /= C[s];
+                    splitaxes(lout2, lout, N[s], M[s], K[s], pM[s], P[s], C[s], iNout[s], oNout[s], tstart%pM[s], tstart/pM[s], tend%pM[s], tend/pM[s]);
                 }
-                else
+#pragma omp barrier /*barrier required before AllToAll (all input has to be their) - before timing to make timing more acurate*/
+#ifdef NOGMX
+                if (times != NULL && thread == 0)
                 {
-                    MPI_Alltoall((real *)lout2, N[s]*M[s]*pK[s]*sizeof(t_complex)/sizeof(real), GMX_MPI_REAL, (real *)lout3, N[s]*M[s]*pK[s]*sizeof(t_complex)/sizeof(real), GMX_MPI_REAL, cart[s]);
+                    time_local += MPI_Wtime()-time;
                 }
+#endif
+
+                /* ---------- END SPLIT , START TRANSPOSE------------ */
+
+                if (thread == 0)
+                {
+#ifdef NOGMX
+                    if (times != 0)
+                    {
+                        time = MPI_Wtime();
+                    }
+#else
+                    wallcycle_start(times, ewcPME_FFTCOMM);
+#endif
+#ifdef FFT5D_MPI_TRANSPOSE
+                    FFTW(execute)(mpip[s]);
+#else
+#ifdef GMX_MPI
+                    if ((s == 0 && !(plan->flags&FFT5D_ORDER_YZ)) || (s == 1 && (plan->flags&FFT5D_ORDER_YZ)))
+                    {
+                        MPI_Alltoall((real *)lout2, N[s]*pM[s]*K[s]*sizeof(t_complex)/sizeof(real), GMX_MPI_REAL, (real *)lout3, N[s]*pM[s]*K[s]*sizeof(t_complex)/sizeof(real), GMX_MPI_REAL, cart[s]);
+                    }
+                    else
+                    {
+                        MPI_Alltoall((real *)lout2, N[s]*M[s]*pK[s]*sizeof(t_complex)/sizeof(real), GMX_MPI_REAL, (real *)lout3, N[s]*M[s]*pK[s]*sizeof(t_complex)/sizeof(real), GMX_MPI_REAL, cart[s]);
+                    }
 #else
-                gmx_incons("fft5d MPI call without MPI configuration");
+                    gmx_incons("fft5d MPI call without MPI configuration");
 #endif /*GMX_MPI*/
 #endif /*FFT5D_MPI_TRANSPOSE*/
 #ifdef NOGMX
-                if (times != 0)
-                {
-                    time_mpi[s] = MPI_Wtime()-time;
-                }
+                    if (times != 0)
+                    {
+                        time_mpi[s] = MPI_Wtime()-time;
+                    }
 #else
-                wallcycle_stop(times, ewcPME_FFTCOMM);
+                    wallcycle_stop(times, ewcPME_FFTCOMM);
 #endif
-            } /*master*/
-        }     /* bPrallelDim */
+                } /*master*/
+            }     /* bPrallelDim */
+        }
 #pragma omp barrier  /*both needed for parallel and non-parallel dimension (either have to wait on data from AlltoAll or from last FFT*/
 
         /* ---------- END SPLIT + TRANSPOSE------------ */
@@ -1272,6 +1533,20 @@ void fft5d_destroy(fft5d_plan plan)
             plan->oNout[s] = 0;
         }
     }
+    for (s = 0; s < 2; s++)
+    {
+        if (plan->p1d_chunk[s])
+        {
+            for (t = 0; t < plan->nchunk[s]*plan->nthreads; t++)
+            {
+                gmx_many_fft_destroy(plan->p1d_chunk[s][t]);
+            }
+            free(plan->p1d_chunk[s]);
+#ifdef GMX_MPI
+            free(plan->req[s]);
+#endif
+        }
+    }
 #ifdef GMX_FFT_FFTW3
     FFTW_LOCK;
 #ifdef FFT5D_MPI_TRANSPOS
@@ -1291,7 +1566,7 @@ void fft5d_destroy(fft5d_plan plan)
     {
         sfree_aligned(plan->lin);
         sfree_aligned(plan->lout);
-        if (plan->nthreads > 1)
+        if (separate_transpose_buffers(plan->flags, plan->P, plan->nthreads))
         {
             sfree_aligned(plan->lout2);
             sfree_aligned(plan->lout3);
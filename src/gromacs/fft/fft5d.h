@@ -71,6 +71,7 @@ extern "C" {
 #endif
 struct fft5d_time_t {
     double fft, local, mpi1, mpi2;
+    double wait1, wait2; /* part of mpi1/2 waiting for pipelined transposes */
 };
 typedef struct fft5d_time_t *fft5d_time;
 #else
@@ -88,13 +89,26 @@ typedef enum fft5d_flags_t {
     FFT5D_DEBUG       = 8,
     FFT5D_NOMEASURE   = 16,
     FFT5D_INPLACE     = 32,
-    FFT5D_NOMALLOC    = 64
+    FFT5D_NOMALLOC    = 64,
+    FFT5D_PIPELINE    = 128 /* Overlap transposes with the 1D FFTs */
 } fft5d_flags;
 
+/* With FFT5D_PIPELINE, the FFT, split and transpose of a parallel step
+ * are done in (at most) this number of chunks along the major dimension.
+ * The transpose of each chunk uses non-blocking communication,
+ * which overlaps with the FFT and split of the next chunk.
+ */
+#define FFT5D_PIPELINE_NCHUNK 4
+
 struct fft5d_plan_t {
     t_complex *lin;
     t_complex *lout, *lout2, *lout3;
     gmx_fft_t* p1d[3]; /*1D plans*/
+    int        nchunk[2];    /*number of pipeline chunks for the first two steps, 0: no pipelining*/
+    gmx_fft_t* p1d_chunk[2]; /*1D plans for each chunk and thread with pipelining*/
+#ifdef GMX_MPI
+    MPI_Request *req[2];     /*non-blocking requests for the pipelined transposes*/
+#endif
 #ifdef GMX_FFT_FFTW3
     FFTW(plan) p2d;    /*2D plan: used for 1D decomposition if FFT supports transposed output*/
     FFTW(plan) p3d;    /*3D plan: used for 0D decomposition if FFT supports transposed output*/
@@ -75,6 +75,11 @@ gmx_parallel_3dfft_init   (gmx_parallel_3dfft_t     *    pfft_setup,
     {
         flags |= FFT5D_NOMEASURE;
     }
+    /* Overlap the transposes with the 1D FFTs, only has effect in parallel */
+    if (getenv("GMX_FFT5D_PIPELINE") != NULL)
+    {
+        flags |= FFT5D_PIPELINE;
+    }
 
     if (!(flags&FFT5D_ORDER_YZ))
     {
@@ -42,11 +42,15 @@
  * \author Roland Schulz <roland@utk.edu>
  * \ingroup module_fft
  */
+#include <cmath>
+
+#include <algorithm>
 #include <vector>
 
 #include <gtest/gtest.h>
 
 #include "gromacs/fft/fft.h"
+#include "gromacs/fft/fft5d.h"
 #include "gromacs/fft/parallel_3dfft.h"
 #include "gromacs/utility/stringutil.h"
 
@@ -296,4 +300,183 @@ TEST_F(FFFTest3D, Real5_6_9)
     }
 }
 
+#ifdef GMX_THREAD_MPI
+
+//! Number of thread-MPI ranks for the pipelined fft5d test.
+const int c_numPipelineRanks = 4;
+
+//! Result of comparing pipelined with plain fft5d for one decomposition.
+struct Fft5dPipelineResult
+{
+    //! Number of ranks along the first decomposition dimension.
+    int    P0;
+    //! Whether only the plans with the pipeline flag chunk their parallel steps.
+    bool   bPipelined;
+    //! Largest relative difference of the forward output on any rank.
+    double forwardDiff;
+    //! Largest relative difference of the backward output on any rank.
+    double backwardDiff;
+};
+
+//! Decompositions of the ranks for the pipelined fft5d test.
+const int c_pipelineP0[] = { 1, 2, 4 };
+
+//! Returns the maximum difference of \p a and \p b relative to the maximum of \p a.
+double maxRelativeDifference(const std::vector<real> &a, const std::vector<real> &b)
+{
+    double diff = 0, norm = 0;
+
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        diff = std::max(diff, static_cast<double>(std::fabs(a[i] - b[i])));
+        norm = std::max(norm, static_cast<double>(std::fabs(a[i])));
+    }
+
+    return (norm > 0 ? diff/norm : diff);
+}
+
+/*! \brief
+ * Does a forward and backward real 3D FFT on the local data of a rank.
+ *
+ * Sets up the plans as gmx_parallel_3dfft_init() does, but with the
+ * pipeline flag given explicitly. Returns the forward complex output
+ * in \p forward and the used part of the backward real output in
+ * \p backward.
+ */
+void fft5dForwardBackward(const int ndata[3], MPI_Comm comm[2], bool bPipeline,
+                          int rank, std::vector<real> *forward,
+                          std::vector<real> *backward, bool *bPipelined)
+{
+    int         rN      = ndata[2], M = ndata[1], K = ndata[0];
+    int         flags   = FFT5D_REALCOMPLEX | FFT5D_ORDER_YZ | FFT5D_NOMEASURE;
+    MPI_Comm    rcomm[] = {comm[1], comm[0]};
+    real       *rdata;
+    t_complex  *cdata, *buf1, *buf2;
+    const int   ninput  = sizeof(inputdata)/sizeof(inputdata[0]);
+
+    if (bPipeline)
+    {
+        flags |= FFT5D_PIPELINE;
+    }
+    fft5d_plan p1 = fft5d_plan_3d(rN, M, K, rcomm, flags,
+                                  reinterpret_cast<t_complex **>(&rdata), &cdata,
+                                  &buf1, &buf2, 1);
+    fft5d_plan p2 = fft5d_plan_3d(K, rN, M, rcomm,
+                                  (flags | FFT5D_BACKWARD | FFT5D_NOMALLOC) ^ FFT5D_ORDER_YZ,
+                                  &cdata, reinterpret_cast<t_complex **>(&rdata),
+                                  &buf1, &buf2, 1);
+    /* Only the steps along a decomposed dimension are chunked */
+    *bPipelined = ((p1->nchunk[0] > 0 || p1->nchunk[1] > 0) &&
+                   (p2->nchunk[0] > 0 || p2->nchunk[1] > 0));
+
+    /* Local sizes as in fft5d_limits() in parallel_3dfft.c */
+    int realRowSize = p1->C[0]*2;
+    int numRealRows = p1->pM[0]*p1->pK[0];
+    int complexSize = p2->C[0]*p2->pM[0]*p2->pK[0];
+
+    for (int i = 0; i < realRowSize*numRealRows; i++)
+    {
+        rdata[i] = inputdata[(i + 7*rank) % ninput];
+    }
+    fft5d_execute(p1, 0, NULL);
+    forward->assign(reinterpret_cast<real *>(cdata),
+                    reinterpret_cast<real *>(cdata) + 2*complexSize);
+
+    for (int i = 0; i < complexSize; i++)
+    {
+        cdata[i].re = inputdata[(2*i + 3*rank) % ninput];
+        cdata[i].im = inputdata[(2*i + 1 + 3*rank) % ninput];
+    }
+    fft5d_execute(p2, 0, NULL);
+    backward->clear();
+    for (int i = 0; i < numRealRows; i++)
+    {
+        /* Skip the padding at the end of each row */
+        backward->insert(backward->end(), rdata + i*realRowSize,
+                         rdata + i*realRowSize + p1->rC[0]);
+    }
+
+    fft5d_destroy(p2);
+    fft5d_destroy(p1);
+}
+
+//! Thread-MPI start function comparing pipelined with plain fft5d.
+void fft5dPipelineRanks(void *arg)
+{
+    Fft5dPipelineResult *result = static_cast<Fft5dPipelineResult *>(arg);
+    /* Not divisible by the number of ranks, nor by the number of chunks */
+    const int            ndata[3] = { 13, 10, 14 };
+    int                  rank, nranks;
+
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+    for (size_t d = 0; d < sizeof(c_pipelineP0)/sizeof(c_pipelineP0[0]); d++)
+    {
+        int      P0 = c_pipelineP0[d];
+        int      P1 = nranks/P0;
+        MPI_Comm comm[2];
+
+        /* Ranks along the same row share comm[0], along the same column comm[1] */
+        MPI_Comm_split(MPI_COMM_WORLD, rank % P1, rank / P1, &comm[0]);
+        MPI_Comm_split(MPI_COMM_WORLD, rank / P1, rank % P1, &comm[1]);
+
+        std::vector<real> forward[2], backward[2];
+        bool              bPipelined[2];
+        for (int p = 0; p < 2; p++)
+        {
+            fft5dForwardBackward(ndata, comm, p == 1, rank,
+                                 &forward[p], &backward[p], &bPipelined[p]);
+        }
+
+        double diff[2], maxDiff[2];
+        int    pipelined, allPipelined;
+        diff[0]   = maxRelativeDifference(forward[0], forward[1]);
+        diff[1]   = maxRelativeDifference(backward[0], backward[1]);
+        pipelined = (bPipelined[1] && !bPipelined[0]);
+        MPI_Allreduce(diff, maxDiff, 2, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+        MPI_Allreduce(&pipelined, &allPipelined, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+        if (rank == 0)
+        {
+            result[d].P0           = P0;
+            result[d].bPipelined   = (allPipelined != 0);
+            result[d].forwardDiff  = maxDiff[0];
+            result[d].backwardDiff = maxDiff[1];
+        }
+
+        MPI_Comm_free(&comm[0]);
+        MPI_Comm_free(&comm[1]);
+    }
+}
+
+/* The pipelined transposes send the 1D FFT output in chunks with
+ * point-to-point communication. This should give the same data layout
+ * and values as the plain transposes, for any decomposition.
+ */
+TEST(FFT5DPipelineTest, MatchesPlainTransposes)
+{
+    const int           ndecomp = sizeof(c_pipelineP0)/sizeof(c_pipelineP0[0]);
+    Fft5dPipelineResult result[ndecomp];
+
+    ASSERT_EQ(TMPI_SUCCESS,
+              tMPI_Init_fn(FALSE, c_numPipelineRanks, TMPI_AFFINITY_NONE,
+                           fft5dPipelineRanks, result));
+    gmx_fft_cleanup();
+
+#ifdef GMX_DOUBLE
+    const double tolerance = 1e-12;
+#else
+    const double tolerance = 1e-5;
+#endif
+    for (int d = 0; d < ndecomp; d++)
+    {
+        SCOPED_TRACE(gmx::formatString("decomposition %d x %d",
+                                       result[d].P0, c_numPipelineRanks/result[d].P0));
+        EXPECT_TRUE(result[d].bPipelined);
+        EXPECT_LE(result[d].forwardDiff, tolerance);
+        EXPECT_LE(result[d].backwardDiff, tolerance);
+    }
+}
+
+#endif
+
 } // namespace
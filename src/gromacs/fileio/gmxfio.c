@@ -40,6 +40,7 @@
 
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #ifdef HAVE_IO_H
 #include <io.h>
@@ -58,6 +59,7 @@
 #include "gromacs/utility/cstringutil.h"
 #include "gmxfio.h"
 #include "md5.h"
+#include "xtcindex.h"
 
 #include "gmxfio_int.h"
 
@@ -377,6 +379,8 @@ static t_fileio *gmx_fio_get_first(void)
     {
         /* after this, the open_file pointer should never change */
         ret = NULL;
+        /* there is no next file to unlock the global lock */
+        tMPI_Thread_mutex_unlock(&open_file_mutex);
     }
     else
     {
@@ -583,6 +587,13 @@ static int gmx_fio_close_locked(t_fileio *fio)
         sfree(fio->xdr);
     }
 
+    if (fio->xtc_index != NULL)
+    {
+        xtc_index_destroy(fio->xtc_index);
+        fio->xtc_index = NULL;
+    }
+    fio->bXtcIndexInit = FALSE;
+
     /* Don't close stdin and stdout! */
     if (!fio->bStdio && fio->fp != NULL)
     {
@@ -778,6 +789,48 @@ int gmx_fio_get_file_md5(t_fileio *fio, gmx_off_t offset,
     return ret;
 }
 
+int gmx_fio_get_named_file_md5(const char *fn, gmx_off_t offset,
+                                unsigned char digest[])
+{
+    FILE          *fp;
+    md5_state_t    state;
+    unsigned char *buf;
+    gmx_off_t      read_len;
+    gmx_off_t      seek_offset;
+    int            ret = -1;
+
+    seek_offset = offset - CPT_CHK_LEN;
+    if (seek_offset < 0)
+    {
+        seek_offset = 0;
+    }
+    read_len = offset - seek_offset;
+
+    /* We use a separate file pointer, so we do not disturb a process
+     * or thread that is writing to the file.
+     */
+    fp = fopen(fn, "rb");
+    if (fp == NULL)
+    {
+        return -1;
+    }
+    if (gmx_fseek(fp, seek_offset, SEEK_SET) == 0)
+    {
+        snew(buf, CPT_CHK_LEN);
+        if ((gmx_off_t)fread(buf, 1, read_len, fp) == read_len)
+        {
+            md5_init(&state);
+            md5_append(&state, buf, read_len);
+            md5_finish(&state, digest);
+            ret = read_len;
+        }
+        sfree(buf);
+    }
+    fclose(fp);
+
+    return ret;
+}
+
 /* The fio_mutex should ALWAYS be locked when this function is called */
 static int gmx_fio_int_get_file_position(t_fileio *fio, gmx_off_t *offset)
 {
@@ -805,8 +858,9 @@ static int gmx_fio_int_get_file_position(t_fileio *fio, gmx_off_t *offset)
     return 0;
 }
 
-int gmx_fio_get_output_file_positions(gmx_file_position_t **p_outputfiles,
-                                      int                  *p_nfiles)
+static int get_output_file_positions(gmx_file_position_t **p_outputfiles,
+                                     int                  *p_nfiles,
+                                     gmx_bool              bChecksum)
 {
     int                   i, nfiles, rc, nalloc;
     int                   pos_hi, pos_lo;
@@ -845,11 +899,15 @@ int gmx_fio_get_output_file_positions(gmx_file_position_t **p_outputfiles,
 
             /* Get the file position */
             gmx_fio_int_get_file_position(cur, &outputfiles[nfiles].offset);
+            outputfiles[nfiles].chksum_size = -1;
 #ifndef GMX_FAHCORE
-            outputfiles[nfiles].chksum_size
-                = gmx_fio_int_get_file_md5(cur,
-                                           outputfiles[nfiles].offset,
-                                           outputfiles[nfiles].chksum);
+            if (bChecksum)
+            {
+                outputfiles[nfiles].chksum_size
+                    = gmx_fio_int_get_file_md5(cur,
+                                               outputfiles[nfiles].offset,
+                                               outputfiles[nfiles].chksum);
+            }
 #endif
             nfiles++;
         }
@@ -862,6 +920,18 @@ int gmx_fio_get_output_file_positions(gmx_file_position_t **p_outputfiles,
     return 0;
 }
 
+int gmx_fio_get_output_file_positions(gmx_file_position_t **p_outputfiles,
+                                      int                  *p_nfiles)
+{
+    return get_output_file_positions(p_outputfiles, p_nfiles, TRUE);
+}
+
+int gmx_fio_get_output_file_offsets(gmx_file_position_t **p_outputfiles,
+                                    int                  *p_nfiles)
+{
+    return get_output_file_positions(p_outputfiles, p_nfiles, FALSE);
+}
+
 
 void gmx_fio_checktype(t_fileio *fio)
 {
@@ -1110,12 +1180,57 @@ gmx_bool gmx_fio_getread(t_fileio* fio)
     return ret;
 }
 
+/* Reads the frame index of an xtc file opened for reading, when present.
+ * Must be called with fio locked.
+ */
+static void gmx_fio_init_xtc_index_read(t_fileio *fio)
+{
+    if (!fio->bXtcIndexInit)
+    {
+        fio->bXtcIndexInit = TRUE;
+        if (fio->bRead && !fio->bStdio)
+        {
+            fio->xtc_index = xtc_index_read(fio->fn);
+        }
+        if (debug && fio->xtc_index != NULL)
+        {
+            fprintf(debug, "Using the frame index of %s with %d frames\n",
+                    fio->fn, xtc_index_nframes(fio->xtc_index));
+        }
+    }
+}
+
+/* Stops using the frame index after a mismatch with the file.
+ * Must be called with fio locked.
+ */
+static void gmx_fio_drop_xtc_index(t_fileio *fio)
+{
+    fprintf(stderr, "\nNOTE: The frame index %s%s does not match the file, "
+            "will not use it. You can rebuild the index with gmx xtcindex.\n",
+            fio->fn, XTC_INDEX_EXT);
+    xtc_index_destroy(fio->xtc_index);
+    fio->xtc_index = NULL;
+}
+
 int xtc_seek_frame(t_fileio *fio, int frame, int natoms)
 {
     int ret;
 
     gmx_fio_lock(fio);
-    ret = xdr_xtc_seek_frame(frame, fio->fp, fio->xdr, natoms);
+    gmx_fio_init_xtc_index_read(fio);
+    ret = XTC_INDEX_MISMATCH;
+    if (fio->xtc_index != NULL)
+    {
+        ret = xtc_index_seek_frame(fio->xtc_index, fio->fp, fio->xdr, frame);
+        if (ret == XTC_INDEX_MISMATCH)
+        {
+            gmx_fio_drop_xtc_index(fio);
+        }
+    }
+    if (ret == XTC_INDEX_MISMATCH)
+    {
+        ret = xdr_xtc_seek_frame(frame, fio->fp, fio->xdr, natoms);
+    }
     gmx_fio_unlock(fio);
 
     return ret;
@@ -1126,8 +1241,53 @@ int xtc_seek_time(t_fileio *fio, real time, int natoms, gmx_bool bSeekForwardOnl
     int ret;
 
     gmx_fio_lock(fio);
-    ret = xdr_xtc_seek_time(time, fio->fp, fio->xdr, natoms, bSeekForwardOnly);
+    gmx_fio_init_xtc_index_read(fio);
+    ret = XTC_INDEX_MISMATCH;
+    if (fio->xtc_index != NULL)
+    {
+        ret = xtc_index_seek_time(fio->xtc_index, fio->fp, fio->xdr, time, bSeekForwardOnly);
+        if (ret == XTC_INDEX_MISMATCH)
+        {
+            gmx_fio_drop_xtc_index(fio);
+        }
+    }
+    if (ret == XTC_INDEX_MISMATCH)
+    {
+        ret = xdr_xtc_seek_time(time, fio->fp, fio->xdr, natoms, bSeekForwardOnly);
+    }
     gmx_fio_unlock(fio);
 
     return ret;
 }
+
+void gmx_fio_add_xtc_index_frame(t_fileio *fio, int natoms, int step, real time)
+{
+    gmx_off_t offset;
+
+    gmx_fio_lock(fio);
+    if (!fio->bXtcIndexInit)
+    {
+        fio->bXtcIndexInit = TRUE;
+        if (!fio->bRead && !fio->bStdio && getenv("GMX_XTC_INDEX") != NULL)
+        {
+            /* Make sure all data is on disk before scanning, when appending */
+            fflush(fio->fp);
+            fio->xtc_index = xtc_index_open_write(fio->fn);
+            if (fio->xtc_index == NULL)
+            {
+                fprintf(stderr, "\nWARNING: Could not open the frame index %s%s for writing\n",
+                        fio->fn, XTC_INDEX_EXT);
+            }
+        }
+    }
+    if (fio->xtc_index != NULL)
+    {
+        /* Frames are always added at the end, also when appending */
+        if (gmx_fseek(fio->fp, 0, SEEK_END) == 0 &&
+            (offset = gmx_ftell(fio->fp)) >= 0)
+        {
+            xtc_index_add_frame(fio->xtc_index, offset, natoms, step, time);
+        }
+    }
+    gmx_fio_unlock(fio);
+}
@@ -196,6 +196,14 @@ int gmx_fio_get_output_file_positions(gmx_file_position_t ** outputfiles,
  * point to a list of open files.
  */
 
+int gmx_fio_get_output_file_offsets(gmx_file_position_t ** outputfiles,
+                                    int                   *nfiles);
+/* As gmx_fio_get_output_file_positions, but only flushes the files and
+ * gets the offsets, the checksum sizes are set to -1. The checksums can
+ * be computed afterwards with gmx_fio_get_named_file_md5, also
+ * while the files are being appended to.
+ */
+
 t_fileio *gmx_fio_all_output_fsync(void);
 /* fsync all open output files. This is used for checkpointing, where
    we need to ensure that all output is actually written out to
@@ -213,10 +221,25 @@ t_fileio *gmx_fio_all_output_fsync(void);
 int gmx_fio_get_file_md5(t_fileio *fio, gmx_off_t offset,
                          unsigned char digest[]);
 
+int gmx_fio_get_named_file_md5(const char *fn, gmx_off_t offset,
+                               unsigned char digest[]);
+/* Computes the md5 sum of the same part of the file before offset as
+ * gmx_fio_get_file_md5, but opens file fn separately for reading.
+ * Returns the number of bytes used, or -1 on failure.
+ */
+
 
 int xtc_seek_frame(t_fileio *fio, int frame, int natoms);
 
 int xtc_seek_time(t_fileio *fio, real time, int natoms, gmx_bool bSeekForwardOnly);
+/* The xtc seek functions use the frame index of the file, see xtcindex.h,
+ * when present and otherwise search the file.
+ */
+
+void gmx_fio_add_xtc_index_frame(t_fileio *fio, int natoms, int step, real time);
+/* Adds a frame that is about to be written to the frame index of an xtc
+ * file, when the environment variable GMX_XTC_INDEX is set.
+ */
 
 
 /* Add this to the comment string for debugging */
@@ -93,6 +93,9 @@ struct t_fileio
 
     const char  *comment;              /* a comment string for debugging */
 
+    struct t_xtc_index *xtc_index;     /* frame index of an xtc file, can be NULL */
+    gmx_bool            bXtcIndexInit; /* whether xtc_index has been set up */
+
     t_fileio    *next, *prev;          /* next and previous file pointers in the
                                           linked list */
     tMPI_Lock_t  mtx;                  /* content locking mutex. This is a fast lock
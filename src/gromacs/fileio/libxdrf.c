@@ -38,6 +38,7 @@
 #include <config.h>
 #endif
 
+#include <float.h>
 #include <limits.h>
 #include <math.h>
 #include <stdio.h>
@@ -46,6 +47,7 @@
 
 #include "xdrf.h"
 #include "xdr_datatype.h"
+#include "gromacs/simd/simd.h"
 #include "gromacs/utility/futil.h"
 
 /* This is just for clarity - it can never be anything but 4! */
@@ -96,51 +98,92 @@ static const int magicints[] = {
 #define LASTIDX (sizeof(magicints) / sizeof(*magicints))
 
 
+/*____________________________________________________________________________
+ |
+ | t_xdr_bitbuf - bit buffer for the compressed coordinates
+ |
+ | The compressed coordinates are a stream of bits, stored most significant
+ | bit first. Instead of shifting single bytes in and out of the buffer,
+ | up to 64 bits are kept in an accumulator and moved to and from the
+ | byte buffer 32 bits at a time.
+ |
+ */
+
+typedef struct
+{
+    unsigned char *cbuf;   /* the byte buffer                        */
+    int            cnt;    /* number of bytes written to or read     */
+    int            nbytes; /* when reading, the number of bytes      */
+    gmx_uint64_t   bits;   /* the bit accumulator                    */
+    int            nbits;  /* number of pending bits in bits, < 32   */
+} t_xdr_bitbuf;
+
+static void init_bitbuf(t_xdr_bitbuf *bb, unsigned char *cbuf, int nbytes)
+{
+    bb->cbuf   = cbuf;
+    bb->cnt    = 0;
+    bb->nbytes = nbytes;
+    bb->bits   = 0;
+    bb->nbits  = 0;
+}
+
+/* Returns w with the byte order reversed */
+static gmx_inline unsigned int byteswap32(unsigned int w)
+{
+    return (w >> 24) | ((w >> 8) & 0xff00) | ((w << 8) & 0xff0000) | (w << 24);
+}
+
 /*____________________________________________________________________________
  |
  | sendbits - encode num into buf using the specified number of bits
  |
  | This routines appends the value of num to the bits already present in
- | the array buf. You need to give it the number of bits to use and you
- | better make sure that this number of bits is enough to hold the value
- | Also num must be positive.
+ | the buffer. You need to give it the number of bits to use, at most 32,
+ | and you better make sure that this number of bits is enough to hold
+ | the value.
  |
  */
 
-static void sendbits(int buf[], int num_of_bits, int num)
+static gmx_inline void sendbits(t_xdr_bitbuf *bb, int num_of_bits, unsigned int num)
 {
+    unsigned int word;
 
-    unsigned int    cnt, lastbyte;
-    int             lastbits;
-    unsigned char * cbuf;
-
-    cbuf     = ((unsigned char *)buf) + 3 * sizeof(*buf);
-    cnt      = (unsigned int) buf[0];
-    lastbits = buf[1];
-    lastbyte = (unsigned int) buf[2];
-    while (num_of_bits >= 8)
+    bb->bits   = (bb->bits << num_of_bits) | num;
+    bb->nbits += num_of_bits;
+    if (bb->nbits >= 32)
     {
-        lastbyte     = (lastbyte << 8) | ((num >> (num_of_bits -8)) /* & 0xff*/);
-        cbuf[cnt++]  = lastbyte >> lastbits;
-        num_of_bits -= 8;
+        bb->nbits            -= 32;
+        word                  = (unsigned int)(bb->bits >> bb->nbits);
+        bb->cbuf[bb->cnt]     = word >> 24;
+        bb->cbuf[bb->cnt + 1] = word >> 16;
+        bb->cbuf[bb->cnt + 2] = word >> 8;
+        bb->cbuf[bb->cnt + 3] = word;
+        bb->cnt              += 4;
     }
-    if (num_of_bits > 0)
+}
+
+/*____________________________________________________________________________
+ |
+ | flushbits - write the remaining bits to the buffer
+ |
+ | The last byte is padded with zero bits. Returns the total number of
+ | bytes in the buffer.
+ |
+ */
+
+static int flushbits(t_xdr_bitbuf *bb)
+{
+    while (bb->nbits >= 8)
     {
-        lastbyte  = (lastbyte << num_of_bits) | num;
-        lastbits += num_of_bits;
-        if (lastbits >= 8)
-        {
-            lastbits   -= 8;
-            cbuf[cnt++] = lastbyte >> lastbits;
-        }
+        bb->nbits          -= 8;
+        bb->cbuf[bb->cnt++] = (unsigned char)(bb->bits >> bb->nbits);
     }
-    buf[0] = cnt;
-    buf[1] = lastbits;
-    buf[2] = lastbyte;
-    if (lastbits > 0)
+    if (bb->nbits > 0)
     {
-        cbuf[cnt] = lastbyte << (8 - lastbits);
+        bb->cbuf[bb->cnt++] = (unsigned char)(bb->bits << (8 - bb->nbits));
+        bb->nbits           = 0;
     }
+    return bb->cnt;
 }
 
 /*_________________________________________________________________________
@@ -218,7 +261,10 @@ static int sizeofints( const int num_of_ints, unsigned int sizes[])
  | this routine is used internally by xdr3dfcoord, to send a set of
  | small integers to the buffer.
  | Multiplication with fixed (specified maximum ) sizes is used to get
- | to one big, multibyte integer. Allthough the routine could be
+ | to one big, multibyte integer, which is sent least significant byte
+ | first. When the result fits in 64 bits, which is nearly always the case,
+ | the product is formed in a single word and sent 32 bits at a time.
+ | Otherwise a byte array is used. Allthough the routine could be
  | modified to handle sizes bigger than 16777216, or more than just
  | a few integers, this is not done, because the gain in compression
  | isn't worth the effort. Note that overflowing the multiplication
@@ -226,12 +272,49 @@ static int sizeofints( const int num_of_ints, unsigned int sizes[])
  |
  */
 
-static void sendints(int buf[], const int num_of_ints, const int num_of_bits,
+static void sendints(t_xdr_bitbuf *bb, const int num_of_ints, const int num_of_bits,
                      unsigned int sizes[], unsigned int nums[])
 {
 
     int          i, num_of_bytes, bytecnt;
     unsigned int bytes[32], tmp;
+    gmx_uint64_t num;
+
+    for (i = 1; i < num_of_ints; i++)
+    {
+        if (nums[i] >= sizes[i])
+        {
+            fprintf(stderr, "major breakdown in sendints num %u doesn't "
+                    "match size %u\n", nums[i], sizes[i]);
+            exit(1);
+        }
+    }
+
+    if (num_of_bits <= 64)
+    {
+        num = nums[0];
+        for (i = 1; i < num_of_ints; i++)
+        {
+            num = num*sizes[i] + nums[i];
+        }
+        /* The bytes of num go out in little-endian order, so each 32-bit
+         * word needs its bytes swapped for the big-endian bit stream.
+         */
+        num_of_bytes = num_of_bits >> 3;
+        for (i = 0; i + 4 <= num_of_bytes; i += 4)
+        {
+            sendbits(bb, 32, byteswap32((unsigned int)(num >> (i*8))));
+        }
+        for (; i < num_of_bytes; i++)
+        {
+            sendbits(bb, 8, (unsigned int)(num >> (i*8)) & 0xff);
+        }
+        if (num_of_bits & 7)
+        {
+            sendbits(bb, num_of_bits & 7, (unsigned int)(num >> (num_of_bytes*8)));
+        }
+        return;
+    }
 
     tmp          = nums[0];
     num_of_bytes = 0;
@@ -244,12 +327,6 @@ static void sendints(int buf[], const int num_of_ints, const int num_of_bits,
 
     for (i = 1; i < num_of_ints; i++)
     {
-        if (nums[i] >= sizes[i])
-        {
-            fprintf(stderr, "major breakdown in sendints num %u doesn't "
-                    "match size %u\n", nums[i], sizes[i]);
-            exit(1);
-        }
         /* use one step multiply */
         tmp = nums[i];
         for (bytecnt = 0; bytecnt < num_of_bytes; bytecnt++)
@@ -269,17 +346,21 @@ static void sendints(int buf[], const int num_of_ints, const int num_of_bits,
     {
         for (i = 0; i < num_of_bytes; i++)
         {
-            sendbits(buf, 8, bytes[i]);
+            sendbits(bb, 8, bytes[i]);
+        }
+        /* sendbits takes at most 32 bits at a time */
+        for (i = num_of_bits - num_of_bytes * 8; i > 0; i -= 32)
+        {
+            sendbits(bb, MIN(i, 32), 0);
         }
-        sendbits(buf, num_of_bits - num_of_bytes * 8, 0);
     }
     else
     {
         for (i = 0; i < num_of_bytes-1; i++)
         {
-            sendbits(buf, 8, bytes[i]);
+            sendbits(bb, 8, bytes[i]);
         }
-        sendbits(buf, num_of_bits- (num_of_bytes -1) * 8, bytes[i]);
+        sendbits(bb, num_of_bits- (num_of_bytes -1) * 8, bytes[i]);
     }
 }
 
@@ -288,46 +369,43 @@ static void sendints(int buf[], const int num_of_ints, const int num_of_bits,
  |
  | receivebits - decode number from buf using specified number of bits
  |
- | extract the number of bits from the array buf and construct an integer
- | from it. Return that value.
+ | extract the number of bits, at most 32, from the buffer and construct
+ | an integer from it. Return that value. Reading beyond the end of the
+ | buffer returns zero bits.
  |
  */
 
-static int receivebits(int buf[], int num_of_bits)
+static gmx_inline unsigned int receivebits(t_xdr_bitbuf *bb, int num_of_bits)
 {
+    const unsigned char *c;
 
-    int             cnt, num, lastbits;
-    unsigned int    lastbyte;
-    unsigned char * cbuf;
-    int             mask = (1 << num_of_bits) -1;
-
-    cbuf     = ((unsigned char *)buf) + 3 * sizeof(*buf);
-    cnt      = buf[0];
-    lastbits = (unsigned int) buf[1];
-    lastbyte = (unsigned int) buf[2];
-
-    num = 0;
-    while (num_of_bits >= 8)
+    if (bb->nbits < num_of_bits)
     {
-        lastbyte     = ( lastbyte << 8 ) | cbuf[cnt++];
-        num         |=  (lastbyte >> lastbits) << (num_of_bits - 8);
-        num_of_bits -= 8;
-    }
-    if (num_of_bits > 0)
-    {
-        if (lastbits < num_of_bits)
+        if (bb->cnt + 4 <= bb->nbytes)
+        {
+            c          = bb->cbuf + bb->cnt;
+            bb->bits   = (bb->bits << 32) |
+                ((unsigned int)c[0] << 24) | ((unsigned int)c[1] << 16) |
+                ((unsigned int)c[2] << 8) | c[3];
+            bb->cnt   += 4;
+            bb->nbits += 32;
+        }
+        else
         {
-            lastbits += 8;
-            lastbyte  = (lastbyte << 8) | cbuf[cnt++];
+            while (bb->nbits < num_of_bits)
+            {
+                bb->bits <<= 8;
+                if (bb->cnt < bb->nbytes)
+                {
+                    bb->bits |= bb->cbuf[bb->cnt++];
+                }
+                bb->nbits += 8;
+            }
         }
-        lastbits -= num_of_bits;
-        num      |= (lastbyte >> lastbits) & ((1 << num_of_bits) -1);
     }
-    num   &= mask;
-    buf[0] = cnt;
-    buf[1] = lastbits;
-    buf[2] = lastbyte;
-    return num;
+    bb->nbits -= num_of_bits;
+
+    return (unsigned int)((bb->bits >> bb->nbits) & ((((gmx_uint64_t)1) << num_of_bits) - 1));
 }
 
 /*____________________________________________________________________________
@@ -341,25 +419,53 @@ static int receivebits(int buf[], int num_of_bits)
  |
  */
 
-static void receiveints(int buf[], const int num_of_ints, int num_of_bits,
+static void receiveints(t_xdr_bitbuf *bb, const int num_of_ints, int num_of_bits,
                         unsigned int sizes[], int nums[])
 {
-    int bytes[32];
-    int i, j, num_of_bytes, p, num;
+    int          bytes[32];
+    int          i, j, num_of_bytes;
+    unsigned int p, num;
+    gmx_uint64_t num64;
+
+    if (num_of_bits <= 64)
+    {
+        num_of_bytes = num_of_bits >> 3;
+        num64        = 0;
+        for (i = 0; i + 4 <= num_of_bytes; i += 4)
+        {
+            num64 |= (gmx_uint64_t)byteswap32(receivebits(bb, 32)) << (i*8);
+        }
+        for (; i < num_of_bytes; i++)
+        {
+            num64 |= (gmx_uint64_t)receivebits(bb, 8) << (i*8);
+        }
+        if (num_of_bits & 7)
+        {
+            num64 |= (gmx_uint64_t)receivebits(bb, num_of_bits & 7) << (num_of_bytes*8);
+        }
+        for (i = num_of_ints-1; i > 0; i--)
+        {
+            nums[i] = num64 % sizes[i];
+            num64  /= sizes[i];
+        }
+        nums[0] = num64;
+        return;
+    }
 
     bytes[0]     = bytes[1] = bytes[2] = bytes[3] = 0;
     num_of_bytes = 0;
     while (num_of_bits > 8)
     {
-        bytes[num_of_bytes++] = receivebits(buf, 8);
+        bytes[num_of_bytes++] = receivebits(bb, 8);
         num_of_bits          -= 8;
     }
     if (num_of_bits > 0)
     {
-        bytes[num_of_bytes++] = receivebits(buf, num_of_bits);
+        bytes[num_of_bytes++] = receivebits(bb, num_of_bits);
     }
     for (i = num_of_ints-1; i > 0; i--)
     {
+        /* num < sizes[i] <= 2^24, so num << 8 fits in 32 unsigned bits */
         num = 0;
         for (j = num_of_bytes-1; j >= 0; j--)
         {
@@ -373,6 +479,294 @@ static void receiveints(int buf[], const int num_of_ints, int num_of_bits,
     nums[0] = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24);
 }
 
+#if defined GMX_SIMD_HAVE_FLOAT && defined GMX_SIMD_HAVE_FINT32 && \
+    defined GMX_SIMD_HAVE_LOADU && defined GMX_SIMD_HAVE_STOREU
+#define XTC_SIMD_QUANTIZE
+#endif
+
+/*____________________________________________________________________________
+ |
+ | quantize - convert coordinates to integers
+ |
+ | Multiplies the size3 values in fp by precision and rounds to the nearest
+ | integer, with halves rounded away from zero, storing the result in ip.
+ | Returns the ranges of the integers per dimension in minint and maxint
+ | and the largest absolute scaled value in *maxabs.
+ | Note that the rounding offset has to be added to the product rounded to
+ | float, as in the scalar code; a fused multiply-add would change the
+ | output in rare cases.
+ |
+ */
+
+static void quantize(const float *fp, int size3, float precision, int *ip,
+                     int minint[], int maxint[], float *maxabs)
+{
+    float lf, lfmin[3], lfmax[3], lfabs;
+    int   i, d;
+
+    lfmin[0] = lfmin[1] = lfmin[2] = FLT_MAX;
+    lfmax[0] = lfmax[1] = lfmax[2] = -FLT_MAX;
+    lfabs    = 0;
+    i        = 0;
+#ifdef XTC_SIMD_QUANTIZE
+    {
+        gmx_simd_float_t prec_S, half_S, mhalf_S, zero_S;
+        gmx_simd_float_t x_S, p_S, lf_S, abs_S;
+        gmx_simd_float_t min_S[3], max_S[3];
+        float            mem_min[GMX_SIMD_FLOAT_WIDTH];
+        float            mem_max[GMX_SIMD_FLOAT_WIDTH];
+        int              l, dim;
+
+        prec_S  = gmx_simd_set1_f(precision);
+        half_S  = gmx_simd_set1_f(0.5);
+        mhalf_S = gmx_simd_set1_f(-0.5);
+        zero_S  = gmx_simd_setzero_f();
+        abs_S   = gmx_simd_setzero_f();
+        for (d = 0; d < 3; d++)
+        {
+            min_S[d] = gmx_simd_set1_f(FLT_MAX);
+            max_S[d] = gmx_simd_set1_f(-FLT_MAX);
+        }
+        /* Process blocks of 3 registers, so each register lane always
+         * holds the same dimension.
+         */
+        for (; i + 3*GMX_SIMD_FLOAT_WIDTH <= size3; i += 3*GMX_SIMD_FLOAT_WIDTH)
+        {
+            for (d = 0; d < 3; d++)
+            {
+                x_S   = gmx_simd_loadu_f(fp + i + d*GMX_SIMD_FLOAT_WIDTH);
+                p_S   = gmx_simd_mul_f(x_S, prec_S);
+                abs_S = gmx_simd_max_f(abs_S, gmx_simd_fabs_f(p_S));
+                lf_S  = gmx_simd_add_f(p_S, gmx_simd_blendv_f(mhalf_S, half_S, gmx_simd_cmple_f(zero_S, x_S)));
+                gmx_simd_storeu_fi(ip + i + d*GMX_SIMD_FLOAT_WIDTH, gmx_simd_cvtt_f2i(lf_S));
+                /* Truncation is monotonic, so the float extremes give the
+                 * integer extremes.
+                 */
+                min_S[d] = gmx_simd_min_f(min_S[d], lf_S);
+                max_S[d] = gmx_simd_max_f(max_S[d], lf_S);
+            }
+        }
+        for (d = 0; d < 3; d++)
+        {
+            gmx_simd_storeu_f(mem_min, min_S[d]);
+            gmx_simd_storeu_f(mem_max, max_S[d]);
+            for (l = 0; l < GMX_SIMD_FLOAT_WIDTH; l++)
+            {
+                dim        = (d*GMX_SIMD_FLOAT_WIDTH + l) % 3;
+                lfmin[dim] = MIN(lfmin[dim], mem_min[l]);
+                lfmax[dim] = MAX(lfmax[dim], mem_max[l]);
+            }
+        }
+        /* For values this large the rounding offset has no effect */
+        gmx_simd_storeu_f(mem_max, abs_S);
+        for (l = 0; l < GMX_SIMD_FLOAT_WIDTH; l++)
+        {
+            lfabs = MAX(lfabs, mem_max[l]);
+        }
+    }
+#endif
+    for (; i < size3; i++)
+    {
+        /* find nearest integer */
+        if (fp[i] >= 0.0)
+        {
+            lf = fp[i] * precision + 0.5;
+        }
+        else
+        {
+            lf = fp[i] * precision - 0.5;
+        }
+        lfabs    = MAX(lfabs, fabs(lf));
+        ip[i]    = lf;
+        d        = i % 3;
+        lfmin[d] = MIN(lfmin[d], lf);
+        lfmax[d] = MAX(lfmax[d], lf);
+    }
+    for (d = 0; d < 3; d++)
+    {
+        minint[d] = lfmin[d];
+        maxint[d] = lfmax[d];
+    }
+    *maxabs = lfabs;
+}
+
+/*____________________________________________________________________________
+ |
+ | dequantize - convert integer coordinates back to floats
+ |
+ */
+
+static void dequantize(const int *ip, int size3, float inv_precision, float *fp)
+{
+    int i = 0;
+
+#ifdef XTC_SIMD_QUANTIZE
+    {
+        gmx_simd_float_t inv_prec_S = gmx_simd_set1_f(inv_precision);
+
+        for (; i + GMX_SIMD_FLOAT_WIDTH <= size3; i += GMX_SIMD_FLOAT_WIDTH)
+        {
+            gmx_simd_storeu_f(fp + i, gmx_simd_mul_f(gmx_simd_cvt_i2f(gmx_simd_loadu_fi(ip + i)), inv_prec_S));
+        }
+    }
+#endif
+    for (; i < size3; i++)
+    {
+        fp[i] = ip[i] * inv_precision;
+    }
+}
+
+/*____________________________________________________________________________
+ |
+ | decompress_coords - decode the compressed coordinates of one frame
+ |
+ | This is the reading half of xdr3dfcoord, after the parameters of the
+ | compression have been read. The nbytes bytes of compressed data in cbuf
+ | are decoded into lsize coordinate triplets in fp, using ip as
+ | temporary storage of 3*lsize integers. Returns 0 for corrupt data.
+ | Only reads global data, so it can be called from multiple threads.
+ |
+ */
+
+static int decompress_coords(int lsize, const int minint[], const int maxint[],
+                             int smallidx, const unsigned char *cbuf, int nbytes,
+                             int *ip, float precision, float *fp)
+{
+    unsigned     sizeint[3], sizesmall[3], bitsizeint[3];
+    unsigned int bitsize;
+    int          smallnum, smaller, i, k, run, flag, is_smaller, tmp;
+    int         *thiscoord, prevcoord[3];
+    t_xdr_bitbuf bb;
+
+    if (smallidx < FIRSTIDX || smallidx >= (int)LASTIDX)
+    {
+        return 0;
+    }
+
+    bitsizeint[0] = bitsizeint[1] = bitsizeint[2] = 0;
+    sizeint[0]    = maxint[0] - minint[0]+1;
+    sizeint[1]    = maxint[1] - minint[1]+1;
+    sizeint[2]    = maxint[2] - minint[2]+1;
+
+    /* check if one of the sizes is to big to be multiplied */
+    if ((sizeint[0] | sizeint[1] | sizeint[2] ) > 0xffffff)
+    {
+        bitsizeint[0] = sizeofint(sizeint[0]);
+        bitsizeint[1] = sizeofint(sizeint[1]);
+        bitsizeint[2] = sizeofint(sizeint[2]);
+        bitsize       = 0; /* flag the use of large sizes */
+    }
+    else
+    {
+        bitsize = sizeofints(3, sizeint);
+    }
+
+    smaller      = magicints[MAX(FIRSTIDX, smallidx-1)] / 2;
+    smallnum     = magicints[smallidx] / 2;
+    sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+
+    init_bitbuf(&bb, (unsigned char *)cbuf, nbytes);
+
+    /* The integer coordinates are decoded in place into ip, in the
+     * output order, and converted to float at the end.
+     */
+    run = 0;
+    i   = 0;
+    while (i < lsize)
+    {
+        thiscoord = ip + i * 3;
+
+        if (bitsize == 0)
+        {
+            thiscoord[0] = receivebits(&bb, bitsizeint[0]);
+            thiscoord[1] = receivebits(&bb, bitsizeint[1]);
+            thiscoord[2] = receivebits(&bb, bitsizeint[2]);
+        }
+        else
+        {
+            receiveints(&bb, 3, bitsize, sizeint, thiscoord);
+        }
+
+        i++;
+        thiscoord[0] += minint[0];
+        thiscoord[1] += minint[1];
+        thiscoord[2] += minint[2];
+
+        prevcoord[0] = thiscoord[0];
+        prevcoord[1] = thiscoord[1];
+        prevcoord[2] = thiscoord[2];
+
+
+        flag       = receivebits(&bb, 1);
+        is_smaller = 0;
+        if (flag == 1)
+        {
+            run        = receivebits(&bb, 5);
+            is_smaller = run % 3;
+            run       -= is_smaller;
+            is_smaller--;
+        }
+        if (i + run/3 > lsize)
+        {
+            /* corrupt data, more coordinates than atoms */
+            return 0;
+        }
+        for (k = 0; k < run; k += 3)
+        {
+            thiscoord = ip + i * 3;
+            receiveints(&bb, 3, smallidx, sizesmall, thiscoord);
+            i++;
+            thiscoord[0] += prevcoord[0] - smallnum;
+            thiscoord[1] += prevcoord[1] - smallnum;
+            thiscoord[2] += prevcoord[2] - smallnum;
+            if (k == 0)
+            {
+                /* interchange first with second atom for better
+                 * compression of water molecules
+                 */
+                tmp          = thiscoord[0]; thiscoord[0] = thiscoord[-3];
+                thiscoord[-3] = prevcoord[0] = tmp;
+                tmp          = thiscoord[1]; thiscoord[1] = thiscoord[-2];
+                thiscoord[-2] = prevcoord[1] = tmp;
+                tmp          = thiscoord[2]; thiscoord[2] = thiscoord[-1];
+                thiscoord[-1] = prevcoord[2] = tmp;
+            }
+            else
+            {
+                prevcoord[0] = thiscoord[0];
+                prevcoord[1] = thiscoord[1];
+                prevcoord[2] = thiscoord[2];
+            }
+        }
+        smallidx += is_smaller;
+        if (smallidx < FIRSTIDX || smallidx >= (int)LASTIDX)
+        {
+            return 0;
+        }
+        if (is_smaller < 0)
+        {
+            smallnum = smaller;
+            if (smallidx > FIRSTIDX)
+            {
+                smaller = magicints[smallidx - 1] /2;
+            }
+            else
+            {
+                smaller = 0;
+            }
+        }
+        else if (is_smaller > 0)
+        {
+            smaller  = smallnum;
+            smallnum = magicints[smallidx] / 2;
+        }
+        sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+    }
+    dequantize(ip, 3*lsize, 1.0 / precision, fp);
+
+    return 1;
+}
+
 /*____________________________________________________________________________
  |
  | xdr3dfcoord - read or write compressed 3d coordinates to xdr file.
@@ -412,19 +806,19 @@ int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision)
     int          prealloc_ip[3*16], prealloc_buf[3*20];
     int          we_should_free = 0;
 
-    int          minint[3], maxint[3], mindiff, *lip, diff;
-    int          lint1, lint2, lint3, oldlint1, oldlint2, oldlint3, smallidx;
+    int          minint[3], maxint[3], mindiff, diff;
+    int          smallidx;
     int          minidx, maxidx;
-    unsigned     sizeint[3], sizesmall[3], bitsizeint[3], size3, *luip;
-    int          flag, k;
+    unsigned     sizeint[3], sizesmall[3], bitsizeint[3], size3;
+    int          k;
     int          smallnum, smaller, larger, i, is_small, is_smaller, run, prevrun;
-    float       *lfp, lf;
     int          tmp, *thiscoord,  prevcoord[3];
     unsigned int tmpcoord[30];
 
     int          bufsize, xdrid, lsize;
     unsigned int bitsize;
-    float        inv_precision;
+    t_xdr_bitbuf bb;
+    float        maxabs;
     int          errval = 1;
     int          rc;
 
@@ -473,97 +867,23 @@ int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision)
             }
         }
         /* buf[0-2] are special and do not contain actual data */
-        buf[0]    = buf[1] = buf[2] = 0;
-        minint[0] = minint[1] = minint[2] = INT_MAX;
-        maxint[0] = maxint[1] = maxint[2] = INT_MIN;
-        prevrun   = -1;
-        lfp       = fp;
-        lip       = ip;
-        mindiff   = INT_MAX;
-        oldlint1  = oldlint2 = oldlint3 = 0;
-        while (lfp < fp + size3)
-        {
-            /* find nearest integer */
-            if (*lfp >= 0.0)
-            {
-                lf = *lfp * *precision + 0.5;
-            }
-            else
-            {
-                lf = *lfp * *precision - 0.5;
-            }
-            if (fabs(lf) > MAXABS)
-            {
-                /* scaling would cause overflow */
-                errval = 0;
-            }
-            lint1 = lf;
-            if (lint1 < minint[0])
-            {
-                minint[0] = lint1;
-            }
-            if (lint1 > maxint[0])
-            {
-                maxint[0] = lint1;
-            }
-            *lip++ = lint1;
-            lfp++;
-            if (*lfp >= 0.0)
-            {
-                lf = *lfp * *precision + 0.5;
-            }
-            else
-            {
-                lf = *lfp * *precision - 0.5;
-            }
-            if (fabs(lf) > MAXABS)
-            {
-                /* scaling would cause overflow */
-                errval = 0;
-            }
-            lint2 = lf;
-            if (lint2 < minint[1])
-            {
-                minint[1] = lint2;
-            }
-            if (lint2 > maxint[1])
-            {
-                maxint[1] = lint2;
-            }
-            *lip++ = lint2;
-            lfp++;
-            if (*lfp >= 0.0)
-            {
-                lf = *lfp * *precision + 0.5;
-            }
-            else
-            {
-                lf = *lfp * *precision - 0.5;
-            }
-            if (fabs(lf) > MAXABS)
-            {
-                /* scaling would cause overflow */
-                errval = 0;
-            }
-            lint3 = lf;
-            if (lint3 < minint[2])
-            {
-                minint[2] = lint3;
-            }
-            if (lint3 > maxint[2])
-            {
-                maxint[2] = lint3;
-            }
-            *lip++ = lint3;
-            lfp++;
-            diff = abs(oldlint1-lint1)+abs(oldlint2-lint2)+abs(oldlint3-lint3);
-            if (diff < mindiff && lfp > fp + 3)
+        buf[0]  = buf[1] = buf[2] = 0;
+        init_bitbuf(&bb, (unsigned char *)&(buf[3]), 0);
+        prevrun = -1;
+        quantize(fp, size3, *precision, ip, minint, maxint, &maxabs);
+        if (fabs(maxabs) > MAXABS)
+        {
+            /* scaling would cause overflow */
+            errval = 0;
+        }
+        mindiff = INT_MAX;
+        for (i = 3; i < size3; i += 3)
+        {
+            diff = abs(ip[i-3]-ip[i]) + abs(ip[i-2]-ip[i+1]) + abs(ip[i-1]-ip[i+2]);
+            if (diff < mindiff)
             {
                 mindiff = diff;
             }
-            oldlint1 = lint1;
-            oldlint2 = lint2;
-            oldlint3 = lint3;
         }
         if ( (xdr_int(xdrs, &(minint[0])) == 0) ||
              (xdr_int(xdrs, &(minint[1])) == 0) ||
@@ -605,8 +925,6 @@ int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision)
         {
             bitsize = sizeofints(3, sizeint);
         }
-        lip      = ip;
-        luip     = (unsigned int *) ip;
         smallidx = FIRSTIDX;
         while (smallidx < LASTIDX && magicints[smallidx] < mindiff)
         {
@@ -632,7 +950,7 @@ int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision)
         while (i < *size)
         {
             is_small  = 0;
-            thiscoord = (int *)(luip) + i * 3;
+            thiscoord = ip + i * 3;
             if (smallidx < maxidx && i >= 1 &&
                 abs(thiscoord[0] - prevcoord[0]) < larger &&
                 abs(thiscoord[1] - prevcoord[1]) < larger &&
@@ -672,13 +990,13 @@ int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision)
             tmpcoord[2] = thiscoord[2] - minint[2];
             if (bitsize == 0)
             {
-                sendbits(buf, bitsizeint[0], tmpcoord[0]);
-                sendbits(buf, bitsizeint[1], tmpcoord[1]);
-                sendbits(buf, bitsizeint[2], tmpcoord[2]);
+                sendbits(&bb, bitsizeint[0], tmpcoord[0]);
+                sendbits(&bb, bitsizeint[1], tmpcoord[1]);
+                sendbits(&bb, bitsizeint[2], tmpcoord[2]);
             }
             else
             {
-                sendints(buf, 3, bitsize, sizeint, tmpcoord);
+                sendints(&bb, 3, bitsize, sizeint, tmpcoord);
             }
             prevcoord[0] = thiscoord[0];
             prevcoord[1] = thiscoord[1];
@@ -723,16 +1041,16 @@ int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision)
             if (run != prevrun || is_smaller != 0)
             {
                 prevrun = run;
-                sendbits(buf, 1, 1); /* flag the change in run-length */
-                sendbits(buf, 5, run+is_smaller+1);
+                sendbits(&bb, 1, 1); /* flag the change in run-length */
+                sendbits(&bb, 5, run+is_smaller+1);
             }
             else
             {
-                sendbits(buf, 1, 0); /* flag the fact that runlength did not change */
+                sendbits(&bb, 1, 0); /* flag the fact that runlength did not change */
             }
             for (k = 0; k < run; k += 3)
             {
-                sendints(buf, 3, smallidx, sizesmall, &tmpcoord[k]);
+                sendints(&bb, 3, smallidx, sizesmall, &tmpcoord[k]);
             }
             if (is_smaller != 0)
             {
@@ -750,11 +1068,8 @@ int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision)
                 sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
             }
         }
-        if (buf[1] != 0)
-        {
-            buf[0]++;
-        }
         /* buf[0] holds the length in bytes */
+        buf[0] = flushbits(&bb);
         if (xdr_int(xdrs, &(buf[0])) == 0)
         {
             if (we_should_free)
@@ -804,8 +1119,9 @@ int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision)
 
         if (size3 <= prealloc_size)
         {
-            ip  = prealloc_ip;
-            buf = prealloc_buf;
+            ip      = prealloc_ip;
+            buf     = prealloc_buf;
+            bufsize = sizeof(prealloc_buf)/sizeof(*prealloc_buf);
         }
         else
         {
@@ -837,23 +1153,6 @@ int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision)
             return 0;
         }
 
-        sizeint[0] = maxint[0] - minint[0]+1;
-        sizeint[1] = maxint[1] - minint[1]+1;
-        sizeint[2] = maxint[2] - minint[2]+1;
-
-        /* check if one of the sizes is to big to be multiplied */
-        if ((sizeint[0] | sizeint[1] | sizeint[2] ) > 0xffffff)
-        {
-            bitsizeint[0] = sizeofint(sizeint[0]);
-            bitsizeint[1] = sizeofint(sizeint[1]);
-            bitsizeint[2] = sizeofint(sizeint[2]);
-            bitsize       = 0; /* flag the use of large sizes */
-        }
-        else
-        {
-            bitsize = sizeofints(3, sizeint);
-        }
-
         if (xdr_int(xdrs, &smallidx) == 0)
         {
             if (we_should_free)
@@ -864,13 +1163,6 @@ int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision)
             return 0;
         }
 
-        maxidx       = MIN(LASTIDX, smallidx + 8);
-        minidx       = maxidx - 8; /* often this equal smallidx */
-        smaller      = magicints[MAX(FIRSTIDX, smallidx-1)] / 2;
-        smallnum     = magicints[smallidx] / 2;
-        sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
-        larger       = magicints[maxidx];
-
         /* buf[0] holds the length in bytes */
 
         if (xdr_int(xdrs, &(buf[0])) == 0)
@@ -884,7 +1176,11 @@ int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision)
         }
 
 
-        if (xdr_opaque(xdrs, (char *)&(buf[3]), (unsigned int)buf[0]) == 0)
+        /* Do not trust the length in the file beyond our buffer size */
+        if (buf[0] < 0 || buf[0] > (bufsize - 3) * (int)sizeof(*buf) ||
+            xdr_opaque(xdrs, (char *)&(buf[3]), (unsigned int)buf[0]) == 0 ||
+            !decompress_coords(lsize, minint, maxint, smallidx,
+                               (unsigned char *)&(buf[3]), buf[0], ip, *precision, fp))
         {
             if (we_should_free)
             {
@@ -893,119 +1189,93 @@ int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision)
             }
             return 0;
         }
+    }
+    if (we_should_free)
+    {
+        free(ip);
+        free(buf);
+    }
+    return 1;
+}
 
+/* Returns the big-endian (xdr) 32-bit value stored at buf */
+static gmx_inline unsigned int get_xdr_uint(const unsigned char *buf)
+{
+    return ((unsigned int)buf[0] << 24) | ((unsigned int)buf[1] << 16) |
+           ((unsigned int)buf[2] << 8) | buf[3];
+}
 
+int xdr3dfcoord_from_buffer(const unsigned char *data, int nbytes,
+                            float *fp, int *size, float *precision)
+{
+    /* Size of the parameters that precede the compressed data */
+    const int nparams = 10*XDR_INT_SIZE;
+    union
+    {
+        unsigned int i;
+        float        f;
+    }         conv;
+    int       lsize, size3, minint[3], maxint[3], smallidx, ncomp, nused, i, rc;
+    int      *ip;
 
-        buf[0] = buf[1] = buf[2] = 0;
-
-        lfp           = fp;
-        inv_precision = 1.0 / *precision;
-        run           = 0;
-        i             = 0;
-        lip           = ip;
-        while (i < lsize)
+    if (nbytes < XDR_INT_SIZE)
+    {
+        return 0;
+    }
+    lsize = get_xdr_uint(data);
+    if (*size != 0 && lsize != *size)
+    {
+        fprintf(stderr, "wrong number of coordinates in xdr3dfcoord; "
+                "%d arg vs %d in file", *size, lsize);
+    }
+    *size = lsize;
+    size3 = lsize * 3;
+    if (lsize <= 9)
+    {
+        nused = XDR_INT_SIZE + size3*XDR_INT_SIZE;
+        if (lsize < 0 || nbytes < nused)
         {
-            thiscoord = (int *)(lip) + i * 3;
-
-            if (bitsize == 0)
-            {
-                thiscoord[0] = receivebits(buf, bitsizeint[0]);
-                thiscoord[1] = receivebits(buf, bitsizeint[1]);
-                thiscoord[2] = receivebits(buf, bitsizeint[2]);
-            }
-            else
-            {
-                receiveints(buf, 3, bitsize, sizeint, thiscoord);
-            }
-
-            i++;
-            thiscoord[0] += minint[0];
-            thiscoord[1] += minint[1];
-            thiscoord[2] += minint[2];
-
-            prevcoord[0] = thiscoord[0];
-            prevcoord[1] = thiscoord[1];
-            prevcoord[2] = thiscoord[2];
-
-
-            flag       = receivebits(buf, 1);
-            is_smaller = 0;
-            if (flag == 1)
-            {
-                run        = receivebits(buf, 5);
-                is_smaller = run % 3;
-                run       -= is_smaller;
-                is_smaller--;
-            }
-            if (run > 0)
-            {
-                thiscoord += 3;
-                for (k = 0; k < run; k += 3)
-                {
-                    receiveints(buf, 3, smallidx, sizesmall, thiscoord);
-                    i++;
-                    thiscoord[0] += prevcoord[0] - smallnum;
-                    thiscoord[1] += prevcoord[1] - smallnum;
-                    thiscoord[2] += prevcoord[2] - smallnum;
-                    if (k == 0)
-                    {
-                        /* interchange first with second atom for better
-                         * compression of water molecules
-                         */
-                        tmp          = thiscoord[0]; thiscoord[0] = prevcoord[0];
-                        prevcoord[0] = tmp;
-                        tmp          = thiscoord[1]; thiscoord[1] = prevcoord[1];
-                        prevcoord[1] = tmp;
-                        tmp          = thiscoord[2]; thiscoord[2] = prevcoord[2];
-                        prevcoord[2] = tmp;
-                        *lfp++       = prevcoord[0] * inv_precision;
-                        *lfp++       = prevcoord[1] * inv_precision;
-                        *lfp++       = prevcoord[2] * inv_precision;
-                    }
-                    else
-                    {
-                        prevcoord[0] = thiscoord[0];
-                        prevcoord[1] = thiscoord[1];
-                        prevcoord[2] = thiscoord[2];
-                    }
-                    *lfp++ = thiscoord[0] * inv_precision;
-                    *lfp++ = thiscoord[1] * inv_precision;
-                    *lfp++ = thiscoord[2] * inv_precision;
-                }
-            }
-            else
-            {
-                *lfp++ = thiscoord[0] * inv_precision;
-                *lfp++ = thiscoord[1] * inv_precision;
-                *lfp++ = thiscoord[2] * inv_precision;
-            }
-            smallidx += is_smaller;
-            if (is_smaller < 0)
-            {
-                smallnum = smaller;
-                if (smallidx > FIRSTIDX)
-                {
-                    smaller = magicints[smallidx - 1] /2;
-                }
-                else
-                {
-                    smaller = 0;
-                }
-            }
-            else if (is_smaller > 0)
-            {
-                smaller  = smallnum;
-                smallnum = magicints[smallidx] / 2;
-            }
-            sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+            return 0;
+        }
+        for (i = 0; i < size3; i++)
+        {
+            conv.i = get_xdr_uint(data + XDR_INT_SIZE*(1 + i));
+            fp[i]  = conv.f;
         }
+        *precision = -1;
+        return nused;
     }
-    if (we_should_free)
+    if (nbytes < nparams)
     {
-        free(ip);
-        free(buf);
+        return 0;
     }
-    return 1;
+    conv.i     = get_xdr_uint(data + XDR_INT_SIZE);
+    *precision = conv.f;
+    for (i = 0; i < 3; i++)
+    {
+        minint[i] = get_xdr_uint(data + XDR_INT_SIZE*(2 + i));
+        maxint[i] = get_xdr_uint(data + XDR_INT_SIZE*(5 + i));
+    }
+    smallidx = get_xdr_uint(data + XDR_INT_SIZE*8);
+    ncomp    = get_xdr_uint(data + XDR_INT_SIZE*9);
+    /* xdr pads opaque data to a multiple of 4 bytes */
+    nused    = nparams + ((ncomp + XDR_INT_SIZE - 1)/XDR_INT_SIZE)*XDR_INT_SIZE;
+    if (ncomp < 0 || nbytes < nused)
+    {
+        return 0;
+    }
+
+    ip = (int *)malloc((size_t)(size3 * sizeof(*ip)));
+    if (ip == NULL)
+    {
+        fprintf(stderr, "malloc failed\n");
+        exit(1);
+    }
+    rc = decompress_coords(lsize, minint, maxint, smallidx,
+                           data + nparams, ncomp, ip, *precision, fp);
+    free(ip);
+
+    return rc ? nused : 0;
 }
 
 
@@ -34,9 +34,13 @@
  */
 #include "mdoutf.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "gromacs/legacyheaders/mdrun.h"
 #include "gromacs/legacyheaders/types/commrec.h"
 #include "gromacs/legacyheaders/mvdata.h"
+#include "gromacs/legacyheaders/network.h"
 #include "gromacs/legacyheaders/domdec.h"
 #include "trnio.h"
 #include "xtcio.h"
@@ -50,6 +54,43 @@
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/smalloc.h"
 
+#include "thread_mpi/threads.h"
+
+/* The default number of frames the trajectory writer thread can queue */
+#define TRAJ_WRITER_NFRAMES_DEFAULT 4
+
+/* A trajectory frame for writing to the uncompressed and/or compressed
+ * output files. Coordinate pointers are NULL when not written.
+ */
+typedef struct {
+    int          mdof_flags;
+    gmx_int64_t  step;
+    double       t;
+    real         lambda;
+    matrix       box;
+    rvec        *x;
+    rvec        *v;
+    rvec        *f;
+    rvec        *xxtc;
+    /* Buffers for the frame copies, only used with the writer thread */
+    rvec        *x_buf;
+    rvec        *v_buf;
+    rvec        *f_buf;
+    rvec        *xxtc_buf;
+} t_traj_frame;
+
+/* The trajectory writer thread with a bounded queue of frames */
+typedef struct {
+    tMPI_Thread_t        thread;
+    tMPI_Thread_mutex_t  mutex;
+    tMPI_Thread_cond_t   cond;
+    int                  nframes;  /* the size of the queue */
+    t_traj_frame        *frame;    /* circular buffer of frames */
+    int                  first;    /* the index of the first queued frame */
+    int                  nqueued;  /* the number of queued frames */
+    gmx_bool             bStop;    /* the thread should stop */
+} t_traj_writer;
+
 struct gmx_mdoutf {
     t_fileio         *fp_trn;
     t_fileio         *fp_xtc;
@@ -68,9 +109,234 @@ struct gmx_mdoutf {
     int               natoms_global;
     int               natoms_x_compressed;
     gmx_groups_t     *groups; /* for compressed position writing */
+    gmx_checkpoint_writer_t cpt_writer; /* writes checkpoints asynchronously, can be NULL */
+    gmx_bool          bDistributedCpt; /* each DD rank writes its home atoms */
+    t_traj_writer    *traj_writer; /* writes trajectory frames asynchronously, can be NULL */
 };
 
 
+
+/* Writes frame to the trajectory files */
+static void write_traj_frame(gmx_mdoutf_t of, t_traj_frame *frame)
+{
+    int mdof_flags = frame->mdof_flags;
+
+    if (mdof_flags & (MDOF_X | MDOF_V | MDOF_F))
+    {
+        if (of->fp_trn)
+        {
+            fwrite_trn(of->fp_trn, frame->step, frame->t, frame->lambda,
+                       frame->box, of->natoms_global,
+                       frame->x, frame->v, frame->f);
+            if (gmx_fio_flush(of->fp_trn) != 0)
+            {
+                gmx_file("Cannot write trajectory; maybe you are out of disk space?");
+            }
+        }
+
+        gmx_fwrite_tng(of->tng, FALSE, frame->step, frame->t, frame->lambda,
+                       (const rvec *) frame->box,
+                       of->natoms_global,
+                       (const rvec *) frame->x,
+                       (const rvec *) frame->v,
+                       (const rvec *) frame->f);
+    }
+    if (mdof_flags & MDOF_X_COMPRESSED)
+    {
+        if (write_xtc(of->fp_xtc, of->natoms_x_compressed, frame->step, frame->t,
+                      frame->box, frame->xxtc, of->x_compression_precision) == 0)
+        {
+            gmx_fatal(FARGS, "XTC error - maybe you are out of disk space?");
+        }
+        gmx_fwrite_tng(of->tng_low_prec,
+                       TRUE,
+                       frame->step,
+                       frame->t,
+                       frame->lambda,
+                       (const rvec *) frame->box,
+                       of->natoms_x_compressed,
+                       (const rvec *) frame->xxtc,
+                       NULL,
+                       NULL);
+    }
+}
+
+static void *traj_writer_thread(void *arg)
+{
+    gmx_mdoutf_t   of = (gmx_mdoutf_t)arg;
+    t_traj_writer *tw = of->traj_writer;
+
+    tMPI_Thread_mutex_lock(&tw->mutex);
+    while (!tw->bStop || tw->nqueued > 0)
+    {
+        if (tw->nqueued == 0)
+        {
+            tMPI_Thread_cond_wait(&tw->cond, &tw->mutex);
+            continue;
+        }
+        /* The frame stays in the queue while writing,
+         * so the producer does not reuse its buffers.
+         */
+        tMPI_Thread_mutex_unlock(&tw->mutex);
+
+        write_traj_frame(of, &tw->frame[tw->first]);
+
+        tMPI_Thread_mutex_lock(&tw->mutex);
+        tw->first = (tw->first + 1) % tw->nframes;
+        tw->nqueued--;
+        tMPI_Thread_cond_broadcast(&tw->cond);
+    }
+    tMPI_Thread_mutex_unlock(&tw->mutex);
+
+    return NULL;
+}
+
+/* Starts a trajectory writer thread for of when the environment variable
+ * GMX_ASYNC_TRAJECTORY is set. Its value, when positive, sets the number
+ * of frames that can be queued.
+ */
+static void init_traj_writer(gmx_mdoutf_t of)
+{
+    t_traj_writer *tw;
+    const char    *env;
+    int            nframes, i;
+
+    env = getenv("GMX_ASYNC_TRAJECTORY");
+    if (env == NULL || tMPI_Thread_support() != TMPI_THREAD_SUPPORT_YES)
+    {
+        return;
+    }
+    nframes = atoi(env);
+    if (nframes <= 0)
+    {
+        nframes = TRAJ_WRITER_NFRAMES_DEFAULT;
+    }
+
+    snew(tw, 1);
+    tw->nframes = nframes;
+    snew(tw->frame, nframes);
+    for (i = 0; i < nframes; i++)
+    {
+        snew(tw->frame[i].xxtc_buf, of->natoms_x_compressed);
+    }
+    tMPI_Thread_mutex_init(&tw->mutex);
+    tMPI_Thread_cond_init(&tw->cond);
+
+    of->traj_writer = tw;
+    if (tMPI_Thread_create(&tw->thread, traj_writer_thread, of) != 0)
+    {
+        gmx_fatal(FARGS, "Could not create the trajectory writer thread");
+    }
+}
+
+/* Waits until all queued frames have been written */
+static void wait_traj_writer(t_traj_writer *tw)
+{
+    if (tw == NULL)
+    {
+        return;
+    }
+
+    tMPI_Thread_mutex_lock(&tw->mutex);
+    while (tw->nqueued > 0)
+    {
+        tMPI_Thread_cond_wait(&tw->cond, &tw->mutex);
+    }
+    tMPI_Thread_mutex_unlock(&tw->mutex);
+}
+
+static void done_traj_writer(t_traj_writer *tw)
+{
+    int i;
+
+    if (tw == NULL)
+    {
+        return;
+    }
+
+    tMPI_Thread_mutex_lock(&tw->mutex);
+    tw->bStop = TRUE;
+    tMPI_Thread_cond_broadcast(&tw->cond);
+    tMPI_Thread_mutex_unlock(&tw->mutex);
+    tMPI_Thread_join(tw->thread, NULL);
+
+    for (i = 0; i < tw->nframes; i++)
+    {
+        sfree(tw->frame[i].x_buf);
+        sfree(tw->frame[i].v_buf);
+        sfree(tw->frame[i].f_buf);
+        sfree(tw->frame[i].xxtc_buf);
+    }
+    sfree(tw->frame);
+    tMPI_Thread_cond_destroy(&tw->cond);
+    tMPI_Thread_mutex_destroy(&tw->mutex);
+    sfree(tw);
+}
+
+/* Returns the next free frame in the queue, waits when the queue is full */
+static t_traj_frame *get_traj_writer_frame(t_traj_writer *tw)
+{
+    t_traj_frame *frame;
+
+    tMPI_Thread_mutex_lock(&tw->mutex);
+    while (tw->nqueued == tw->nframes)
+    {
+        tMPI_Thread_cond_wait(&tw->cond, &tw->mutex);
+    }
+    frame = &tw->frame[(tw->first + tw->nqueued) % tw->nframes];
+    tMPI_Thread_mutex_unlock(&tw->mutex);
+
+    return frame;
+}
+
+/* Copies the coordinates of frame, obtained with get_traj_writer_frame,
+ * to its buffers and queues it for writing.
+ */
+static void queue_traj_writer_frame(gmx_mdoutf_t of, t_traj_frame *frame)
+{
+    t_traj_writer *tw = of->traj_writer;
+    int            natoms = of->natoms_global;
+
+    if (frame->xxtc != NULL && frame->xxtc != frame->xxtc_buf)
+    {
+        /* All atoms are written, xxtc points to the global coordinates */
+        memcpy(frame->xxtc_buf, frame->xxtc, of->natoms_x_compressed*sizeof(rvec));
+        frame->xxtc = frame->xxtc_buf;
+    }
+    if (frame->x != NULL)
+    {
+        if (frame->x_buf == NULL)
+        {
+            snew(frame->x_buf, natoms);
+        }
+        memcpy(frame->x_buf, frame->x, natoms*sizeof(rvec));
+        frame->x = frame->x_buf;
+    }
+    if (frame->v != NULL)
+    {
+        if (frame->v_buf == NULL)
+        {
+            snew(frame->v_buf, natoms);
+        }
+        memcpy(frame->v_buf, frame->v, natoms*sizeof(rvec));
+        frame->v = frame->v_buf;
+    }
+    if (frame->f != NULL)
+    {
+        if (frame->f_buf == NULL)
+        {
+            snew(frame->f_buf, natoms);
+        }
+        memcpy(frame->f_buf, frame->f, natoms*sizeof(rvec));
+        frame->f = frame->f_buf;
+    }
+
+    tMPI_Thread_mutex_lock(&tw->mutex);
+    tw->nqueued++;
+    tMPI_Thread_cond_broadcast(&tw->cond);
+    tMPI_Thread_mutex_unlock(&tw->mutex);
+}
+
 gmx_mdoutf_t init_mdoutf(FILE *fplog, int nfile, const t_filenm fnm[],
                          int mdrun_flags, const t_commrec *cr,
                          const t_inputrec *ir, gmx_mtop_t *top_global,
@@ -90,6 +356,13 @@ gmx_mdoutf_t init_mdoutf(FILE *fplog, int nfile, const t_filenm fnm[],
     of->tng_low_prec = NULL;
     of->fp_dhdl      = NULL;
     of->fp_field     = NULL;
+    of->cpt_writer   = NULL;
+    of->traj_writer  = NULL;
+
+    /* All ranks need the checkpoint name for writing distributed parts */
+    of->fn_cpt          = opt2fn("-cpo", nfile, fnm);
+    of->bDistributedCpt = (DOMAINDECOMP(cr) &&
+                           getenv("GMX_DISTRIBUTED_CHECKPOINT") != NULL);
 
     of->eIntegrator             = ir->eI;
     of->bExpanded               = ir->bExpanded;
@@ -161,7 +434,7 @@ gmx_mdoutf_t init_mdoutf(FILE *fplog, int nfile, const t_filenm fnm[],
         {
             of->fp_ene = open_enx(ftp2fn(efEDR, nfile, fnm), filemode);
         }
-        of->fn_cpt = opt2fn("-cpo", nfile, fnm);
+        of->cpt_writer = init_checkpoint_writer();
 
         if ((ir->efep != efepNO || ir->bSimTemp) && ir->fepvals->nstdhdl > 0 &&
             (ir->fepvals->separate_dhdl_file == esepdhdlfileYES ) &&
@@ -207,6 +480,8 @@ gmx_mdoutf_t init_mdoutf(FILE *fplog, int nfile, const t_filenm fnm[],
                 of->natoms_x_compressed++;
             }
         }
+
+        init_traj_writer(of);
     }
 
     if (bCiteTng)
@@ -251,18 +526,33 @@ void mdoutf_write_to_trajectory_files(FILE *fplog, t_commrec *cr,
 
     if (DOMAINDECOMP(cr))
     {
-        if (mdof_flags & MDOF_CPT)
+        if ((mdof_flags & MDOF_CPT) && !of->bDistributedCpt)
         {
             dd_collect_state(cr->dd, state_local, state_global);
         }
         else
         {
-            if (mdof_flags & (MDOF_X | MDOF_X_COMPRESSED))
+            if (mdof_flags & MDOF_CPT)
+            {
+                /* Each rank writes its home atoms, so we avoid
+                 * collecting the atom data on the master.
+                 */
+                dd_collect_state_nonatomic(cr->dd, state_local, state_global);
+                write_checkpoint_part(of->fn_cpt, step,
+                                      cr->dd->rank, cr->dd->nnodes,
+                                      top_global->natoms, cr->dd->nat_home,
+                                      cr->dd->gatindex, state_local);
+                /* The master lists the parts in the checkpoint file,
+                 * so all parts should be complete before that.
+                 */
+                gmx_barrier(cr);
+            }
+            if (mdof_flags & (MDOF_X | MDOF_X_COMPRESSED | MDOF_CONFOUT))
             {
                 dd_collect_vec(cr->dd, state_local, state_local->x,
                                state_global->x);
             }
-            if (mdof_flags & MDOF_V)
+            if (mdof_flags & (MDOF_V | MDOF_CONFOUT))
             {
                 dd_collect_vec(cr->dd, state_local, local_v,
                                global_v);
@@ -295,79 +585,85 @@ void mdoutf_write_to_trajectory_files(FILE *fplog, t_commrec *cr,
     {
         if (mdof_flags & MDOF_CPT)
         {
+            /* The checkpoint stores the output file positions,
+             * so all frames before this step should have been written.
+             */
+            wait_traj_writer(of->traj_writer);
             fflush_tng(of->tng);
             fflush_tng(of->tng_low_prec);
             write_checkpoint(of->fn_cpt, of->bKeepAndNumCPT,
                              fplog, cr, of->eIntegrator, of->simulation_part,
-                             of->bExpanded, of->elamstats, step, t, state_global);
+                             of->bExpanded, of->elamstats, step, t, state_global,
+                             of->bDistributedCpt ? cr->dd->nnodes : 0,
+                             of->cpt_writer);
         }
 
-        if (mdof_flags & (MDOF_X | MDOF_V | MDOF_F))
-        {
-            if (of->fp_trn)
-            {
-                fwrite_trn(of->fp_trn, step, t, state_local->lambda[efptFEP],
-                           state_local->box, top_global->natoms,
-                           (mdof_flags & MDOF_X) ? state_global->x : NULL,
-                           (mdof_flags & MDOF_V) ? global_v : NULL,
-                           (mdof_flags & MDOF_F) ? f_global : NULL);
-                if (gmx_fio_flush(of->fp_trn) != 0)
-                {
-                    gmx_file("Cannot write trajectory; maybe you are out of disk space?");
-                }
-            }
-
-            gmx_fwrite_tng(of->tng, FALSE, step, t, state_local->lambda[efptFEP],
-                           (const rvec *) state_local->box,
-                           top_global->natoms,
-                           (mdof_flags & MDOF_X) ? (const rvec *) state_global->x : NULL,
-                           (mdof_flags & MDOF_V) ? (const rvec *) global_v : NULL,
-                           (mdof_flags & MDOF_F) ? (const rvec *) f_global : NULL);
-        }
-        if (mdof_flags & MDOF_X_COMPRESSED)
+        if (mdof_flags & (MDOF_X | MDOF_V | MDOF_F | MDOF_X_COMPRESSED))
         {
-            rvec *xxtc = NULL;
+            t_traj_frame  frame_local, *frame;
 
-            if (of->natoms_x_compressed == of->natoms_global)
+            if (of->traj_writer != NULL)
             {
-                /* We are writing the positions of all of the atoms to
-                   the compressed output */
-                xxtc = state_global->x;
+                frame = get_traj_writer_frame(of->traj_writer);
             }
             else
             {
-                /* We are writing the positions of only a subset of
-                   the atoms to the compressed output, so we have to
-                   make a copy of the subset of coordinates. */
-                int i, j;
-
-                snew(xxtc, of->natoms_x_compressed);
-                for (i = 0, j = 0; (i < of->natoms_x_compressed); i++)
+                frame = &frame_local;
+            }
+            frame->mdof_flags = mdof_flags;
+            frame->step       = step;
+            frame->t          = t;
+            frame->lambda     = state_local->lambda[efptFEP];
+            copy_mat(state_local->box, frame->box);
+            frame->x          = (mdof_flags & MDOF_X) ? state_global->x : NULL;
+            frame->v          = (mdof_flags & MDOF_V) ? global_v : NULL;
+            frame->f          = (mdof_flags & MDOF_F) ? f_global : NULL;
+            frame->xxtc       = NULL;
+            if (mdof_flags & MDOF_X_COMPRESSED)
+            {
+                if (of->natoms_x_compressed == of->natoms_global)
+                {
+                    /* We are writing the positions of all of the atoms to
+                       the compressed output */
+                    frame->xxtc = state_global->x;
+                }
+                else
                 {
-                    if (ggrpnr(of->groups, egcCompressedX, i) == 0)
+                    /* We are writing the positions of only a subset of
+                       the atoms to the compressed output, so we have to
+                       make a copy of the subset of coordinates. */
+                    int i, j;
+
+                    if (of->traj_writer != NULL)
+                    {
+                        frame->xxtc = frame->xxtc_buf;
+                    }
+                    else
                     {
-                        copy_rvec(state_global->x[i], xxtc[j++]);
+                        snew(frame->xxtc, of->natoms_x_compressed);
+                    }
+                    for (i = 0, j = 0; (i < of->natoms_x_compressed); i++)
+                    {
+                        if (ggrpnr(of->groups, egcCompressedX, i) == 0)
+                        {
+                            copy_rvec(state_global->x[i], frame->xxtc[j++]);
+                        }
                     }
                 }
             }
-            if (write_xtc(of->fp_xtc, of->natoms_x_compressed, step, t,
-                          state_local->box, xxtc, of->x_compression_precision) == 0)
+
+            if (of->traj_writer != NULL)
             {
-                gmx_fatal(FARGS, "XTC error - maybe you are out of disk space?");
+                /* Copy the data, MD continues with the originals */
+                queue_traj_writer_frame(of, frame);
             }
-            gmx_fwrite_tng(of->tng_low_prec,
-                           TRUE,
-                           step,
-                           t,
-                           state_local->lambda[efptFEP],
-                           (const rvec *) state_local->box,
-                           of->natoms_x_compressed,
-                           (const rvec *) xxtc,
-                           NULL,
-                           NULL);
-            if (of->natoms_x_compressed != of->natoms_global)
+            else
             {
-                sfree(xxtc);
+                write_traj_frame(of, frame);
+                if (frame->xxtc != NULL && frame->xxtc != state_global->x)
+                {
+                    sfree(frame->xxtc);
+                }
             }
         }
     }
@@ -375,6 +671,12 @@ void mdoutf_write_to_trajectory_files(FILE *fplog, t_commrec *cr,
 
 void done_mdoutf(gmx_mdoutf_t of)
 {
+    /* The last checkpoint and frames should be complete
+     * before closing the output files.
+     */
+    done_traj_writer(of->traj_writer);
+    done_checkpoint_writer(of->cpt_writer);
+
     if (of->fp_ene != NULL)
     {
         close_enx(of->fp_ene);
@@ -47,6 +47,10 @@
 #include "filenm.h"
 #include "enxio.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 struct gmx_mtop_t;
 
 typedef struct gmx_mdoutf *gmx_mdoutf_t;
@@ -97,6 +101,10 @@ void mdoutf_write_to_trajectory_files(FILE *fplog, t_commrec *cr,
 #define MDOF_X_COMPRESSED (1<<3)
 #define MDOF_CPT          (1<<4)
 #define MDOF_IMD          (1<<5)
+#define MDOF_CONFOUT      (1<<6)
 
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* GMX_FILEIO_MDOUTF_H */
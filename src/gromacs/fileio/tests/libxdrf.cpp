@@ -0,0 +1,221 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the xtc coordinate compression.
+ *
+ * The reference file xtc-coder-reference.xtc was written with the original
+ * bit-by-bit implementation of the coder. Any change to the coder must keep
+ * the output bit-identical to this file, since that is the xtc format.
+ *
+ * \ingroup module_fileio
+ */
+#include <cmath>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/xtcio.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "testutils/testfilemanager.h"
+
+namespace
+{
+
+//! Description of a test frame.
+struct XtcCoderFrame
+{
+    //! Number of atoms.
+    int         natoms;
+    //! Extent of the coordinates in nm.
+    double      extent;
+    //! Compression precision.
+    real        precision;
+    //! Whether atoms are placed in water-like triplets.
+    bool        bWater;
+};
+
+//! The frames in the reference file, covering all code paths of the coder.
+const XtcCoderFrame c_frames[] = {
+    //! Water with the default precision.
+    { 3000, 4.0, 1000, true },
+    //! Water with low precision and negative coordinates.
+    { 999, -3.0, 100, true },
+    //! Large extent, uses sizes that do not fit in 64 bits.
+    { 501, 1.5e4, 1000, true },
+    //! Larger extent, uses separate bit sizes per dimension.
+    { 300, 2.0e4, 1000, true },
+    //! Few atoms, which are stored uncompressed.
+    { 7, 2.0, 1000, false },
+    //! Dense atoms with high precision.
+    { 2000, 2.5, 10000, true },
+};
+
+/*! \brief Returns reproducible coordinates for frame \p f.
+ *
+ * Uses a simple linear congruential generator, so the coordinates do not
+ * depend on the platform or the random engine implementation.
+ */
+std::vector<float> frameCoordinates(const XtcCoderFrame &f)
+{
+    std::vector<float> x(3*f.natoms);
+    unsigned int       seed = 12345 + f.natoms;
+    float              center[3] = {0, 0, 0};
+
+    for (int a = 0; a < f.natoms; a++)
+    {
+        for (int d = 0; d < 3; d++)
+        {
+            seed = seed*1103515245u + 12345u;
+            /* Use all mantissa bits, so the scaling by the precision is
+             * inexact and any change in rounding shows up in the output.
+             */
+            float r = ((seed >> 8) & 0xffffff)/16777216.0f;
+            if (f.bWater && a % 3 != 0)
+            {
+                /* Hydrogens within 0.1 nm of their oxygen */
+                x[3*a + d] = center[d] + 0.1f*(r - 0.5f);
+            }
+            else
+            {
+                x[3*a + d] = f.extent*r;
+                center[d]  = x[3*a + d];
+            }
+        }
+    }
+
+    return x;
+}
+
+//! Returns the contents of file \p fn.
+std::string fileContents(const std::string &fn)
+{
+    std::ifstream in(fn.c_str(), std::ios::in | std::ios::binary);
+
+    return std::string(std::istreambuf_iterator<char>(in),
+                       std::istreambuf_iterator<char>());
+}
+
+class XtcCoderTest : public ::testing::Test
+{
+    public:
+        //! Writes all reference frames to \p fn.
+        void writeFrames(const std::string &fn)
+        {
+            t_fileio *fio = open_xtc(fn.c_str(), "w");
+
+            for (size_t i = 0; i < sizeof(c_frames)/sizeof(c_frames[0]); i++)
+            {
+                const XtcCoderFrame &f   = c_frames[i];
+                std::vector<float>   xf  = frameCoordinates(f);
+                matrix               box = {{10, 0, 0}, {0, 10, 0}, {0, 0, 10}};
+                rvec                *x;
+
+                snew(x, f.natoms);
+                for (int a = 0; a < f.natoms; a++)
+                {
+                    for (int d = 0; d < 3; d++)
+                    {
+                        x[a][d] = xf[3*a + d];
+                    }
+                }
+                ASSERT_TRUE(write_xtc(fio, f.natoms, i, i, box, x, f.precision));
+                sfree(x);
+            }
+            close_xtc(fio);
+        }
+
+        gmx::test::TestFileManager fileManager_;
+};
+
+TEST_F(XtcCoderTest, WritesReferenceBits)
+{
+    std::string fn = fileManager_.getTemporaryFilePath(".xtc");
+
+    writeFrames(fn);
+    std::string reference =
+        fileContents(gmx::test::TestFileManager::getInputFilePath("xtc-coder-reference.xtc"));
+    ASSERT_FALSE(reference.empty());
+    EXPECT_TRUE(reference == fileContents(fn)) << "xtc output differs from the reference";
+}
+
+TEST_F(XtcCoderTest, ReadsReferenceFrames)
+{
+    std::string fn = gmx::test::TestFileManager::getInputFilePath("xtc-coder-reference.xtc");
+    t_fileio   *fio;
+    int         natoms, step;
+    real        time, prec;
+    matrix      box;
+    rvec       *x;
+    gmx_bool    bOK;
+
+    fio = open_xtc(fn.c_str(), "r");
+    ASSERT_TRUE(read_first_xtc(fio, &natoms, &step, &time, box, &x, &prec, &bOK));
+    size_t nframes = sizeof(c_frames)/sizeof(c_frames[0]);
+    for (size_t i = 0; i < nframes; i++)
+    {
+        const XtcCoderFrame &f  = c_frames[i];
+        std::vector<float>   xf = frameCoordinates(f);
+
+        if (i > 0)
+        {
+            /* The frames have different numbers of atoms */
+            sfree(x);
+            ASSERT_TRUE(read_first_xtc(fio, &natoms, &step, &time, box, &x, &prec, &bOK));
+        }
+        ASSERT_TRUE(bOK);
+        ASSERT_EQ(f.natoms, natoms);
+        EXPECT_EQ(static_cast<int>(i), step);
+        /* Rounding to the precision, plus float rounding for large values */
+        double tolerance = 0.5/f.precision + 1e-6*std::fabs(f.extent);
+        for (int a = 0; a < natoms; a++)
+        {
+            for (int d = 0; d < 3; d++)
+            {
+                EXPECT_NEAR(xf[3*a + d], x[a][d], tolerance) << "frame " << i << " atom " << a;
+            }
+        }
+    }
+    EXPECT_FALSE(read_next_xtc(fio, natoms, &step, &time, box, x, &prec, &bOK));
+    sfree(x);
+    close_xtc(fio);
+}
+
+} // namespace
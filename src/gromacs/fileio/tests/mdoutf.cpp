@@ -0,0 +1,295 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for writing the mdrun trajectory output.
+ *
+ * The asynchronous trajectory writer thread, enabled with
+ * GMX_ASYNC_TRAJECTORY, should write the same trajectory and
+ * checkpoint files as writing directly, while the state changes
+ * after each frame has been handed over.
+ *
+ * \ingroup module_fileio
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/filenm.h"
+#include "gromacs/fileio/mdoutf.h"
+#include "gromacs/legacyheaders/network.h"
+#include "gromacs/legacyheaders/typedefs.h"
+#include "gromacs/topology/topology.h"
+#include "gromacs/utility/smalloc.h"
+#include "gromacs/utility/stringutil.h"
+
+#include "testutils/testfilemanager.h"
+
+namespace
+{
+
+//! Number of atoms, large enough that writing a frame takes a while.
+const int c_natoms     = 10000;
+//! Number of MD steps.
+const int c_nsteps     = 20;
+//! Step at which a checkpoint is written.
+const int c_checkpoint = 13;
+
+//! Returns the contents of file \p fn.
+std::string fileContents(const std::string &fn)
+{
+    std::ifstream in(fn.c_str(), std::ios::in | std::ios::binary);
+
+    return std::string(std::istreambuf_iterator<char>(in),
+                       std::istreambuf_iterator<char>());
+}
+
+//! Sets or, with \p value NULL, unsets environment variable \p name.
+void setEnv(const char *name, const char *value)
+{
+    // TODO fix this when we have an encapsulation layer for handling
+    // environment variables
+#ifdef GMX_NATIVE_WINDOWS
+    _putenv_s(name, value != NULL ? value : "");
+#else
+    if (value != NULL)
+    {
+        setenv(name, value, true);
+    }
+    else
+    {
+        unsetenv(name);
+    }
+#endif
+}
+
+class TrajectoryWriterTest : public ::testing::Test
+{
+    public:
+        TrajectoryWriterTest() : cr_(init_commrec())
+        {
+            int i;
+
+            fnTrr_ = fileManager_.getTemporaryFilePath(".trr");
+            fnXtc_ = fileManager_.getTemporaryFilePath(".xtc");
+            fnEdr_ = fileManager_.getTemporaryFilePath(".edr");
+            fnCpt_ = fileManager_.getTemporaryFilePath(".cpt");
+            fileManager_.getTemporaryFilePath(".log");
+            fileManager_.getTemporaryFilePath(".xvg");
+            fileManager_.getTemporaryFilePath(gmx::formatString("step%d.cpt", c_checkpoint));
+
+            init_inputrec(&ir_);
+            ir_.eI                      = eiMD;
+            ir_.nstxout                 = 4;
+            ir_.nstvout                 = 4;
+            ir_.nstfout                 = 5;
+            ir_.nstxout_compressed      = 1;
+            ir_.x_compression_precision = 1000;
+            ir_.simulation_part         = 1;
+
+            /* Leave out every third atom from the compressed output */
+            std::memset(&mtop_, 0, sizeof(mtop_));
+            mtop_.natoms = c_natoms;
+            snew(mtop_.groups.grpnr[egcCompressedX], c_natoms);
+            for (i = 0; i < c_natoms; i++)
+            {
+                mtop_.groups.grpnr[egcCompressedX][i] = (i % 3 == 2);
+            }
+        }
+
+        ~TrajectoryWriterTest()
+        {
+            sfree(mtop_.groups.grpnr[egcCompressedX]);
+            done_inputrec(&ir_);
+            sfree(cr_);
+            setEnv("GMX_ASYNC_TRAJECTORY", NULL);
+        }
+
+        //! Sets the coordinates, velocities and forces of \p step.
+        static void setFrame(t_state *state, rvec *f, int step)
+        {
+            int i;
+
+            for (i = 0; i < c_natoms; i++)
+            {
+                state->x[i][XX] = 0.01*(i % 300) + 0.001*step;
+                state->x[i][YY] = 0.2*(i % 17) - 0.002*step*(i % 3);
+                state->x[i][ZZ] = 0.3*(i % 23) + 0.003*step;
+                state->v[i][XX] = 0.1*(i % 7) - 0.01*step;
+                state->v[i][YY] = -0.2*(i % 5) + 0.02*step;
+                state->v[i][ZZ] = 0.3*(i % 3);
+                f[i][XX]        = 10.0*(i % 11) + step;
+                f[i][YY]        = -20.0*(i % 13);
+                f[i][ZZ]        = 30.0*(i % 5) - step;
+            }
+            state->box[XX][XX]      = 3.0 + 0.01*step;
+            state->box[YY][YY]      = 3.1;
+            state->box[ZZ][ZZ]      = 3.2 - 0.01*step;
+            state->lambda[efptFEP]  = 0.05*step;
+        }
+
+        //! Runs the MD steps that write the output files.
+        void runSteps()
+        {
+            t_filenm     fnm[] = {
+                { efTRN, "-o", NULL, ffWRITE, 1, NULL },
+                { efCOMPRESSED, "-x", NULL, ffOPTWR, 1, NULL },
+                { efEDR, "-e", NULL, ffWRITE, 1, NULL },
+                { efCPT, "-cpo", NULL, ffOPTWR, 1, NULL },
+                { efXVG, "-dhdl", NULL, ffOPTWR, 1, NULL },
+                { efXVG, "-field", NULL, ffOPTWR, 1, NULL }
+            };
+            char        *fns[] = {
+                const_cast<char *>(fnTrr_.c_str()),
+                const_cast<char *>(fnXtc_.c_str()),
+                const_cast<char *>(fnEdr_.c_str()),
+                const_cast<char *>(fnCpt_.c_str()),
+                NULL, NULL
+            };
+            const int    nfile = sizeof(fnm)/sizeof(fnm[0]);
+            gmx_mdoutf_t of;
+            t_state      state;
+            rvec        *f;
+            int          i, step, mdof_flags;
+
+            for (i = 0; i < nfile; i++)
+            {
+                fnm[i].fns = &fns[i];
+            }
+
+            std::memset(&state, 0, sizeof(state));
+            init_state(&state, c_natoms, 0, 0, 0, 0);
+            state.flags = (1<<estLAMBDA) | (1<<estBOX) | (1<<estX) | (1<<estV);
+            snew(f, c_natoms);
+
+            of = init_mdoutf(NULL, nfile, fnm, 0, cr_, &ir_, &mtop_, NULL);
+            for (step = 0; step <= c_nsteps; step++)
+            {
+                mdof_flags = MDOF_X_COMPRESSED;
+                if (step % ir_.nstxout == 0)
+                {
+                    mdof_flags |= MDOF_X;
+                }
+                if (step % ir_.nstvout == 0)
+                {
+                    mdof_flags |= MDOF_V;
+                }
+                if (step % ir_.nstfout == 0)
+                {
+                    mdof_flags |= MDOF_F;
+                }
+                if (step == c_checkpoint)
+                {
+                    mdof_flags |= MDOF_CPT;
+                }
+                setFrame(&state, f, step);
+                mdoutf_write_to_trajectory_files(NULL, cr_, of, mdof_flags, &mtop_,
+                                                 step, 0.002*step,
+                                                 &state, &state, f, f);
+                /* MD continues with the same buffers */
+                setFrame(&state, f, -1);
+            }
+            done_mdoutf(of);
+
+            sfree(f);
+            done_state(&state);
+        }
+
+        gmx::test::TestFileManager fileManager_;
+        std::string                fnTrr_;
+        std::string                fnXtc_;
+        std::string                fnEdr_;
+        std::string                fnCpt_;
+        t_commrec                 *cr_;
+        t_inputrec                 ir_;
+        gmx_mtop_t                 mtop_;
+};
+
+TEST_F(TrajectoryWriterTest, AsyncWritesSameFiles)
+{
+    std::string ref[3], test[3];
+    time_t      start;
+    int         attempt;
+
+    /* The checkpoint contains the time of writing in seconds,
+     * so we retry when a second boundary is crossed.
+     */
+    for (attempt = 0; attempt < 3; attempt++)
+    {
+        std::remove(fnCpt_.c_str());
+        start = time(NULL);
+
+        setEnv("GMX_ASYNC_TRAJECTORY", NULL);
+        runSteps();
+        ref[0] = fileContents(fnTrr_);
+        ref[1] = fileContents(fnXtc_);
+        ref[2] = fileContents(fnCpt_);
+        std::remove(fnTrr_.c_str());
+        std::remove(fnXtc_.c_str());
+        std::remove(fnEdr_.c_str());
+        std::remove(fnCpt_.c_str());
+
+        /* A short queue, so the MD steps also wait for the writer */
+        setEnv("GMX_ASYNC_TRAJECTORY", "2");
+        runSteps();
+        test[0] = fileContents(fnTrr_);
+        test[1] = fileContents(fnXtc_);
+        test[2] = fileContents(fnCpt_);
+        std::remove(fnTrr_.c_str());
+        std::remove(fnXtc_.c_str());
+        std::remove(fnEdr_.c_str());
+
+        if (time(NULL) == start)
+        {
+            break;
+        }
+    }
+
+    ASSERT_FALSE(ref[0].empty());
+    ASSERT_FALSE(ref[1].empty());
+    ASSERT_FALSE(ref[2].empty());
+    EXPECT_TRUE(ref[0] == test[0]) << "trr output differs";
+    EXPECT_TRUE(ref[1] == test[1]) << "xtc output differs";
+    EXPECT_TRUE(ref[2] == test[2]) << "checkpoint differs";
+}
+
+} // namespace
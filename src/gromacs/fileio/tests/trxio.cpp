@@ -0,0 +1,274 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for reading xtc trajectories with prefetching.
+ *
+ * \ingroup module_fileio
+ */
+#include <cstdlib>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/trxio.h"
+#include "gromacs/fileio/xtcio.h"
+#include "gromacs/fileio/xtcprefetch.h"
+#include "gromacs/legacyheaders/oenv.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "testutils/testfilemanager.h"
+
+namespace
+{
+
+//! Sets or clears the number of threads for prefetching xtc frames.
+void setPrefetchEnv(const char *nthreads)
+{
+    // TODO fix this when we have an encapsulation layer for handling
+    // environment variables
+#ifdef GMX_NATIVE_WINDOWS
+    _putenv_s("GMX_XTC_PREFETCH", nthreads != NULL ? nthreads : "");
+#else
+    if (nthreads != NULL)
+    {
+        setenv("GMX_XTC_PREFETCH", nthreads, true);
+    }
+    else
+    {
+        unsetenv("GMX_XTC_PREFETCH");
+    }
+#endif
+}
+
+//! Number of atoms in the test trajectory.
+const int c_natoms  = 300;
+//! Number of frames in the test trajectory.
+const int c_nframes = 40;
+
+//! A frame as returned by the reading functions.
+struct ReadFrame
+{
+    //! Step.
+    gmx_int64_t       step;
+    //! Time.
+    real              time;
+    //! The coordinates.
+    std::vector<real> x;
+};
+
+class XtcPrefetchTest : public ::testing::Test
+{
+    public:
+        XtcPrefetchTest()
+            : fn_(fileManager_.getTemporaryFilePath(".xtc")), oenv_(NULL)
+        {
+            output_env_init_default(&oenv_);
+            writeFrames();
+        }
+        ~XtcPrefetchTest()
+        {
+            output_env_done(oenv_);
+            setPrefetchEnv(NULL);
+        }
+
+        //! Writes the test trajectory.
+        void writeFrames()
+        {
+            t_fileio *fio = open_xtc(fn_.c_str(), "w");
+            rvec     *x;
+            matrix    box = {{3, 0, 0}, {0, 3, 0}, {0, 0, 3}};
+
+            snew(x, c_natoms);
+            for (int i = 0; i < c_nframes; i++)
+            {
+                for (int a = 0; a < c_natoms; a++)
+                {
+                    x[a][XX] = 0.01*a + 0.01*i;
+                    x[a][YY] = 0.2*(a % 5) + 0.001*i*(a % 3);
+                    x[a][ZZ] = 0.3*(a % 7) - 0.02*i;
+                }
+                ASSERT_TRUE(write_xtc(fio, c_natoms, 10*i, 0.5*i, box, x, 1000));
+            }
+            sfree(x);
+            close_xtc(fio);
+        }
+
+        //! Reads all frames with read_first_frame/read_next_frame.
+        std::vector<ReadFrame> readFrames(bool *bIncomplete)
+        {
+            std::vector<ReadFrame> frames;
+            t_trxstatus           *status;
+            t_trxframe             fr;
+
+            *bIncomplete = false;
+            if (read_first_frame(oenv_, &status, fn_.c_str(), &fr, TRX_NEED_X))
+            {
+                do
+                {
+                    addFrame(fr, &frames);
+                }
+                while (read_next_frame(oenv_, status, &fr));
+                *bIncomplete = (fr.not_ok != 0);
+                close_trx(status);
+                sfree(fr.x);
+            }
+
+            return frames;
+        }
+
+        //! Appends the contents of \p fr to \p frames.
+        static void addFrame(const t_trxframe &fr, std::vector<ReadFrame> *frames)
+        {
+            ReadFrame frame;
+
+            frame.step = fr.step;
+            frame.time = fr.time;
+            for (int a = 0; a < fr.natoms; a++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    frame.x.push_back(fr.x[a][d]);
+                }
+            }
+            frames->push_back(frame);
+        }
+
+        //! Checks that two sets of frames are identical.
+        static void compareFrames(const std::vector<ReadFrame> &ref,
+                                  const std::vector<ReadFrame> &test)
+        {
+            ASSERT_EQ(ref.size(), test.size());
+            for (size_t i = 0; i < ref.size(); i++)
+            {
+                EXPECT_EQ(ref[i].step, test[i].step);
+                EXPECT_EQ(ref[i].time, test[i].time);
+                EXPECT_TRUE(ref[i].x == test[i].x) << "frame " << i;
+            }
+        }
+
+        gmx::test::TestFileManager fileManager_;
+        std::string                fn_;
+        output_env_t               oenv_;
+};
+
+TEST_F(XtcPrefetchTest, ReadsSameFramesAsDirectReading)
+{
+    bool bIncomplete;
+
+    setPrefetchEnv("0");
+    std::vector<ReadFrame> ref = readFrames(&bIncomplete);
+    EXPECT_FALSE(bIncomplete);
+    ASSERT_EQ(c_nframes, static_cast<int>(ref.size()));
+
+    const char *nthreads[] = { "1", "3" };
+    for (size_t i = 0; i < sizeof(nthreads)/sizeof(nthreads[0]); i++)
+    {
+        setPrefetchEnv(nthreads[i]);
+        std::vector<ReadFrame> test = readFrames(&bIncomplete);
+        EXPECT_FALSE(bIncomplete);
+        compareFrames(ref, test);
+    }
+}
+
+TEST_F(XtcPrefetchTest, ReportsIncompleteLastFrame)
+{
+    bool bIncomplete;
+
+    setPrefetchEnv("0");
+    std::vector<ReadFrame> ref = readFrames(&bIncomplete);
+    /* Cut the last frame in half */
+    std::string contents;
+    {
+        std::ifstream in(fn_.c_str(), std::ios::binary);
+        contents.assign(std::istreambuf_iterator<char>(in),
+                        std::istreambuf_iterator<char>());
+    }
+    {
+        std::ofstream out(fn_.c_str(), std::ios::binary | std::ios::trunc);
+        out.write(contents.data(), contents.size() - contents.size()/(2*c_nframes));
+    }
+
+    ref.pop_back();
+    std::vector<ReadFrame> direct = readFrames(&bIncomplete);
+    EXPECT_TRUE(bIncomplete);
+    compareFrames(ref, direct);
+
+    setPrefetchEnv("2");
+    std::vector<ReadFrame> test = readFrames(&bIncomplete);
+    EXPECT_TRUE(bIncomplete);
+    compareFrames(ref, test);
+}
+
+TEST_F(XtcPrefetchTest, ContinuesAfterDirectFileAccess)
+{
+    t_trxstatus *status;
+    t_trxframe   fr;
+    int          step;
+    real         time, prec;
+    matrix       box;
+    gmx_bool     bOK;
+
+    setPrefetchEnv("2");
+    ASSERT_TRUE(read_first_frame(oenv_, &status, fn_.c_str(), &fr, TRX_NEED_X));
+    for (int i = 1; i < 5; i++)
+    {
+        ASSERT_TRUE(read_next_frame(oenv_, status, &fr));
+        EXPECT_EQ(10*i, fr.step);
+    }
+    /* Direct reading continues with the next frame */
+    t_fileio *fio = trx_get_fileio(status);
+    ASSERT_TRUE(read_next_xtc(fio, fr.natoms, &step, &time, box, fr.x, &prec, &bOK));
+    EXPECT_EQ(50, step);
+    /* And so does prefetching */
+    ASSERT_TRUE(read_next_frame(oenv_, status, &fr));
+    EXPECT_EQ(60, fr.step);
+    close_trx(status);
+    sfree(fr.x);
+}
+
+TEST_F(XtcPrefetchTest, IsOffUnlessRequested)
+{
+    setPrefetchEnv(NULL);
+    EXPECT_EQ(0, xtc_prefetch_nthreads());
+    setPrefetchEnv("3");
+    EXPECT_EQ(3, xtc_prefetch_nthreads());
+}
+
+} // namespace
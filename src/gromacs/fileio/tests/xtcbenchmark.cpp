@@ -0,0 +1,175 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Throughput benchmark for the xtc coordinate compression.
+ *
+ * The frames are written to and read back from a temporary file, so the
+ * rates also include the file system; only the reported numbers are of
+ * interest and nothing is checked. Run e.g.
+ *
+ *     fileio-xtc-benchmark -natoms 100000 -nframes 50
+ *
+ * and compare the reported rates before and after changes to the coder.
+ *
+ * \ingroup module_fileio
+ */
+#include <cmath>
+#include <cstdio>
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/xtcio.h"
+#include "gromacs/options/basicoptions.h"
+#include "gromacs/options/options.h"
+#include "gromacs/timing/walltime_accounting.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "testutils/testfilemanager.h"
+#include "testutils/testoptions.h"
+
+namespace
+{
+
+//! Number of atoms per frame.
+int g_natoms  = 30000;
+//! Number of frames written and read.
+int g_nframes = 100;
+
+//! \cond
+GMX_TEST_OPTIONS(XtcBenchmarkOptions, options)
+{
+    options->addOption(::gmx::IntegerOption("natoms")
+                           .store(&g_natoms)
+                           .description("Number of atoms per frame"));
+    options->addOption(::gmx::IntegerOption("nframes")
+                           .store(&g_nframes)
+                           .description("Number of frames to write and read"));
+}
+//! \endcond
+
+//! Fills \p x with a water-like system in a cubic box of size \p boxSize.
+void generateWater(rvec *x, int natoms, real boxSize)
+{
+    unsigned int seed = 1;
+
+    for (int a = 0; a < natoms; a++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            seed = seed*1103515245u + 12345u;
+            real r = ((seed >> 8) & 0xffffff)/16777216.0;
+            if (a % 3 == 0)
+            {
+                x[a][d] = boxSize*r;
+            }
+            else
+            {
+                /* Hydrogens within 0.1 nm of their oxygen */
+                x[a][d] = x[a - a % 3][d] + 0.1*(r - 0.5);
+            }
+        }
+    }
+}
+
+//! Moves all atoms a little, so consecutive frames differ.
+void perturb(rvec *x, int natoms, int frame)
+{
+    for (int a = 0; a < natoms; a++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            x[a][d] += 0.001*(((a + d + frame) % 7) - 3);
+        }
+    }
+}
+
+TEST(XtcBenchmark, ReadWriteThroughput)
+{
+    gmx::test::TestFileManager fileManager;
+    std::string                fn     = fileManager.getTemporaryFilePath(".xtc");
+    /* Water density, about 100 atoms per nm^3 */
+    real                       boxSize = std::pow(g_natoms/100.0, 1.0/3.0);
+    matrix                     box     = {{boxSize, 0, 0}, {0, boxSize, 0}, {0, 0, boxSize}};
+    rvec                      *x;
+    double                     t0, tWrite, tRead;
+    double                     nbytesIn;
+
+    snew(x, g_natoms);
+    generateWater(x, g_natoms, boxSize);
+
+    t_fileio *fio = open_xtc(fn.c_str(), "w");
+    t0 = gmx_gettime();
+    for (int f = 0; f < g_nframes; f++)
+    {
+        perturb(x, g_natoms, f);
+        ASSERT_TRUE(write_xtc(fio, g_natoms, f, f, box, x, 1000));
+    }
+    close_xtc(fio);
+    tWrite = gmx_gettime() - t0;
+
+    int      natoms, step;
+    real     time, prec;
+    gmx_bool bOK;
+    rvec    *xr;
+    int      nread = 0;
+
+    fio = open_xtc(fn.c_str(), "r");
+    t0  = gmx_gettime();
+    ASSERT_TRUE(read_first_xtc(fio, &natoms, &step, &time, box, &xr, &prec, &bOK));
+    do
+    {
+        ASSERT_TRUE(bOK);
+        nread++;
+    }
+    while (read_next_xtc(fio, natoms, &step, &time, box, xr, &prec, &bOK));
+    tRead = gmx_gettime() - t0;
+    close_xtc(fio);
+    EXPECT_EQ(g_nframes, nread);
+
+    /* Rates are given in uncompressed coordinate data */
+    nbytesIn = static_cast<double>(g_nframes)*g_natoms*DIM*sizeof(float);
+    std::printf("xtc write: %d frames of %d atoms in %.3f s, %.1f MB/s\n",
+                g_nframes, g_natoms, tWrite, nbytesIn/tWrite*1e-6);
+    std::printf("xtc read:  %d frames of %d atoms in %.3f s, %.1f MB/s\n",
+                nread, g_natoms, tRead, nbytesIn/tRead*1e-6);
+
+    sfree(x);
+    sfree(xr);
+}
+
+} // namespace
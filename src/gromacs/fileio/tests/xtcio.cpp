@@ -0,0 +1,239 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the xtc frame index.
+ *
+ * \ingroup module_fileio
+ */
+#include <cstdio>
+#include <cstdlib>
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/fileio/xtcindex.h"
+#include "gromacs/fileio/xtcio.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "testutils/testfilemanager.h"
+
+namespace
+{
+
+//! Sets or clears the environment variable that enables writing the index.
+void setXtcIndexEnv(bool bWriteIndex)
+{
+    // TODO fix this when we have an encapsulation layer for handling
+    // environment variables
+#ifdef GMX_NATIVE_WINDOWS
+    _putenv_s("GMX_XTC_INDEX", bWriteIndex ? "1" : "");
+#else
+    if (bWriteIndex)
+    {
+        setenv("GMX_XTC_INDEX", "1", true);
+    }
+    else
+    {
+        unsetenv("GMX_XTC_INDEX");
+    }
+#endif
+}
+
+//! Step of frame \p i in the test trajectories.
+int frameStep(int i)
+{
+    return 10*i;
+}
+
+//! Time of frame \p i in the test trajectories.
+real frameTime(int i)
+{
+    return 0.5*i;
+}
+
+class XtcIndexTest : public ::testing::Test
+{
+    public:
+        XtcIndexTest()
+            : fn_(fileManager_.getTemporaryFilePath(".xtc")),
+              indexFn_(fileManager_.getTemporaryFilePath(std::string(".xtc") + XTC_INDEX_EXT))
+        {
+        }
+        ~XtcIndexTest()
+        {
+            setXtcIndexEnv(false);
+        }
+
+        /*! \brief Writes frames [first, last) with natoms atoms to fn
+         *
+         * With natoms > 9 the coordinates are compressed.
+         */
+        void writeFrames(const std::string &fn, const char *mode,
+                         int natoms, int first, int last)
+        {
+            t_fileio *fio = open_xtc(fn.c_str(), mode);
+            rvec     *x;
+            matrix    box = {{3, 0, 0}, {0, 3, 0}, {0, 0, 3}};
+
+            snew(x, natoms);
+            for (int i = first; i < last; i++)
+            {
+                for (int a = 0; a < natoms; a++)
+                {
+                    x[a][XX] = 0.1*a + 0.01*i;
+                    x[a][YY] = 0.2*(a % 5);
+                    x[a][ZZ] = 0.3*(a % 7) - 0.02*i;
+                }
+                ASSERT_TRUE(write_xtc(fio, natoms, frameStep(i), frameTime(i),
+                                      box, x, 1000));
+            }
+            sfree(x);
+            close_xtc(fio);
+        }
+
+        //! Seeks to time \p t and checks that the next frame is frame \p i
+        void checkSeekTime(t_fileio *fio, real t, int i)
+        {
+            int      natoms = 0, step;
+            real     time, prec;
+            matrix   box;
+            rvec    *x;
+            gmx_bool bOK;
+
+            ASSERT_TRUE(read_first_xtc(fio, &natoms, &step, &time, box, &x, &prec, &bOK));
+            ASSERT_EQ(0, xtc_seek_time(fio, t, natoms, FALSE));
+            ASSERT_TRUE(read_next_xtc(fio, natoms, &step, &time, box, x, &prec, &bOK));
+            EXPECT_EQ(frameStep(i), step);
+            EXPECT_FLOAT_EQ(frameTime(i), time);
+            sfree(x);
+        }
+
+        gmx::test::TestFileManager fileManager_;
+        std::string                fn_;
+        std::string                indexFn_;
+};
+
+TEST_F(XtcIndexTest, WritesIndexWhileWriting)
+{
+    setXtcIndexEnv(true);
+    writeFrames(fn_, "w", 20, 0, 12);
+
+    t_xtc_index *index = xtc_index_read(fn_.c_str());
+    t_xtc_index *built = xtc_index_build(fn_.c_str());
+    ASSERT_TRUE(index != NULL);
+    ASSERT_TRUE(built != NULL);
+    ASSERT_EQ(12, xtc_index_nframes(index));
+    ASSERT_EQ(12, xtc_index_nframes(built));
+    for (int i = 0; i < 12; i++)
+    {
+        gmx_off_t offset, builtOffset;
+        int       natoms, step;
+        real      time;
+
+        xtc_index_get_frame(built, i, &builtOffset, &natoms, &step, &time);
+        xtc_index_get_frame(index, i, &offset, &natoms, &step, &time);
+        EXPECT_EQ(builtOffset, offset);
+        EXPECT_EQ(20, natoms);
+        EXPECT_EQ(frameStep(i), step);
+        EXPECT_FLOAT_EQ(frameTime(i), time);
+    }
+    xtc_index_destroy(index);
+    xtc_index_destroy(built);
+}
+
+TEST_F(XtcIndexTest, AppendingExtendsIndex)
+{
+    setXtcIndexEnv(true);
+    writeFrames(fn_, "w", 20, 0, 5);
+    writeFrames(fn_, "a", 20, 5, 9);
+    /* Frames written without index are added when reading the index */
+    setXtcIndexEnv(false);
+    writeFrames(fn_, "a", 20, 9, 11);
+
+    t_xtc_index *index = xtc_index_read(fn_.c_str());
+    ASSERT_TRUE(index != NULL);
+    ASSERT_EQ(11, xtc_index_nframes(index));
+    for (int i = 0; i < 11; i++)
+    {
+        gmx_off_t offset;
+        int       natoms, step;
+        real      time;
+
+        xtc_index_get_frame(index, i, &offset, &natoms, &step, &time);
+        EXPECT_EQ(frameStep(i), step);
+    }
+    xtc_index_destroy(index);
+}
+
+TEST_F(XtcIndexTest, SeeksWithIndex)
+{
+    writeFrames(fn_, "w", 3, 0, 10);
+    t_xtc_index *index = xtc_index_build(fn_.c_str());
+    ASSERT_TRUE(index != NULL);
+    ASSERT_TRUE(xtc_index_write(index, fn_.c_str()));
+    xtc_index_destroy(index);
+
+    t_fileio *fio = open_xtc(fn_.c_str(), "r");
+    checkSeekTime(fio, 2.2, 5);
+    close_xtc(fio);
+
+    fio = open_xtc(fn_.c_str(), "r");
+    checkSeekTime(fio, 4.5, 9);
+    EXPECT_EQ(0, xtc_seek_frame(fio, frameStep(3), 3));
+    EXPECT_NE(0, xtc_seek_time(fio, 10, 3, FALSE));
+    close_xtc(fio);
+}
+
+TEST_F(XtcIndexTest, IgnoresMismatchingIndex)
+{
+    std::string otherFn = fileManager_.getTemporaryFilePath("other.xtc");
+
+    /* Write the index of a different trajectory for fn_ */
+    writeFrames(fn_, "w", 15, 0, 10);
+    writeFrames(otherFn, "w", 25, 0, 10);
+    t_xtc_index *index = xtc_index_build(otherFn.c_str());
+    ASSERT_TRUE(index != NULL);
+    ASSERT_TRUE(xtc_index_write(index, fn_.c_str()));
+    xtc_index_destroy(index);
+
+    t_fileio *fio = open_xtc(fn_.c_str(), "r");
+    checkSeekTime(fio, 2.2, 5);
+    close_xtc(fio);
+}
+
+} // namespace
@@ -98,6 +98,11 @@ do_md_trajectory_writing(FILE           *fplog,
     {
         mdof_flags |= MDOF_CPT;
     }
+    if (bLastStep && step_rel == ir->nsteps && bDoConfOut && !bRerunMD)
+    {
+        /* x and v are needed on the master for the final coordinates */
+        mdof_flags |= MDOF_CONFOUT;
+    }
     ;
 
 #if defined(GMX_FAHCORE) || defined(GMX_WRITELASTSTEP)
@@ -154,10 +159,7 @@ do_md_trajectory_writing(FILE           *fplog,
             bDoConfOut && MASTER(cr) &&
             !bRerunMD)
         {
-            /* x and v have been collected in mdoutf_write_to_trajectory_files,
-             * because a checkpoint file will always be written
-             * at the last step.
-             */
+            /* x and v have been collected in mdoutf_write_to_trajectory_files */
             fprintf(stderr, "\nWriting final coordinates.\n");
             if (fr->bMolPBC)
             {
@@ -58,6 +58,7 @@
 #include "gromacs/math/vec.h"
 #include "gromacs/utility/futil.h"
 #include "xtcio.h"
+#include "xtcprefetch.h"
 #include "pdbio.h"
 #include "confio.h"
 #include "checkpoint.h"
@@ -82,6 +83,8 @@ struct t_trxstatus
     double                  DT, BOX[3];
     gmx_bool                bReadBox;
     char                   *persistent_line; /* Persistent line for reading g96 trajectories */
+    t_xtc_prefetch         *xtc_prefetch;    /* Prefetching reader for xtc files */
+    gmx_bool                bXtcPrefetch;    /* Whether to prefetch xtc frames */
 };
 
 /* utility functions */
@@ -159,6 +162,18 @@ static void status_init(t_trxstatus *status)
     status->__frame         = -1;
     status->persistent_line = NULL;
     status->tng             = NULL;
+    status->xtc_prefetch    = NULL;
+    status->bXtcPrefetch    = FALSE;
+}
+
+/* Stops prefetching, so the file can be accessed directly */
+static void stop_prefetch(t_trxstatus *status)
+{
+    if (status->xtc_prefetch)
+    {
+        xtc_prefetch_destroy(status->xtc_prefetch);
+        status->xtc_prefetch = NULL;
+    }
 }
 
 
@@ -223,6 +238,9 @@ real ndec2prec(int ndec)
 
 t_fileio *trx_get_fileio(t_trxstatus *status)
 {
+    /* The caller might access the file directly */
+    stop_prefetch(status);
+
     return status->fio;
 }
 
@@ -613,6 +631,7 @@ int write_trx(t_trxstatus *status, int nind, const atom_id *ind, t_atoms *atoms,
 
 void close_trx(t_trxstatus *status)
 {
+    stop_prefetch(status);
     gmx_tng_close(&status->tng);
     if (status->fio)
     {
@@ -834,6 +853,7 @@ gmx_bool read_next_frame(const output_env_t oenv, t_trxstatus *status, t_trxfram
                  */
                 if (bTimeSet(TBEGIN) && (fr->time < rTimeValue(TBEGIN)))
                 {
+                    stop_prefetch(status);
                     if (xtc_seek_time(status->fio, rTimeValue(TBEGIN), fr->natoms, TRUE))
                     {
                         gmx_fatal(FARGS, "Specified frame (time %f) doesn't exist or file corrupt/inconsistent.",
@@ -841,8 +861,22 @@ gmx_bool read_next_frame(const output_env_t oenv, t_trxstatus *status, t_trxfram
                     }
                     initcount(status);
                 }
-                bRet = read_next_xtc(status->fio, fr->natoms, &fr->step, &fr->time, fr->box,
-                                     fr->x, &fr->prec, &bOK);
+                if (status->bXtcPrefetch && status->xtc_prefetch == NULL)
+                {
+                    status->xtc_prefetch = xtc_prefetch_init(status->fio, fr->natoms,
+                                                             xtc_prefetch_nthreads());
+                }
+                if (status->xtc_prefetch)
+                {
+                    bRet = xtc_prefetch_next(status->xtc_prefetch, fr->natoms,
+                                             &fr->step, &fr->time, fr->box,
+                                             fr->x, &fr->prec, &bOK);
+                }
+                else
+                {
+                    bRet = read_next_xtc(status->fio, fr->natoms, &fr->step, &fr->time, fr->box,
+                                         fr->x, &fr->prec, &bOK);
+                }
                 fr->bPrec = (bRet && fr->prec > 0);
                 fr->bStep = bRet;
                 fr->bTime = bRet;
@@ -992,6 +1026,8 @@ int read_first_frame(const output_env_t oenv, t_trxstatus **status,
                 fr->bX    = TRUE;
                 fr->bBox  = TRUE;
                 printcount(*status, oenv, fr->time, FALSE);
+                /* The following frames are decoded in parallel */
+                (*status)->bXtcPrefetch = (xtc_prefetch_nthreads() > 0);
             }
             bFirst = FALSE;
             break;
@@ -1099,6 +1135,7 @@ gmx_bool read_next_x(const output_env_t oenv, t_trxstatus *status, real *t,
 
 void close_trj(t_trxstatus *status)
 {
+    stop_prefetch(status);
     gmx_tng_close(&status->tng);
     if (status->fio)
     {
@@ -1114,6 +1151,7 @@ void close_trj(t_trxstatus *status)
 
 void rewind_trj(t_trxstatus *status)
 {
+    stop_prefetch(status);
     initcount(status);
 
     gmx_fio_rewind(status->fio);
@@ -64,6 +64,15 @@ struct t_fileio;
 /* Read or write reduced precision *float* coordinates */
 int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision);
 
+/* Read reduced precision *float* coordinates from nbytes bytes of xdr
+ * data in memory, as written by xdr3dfcoord. The arguments and checks
+ * are the same as for reading with xdr3dfcoord. Returns the number of
+ * bytes used, or 0 on error. Does not modify global state, so it can
+ * be called from multiple threads simultaneously.
+ */
+int xdr3dfcoord_from_buffer(const unsigned char *data, int nbytes,
+                            float *fp, int *size, float *precision);
+
 
 /* Read or write a *real* value (stored as float) */
 int xdr_real(XDR *xdrs, real *r);
@@ -0,0 +1,555 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "xtcindex.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "gromacs/math/vectypes.h"
+#include "gromacs/utility/fatalerror.h"
+#include "gromacs/utility/smalloc.h"
+
+/* The xtc frame magic number, as in xtcio.c */
+#define XTC_MAGIC         1995
+#define XTC_INDEX_MAGIC   0x58494458
+#define XTC_INDEX_VERSION 1
+/* The size in bytes of an XDR unit */
+#define XDR_UNIT_SIZE     4
+
+typedef struct {
+    gmx_off_t offset; /* file offset of the start of the frame */
+    int       natoms;
+    int       step;
+    float     time;   /* stored in single precision, as in the xtc file */
+} t_xtc_index_frame;
+
+struct t_xtc_index {
+    int                nframes;
+    int                nalloc;
+    t_xtc_index_frame *frame;
+    gmx_bool           bStepSorted; /* steps are non-decreasing */
+    gmx_bool           bTimeSorted; /* times are non-decreasing */
+    FILE              *fp;          /* the index file, when writing */
+    XDR                xdr;
+};
+
+/* Returns the index file name for xtc file fn, should be freed */
+static char *xtc_index_fn(const char *fn)
+{
+    char *ifn;
+
+    snew(ifn, strlen(fn) + strlen(XTC_INDEX_EXT) + 1);
+    sprintf(ifn, "%s%s", fn, XTC_INDEX_EXT);
+
+    return ifn;
+}
+
+static t_xtc_index *xtc_index_init(void)
+{
+    t_xtc_index *index;
+
+    snew(index, 1);
+    index->bStepSorted = TRUE;
+    index->bTimeSorted = TRUE;
+
+    return index;
+}
+
+static void xtc_index_push(t_xtc_index *index, gmx_off_t offset,
+                           int natoms, int step, float time)
+{
+    t_xtc_index_frame *fr;
+
+    if (index->nframes > 0)
+    {
+        fr = &index->frame[index->nframes - 1];
+        if (step < fr->step)
+        {
+            index->bStepSorted = FALSE;
+        }
+        if (time < fr->time)
+        {
+            index->bTimeSorted = FALSE;
+        }
+    }
+    if (index->nframes == index->nalloc)
+    {
+        index->nalloc = over_alloc_large(index->nframes + 1);
+        srenew(index->frame, index->nalloc);
+    }
+    fr         = &index->frame[index->nframes++];
+    fr->offset = offset;
+    fr->natoms = natoms;
+    fr->step   = step;
+    fr->time   = time;
+}
+
+static gmx_bool xdr_xtc_index_header(XDR *xd)
+{
+    int magic   = XTC_INDEX_MAGIC;
+    int version = XTC_INDEX_VERSION;
+
+    return (xdr_int(xd, &magic) && xdr_int(xd, &version) &&
+            magic == XTC_INDEX_MAGIC && version == XTC_INDEX_VERSION);
+}
+
+static gmx_bool xdr_xtc_index_frame(XDR *xd, t_xtc_index_frame *fr)
+{
+    gmx_int64_t offset = fr->offset;
+
+    if (!(xdr_int64(xd, &offset) &&
+          xdr_int(xd, &fr->natoms) &&
+          xdr_int(xd, &fr->step) &&
+          xdr_float(xd, &fr->time)))
+    {
+        return FALSE;
+    }
+    fr->offset = offset;
+
+    return TRUE;
+}
+
+/* Reads the header of the xtc frame at the current position of fp
+ * and skips the coordinates. Only the size of the compressed coordinates
+ * is read, the coordinates are not decompressed.
+ * Returns FALSE when there is no complete frame before fsize.
+ */
+static gmx_bool xtc_skip_frame(FILE *fp, XDR *xd, gmx_off_t fsize,
+                               int *natoms, int *step, float *time)
+{
+    int       magic, size, nbytes, i;
+    float     box;
+    gmx_off_t skip;
+
+    if (!(xdr_int(xd, &magic) && magic == XTC_MAGIC &&
+          xdr_int(xd, natoms) && xdr_int(xd, step) && xdr_float(xd, time)))
+    {
+        return FALSE;
+    }
+    for (i = 0; i < DIM*DIM; i++)
+    {
+        if (!xdr_float(xd, &box))
+        {
+            return FALSE;
+        }
+    }
+    if (!xdr_int(xd, &size) || size != *natoms)
+    {
+        return FALSE;
+    }
+    if (size <= 9)
+    {
+        /* Small frames are stored as uncompressed floats */
+        skip = size*DIM*XDR_UNIT_SIZE;
+    }
+    else
+    {
+        /* Skip precision, minint[3], maxint[3] and smallidx */
+        if (gmx_fseek(fp, 8*XDR_UNIT_SIZE, SEEK_CUR) != 0 ||
+            !xdr_int(xd, &nbytes) || nbytes < 0)
+        {
+            return FALSE;
+        }
+        skip = ((nbytes + XDR_UNIT_SIZE - 1)/XDR_UNIT_SIZE)*XDR_UNIT_SIZE;
+    }
+    /* Seeking beyond the end of the file succeeds, so check the position */
+    if (gmx_fseek(fp, skip, SEEK_CUR) != 0 || gmx_ftell(fp) > fsize)
+    {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Adds the complete frames in xtc file fn from offset start onwards
+ * to index. Returns FALSE when fn can not be read.
+ */
+static gmx_bool xtc_index_scan(t_xtc_index *index, const char *fn,
+                               gmx_off_t start)
+{
+    FILE      *fp;
+    XDR        xd;
+    gmx_off_t  fsize, offset;
+    int        natoms, step;
+    float      time;
+
+    if ((fp = fopen(fn, "rb")) == NULL)
+    {
+        return FALSE;
+    }
+    if (gmx_fseek(fp, 0, SEEK_END) != 0 ||
+        (fsize = gmx_ftell(fp)) < 0 ||
+        gmx_fseek(fp, start, SEEK_SET) != 0)
+    {
+        fclose(fp);
+        return FALSE;
+    }
+    xdrstdio_create(&xd, fp, XDR_DECODE);
+
+    offset = start;
+    while (offset < fsize &&
+           xtc_skip_frame(fp, &xd, fsize, &natoms, &step, &time))
+    {
+        xtc_index_push(index, offset, natoms, step, time);
+        offset = gmx_ftell(fp);
+    }
+
+    xdr_destroy(&xd);
+    fclose(fp);
+
+    return TRUE;
+}
+
+t_xtc_index *xtc_index_build(const char *fn)
+{
+    t_xtc_index *index;
+
+    index = xtc_index_init();
+    if (!xtc_index_scan(index, fn, 0))
+    {
+        xtc_index_destroy(index);
+        index = NULL;
+    }
+
+    return index;
+}
+
+t_xtc_index *xtc_index_read(const char *fn)
+{
+    t_xtc_index       *index;
+    t_xtc_index_frame  fr;
+    char              *ifn;
+    FILE              *fp;
+    XDR                xd;
+    gmx_off_t          fsize, start;
+    int                nkept;
+    gmx_bool           bOK;
+
+    ifn = xtc_index_fn(fn);
+    fp  = fopen(ifn, "rb");
+    sfree(ifn);
+    if (fp == NULL)
+    {
+        return NULL;
+    }
+    xdrstdio_create(&xd, fp, XDR_DECODE);
+    bOK   = xdr_xtc_index_header(&xd);
+    index = xtc_index_init();
+    /* Entries after an incompletely written entry are not trusted */
+    while (bOK && xdr_xtc_index_frame(&xd, &fr) &&
+           (index->nframes == 0 ||
+            fr.offset > index->frame[index->nframes - 1].offset))
+    {
+        xtc_index_push(index, fr.offset, fr.natoms, fr.step, fr.time);
+    }
+    xdr_destroy(&xd);
+    fclose(fp);
+
+    /* The trajectory might have been truncated or extended after
+     * writing the index. Remove the entries beyond the end of the file
+     * and rescan from the last remaining entry. This adds all frames
+     * after that entry and checks that the entry matches the file.
+     */
+    fsize = -1;
+    if (bOK && (fp = fopen(fn, "rb")) != NULL)
+    {
+        if (gmx_fseek(fp, 0, SEEK_END) == 0)
+        {
+            fsize = gmx_ftell(fp);
+        }
+        fclose(fp);
+    }
+    if (fsize < 0)
+    {
+        xtc_index_destroy(index);
+        return NULL;
+    }
+    while (index->nframes > 0 &&
+           index->frame[index->nframes - 1].offset >= fsize)
+    {
+        index->nframes--;
+    }
+    start = 0;
+    nkept = index->nframes - 1;
+    if (nkept >= 0)
+    {
+        index->nframes = nkept;
+        fr             = index->frame[nkept];
+        start          = fr.offset;
+    }
+    bOK = xtc_index_scan(index, fn, start);
+    if (bOK && nkept >= 0)
+    {
+        bOK = (index->frame[0].offset == 0 &&
+               index->nframes > nkept &&
+               index->frame[nkept].natoms == fr.natoms &&
+               index->frame[nkept].step == fr.step);
+    }
+    if (!bOK)
+    {
+        if (debug)
+        {
+            fprintf(debug, "The frame index of %s does not match the file\n", fn);
+        }
+        xtc_index_destroy(index);
+        return NULL;
+    }
+
+    return index;
+}
+
+/* Opens the index file for xtc file fn and writes the header and
+ * all frames in index. Returns FALSE on failure.
+ */
+static gmx_bool xtc_index_open_file(t_xtc_index *index, const char *fn)
+{
+    char    *ifn;
+    int      i;
+    gmx_bool bOK;
+
+    /* The index can be regenerated at any time, so we don't make backups */
+    ifn       = xtc_index_fn(fn);
+    index->fp = fopen(ifn, "wb");
+    sfree(ifn);
+    if (index->fp == NULL)
+    {
+        return FALSE;
+    }
+    xdrstdio_create(&index->xdr, index->fp, XDR_ENCODE);
+    bOK = xdr_xtc_index_header(&index->xdr);
+    for (i = 0; i < index->nframes && bOK; i++)
+    {
+        bOK = xdr_xtc_index_frame(&index->xdr, &index->frame[i]);
+    }
+
+    return (bOK && fflush(index->fp) == 0);
+}
+
+static void xtc_index_close_file(t_xtc_index *index)
+{
+    if (index->fp != NULL)
+    {
+        xdr_destroy(&index->xdr);
+        fclose(index->fp);
+        index->fp = NULL;
+    }
+}
+
+gmx_bool xtc_index_write(const t_xtc_index *index, const char *fn)
+{
+    t_xtc_index tmp;
+    gmx_bool    bOK;
+
+    /* Use a shallow copy, so we don't modify index */
+    tmp    = *index;
+    tmp.fp = NULL;
+    bOK    = xtc_index_open_file(&tmp, fn);
+    xtc_index_close_file(&tmp);
+
+    return bOK;
+}
+
+t_xtc_index *xtc_index_open_write(const char *fn)
+{
+    t_xtc_index *index;
+
+    /* When appending, use the existing index or build a new one */
+    index = xtc_index_read(fn);
+    if (index == NULL)
+    {
+        index = xtc_index_build(fn);
+    }
+    if (index == NULL)
+    {
+        index = xtc_index_init();
+    }
+    if (!xtc_index_open_file(index, fn))
+    {
+        xtc_index_destroy(index);
+        index = NULL;
+    }
+
+    return index;
+}
+
+void xtc_index_add_frame(t_xtc_index *index, gmx_off_t offset,
+                         int natoms, int step, real time)
+{
+    xtc_index_push(index, offset, natoms, step, time);
+
+    if (index->fp != NULL)
+    {
+        if (!xdr_xtc_index_frame(&index->xdr, &index->frame[index->nframes - 1]) ||
+            fflush(index->fp) != 0)
+        {
+            /* Stop writing, a partial index is handled when reading */
+            xtc_index_close_file(index);
+        }
+    }
+}
+
+int xtc_index_nframes(const t_xtc_index *index)
+{
+    return index->nframes;
+}
+
+void xtc_index_get_frame(const t_xtc_index *index, int frame,
+                         gmx_off_t *offset, int *natoms, int *step, real *time)
+{
+    const t_xtc_index_frame *fr = &index->frame[frame];
+
+    *offset = fr->offset;
+    *natoms = fr->natoms;
+    *step   = fr->step;
+    *time   = fr->time;
+}
+
+static double frame_offset(const t_xtc_index_frame *fr)
+{
+    return fr->offset;
+}
+
+static double frame_step(const t_xtc_index_frame *fr)
+{
+    return fr->step;
+}
+
+static double frame_time(const t_xtc_index_frame *fr)
+{
+    return fr->time;
+}
+
+/* Returns the first frame from start onwards with value >= target,
+ * bisects when the values are sorted.
+ */
+static int xtc_index_lower_bound(const t_xtc_index *index, int start,
+                                 double (*value)(const t_xtc_index_frame *),
+                                 double target, gmx_bool bSorted)
+{
+    int low, high, mid;
+
+    low  = start;
+    high = index->nframes;
+    if (bSorted)
+    {
+        while (low < high)
+        {
+            mid = low + (high - low)/2;
+            if (value(&index->frame[mid]) < target)
+            {
+                low = mid + 1;
+            }
+            else
+            {
+                high = mid;
+            }
+        }
+    }
+    else
+    {
+        while (low < high && value(&index->frame[low]) < target)
+        {
+            low++;
+        }
+    }
+
+    return low;
+}
+
+/* Positions fp at the start of frame, checks the frame header and
+ * restores the position pos on mismatch.
+ */
+static int xtc_index_seek(const t_xtc_index *index, FILE *fp, XDR *xdrs,
+                          int frame, gmx_off_t pos)
+{
+    const t_xtc_index_frame *fr;
+    int                      magic, natoms, step;
+
+    if (frame >= index->nframes)
+    {
+        return -1;
+    }
+    fr = &index->frame[frame];
+
+    if (gmx_fseek(fp, fr->offset, SEEK_SET) == 0 &&
+        xdr_int(xdrs, &magic) && magic == XTC_MAGIC &&
+        xdr_int(xdrs, &natoms) && natoms == fr->natoms &&
+        xdr_int(xdrs, &step) && step == fr->step &&
+        gmx_fseek(fp, fr->offset, SEEK_SET) == 0)
+    {
+        return 0;
+    }
+    gmx_fseek(fp, pos, SEEK_SET);
+
+    return XTC_INDEX_MISMATCH;
+}
+
+int xtc_index_seek_frame(const t_xtc_index *index, FILE *fp, XDR *xdrs,
+                         int frame)
+{
+    int i;
+
+    i = xtc_index_lower_bound(index, 0, frame_step, frame, index->bStepSorted);
+
+    return xtc_index_seek(index, fp, xdrs, i, gmx_ftell(fp));
+}
+
+int xtc_index_seek_time(const t_xtc_index *index, FILE *fp, XDR *xdrs,
+                        real time, gmx_bool bSeekForwardOnly)
+{
+    gmx_off_t pos;
+    int       start, i;
+
+    pos   = gmx_ftell(fp);
+    start = 0;
+    if (bSeekForwardOnly)
+    {
+        start = xtc_index_lower_bound(index, 0, frame_offset, pos, TRUE);
+    }
+    i = xtc_index_lower_bound(index, start, frame_time, time, index->bTimeSorted);
+
+    return xtc_index_seek(index, fp, xdrs, i, pos);
+}
+
+void xtc_index_destroy(t_xtc_index *index)
+{
+    xtc_index_close_file(index);
+    sfree(index->frame);
+    sfree(index);
+}
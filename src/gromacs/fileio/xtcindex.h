@@ -0,0 +1,126 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+#ifndef GMX_FILEIO_XTCINDEX_H
+#define GMX_FILEIO_XTCINDEX_H
+
+#include <stdio.h>
+
+#include "gromacs/fileio/xdrf.h"
+#include "gromacs/utility/basedefinitions.h"
+#include "gromacs/utility/futil.h"
+#include "gromacs/utility/real.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Frame index for xtc files.
+ *
+ * The index is stored in a sidecar file, which has the name of the xtc file
+ * with XTC_INDEX_EXT appended. It contains a header with a magic number
+ * and a version, followed by a fixed size entry for each frame with
+ * the file offset, step, time and number of atoms of the frame.
+ * Since the entries have fixed size, entries can be appended to the index
+ * while writing an xtc file.
+ *
+ * An index is never trusted blindly: entries beyond the end of the xtc file
+ * are discarded when reading the index, frames after the last indexed frame
+ * are added by scanning the frame headers and the frame header is checked
+ * each time the index is used for seeking.
+ */
+
+#define XTC_INDEX_EXT ".idx"
+
+/* Return value of the seek functions when the index does not match the file */
+#define XTC_INDEX_MISMATCH -3
+
+typedef struct t_xtc_index t_xtc_index;
+
+t_xtc_index *xtc_index_read(const char *fn);
+/* Reads the frame index of xtc file fn, returns NULL when there is
+ * no (usable) index file.
+ */
+
+t_xtc_index *xtc_index_build(const char *fn);
+/* Builds the frame index of xtc file fn by scanning all frame headers.
+ * Only the compressed coordinate sizes are read, so this is much faster
+ * than reading the frames. Returns NULL when fn can not be read.
+ */
+
+gmx_bool xtc_index_write(const t_xtc_index *index, const char *fn);
+/* Writes the index file for xtc file fn, returns FALSE on failure */
+
+t_xtc_index *xtc_index_open_write(const char *fn);
+/* Opens the index file of xtc file fn for writing while writing fn.
+ * When fn already contains frames, e.g. when appending,
+ * the existing index is updated to match these frames first.
+ */
+
+void xtc_index_add_frame(t_xtc_index *index, gmx_off_t offset,
+                         int natoms, int step, real time);
+/* Adds a frame to the index and, when opened with xtc_index_open_write,
+ * to the index file.
+ */
+
+int xtc_index_nframes(const t_xtc_index *index);
+/* Returns the number of frames in the index */
+
+void xtc_index_get_frame(const t_xtc_index *index, int frame,
+                         gmx_off_t *offset, int *natoms, int *step, real *time);
+/* Returns the properties of frame number frame (counting from 0) */
+
+int xtc_index_seek_frame(const t_xtc_index *index, FILE *fp, XDR *xdrs,
+                         int frame);
+/* Positions fp at the start of the first frame with step >= frame.
+ * Returns 0 on success, -1 when there is no such frame and
+ * XTC_INDEX_MISMATCH when the index does not match the file.
+ */
+
+int xtc_index_seek_time(const t_xtc_index *index, FILE *fp, XDR *xdrs,
+                        real time, gmx_bool bSeekForwardOnly);
+/* Positions fp at the start of the first frame with time >= time,
+ * when bSeekForwardOnly only considers frames at or after the current
+ * position of fp. Returns as xtc_index_seek_frame.
+ */
+
+void xtc_index_destroy(t_xtc_index *index);
+/* Closes the index file, when open, and frees index */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
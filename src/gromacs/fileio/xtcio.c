@@ -217,6 +217,8 @@ int write_xtc(t_fileio *fio,
         return 1;
     }
 
+    gmx_fio_add_xtc_index_frame(fio, natoms, step, time);
+
     xd = gmx_fio_getxdr(fio);
     /* write magic number and xtc identidier */
     if (xtc_header(xd, &magic_number, &natoms, &step, &time, FALSE, &bDum) == 0)
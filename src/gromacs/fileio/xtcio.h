@@ -70,7 +70,10 @@ int read_next_xtc(t_fileio *fio,
 int write_xtc(t_fileio *fio,
               int natoms, int step, real time,
               matrix box, rvec *x, real prec);
-/* Write a frame to xtc file */
+/* Write a frame to xtc file.
+ * When the environment variable GMX_XTC_INDEX is set, a frame index
+ * is written to a sidecar file as well, see xtcindex.h.
+ */
 
 int xtc_check(const char *str, gmx_bool bResult, const char *file, int line);
 #define XTC_CHECK(s, b) xtc_check(s, b, __FILE__, __LINE__)
@@ -0,0 +1,458 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "xtcprefetch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "thread_mpi/threads.h"
+
+#include "gromacs/fileio/xdrf.h"
+#include "gromacs/utility/fatalerror.h"
+#include "gromacs/utility/futil.h"
+#include "gromacs/utility/smalloc.h"
+
+/* The xtc frame magic number, as in xtcio.c */
+#define XTC_MAGIC         1995
+/* The size in bytes of an XDR unit */
+#define XDR_UNIT_SIZE     4
+/* Size of the frame header plus box plus number of coordinates */
+#define XTC_HEADER_SIZE   ((4 + DIM*DIM + 1)*XDR_UNIT_SIZE)
+/* Size of the compression parameters following the header */
+#define XTC_PARAMS_SIZE   (9*XDR_UNIT_SIZE)
+
+/* The status of a prefetched frame */
+enum {
+    epfOK, epfEOF, epfINCOMPLETE, epfMAGIC
+};
+
+typedef struct {
+    int            status;
+    gmx_off_t      offset;     /* file offset of the start of the frame */
+    int            magic;
+    gmx_bool       bHeader;    /* the header below has been read */
+    int            natoms;
+    int            step;
+    float          time;
+    float          box[DIM*DIM];
+    unsigned char *raw;        /* the xdr data of the coordinates */
+    int            nraw;
+    int            nraw_alloc;
+    float         *x;          /* the decoded coordinates */
+    int            nx;         /* the number of decoded atoms */
+    int            nx_alloc;
+    float          prec;
+    gmx_bool       bOK;        /* decoding succeeded */
+    gmx_bool       bDecoded;
+} t_xtc_prefetch_frame;
+
+struct t_xtc_prefetch {
+    t_fileio             *fio;
+    FILE                 *fp;
+    int                   natoms;      /* the number of atoms expected */
+    gmx_off_t             read_offset; /* file offset of the next frame to read */
+
+    int                   nframe;      /* size of the ring of frames */
+    t_xtc_prefetch_frame *frame;
+    /* Frame counters, frame i is stored in frame[i % nframe] */
+    int                   nread;       /* number of frames read */
+    int                   ndecode;     /* number of frames taken for decoding */
+    int                   nreturned;   /* number of frames returned */
+    gmx_bool              bEnd;        /* the reader reached the last frame */
+    gmx_bool              bStop;       /* the threads should stop */
+
+    tMPI_Thread_mutex_t   mutex;
+    tMPI_Thread_cond_t    cond;
+    int                   nthreads;
+    tMPI_Thread_t        *threads;     /* the reader and decoding threads */
+};
+
+/* Returns the big-endian (xdr) 32-bit value stored at buf */
+static unsigned int get_xdr_uint(const unsigned char *buf)
+{
+    return ((unsigned int)buf[0] << 24) | ((unsigned int)buf[1] << 16) |
+           ((unsigned int)buf[2] << 8) | buf[3];
+}
+
+static float get_xdr_float(const unsigned char *buf)
+{
+    union
+    {
+        unsigned int i;
+        float        f;
+    } conv;
+
+    conv.i = get_xdr_uint(buf);
+
+    return conv.f;
+}
+
+/* Reads the raw data of the frame at the current position of pf->fp.
+ * Only the sizes of the data are interpreted, the decompression
+ * is left to the decoding threads.
+ */
+static void read_raw_frame(t_xtc_prefetch *pf, t_xtc_prefetch_frame *fr)
+{
+    unsigned char header[XTC_HEADER_SIZE];
+    size_t        n;
+    int           i, ncoord, nbytes;
+
+    fr->offset  = pf->read_offset;
+    fr->nraw    = 0;
+    fr->bHeader = FALSE;
+
+    n = fread(header, 1, XTC_HEADER_SIZE, pf->fp);
+    if (n < XDR_UNIT_SIZE)
+    {
+        /* Not even a magic number, this is the end of the file */
+        fr->status = epfEOF;
+        return;
+    }
+    fr->magic = get_xdr_uint(header);
+    if (fr->magic != XTC_MAGIC)
+    {
+        fr->status = epfMAGIC;
+        return;
+    }
+    if (n < XTC_HEADER_SIZE)
+    {
+        fr->status = epfINCOMPLETE;
+        return;
+    }
+    fr->natoms = get_xdr_uint(header + XDR_UNIT_SIZE);
+    fr->step   = get_xdr_uint(header + 2*XDR_UNIT_SIZE);
+    fr->time   = get_xdr_float(header + 3*XDR_UNIT_SIZE);
+    for (i = 0; i < DIM*DIM; i++)
+    {
+        fr->box[i] = get_xdr_float(header + (4 + i)*XDR_UNIT_SIZE);
+    }
+    fr->bHeader = TRUE;
+
+    /* The coordinate data starts with the number of coordinates */
+    ncoord = get_xdr_uint(header + (4 + DIM*DIM)*XDR_UNIT_SIZE);
+    if (ncoord < 0 || ncoord > fr->natoms)
+    {
+        fr->status = epfINCOMPLETE;
+        return;
+    }
+    if (XDR_UNIT_SIZE + XTC_PARAMS_SIZE > fr->nraw_alloc)
+    {
+        fr->nraw_alloc = XDR_UNIT_SIZE + XTC_PARAMS_SIZE;
+        srenew(fr->raw, fr->nraw_alloc);
+    }
+    memcpy(fr->raw, header + (4 + DIM*DIM)*XDR_UNIT_SIZE, XDR_UNIT_SIZE);
+    fr->nraw = XDR_UNIT_SIZE;
+
+    if (ncoord <= 9)
+    {
+        /* Few coordinates are stored uncompressed */
+        nbytes = ncoord*DIM*XDR_UNIT_SIZE;
+    }
+    else
+    {
+        if (fread(fr->raw + fr->nraw, 1, XTC_PARAMS_SIZE, pf->fp) != XTC_PARAMS_SIZE)
+        {
+            fr->status = epfINCOMPLETE;
+            return;
+        }
+        fr->nraw += XTC_PARAMS_SIZE;
+        nbytes    = get_xdr_uint(fr->raw + fr->nraw - XDR_UNIT_SIZE);
+        /* Limit the size as xdr3dfcoord does, to not allocate garbage sizes */
+        if (nbytes < 0 || nbytes > 1.2*ncoord*DIM*XDR_UNIT_SIZE)
+        {
+            fr->status = epfINCOMPLETE;
+            return;
+        }
+        /* xdr pads opaque data to a multiple of 4 bytes */
+        nbytes = ((nbytes + XDR_UNIT_SIZE - 1)/XDR_UNIT_SIZE)*XDR_UNIT_SIZE;
+    }
+    if (fr->nraw + nbytes > fr->nraw_alloc)
+    {
+        fr->nraw_alloc = fr->nraw + nbytes;
+        srenew(fr->raw, fr->nraw_alloc);
+    }
+    if (fread(fr->raw + fr->nraw, 1, nbytes, pf->fp) != (size_t)nbytes)
+    {
+        fr->status = epfINCOMPLETE;
+        return;
+    }
+    fr->nraw        += nbytes;
+    pf->read_offset += XTC_HEADER_SIZE + fr->nraw - XDR_UNIT_SIZE;
+    fr->status       = epfOK;
+}
+
+/* Decompresses the coordinates of a frame read by read_raw_frame */
+static void decode_frame(t_xtc_prefetch *pf, t_xtc_prefetch_frame *fr)
+{
+    fr->bOK = FALSE;
+    if (fr->status != epfOK)
+    {
+        return;
+    }
+    if (fr->natoms*DIM > fr->nx_alloc)
+    {
+        fr->nx_alloc = fr->natoms*DIM;
+        srenew(fr->x, fr->nx_alloc);
+    }
+    fr->nx  = pf->natoms;
+    fr->bOK = (xdr3dfcoord_from_buffer(fr->raw, fr->nraw, fr->x, &fr->nx, &fr->prec) > 0);
+}
+
+static void *reader_thread(void *arg)
+{
+    t_xtc_prefetch       *pf = (t_xtc_prefetch *)arg;
+    t_xtc_prefetch_frame *fr;
+
+    tMPI_Thread_mutex_lock(&pf->mutex);
+    while (!pf->bStop && !pf->bEnd)
+    {
+        if (pf->nread - pf->nreturned >= pf->nframe)
+        {
+            /* All buffers are in use, wait for a frame to be returned */
+            tMPI_Thread_cond_wait(&pf->cond, &pf->mutex);
+            continue;
+        }
+        fr = &pf->frame[pf->nread % pf->nframe];
+        tMPI_Thread_mutex_unlock(&pf->mutex);
+
+        read_raw_frame(pf, fr);
+
+        tMPI_Thread_mutex_lock(&pf->mutex);
+        fr->bDecoded = FALSE;
+        pf->nread++;
+        pf->bEnd     = (fr->status != epfOK);
+        tMPI_Thread_cond_broadcast(&pf->cond);
+    }
+    tMPI_Thread_mutex_unlock(&pf->mutex);
+
+    return NULL;
+}
+
+static void *decoder_thread(void *arg)
+{
+    t_xtc_prefetch       *pf = (t_xtc_prefetch *)arg;
+    t_xtc_prefetch_frame *fr;
+
+    tMPI_Thread_mutex_lock(&pf->mutex);
+    while (!pf->bStop && !(pf->bEnd && pf->ndecode == pf->nread))
+    {
+        if (pf->ndecode == pf->nread)
+        {
+            tMPI_Thread_cond_wait(&pf->cond, &pf->mutex);
+            continue;
+        }
+        fr = &pf->frame[pf->ndecode % pf->nframe];
+        pf->ndecode++;
+        tMPI_Thread_mutex_unlock(&pf->mutex);
+
+        decode_frame(pf, fr);
+
+        tMPI_Thread_mutex_lock(&pf->mutex);
+        fr->bDecoded = TRUE;
+        tMPI_Thread_cond_broadcast(&pf->cond);
+    }
+    tMPI_Thread_mutex_unlock(&pf->mutex);
+
+    return NULL;
+}
+
+int xtc_prefetch_nthreads(void)
+{
+    const char *env;
+    int         nthreads;
+
+    /* Prefetching is only done on request, since the callers, e.g. mdrun
+     * and the OpenMP parallel analysis tools, use all cores themselves.
+     */
+    env = getenv("GMX_XTC_PREFETCH");
+    if (env == NULL)
+    {
+        return 0;
+    }
+    nthreads = strtol(env, NULL, 10);
+
+    return (nthreads > 0 ? nthreads : 0);
+}
+
+t_xtc_prefetch *xtc_prefetch_init(t_fileio *fio, int natoms, int nthreads)
+{
+    t_xtc_prefetch *pf;
+    int             i;
+
+    snew(pf, 1);
+    pf->fio         = fio;
+    pf->fp          = gmx_fio_getfp(fio);
+    pf->natoms      = natoms;
+    pf->read_offset = gmx_ftell(pf->fp);
+    /* Enough frames to keep all threads busy while the caller
+     * processes a frame.
+     */
+    pf->nframe      = 2*nthreads + 1;
+    snew(pf->frame, pf->nframe);
+
+    tMPI_Thread_mutex_init(&pf->mutex);
+    tMPI_Thread_cond_init(&pf->cond);
+    pf->nthreads = 1 + nthreads;
+    snew(pf->threads, pf->nthreads);
+    for (i = 0; i < pf->nthreads; i++)
+    {
+        if (tMPI_Thread_create(&pf->threads[i],
+                               i == 0 ? reader_thread : decoder_thread, pf) != 0)
+        {
+            gmx_fatal(FARGS, "Could not create a thread for reading %s",
+                      gmx_fio_getname(fio));
+        }
+    }
+    if (debug)
+    {
+        fprintf(debug, "Prefetching xtc frames of %s with %d decoding threads\n",
+                gmx_fio_getname(fio), nthreads);
+    }
+
+    return pf;
+}
+
+int xtc_prefetch_next(t_xtc_prefetch *pf,
+                      int natoms, int *step, real *time,
+                      matrix box, rvec *x, real *prec, gmx_bool *bOK)
+{
+    t_xtc_prefetch_frame *fr;
+    int                   i, d;
+
+    tMPI_Thread_mutex_lock(&pf->mutex);
+    fr = &pf->frame[pf->nreturned % pf->nframe];
+    while (pf->nreturned >= pf->nread || !fr->bDecoded)
+    {
+        tMPI_Thread_cond_wait(&pf->cond, &pf->mutex);
+    }
+    tMPI_Thread_mutex_unlock(&pf->mutex);
+
+    /* Report the same errors as read_next_xtc */
+    *bOK = TRUE;
+    switch (fr->status)
+    {
+        case epfEOF:
+            return 0;
+        case epfINCOMPLETE:
+            /* read_next_xtc returns the header of an incomplete frame */
+            if (fr->bHeader)
+            {
+                *step = fr->step;
+                *time = fr->time;
+            }
+            *bOK = FALSE;
+            return 0;
+        case epfMAGIC:
+            gmx_fatal(FARGS, "Magic Number Error in XTC file (read %d, should be %d)",
+                      fr->magic, XTC_MAGIC);
+            break;
+    }
+    if (fr->natoms > natoms)
+    {
+        gmx_fatal(FARGS, "Frame contains more atoms (%d) than expected (%d)",
+                  fr->natoms, natoms);
+    }
+    *step = fr->step;
+    *time = fr->time;
+    for (i = 0; i < DIM; i++)
+    {
+        for (d = 0; d < DIM; d++)
+        {
+            box[i][d] = fr->box[i*DIM + d];
+        }
+    }
+    *bOK = fr->bOK;
+    if (!fr->bOK)
+    {
+        return 0;
+    }
+    for (i = 0; i < fr->nx; i++)
+    {
+        for (d = 0; d < DIM; d++)
+        {
+            x[i][d] = fr->x[i*DIM + d];
+        }
+    }
+    *prec = fr->prec;
+
+    tMPI_Thread_mutex_lock(&pf->mutex);
+    pf->nreturned++;
+    tMPI_Thread_cond_broadcast(&pf->cond);
+    tMPI_Thread_mutex_unlock(&pf->mutex);
+
+    return 1;
+}
+
+void xtc_prefetch_destroy(t_xtc_prefetch *pf)
+{
+    gmx_off_t offset;
+    int       i;
+
+    tMPI_Thread_mutex_lock(&pf->mutex);
+    pf->bStop = TRUE;
+    tMPI_Thread_cond_broadcast(&pf->cond);
+    tMPI_Thread_mutex_unlock(&pf->mutex);
+    for (i = 0; i < pf->nthreads; i++)
+    {
+        tMPI_Thread_join(pf->threads[i], NULL);
+    }
+
+    /* Continue after the last returned frame */
+    if (pf->nreturned < pf->nread)
+    {
+        offset = pf->frame[pf->nreturned % pf->nframe].offset;
+    }
+    else
+    {
+        offset = pf->read_offset;
+    }
+    gmx_fseek(pf->fp, offset, SEEK_SET);
+
+    for (i = 0; i < pf->nframe; i++)
+    {
+        sfree(pf->frame[i].raw);
+        sfree(pf->frame[i].x);
+    }
+    sfree(pf->frame);
+    sfree(pf->threads);
+    tMPI_Thread_cond_destroy(&pf->cond);
+    tMPI_Thread_mutex_destroy(&pf->mutex);
+    sfree(pf);
+}
@@ -0,0 +1,88 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+#ifndef GMX_FILEIO_XTCPREFETCH_H
+#define GMX_FILEIO_XTCPREFETCH_H
+
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/utility/basedefinitions.h"
+#include "gromacs/utility/real.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Prefetching reader for xtc files.
+ *
+ * A reader thread reads the raw data of the next frames ahead into a ring
+ * of buffers, while a pool of threads decompresses the coordinates of
+ * several frames concurrently. The frames are returned in file order by
+ * xtc_prefetch_next, which has the same semantics as read_next_xtc.
+ *
+ * While prefetching, the file pointer of fio is owned by the reader thread.
+ * Call xtc_prefetch_destroy before using fio directly, which leaves
+ * the file positioned at the first frame not returned yet.
+ */
+
+typedef struct t_xtc_prefetch t_xtc_prefetch;
+
+int xtc_prefetch_nthreads(void);
+/* Returns the number of decoding threads to use for prefetching, 0 means
+ * no prefetching. Prefetching is off by default and is turned on by
+ * setting the environment variable GMX_XTC_PREFETCH to the number of
+ * decoding threads.
+ */
+
+t_xtc_prefetch *xtc_prefetch_init(t_fileio *fio, int natoms, int nthreads);
+/* Starts prefetching frames with natoms atoms from the current position
+ * of fio, using nthreads decoding threads.
+ */
+
+int xtc_prefetch_next(t_xtc_prefetch *pf,
+                      int natoms, int *step, real *time,
+                      matrix box, rvec *x, real *prec, gmx_bool *bOK);
+/* Returns the next frame, as read_next_xtc */
+
+void xtc_prefetch_destroy(t_xtc_prefetch *pf);
+/* Stops the threads, positions the file at the first frame not returned
+ * by xtc_prefetch_next and frees pf.
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
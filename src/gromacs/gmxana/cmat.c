@@ -39,11 +39,22 @@
 #endif
 
 #include "cmat.h"
+
+#include <errno.h>
+#include <stdio.h>
+
+#if defined HAVE_SYS_MMAN_H && defined HAVE_UNISTD_H
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 #include "gromacs/utility/smalloc.h"
 #include "macros.h"
 #include "gromacs/math/vec.h"
 #include "gromacs/fileio/xvgr.h"
 #include "gromacs/fileio/matio.h"
+#include "gromacs/utility/cstringutil.h"
+#include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/futil.h"
 
 t_mat *init_mat(int n1, gmx_bool b1D)
@@ -66,6 +77,62 @@ t_mat *init_mat(int n1, gmx_bool b1D)
     return m;
 }
 
+t_mat *init_mat_mapped(int n1, const char *fn)
+{
+#if defined HAVE_SYS_MMAN_H && defined HAVE_UNISTD_H
+    t_mat *m;
+    FILE  *fp;
+    void  *map;
+    size_t size;
+    int    i;
+
+    size = (size_t)n1*(size_t)n1*sizeof(real);
+    fp   = gmx_ffopen(fn, "w+");
+    /* ftruncate fills the file with zeros without writing them */
+    if (ftruncate(fileno(fp), (off_t)size) != 0)
+    {
+        gmx_fatal(errno, __FILE__, __LINE__,
+                  "Could not extend %s to %g MB for the matrix",
+                  fn, size/(1024.0*1024.0));
+    }
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fileno(fp), 0);
+    if (map == MAP_FAILED)
+    {
+        gmx_fatal(errno, __FILE__, __LINE__,
+                  "Could not memory map %s", fn);
+    }
+    /* The mapping stays valid after closing the file */
+    gmx_ffclose(fp);
+
+    snew(m, 1);
+    m->n1      = n1;
+    m->nn      = 0;
+    m->b1D     = TRUE;
+    m->maxrms  = 0;
+    m->minrms  = 1e20;
+    m->sumrms  = 0;
+    m->map     = (real *)map;
+    m->mapsize = size;
+    m->mapfn   = gmx_strdup(fn);
+    snew(m->mat, n1);
+    for (i = 0; (i < n1); i++)
+    {
+        m->mat[i] = m->map + (size_t)i*n1;
+    }
+
+    snew(m->erow, n1);
+    snew(m->m_ind, n1);
+    reset_index(m);
+
+    return m;
+#else
+    gmx_fatal(FARGS, "Cannot store the matrix in %s, "
+              "memory mapping is not supported on this platform", fn);
+
+    return NULL;
+#endif
+}
+
 void copy_t_mat(t_mat *dst, t_mat *src)
 {
     int i, j;
@@ -139,7 +206,25 @@ void set_mat_entry(t_mat *m, int i, int j, real val)
 
 void done_mat(t_mat **m)
 {
-    done_matrix((*m)->n1, &((*m)->mat));
+    if ((*m)->map != NULL)
+    {
+#if defined HAVE_SYS_MMAN_H && defined HAVE_UNISTD_H
+        munmap((*m)->map, (*m)->mapsize);
+#endif
+        remove((*m)->mapfn);
+        sfree((*m)->mapfn);
+        sfree((*m)->mat);
+    }
+    else if ((*m)->b1D)
+    {
+        /* All rows point into the first one */
+        sfree((*m)->mat[0]);
+        sfree((*m)->mat);
+    }
+    else
+    {
+        done_matrix((*m)->n1, &((*m)->mat));
+    }
     sfree((*m)->m_ind);
     sfree((*m)->erow);
     sfree(*m);
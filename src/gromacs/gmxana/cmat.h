@@ -56,6 +56,9 @@ typedef struct {
     real     minrms, maxrms, sumrms;
     real    *erow;
     real   **mat;
+    real    *map;     /* Start of the memory-mapped storage, or NULL */
+    size_t   mapsize; /* Size of the mapping in bytes */
+    char    *mapfn;   /* Name of the file backing the mapping */
 } t_mat;
 
 /* The matrix is indexed using the matrix index */
@@ -63,6 +66,13 @@ typedef struct {
 
 extern t_mat *init_mat(int n1, gmx_bool b1D);
 
+/* Initiates an n1 x n1 matrix stored contiguously in file fn, which is
+ * memory mapped, so the matrix can be larger than the available memory.
+ * The file is removed by done_mat. Gives a fatal error when memory
+ * mapping is not supported.
+ */
+extern t_mat *init_mat_mapped(int n1, const char *fn);
+
 extern void copy_t_mat(t_mat *dst, t_mat *src);
 
 extern void enlarge_mat(t_mat *m, int deltan);
@@ -66,6 +66,7 @@
 #include "gromacs/linearalgebra/eigensolver.h"
 #include "gromacs/math/do_fit.h"
 #include "gromacs/utility/fatalerror.h"
+#include "gromacs/utility/gmxomp.h"
 
 /* print to two file pointers at once (i.e. stderr and log) */
 static gmx_inline
@@ -502,9 +503,9 @@ static void jarvis_patrick(int n1, real **mat, int M, int P,
     t_dist     *row;
     t_clustid  *c;
     int       **nnb;
-    int         i, j, k, cid, diff, max;
+    int       **link;
+    int         i, j, k, l, cid, diff, max;
     gmx_bool    bChange;
-    real      **mcpy = NULL;
 
     if (rmsdcut < 0)
     {
@@ -580,14 +581,29 @@ static void jarvis_patrick(int n1, real **mat, int M, int P,
 
     c = new_clustid(n1);
     fprintf(stderr, "Linking structures ");
-    /* Use mcpy for temporary storage of booleans */
-    mcpy = mk_matrix(n1, n1, FALSE);
+    /* Store the links j > i, as -1 terminated lists. Since linked
+     * structures are in each other's neighbor lists, these are short
+     * and we do not need an n1 x n1 matrix of booleans.
+     */
+    snew(link, n1);
     for (i = 0; i < n1; i++)
     {
-        for (j = i+1; j < n1; j++)
+        k = 0;
+        while (nnb[i][k] >= 0)
+        {
+            k++;
+        }
+        snew(link[i], k+1);
+        l = 0;
+        for (k = 0; nnb[i][k] >= 0; k++)
         {
-            mcpy[i][j] = jp_same(nnb, i, j, P);
+            j = nnb[i][k];
+            if (j > i && jp_same(nnb, i, j, P))
+            {
+                link[i][l++] = j;
+            }
         }
+        link[i][l] = -1;
     }
     do
     {
@@ -595,22 +611,20 @@ static void jarvis_patrick(int n1, real **mat, int M, int P,
         bChange = FALSE;
         for (i = 0; i < n1; i++)
         {
-            for (j = i+1; j < n1; j++)
+            for (l = 0; link[i][l] >= 0; l++)
             {
-                if (mcpy[i][j])
+                j    = link[i][l];
+                diff = c[j].clust - c[i].clust;
+                if (diff)
                 {
-                    diff = c[j].clust - c[i].clust;
-                    if (diff)
+                    bChange = TRUE;
+                    if (diff > 0)
                     {
-                        bChange = TRUE;
-                        if (diff > 0)
-                        {
-                            c[j].clust = c[i].clust;
-                        }
-                        else
-                        {
-                            c[i].clust = c[j].clust;
-                        }
+                        c[j].clust = c[i].clust;
+                    }
+                    else
+                    {
+                        c[i].clust = c[j].clust;
                     }
                 }
             }
@@ -660,14 +674,14 @@ static void jarvis_patrick(int n1, real **mat, int M, int P,
 /*     for(j=0; (j<n1); j++) */
 /*       mat[i][j] = mcpy[i][j]; */
 /*   } */
-    done_matrix(n1, &mcpy);
-
     sfree(c);
     for (i = 0; (i < n1); i++)
     {
         sfree(nnb[i]);
+        sfree(link[i]);
     }
     sfree(nnb);
+    sfree(link);
 }
 
 static void dump_nnb (FILE *fp, const char *title, int n1, t_nnb *nnb)
@@ -842,6 +856,71 @@ rvec **read_whole_trj(const char *fn, int isize, atom_id index[], int skip,
     return xx;
 }
 
+/* The number of frames per block in calc_rmsd_matrix */
+#define RMSD_BLOCK_SIZE 32
+
+/* Computes the RMS deviation between all pairs of frames, after fitting
+ * when bFit is set. The matrix is computed in blocks of frames, such that
+ * the coordinates of two blocks are reused from cache. Each block row
+ * is distributed over the OpenMP threads.
+ */
+static void calc_rmsd_matrix(int nf, int isize, rvec **xx, real *mass,
+                             gmx_bool bFit, t_mat *rms)
+{
+    int         nblock, bi, bj, i1, i2;
+    gmx_int64_t nrms;
+
+    nrms   = ((gmx_int64_t)nf*((gmx_int64_t)nf-1))/2;
+    nblock = (nf + RMSD_BLOCK_SIZE - 1)/RMSD_BLOCK_SIZE;
+    for (bi = 0; bi < nblock; bi++)
+    {
+        int i1start = bi*RMSD_BLOCK_SIZE;
+        int i1end   = min(i1start + RMSD_BLOCK_SIZE, nf);
+
+#pragma omp parallel for schedule(dynamic, 1) private(i1, i2)
+        for (bj = bi; bj < nblock; bj++)
+        {
+            int  i2end = min((bj + 1)*RMSD_BLOCK_SIZE, nf);
+            real rmsd;
+
+            for (i1 = i1start; i1 < i1end; i1++)
+            {
+                for (i2 = max(i1 + 1, bj*RMSD_BLOCK_SIZE); i2 < i2end; i2++)
+                {
+                    /* The frames are centered, so we can compute
+                     * the RMSD after fitting without rotating.
+                     */
+                    if (bFit)
+                    {
+                        rmsd = rmsdev_fit(isize, mass, xx[i2], xx[i1]);
+                    }
+                    else
+                    {
+                        rmsd = rmsdev(isize, mass, xx[i2], xx[i1]);
+                    }
+                    rms->mat[i1][i2] = rmsd;
+                    rms->mat[i2][i1] = rmsd;
+                }
+            }
+        }
+
+        for (i1 = i1start; i1 < i1end; i1++)
+        {
+            nrms -= (gmx_int64_t) (nf-i1-1);
+        }
+        fprintf(stderr, "\r# RMSD calculations left: " "%"GMX_PRId64 "   ", nrms);
+    }
+
+    /* Set the entries serially, to get the same statistics as before */
+    for (i1 = 0; i1 < nf; i1++)
+    {
+        for (i2 = i1+1; i2 < nf; i2++)
+        {
+            set_mat_entry(rms, i1, i2, rms->mat[i1][i2]);
+        }
+    }
+}
+
 static int plot_clusters(int nf, real **mat, t_clusters *clust,
                          int minstruct)
 {
@@ -1341,7 +1420,9 @@ int gmx_cluster(int argc, char *argv[])
         "Distances between structures can be determined from a trajectory",
         "or read from an [TT].xpm[tt] matrix file with the [TT]-dm[tt] option.",
         "RMS deviation after fitting or RMS deviation of atom-pair distances",
-        "can be used to define the distance between structures.[PAR]",
+        "can be used to define the distance between structures.",
+        "The RMS deviation after fitting is computed from the optimal",
+        "rotation without rotating the structures, using multiple threads.[PAR]",
 
         "single linkage: add a structure to a cluster when its distance to any",
         "element of the cluster is less than [TT]cutoff[tt].[PAR]",
@@ -1405,7 +1486,13 @@ int gmx_cluster(int argc, char *argv[])
         "for a selected set of clusters (with option [TT]-wcl[tt], depends on",
         "[TT]-nst[tt] and [TT]-rmsmin[tt]). The center of a cluster is the",
         "structure with the smallest average RMSD from all other structures",
-        "of the cluster.[BR]",
+        "of the cluster.[PAR]",
+
+        "With [TT]-mmap[tt] the RMSD matrix is stored in the given scratch",
+        "file and accessed through memory mapping, so the number of",
+        "structures is not limited by the available memory. This is only",
+        "supported for the jarvis-patrick and gromos methods, which do not",
+        "copy the matrix. The file is removed at the end."
     };
 
     FILE              *fp, *log;
@@ -1413,7 +1500,7 @@ int gmx_cluster(int argc, char *argv[])
     gmx_int64_t        nrms = 0;
 
     matrix             box;
-    rvec              *xtps, *usextps, *x1, **xx = NULL;
+    rvec              *xtps, *usextps, **xx = NULL;
     const char        *fn, *trx_out_fn;
     t_clusters         clust;
     t_mat             *rms, *orig = NULL;
@@ -1427,9 +1514,9 @@ int gmx_cluster(int argc, char *argv[])
     int                isize = 0, ifsize = 0, iosize = 0;
     atom_id           *index = NULL, *fitidx, *outidx;
     char              *grpname;
-    real               rmsd, **d1, **d2, *time = NULL, time_invfac, *mass = NULL;
+    real             **d1, **d2, *time = NULL, time_invfac, *mass = NULL;
     char               buf[STRLEN], buf1[80], title[STRLEN];
-    gmx_bool           bAnalyze, bUseRmsdCut, bJP_RMSD = FALSE, bReadMat, bReadTraj, bPBC = TRUE;
+    gmx_bool           bAnalyze, bUseRmsdCut, bJP_RMSD = FALSE, bReadMat, bReadTraj, bMapMat, bPBC = TRUE;
 
     int                method, ncluster = 0;
     static const char *methodname[] = {
@@ -1451,6 +1538,7 @@ int gmx_cluster(int argc, char *argv[])
     static int   niter    = 10000, nrandom = 0, seed = 1993, write_ncl = 0, write_nst = 1, minstruct = 1;
     static real  kT       = 1e-3;
     static int   M        = 10, P = 3;
+    static int   nthreads = 0;
     output_env_t oenv;
     gmx_rmpbc_t  gpbc = NULL;
 
@@ -1497,7 +1585,11 @@ int gmx_cluster(int argc, char *argv[])
           "Boltzmann weighting factor for Monte Carlo optimization "
           "(zero turns off uphill steps)" },
         { "-pbc", FALSE, etBOOL,
-          { &bPBC }, "PBC check" }
+          { &bPBC }, "PBC check" },
+#ifdef GMX_OPENMP
+        { "-nt",    FALSE, etINT,  {&nthreads},
+          "Number of threads to start for computing the RMSD matrix" },
+#endif
     };
     t_filenm     fnm[] = {
         { efTRX, "-f",     NULL,        ffOPTRD },
@@ -1514,10 +1606,13 @@ int gmx_cluster(int argc, char *argv[])
         { efXPM, "-tr",   "clust-trans", ffOPTWR},
         { efXVG, "-ntr",  "clust-trans", ffOPTWR},
         { efXVG, "-clid", "clust-id.xvg", ffOPTWR},
-        { efTRX, "-cl",   "clusters.pdb", ffOPTWR }
+        { efTRX, "-cl",   "clusters.pdb", ffOPTWR },
+        { efDAT, "-mmap", "rmsd-matrix", ffOPTWR }
     };
 #define NFILE asize(fnm)
 
+    nthreads = gmx_omp_get_max_threads();
+
     if (!parse_common_args(&argc, argv,
                            PCA_CAN_VIEW | PCA_CAN_TIME | PCA_TIME_UNIT | PCA_BE_NICE,
                            NFILE, fnm, asize(pa), pa, asize(desc), desc, 0, NULL,
@@ -1526,6 +1621,8 @@ int gmx_cluster(int argc, char *argv[])
         return 0;
     }
 
+    gmx_omp_set_num_threads(nthreads);
+
     /* parse options */
     bReadMat   = opt2bSet("-dm", NFILE, fnm);
     bReadTraj  = opt2bSet("-f", NFILE, fnm) || !bReadMat;
@@ -1566,6 +1663,12 @@ int gmx_cluster(int argc, char *argv[])
 
     bAnalyze = (method == m_linkage || method == m_jarvis_patrick ||
                 method == m_gromos );
+    bMapMat  = opt2bSet("-mmap", NFILE, fnm);
+    if (bMapMat && method != m_jarvis_patrick && method != m_gromos)
+    {
+        gmx_fatal(FARGS, "Option -mmap is only supported with the "
+                  "jarvis-patrick and gromos methods");
+    }
 
     /* Open log file */
     log = ftp2FILE(efLOG, NFILE, fnm, "w");
@@ -1737,39 +1840,33 @@ int gmx_cluster(int argc, char *argv[])
             time[i] *= time_invfac;
         }
 
-        rms = init_mat(readmat[0].nx, method == m_diagonalize);
+        if (bMapMat)
+        {
+            rms = init_mat_mapped(readmat[0].nx, opt2fn("-mmap", NFILE, fnm));
+        }
+        else
+        {
+            rms = init_mat(readmat[0].nx, method == m_diagonalize);
+        }
         convert_mat(&(readmat[0]), rms);
 
         nlevels = readmat[0].nmap;
     }
     else   /* !bReadMat */
     {
-        rms  = init_mat(nf, method == m_diagonalize);
+        if (bMapMat)
+        {
+            rms = init_mat_mapped(nf, opt2fn("-mmap", NFILE, fnm));
+        }
+        else
+        {
+            rms = init_mat(nf, method == m_diagonalize);
+        }
         nrms = ((gmx_int64_t)nf*((gmx_int64_t)nf-1))/2;
         if (!bRMSdist)
         {
             fprintf(stderr, "Computing %dx%d RMS deviation matrix\n", nf, nf);
-            /* Initialize work array */
-            snew(x1, isize);
-            for (i1 = 0; i1 < nf; i1++)
-            {
-                for (i2 = i1+1; i2 < nf; i2++)
-                {
-                    for (i = 0; i < isize; i++)
-                    {
-                        copy_rvec(xx[i1][i], x1[i]);
-                    }
-                    if (bFit)
-                    {
-                        do_fit(isize, mass, xx[i2], x1);
-                    }
-                    rmsd = rmsdev(isize, mass, xx[i2], x1);
-                    set_mat_entry(rms, i1, i2, rmsd);
-                }
-                nrms -= (gmx_int64_t) (nf-i1-1);
-                fprintf(stderr, "\r# RMSD calculations left: " "%"GMX_PRId64 "   ", nrms);
-            }
-            sfree(x1);
+            calc_rmsd_matrix(nf, isize, xx, mass, bFit, rms);
         }
         else /* bRMSdist */
         {
@@ -1982,6 +2079,7 @@ int gmx_cluster(int argc, char *argv[])
         done_mat(&orig);
         sfree(orig);
     }
+    done_mat(&rms);
     /* now show what we've done */
     do_view(oenv, opt2fn("-o", NFILE, fnm), "-nxy");
     do_view(oenv, opt2fn_null("-sz", NFILE, fnm), "-nxy");
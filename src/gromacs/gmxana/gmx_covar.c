@@ -67,6 +67,42 @@
 #include "gromacs/linearalgebra/eigensolver.h"
 #include "gromacs/math/do_fit.h"
 #include "gromacs/utility/fatalerror.h"
+#include "gromacs/utility/gmxomp.h"
+
+/* The number of frames collected before updating the covariance matrix */
+#define COVAR_FRAME_BLOCK 32
+
+/* Adds the outer products of the nx deviation vectors of length ndim,
+ * stored consecutively in xblock, to the upper triangle of the ndim*ndim
+ * matrix mat. Compared to adding the frames one by one, this rank-nx
+ * update reads and writes each row of the large matrix only once per
+ * block of frames. The elements are summed in the same order, so
+ * the result is identical.
+ */
+static void add_covar_block(gmx_int64_t ndim, int nx, const real *xblock,
+                            real *mat)
+{
+    gmx_int64_t j;
+
+#pragma omp parallel for schedule(dynamic, 16)
+    for (j = 0; j < ndim; j++)
+    {
+        real       *matj = mat + ndim*j;
+        gmx_int64_t i;
+        int         f;
+
+        for (f = 0; f < nx; f++)
+        {
+            const real *xf = xblock + ndim*f;
+            real        xj = xf[j];
+
+            for (i = j; i < ndim; i++)
+            {
+                matj[i] += xj*xf[i];
+            }
+        }
+    }
+}
 
 int gmx_covar(int argc, char *argv[])
 {
@@ -101,10 +137,20 @@ int gmx_covar(int argc, char *argv[])
         "of atoms involved. It is easy to run out of memory, in which",
         "case this tool will probably exit with a 'Segmentation fault'. You",
         "should consider carefully whether a reduced set of atoms will meet",
-        "your needs for lower costs."
+        "your needs for lower costs.",
+        "[PAR]",
+        "With option [TT]-partial[tt] only the largest eigenvalues and",
+        "eigenvectors up to [TT]-last[tt] are determined, with an iterative",
+        "Lanczos (ARPACK) solver. This only needs products of the covariance",
+        "matrix with vectors, which for large matrices is much faster",
+        "and needs less memory than the full diagonalization.",
+        "The covariance matrix construction and the iterative solver",
+        "use multiple threads."
     };
     static gmx_bool bFit = TRUE, bRef = FALSE, bM = FALSE, bPBC = TRUE;
-    static int      end  = -1;
+    static gmx_bool bPartial = FALSE;
+    static int      end      = -1;
+    static int      nthreads = 0;
     t_pargs         pa[] = {
         { "-fit",  FALSE, etBOOL, {&bFit},
           "Fit to a reference structure"},
@@ -115,7 +161,13 @@ int gmx_covar(int argc, char *argv[])
         { "-last",  FALSE, etINT, {&end},
           "Last eigenvector to write away (-1 is till the last)" },
         { "-pbc",  FALSE,  etBOOL, {&bPBC},
-          "Apply corrections for periodic boundary conditions" }
+          "Apply corrections for periodic boundary conditions" },
+        { "-partial", FALSE, etBOOL, {&bPartial},
+          "Only compute the eigenvectors up to [TT]-last[tt] with an iterative solver" },
+#ifdef GMX_OPENMP
+        { "-nt",   FALSE, etINT, {&nthreads},
+          "Number of threads to start" },
+#endif
     };
     FILE           *out;
     t_trxstatus    *status;
@@ -123,21 +175,21 @@ int gmx_covar(int argc, char *argv[])
     t_topology      top;
     int             ePBC;
     t_atoms        *atoms;
-    rvec           *x, *xread, *xref, *xav, *xproj;
+    rvec           *x, *xread, *xref, *xav, *xproj, *xblock, *xf;
     matrix          box, zerobox;
     real           *sqrtm, *mat, *eigenvalues, sum, trace, inv_nframes;
     real            t, tstart, tend, **mat2;
-    real            xj, *w_rls = NULL;
-    real            min, max, *axis;
+    real           *w_rls = NULL;
+    real            min, max, swap, *axis;
     int             ntopatoms, step;
-    int             natoms, nat, count, nframes0, nframes, nlevels;
-    gmx_int64_t     ndim, i, j, k, l;
+    int             natoms, nat, nframes0, nframes, nblock, nlevels;
+    gmx_int64_t     ndim, i, j, k;
     int             WriteXref;
     const char     *fitfile, *trxfile, *ndxfile;
     const char     *eigvalfile, *eigvecfile, *averfile, *logfile;
     const char     *asciifile, *xpmfile, *xpmafile;
     char            str[STRLEN], *fitname, *ananame, *pcwd;
-    int             d, dj, nfit;
+    int             d, dj, nfit, neig;
     atom_id        *index, *ifit;
     gmx_bool        bDiffMass1, bDiffMass2;
     time_t          now;
@@ -161,12 +213,16 @@ int gmx_covar(int argc, char *argv[])
     };
 #define NFILE asize(fnm)
 
+    nthreads = gmx_omp_get_max_threads();
+
     if (!parse_common_args(&argc, argv, PCA_CAN_TIME | PCA_TIME_UNIT | PCA_BE_NICE,
                            NFILE, fnm, asize(pa), pa, asize(desc), desc, 0, NULL, &oenv))
     {
         return 0;
     }
 
+    gmx_omp_set_num_threads(nthreads);
+
     clear_mat(zerobox);
 
     fitfile    = ftp2fn(efTPS, NFILE, fnm);
@@ -313,6 +369,8 @@ int gmx_covar(int argc, char *argv[])
     sfree(xread);
 
     fprintf(stderr, "Constructing covariance matrix (%dx%d) ...\n", (int)ndim, (int)ndim);
+    snew(xblock, natoms*COVAR_FRAME_BLOCK);
+    nblock  = 0;
     nframes = 0;
     nat     = read_first_x(oenv, &status, trxfile, &t, &xread, box);
     tstart  = t;
@@ -330,41 +388,38 @@ int gmx_covar(int argc, char *argv[])
             reset_x(nfit, ifit, nat, NULL, xread, w_rls);
             do_fit(nat, w_rls, xref, xread);
         }
+        /* store the deviation in the next slot of the frame block */
+        xf = xblock + natoms*nblock;
         if (bRef)
         {
             for (i = 0; i < natoms; i++)
             {
-                rvec_sub(xread[index[i]], xref[index[i]], x[i]);
+                rvec_sub(xread[index[i]], xref[index[i]], xf[i]);
             }
         }
         else
         {
             for (i = 0; i < natoms; i++)
             {
-                rvec_sub(xread[index[i]], xav[i], x[i]);
+                rvec_sub(xread[index[i]], xav[i], xf[i]);
             }
         }
 
-        for (j = 0; j < natoms; j++)
+        nblock++;
+        if (nblock == COVAR_FRAME_BLOCK)
         {
-            for (dj = 0; dj < DIM; dj++)
-            {
-                k  = ndim*(DIM*j+dj);
-                xj = x[j][dj];
-                for (i = j; i < natoms; i++)
-                {
-                    l = k+DIM*i;
-                    for (d = 0; d < DIM; d++)
-                    {
-                        mat[l+d] += x[i][d]*xj;
-                    }
-                }
-            }
+            add_covar_block(ndim, nblock, xblock[0], mat);
+            nblock = 0;
         }
     }
     while (read_next_x(oenv, status, &t, xread, box) &&
            (bRef || nframes < nframes0));
     close_trj(status);
+    if (nblock > 0)
+    {
+        add_covar_block(ndim, nblock, xblock[0], mat);
+    }
+    sfree(xblock);
     gmx_rmpbc_done(gpbc);
 
     fprintf(stderr, "Read %d frames\n", nframes);
@@ -521,29 +576,86 @@ int gmx_covar(int argc, char *argv[])
     }
 
 
+    if (end == -1)
+    {
+        if (nframes-1 < ndim)
+        {
+            end = nframes-1;
+            fprintf(stderr, "\nWARNING: there are fewer frames in your trajectory than there are\n");
+            fprintf(stderr, "degrees of freedom in your system. Only generating the first\n");
+            fprintf(stderr, "%d out of %d eigenvectors and eigenvalues.\n", end, (int)ndim);
+        }
+        else
+        {
+            end = ndim;
+        }
+    }
+    if (bPartial && (end <= 0 || end >= ndim))
+    {
+        fprintf(stderr, "\nNote: -partial needs -last to be smaller than the number of degrees\n"
+                "      of freedom (%d), diagonalizing the full matrix\n", (int)ndim);
+        bPartial = FALSE;
+    }
+
     /* call diagonalization routine */
 
     snew(eigenvalues, ndim);
-    snew(eigenvectors, ndim*ndim);
+    if (bPartial)
+    {
+        neig = end;
+        snew(eigenvectors, ndim*neig);
+        fprintf(stderr, "\nDetermining the %d largest eigenvalues ...\n", neig);
+        fflush(stderr);
+        dense_partial_eigensolver(mat, ndim, neig, eigenvalues, eigenvectors, 100000);
 
-    memcpy(eigenvectors, mat, ndim*ndim*sizeof(real));
-    fprintf(stderr, "\nDiagonalizing ...\n");
-    fflush(stderr);
-    eigensolver(eigenvectors, ndim, 0, ndim, eigenvalues, mat);
-    sfree(eigenvectors);
+        /* the solver returns ascending order, put the largest first */
+        for (i = 0; i < neig/2; i++)
+        {
+            k = neig-1-i;
+            swap           = eigenvalues[i];
+            eigenvalues[i] = eigenvalues[k];
+            eigenvalues[k] = swap;
+            for (j = 0; j < ndim; j++)
+            {
+                swap                   = eigenvectors[ndim*i+j];
+                eigenvectors[ndim*i+j] = eigenvectors[ndim*k+j];
+                eigenvectors[ndim*k+j] = swap;
+            }
+        }
+    }
+    else
+    {
+        neig = ndim;
+        snew(eigenvectors, ndim*ndim);
+
+        memcpy(eigenvectors, mat, ndim*ndim*sizeof(real));
+        fprintf(stderr, "\nDiagonalizing ...\n");
+        fflush(stderr);
+        eigensolver(eigenvectors, ndim, 0, ndim, eigenvalues, mat);
+        sfree(eigenvectors);
+        eigenvectors = NULL;
+    }
 
     /* now write the output */
 
     sum = 0;
-    for (i = 0; i < ndim; i++)
+    for (i = 0; i < neig; i++)
     {
         sum += eigenvalues[i];
     }
-    fprintf(stderr, "\nSum of the eigenvalues: %g (%snm^2)\n",
-            sum, bM ? "u " : "");
-    if (fabs(trace-sum) > 0.01*trace)
+    if (bPartial)
     {
-        fprintf(stderr, "\nWARNING: eigenvalue sum deviates from the trace of the covariance matrix\n");
+        fprintf(stderr, "\nSum of the %d largest eigenvalues: %g (%snm^2)\n",
+                neig, sum, bM ? "u " : "");
+    }
+    else
+    {
+        fprintf(stderr, "\nSum of the eigenvalues: %g (%snm^2)\n",
+                sum, bM ? "u " : "");
+        if (fabs(trace-sum) > 0.01*trace)
+        {
+            fprintf(stderr, "\nWARNING: eigenvalue sum deviates from the trace of the covariance matrix\n");
+        }
     }
 
     fprintf(stderr, "\nWriting eigenvalues to %s\n", eigvalfile);
@@ -554,24 +666,11 @@ int gmx_covar(int argc, char *argv[])
                    "Eigenvector index", str, oenv);
     for (i = 0; (i < end); i++)
     {
-        fprintf (out, "%10d %g\n", (int)i+1, eigenvalues[ndim-1-i]);
+        fprintf (out, "%10d %g\n", (int)i+1,
+                 bPartial ? eigenvalues[i] : eigenvalues[ndim-1-i]);
     }
     gmx_ffclose(out);
 
-    if (end == -1)
-    {
-        if (nframes-1 < ndim)
-        {
-            end = nframes-1;
-            fprintf(out, "WARNING: there are fewer frames in your trajectory than there are\n");
-            fprintf(out, "degrees of freedom in your system. Only generating the first\n");
-            fprintf(out, "%d out of %d eigenvectors and eigenvalues.\n", end, (int)ndim);
-        }
-        else
-        {
-            end = ndim;
-        }
-    }
     if (bFit)
     {
         /* misuse lambda: 0/1 mass weighted analysis no/yes */
@@ -594,8 +693,11 @@ int gmx_covar(int argc, char *argv[])
         WriteXref = eWXR_NOFIT;
     }
 
-    write_eigenvectors(eigvecfile, natoms, mat, TRUE, 1, end,
+    /* the full diagonalization returns the eigenvectors in mat, ascending */
+    write_eigenvectors(eigvecfile, natoms, bPartial ? eigenvectors : mat,
+                       !bPartial, 1, end,
                        WriteXref, x, bDiffMass1, xproj, bM, eigenvalues);
+    sfree(eigenvectors);
 
     out = gmx_ffopen(logfile, "w");
 
@@ -634,11 +736,21 @@ int gmx_covar(int argc, char *argv[])
     {
         fprintf(out, "Fit is %smass weighted\n", bDiffMass1 ? "" : "non-");
     }
-    fprintf(out, "Diagonalized the %dx%d covariance matrix\n", (int)ndim, (int)ndim);
-    fprintf(out, "Trace of the covariance matrix before diagonalizing: %g\n",
-            trace);
-    fprintf(out, "Trace of the covariance matrix after diagonalizing: %g\n\n",
-            sum);
+    if (bPartial)
+    {
+        fprintf(out, "Determined the %d largest eigenvalues of the %dx%d covariance matrix\n",
+                neig, (int)ndim, (int)ndim);
+        fprintf(out, "Trace of the covariance matrix: %g\n", trace);
+        fprintf(out, "Sum of the %d largest eigenvalues: %g\n\n", neig, sum);
+    }
+    else
+    {
+        fprintf(out, "Diagonalized the %dx%d covariance matrix\n", (int)ndim, (int)ndim);
+        fprintf(out, "Trace of the covariance matrix before diagonalizing: %g\n",
+                trace);
+        fprintf(out, "Trace of the covariance matrix after diagonalizing: %g\n\n",
+                sum);
+    }
 
     fprintf(out, "Wrote %d eigenvalues to %s\n", (int)end, eigvalfile);
     if (WriteXref == eWXR_YES)
@@ -42,6 +42,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+
 #include "typedefs.h"
 #include "gromacs/utility/smalloc.h"
 #include "macros.h"
@@ -55,6 +57,9 @@
 #include "gromacs/fileio/tpxio.h"
 #include "gromacs/fileio/trxio.h"
 #include "gromacs/pbcutil/rmpbc.h"
+#include "gromacs/selection/nbsearch.h"
+#include "gromacs/utility/exceptions.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gmx_ana.h"
 
 
@@ -62,11 +67,13 @@ static void periodic_dist(matrix box, rvec x[], int n, atom_id index[],
                           real *rmin, real *rmax, int *min_ind)
 {
 #define NSHIFT 26
-    int  sx, sy, sz, i, j, s;
-    real sqr_box, r2min, r2max, r2;
-    rvec shift[NSHIFT], d0, d;
+    int   sx, sy, sz, i, s, nthreads, th, thmin;
+    real  sqr_box, r2min, r2max;
+    rvec  shift[NSHIFT];
+    real *r2min_t, *r2max_t;
+    int  *imin_t, *jmin_t;
 
-    sqr_box = sqr(min(norm(box[XX]), min(norm(box[YY]), norm(box[ZZ]))));
+    sqr_box = sqr(std::min(norm(box[XX]), std::min(norm(box[YY]), norm(box[ZZ]))));
 
     s = 0;
     for (sz = -1; sz <= 1; sz++)
@@ -87,33 +94,80 @@ static void periodic_dist(matrix box, rvec x[], int n, atom_id index[],
         }
     }
 
-    r2min = sqr_box;
-    r2max = 0;
+    nthreads = gmx_omp_get_max_threads();
+    snew(r2min_t, nthreads);
+    snew(r2max_t, nthreads);
+    snew(imin_t, nthreads);
+    snew(jmin_t, nthreads);
 
-    for (i = 0; i < n; i++)
+#pragma omp parallel num_threads(nthreads)
     {
-        for (j = i+1; j < n; j++)
+        int  th    = gmx_omp_get_thread_num();
+        real r2min = sqr_box;
+        real r2max = 0;
+        int  imin  = -1;
+        int  jmin  = -1;
+
+        /* The loop is triangular, so we need dynamic scheduling */
+#pragma omp for schedule(dynamic, 16)
+        for (int i = 0; i < n; i++)
         {
-            rvec_sub(x[index[i]], x[index[j]], d0);
-            r2 = norm2(d0);
-            if (r2 > r2max)
-            {
-                r2max = r2;
-            }
-            for (s = 0; s < NSHIFT; s++)
+            for (int j = i+1; j < n; j++)
             {
-                rvec_add(d0, shift[s], d);
-                r2 = norm2(d);
-                if (r2 < r2min)
+                rvec d0, d;
+                real r2;
+
+                rvec_sub(x[index[i]], x[index[j]], d0);
+                r2 = norm2(d0);
+                if (r2 > r2max)
+                {
+                    r2max = r2;
+                }
+                for (int k = 0; k < NSHIFT; k++)
                 {
-                    r2min      = r2;
-                    min_ind[0] = i;
-                    min_ind[1] = j;
+                    rvec_add(d0, shift[k], d);
+                    r2 = norm2(d);
+                    if (r2 < r2min)
+                    {
+                        r2min = r2;
+                        imin  = i;
+                        jmin  = j;
+                    }
                 }
             }
         }
+
+        r2min_t[th] = r2min;
+        r2max_t[th] = r2max;
+        imin_t[th]  = imin;
+        jmin_t[th]  = jmin;
     }
 
+    /* Reduce over the threads, giving the same pair as a serial loop */
+    r2min = sqr_box;
+    r2max = 0;
+    thmin = -1;
+    for (th = 0; th < nthreads; th++)
+    {
+        r2max = std::max(r2max, r2max_t[th]);
+        if (imin_t[th] >= 0 &&
+            (thmin < 0 || r2min_t[th] < r2min ||
+             (r2min_t[th] == r2min && imin_t[th] < imin_t[thmin])))
+        {
+            r2min = r2min_t[th];
+            thmin = th;
+        }
+    }
+    if (thmin >= 0)
+    {
+        min_ind[0] = imin_t[thmin];
+        min_ind[1] = jmin_t[thmin];
+    }
+    sfree(r2min_t);
+    sfree(r2max_t);
+    sfree(imin_t);
+    sfree(jmin_t);
+
     *rmin = sqrt(r2min);
     *rmax = sqrt(r2max);
 }
@@ -130,7 +184,7 @@ static void periodic_mindist_plot(const char *trxfn, const char *outfn,
     rvec        *x;
     matrix       box;
     int          natoms, ind_min[2] = {0, 0}, ind_mini = 0, ind_minj = 0;
-    real         r, rmin, rmax, rmint, tmint;
+    real         rmin, rmax, rmint, tmint;
     gmx_bool     bFirst;
     gmx_rmpbc_t  gpbc = NULL;
 
@@ -303,7 +357,354 @@ static void calc_dist(real rcut, gmx_bool bPBC, int ePBC, matrix box, rvec x[],
     *rmax = sqrt(rmax2);
 }
 
-void dist_plot(const char *fn, const char *afile, const char *dfile,
+/* Thread-local results of calc_mindist_grid */
+typedef struct {
+    real  rmin2;    /* Minimum distance squared                          */
+    int   imin;     /* Position in the first group of the minimum pair   */
+    int   jmin;     /* Position in the second group of the minimum pair  */
+    int   ncont;    /* Number of contacts                                */
+    real *resmin2;  /* Minimum distance squared per residue, -1 for none */
+} t_mindist_thread;
+
+/* Work data for the grid search in calc_mindist_grid */
+typedef struct {
+    gmx::AnalysisNeighborhood nb;       /* Searches within the contact distance */
+    int                       nthreads; /* The number of OpenMP threads         */
+    t_mindist_thread         *td;       /* Thread-local results                 */
+    rvec                     *x1;       /* Coordinates of the first group       */
+    rvec                     *x2;       /* Coordinates of the second group      */
+    int                       x2_nalloc; /* Allocation size of x2               */
+} t_mindist_grid;
+
+static void init_mindist_grid(t_mindist_grid *grid, real rcut,
+                              int natoms, int nres)
+{
+    int th;
+
+    grid->nb.setCutoff(rcut);
+    grid->nthreads = gmx_omp_get_max_threads();
+    snew(grid->td, grid->nthreads);
+    for (th = 0; th < grid->nthreads; th++)
+    {
+        snew(grid->td[th].resmin2, std::max(nres, 1));
+    }
+    snew(grid->x1, natoms);
+    grid->x2        = NULL;
+    grid->x2_nalloc = 0;
+}
+
+static void done_mindist_grid(t_mindist_grid *grid)
+{
+    int th;
+
+    for (th = 0; th < grid->nthreads; th++)
+    {
+        sfree(grid->td[th].resmin2);
+    }
+    sfree(grid->td);
+    sfree(grid->x1);
+    sfree(grid->x2);
+}
+
+/* Computes the minimum distance and the number of contacts between two
+ * groups, as calc_dist, but only searches pairs within rcut using a grid.
+ * The pair search runs in parallel over the atoms of the second group.
+ * When no pair is within rcut, we fall back to the all-pairs loop
+ * of calc_dist for the minimum distance.
+ * When res1 != NULL, resmin2 returns for each of the nres residues, given
+ * by res1 for each atom of the first group, the minimum distance squared,
+ * or -1 when the residue has no pair within rcut.
+ */
+static void calc_mindist_grid(t_mindist_grid *grid,
+                              real rcut, gmx_bool bPBC, int ePBC, matrix box, rvec x[],
+                              int nx1, int nx2, atom_id index1[], atom_id index2[],
+                              gmx_bool bGroup, int nres, const int *res1, real *resmin2,
+                              real *rmin, int *nmin, int *ixmin, int *jxmin)
+{
+    t_pbc pbc;
+    real  rcut2, rmin2;
+    int   i, th, thmin, nthreads;
+
+    rcut2    = sqr(rcut);
+    nthreads = grid->nthreads;
+
+    /* Must init pbc every step because of pressure coupling */
+    if (bPBC)
+    {
+        set_pbc(&pbc, ePBC, box);
+    }
+    for (i = 0; i < nx1; i++)
+    {
+        copy_rvec(x[index1[i]], grid->x1[i]);
+    }
+
+    gmx::AnalysisNeighborhoodSearch nbsearch =
+        grid->nb.initSearch(bPBC ? &pbc : NULL,
+                            gmx::AnalysisNeighborhoodPositions(grid->x1, nx1));
+
+#pragma omp parallel num_threads(nthreads)
+    {
+        try
+        {
+            t_mindist_thread *td = &grid->td[gmx_omp_get_thread_num()];
+
+            td->rmin2 = GMX_REAL_MAX;
+            td->imin  = -1;
+            td->jmin  = -1;
+            td->ncont = 0;
+            if (res1 != NULL)
+            {
+                for (int r = 0; r < nres; r++)
+                {
+                    td->resmin2[r] = -1;
+                }
+            }
+
+#pragma omp for schedule(dynamic, 64)
+            for (int j = 0; j < nx2; j++)
+            {
+                atom_id jx      = index2[j];
+                int     ncont_j = 0;
+
+                gmx::AnalysisNeighborhoodPairSearch pairSearch =
+                    nbsearch.startPairSearch(x[jx]);
+                gmx::AnalysisNeighborhoodPair       pair;
+                while (pairSearch.findNextPair(&pair))
+                {
+                    int  i  = pair.refIndex();
+                    rvec dx;
+                    real r2;
+
+                    if (index1[i] == jx)
+                    {
+                        continue;
+                    }
+                    if (bPBC)
+                    {
+                        pbc_dx(&pbc, x[index1[i]], x[jx], dx);
+                    }
+                    else
+                    {
+                        rvec_sub(x[index1[i]], x[jx], dx);
+                    }
+                    r2 = iprod(dx, dx);
+                    if (r2 > rcut2)
+                    {
+                        continue;
+                    }
+                    ncont_j++;
+                    /* Pairs are found in arbitrary order, so we pick the lowest
+                     * index on ties, as the serial loop in calc_dist does.
+                     */
+                    if (r2 < td->rmin2 ||
+                        (r2 == td->rmin2 && j == td->jmin && i < td->imin))
+                    {
+                        td->rmin2 = r2;
+                        td->imin  = i;
+                        td->jmin  = j;
+                    }
+                    if (res1 != NULL &&
+                        (td->resmin2[res1[i]] < 0 || r2 < td->resmin2[res1[i]]))
+                    {
+                        td->resmin2[res1[i]] = r2;
+                    }
+                }
+                if (bGroup)
+                {
+                    td->ncont += (ncont_j > 0 ? 1 : 0);
+                }
+                else
+                {
+                    td->ncont += ncont_j;
+                }
+            }
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
+
+    /* Reduce over the threads, each atom of group 2 is used by one thread */
+    rmin2 = GMX_REAL_MAX;
+    thmin = -1;
+    *nmin = 0;
+    for (th = 0; th < nthreads; th++)
+    {
+        const t_mindist_thread *td = &grid->td[th];
+
+        *nmin += td->ncont;
+        if (td->jmin >= 0 &&
+            (thmin < 0 || td->rmin2 < rmin2 ||
+             (td->rmin2 == rmin2 && td->jmin < grid->td[thmin].jmin)))
+        {
+            rmin2 = td->rmin2;
+            thmin = th;
+        }
+        if (res1 != NULL)
+        {
+            for (i = 0; i < nres; i++)
+            {
+                if (td->resmin2[i] >= 0 &&
+                    (th == 0 || resmin2[i] < 0 || td->resmin2[i] < resmin2[i]))
+                {
+                    resmin2[i] = td->resmin2[i];
+                }
+                else if (th == 0)
+                {
+                    resmin2[i] = -1;
+                }
+            }
+        }
+    }
+
+    if (thmin >= 0)
+    {
+        *rmin  = sqrt(rmin2);
+        *ixmin = index1[grid->td[thmin].imin];
+        *jxmin = index2[grid->td[thmin].jmin];
+    }
+    else
+    {
+        /* No pairs within rcut, we need to check all pairs */
+        real dmax;
+        int  nmax, ixmax, jxmax;
+
+        calc_dist(rcut, bPBC, ePBC, box, x, nx1, nx2, index1, index2, bGroup,
+                  rmin, &dmax, nmin, &nmax, ixmin, jxmin, &ixmax, &jxmax);
+    }
+}
+
+/* Completes resmin2, as returned by calc_mindist_grid for the first
+ * group, for the residues without a pair within rcut. For those we
+ * search the second group with a cut-off that starts at 2*rcut and is
+ * doubled until each residue has a pair within the cut-off, which then
+ * gives its exact minimum distance. Without full PBC the search can not
+ * use a grid, so then we search without cut-off.
+ * The residues are searched in parallel.
+ */
+static void calc_resmin2_far(t_mindist_grid *grid,
+                             real rcut, gmx_bool bPBC, int ePBC, matrix box, rvec x[],
+                             int nres, const atom_id *residue,
+                             atom_id index1[], int nx2, atom_id index2[],
+                             real *resmin2)
+{
+    t_pbc    pbc;
+    rvec     diag;
+    real     rc, rmax2;
+    int      i, r, nleft;
+    gmx_bool bAll;
+
+    nleft = 0;
+    for (r = 0; r < nres; r++)
+    {
+        if (resmin2[r] < 0)
+        {
+            nleft++;
+        }
+    }
+    if (nleft == 0 || nx2 == 0)
+    {
+        return;
+    }
+
+    if (bPBC)
+    {
+        set_pbc(&pbc, ePBC, box);
+    }
+    for (i = 0; i < residue[nres]; i++)
+    {
+        copy_rvec(x[index1[i]], grid->x1[i]);
+    }
+    if (nx2 > grid->x2_nalloc)
+    {
+        grid->x2_nalloc = over_alloc_large(nx2);
+        srenew(grid->x2, grid->x2_nalloc);
+    }
+    for (i = 0; i < nx2; i++)
+    {
+        copy_rvec(x[index2[i]], grid->x2[i]);
+    }
+
+    /* No pair distance is larger than the box diagonal */
+    rvec_add(box[XX], box[YY], diag);
+    rvec_inc(diag, box[ZZ]);
+    rmax2 = norm2(diag);
+
+    rc = rcut;
+    do
+    {
+        rc  *= 2;
+        bAll = (!bPBC || ePBC != epbcXYZ || sqr(rc) >= rmax2);
+
+        gmx::AnalysisNeighborhood       nb;
+        nb.setCutoff(bAll ? 0 : rc);
+        gmx::AnalysisNeighborhoodSearch nbsearch =
+            nb.initSearch(bPBC ? &pbc : NULL,
+                          gmx::AnalysisNeighborhoodPositions(grid->x2, nx2));
+        const real                      rc2 = (bAll ? GMX_REAL_MAX : sqr(rc));
+
+#pragma omp parallel for num_threads(grid->nthreads) schedule(dynamic)
+        for (r = 0; r < nres; r++)
+        {
+            try
+            {
+                if (resmin2[r] >= 0)
+                {
+                    continue;
+                }
+
+                const int                           nr     = residue[r+1] - residue[r];
+                real                                rmin2  = rc2;
+                gmx_bool                            bFound = FALSE;
+                gmx::AnalysisNeighborhoodPairSearch pairSearch =
+                    nbsearch.startPairSearch(
+                            gmx::AnalysisNeighborhoodPositions(grid->x1 + residue[r], nr));
+                gmx::AnalysisNeighborhoodPair       pair;
+                while (pairSearch.findNextPair(&pair))
+                {
+                    atom_id ix = index1[residue[r] + pair.testIndex()];
+                    atom_id jx = index2[pair.refIndex()];
+                    rvec    dx;
+                    real    r2;
+
+                    if (ix == jx)
+                    {
+                        continue;
+                    }
+                    if (bPBC)
+                    {
+                        pbc_dx(&pbc, x[ix], x[jx], dx);
+                    }
+                    else
+                    {
+                        rvec_sub(x[ix], x[jx], dx);
+                    }
+                    r2 = iprod(dx, dx);
+                    if (r2 < rmin2)
+                    {
+                        rmin2  = r2;
+                        bFound = TRUE;
+                    }
+                }
+                if (bFound)
+                {
+                    resmin2[r] = rmin2;
+                }
+            }
+            GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+        }
+
+        nleft = 0;
+        for (r = 0; r < nres; r++)
+        {
+            if (resmin2[r] < 0)
+            {
+                nleft++;
+            }
+        }
+    }
+    while (nleft > 0 && !bAll);
+}
+
+static void dist_plot(const char *fn, const char *afile, const char *dfile,
                const char *nfile, const char *rfile, const char *xfile,
                real rcut, gmx_bool bMat, t_atoms *atoms,
                int ng, atom_id *index[], int gnx[], char *grpn[], gmx_bool bSplit,
@@ -323,15 +724,39 @@ void dist_plot(const char *fn, const char *afile, const char *dfile,
     atom_id          oindex[2];
     rvec            *x0;
     matrix           box;
-    t_trxframe       frout;
     gmx_bool         bFirst;
     FILE            *respertime = NULL;
+    gmx_bool         bGrid;
+    t_mindist_grid   grid;
+    int             *resind0    = NULL;
+    real            *resmin2    = NULL;
 
     if ((natoms = read_first_x(oenv, &status, fn, &t, &x0, box)) == 0)
     {
         gmx_fatal(FARGS, "Could not read coordinates from statusfile\n");
     }
 
+    /* For the minimum distance and contacts we only need to search pairs
+     * within rcut, for the maximum distance we need all pairs.
+     */
+    bGrid = (bMin && rcut > 0);
+    if (bGrid)
+    {
+        init_mindist_grid(&grid, rcut, std::max(natoms, gnx[0]), nres);
+        if (nres)
+        {
+            snew(resind0, gnx[0]);
+            for (j = 0; j < nres; j++)
+            {
+                for (k = residue[j]; k < residue[j+1]; k++)
+                {
+                    resind0[k] = j;
+                }
+            }
+            snew(resmin2, nres);
+        }
+    }
+
     sprintf(buf, "%simum Distance", bMin ? "Min" : "Max");
     dist = xvgropen(dfile, buf, output_env_get_time_label(oenv), "Distance (nm)", oenv);
     sprintf(buf, "Number of Contacts %s %g nm", bMin ? "<" : ">", rcut);
@@ -443,8 +868,17 @@ void dist_plot(const char *fn, const char *afile, const char *dfile,
         {
             if (ng == 1)
             {
-                calc_dist(rcut, bPBC, ePBC, box, x0, gnx[0], gnx[0], index[0], index[0], bGroup,
-                          &dmin, &dmax, &nmin, &nmax, &min1, &min2, &max1, &max2);
+                if (bGrid)
+                {
+                    calc_mindist_grid(&grid, rcut, bPBC, ePBC, box, x0, gnx[0], gnx[0],
+                                      index[0], index[0], bGroup, 0, NULL, NULL,
+                                      &dmin, &nmin, &min1, &min2);
+                }
+                else
+                {
+                    calc_dist(rcut, bPBC, ePBC, box, x0, gnx[0], gnx[0], index[0], index[0], bGroup,
+                              &dmin, &dmax, &nmin, &nmax, &min1, &min2, &max1, &max2);
+                }
                 fprintf(dist, "  %12e", bMin ? dmin : dmax);
                 if (num)
                 {
@@ -457,8 +891,17 @@ void dist_plot(const char *fn, const char *afile, const char *dfile,
                 {
                     for (k = i+1; (k < ng); k++)
                     {
-                        calc_dist(rcut, bPBC, ePBC, box, x0, gnx[i], gnx[k], index[i], index[k],
-                                  bGroup, &dmin, &dmax, &nmin, &nmax, &min1, &min2, &max1, &max2);
+                        if (bGrid)
+                        {
+                            calc_mindist_grid(&grid, rcut, bPBC, ePBC, box, x0, gnx[i], gnx[k],
+                                              index[i], index[k], bGroup, 0, NULL, NULL,
+                                              &dmin, &nmin, &min1, &min2);
+                        }
+                        else
+                        {
+                            calc_dist(rcut, bPBC, ePBC, box, x0, gnx[i], gnx[k], index[i], index[k],
+                                      bGroup, &dmin, &dmax, &nmin, &nmax, &min1, &min2, &max1, &max2);
+                        }
                         fprintf(dist, "  %12e", bMin ? dmin : dmax);
                         if (num)
                         {
@@ -472,8 +915,17 @@ void dist_plot(const char *fn, const char *afile, const char *dfile,
         {
             for (i = 1; (i < ng); i++)
             {
-                calc_dist(rcut, bPBC, ePBC, box, x0, gnx[0], gnx[i], index[0], index[i], bGroup,
-                          &dmin, &dmax, &nmin, &nmax, &min1, &min2, &max1, &max2);
+                if (bGrid)
+                {
+                    calc_mindist_grid(&grid, rcut, bPBC, ePBC, box, x0, gnx[0], gnx[i],
+                                      index[0], index[i], bGroup, nres, resind0, resmin2,
+                                      &dmin, &nmin, &min1, &min2);
+                }
+                else
+                {
+                    calc_dist(rcut, bPBC, ePBC, box, x0, gnx[0], gnx[i], index[0], index[i], bGroup,
+                              &dmin, &dmax, &nmin, &nmax, &min1, &min2, &max1, &max2);
+                }
                 fprintf(dist, "  %12e", bMin ? dmin : dmax);
                 if (num)
                 {
@@ -481,13 +933,27 @@ void dist_plot(const char *fn, const char *afile, const char *dfile,
                 }
                 if (nres)
                 {
+                    if (bGrid)
+                    {
+                        calc_resmin2_far(&grid, rcut, bPBC, ePBC, box, x0,
+                                         nres, residue, index[0], gnx[i], index[i],
+                                         resmin2);
+                    }
                     for (j = 0; j < nres; j++)
                     {
+                        if (bGrid)
+                        {
+                            if (resmin2[j] >= 0)
+                            {
+                                mindres[i-1][j] = std::min(mindres[i-1][j], sqrt(resmin2[j]));
+                            }
+                            continue;
+                        }
                         calc_dist(rcut, bPBC, ePBC, box, x0, residue[j+1]-residue[j], gnx[i],
                                   &(index[0][residue[j]]), index[i], bGroup,
                                   &dmin, &dmax, &nmin, &nmax, &min1r, &min2r, &max1r, &max2r);
-                        mindres[i-1][j] = min(mindres[i-1][j], dmin);
-                        maxdres[i-1][j] = max(maxdres[i-1][j], dmax);
+                        mindres[i-1][j] = std::min(mindres[i-1][j], dmin);
+                        maxdres[i-1][j] = std::max(maxdres[i-1][j], dmax);
                     }
                 }
             }
@@ -547,6 +1013,12 @@ void dist_plot(const char *fn, const char *afile, const char *dfile,
     {
         close_trx(trxout);
     }
+    if (bGrid)
+    {
+        done_mindist_grid(&grid);
+        sfree(resind0);
+        sfree(resmin2);
+    }
 
     if (nres && !bEachResEachTime)
     {
@@ -569,7 +1041,7 @@ void dist_plot(const char *fn, const char *afile, const char *dfile,
     sfree(x0);
 }
 
-int find_residues(t_atoms *atoms, int n, atom_id index[], atom_id **resindex)
+static int find_residues(t_atoms *atoms, int n, atom_id index[], atom_id **resindex)
 {
     int  i;
     int  nres = 0, resnr, presnr;
@@ -600,7 +1072,7 @@ int find_residues(t_atoms *atoms, int n, atom_id index[], atom_id **resindex)
     return nres;
 }
 
-void dump_res(FILE *out, int nres, atom_id *resindex, atom_id index[])
+static void dump_res(FILE *out, int nres, atom_id *resindex, atom_id index[])
 {
     int i, j;
 
@@ -634,17 +1106,18 @@ int gmx_mindist(int argc, char *argv[])
         "each direction is considered, giving a total of 26 shifts.",
         "It also plots the maximum distance within the group and the lengths",
         "of the three box vectors.[PAR]",
+        "For the minimum distance and the number of contacts, only atom pairs",
+        "within the contact distance [TT]-d[tt] are searched for using a grid,",
+        "which is much faster for large groups. Only when there are no pairs",
+        "within [TT]-d[tt] all pairs are checked.[PAR]",
         "Also [gmx-distance] calculates distances."
     };
-    const char     *bugs[] = {
-        "The [TT]-pi[tt] option is very slow."
-    };
-
     static gmx_bool bMat             = FALSE, bPI = FALSE, bSplit = FALSE, bMax = FALSE, bPBC = TRUE;
     static gmx_bool bGroup           = FALSE;
     static real     rcutoff          = 0.6;
     static int      ng               = 1;
     static gmx_bool bEachResEachTime = FALSE, bPrintResName = FALSE;
+    static int      nthreads         = 0;
     t_pargs         pa[]             = {
         { "-matrix", FALSE, etBOOL, {&bMat},
           "Calculate half a matrix of group-group distances" },
@@ -665,19 +1138,21 @@ int gmx_mindist(int argc, char *argv[])
         { "-respertime",  FALSE, etBOOL, {&bEachResEachTime},
           "When writing per-residue distances, write distance for each time point" },
         { "-printresname",  FALSE, etBOOL, {&bPrintResName},
-          "Write residue names" }
+          "Write residue names" },
+#ifdef GMX_OPENMP
+        { "-nt",     FALSE, etINT, {&nthreads},
+          "Number of threads to start" },
+#endif
     };
     output_env_t    oenv;
     t_topology     *top  = NULL;
     int             ePBC = -1;
     char            title[256];
-    real            t;
     rvec           *x;
     matrix          box;
     gmx_bool        bTop = FALSE;
 
-    FILE           *atm;
-    int             i, j, nres = 0;
+    int             i, nres = 0;
     const char     *trxfnm, *tpsfnm, *ndxfnm, *distfnm, *numfnm, *atmfnm, *oxfnm, *resfnm;
     char          **grpname;
     int            *gnx;
@@ -694,6 +1169,8 @@ int gmx_mindist(int argc, char *argv[])
     };
 #define NFILE asize(fnm)
 
+    nthreads = gmx_omp_get_max_threads();
+
     if (!parse_common_args(&argc, argv,
                            PCA_CAN_VIEW | PCA_CAN_TIME | PCA_TIME_UNIT | PCA_BE_NICE,
                            NFILE, fnm, asize(pa), pa, asize(desc), desc, 0, NULL, &oenv))
@@ -701,6 +1178,8 @@ int gmx_mindist(int argc, char *argv[])
         return 0;
     }
 
+    gmx_omp_set_num_threads(nthreads);
+
     trxfnm  = ftp2fn(efTRX, NFILE, fnm);
     ndxfnm  = ftp2fn_null(efNDX, NFILE, fnm);
     distfnm = opt2fn("-od", NFILE, fnm);
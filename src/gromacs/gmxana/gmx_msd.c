@@ -56,9 +56,11 @@
 #include "gmx_ana.h"
 
 #include "gromacs/commandline/pargs.h"
+#include "gromacs/fft/fft.h"
 #include "gromacs/fileio/xvgr.h"
 #include "gromacs/pbcutil/rmpbc.h"
 #include "gromacs/utility/fatalerror.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/smalloc.h"
 
 #define FACTOR  1000.0  /* Convert nm^2/ps to 10e-5 cm^2/s */
@@ -85,6 +87,7 @@ typedef struct {
     rvec        **x0;         /* original positions */
     rvec         *com;        /* center of mass correction for each frame */
     gmx_stats_t **lsq;        /* fitting stats for individual molecule msds */
+    int           nlsq;       /* number of sets of fitting stats in lsq */
     msd_type      type;       /* the type of msd to calculate (lateral, etc.)*/
     int           axis;       /* the axis along which to calculate */
     int           ncoords;
@@ -150,6 +153,7 @@ t_corr *init_corr(int nrgrp, int type, int axis, real dim_factor,
     }
     curr->time = NULL;
     curr->lsq  = NULL;
+    curr->nlsq = 0;
     curr->nmol = nmol;
     if (curr->nmol > 0)
     {
@@ -577,7 +581,7 @@ void printmol(t_corr *curr, const char *fn,
     for (i = 0; (i < curr->nmol); i++)
     {
         lsq1 = gmx_stats_init();
-        for (j = 0; (j < curr->nrestart); j++)
+        for (j = 0; (j < curr->nlsq); j++)
         {
             real xx, yy, dx, dy;
 
@@ -586,7 +590,7 @@ void printmol(t_corr *curr, const char *fn,
                 gmx_stats_add_point(lsq1, xx, yy, dx, dy);
             }
         }
-        gmx_stats_get_ab(lsq1, elsqWEIGHT_NONE, &a, &b, NULL, NULL, NULL, NULL);
+        gmx_stats_get_ab(lsq1, elsqWEIGHT_Y, &a, &b, NULL, NULL, NULL, NULL);
         gmx_stats_done(lsq1);
         sfree(lsq1);
         D     = a*FACTOR/curr->dim_factor;
@@ -731,6 +735,7 @@ int corr_loop(t_corr *curr, const char *fn, t_topology *top, int ePBC,
             {
                 curr->lsq[curr->nrestart-1][i]  = gmx_stats_init();
             }
+            curr->nlsq = curr->nrestart;
 
             if (debug)
             {
@@ -841,6 +846,628 @@ int corr_loop(t_corr *curr, const char *fn, t_topology *top, int ePBC,
     return natoms;
 }
 
+/* The MSD components computed with -fft -ten, in the order of datam */
+static const int msd_fft_comp[6][2] = {
+    { XX, XX }, { YY, YY }, { ZZ, ZZ }, { YY, XX }, { ZZ, XX }, { ZZ, YY }
+};
+
+/* Settings shared by all threads for the FFT-based MSD calculation */
+typedef struct {
+    int      nframes;  /* number of frames, all are used as time origins */
+    int      nfft;     /* the zero-padded transform length, >= 2*nframes */
+    int      nd;       /* the number of dimensions used */
+    int      dim[DIM]; /* the dimensions used */
+    gmx_bool bTen;     /* compute the full tensor */
+    int      ncomp;    /* the number of components accumulated per group */
+} t_msd_fft;
+
+/* Thread-local work data for the FFT-based MSD calculation */
+typedef struct {
+    gmx_fft_t fft;
+    real     *in;      /* real-space transform buffer, length nfft */
+    real     *c;       /* complex transform buffer, length nfft+2 */
+    real     *F[DIM];  /* transforms of the particle coordinates */
+    real     *y[DIM];  /* centered coordinates of the particle */
+    double   *cum;     /* cumulative squared coordinates, length nframes+1 */
+    double   *pspec;   /* the power spectrum of one molecule, for -mol */
+    double   *psq;     /* the squared coordinates of one molecule, for -mol */
+    double   *msd;     /* the summed squared displacements per time lag */
+    double  **spec;    /* the summed power spectra per group and component */
+    double  **sq;      /* the summed squared coordinates per group, component
+                          and frame */
+} t_msd_fft_work;
+
+/* Returns the smallest even transform length >= n with factors 2, 3 and 5 */
+static int msd_fft_size(int n)
+{
+    int m, r;
+
+    for (m = n + (n % 2); ; m += 2)
+    {
+        r = m;
+        while (r % 2 == 0)
+        {
+            r /= 2;
+        }
+        while (r % 3 == 0)
+        {
+            r /= 3;
+        }
+        while (r % 5 == 0)
+        {
+            r /= 5;
+        }
+        if (r == 1)
+        {
+            return m;
+        }
+    }
+}
+
+/* Computes from the summed power spectrum spec and the summed squared
+ * coordinates sq the sum over all time origins of the squared displacements
+ * for all time lags m, using
+ *   sum_k (y(k+m) - y(k))^2 = sum_k y(k+m)^2 + y(k)^2 - 2 y(k) y(k+m),
+ * where the last term is the autocorrelation obtained by a backward FFT.
+ */
+static void msd_fft_sum(const t_msd_fft *fd, t_msd_fft_work *w,
+                        const double *spec, const double *sq, double *msd)
+{
+    int N, j, m, fftcode;
+
+    N = fd->nframes;
+    for (j = 0; j < fd->nfft/2 + 1; j++)
+    {
+        w->c[2*j]   = spec[j];
+        w->c[2*j+1] = 0;
+    }
+    if ((fftcode = gmx_fft_1d_real(w->fft, GMX_FFT_COMPLEX_TO_REAL,
+                                   w->c, w->in)) != 0)
+    {
+        gmx_fatal(FARGS, "gmx_fft_1d_real returned %d", fftcode);
+    }
+    w->cum[0] = 0;
+    for (j = 0; j < N; j++)
+    {
+        w->cum[j+1] = w->cum[j] + sq[j];
+    }
+    for (m = 0; m < N; m++)
+    {
+        msd[m] = w->cum[N] - w->cum[m] + w->cum[N-m] - 2.0*w->in[m]/fd->nfft;
+    }
+}
+
+/* Adds the weighted power spectra and squared coordinates of one particle
+ * to the sums of group g in w. xp contains the unwrapped coordinates
+ * of the particle for each frame, spaced by stride. When lsq is not NULL
+ * the MSD of this particle is added to lsq for the fit of its diffusion
+ * coefficient.
+ */
+static void msd_fft_particle(const t_corr *curr, const t_msd_fft *fd,
+                             t_msd_fft_work *w, int g, const rvec *xp, int stride,
+                             const rvec *com, real wgt, gmx_stats_t lsq)
+{
+    int     N, nc, k, d, a, b, c, f, j, fftcode;
+    double  sum, *spec, *sq;
+    real    mean, tt;
+
+    N  = fd->nframes;
+    nc = fd->nfft/2 + 1;
+    for (k = 0; k < fd->nd; k++)
+    {
+        d   = fd->dim[k];
+        sum = 0;
+        for (f = 0; f < N; f++)
+        {
+            w->y[d][f] = xp[f*stride][d] - (com ? com[f][d] : 0);
+            sum       += w->y[d][f];
+        }
+        /* Shifting the particle to the origin reduces rounding errors */
+        mean = sum/N;
+        for (f = 0; f < N; f++)
+        {
+            w->y[d][f] -= mean;
+            w->in[f]    = w->y[d][f];
+        }
+        for (f = N; f < fd->nfft; f++)
+        {
+            w->in[f] = 0;
+        }
+        if ((fftcode = gmx_fft_1d_real(w->fft, GMX_FFT_REAL_TO_COMPLEX,
+                                       w->in, w->F[d])) != 0)
+        {
+            gmx_fatal(FARGS, "gmx_fft_1d_real returned %d", fftcode);
+        }
+    }
+
+    for (c = 0; c < fd->ncomp; c++)
+    {
+        spec = w->spec[g*fd->ncomp + c];
+        sq   = w->sq[g*fd->ncomp + c];
+        for (k = 0; k < (fd->bTen ? 1 : fd->nd); k++)
+        {
+            a = fd->bTen ? msd_fft_comp[c][0] : fd->dim[k];
+            b = fd->bTen ? msd_fft_comp[c][1] : fd->dim[k];
+            for (j = 0; j < nc; j++)
+            {
+                spec[j] += wgt*(w->F[a][2*j]*w->F[b][2*j] +
+                                w->F[a][2*j+1]*w->F[b][2*j+1]);
+            }
+            for (f = 0; f < N; f++)
+            {
+                sq[f] += wgt*w->y[a][f]*w->y[b][f];
+            }
+        }
+    }
+
+    if (lsq)
+    {
+        for (j = 0; j < nc; j++)
+        {
+            w->pspec[j] = 0;
+        }
+        for (f = 0; f < N; f++)
+        {
+            w->psq[f] = 0;
+        }
+        for (k = 0; k < fd->nd; k++)
+        {
+            d = fd->dim[k];
+            for (j = 0; j < nc; j++)
+            {
+                w->pspec[j] += sqr(w->F[d][2*j]) + sqr(w->F[d][2*j+1]);
+            }
+            for (f = 0; f < N; f++)
+            {
+                w->psq[f] += sqr(w->y[d][f]);
+            }
+        }
+        msd_fft_sum(fd, w, w->pspec, w->psq, w->msd);
+        /* Weighting the average over the N-f time origins with N-f gives
+         * the same fit as adding the displacement for each origin.
+         */
+        for (f = 0; f < N; f++)
+        {
+            tt = curr->time[f];
+            if (tt >= curr->beginfit && (curr->endfit < 0 || tt <= curr->endfit))
+            {
+                gmx_stats_add_point(lsq, tt, w->msd[f]/(N - f), 0, 1/sqrt(N - f));
+            }
+        }
+    }
+}
+
+/* Reads the trajectory for the FFT-based MSD calculation and stores for
+ * every frame the unwrapped coordinates of the particles p0 up to p0+*np
+ * of the concatenated groups in *xbuf. Particle p of group g has number
+ * goff[g]+p. With bFirst this is the first pass over the trajectory, which
+ * also collects the frame times, the center of mass for each frame and
+ * the frame for -pdb. During the first pass *np is reduced when storing
+ * the coordinates would take more than maxbuf bytes.
+ */
+static int msd_fft_read(t_corr *curr, const char *fn, t_topology *top, int ePBC,
+                        gmx_bool bMol, int gnx[], atom_id *index[], const int goff[],
+                        int *gnx_com, atom_id *index_com[], rvec **com,
+                        gmx_bool bFirst, int p0, int *np, double maxbuf,
+                        rvec **xbuf, real t_pdb, rvec **x_pdb, matrix box_pdb,
+                        const output_env_t oenv)
+{
+    rvec            *x[2];  /* the coordinates to read */
+    rvec            *xa[2]; /* the coordinates to calculate displacements for */
+    real             t, t0, t_prev = 0;
+    int              natoms, nstore, nnew, g, i, i0, i1, f;
+    int              cur = 0, nframes = 0, maxframes = 0;
+    t_trxstatus     *status;
+#define        prev (1-cur)
+    matrix           box;
+    gmx_bool         bFirstFrame;
+    gmx_rmpbc_t      gpbc = NULL;
+
+    natoms = read_first_x(oenv, &status, fn, &t0, &(x[cur]), box);
+    if (bFirst && (gnx_com != NULL) && natoms < top->atoms.nr)
+    {
+        fprintf(stderr, "WARNING: The trajectory only contains part of the system (%d of %d atoms) and therefore the COM motion of only this part of the system will be removed\n", natoms, top->atoms.nr);
+    }
+
+    snew(x[prev], natoms);
+
+    if (bMol)
+    {
+        curr->ncoords = curr->nmol;
+        snew(xa[0], curr->ncoords);
+        snew(xa[1], curr->ncoords);
+        gpbc = gmx_rmpbc_init(&top->idef, ePBC, natoms);
+    }
+    else
+    {
+        curr->ncoords = natoms;
+        xa[0]         = x[0];
+        xa[1]         = x[1];
+    }
+
+    if (bFirst)
+    {
+        curr->t0 = t0;
+        if (x_pdb)
+        {
+            *x_pdb = NULL;
+        }
+    }
+    else
+    {
+        maxframes = curr->nframes;
+        srenew(*xbuf, maxframes*(*np));
+    }
+    nstore      = *np;
+    bFirstFrame = TRUE;
+    t           = t0;
+
+    /* the loop over all frames */
+    do
+    {
+        if (bFirst)
+        {
+            if (x_pdb && ((bFirstFrame && t_pdb < t) ||
+                          (!bFirstFrame &&
+                           t_pdb > t - 0.5*(t - t_prev) &&
+                           t_pdb < t + 0.5*(t - t_prev))))
+            {
+                if (*x_pdb == NULL)
+                {
+                    snew(*x_pdb, natoms);
+                }
+                for (i = 0; i < natoms; i++)
+                {
+                    copy_rvec(x[cur][i], (*x_pdb)[i]);
+                }
+                copy_mat(box, box_pdb);
+            }
+
+            if (nframes >= maxframes)
+            {
+                maxframes += 100;
+                srenew(curr->time, maxframes);
+                if (gnx_com)
+                {
+                    srenew(*com, maxframes);
+                }
+                if ((double)maxframes*nstore*sizeof(rvec) > maxbuf && nstore > 1)
+                {
+                    /* Store fewer particles, compact the frames stored so far */
+                    nnew = (int)(maxbuf/(maxframes*sizeof(rvec)));
+                    nnew = (nnew < 1 ? 1 : nnew);
+                    for (f = 0; f < nframes; f++)
+                    {
+                        memmove(*xbuf + f*nnew, *xbuf + f*nstore,
+                                nnew*sizeof(rvec));
+                    }
+                    nstore = nnew;
+                }
+                srenew(*xbuf, maxframes*nstore);
+            }
+            curr->time[nframes] = t - curr->t0;
+        }
+        else if (nframes >= curr->nframes)
+        {
+            gmx_fatal(FARGS, "Trajectory %s changed between passes", fn);
+        }
+
+        /* for the first frame, the previous frame is a copy of the first frame */
+        if (bFirstFrame)
+        {
+            memcpy(xa[prev], xa[cur], curr->ncoords*sizeof(xa[prev][0]));
+            bFirstFrame = FALSE;
+        }
+
+        /* make the molecules whole and put their centers of masses into xa */
+        if (bMol)
+        {
+            gmx_rmpbc(gpbc, natoms, box, x[cur]);
+        }
+
+        for (g = 0; g < curr->ngrp; g++)
+        {
+            /* During the first pass we need all coordinates for the COM,
+             * later we only need the particles we store.
+             */
+            i0 = (bFirst ? 0 : max(p0 - goff[g], 0));
+            i1 = (bFirst ? gnx[g] : min(p0 + nstore - goff[g], gnx[g]));
+            if (i1 <= i0)
+            {
+                continue;
+            }
+            if (bMol)
+            {
+                calc_mol_com(i1 - i0, index[g] + i0, &top->mols, &top->atoms,
+                             x[cur], xa[cur] + i0);
+                prep_data(bMol, i1 - i0, NULL, xa[cur] + i0, xa[prev] + i0, box);
+            }
+            else
+            {
+                prep_data(bMol, i1 - i0, index[g] + i0, xa[cur], xa[prev], box);
+            }
+        }
+
+        if (bFirst && gnx_com)
+        {
+            prep_data(bMol, gnx_com[0], index_com[0], xa[cur], xa[prev], box);
+            calc_com(bMol, gnx_com[0], index_com[0], xa[cur], xa[prev], box,
+                     &top->atoms, (*com)[nframes]);
+        }
+
+        /* store the unwrapped coordinates of our particles */
+        for (g = 0; g < curr->ngrp; g++)
+        {
+            i0 = max(p0 - goff[g], 0);
+            i1 = min(p0 + nstore - goff[g], gnx[g]);
+            for (i = i0; i < i1; i++)
+            {
+                copy_rvec(xa[cur][bMol ? i : index[g][i]],
+                          (*xbuf)[nframes*nstore + goff[g] + i - p0]);
+            }
+        }
+
+        cur    = prev;
+        t_prev = t;
+        nframes++;
+    }
+    while (read_next_x(oenv, status, &t, x[cur], box));
+
+    if (bFirst)
+    {
+        curr->nframes = nframes;
+    }
+    else if (nframes != curr->nframes)
+    {
+        gmx_fatal(FARGS, "Trajectory %s changed between passes", fn);
+    }
+    *np = nstore;
+
+    if (bMol)
+    {
+        gmx_rmpbc_done(gpbc);
+        sfree(xa[0]);
+        sfree(xa[1]);
+    }
+    sfree(x[0]);
+    sfree(x[1]);
+
+    close_trj(status);
+
+    return natoms;
+#undef prev
+}
+
+/* Computes the MSD with all frames as time origins. The squared
+ * displacements are summed over all origins using FFTs, which scales
+ * as N log N instead of N^2 with the number of frames N. The particles
+ * are distributed over OpenMP threads. When the unwrapped coordinates
+ * of all particles would take more than maxmem MB, they are processed in
+ * chunks, reading the trajectory once for every chunk.
+ */
+static int corr_fft(t_corr *curr, const char *fn, t_topology *top, int ePBC,
+                    gmx_bool bMol, gmx_bool bMW, gmx_bool bTen,
+                    int gnx[], atom_id *index[],
+                    int *gnx_com, atom_id *index_com[], int maxmem,
+                    real t_pdb, rvec **x_pdb, matrix box_pdb,
+                    const output_env_t oenv)
+{
+    t_msd_fft       fd;
+    t_msd_fft_work *work;
+    int            *goff, ntot, p0, np, npass, natoms, nthreads, th;
+    int             N, nc, g, c, i, j, m, fftcode;
+    double          maxbuf, *wtot, *spec, *sq, *msd;
+    rvec           *xbuf = NULL, *com = NULL;
+
+    snew(goff, curr->ngrp + 1);
+    for (g = 0; g < curr->ngrp; g++)
+    {
+        goff[g+1] = goff[g] + gnx[g];
+    }
+    ntot   = goff[curr->ngrp];
+    maxbuf = (maxmem > 0 ? maxmem*1024.0*1024.0 : GMX_DOUBLE_MAX);
+
+    np     = ntot;
+    natoms = msd_fft_read(curr, fn, top, ePBC, bMol, gnx, index, goff,
+                          gnx_com, index_com, &com, TRUE, 0, &np, maxbuf,
+                          &xbuf, t_pdb, x_pdb, box_pdb, oenv);
+    N      = curr->nframes;
+
+    fd.nframes = N;
+    fd.nfft    = msd_fft_size(2*N);
+    fd.bTen    = bTen;
+    fd.ncomp   = (bTen ? asize(msd_fft_comp) : 1);
+    fd.nd      = 0;
+    for (m = 0; m < DIM; m++)
+    {
+        if ((curr->type == NORMAL) ||
+            (curr->type == LATERAL && m != curr->axis) ||
+            (curr->type != LATERAL && curr->type - X == m))
+        {
+            fd.dim[fd.nd++] = m;
+        }
+    }
+    nc = fd.nfft/2 + 1;
+
+    nthreads = gmx_omp_get_max_threads();
+    snew(work, nthreads);
+    for (th = 0; th < nthreads; th++)
+    {
+        if ((fftcode = gmx_fft_init_1d_real(&work[th].fft, fd.nfft,
+                                            GMX_FFT_FLAG_NONE)) != 0)
+        {
+            gmx_fatal(FARGS, "gmx_fft_init_1d_real returned %d", fftcode);
+        }
+        snew(work[th].in, fd.nfft);
+        snew(work[th].c, fd.nfft + 2);
+        for (m = 0; m < DIM; m++)
+        {
+            snew(work[th].F[m], fd.nfft + 2);
+            snew(work[th].y[m], N);
+        }
+        snew(work[th].cum, N + 1);
+        snew(work[th].msd, N);
+        if (bMol)
+        {
+            snew(work[th].pspec, nc);
+            snew(work[th].psq, N);
+        }
+        snew(work[th].spec, curr->ngrp*fd.ncomp);
+        snew(work[th].sq, curr->ngrp*fd.ncomp);
+        for (c = 0; c < curr->ngrp*fd.ncomp; c++)
+        {
+            snew(work[th].spec[c], nc);
+            snew(work[th].sq[c], N);
+        }
+    }
+
+    /* Every frame is a time origin */
+    curr->nrestart = N;
+    if (bMol)
+    {
+        snew(curr->lsq, 1);
+        snew(curr->lsq[0], curr->nmol);
+        for (i = 0; i < curr->nmol; i++)
+        {
+            curr->lsq[0][i] = gmx_stats_init();
+        }
+        curr->nlsq = 1;
+    }
+
+    snew(wtot, curr->ngrp);
+    for (g = 0; g < curr->ngrp; g++)
+    {
+        for (i = 0; i < gnx[g]; i++)
+        {
+            wtot[g] += ((bMW && !bMol) ? curr->mass[index[g][i]] : 1);
+        }
+    }
+
+    p0    = 0;
+    npass = 1;
+    while (TRUE)
+    {
+        int p;
+
+#pragma omp parallel for schedule(static)
+        for (p = 0; p < np; p++)
+        {
+            t_msd_fft_work *w = &work[gmx_omp_get_thread_num()];
+            int             pg, pi;
+            real            wgt;
+
+            for (pg = 0; p0 + p >= goff[pg+1]; pg++)
+            {
+                ;
+            }
+            pi  = p0 + p - goff[pg];
+            wgt = ((bMW && !bMol) ? curr->mass[index[pg][pi]] : 1);
+            if (wgt > 0)
+            {
+                msd_fft_particle(curr, &fd, w, pg, xbuf + p, np, com, wgt,
+                                 bMol ? curr->lsq[0][pi] : NULL);
+            }
+        }
+
+        p0 += np;
+        if (p0 >= ntot)
+        {
+            break;
+        }
+        np = min(np, ntot - p0);
+        msd_fft_read(curr, fn, top, ePBC, bMol, gnx, index, goff,
+                     gnx_com, index_com, &com, FALSE, p0, &np, maxbuf,
+                     &xbuf, t_pdb, NULL, box_pdb, oenv);
+        npass++;
+    }
+
+    fprintf(stderr, "\nUsed all %d frames as time origins over %g %s",
+            N, output_env_conv_time(oenv, curr->time[N-1]),
+            output_env_get_time_unit(oenv));
+    if (npass > 1)
+    {
+        fprintf(stderr, ", read the trajectory %d times to use at most %d MB",
+                npass, maxmem);
+    }
+    fprintf(stderr, "\n\n");
+
+    /* Reduce the thread sums in a fixed order and transform back */
+    msd = work[0].msd;
+    for (g = 0; g < curr->ngrp; g++)
+    {
+        snew(curr->data[g], N);
+        snew(curr->ndata[g], N);
+        if (bTen)
+        {
+            snew(curr->datam[g], N);
+        }
+        for (c = 0; c < fd.ncomp; c++)
+        {
+            spec = work[0].spec[g*fd.ncomp + c];
+            sq   = work[0].sq[g*fd.ncomp + c];
+            for (th = 1; th < nthreads; th++)
+            {
+                for (j = 0; j < nc; j++)
+                {
+                    spec[j] += work[th].spec[g*fd.ncomp + c][j];
+                }
+                for (j = 0; j < N; j++)
+                {
+                    sq[j] += work[th].sq[g*fd.ncomp + c][j];
+                }
+            }
+            msd_fft_sum(&fd, &work[0], spec, sq, msd);
+            for (m = 0; m < N; m++)
+            {
+                if (bTen)
+                {
+                    curr->datam[g][m][msd_fft_comp[c][0]][msd_fft_comp[c][1]] =
+                        msd[m]/wtot[g];
+                    if (msd_fft_comp[c][0] != msd_fft_comp[c][1])
+                    {
+                        continue;
+                    }
+                }
+                curr->data[g][m] += msd[m]/wtot[g];
+            }
+        }
+        for (m = 0; m < N; m++)
+        {
+            curr->ndata[g][m] = N - m;
+        }
+    }
+
+    for (th = 0; th < nthreads; th++)
+    {
+        gmx_fft_destroy(work[th].fft);
+        sfree(work[th].in);
+        sfree(work[th].c);
+        for (m = 0; m < DIM; m++)
+        {
+            sfree(work[th].F[m]);
+            sfree(work[th].y[m]);
+        }
+        sfree(work[th].cum);
+        sfree(work[th].msd);
+        sfree(work[th].pspec);
+        sfree(work[th].psq);
+        for (c = 0; c < curr->ngrp*fd.ncomp; c++)
+        {
+            sfree(work[th].spec[c]);
+            sfree(work[th].sq[c]);
+        }
+        sfree(work[th].spec);
+        sfree(work[th].sq);
+    }
+    sfree(work);
+    sfree(wtot);
+    sfree(xbuf);
+    sfree(com);
+    sfree(goff);
+
+    return natoms;
+}
+
 static void index_atom2mol(int *n, int *index, t_block *mols)
 {
     int nat, i, nmol, mol, j;
@@ -880,7 +1507,8 @@ void do_corr(const char *trx_file, const char *ndx_file, const char *msd_file,
              int nrgrp, t_topology *top, int ePBC,
              gmx_bool bTen, gmx_bool bMW, gmx_bool bRmCOMM,
              int type, real dim_factor, int axis,
-             real dt, real beginfit, real endfit, const output_env_t oenv)
+             real dt, gmx_bool bFFT, int maxmem,
+             real beginfit, real endfit, const output_env_t oenv)
 {
     t_corr        *msd;
     int           *gnx;   /* the selected groups' sizes */
@@ -920,11 +1548,21 @@ void do_corr(const char *trx_file, const char *ndx_file, const char *msd_file,
                     mol_file == NULL ? 0 : gnx[0], bTen, bMW, dt, top,
                     beginfit, endfit);
 
-    nat_trx =
-        corr_loop(msd, trx_file, top, ePBC, mol_file ? gnx[0] : 0, gnx, index,
-                  (mol_file != NULL) ? calc1_mol : (bMW ? calc1_mw : calc1_norm),
-                  bTen, gnx_com, index_com, dt, t_pdb,
-                  pdb_file ? &x : NULL, box, oenv);
+    if (bFFT)
+    {
+        nat_trx =
+            corr_fft(msd, trx_file, top, ePBC, mol_file != NULL, bMW, bTen,
+                     gnx, index, gnx_com, index_com, maxmem, t_pdb,
+                     pdb_file ? &x : NULL, box, oenv);
+    }
+    else
+    {
+        nat_trx =
+            corr_loop(msd, trx_file, top, ePBC, mol_file ? gnx[0] : 0, gnx, index,
+                      (mol_file != NULL) ? calc1_mol : (bMW ? calc1_mw : calc1_norm),
+                      bTen, gnx_com, index_com, dt, t_pdb,
+                      pdb_file ? &x : NULL, box, oenv);
+    }
 
     /* Correct for the number of points */
     for (j = 0; (j < msd->ngrp); j++)
@@ -1071,7 +1709,16 @@ int gmx_msd(int argc, char *argv[])
         "Option [TT]-pdb[tt] writes a [TT].pdb[tt] file with the coordinates of the frame",
         "at time [TT]-tpdb[tt] with in the B-factor field the square root of",
         "the diffusion coefficient of the molecule.",
-        "This option implies option [TT]-mol[tt]."
+        "This option implies option [TT]-mol[tt].[PAR]",
+        "With [TT]-fft[tt] all frames are used as reference points and",
+        "[TT]-trestart[tt] is ignored. The displacements are then summed",
+        "over all reference points with fast Fourier transforms, so the cost",
+        "scales as N log N instead of N^2 with the number of frames N.",
+        "The frames should be equally spaced in time.",
+        "The particles are distributed over [TT]-nt[tt] threads.",
+        "The unwrapped coordinates of all particles in all frames are stored;",
+        "when these would take more than [TT]-maxmem[tt] MB, the particles",
+        "are processed in chunks and the trajectory is read once per chunk."
     };
     static const char *normtype[] = { NULL, "no", "x", "y", "z", NULL };
     static const char *axtitle[]  = { NULL, "no", "x", "y", "z", NULL };
@@ -1083,6 +1730,9 @@ int gmx_msd(int argc, char *argv[])
     static gmx_bool    bTen       = FALSE;
     static gmx_bool    bMW        = TRUE;
     static gmx_bool    bRmCOMM    = FALSE;
+    static gmx_bool    bFFT       = FALSE;
+    static int         maxmem     = 2048;
+    static int         nthreads   = 0;
     t_pargs            pa[]       = {
         { "-type",    FALSE, etENUM, {normtype},
           "Compute diffusion coefficient in one direction" },
@@ -1103,7 +1753,15 @@ int gmx_msd(int argc, char *argv[])
         { "-beginfit", FALSE, etTIME, {&beginfit},
           "Start time for fitting the MSD (%t), -1 is 10%" },
         { "-endfit", FALSE, etTIME, {&endfit},
-          "End time for fitting the MSD (%t), -1 is 90%" }
+          "End time for fitting the MSD (%t), -1 is 90%" },
+        { "-fft", FALSE, etBOOL, {&bFFT},
+          "Use all frames as reference points and compute the MSD with FFTs" },
+        { "-maxmem", FALSE, etINT, {&maxmem},
+          "Maximum memory (MB) for the stored coordinates with [TT]-fft[tt], 0 is unlimited" },
+#ifdef GMX_OPENMP
+        { "-nt", FALSE, etINT, {&nthreads},
+          "Number of threads to start" },
+#endif
     };
 
     t_filenm           fnm[] = {
@@ -1127,12 +1785,15 @@ int gmx_msd(int argc, char *argv[])
     real            dim_factor;
     output_env_t    oenv;
 
+    nthreads = gmx_omp_get_max_threads();
+
     if (!parse_common_args(&argc, argv,
                            PCA_CAN_VIEW | PCA_CAN_BEGIN | PCA_CAN_END | PCA_TIME_UNIT | PCA_BE_NICE,
                            NFILE, fnm, asize(pa), pa, asize(desc), desc, 0, NULL, &oenv))
     {
         return 0;
     }
+    gmx_omp_set_num_threads(nthreads);
     trx_file = ftp2fn_null(efTRX, NFILE, fnm);
     tps_file = ftp2fn_null(efTPS, NFILE, fnm);
     ndx_file = ftp2fn_null(efNDX, NFILE, fnm);
@@ -1199,8 +1860,8 @@ int gmx_msd(int argc, char *argv[])
     }
 
     do_corr(trx_file, ndx_file, msd_file, mol_file, pdb_file, t_pdb, ngroup,
-            &top, ePBC, bTen, bMW, bRmCOMM, type, dim_factor, axis, dt, beginfit, endfit,
-            oenv);
+            &top, ePBC, bTen, bMW, bRmCOMM, type, dim_factor, axis, dt,
+            bFFT, maxmem, beginfit, endfit, oenv);
 
     view_all(oenv, NFILE, fnm);
 
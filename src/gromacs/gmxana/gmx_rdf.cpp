@@ -41,6 +41,8 @@
 
 #include <math.h>
 
+#include <algorithm>
+
 #include "typedefs.h"
 #include "macros.h"
 #include "gromacs/math/vec.h"
@@ -60,7 +62,10 @@
 #include "gromacs/commandline/pargs.h"
 #include "gromacs/fileio/xvgr.h"
 #include "gromacs/pbcutil/rmpbc.h"
+#include "gromacs/selection/nbsearch.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/smalloc.h"
 
 static void check_box_c(matrix box)
@@ -175,39 +180,52 @@ static void split_group(int isize, int *index, char *grpname,
     *coi_out = coi;
 }
 
+/* Returns whether atom j is in the exclusion list of atom i */
+static gmx_bool is_excluded(const t_blocka *excl, atom_id i, atom_id j)
+{
+    int k;
+
+    for (k = excl->index[i]; k < excl->index[i+1]; k++)
+    {
+        if (excl->a[k] == j)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
 static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
                    const char *fnRDF, const char *fnCNRDF, const char *fnHQ,
                    gmx_bool bCM, const char *close,
                    const char **rdft, gmx_bool bXY, gmx_bool bPBC, gmx_bool bNormalize,
-                   real cutoff, real binwidth, real fade, int ng,
+                   real cutoff, real rmax, real binwidth, real fade, int ng,
                    const output_env_t oenv)
 {
     FILE          *fp;
     t_trxstatus   *status;
-    char           outf1[STRLEN], outf2[STRLEN];
     char           title[STRLEN], gtitle[STRLEN], refgt[30];
-    int            g, natoms, i, ii, j, k, nbin, j0, j1, n, nframes;
-    int          **count;
+    int            g, natoms, i, ii, j, nbin, nframes;
+    int          **count, ***count_t;
     char         **grpname;
-    int           *isize, isize_cm = 0, nrdf = 0, max_i, isize0, isize_g;
-    atom_id      **index, *index_cm = NULL;
+    int           *isize, nrdf = 0, max_i, isize0, isize_g;
+    atom_id      **index;
     gmx_int64_t   *sum;
     real           t, rmax2, cut2, r, r2, r2ii, invhbinw, normfac;
     real           segvol, spherevol, prev_spherevol, **rdf;
-    rvec          *x, dx, *x0 = NULL, *x_i1, xi;
+    rvec          *x, dx, *x0 = NULL, *x_i1;
     real          *inv_segvol, invvol, invvol_sum, rho;
-    gmx_bool       bClose, *bExcl, bTop, bNonSelfExcl;
+    gmx_bool       bClose, bTop, bExclusions;
     matrix         box, box_pbc;
-    int          **npairs;
-    atom_id        ix, jx, ***pairs;
     t_topology    *top  = NULL;
     int            ePBC = -1, ePBCrdf = -1;
-    t_block       *mols = NULL;
     t_blocka      *excl;
     t_atom        *atom = NULL;
     t_pbc          pbc;
     gmx_rmpbc_t    gpbc = NULL;
-    int           *is   = NULL, **coi = NULL, cur, mol, i1, res, a;
+    int           *is   = NULL, **coi = NULL;
+    int            nthreads, th;
 
     excl = NULL;
 
@@ -325,7 +343,7 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
                 break;
         }
         /* Make sure the z-height does not influence the cut-off */
-        box_pbc[ZZ][ZZ] = 2*max(box[XX][XX], box[YY][YY]);
+        box_pbc[ZZ][ZZ] = 2*std::max(box[XX][XX], box[YY][YY]);
     }
     else
     {
@@ -337,7 +355,11 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
     }
     else
     {
-        rmax2   = sqr(3*max(box[XX][XX], max(box[YY][YY], box[ZZ][ZZ])));
+        rmax2   = sqr(3*std::max(box[XX][XX], std::max(box[YY][YY], box[ZZ][ZZ])));
+    }
+    if (rmax > 0 && sqr(rmax) < rmax2)
+    {
+        rmax2 = sqr(rmax);
     }
     if (debug)
     {
@@ -351,11 +373,12 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
     invhbinw = 2.0 / binwidth;
     cut2     = sqr(cutoff);
 
-    snew(count, ng);
-    snew(pairs, ng);
-    snew(npairs, ng);
+    /* We can only have exclusions with atomic rdfs */
+    bExclusions = (excl != NULL && !(bCM || bClose || rdft[0][0] != 'a'));
 
-    snew(bExcl, natoms);
+    nthreads = gmx_omp_get_max_threads();
+    snew(count, ng);
+    snew(count_t, nthreads);
     max_i = 0;
     for (g = 0; g < ng; g++)
     {
@@ -366,63 +389,24 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
 
         /* this is THE array */
         snew(count[g], nbin+1);
-
-        /* make pairlist array for groups and exclusions */
-        snew(pairs[g], isize[0]);
-        snew(npairs[g], isize[0]);
-        for (i = 0; i < isize[0]; i++)
+    }
+    /* Each thread histograms in its own count array, thread 0 uses count */
+    count_t[0] = count;
+    for (th = 1; th < nthreads; th++)
+    {
+        snew(count_t[th], ng);
+        for (g = 0; g < ng; g++)
         {
-            /* We can only have exclusions with atomic rdfs */
-            if (!(bCM || bClose || rdft[0][0] != 'a'))
-            {
-                ix = index[0][i];
-                for (j = 0; j < natoms; j++)
-                {
-                    bExcl[j] = FALSE;
-                }
-                /* exclusions? */
-                if (excl)
-                {
-                    for (j = excl->index[ix]; j < excl->index[ix+1]; j++)
-                    {
-                        bExcl[excl->a[j]] = TRUE;
-                    }
-                }
-                k = 0;
-                snew(pairs[g][i], isize[g+1]);
-                bNonSelfExcl = FALSE;
-                for (j = 0; j < isize[g+1]; j++)
-                {
-                    jx = index[g+1][j];
-                    if (!bExcl[jx])
-                    {
-                        pairs[g][i][k++] = jx;
-                    }
-                    else if (ix != jx)
-                    {
-                        /* Check if we have exclusions other than self exclusions */
-                        bNonSelfExcl = TRUE;
-                    }
-                }
-                if (bNonSelfExcl)
-                {
-                    npairs[g][i] = k;
-                    srenew(pairs[g][i], npairs[g][i]);
-                }
-                else
-                {
-                    /* Save a LOT of memory and some cpu cycles */
-                    npairs[g][i] = -1;
-                    sfree(pairs[g][i]);
-                }
-            }
-            else
-            {
-                npairs[g][i] = -1;
-            }
+            snew(count_t[th][g], nbin+1);
         }
     }
-    sfree(bExcl);
+
+    /* The pair search only returns pairs within rmax, with a grid when
+     * rmax is sufficiently small compared to the box. With -xy we need
+     * all pairs, since the search cut-off applies to the 3D distance.
+     */
+    gmx::AnalysisNeighborhood nb;
+    nb.setCutoff(bXY ? 0 : sqrt(rmax2));
 
     snew(x_i1, max_i);
     nframes    = 0;
@@ -484,21 +468,22 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
                 calc_comg(is[g+1], coi[g+1], index[g+1], rdft[0][6] == 'm', atom, x, x_i1);
             }
 
-            for (i = 0; i < isize0; i++)
+            if (rdft[0][0] == 'a')
+            {
+                isize_g = isize[g+1];
+            }
+            else
+            {
+                isize_g = is[g+1];
+            }
+
+            if (bClose)
             {
-                if (bClose)
+                for (i = 0; i < isize0; i++)
                 {
                     /* Special loop, since we need to determine the minimum distance
                      * over all selected atoms in the reference molecule/residue.
                      */
-                    if (rdft[0][0] == 'a')
-                    {
-                        isize_g = isize[g+1];
-                    }
-                    else
-                    {
-                        isize_g = is[g+1];
-                    }
                     for (j = 0; j < isize_g; j++)
                     {
                         r2 = 1e30;
@@ -532,66 +517,52 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
                         }
                     }
                 }
-                else
+            }
+            else
+            {
+                /* Real rdf between points in space */
+                gmx::AnalysisNeighborhoodSearch nbsearch =
+                    nb.initSearch(bPBC ? &pbc : NULL,
+                                  gmx::AnalysisNeighborhoodPositions(x_i1, isize_g));
+
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic, 64)
+                for (int i = 0; i < isize0; i++)
                 {
-                    /* Real rdf between points in space */
-                    if (bCM || rdft[0][0] != 'a')
-                    {
-                        copy_rvec(x0[i], xi);
-                    }
-                    else
+                    try
                     {
-                        copy_rvec(x[index[0][i]], xi);
-                    }
-                    if (rdft[0][0] == 'a' && npairs[g][i] >= 0)
-                    {
-                        /* Expensive loop, because of indexing */
-                        for (j = 0; j < npairs[g][i]; j++)
-                        {
-                            jx = pairs[g][i][j];
-                            if (bPBC)
-                            {
-                                pbc_dx(&pbc, xi, x[jx], dx);
-                            }
-                            else
-                            {
-                                rvec_sub(xi, x[jx], dx);
-                            }
+                        int        *count_g = count_t[gmx_omp_get_thread_num()][g];
+                        const rvec *xi;
+                        rvec        dx;
+                        real        r2;
 
-                            if (bXY)
-                            {
-                                r2 = dx[XX]*dx[XX] + dx[YY]*dx[YY];
-                            }
-                            else
-                            {
-                                r2 = iprod(dx, dx);
-                            }
-                            if (r2 > cut2 && r2 <= rmax2)
-                            {
-                                count[g][(int)(sqrt(r2)*invhbinw)]++;
-                            }
-                        }
-                    }
-                    else
-                    {
-                        /* Cheaper loop, no exclusions */
-                        if (rdft[0][0] == 'a')
+                        if (bCM || rdft[0][0] != 'a')
                         {
-                            isize_g = isize[g+1];
+                            xi = &x0[i];
                         }
                         else
                         {
-                            isize_g = is[g+1];
+                            xi = &x[index[0][i]];
                         }
-                        for (j = 0; j < isize_g; j++)
+
+                        gmx::AnalysisNeighborhoodPairSearch pairSearch =
+                            nbsearch.startPairSearch(*xi);
+                        gmx::AnalysisNeighborhoodPair       pair;
+                        while (pairSearch.findNextPair(&pair))
                         {
+                            int j = pair.refIndex();
+
+                            if (bExclusions &&
+                                is_excluded(excl, index[0][i], index[g+1][j]))
+                            {
+                                continue;
+                            }
                             if (bPBC)
                             {
-                                pbc_dx(&pbc, xi, x_i1[j], dx);
+                                pbc_dx(&pbc, *xi, x_i1[j], dx);
                             }
                             else
                             {
-                                rvec_sub(xi, x_i1[j], dx);
+                                rvec_sub(*xi, x_i1[j], dx);
                             }
                             if (bXY)
                             {
@@ -603,10 +574,11 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
                             }
                             if (r2 > cut2 && r2 <= rmax2)
                             {
-                                count[g][(int)(sqrt(r2)*invhbinw)]++;
+                                count_g[(int)(sqrt(r2)*invhbinw)]++;
                             }
                         }
                     }
+                    GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
                 }
             }
         }
@@ -615,6 +587,21 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
     while (read_next_x(oenv, status, &t, x, box));
     fprintf(stderr, "\n");
 
+    /* Reduce the thread histograms */
+    for (th = 1; th < nthreads; th++)
+    {
+        for (g = 0; g < ng; g++)
+        {
+            for (i = 0; i < nbin+1; i++)
+            {
+                count[g][i] += count_t[th][g][i];
+            }
+            sfree(count_t[th][g]);
+        }
+        sfree(count_t[th]);
+    }
+    sfree(count_t);
+
     if (bPBC && (NULL != top))
     {
         gmx_rmpbc_done(gpbc);
@@ -660,7 +647,7 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
         }
 
         /* Do the normalization */
-        nrdf = max((nbin+1)/2, 1+2*fade/binwidth);
+        nrdf = static_cast<int>(std::max(static_cast<real>((nbin+1)/2), 1+2*fade/binwidth));
         snew(rdf[g], nrdf);
         for (i = 0; i < (nbin+1)/2; i++)
         {
@@ -861,11 +848,16 @@ int gmx_rdf(int argc, char *argv[])
         "Note that all atoms in the selected groups are used, also the ones",
         "that don't have Lennard-Jones interactions.[PAR]",
         "Option [TT]-cn[tt] produces the cumulative number RDF,",
-        "i.e. the average number of particles within a distance r.[PAR]"
+        "i.e. the average number of particles within a distance r.[PAR]",
+        "The pairs are searched with a grid when the maximum distance is",
+        "small compared to the box. By default the maximum distance is half",
+        "the shortest box vector, with [TT]-rmax[tt] a shorter one can be",
+        "set, which reduces the cost of the pair search."
     };
     static gmx_bool    bCM     = FALSE, bXY = FALSE, bPBC = TRUE, bNormalize = TRUE;
-    static real        cutoff  = 0, binwidth = 0.002, fade = 0.0;
+    static real        cutoff  = 0, rmax = 0, binwidth = 0.002, fade = 0.0;
     static int         ngroups = 1;
+    static int         nthreads = 0;
 
     static const char *closet[] = { NULL, "no", "mol", "res", NULL };
     static const char *rdft[]   = { NULL, "atom", "mol_com", "mol_cog", "res_com", "res_cog", NULL };
@@ -887,10 +879,16 @@ int gmx_rdf(int argc, char *argv[])
           "Use only the x and y components of the distance" },
         { "-cut",      FALSE, etREAL, {&cutoff},
           "Shortest distance (nm) to be considered"},
+        { "-rmax",     FALSE, etREAL, {&rmax},
+          "Largest distance (nm) to be considered, 0 is half the box"},
         { "-ng",       FALSE, etINT, {&ngroups},
           "Number of secondary groups to compute RDFs around a central group" },
         { "-fade",     FALSE, etREAL, {&fade},
-          "From this distance onwards the RDF is tranformed by g'(r) = 1 + [g(r)-1] exp(-(r/fade-1)^2 to make it go to 1 smoothly. If fade is 0.0 nothing is done." }
+          "From this distance onwards the RDF is tranformed by g'(r) = 1 + [g(r)-1] exp(-(r/fade-1)^2 to make it go to 1 smoothly. If fade is 0.0 nothing is done." },
+#ifdef GMX_OPENMP
+        { "-nt",       FALSE, etINT, {&nthreads},
+          "Number of threads to start"},
+#endif
     };
 #define NPA asize(pa)
     const char        *fnTPS, *fnNDX;
@@ -905,6 +903,9 @@ int gmx_rdf(int argc, char *argv[])
         { efXVG, "-hq", "hq",     ffOPTWR },
     };
 #define NFILE asize(fnm)
+
+    nthreads = gmx_omp_get_max_threads();
+
     if (!parse_common_args(&argc, argv, PCA_CAN_VIEW | PCA_CAN_TIME | PCA_BE_NICE,
                            NFILE, fnm, NPA, pa, asize(desc), desc, 0, NULL, &oenv))
     {
@@ -921,6 +922,8 @@ int gmx_rdf(int argc, char *argv[])
     }
     fnNDX = ftp2fn_null(efNDX, NFILE, fnm);
 
+    gmx_omp_set_num_threads(nthreads);
+
     if (!fnTPS && !fnNDX)
     {
         gmx_fatal(FARGS, "Neither index file nor topology file specified\n"
@@ -943,7 +946,7 @@ int gmx_rdf(int argc, char *argv[])
     do_rdf(fnNDX, fnTPS, ftp2fn(efTRX, NFILE, fnm),
            opt2fn("-o", NFILE, fnm), opt2fn_null("-cn", NFILE, fnm),
            opt2fn_null("-hq", NFILE, fnm),
-           bCM, closet[0], rdft, bXY, bPBC, bNormalize, cutoff, binwidth, fade, ngroups,
+           bCM, closet[0], rdft, bXY, bPBC, bNormalize, cutoff, rmax, binwidth, fade, ngroups,
            oenv);
 
     return 0;
@@ -1388,6 +1388,197 @@ real urey_bradley(int nbonds,
     return vtot;
 }
 
+#ifdef GMX_SIMD_HAVE_REAL
+
+/* As urey_bradley, but using SIMD to calculate many angles at once.
+ * This routine does not calculate energies, shift forces and dvdl.
+ */
+static void
+urey_bradley_noener_simd(int nbonds,
+                         const t_iatom forceatoms[], const t_iparams forceparams[],
+                         const rvec x[], rvec f[],
+                         const t_pbc *pbc, const t_graph gmx_unused *g,
+                         real gmx_unused lambda,
+                         const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+                         int gmx_unused *global_atom_index)
+{
+    const int            nfa1 = 4;
+    int                  i, iu, s, m;
+    int                  type, ai[GMX_SIMD_REAL_WIDTH], aj[GMX_SIMD_REAL_WIDTH];
+    int                  ak[GMX_SIMD_REAL_WIDTH];
+    real                 coeff_array[4*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *coeff;
+    real                 dr_array[2*DIM*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *dr;
+    real                 f_buf_array[6*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *f_buf;
+    gmx_simd_real_t      k_S, theta0_S, kUB_S, r13_S;
+    gmx_simd_real_t      rijx_S, rijy_S, rijz_S;
+    gmx_simd_real_t      rkjx_S, rkjy_S, rkjz_S;
+    gmx_simd_real_t      rikx_S, riky_S, rikz_S;
+    gmx_simd_real_t      one_S;
+    gmx_simd_real_t      min_one_plus_eps_S;
+    gmx_simd_real_t      dr2_min_S;
+    gmx_simd_real_t      rij_rkj_S;
+    gmx_simd_real_t      nrij2_S, nrij_1_S;
+    gmx_simd_real_t      nrkj2_S, nrkj_1_S;
+    gmx_simd_real_t      nrik2_S, nrik_1_S;
+    gmx_simd_real_t      cos_S, invsin_S;
+    gmx_simd_real_t      theta_S;
+    gmx_simd_real_t      st_S, sth_S;
+    gmx_simd_real_t      cik_S, cii_S, ckk_S;
+    gmx_simd_real_t      fbond_S;
+    gmx_simd_real_t      f_ix_S, f_iy_S, f_iz_S;
+    gmx_simd_real_t      f_kx_S, f_ky_S, f_kz_S;
+    pbc_simd_t           pbc_simd;
+
+    /* Ensure register memory alignment */
+    coeff = gmx_simd_align_r(coeff_array);
+    dr    = gmx_simd_align_r(dr_array);
+    f_buf = gmx_simd_align_r(f_buf_array);
+
+    set_pbc_simd(pbc, &pbc_simd);
+
+    one_S = gmx_simd_set1_r(1.0);
+
+    /* The smallest number > -1 */
+    min_one_plus_eps_S = gmx_simd_set1_r(-1.0 + 2*GMX_REAL_EPS);
+
+    /* Used to avoid division by zero for the 1-3 distance,
+     * the bond force is multiplied by the distance vector.
+     */
+    dr2_min_S          = gmx_simd_set1_r(GMX_REAL_MIN);
+
+    /* nbonds is the number of angles times nfa1, here we step GMX_SIMD_REAL_WIDTH angles */
+    for (i = 0; (i < nbonds); i += GMX_SIMD_REAL_WIDTH*nfa1)
+    {
+        /* Collect atoms for GMX_SIMD_REAL_WIDTH angles.
+         * iu indexes into forceatoms, we should not let iu go beyond nbonds.
+         */
+        iu = i;
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            type  = forceatoms[iu];
+            ai[s] = forceatoms[iu+1];
+            aj[s] = forceatoms[iu+2];
+            ak[s] = forceatoms[iu+3];
+
+            coeff[                      s] = forceparams[type].u_b.kthetaA;
+            coeff[  GMX_SIMD_REAL_WIDTH+s] = forceparams[type].u_b.thetaA*DEG2RAD;
+            coeff[2*GMX_SIMD_REAL_WIDTH+s] = forceparams[type].u_b.kUBA;
+            coeff[3*GMX_SIMD_REAL_WIDTH+s] = forceparams[type].u_b.r13A;
+
+            /* Store the non PBC corrected distances packed and aligned */
+            for (m = 0; m < DIM; m++)
+            {
+                dr[s +      m *GMX_SIMD_REAL_WIDTH] = x[ai[s]][m] - x[aj[s]][m];
+                dr[s + (DIM+m)*GMX_SIMD_REAL_WIDTH] = x[ak[s]][m] - x[aj[s]][m];
+            }
+
+            /* At the end fill the arrays with identical entries */
+            if (iu + nfa1 < nbonds)
+            {
+                iu += nfa1;
+            }
+        }
+
+        k_S       = gmx_simd_load_r(coeff);
+        theta0_S  = gmx_simd_load_r(coeff+GMX_SIMD_REAL_WIDTH);
+        kUB_S     = gmx_simd_load_r(coeff+2*GMX_SIMD_REAL_WIDTH);
+        r13_S     = gmx_simd_load_r(coeff+3*GMX_SIMD_REAL_WIDTH);
+
+        rijx_S    = gmx_simd_load_r(dr + 0*GMX_SIMD_REAL_WIDTH);
+        rijy_S    = gmx_simd_load_r(dr + 1*GMX_SIMD_REAL_WIDTH);
+        rijz_S    = gmx_simd_load_r(dr + 2*GMX_SIMD_REAL_WIDTH);
+        rkjx_S    = gmx_simd_load_r(dr + 3*GMX_SIMD_REAL_WIDTH);
+        rkjy_S    = gmx_simd_load_r(dr + 4*GMX_SIMD_REAL_WIDTH);
+        rkjz_S    = gmx_simd_load_r(dr + 5*GMX_SIMD_REAL_WIDTH);
+
+        pbc_dx_simd(&rijx_S, &rijy_S, &rijz_S, &pbc_simd);
+        pbc_dx_simd(&rkjx_S, &rkjy_S, &rkjz_S, &pbc_simd);
+
+        /* The 1-3 vector, this is PBC corrected through r_ij and r_kj */
+        rikx_S    = gmx_simd_sub_r(rijx_S, rkjx_S);
+        riky_S    = gmx_simd_sub_r(rijy_S, rkjy_S);
+        rikz_S    = gmx_simd_sub_r(rijz_S, rkjz_S);
+
+        rij_rkj_S = gmx_simd_iprod_r(rijx_S, rijy_S, rijz_S,
+                                     rkjx_S, rkjy_S, rkjz_S);
+
+        nrij2_S   = gmx_simd_norm2_r(rijx_S, rijy_S, rijz_S);
+        nrkj2_S   = gmx_simd_norm2_r(rkjx_S, rkjy_S, rkjz_S);
+        nrik2_S   = gmx_simd_norm2_r(rikx_S, riky_S, rikz_S);
+
+        nrij_1_S  = gmx_simd_invsqrt_r(nrij2_S);
+        nrkj_1_S  = gmx_simd_invsqrt_r(nrkj2_S);
+        nrik_1_S  = gmx_simd_invsqrt_r(gmx_simd_max_r(nrik2_S, dr2_min_S));
+
+        cos_S     = gmx_simd_mul_r(rij_rkj_S, gmx_simd_mul_r(nrij_1_S, nrkj_1_S));
+
+        /* As in angles_noener_simd, we allow for 180 degrees */
+        cos_S     = gmx_simd_max_r(cos_S, min_one_plus_eps_S);
+
+        theta_S   = gmx_simd_acos_r(cos_S);
+
+        invsin_S  = gmx_simd_invsqrt_r(gmx_simd_sub_r(one_S, gmx_simd_mul_r(cos_S, cos_S)));
+
+        st_S      = gmx_simd_mul_r(gmx_simd_mul_r(k_S, gmx_simd_sub_r(theta0_S, theta_S)),
+                                   invsin_S);
+        sth_S     = gmx_simd_mul_r(st_S, cos_S);
+
+        cik_S     = gmx_simd_mul_r(st_S,  gmx_simd_mul_r(nrij_1_S, nrkj_1_S));
+        cii_S     = gmx_simd_mul_r(sth_S, gmx_simd_mul_r(nrij_1_S, nrij_1_S));
+        ckk_S     = gmx_simd_mul_r(sth_S, gmx_simd_mul_r(nrkj_1_S, nrkj_1_S));
+
+        /* The 1-3 harmonic bond force divided by the distance */
+        fbond_S   = gmx_simd_mul_r(kUB_S,
+                                   gmx_simd_fnmadd_r(nrik2_S, nrik_1_S, r13_S));
+        fbond_S   = gmx_simd_mul_r(fbond_S, nrik_1_S);
+
+        f_ix_S    = gmx_simd_mul_r(cii_S, rijx_S);
+        f_ix_S    = gmx_simd_fnmadd_r(cik_S, rkjx_S, f_ix_S);
+        f_iy_S    = gmx_simd_mul_r(cii_S, rijy_S);
+        f_iy_S    = gmx_simd_fnmadd_r(cik_S, rkjy_S, f_iy_S);
+        f_iz_S    = gmx_simd_mul_r(cii_S, rijz_S);
+        f_iz_S    = gmx_simd_fnmadd_r(cik_S, rkjz_S, f_iz_S);
+        f_kx_S    = gmx_simd_mul_r(ckk_S, rkjx_S);
+        f_kx_S    = gmx_simd_fnmadd_r(cik_S, rijx_S, f_kx_S);
+        f_ky_S    = gmx_simd_mul_r(ckk_S, rkjy_S);
+        f_ky_S    = gmx_simd_fnmadd_r(cik_S, rijy_S, f_ky_S);
+        f_kz_S    = gmx_simd_mul_r(ckk_S, rkjz_S);
+        f_kz_S    = gmx_simd_fnmadd_r(cik_S, rijz_S, f_kz_S);
+
+        /* Add the bond force, which acts along r_ik */
+        f_ix_S    = gmx_simd_fmadd_r(fbond_S, rikx_S, f_ix_S);
+        f_iy_S    = gmx_simd_fmadd_r(fbond_S, riky_S, f_iy_S);
+        f_iz_S    = gmx_simd_fmadd_r(fbond_S, rikz_S, f_iz_S);
+        f_kx_S    = gmx_simd_fnmadd_r(fbond_S, rikx_S, f_kx_S);
+        f_ky_S    = gmx_simd_fnmadd_r(fbond_S, riky_S, f_ky_S);
+        f_kz_S    = gmx_simd_fnmadd_r(fbond_S, rikz_S, f_kz_S);
+
+        gmx_simd_store_r(f_buf + 0*GMX_SIMD_REAL_WIDTH, f_ix_S);
+        gmx_simd_store_r(f_buf + 1*GMX_SIMD_REAL_WIDTH, f_iy_S);
+        gmx_simd_store_r(f_buf + 2*GMX_SIMD_REAL_WIDTH, f_iz_S);
+        gmx_simd_store_r(f_buf + 3*GMX_SIMD_REAL_WIDTH, f_kx_S);
+        gmx_simd_store_r(f_buf + 4*GMX_SIMD_REAL_WIDTH, f_ky_S);
+        gmx_simd_store_r(f_buf + 5*GMX_SIMD_REAL_WIDTH, f_kz_S);
+
+        iu = i;
+        s  = 0;
+        do
+        {
+            for (m = 0; m < DIM; m++)
+            {
+                f[ai[s]][m] += f_buf[s + m*GMX_SIMD_REAL_WIDTH];
+                f[aj[s]][m] -= f_buf[s + m*GMX_SIMD_REAL_WIDTH] + f_buf[s + (DIM+m)*GMX_SIMD_REAL_WIDTH];
+                f[ak[s]][m] += f_buf[s + (DIM+m)*GMX_SIMD_REAL_WIDTH];
+            }
+            s++;
+            iu += nfa1;
+        }
+        while (s < GMX_SIMD_REAL_WIDTH && iu < nbonds);
+    }
+}
+
+#endif /* GMX_SIMD_HAVE_REAL */
+
 real quartic_angles(int nbonds,
                     const t_iatom forceatoms[], const t_iparams forceparams[],
                     const rvec x[], rvec f[], rvec fshift[],
@@ -2095,6 +2286,66 @@ pdihs_noener_simd(int nbonds,
     }
 }
 
+/* Returns the number of interactions, at most GMX_SIMD_REAL_WIDTH,
+ * that start at index i in a forceatoms list of length nbonds
+ * with nfa1 entries per interaction.
+ */
+static gmx_inline int
+simd_nlanes(int i, int nbonds, int nfa1)
+{
+    int n;
+
+    n = (nbonds - i)/nfa1;
+
+    return (n < GMX_SIMD_REAL_WIDTH ? n : GMX_SIMD_REAL_WIDTH);
+}
+
+/* Spreads the forces of nlanes dihedrals with angles calculated
+ * by dih_angle_simd. mddphi_S is minus the derivative of the potential
+ * with respect to the dihedral angle, the other arguments are the output
+ * of dih_angle_simd. dr is used as buffer and should be register aligned.
+ */
+static gmx_inline void
+do_dih_fup_noshiftf_simd(int nlanes,
+                         const int *ai, const int *aj,
+                         const int *ak, const int *al,
+                         gmx_simd_real_t mddphi_S,
+                         gmx_simd_real_t mx_S, gmx_simd_real_t my_S, gmx_simd_real_t mz_S,
+                         gmx_simd_real_t nx_S, gmx_simd_real_t ny_S, gmx_simd_real_t nz_S,
+                         gmx_simd_real_t nrkj_m2_S, gmx_simd_real_t nrkj_n2_S,
+                         const real *p, const real *q,
+                         real *dr,
+                         rvec f[])
+{
+    int             s;
+    gmx_simd_real_t sf_i_S, msf_l_S;
+
+    sf_i_S   = gmx_simd_mul_r(mddphi_S, nrkj_m2_S);
+    msf_l_S  = gmx_simd_mul_r(mddphi_S, nrkj_n2_S);
+
+    /* f[i] */
+    gmx_simd_store_r(dr + 0*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(sf_i_S, mx_S));
+    gmx_simd_store_r(dr + 1*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(sf_i_S, my_S));
+    gmx_simd_store_r(dr + 2*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(sf_i_S, mz_S));
+    /* -f[l] */
+    gmx_simd_store_r(dr + 3*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(msf_l_S, nx_S));
+    gmx_simd_store_r(dr + 4*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(msf_l_S, ny_S));
+    gmx_simd_store_r(dr + 5*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(msf_l_S, nz_S));
+
+    for (s = 0; s < nlanes; s++)
+    {
+        do_dih_fup_noshiftf_precalc(ai[s], aj[s], ak[s], al[s],
+                                    p[s], q[s],
+                                    dr[     XX *GMX_SIMD_REAL_WIDTH+s],
+                                    dr[     YY *GMX_SIMD_REAL_WIDTH+s],
+                                    dr[     ZZ *GMX_SIMD_REAL_WIDTH+s],
+                                    dr[(DIM+XX)*GMX_SIMD_REAL_WIDTH+s],
+                                    dr[(DIM+YY)*GMX_SIMD_REAL_WIDTH+s],
+                                    dr[(DIM+ZZ)*GMX_SIMD_REAL_WIDTH+s],
+                                    f);
+    }
+}
+
 #endif /* GMX_SIMD_HAVE_REAL */
 
 
@@ -2169,6 +2420,104 @@ real idihs(int nbonds,
     return vtot;
 }
 
+#ifdef GMX_SIMD_HAVE_REAL
+
+/* As idihs, but using SIMD to calculate many dihedrals at once.
+ * This routine does not calculate energies, shift forces and dvdl.
+ */
+static void
+idihs_noener_simd(int nbonds,
+                  const t_iatom forceatoms[], const t_iparams forceparams[],
+                  const rvec x[], rvec f[],
+                  const t_pbc *pbc, const t_graph gmx_unused *g,
+                  real gmx_unused lambda,
+                  const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+                  int gmx_unused *global_atom_index)
+{
+    const int             nfa1 = 5;
+    int                   i, iu, s;
+    int                   type, ai[GMX_SIMD_REAL_WIDTH], aj[GMX_SIMD_REAL_WIDTH], ak[GMX_SIMD_REAL_WIDTH], al[GMX_SIMD_REAL_WIDTH];
+    real                  dr_array[3*DIM*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *dr;
+    real                  buf_array[4*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *buf;
+    real                 *kk, *phi0, *p, *q;
+    gmx_simd_real_t       phi_S, dp_S;
+    gmx_simd_real_t       mx_S, my_S, mz_S;
+    gmx_simd_real_t       nx_S, ny_S, nz_S;
+    gmx_simd_real_t       nrkj_m2_S, nrkj_n2_S;
+    gmx_simd_real_t       twopi_S, inv_twopi_S;
+    gmx_simd_real_t       mddphi_S;
+    pbc_simd_t            pbc_simd;
+
+    /* Ensure SIMD register alignment */
+    dr  = gmx_simd_align_r(dr_array);
+    buf = gmx_simd_align_r(buf_array);
+
+    /* Extract aligned pointer for parameters and variables */
+    kk    = buf + 0*GMX_SIMD_REAL_WIDTH;
+    phi0  = buf + 1*GMX_SIMD_REAL_WIDTH;
+    p     = buf + 2*GMX_SIMD_REAL_WIDTH;
+    q     = buf + 3*GMX_SIMD_REAL_WIDTH;
+
+    set_pbc_simd(pbc, &pbc_simd);
+
+    twopi_S     = gmx_simd_set1_r(2*M_PI);
+    inv_twopi_S = gmx_simd_set1_r(1/(2*M_PI));
+
+    /* nbonds is the number of dihedrals times nfa1, here we step GMX_SIMD_REAL_WIDTH dihs */
+    for (i = 0; (i < nbonds); i += GMX_SIMD_REAL_WIDTH*nfa1)
+    {
+        /* Collect atoms quadruplets for GMX_SIMD_REAL_WIDTH dihedrals.
+         * iu indexes into forceatoms, we should not let iu go beyond nbonds.
+         */
+        iu = i;
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            type  = forceatoms[iu];
+            ai[s] = forceatoms[iu+1];
+            aj[s] = forceatoms[iu+2];
+            ak[s] = forceatoms[iu+3];
+            al[s] = forceatoms[iu+4];
+
+            kk[s]   = forceparams[type].harmonic.krA;
+            phi0[s] = forceparams[type].harmonic.rA*DEG2RAD;
+
+            /* At the end fill the arrays with identical entries */
+            if (iu + nfa1 < nbonds)
+            {
+                iu += nfa1;
+            }
+        }
+
+        /* Caclulate GMX_SIMD_REAL_WIDTH dihedral angles at once */
+        dih_angle_simd(x, ai, aj, ak, al, &pbc_simd,
+                       dr,
+                       &phi_S,
+                       &mx_S, &my_S, &mz_S,
+                       &nx_S, &ny_S, &nz_S,
+                       &nrkj_m2_S,
+                       &nrkj_n2_S,
+                       p, q);
+
+        /* Put phi - phi0 in (-pi, pi), as make_dp_periodic does */
+        dp_S     = gmx_simd_sub_r(phi_S, gmx_simd_load_r(phi0));
+        dp_S     = gmx_simd_fnmadd_r(twopi_S,
+                                     gmx_simd_round_r(gmx_simd_mul_r(dp_S, inv_twopi_S)),
+                                     dp_S);
+
+        mddphi_S = gmx_simd_mul_r(gmx_simd_load_r(kk), dp_S);
+        mddphi_S = gmx_simd_sub_r(gmx_simd_setzero_r(), mddphi_S);
+
+        do_dih_fup_noshiftf_simd(simd_nlanes(i, nbonds, nfa1),
+                                 ai, aj, ak, al,
+                                 mddphi_S,
+                                 mx_S, my_S, mz_S, nx_S, ny_S, nz_S,
+                                 nrkj_m2_S, nrkj_n2_S,
+                                 p, q, dr, f);
+    }
+}
+
+#endif /* GMX_SIMD_HAVE_REAL */
+
 
 /*! \brief returns dx, rdist, and dpdl for functions posres() and fbposres()
  */
@@ -2769,30 +3118,169 @@ real restrangles(int nbonds,
     return vtot;
 }
 
+#ifdef GMX_SIMD_HAVE_REAL
 
-real restrdihs(int nbonds,
-               const t_iatom forceatoms[], const t_iparams forceparams[],
-               const rvec x[], rvec f[], rvec fshift[],
-               const t_pbc *pbc, const t_graph *g,
-               real gmx_unused lambda, real gmx_unused *dvlambda,
-               const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
-               int gmx_unused *global_atom_index)
+/* As restrangles, but using SIMD to calculate many angles at once.
+ * This routine does not calculate energies and shift forces.
+ */
+static void
+restrangles_noener_simd(int nbonds,
+                        const t_iatom forceatoms[], const t_iparams forceparams[],
+                        const rvec x[], rvec f[],
+                        const t_pbc *pbc, const t_graph gmx_unused *g,
+                        real gmx_unused lambda,
+                        const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+                        int gmx_unused *global_atom_index)
 {
-    int  i, d, type, ai, aj, ak, al;
-    rvec f_i, f_j, f_k, f_l;
-    rvec dx_jl;
-    ivec jt, dt_ij, dt_kj, dt_lj;
-    int  t1, t2, t3;
-    real v, vtot;
-    rvec delta_ante,  delta_crnt, delta_post, vec_temp;
-    real factor_phi_ai_ante, factor_phi_ai_crnt, factor_phi_ai_post;
-    real factor_phi_aj_ante, factor_phi_aj_crnt, factor_phi_aj_post;
-    real factor_phi_ak_ante, factor_phi_ak_crnt, factor_phi_ak_post;
-    real factor_phi_al_ante, factor_phi_al_crnt, factor_phi_al_post;
-    real prefactor_phi;
-
-
-    vtot = 0.0;
+    const int            nfa1 = 4;
+    int                  i, iu, s, m;
+    int                  type, ai[GMX_SIMD_REAL_WIDTH], aj[GMX_SIMD_REAL_WIDTH];
+    int                  ak[GMX_SIMD_REAL_WIDTH];
+    real                 coeff_array[2*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *coeff;
+    real                 dr_array[2*DIM*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *dr;
+    real                 f_buf_array[6*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *f_buf;
+    gmx_simd_real_t      k_S, cos_eq_S;
+    gmx_simd_real_t      dax_S, day_S, daz_S;
+    gmx_simd_real_t      dpx_S, dpy_S, dpz_S;
+    gmx_simd_real_t      one_S;
+    gmx_simd_real_t      c_ante_S, c_cros_S, c_post_S;
+    gmx_simd_real_t      norm_S, cos_S, sin2_S;
+    gmx_simd_real_t      ratio_ante_S, ratio_post_S;
+    gmx_simd_real_t      pref_S;
+    gmx_simd_real_t      f_ix_S, f_iy_S, f_iz_S;
+    gmx_simd_real_t      f_kx_S, f_ky_S, f_kz_S;
+    pbc_simd_t           pbc_simd;
+
+    /* Ensure register memory alignment */
+    coeff = gmx_simd_align_r(coeff_array);
+    dr    = gmx_simd_align_r(dr_array);
+    f_buf = gmx_simd_align_r(f_buf_array);
+
+    set_pbc_simd(pbc, &pbc_simd);
+
+    one_S = gmx_simd_set1_r(1.0);
+
+    /* nbonds is the number of angles times nfa1, here we step GMX_SIMD_REAL_WIDTH angles */
+    for (i = 0; (i < nbonds); i += GMX_SIMD_REAL_WIDTH*nfa1)
+    {
+        /* Collect atoms for GMX_SIMD_REAL_WIDTH angles.
+         * iu indexes into forceatoms, we should not let iu go beyond nbonds.
+         */
+        iu = i;
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            type  = forceatoms[iu];
+            ai[s] = forceatoms[iu+1];
+            aj[s] = forceatoms[iu+2];
+            ak[s] = forceatoms[iu+3];
+
+            /* As in compute_factors_restangles, cos(pi - theta0) */
+            coeff[s]                     = forceparams[type].harmonic.krA;
+            coeff[GMX_SIMD_REAL_WIDTH+s] = -cos(forceparams[type].harmonic.rA*DEG2RAD);
+
+            /* Store the non PBC corrected distances packed and aligned */
+            for (m = 0; m < DIM; m++)
+            {
+                dr[s +      m *GMX_SIMD_REAL_WIDTH] = x[aj[s]][m] - x[ai[s]][m];
+                dr[s + (DIM+m)*GMX_SIMD_REAL_WIDTH] = x[ak[s]][m] - x[aj[s]][m];
+            }
+
+            /* At the end fill the arrays with identical entries */
+            if (iu + nfa1 < nbonds)
+            {
+                iu += nfa1;
+            }
+        }
+
+        k_S          = gmx_simd_load_r(coeff);
+        cos_eq_S     = gmx_simd_load_r(coeff+GMX_SIMD_REAL_WIDTH);
+
+        dax_S        = gmx_simd_load_r(dr + 0*GMX_SIMD_REAL_WIDTH);
+        day_S        = gmx_simd_load_r(dr + 1*GMX_SIMD_REAL_WIDTH);
+        daz_S        = gmx_simd_load_r(dr + 2*GMX_SIMD_REAL_WIDTH);
+        dpx_S        = gmx_simd_load_r(dr + 3*GMX_SIMD_REAL_WIDTH);
+        dpy_S        = gmx_simd_load_r(dr + 4*GMX_SIMD_REAL_WIDTH);
+        dpz_S        = gmx_simd_load_r(dr + 5*GMX_SIMD_REAL_WIDTH);
+
+        pbc_dx_simd(&dax_S, &day_S, &daz_S, &pbc_simd);
+        pbc_dx_simd(&dpx_S, &dpy_S, &dpz_S, &pbc_simd);
+
+        c_ante_S     = gmx_simd_norm2_r(dax_S, day_S, daz_S);
+        c_cros_S     = gmx_simd_iprod_r(dax_S, day_S, daz_S,
+                                        dpx_S, dpy_S, dpz_S);
+        c_post_S     = gmx_simd_norm2_r(dpx_S, dpy_S, dpz_S);
+
+        norm_S       = gmx_simd_invsqrt_r(gmx_simd_mul_r(c_ante_S, c_post_S));
+        cos_S        = gmx_simd_mul_r(c_cros_S, norm_S);
+        sin2_S       = gmx_simd_fnmadd_r(cos_S, cos_S, one_S);
+
+        ratio_ante_S = gmx_simd_mul_r(c_cros_S, gmx_simd_inv_r(c_ante_S));
+        ratio_post_S = gmx_simd_mul_r(c_cros_S, gmx_simd_inv_r(c_post_S));
+
+        /* The prefactor of compute_factors_restangles */
+        pref_S       = gmx_simd_mul_r(k_S, gmx_simd_sub_r(cos_eq_S, cos_S));
+        pref_S       = gmx_simd_mul_r(pref_S, norm_S);
+        pref_S       = gmx_simd_mul_r(pref_S, gmx_simd_fnmadd_r(cos_S, cos_eq_S, one_S));
+        pref_S       = gmx_simd_mul_r(pref_S, gmx_simd_inv_r(gmx_simd_mul_r(sin2_S, sin2_S)));
+
+        f_ix_S       = gmx_simd_fmsub_r(ratio_ante_S, dax_S, dpx_S);
+        f_iy_S       = gmx_simd_fmsub_r(ratio_ante_S, day_S, dpy_S);
+        f_iz_S       = gmx_simd_fmsub_r(ratio_ante_S, daz_S, dpz_S);
+        f_kx_S       = gmx_simd_fnmadd_r(ratio_post_S, dpx_S, dax_S);
+        f_ky_S       = gmx_simd_fnmadd_r(ratio_post_S, dpy_S, day_S);
+        f_kz_S       = gmx_simd_fnmadd_r(ratio_post_S, dpz_S, daz_S);
+
+        gmx_simd_store_r(f_buf + 0*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(pref_S, f_ix_S));
+        gmx_simd_store_r(f_buf + 1*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(pref_S, f_iy_S));
+        gmx_simd_store_r(f_buf + 2*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(pref_S, f_iz_S));
+        gmx_simd_store_r(f_buf + 3*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(pref_S, f_kx_S));
+        gmx_simd_store_r(f_buf + 4*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(pref_S, f_ky_S));
+        gmx_simd_store_r(f_buf + 5*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(pref_S, f_kz_S));
+
+        /* The force on j is minus the sum of the forces on i and k */
+        iu = i;
+        s  = 0;
+        do
+        {
+            for (m = 0; m < DIM; m++)
+            {
+                f[ai[s]][m] += f_buf[s + m*GMX_SIMD_REAL_WIDTH];
+                f[aj[s]][m] -= f_buf[s + m*GMX_SIMD_REAL_WIDTH] + f_buf[s + (DIM+m)*GMX_SIMD_REAL_WIDTH];
+                f[ak[s]][m] += f_buf[s + (DIM+m)*GMX_SIMD_REAL_WIDTH];
+            }
+            s++;
+            iu += nfa1;
+        }
+        while (s < GMX_SIMD_REAL_WIDTH && iu < nbonds);
+    }
+}
+
+#endif /* GMX_SIMD_HAVE_REAL */
+
+
+real restrdihs(int nbonds,
+               const t_iatom forceatoms[], const t_iparams forceparams[],
+               const rvec x[], rvec f[], rvec fshift[],
+               const t_pbc *pbc, const t_graph *g,
+               real gmx_unused lambda, real gmx_unused *dvlambda,
+               const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+               int gmx_unused *global_atom_index)
+{
+    int  i, d, type, ai, aj, ak, al;
+    rvec f_i, f_j, f_k, f_l;
+    rvec dx_jl;
+    ivec jt, dt_ij, dt_kj, dt_lj;
+    int  t1, t2, t3;
+    real v, vtot;
+    rvec delta_ante,  delta_crnt, delta_post, vec_temp;
+    real factor_phi_ai_ante, factor_phi_ai_crnt, factor_phi_ai_post;
+    real factor_phi_aj_ante, factor_phi_aj_crnt, factor_phi_aj_post;
+    real factor_phi_ak_ante, factor_phi_ak_crnt, factor_phi_ak_post;
+    real factor_phi_al_ante, factor_phi_al_crnt, factor_phi_al_post;
+    real prefactor_phi;
+
+
+    vtot = 0.0;
     for (i = 0; (i < nbonds); )
     {
         type = forceatoms[i++];
@@ -3090,6 +3578,115 @@ real rbdihs(int nbonds,
     return vtot;
 }
 
+#ifdef GMX_SIMD_HAVE_REAL
+
+/* As rbdihs, but using SIMD to calculate many dihedrals at once.
+ * This routine does not calculate energies, shift forces and dvdl.
+ */
+static void
+rbdihs_noener_simd(int nbonds,
+                   const t_iatom forceatoms[], const t_iparams forceparams[],
+                   const rvec x[], rvec f[],
+                   const t_pbc *pbc, const t_graph gmx_unused *g,
+                   real gmx_unused lambda,
+                   const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+                   int gmx_unused *global_atom_index)
+{
+    const int             nfa1 = 5;
+    int                   i, iu, s, j;
+    int                   type, ai[GMX_SIMD_REAL_WIDTH], aj[GMX_SIMD_REAL_WIDTH], ak[GMX_SIMD_REAL_WIDTH], al[GMX_SIMD_REAL_WIDTH];
+    real                  dr_array[3*DIM*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *dr;
+    real                  buf_array[(NR_RBDIHS+1)*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *buf;
+    real                 *parm, *p, *q;
+    gmx_simd_real_t       phi_S;
+    gmx_simd_real_t       mx_S, my_S, mz_S;
+    gmx_simd_real_t       nx_S, ny_S, nz_S;
+    gmx_simd_real_t       nrkj_m2_S, nrkj_n2_S;
+    gmx_simd_real_t       sin_S, cos_S;
+    gmx_simd_real_t       ddv_S, mddphi_S;
+    pbc_simd_t            pbc_simd;
+
+    /* Ensure SIMD register alignment */
+    dr  = gmx_simd_align_r(dr_array);
+    buf = gmx_simd_align_r(buf_array);
+
+    /* Extract aligned pointer for parameters and variables.
+     * parm stores j*C_j for j=1,...,NR_RBDIHS-1, the coefficients
+     * of the derivative of the RB polynomial.
+     */
+    parm  = buf;
+    p     = buf + (NR_RBDIHS-1)*GMX_SIMD_REAL_WIDTH;
+    q     = buf + NR_RBDIHS*GMX_SIMD_REAL_WIDTH;
+
+    set_pbc_simd(pbc, &pbc_simd);
+
+    /* nbonds is the number of dihedrals times nfa1, here we step GMX_SIMD_REAL_WIDTH dihs */
+    for (i = 0; (i < nbonds); i += GMX_SIMD_REAL_WIDTH*nfa1)
+    {
+        /* Collect atoms quadruplets for GMX_SIMD_REAL_WIDTH dihedrals.
+         * iu indexes into forceatoms, we should not let iu go beyond nbonds.
+         */
+        iu = i;
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            type  = forceatoms[iu];
+            ai[s] = forceatoms[iu+1];
+            aj[s] = forceatoms[iu+2];
+            ak[s] = forceatoms[iu+3];
+            al[s] = forceatoms[iu+4];
+
+            for (j = 1; j < NR_RBDIHS; j++)
+            {
+                parm[(j-1)*GMX_SIMD_REAL_WIDTH+s] =
+                    j*forceparams[type].rbdihs.rbcA[j];
+            }
+
+            /* At the end fill the arrays with identical entries */
+            if (iu + nfa1 < nbonds)
+            {
+                iu += nfa1;
+            }
+        }
+
+        /* Caclulate GMX_SIMD_REAL_WIDTH dihedral angles at once */
+        dih_angle_simd(x, ai, aj, ak, al, &pbc_simd,
+                       dr,
+                       &phi_S,
+                       &mx_S, &my_S, &mz_S,
+                       &nx_S, &ny_S, &nz_S,
+                       &nrkj_m2_S,
+                       &nrkj_n2_S,
+                       p, q);
+
+        /* In the polymer convention psi = phi - pi,
+         * so cos(psi) = -cos(phi) and sin(psi) = -sin(phi).
+         */
+        gmx_simd_sincos_r(phi_S, &sin_S, &cos_S);
+        cos_S    = gmx_simd_sub_r(gmx_simd_setzero_r(), cos_S);
+
+        /* The derivative of the RB polynomial with respect to cos(psi) */
+        ddv_S    = gmx_simd_load_r(parm + (NR_RBDIHS-2)*GMX_SIMD_REAL_WIDTH);
+        for (j = NR_RBDIHS-3; j >= 0; j--)
+        {
+            ddv_S = gmx_simd_fmadd_r(ddv_S, cos_S,
+                                     gmx_simd_load_r(parm + j*GMX_SIMD_REAL_WIDTH));
+        }
+
+        /* -dV/dphi = -dV/dcos(psi) sin(phi) */
+        mddphi_S = gmx_simd_sub_r(gmx_simd_setzero_r(),
+                                  gmx_simd_mul_r(ddv_S, sin_S));
+
+        do_dih_fup_noshiftf_simd(simd_nlanes(i, nbonds, nfa1),
+                                 ai, aj, ak, al,
+                                 mddphi_S,
+                                 mx_S, my_S, mz_S, nx_S, ny_S, nz_S,
+                                 nrkj_m2_S, nrkj_n2_S,
+                                 p, q, dr, f);
+    }
+}
+
+#endif /* GMX_SIMD_HAVE_REAL */
+
 int cmap_setup_grid_index(int ip, int grid_spacing, int *ipm1, int *ipp1, int *ipp2)
 {
     int im1, ip1, ip2;
@@ -3129,6 +3726,148 @@ int cmap_setup_grid_index(int ip, int grid_spacing, int *ipm1, int *ipp1, int *i
 
 }
 
+/* Returns the CMAP energy of grid cmapA at dihedral angles phi1 and phi2,
+ * which should be in [-pi, pi], using bicubic interpolation.
+ * Returns the derivatives of the energy with respect to the two angles
+ * in df1 and df2.
+ */
+static real cmap_interpolate(const gmx_cmap_t *cmap_grid, int cmapA,
+                             real phi1, real phi2,
+                             real *df1_out, real *df2_out)
+{
+    int         i, j, k, idx;
+    int         iphi1, ip1m1, ip1p1, ip1p2;
+    int         iphi2, ip2m1, ip2p1, ip2p2;
+    int         l1, l2, l3;
+    int         pos1, pos2, pos3, pos4;
+    real        ty[4], ty1[4], ty2[4], ty12[4], tc[16], tx[16];
+    real        xphi1, xphi2;
+    real        dx, xx, tt, tu, e, df1, df2, fac;
+    const real *cmapd;
+
+    int         loop_index[4][4] = {
+        {0, 4, 8, 12},
+        {1, 5, 9, 13},
+        {2, 6, 10, 14},
+        {3, 7, 11, 15}
+    };
+
+    cmapd = cmap_grid->cmapdata[cmapA].cmap;
+
+    xphi1 = phi1 + M_PI; /* 1 */
+    xphi2 = phi2 + M_PI; /* 1 */
+
+    /* Range mangling */
+    if (xphi1 < 0)
+    {
+        xphi1 = xphi1 + 2*M_PI;
+    }
+    else if (xphi1 >= 2*M_PI)
+    {
+        xphi1 = xphi1 - 2*M_PI;
+    }
+
+    if (xphi2 < 0)
+    {
+        xphi2 = xphi2 + 2*M_PI;
+    }
+    else if (xphi2 >= 2*M_PI)
+    {
+        xphi2 = xphi2 - 2*M_PI;
+    }
+
+    /* Number of grid points */
+    dx = 2*M_PI / cmap_grid->grid_spacing;
+
+    /* Where on the grid are we */
+    iphi1 = (int)(xphi1/dx);
+    iphi2 = (int)(xphi2/dx);
+
+    iphi1 = cmap_setup_grid_index(iphi1, cmap_grid->grid_spacing, &ip1m1, &ip1p1, &ip1p2);
+    iphi2 = cmap_setup_grid_index(iphi2, cmap_grid->grid_spacing, &ip2m1, &ip2p1, &ip2p2);
+
+    pos1    = iphi1*cmap_grid->grid_spacing+iphi2;
+    pos2    = ip1p1*cmap_grid->grid_spacing+iphi2;
+    pos3    = ip1p1*cmap_grid->grid_spacing+ip2p1;
+    pos4    = iphi1*cmap_grid->grid_spacing+ip2p1;
+
+    ty[0]   = cmapd[pos1*4];
+    ty[1]   = cmapd[pos2*4];
+    ty[2]   = cmapd[pos3*4];
+    ty[3]   = cmapd[pos4*4];
+
+    ty1[0]   = cmapd[pos1*4+1];
+    ty1[1]   = cmapd[pos2*4+1];
+    ty1[2]   = cmapd[pos3*4+1];
+    ty1[3]   = cmapd[pos4*4+1];
+
+    ty2[0]   = cmapd[pos1*4+2];
+    ty2[1]   = cmapd[pos2*4+2];
+    ty2[2]   = cmapd[pos3*4+2];
+    ty2[3]   = cmapd[pos4*4+2];
+
+    ty12[0]   = cmapd[pos1*4+3];
+    ty12[1]   = cmapd[pos2*4+3];
+    ty12[2]   = cmapd[pos3*4+3];
+    ty12[3]   = cmapd[pos4*4+3];
+
+    /* Switch to degrees */
+    dx    = 360.0 / cmap_grid->grid_spacing;
+    xphi1 = xphi1 * RAD2DEG;
+    xphi2 = xphi2 * RAD2DEG;
+
+    for (i = 0; i < 4; i++) /* 16 */
+    {
+        tx[i]    = ty[i];
+        tx[i+4]  = ty1[i]*dx;
+        tx[i+8]  = ty2[i]*dx;
+        tx[i+12] = ty12[i]*dx*dx;
+    }
+
+    idx = 0;
+    for (i = 0; i < 4; i++) /* 1056 */
+    {
+        for (j = 0; j < 4; j++)
+        {
+            xx = 0;
+            for (k = 0; k < 16; k++)
+            {
+                xx = xx + cmap_coeff_matrix[k*16+idx]*tx[k];
+            }
+
+            idx++;
+            tc[i*4+j] = xx;
+        }
+    }
+
+    tt    = (xphi1-iphi1*dx)/dx;
+    tu    = (xphi2-iphi2*dx)/dx;
+
+    e     = 0;
+    df1   = 0;
+    df2   = 0;
+
+    for (i = 3; i >= 0; i--)
+    {
+        l1 = loop_index[i][3];
+        l2 = loop_index[i][2];
+        l3 = loop_index[i][1];
+
+        e     = tt * e    + ((tc[i*4+3]*tu+tc[i*4+2])*tu + tc[i*4+1])*tu+tc[i*4];
+        df1   = tu * df1  + (3.0*tc[l1]*tt+2.0*tc[l2])*tt+tc[l3];
+        df2   = tt * df2  + (3.0*tc[i*4+3]*tu+2.0*tc[i*4+2])*tu+tc[i*4+1];
+    }
+
+    fac      = RAD2DEG/dx;
+    df1      = df1 * fac;
+    df2      = df2 * fac;
+
+    *df1_out = df1;
+    *df2_out = df2;
+
+    return e;
+}
+
 real cmap_dihs(int nbonds,
                const t_iatom forceatoms[], const t_iparams forceparams[],
                const gmx_cmap_t *cmap_grid,
@@ -3138,25 +3877,20 @@ real cmap_dihs(int nbonds,
                const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
                int  gmx_unused *global_atom_index)
 {
-    int         i, j, k, n, idx;
+    int         i, n;
     int         ai, aj, ak, al, am;
     int         a1i, a1j, a1k, a1l, a2i, a2j, a2k, a2l;
     int         type, cmapA;
     int         t11, t21, t31, t12, t22, t32;
-    int         iphi1, ip1m1, ip1p1, ip1p2;
-    int         iphi2, ip2m1, ip2p1, ip2p2;
-    int         l1, l2, l3, l4;
-    int         pos1, pos2, pos3, pos4, tmp;
+    int         tmp;
 
-    real        ty[4], ty1[4], ty2[4], ty12[4], tc[16], tx[16];
-    real        phi1, psi1, cos_phi1, sin_phi1, sign1, xphi1;
-    real        phi2, psi2, cos_phi2, sin_phi2, sign2, xphi2;
-    real        dx, xx, tt, tu, e, df1, df2, ddf1, ddf2, ddf12, vtot;
+    real        phi1, cos_phi1, sin_phi1, sign1;
+    real        phi2, cos_phi2, sin_phi2, sign2;
+    real        e, df1, df2, vtot;
     real        ra21, rb21, rg21, rg1, rgr1, ra2r1, rb2r1, rabr1;
     real        ra22, rb22, rg22, rg2, rgr2, ra2r2, rb2r2, rabr2;
     real        fg1, hg1, fga1, hgb1, gaa1, gbb1;
     real        fg2, hg2, fga2, hgb2, gaa2, gbb2;
-    real        fac;
 
     rvec        r1_ij, r1_kj, r1_kl, m1, n1;
     rvec        r2_ij, r2_kj, r2_kl, m2, n2;
@@ -3168,15 +3902,6 @@ real cmap_dihs(int nbonds,
     ivec        jt1, dt1_ij, dt1_kj, dt1_lj;
     ivec        jt2, dt2_ij, dt2_kj, dt2_lj;
 
-    const real *cmapd;
-
-    int         loop_index[4][4] = {
-        {0, 4, 8, 12},
-        {1, 5, 9, 13},
-        {2, 6, 10, 14},
-        {3, 7, 11, 15}
-    };
-
     /* Total CMAP energy */
     vtot = 0;
 
@@ -3192,7 +3917,6 @@ real cmap_dihs(int nbonds,
 
         /* Which CMAP type is this */
         cmapA = forceparams[type].cmap.cmapA;
-        cmapd = cmap_grid->cmapdata[cmapA].cmap;
 
         /* First torsion */
         a1i   = ai;
@@ -3253,8 +3977,6 @@ real cmap_dihs(int nbonds,
             }
         }
 
-        xphi1 = phi1 + M_PI; /* 1 */
-
         /* Second torsion */
         a2i   = aj;
         a2j   = ak;
@@ -3314,123 +4036,7 @@ real cmap_dihs(int nbonds,
             }
         }
 
-        xphi2 = phi2 + M_PI; /* 1 */
-
-        /* Range mangling */
-        if (xphi1 < 0)
-        {
-            xphi1 = xphi1 + 2*M_PI;
-        }
-        else if (xphi1 >= 2*M_PI)
-        {
-            xphi1 = xphi1 - 2*M_PI;
-        }
-
-        if (xphi2 < 0)
-        {
-            xphi2 = xphi2 + 2*M_PI;
-        }
-        else if (xphi2 >= 2*M_PI)
-        {
-            xphi2 = xphi2 - 2*M_PI;
-        }
-
-        /* Number of grid points */
-        dx = 2*M_PI / cmap_grid->grid_spacing;
-
-        /* Where on the grid are we */
-        iphi1 = (int)(xphi1/dx);
-        iphi2 = (int)(xphi2/dx);
-
-        iphi1 = cmap_setup_grid_index(iphi1, cmap_grid->grid_spacing, &ip1m1, &ip1p1, &ip1p2);
-        iphi2 = cmap_setup_grid_index(iphi2, cmap_grid->grid_spacing, &ip2m1, &ip2p1, &ip2p2);
-
-        pos1    = iphi1*cmap_grid->grid_spacing+iphi2;
-        pos2    = ip1p1*cmap_grid->grid_spacing+iphi2;
-        pos3    = ip1p1*cmap_grid->grid_spacing+ip2p1;
-        pos4    = iphi1*cmap_grid->grid_spacing+ip2p1;
-
-        ty[0]   = cmapd[pos1*4];
-        ty[1]   = cmapd[pos2*4];
-        ty[2]   = cmapd[pos3*4];
-        ty[3]   = cmapd[pos4*4];
-
-        ty1[0]   = cmapd[pos1*4+1];
-        ty1[1]   = cmapd[pos2*4+1];
-        ty1[2]   = cmapd[pos3*4+1];
-        ty1[3]   = cmapd[pos4*4+1];
-
-        ty2[0]   = cmapd[pos1*4+2];
-        ty2[1]   = cmapd[pos2*4+2];
-        ty2[2]   = cmapd[pos3*4+2];
-        ty2[3]   = cmapd[pos4*4+2];
-
-        ty12[0]   = cmapd[pos1*4+3];
-        ty12[1]   = cmapd[pos2*4+3];
-        ty12[2]   = cmapd[pos3*4+3];
-        ty12[3]   = cmapd[pos4*4+3];
-
-        /* Switch to degrees */
-        dx    = 360.0 / cmap_grid->grid_spacing;
-        xphi1 = xphi1 * RAD2DEG;
-        xphi2 = xphi2 * RAD2DEG;
-
-        for (i = 0; i < 4; i++) /* 16 */
-        {
-            tx[i]    = ty[i];
-            tx[i+4]  = ty1[i]*dx;
-            tx[i+8]  = ty2[i]*dx;
-            tx[i+12] = ty12[i]*dx*dx;
-        }
-
-        idx = 0;
-        for (i = 0; i < 4; i++) /* 1056 */
-        {
-            for (j = 0; j < 4; j++)
-            {
-                xx = 0;
-                for (k = 0; k < 16; k++)
-                {
-                    xx = xx + cmap_coeff_matrix[k*16+idx]*tx[k];
-                }
-
-                idx++;
-                tc[i*4+j] = xx;
-            }
-        }
-
-        tt    = (xphi1-iphi1*dx)/dx;
-        tu    = (xphi2-iphi2*dx)/dx;
-
-        e     = 0;
-        df1   = 0;
-        df2   = 0;
-        ddf1  = 0;
-        ddf2  = 0;
-        ddf12 = 0;
-
-        for (i = 3; i >= 0; i--)
-        {
-            l1 = loop_index[i][3];
-            l2 = loop_index[i][2];
-            l3 = loop_index[i][1];
-
-            e     = tt * e    + ((tc[i*4+3]*tu+tc[i*4+2])*tu + tc[i*4+1])*tu+tc[i*4];
-            df1   = tu * df1  + (3.0*tc[l1]*tt+2.0*tc[l2])*tt+tc[l3];
-            df2   = tt * df2  + (3.0*tc[i*4+3]*tu+2.0*tc[i*4+2])*tu+tc[i*4+1];
-            ddf1  = tu * ddf1 + 2.0*3.0*tc[l1]*tt+2.0*tc[l2];
-            ddf2  = tt * ddf2 + 2.0*3.0*tc[4*i+3]*tu+2.0*tc[4*i+2];
-        }
-
-        ddf12 = tc[5] + 2.0*tc[9]*tt + 3.0*tc[13]*tt*tt + 2.0*tu*(tc[6]+2.0*tc[10]*tt+3.0*tc[14]*tt*tt) +
-            3.0*tu*tu*(tc[7]+2.0*tc[11]*tt+3.0*tc[15]*tt*tt);
-
-        fac     = RAD2DEG/dx;
-        df1     = df1   * fac;
-        df2     = df2   * fac;
-        ddf1    = ddf1  * fac * fac;
-        ddf2    = ddf2  * fac * fac;
-        ddf12   = ddf12 * fac * fac;
+        e = cmap_interpolate(cmap_grid, cmapA, phi1, phi2, &df1, &df2);
 
         /* CMAP energy */
         vtot += e;
@@ -3528,7 +4134,7 @@ real cmap_dihs(int nbonds,
         rvec_inc(fshift[t21], f1_k);
         rvec_inc(fshift[t31], f1_l);
 
-        rvec_inc(fshift[t21], f2_i);
+        rvec_inc(fshift[t12], f2_i);
         rvec_inc(fshift[CENTRAL], f2_j);
         rvec_inc(fshift[t22], f2_k);
         rvec_inc(fshift[t32], f2_l);
@@ -3536,6 +4142,134 @@ real cmap_dihs(int nbonds,
     return vtot;
 }
 
+#ifdef GMX_SIMD_HAVE_REAL
+
+/* As cmap_dihs, but using SIMD to calculate the two dihedral angles
+ * and the forces of many CMAP terms at once. The grid interpolation
+ * is done per CMAP term. This routine does not calculate energies
+ * and shift forces.
+ */
+static void
+cmap_dihs_noener_simd(int nbonds,
+                      const t_iatom forceatoms[], const t_iparams forceparams[],
+                      const gmx_cmap_t *cmap_grid,
+                      const rvec x[], rvec f[],
+                      const t_pbc *pbc, const t_graph gmx_unused *g,
+                      real gmx_unused lambda,
+                      const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+                      int gmx_unused *global_atom_index)
+{
+    const int             nfa1 = 6;
+    int                   i, iu, s, nlanes;
+    int                   type, cmapA[GMX_SIMD_REAL_WIDTH];
+    int                   ai[GMX_SIMD_REAL_WIDTH], aj[GMX_SIMD_REAL_WIDTH], ak[GMX_SIMD_REAL_WIDTH], al[GMX_SIMD_REAL_WIDTH], am[GMX_SIMD_REAL_WIDTH];
+    real                  dr_array[3*DIM*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *dr;
+    real                  buf_array[6*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *buf;
+    real                 *phi1, *phi2, *p1, *q1, *p2, *q2;
+    gmx_simd_real_t       phi1_S, phi2_S;
+    gmx_simd_real_t       m1x_S, m1y_S, m1z_S, n1x_S, n1y_S, n1z_S;
+    gmx_simd_real_t       m2x_S, m2y_S, m2z_S, n2x_S, n2y_S, n2z_S;
+    gmx_simd_real_t       nrkj_m2_1_S, nrkj_n2_1_S;
+    gmx_simd_real_t       nrkj_m2_2_S, nrkj_n2_2_S;
+    gmx_simd_real_t       mdf1_S, mdf2_S;
+    pbc_simd_t            pbc_simd;
+
+    /* Ensure SIMD register alignment */
+    dr  = gmx_simd_align_r(dr_array);
+    buf = gmx_simd_align_r(buf_array);
+
+    /* Extract aligned pointer for variables.
+     * After interpolation phi1 and phi2 store minus the derivatives
+     * of the energy with respect to the two dihedral angles.
+     */
+    phi1 = buf + 0*GMX_SIMD_REAL_WIDTH;
+    phi2 = buf + 1*GMX_SIMD_REAL_WIDTH;
+    p1   = buf + 2*GMX_SIMD_REAL_WIDTH;
+    q1   = buf + 3*GMX_SIMD_REAL_WIDTH;
+    p2   = buf + 4*GMX_SIMD_REAL_WIDTH;
+    q2   = buf + 5*GMX_SIMD_REAL_WIDTH;
+
+    set_pbc_simd(pbc, &pbc_simd);
+
+    /* nbonds is the number of CMAP terms times nfa1, here we step GMX_SIMD_REAL_WIDTH terms */
+    for (i = 0; (i < nbonds); i += GMX_SIMD_REAL_WIDTH*nfa1)
+    {
+        /* Collect the five atoms for GMX_SIMD_REAL_WIDTH CMAP terms.
+         * iu indexes into forceatoms, we should not let iu go beyond nbonds.
+         */
+        iu = i;
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            type     = forceatoms[iu];
+            ai[s]    = forceatoms[iu+1];
+            aj[s]    = forceatoms[iu+2];
+            ak[s]    = forceatoms[iu+3];
+            al[s]    = forceatoms[iu+4];
+            am[s]    = forceatoms[iu+5];
+
+            cmapA[s] = forceparams[type].cmap.cmapA;
+
+            /* At the end fill the arrays with identical entries */
+            if (iu + nfa1 < nbonds)
+            {
+                iu += nfa1;
+            }
+        }
+
+        /* The first torsion i-j-k-l and the second torsion j-k-l-m */
+        dih_angle_simd(x, ai, aj, ak, al, &pbc_simd,
+                       dr,
+                       &phi1_S,
+                       &m1x_S, &m1y_S, &m1z_S,
+                       &n1x_S, &n1y_S, &n1z_S,
+                       &nrkj_m2_1_S,
+                       &nrkj_n2_1_S,
+                       p1, q1);
+        dih_angle_simd(x, aj, ak, al, am, &pbc_simd,
+                       dr,
+                       &phi2_S,
+                       &m2x_S, &m2y_S, &m2z_S,
+                       &n2x_S, &n2y_S, &n2z_S,
+                       &nrkj_m2_2_S,
+                       &nrkj_n2_2_S,
+                       p2, q2);
+
+        gmx_simd_store_r(phi1, phi1_S);
+        gmx_simd_store_r(phi2, phi2_S);
+
+        nlanes = simd_nlanes(i, nbonds, nfa1);
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            real df1 = 0, df2 = 0;
+
+            if (s < nlanes)
+            {
+                cmap_interpolate(cmap_grid, cmapA[s], phi1[s], phi2[s],
+                                 &df1, &df2);
+            }
+            phi1[s] = -df1;
+            phi2[s] = -df2;
+        }
+        mdf1_S = gmx_simd_load_r(phi1);
+        mdf2_S = gmx_simd_load_r(phi2);
+
+        do_dih_fup_noshiftf_simd(nlanes,
+                                 ai, aj, ak, al,
+                                 mdf1_S,
+                                 m1x_S, m1y_S, m1z_S, n1x_S, n1y_S, n1z_S,
+                                 nrkj_m2_1_S, nrkj_n2_1_S,
+                                 p1, q1, dr, f);
+        do_dih_fup_noshiftf_simd(nlanes,
+                                 aj, ak, al, am,
+                                 mdf2_S,
+                                 m2x_S, m2y_S, m2z_S, n2x_S, n2y_S, n2z_S,
+                                 nrkj_m2_2_S, nrkj_n2_2_S,
+                                 p2, q2, dr, f);
+    }
+}
+
+#endif /* GMX_SIMD_HAVE_REAL */
+
 
 
 /***********************************************************
@@ -4116,6 +4850,17 @@ static gmx_inline gmx_bool ftype_is_bonded_potential(int ftype)
         (ftype < F_GB12 || ftype > F_GB14);
 }
 
+#ifdef GMX_SIMD_HAVE_REAL
+/* Returns whether calc_one_bond can use a SIMD kernel for ftype */
+static gmx_bool ftype_has_simd_kernel(int ftype)
+{
+    return (ftype == F_ANGLES || ftype == F_PDIHS ||
+            ftype == F_UREY_BRADLEY || ftype == F_IDIHS ||
+            ftype == F_RBDIHS || ftype == F_RESTRANGLES ||
+            ftype == F_CMAP);
+}
+#endif
+
 static void divide_bondeds_over_threads(t_idef *idef, int nthreads)
 {
     int ftype;
@@ -4147,7 +4892,20 @@ static void divide_bondeds_over_threads(t_idef *idef, int nthreads)
                  * If this is not the case, a more advanced scheme
                  * (not implemented yet) will do better.
                  */
-                il_nr_thread = (((idef->il[ftype].nr/nat1)*t)/nthreads)*nat1;
+                il_nr_thread = ((idef->il[ftype].nr/nat1)*t)/nthreads;
+#ifdef GMX_SIMD_HAVE_REAL
+                /* Round to a multiple of the SIMD width, so the SIMD
+                 * kernels only use partially filled registers at
+                 * the end of the list. Types without SIMD kernel
+                 * keep the equal division.
+                 */
+                if (t < nthreads && ftype_has_simd_kernel(ftype))
+                {
+                    il_nr_thread = ((il_nr_thread + GMX_SIMD_REAL_WIDTH/2)/GMX_SIMD_REAL_WIDTH)*GMX_SIMD_REAL_WIDTH;
+                    il_nr_thread = min(il_nr_thread, idef->il[ftype].nr/nat1);
+                }
+#endif
+                il_nr_thread *= nat1;
 
                 /* Ensure that distance restraint pairs with the same label
                  * end up on the same thread.
@@ -4171,15 +4929,33 @@ static void divide_bondeds_over_threads(t_idef *idef, int nthreads)
     }
 }
 
-static unsigned
+/* The block size for the bonded thread force reduction is 1<<BONDED_RED_ASHIFT.
+ * The blocks should be small to reduce the zeroing and reduction cost,
+ * but too small blocks result in overhead.
+ * With 32 atoms a block is 384 bytes in single precision.
+ */
+#define BONDED_RED_ASHIFT 5
+
+/* Marks the blocks of the force buffer that thread t writes to
+ * and stores the list of these blocks.
+ */
+static void
 calc_bonded_reduction_mask(const t_idef *idef,
-                           int shift,
-                           int t, int nt)
+                           int shift, int nblock,
+                           int t, int nt,
+                           f_thread_t *f_t)
 {
-    unsigned mask;
-    int      ftype, nb, nat1, nb0, nb1, i, a;
+    int ftype, nb, nat1, nb0, nb1, i, a, b;
 
-    mask = 0;
+    if (nblock > f_t->red_mask_nalloc)
+    {
+        f_t->red_mask_nalloc = over_alloc_large(nblock);
+        srenew(f_t->red_mask, f_t->red_mask_nalloc);
+    }
+    for (b = 0; b < nblock; b++)
+    {
+        f_t->red_mask[b] = FALSE;
+    }
 
     for (ftype = 0; ftype < F_NRE; ftype++)
     {
@@ -4200,21 +4976,32 @@ calc_bonded_reduction_mask(const t_idef *idef,
                 {
                     for (a = 1; a < nat1; a++)
                     {
-                        mask |= (1U << (idef->il[ftype].iatoms[i+a]>>shift));
+                        f_t->red_mask[idef->il[ftype].iatoms[i+a]>>shift] = TRUE;
                     }
                 }
             }
         }
     }
 
-    return mask;
+    if (nblock > f_t->red_block_nalloc)
+    {
+        f_t->red_block_nalloc = over_alloc_large(nblock);
+        srenew(f_t->red_block, f_t->red_block_nalloc);
+    }
+    f_t->red_nblock = 0;
+    for (b = 0; b < nblock; b++)
+    {
+        if (f_t->red_mask[b])
+        {
+            f_t->red_block[f_t->red_nblock++] = b;
+        }
+    }
 }
 
 void setup_bonded_threading(t_forcerec   *fr, t_idef *idef)
 {
-#define MAX_BLOCK_BITS 32
-    int t;
-    int ctot, c, b;
+    int t, b;
+    int ctot;
 
     assert(fr->nthreads >= 1);
 
@@ -4223,24 +5010,18 @@ void setup_bonded_threading(t_forcerec   *fr, t_idef *idef)
 
     if (fr->nthreads == 1)
     {
-        fr->red_nblock = 0;
+        fr->red_nblock      = 0;
+        fr->red_nblock_used = 0;
 
         return;
     }
 
-    /* We divide the force array in a maximum of 32 blocks.
-     * Minimum force block reduction size is 2^6=64.
+    /* We divide the force array in blocks of fixed size,
+     * so the reduction cost is proportional to the number of atoms
+     * each thread writes to, independently of the system size.
      */
-    fr->red_ashift = 6;
-    while (fr->natoms_force > (int)(MAX_BLOCK_BITS*(1U<<fr->red_ashift)))
-    {
-        fr->red_ashift++;
-    }
-    if (debug)
-    {
-        fprintf(debug, "bonded force buffer block atom shift %d bits\n",
-                fr->red_ashift);
-    }
+    fr->red_ashift = BONDED_RED_ASHIFT;
+    fr->red_nblock = (fr->natoms_force + (1<<fr->red_ashift) - 1)>>fr->red_ashift;
 
     /* Determine to which blocks each thread's bonded force calculation
      * contributes. Store this is a mask for each thread.
@@ -4248,43 +5029,48 @@ void setup_bonded_threading(t_forcerec   *fr, t_idef *idef)
 #pragma omp parallel for num_threads(fr->nthreads) schedule(static)
     for (t = 1; t < fr->nthreads; t++)
     {
-        fr->f_t[t].red_mask =
-            calc_bonded_reduction_mask(idef, fr->red_ashift, t, fr->nthreads);
+        calc_bonded_reduction_mask(idef, fr->red_ashift, fr->red_nblock,
+                                   t, fr->nthreads, &fr->f_t[t]);
     }
 
-    /* Determine the maximum number of blocks we need to reduce over */
-    fr->red_nblock = 0;
-    ctot           = 0;
-    for (t = 0; t < fr->nthreads; t++)
+    /* Make the list of blocks that need to be reduced */
+    if (fr->red_nblock > fr->red_block_nalloc)
+    {
+        fr->red_block_nalloc = over_alloc_large(fr->red_nblock);
+        srenew(fr->red_block, fr->red_block_nalloc);
+    }
+    fr->red_nblock_used = 0;
+    for (b = 0; b < fr->red_nblock; b++)
     {
-        c = 0;
-        for (b = 0; b < MAX_BLOCK_BITS; b++)
+        for (t = 1; t < fr->nthreads; t++)
         {
-            if (fr->f_t[t].red_mask & (1U<<b))
+            if (fr->f_t[t].red_mask[b])
             {
-                fr->red_nblock = max(fr->red_nblock, b+1);
-                c++;
+                fr->red_block[fr->red_nblock_used++] = b;
+                break;
             }
         }
-        if (debug)
-        {
-            fprintf(debug, "thread %d flags %x count %d\n",
-                    t, fr->f_t[t].red_mask, c);
-        }
-        ctot += c;
     }
+
     if (debug)
     {
-        fprintf(debug, "Number of blocks to reduce: %d of size %d\n",
-                fr->red_nblock, 1<<fr->red_ashift);
+        ctot = 0;
+        for (t = 1; t < fr->nthreads; t++)
+        {
+            fprintf(debug, "thread %d block count %d\n",
+                    t, fr->f_t[t].red_nblock);
+            ctot += fr->f_t[t].red_nblock;
+        }
+        fprintf(debug, "Number of blocks to reduce: %d of %d of size %d\n",
+                fr->red_nblock_used, fr->red_nblock, 1<<fr->red_ashift);
         fprintf(debug, "Reduction density %.2f density/#thread %.2f\n",
                 ctot*(1<<fr->red_ashift)/(double)fr->natoms_force,
                 ctot*(1<<fr->red_ashift)/(double)(fr->natoms_force*fr->nthreads));
     }
 }
 
-static void zero_thread_forces(f_thread_t *f_t, int n,
-                               int nblock, int blocksize)
+/* Clears the blocks of the force buffer of f_t that are written to */
+static void zero_thread_forces(f_thread_t *f_t, int n, int blocksize)
 {
     int b, a0, a1, a, i, j;
 
@@ -4294,19 +5080,13 @@ static void zero_thread_forces(f_thread_t *f_t, int n,
         srenew(f_t->f, f_t->f_nalloc);
     }
 
-    if (f_t->red_mask != 0)
+    for (b = 0; b < f_t->red_nblock; b++)
     {
-        for (b = 0; b < nblock; b++)
+        a0 = f_t->red_block[b]*blocksize;
+        a1 = min(a0 + blocksize, n);
+        for (a = a0; a < a1; a++)
         {
-            if (f_t->red_mask && (1U<<b))
-            {
-                a0 = b*blocksize;
-                a1 = min((b+1)*blocksize, n);
-                for (a = a0; a < a1; a++)
-                {
-                    clear_rvec(f_t->f[a]);
-                }
-            }
+            clear_rvec(f_t->f[a]);
         }
     }
     for (i = 0; i < SHIFTS; i++)
@@ -4332,14 +5112,15 @@ static void zero_thread_forces(f_thread_t *f_t, int n,
 
 static void reduce_thread_force_buffer(int n, rvec *f,
                                        int nthreads, f_thread_t *f_t,
-                                       int nblock, int block_size)
+                                       int nblock, const int *block,
+                                       int block_size)
 {
     /* The max thread number is arbitrary,
      * we used a fixed number to avoid memory management.
      * Using more than 16 threads is probably never useful performance wise.
      */
 #define MAX_BONDED_THREADS 256
-    int b;
+    int i;
 
     if (nthreads > MAX_BONDED_THREADS)
     {
@@ -4349,35 +5130,35 @@ static void reduce_thread_force_buffer(int n, rvec *f,
 
     /* This reduction can run on any number of threads,
      * independently of nthreads.
+     * We only loop over the blocks that are filled by at least one thread.
      */
 #pragma omp parallel for num_threads(nthreads) schedule(static)
-    for (b = 0; b < nblock; b++)
+    for (i = 0; i < nblock; i++)
     {
         rvec *fp[MAX_BONDED_THREADS];
-        int   nfb, ft, fb;
+        int   b, nfb, ft, fb;
         int   a0, a1, a;
 
+        b = block[i];
+
         /* Determine which threads contribute to this block */
         nfb = 0;
         for (ft = 1; ft < nthreads; ft++)
         {
-            if (f_t[ft].red_mask & (1U<<b))
+            if (f_t[ft].red_mask[b])
             {
                 fp[nfb++] = f_t[ft].f;
             }
         }
-        if (nfb > 0)
+
+        /* Reduce force buffers for threads that contribute */
+        a0 = b*block_size;
+        a1 = min(a0 + block_size, n);
+        for (a = a0; a < a1; a++)
         {
-            /* Reduce force buffers for threads that contribute */
-            a0 =  b   *block_size;
-            a1 = (b+1)*block_size;
-            a1 = min(a1, n);
-            for (a = a0; a < a1; a++)
+            for (fb = 0; fb < nfb; fb++)
             {
-                for (fb = 0; fb < nfb; fb++)
-                {
-                    rvec_inc(f[a], fp[fb][a]);
-                }
+                rvec_inc(f[a], fp[fb][a]);
             }
         }
     }
@@ -4386,14 +5167,15 @@ static void reduce_thread_force_buffer(int n, rvec *f,
 static void reduce_thread_forces(int n, rvec *f, rvec *fshift,
                                  real *ener, gmx_grppairener_t *grpp, real *dvdl,
                                  int nthreads, f_thread_t *f_t,
-                                 int nblock, int block_size,
+                                 int nblock, const int *block, int block_size,
                                  gmx_bool bCalcEnerVir,
                                  gmx_bool bDHDL)
 {
     if (nblock > 0)
     {
         /* Reduce the bonded force buffer */
-        reduce_thread_force_buffer(n, f, nthreads, f_t, nblock, block_size);
+        reduce_thread_force_buffer(n, f, nthreads, f_t,
+                                   nblock, block, block_size);
     }
 
     /* When necessary, reduce energy and virial using one thread only */
@@ -4440,6 +5222,35 @@ static void reduce_thread_forces(int n, rvec *f, rvec *fshift,
     }
 }
 
+#ifdef GMX_SIMD_HAVE_REAL
+
+/* Function type of the SIMD bonded kernels without energies and shift forces */
+typedef void (*bonded_noener_simd_t)(int nbonds,
+                                     const t_iatom forceatoms[], const t_iparams forceparams[],
+                                     const rvec x[], rvec f[],
+                                     const t_pbc *pbc, const t_graph *g,
+                                     real lambda,
+                                     const t_mdatoms *md, t_fcdata *fcd,
+                                     int *global_atom_index);
+
+/* Returns the SIMD kernel without energies for ftype */
+static bonded_noener_simd_t get_bonded_noener_simd(int ftype)
+{
+    switch (ftype)
+    {
+        case F_UREY_BRADLEY: return urey_bradley_noener_simd;
+        case F_IDIHS:        return idihs_noener_simd;
+        case F_RBDIHS:       return rbdihs_noener_simd;
+        case F_RESTRANGLES:  return restrangles_noener_simd;
+        default:
+            gmx_incons("No SIMD bonded kernel for this interaction type");
+    }
+
+    return NULL;
+}
+
+#endif /* GMX_SIMD_HAVE_REAL */
+
 static real calc_one_bond(FILE *fplog, int thread,
                           int ftype, const t_idef *idef,
                           rvec x[], rvec f[], rvec fshift[],
@@ -4475,6 +5286,20 @@ static real calc_one_bond(FILE *fplog, int thread,
 
     if (!IS_LISTED_LJ_C(ftype))
     {
+#ifdef GMX_SIMD_HAVE_REAL
+        if (ftype == F_CMAP &&
+            !bCalcEnerVir && fr->efep == efepNO)
+        {
+            /* No energies, shift forces, dvdl */
+            cmap_dihs_noener_simd(nbn, iatoms+nb0,
+                                  idef->iparams, &idef->cmap_grid,
+                                  (const rvec*)x, f,
+                                  pbc, g, lambda[efptFTYPE], md, fcd,
+                                  global_atom_index);
+            v = 0;
+        }
+        else
+#endif
         if (ftype == F_CMAP)
         {
             v = cmap_dihs(nbn, iatoms+nb0,
@@ -4495,6 +5320,18 @@ static real calc_one_bond(FILE *fplog, int thread,
                                global_atom_index);
             v = 0;
         }
+        else if ((ftype == F_UREY_BRADLEY || ftype == F_IDIHS ||
+                  ftype == F_RBDIHS || ftype == F_RESTRANGLES) &&
+                 !bCalcEnerVir && fr->efep == efepNO)
+        {
+            /* No energies, shift forces, dvdl */
+            get_bonded_noener_simd(ftype)(nbn, iatoms+nb0,
+                                          idef->iparams,
+                                          (const rvec*)x, f,
+                                          pbc, g, lambda[efptFTYPE], md, fcd,
+                                          global_atom_index);
+            v = 0;
+        }
 #endif
         else if (ftype == F_PDIHS &&
                  !bCalcEnerVir && fr->efep == efepNO)
@@ -4645,7 +5482,7 @@ void calc_bonds(FILE *fplog, const gmx_multisim_t *ms,
         else
         {
             zero_thread_forces(&fr->f_t[thread], fr->natoms_force,
-                               fr->red_nblock, 1<<fr->red_ashift);
+                               1<<fr->red_ashift);
 
             ft     = fr->f_t[thread].f;
             fshift = fr->f_t[thread].fshift;
@@ -4672,7 +5509,8 @@ void calc_bonds(FILE *fplog, const gmx_multisim_t *ms,
         reduce_thread_forces(fr->natoms_force, f, fr->fshift,
                              enerd->term, &enerd->grpp, dvdl,
                              fr->nthreads, fr->f_t,
-                             fr->red_nblock, 1<<fr->red_ashift,
+                             fr->red_nblock_used, fr->red_block,
+                             1<<fr->red_ashift,
                              bCalcEnerVir,
                              force_flags & GMX_FORCE_DHDL);
     }
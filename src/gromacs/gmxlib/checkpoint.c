@@ -83,12 +83,15 @@
 
 #include "buildinfo.h"
 
+#include "thread_mpi/threads.h"
+
 #ifdef GMX_FAHCORE
 #include "corewrap.h"
 #endif
 
 #define CPT_MAGIC1 171817
 #define CPT_MAGIC2 171819
+#define CPT_MAGIC_PART 171821
 #define CPTSTRLEN 1024
 
 #ifdef GMX_DOUBLE
@@ -103,7 +106,7 @@
  * But old code can not read a new entry that is present in the file
  * (but can read a new format when new entries are not present).
  */
-static const int cpt_version = 16;
+static const int cpt_version = 17;
 
 
 const char *est_names[estNR] =
@@ -815,7 +818,7 @@ static void do_cpt_header(XDR *xd, gmx_bool bRead, int *file_version,
                           int *natoms, int *ngtc, int *nnhpres, int *nhchainlength,
                           int *nlambda, int *flags_state,
                           int *flags_eks, int *flags_enh, int *flags_dfh,
-                          int *nED, int *eSwapCoords,
+                          int *nED, int *eSwapCoords, int *nparts,
                           FILE *list)
 {
     bool_t res = 0;
@@ -962,6 +965,14 @@ static void do_cpt_header(XDR *xd, gmx_bool bRead, int *file_version,
     {
         do_cpt_int_err(xd, "swap", eSwapCoords, list);
     }
+    if (*file_version >= 17)
+    {
+        do_cpt_int_err(xd, "#distributed parts", nparts, list);
+    }
+    else
+    {
+        *nparts = 0;
+    }
 }
 
 static int do_cpt_footer(XDR *xd, int file_version)
@@ -986,6 +997,323 @@ static int do_cpt_footer(XDR *xd, int file_version)
     return 0;
 }
 
+/* The per-atom state entries, which are written in distributed parts
+ * when the checkpoint has nparts > 0.
+ */
+static int cpt_part_flags(int flags)
+{
+    return flags & ((1<<estX) | (1<<estV) | (1<<estSDX) | (1<<estCGP));
+}
+
+/* Returns the offset of the file name in path fn, i.e. the length of
+ * its directory part including the trailing separator.
+ */
+static int cpt_dir_length(const char *fn)
+{
+    const char *ptr;
+
+    ptr = strrchr(fn, DIR_SEPARATOR);
+#ifdef GMX_NATIVE_WINDOWS
+    if (strrchr(fn, '/') > ptr)
+    {
+        ptr = strrchr(fn, '/');
+    }
+#endif
+
+    return (ptr == NULL ? 0 : ptr - fn + 1);
+}
+
+/* Returns the file name of distributed part part of checkpoint file fn.
+ * The name is stored in the checkpoint file, so it does not contain
+ * the directory of fn; part files are always next to the checkpoint file.
+ */
+static char *cpt_part_filename(const char *fn, gmx_int64_t step, int part)
+{
+    char *partfn;
+    char  suffix[STEPSTRSIZE+32], sbuf[STEPSTRSIZE];
+    int   ndir, nbase;
+
+    ndir  = cpt_dir_length(fn);
+    nbase = strlen(fn) - strlen(ftp2ext(fn2ftp(fn))) - 1;
+    sprintf(suffix, "_step%s_part%d", gmx_step_str(step, sbuf), part);
+    snew(partfn, strlen(fn) - ndir + strlen(suffix) + 1);
+    strncpy(partfn, fn + ndir, nbase - ndir);
+    partfn[nbase - ndir] = '\0';
+    strcat(partfn, suffix);
+    strcat(partfn, fn + nbase);
+
+    return partfn;
+}
+
+/* Returns the path of part file partfile of checkpoint file fn,
+ * i.e. partfile in the directory of fn.
+ */
+static char *cpt_part_path(const char *fn, const char *partfile)
+{
+    char *path;
+    int   ndir;
+
+    ndir = cpt_dir_length(fn);
+    snew(path, ndir + strlen(partfile) + 1);
+    strncpy(path, fn, ndir);
+    path[ndir] = '\0';
+    strcat(path, partfile);
+
+    return path;
+}
+
+static void do_cpt_parts(XDR *xd, gmx_bool bRead,
+                         int nparts, char ***partfiles, FILE *list)
+{
+    int i;
+
+    if (bRead)
+    {
+        snew(*partfiles, nparts);
+    }
+    for (i = 0; i < nparts; i++)
+    {
+        do_cpt_string_err(xd, bRead, "distributed part file", &(*partfiles)[i], list);
+    }
+}
+
+static void free_cpt_parts(int nparts, char **partfiles)
+{
+    int i;
+
+    for (i = 0; i < nparts; i++)
+    {
+        sfree(partfiles[i]);
+    }
+    sfree(partfiles);
+}
+
+/* Reads or writes a distributed part: the per-atom entries in flags
+ * of nhome atoms with global atom indices index.
+ * On reading, x, v, sd_X and cg_p of state are allocated for nhome atoms.
+ */
+static void do_cpt_part(XDR *xd, gmx_bool bRead,
+                        gmx_int64_t *step, int *part, int *nparts,
+                        int *natoms, int *flags, int *nhome, int **index,
+                        t_state *state)
+{
+    int magic, part_version, est, ret;
+
+    magic        = CPT_MAGIC_PART;
+    part_version = 1;
+    do_cpt_int_err(xd, "magic number", &magic, NULL);
+    if (magic != CPT_MAGIC_PART)
+    {
+        gmx_fatal(FARGS, "Distributed checkpoint part has the wrong magic number");
+    }
+    do_cpt_int_err(xd, "part version", &part_version, NULL);
+    if (part_version != 1)
+    {
+        gmx_fatal(FARGS, "Attempting to read a distributed checkpoint part of version %d with code of version %d", part_version, 1);
+    }
+    do_cpt_step_err(xd, "step", step, NULL);
+    do_cpt_int_err(xd, "part", part, NULL);
+    do_cpt_int_err(xd, "#parts", nparts, NULL);
+    do_cpt_int_err(xd, "natoms", natoms, NULL);
+    do_cpt_int_err(xd, "state flags", flags, NULL);
+    do_cpt_int_err(xd, "#home atoms", nhome, NULL);
+    if (bRead)
+    {
+        snew(*index, *nhome);
+    }
+    if (xdr_vector(xd, (char *)*index, *nhome,
+                   (unsigned int)sizeof(int), (xdrproc_t)xdr_int) == 0)
+    {
+        cp_error();
+    }
+
+    ret = 0;
+    for (est = 0; est < estNR && ret == 0; est++)
+    {
+        if (*flags & (1<<est))
+        {
+            switch (est)
+            {
+                case estX:   ret = do_cpte_rvecs(xd, cptpEST, est, *flags, *nhome, &state->x, NULL); break;
+                case estV:   ret = do_cpte_rvecs(xd, cptpEST, est, *flags, *nhome, &state->v, NULL); break;
+                case estSDX: ret = do_cpte_rvecs(xd, cptpEST, est, *flags, *nhome, &state->sd_X, NULL); break;
+                case estCGP: ret = do_cpte_rvecs(xd, cptpEST, est, *flags, *nhome, &state->cg_p, NULL); break;
+                default:
+                    gmx_fatal(FARGS, "Unknown distributed state entry %d", est);
+            }
+        }
+    }
+    if (ret != 0 || do_cpt_footer(xd, cpt_version) != 0)
+    {
+        cp_error();
+    }
+}
+
+void write_checkpoint_part(const char *fn, gmx_int64_t step,
+                           int part, int nparts, int natoms,
+                           int nhome, int *index, t_state *state_local)
+{
+    char     *partname, *partfn;
+    t_fileio *fp;
+    int       flags;
+
+    partname = cpt_part_filename(fn, step, part);
+    partfn   = cpt_part_path(fn, partname);
+    sfree(partname);
+    flags    = cpt_part_flags(state_local->flags);
+
+    fp = gmx_fio_open(partfn, "w");
+    do_cpt_part(gmx_fio_getxdr(fp), FALSE, &step, &part, &nparts,
+                &natoms, &flags, &nhome, &index, state_local);
+
+    if (gmx_fio_fsync(fp) != 0)
+    {
+        char buf[STRLEN];
+        sprintf(buf,
+                "Cannot fsync '%s'; maybe you are out of disk space?",
+                partfn);
+
+        if (getenv(GMX_IGNORE_FSYNC_FAILURE_ENV) == NULL)
+        {
+            gmx_file(buf);
+        }
+        else
+        {
+            gmx_warning(buf);
+        }
+    }
+    if (gmx_fio_close(fp) != 0)
+    {
+        gmx_file("Cannot read/write checkpoint; corrupt file, or maybe you are out of disk space?");
+    }
+    sfree(partfn);
+}
+
+/* Reads the per-atom entries of the global state from the distributed
+ * parts of checkpoint file fn. Entries not present in state->flags
+ * are ignored.
+ */
+static void read_checkpoint_parts(const char *fn, int nparts, char **partfiles,
+                                  gmx_int64_t step, t_state *state)
+{
+    char        *partfn;
+    t_fileio    *fp;
+    t_state      part_state;
+    gmx_int64_t  part_step;
+    int          p, part, part_nparts, natoms, flags, nhome, i;
+    int         *index;
+    int          nread;
+
+    nread = 0;
+    for (p = 0; p < nparts; p++)
+    {
+        partfn = cpt_part_path(fn, partfiles[p]);
+        if (!gmx_fexist(partfn))
+        {
+            gmx_fatal(FARGS, "Distributed checkpoint part file '%s' is missing", partfn);
+        }
+        fp = gmx_fio_open(partfn, "r");
+
+        memset(&part_state, 0, sizeof(part_state));
+        index = NULL;
+        do_cpt_part(gmx_fio_getxdr(fp), TRUE, &part_step, &part, &part_nparts,
+                    &natoms, &flags, &nhome, &index, &part_state);
+        if (part_step != step || part != p || part_nparts != nparts ||
+            natoms != state->natoms)
+        {
+            gmx_fatal(FARGS, "Distributed checkpoint part file '%s' does not match the checkpoint file", partfn);
+        }
+        if (gmx_fio_close(fp) != 0)
+        {
+            gmx_file("Cannot read/write checkpoint; corrupt file, or maybe you are out of disk space?");
+        }
+
+        if ((state->flags & (1<<estX)) && state->x == NULL)
+        {
+            snew(state->x, state->natoms);
+        }
+        if ((state->flags & (1<<estV)) && state->v == NULL)
+        {
+            snew(state->v, state->natoms);
+        }
+        if ((state->flags & (1<<estSDX)) && state->sd_X == NULL)
+        {
+            snew(state->sd_X, state->natoms);
+        }
+        if ((state->flags & (1<<estCGP)) && state->cg_p == NULL)
+        {
+            snew(state->cg_p, state->natoms);
+        }
+        for (i = 0; i < nhome; i++)
+        {
+            if (index[i] < 0 || index[i] >= natoms)
+            {
+                gmx_fatal(FARGS, "Distributed checkpoint part file '%s' contains atom index %d, while there are %d atoms", partfn, index[i], natoms);
+            }
+            if (flags & state->flags & (1<<estX))
+            {
+                copy_rvec(part_state.x[i], state->x[index[i]]);
+            }
+            if (flags & state->flags & (1<<estV))
+            {
+                copy_rvec(part_state.v[i], state->v[index[i]]);
+            }
+            if (flags & state->flags & (1<<estSDX))
+            {
+                copy_rvec(part_state.sd_X[i], state->sd_X[index[i]]);
+            }
+            if (flags & state->flags & (1<<estCGP))
+            {
+                copy_rvec(part_state.cg_p[i], state->cg_p[index[i]]);
+            }
+        }
+        nread += nhome;
+
+        sfree(part_state.x);
+        sfree(part_state.v);
+        sfree(part_state.sd_X);
+        sfree(part_state.cg_p);
+        sfree(index);
+        sfree(partfn);
+    }
+
+    if (nread != state->natoms)
+    {
+        gmx_fatal(FARGS, "The distributed checkpoint parts contain %d atoms, while the checkpoint has %d atoms", nread, state->natoms);
+    }
+}
+
+/* Reads the list of distributed part files from the checkpoint file fn */
+static void read_checkpoint_part_list(const char *fn, int *nparts, char ***partfiles)
+{
+    t_fileio    *fp;
+    int          file_version;
+    char        *version, *btime, *buser, *bhost, *fprog, *ftime;
+    int          double_prec, eIntegrator, simulation_part, nppnodes, npme;
+    gmx_int64_t  step;
+    double       t;
+    ivec         dd_nc;
+    int          natoms, ngtc, nnhpres, nhchainlength, nlambda;
+    int          flags_state, flags_eks, flags_enh, flags_dfh, nED, eSwapCoords;
+
+    fp = gmx_fio_open(fn, "r");
+    do_cpt_header(gmx_fio_getxdr(fp), TRUE, &file_version,
+                  &version, &btime, &buser, &bhost, &double_prec, &fprog, &ftime,
+                  &eIntegrator, &simulation_part, &step, &t, &nppnodes, dd_nc, &npme,
+                  &natoms, &ngtc, &nnhpres, &nhchainlength, &nlambda,
+                  &flags_state, &flags_eks, &flags_enh, &flags_dfh,
+                  &nED, &eSwapCoords, nparts, NULL);
+    do_cpt_parts(gmx_fio_getxdr(fp), TRUE, *nparts, partfiles, NULL);
+    gmx_fio_close(fp);
+
+    sfree(version);
+    sfree(btime);
+    sfree(buser);
+    sfree(bhost);
+    sfree(fprog);
+    sfree(ftime);
+}
+
 static int do_cpt_state(XDR *xd, gmx_bool bRead,
                         int fflags, t_state *state,
                         FILE *list)
@@ -1495,124 +1823,207 @@ static int do_cpt_files(XDR *xd, gmx_bool bRead,
 }
 
 
-void write_checkpoint(const char *fn, gmx_bool bNumberAndKeep,
-                      FILE *fplog, t_commrec *cr,
-                      int eIntegrator, int simulation_part,
-                      gmx_bool bExpanded, int elamstats,
-                      gmx_int64_t step, double t, t_state *state)
-{
-    t_fileio            *fp;
-    int                  file_version;
-    char                *version;
-    char                *btime;
-    char                *buser;
-    char                *bhost;
-    int                  double_prec;
-    char                *fprog;
-    char                *fntemp; /* the temporary checkpoint file name */
-    time_t               now;
+/* All data needed for writing a checkpoint file */
+typedef struct {
+    char                *fn;             /* the checkpoint file name */
+    char                *fntemp;         /* the temporary checkpoint file name */
+    gmx_bool             bNumberAndKeep;
+    int                  eIntegrator;
+    int                  simulation_part;
+    gmx_int64_t          step;
+    double               t;
+    int                  nppnodes;
+    int                  npmenodes;
+    gmx_bool             bDomDec;
+    ivec                 dd_nc;
     char                 timebuf[STRLEN];
-    int                  nppnodes, npmenodes, flag_64bit;
-    char                 buf[1024], suffix[5+STEPSTRSIZE], sbuf[STEPSTRSIZE];
+    int                  flags_eks;
+    int                  flags_enh;
+    int                  flags_dfh;
+    t_state             *state;          /* the state, a copy when bCopy */
+    gmx_bool             bCopy;
+    int                  nparts;         /* the number of distributed parts */
+    char               **partfiles;      /* the file names of the parts */
     gmx_file_position_t *outputfiles;
     int                  noutputfiles;
-    char                *ftime;
-    int                  flags_eks, flags_enh, flags_dfh, i;
-    t_fileio            *ret;
+} t_cpt_job;
+
+/* The checkpoint writer thread, which writes one job at a time */
+struct gmx_checkpoint_writer {
+    tMPI_Thread_t        thread;
+    tMPI_Thread_mutex_t  mutex;
+    tMPI_Thread_cond_t   cond;
+    t_cpt_job           *job;            /* the job being written, or NULL */
+    gmx_bool             bStop;          /* the thread should stop */
+};
 
-    if (DOMAINDECOMP(cr))
-    {
-        nppnodes  = cr->dd->nnodes;
-        npmenodes = cr->npmenodes;
-    }
-    else
+/* Returns a newly allocated copy of the n elements of size size at src */
+static void *cpt_dup(const void *src, int n, size_t size)
+{
+    char *dest = NULL;
+
+    if (src != NULL && n > 0)
     {
-        nppnodes  = 1;
-        npmenodes = 0;
+        snew(dest, n*size);
+        memcpy(dest, src, n*size);
     }
 
-#ifndef GMX_NO_RENAME
-    /* make the new temporary filename */
-    snew(fntemp, strlen(fn)+5+STEPSTRSIZE);
-    strcpy(fntemp, fn);
-    fntemp[strlen(fn) - strlen(ftp2ext(fn2ftp(fn))) - 1] = '\0';
-    sprintf(suffix, "_%s%s", "step", gmx_step_str(step, sbuf));
-    strcat(fntemp, suffix);
-    strcat(fntemp, fn+strlen(fn) - strlen(ftp2ext(fn2ftp(fn))) - 1);
-#else
-    /* if we can't rename, we just overwrite the cpt file.
-     * dangerous if interrupted.
-     */
-    snew(fntemp, strlen(fn));
-    strcpy(fntemp, fn);
-#endif
-    time(&now);
-    gmx_ctime_r(&now, timebuf, STRLEN);
+    return dest;
+}
 
-    if (fplog)
-    {
-        fprintf(fplog, "Writing checkpoint, step %s at %s\n\n",
-                gmx_step_str(step, buf), timebuf);
-    }
+/* Returns a copy of all data of state that is written to checkpoint,
+ * except for dfhist, edsamstate and swapstate, of which only
+ * the non-pointer entries are copied. The per-atom entries are
+ * only copied with bAtoms.
+ */
+static t_state *copy_state_for_checkpoint(const t_state *src, gmx_bool bAtoms)
+{
+    t_state *dest;
+    int      nnht, nnhtp, i;
 
-    /* Get offsets for open files */
-    gmx_fio_get_output_file_positions(&outputfiles, &noutputfiles);
+    nnht  = src->nhchainlength*src->ngtc;
+    nnhtp = src->nhchainlength*src->nnhpres;
 
-    fp = gmx_fio_open(fntemp, "w");
+    snew(dest, 1);
+    *dest = *src;
 
-    if (state->ekinstate.bUpToDate)
+    dest->lambda         = cpt_dup(src->lambda, efptNR, sizeof(*src->lambda));
+    dest->nosehoover_xi  = cpt_dup(src->nosehoover_xi, nnht, sizeof(double));
+    dest->nosehoover_vxi = cpt_dup(src->nosehoover_vxi, nnht, sizeof(double));
+    dest->nhpres_xi      = cpt_dup(src->nhpres_xi, nnhtp, sizeof(double));
+    dest->nhpres_vxi     = cpt_dup(src->nhpres_vxi, nnhtp, sizeof(double));
+    dest->therm_integral = cpt_dup(src->therm_integral, src->ngtc, sizeof(double));
+    if (bAtoms)
     {
-        flags_eks =
-            ((1<<eeksEKIN_N) | (1<<eeksEKINH) | (1<<eeksEKINF) |
-             (1<<eeksEKINO) | (1<<eeksEKINSCALEF) | (1<<eeksEKINSCALEH) |
-             (1<<eeksVSCALE) | (1<<eeksDEKINDL) | (1<<eeksMVCOS));
+        dest->nalloc = src->natoms;
+        dest->x      = cpt_dup(src->x, src->natoms, sizeof(rvec));
+        dest->v      = cpt_dup(src->v, src->natoms, sizeof(rvec));
+        dest->sd_X   = cpt_dup(src->sd_X, src->natoms, sizeof(rvec));
+        dest->cg_p   = cpt_dup(src->cg_p, src->natoms, sizeof(rvec));
     }
     else
     {
-        flags_eks = 0;
+        dest->nalloc = 0;
+        dest->x      = NULL;
+        dest->v      = NULL;
+        dest->sd_X   = NULL;
+        dest->cg_p   = NULL;
     }
 
-    flags_enh = 0;
-    if (state->enerhist.nsum > 0 || state->enerhist.nsum_sim > 0)
+    dest->hist.disre_rm3tav = cpt_dup(src->hist.disre_rm3tav, src->hist.ndisrepairs, sizeof(real));
+    dest->hist.orire_Dtav   = cpt_dup(src->hist.orire_Dtav, src->hist.norire_Dtav, sizeof(real));
+
+    dest->ekinstate.ekinh          = cpt_dup(src->ekinstate.ekinh, src->ekinstate.ekin_n, sizeof(tensor));
+    dest->ekinstate.ekinf          = cpt_dup(src->ekinstate.ekinf, src->ekinstate.ekin_n, sizeof(tensor));
+    dest->ekinstate.ekinh_old      = cpt_dup(src->ekinstate.ekinh_old, src->ekinstate.ekin_n, sizeof(tensor));
+    dest->ekinstate.ekinscalef_nhc = cpt_dup(src->ekinstate.ekinscalef_nhc, src->ekinstate.ekin_n, sizeof(double));
+    dest->ekinstate.ekinscaleh_nhc = cpt_dup(src->ekinstate.ekinscaleh_nhc, src->ekinstate.ekin_n, sizeof(double));
+    dest->ekinstate.vscale_nhc     = cpt_dup(src->ekinstate.vscale_nhc, src->ekinstate.ekin_n, sizeof(double));
+
+    dest->enerhist.ener_ave     = cpt_dup(src->enerhist.ener_ave, src->enerhist.nener, sizeof(double));
+    dest->enerhist.ener_sum     = cpt_dup(src->enerhist.ener_sum, src->enerhist.nener, sizeof(double));
+    dest->enerhist.ener_sum_sim = cpt_dup(src->enerhist.ener_sum_sim, src->enerhist.nener, sizeof(double));
+    if (src->enerhist.dht != NULL)
     {
-        flags_enh |= (1<<eenhENERGY_N);
-        if (state->enerhist.nsum > 0)
-        {
-            flags_enh |= ((1<<eenhENERGY_AVER) | (1<<eenhENERGY_SUM) |
-                          (1<<eenhENERGY_NSTEPS) | (1<<eenhENERGY_NSUM));
-        }
-        if (state->enerhist.nsum_sim > 0)
-        {
-            flags_enh |= ((1<<eenhENERGY_SUM_SIM) | (1<<eenhENERGY_NSTEPS_SIM) |
-                          (1<<eenhENERGY_NSUM_SIM));
-        }
-        if (state->enerhist.dht)
+        const delta_h_history_t *dht = src->enerhist.dht;
+
+        snew(dest->enerhist.dht, 1);
+        *dest->enerhist.dht     = *dht;
+        dest->enerhist.dht->ndh = cpt_dup(dht->ndh, dht->nndh, sizeof(int));
+        snew(dest->enerhist.dht->dh, dht->nndh);
+        for (i = 0; i < dht->nndh; i++)
         {
-            flags_enh |= ( (1<< eenhENERGY_DELTA_H_NN) |
-                           (1<< eenhENERGY_DELTA_H_LIST) |
-                           (1<< eenhENERGY_DELTA_H_STARTTIME) |
-                           (1<< eenhENERGY_DELTA_H_STARTLAMBDA) );
+            dest->enerhist.dht->dh[i] = cpt_dup(dht->dh[i], dht->ndh[i], sizeof(real));
         }
     }
 
-    if (bExpanded)
+    /* The local DD data is not written */
+    dest->ncg_gl       = 0;
+    dest->cg_gl        = NULL;
+    dest->cg_gl_nalloc = 0;
+
+    return dest;
+}
+
+static void free_state_copy(t_state *state)
+{
+    int i;
+
+    sfree(state->lambda);
+    sfree(state->nosehoover_xi);
+    sfree(state->nosehoover_vxi);
+    sfree(state->nhpres_xi);
+    sfree(state->nhpres_vxi);
+    sfree(state->therm_integral);
+    sfree(state->x);
+    sfree(state->v);
+    sfree(state->sd_X);
+    sfree(state->cg_p);
+    sfree(state->hist.disre_rm3tav);
+    sfree(state->hist.orire_Dtav);
+    sfree(state->ekinstate.ekinh);
+    sfree(state->ekinstate.ekinf);
+    sfree(state->ekinstate.ekinh_old);
+    sfree(state->ekinstate.ekinscalef_nhc);
+    sfree(state->ekinstate.ekinscaleh_nhc);
+    sfree(state->ekinstate.vscale_nhc);
+    sfree(state->enerhist.ener_ave);
+    sfree(state->enerhist.ener_sum);
+    sfree(state->enerhist.ener_sum_sim);
+    if (state->enerhist.dht != NULL)
+    {
+        for (i = 0; i < state->enerhist.dht->nndh; i++)
+        {
+            sfree(state->enerhist.dht->dh[i]);
+        }
+        sfree(state->enerhist.dht->dh);
+        sfree(state->enerhist.dht->ndh);
+        sfree(state->enerhist.dht);
+    }
+    sfree(state);
+}
+
+/* Writes, fsyncs and renames the checkpoint file of job.
+ * When the checksums of the output files have not been computed yet,
+ * they are computed here, which can be done while the files
+ * are being appended to.
+ */
+static void write_checkpoint_job(t_cpt_job *job)
+{
+    t_fileio  *fp;
+    t_state   *state;
+    int        file_version;
+    char      *version;
+    char      *btime;
+    char      *buser;
+    char      *bhost;
+    int        double_prec;
+    char      *fprog;
+    char      *ftime;
+    int        flags_state;
+    char       buf[1024];
+    int        i, j;
+    t_fileio  *ret;
+    int        nparts_prev;
+    char     **partfiles_prev;
+    char      *partfn;
+
+    state = job->state;
+
+#ifndef GMX_FAHCORE
+    for (i = 0; i < job->noutputfiles; i++)
     {
-        flags_dfh = ((1<<edfhBEQUIL) | (1<<edfhNATLAMBDA) | (1<<edfhSUMWEIGHTS) |  (1<<edfhSUMDG)  |
-                     (1<<edfhTIJ) | (1<<edfhTIJEMP));
-        if (EWL(elamstats))
-        {
-            flags_dfh |= ((1<<edfhWLDELTA) | (1<<edfhWLHISTO));
-        }
-        if ((elamstats == elamstatsMINVAR) || (elamstats == elamstatsBARKER) || (elamstats == elamstatsMETROPOLIS))
+        if (job->outputfiles[i].chksum_size == -1)
         {
-            flags_dfh |= ((1<<edfhACCUMP) | (1<<edfhACCUMM) | (1<<edfhACCUMP2) | (1<<edfhACCUMM2)
-                          | (1<<edfhSUMMINVAR) | (1<<edfhSUMVAR));
+            job->outputfiles[i].chksum_size =
+                gmx_fio_get_named_file_md5(job->outputfiles[i].filename,
+                                           job->outputfiles[i].offset,
+                                           job->outputfiles[i].chksum);
         }
     }
-    else
-    {
-        flags_dfh = 0;
-    }
+#endif
+
+    fp = gmx_fio_open(job->fntemp, "w");
 
     /* We can check many more things now (CPU, acceleration, etc), but
      * it is highly unlikely to have two separate builds with exactly
@@ -1627,16 +2038,17 @@ void write_checkpoint(const char *fn, gmx_bool bNumberAndKeep,
     double_prec = GMX_CPT_BUILD_DP;
     fprog       = gmx_strdup(Program());
 
-    ftime   = &(timebuf[0]);
+    ftime   = &(job->timebuf[0]);
 
     do_cpt_header(gmx_fio_getxdr(fp), FALSE, &file_version,
                   &version, &btime, &buser, &bhost, &double_prec, &fprog, &ftime,
-                  &eIntegrator, &simulation_part, &step, &t, &nppnodes,
-                  DOMAINDECOMP(cr) ? cr->dd->nc : NULL, &npmenodes,
+                  &job->eIntegrator, &job->simulation_part, &job->step, &job->t, &job->nppnodes,
+                  job->bDomDec ? job->dd_nc : NULL, &job->npmenodes,
                   &state->natoms, &state->ngtc, &state->nnhpres,
-                  &state->nhchainlength, &(state->dfhist.nlambda), &state->flags, &flags_eks, &flags_enh, &flags_dfh,
+                  &state->nhchainlength, &(state->dfhist.nlambda), &state->flags, &job->flags_eks, &job->flags_enh, &job->flags_dfh,
                   &state->edsamstate.nED, &state->swapstate.eSwapCoords,
-                  NULL);
+                  &job->nparts, NULL);
+    do_cpt_parts(gmx_fio_getxdr(fp), FALSE, job->nparts, &job->partfiles, NULL);
 
     sfree(version);
     sfree(btime);
@@ -1644,13 +2056,20 @@ void write_checkpoint(const char *fn, gmx_bool bNumberAndKeep,
     sfree(bhost);
     sfree(fprog);
 
-    if ((do_cpt_state(gmx_fio_getxdr(fp), FALSE, state->flags, state, NULL) < 0)        ||
-        (do_cpt_ekinstate(gmx_fio_getxdr(fp), flags_eks, &state->ekinstate, NULL) < 0) ||
-        (do_cpt_enerhist(gmx_fio_getxdr(fp), FALSE, flags_enh, &state->enerhist, NULL) < 0)  ||
-        (do_cpt_df_hist(gmx_fio_getxdr(fp), flags_dfh, &state->dfhist, NULL) < 0)  ||
+    flags_state = state->flags;
+    if (job->nparts > 0)
+    {
+        /* The per-atom entries have been written to the parts */
+        flags_state &= ~cpt_part_flags(flags_state);
+    }
+
+    if ((do_cpt_state(gmx_fio_getxdr(fp), FALSE, flags_state, state, NULL) < 0)        ||
+        (do_cpt_ekinstate(gmx_fio_getxdr(fp), job->flags_eks, &state->ekinstate, NULL) < 0) ||
+        (do_cpt_enerhist(gmx_fio_getxdr(fp), FALSE, job->flags_enh, &state->enerhist, NULL) < 0)  ||
+        (do_cpt_df_hist(gmx_fio_getxdr(fp), job->flags_dfh, &state->dfhist, NULL) < 0)  ||
         (do_cpt_EDstate(gmx_fio_getxdr(fp), FALSE, &state->edsamstate, NULL) < 0)      ||
         (do_cpt_swapstate(gmx_fio_getxdr(fp), FALSE, &state->swapstate, NULL) < 0) ||
-        (do_cpt_files(gmx_fio_getxdr(fp), FALSE, &outputfiles, &noutputfiles, NULL,
+        (do_cpt_files(gmx_fio_getxdr(fp), FALSE, &job->outputfiles, &job->noutputfiles, NULL,
                       file_version) < 0))
     {
         gmx_file("Cannot read/write checkpoint; corrupt file, or maybe you are out of disk space?");
@@ -1689,8 +2108,12 @@ void write_checkpoint(const char *fn, gmx_bool bNumberAndKeep,
     /* we don't move the checkpoint if the user specified they didn't want it,
        or if the fsyncs failed */
 #ifndef GMX_NO_RENAME
-    if (!bNumberAndKeep && !ret)
+    if (!job->bNumberAndKeep && !ret)
     {
+        const char *fn = job->fn;
+
+        nparts_prev    = 0;
+        partfiles_prev = NULL;
         if (gmx_fexist(fn))
         {
             /* Rename the previous checkpoint file */
@@ -1698,6 +2121,13 @@ void write_checkpoint(const char *fn, gmx_bool bNumberAndKeep,
             buf[strlen(fn) - strlen(ftp2ext(fn2ftp(fn))) - 1] = '\0';
             strcat(buf, "_prev");
             strcat(buf, fn+strlen(fn) - strlen(ftp2ext(fn2ftp(fn))) - 1);
+            /* The distributed parts of the checkpoint that is replaced
+             * by the previous one are no longer needed.
+             */
+            if (gmx_fexist(buf))
+            {
+                read_checkpoint_part_list(buf, &nparts_prev, &partfiles_prev);
+            }
 #ifndef GMX_FAHCORE
             /* we copy here so that if something goes wrong between now and
              * the rename below, there's always a state.cpt.
@@ -1712,15 +2142,291 @@ void write_checkpoint(const char *fn, gmx_bool bNumberAndKeep,
             gmx_file_rename(fn, buf);
 #endif
         }
-        if (gmx_file_rename(fntemp, fn) != 0)
+        if (gmx_file_rename(job->fntemp, fn) != 0)
         {
             gmx_file("Cannot rename checkpoint file; maybe you are out of disk space?");
         }
+
+        for (i = 0; i < nparts_prev; i++)
+        {
+            /* Never remove a part that was just written */
+            for (j = 0; j < job->nparts; j++)
+            {
+                if (strcmp(partfiles_prev[i], job->partfiles[j]) == 0)
+                {
+                    break;
+                }
+            }
+            if (j == job->nparts)
+            {
+                partfn = cpt_part_path(fn, partfiles_prev[i]);
+                remove(partfn);
+                sfree(partfn);
+            }
+        }
+        free_cpt_parts(nparts_prev, partfiles_prev);
     }
 #endif  /* GMX_NO_RENAME */
+}
 
-    sfree(outputfiles);
-    sfree(fntemp);
+static void free_cpt_job(t_cpt_job *job)
+{
+    if (job->bCopy)
+    {
+        free_state_copy(job->state);
+    }
+    free_cpt_parts(job->nparts, job->partfiles);
+    sfree(job->outputfiles);
+    sfree(job->fntemp);
+    sfree(job->fn);
+    sfree(job);
+}
+
+static void *checkpoint_writer_thread(void *arg)
+{
+    gmx_checkpoint_writer_t cw = (gmx_checkpoint_writer_t)arg;
+    t_cpt_job              *job;
+
+    tMPI_Thread_mutex_lock(&cw->mutex);
+    while (!cw->bStop || cw->job != NULL)
+    {
+        if (cw->job == NULL)
+        {
+            tMPI_Thread_cond_wait(&cw->cond, &cw->mutex);
+            continue;
+        }
+        job = cw->job;
+        tMPI_Thread_mutex_unlock(&cw->mutex);
+
+        write_checkpoint_job(job);
+        free_cpt_job(job);
+
+        tMPI_Thread_mutex_lock(&cw->mutex);
+        cw->job = NULL;
+        tMPI_Thread_cond_broadcast(&cw->cond);
+    }
+    tMPI_Thread_mutex_unlock(&cw->mutex);
+
+    return NULL;
+}
+
+gmx_checkpoint_writer_t init_checkpoint_writer(void)
+{
+    gmx_checkpoint_writer_t cw = NULL;
+
+#ifndef GMX_FAHCORE
+    if (getenv("GMX_ASYNC_CHECKPOINT") != NULL &&
+        tMPI_Thread_support() == TMPI_THREAD_SUPPORT_YES)
+    {
+        snew(cw, 1);
+        tMPI_Thread_mutex_init(&cw->mutex);
+        tMPI_Thread_cond_init(&cw->cond);
+        if (tMPI_Thread_create(&cw->thread, checkpoint_writer_thread, cw) != 0)
+        {
+            gmx_fatal(FARGS, "Could not create the checkpoint writer thread");
+        }
+    }
+#endif
+
+    return cw;
+}
+
+void wait_checkpoint_writer(gmx_checkpoint_writer_t cw)
+{
+    if (cw == NULL)
+    {
+        return;
+    }
+
+    tMPI_Thread_mutex_lock(&cw->mutex);
+    while (cw->job != NULL)
+    {
+        tMPI_Thread_cond_wait(&cw->cond, &cw->mutex);
+    }
+    tMPI_Thread_mutex_unlock(&cw->mutex);
+}
+
+void done_checkpoint_writer(gmx_checkpoint_writer_t cw)
+{
+    if (cw == NULL)
+    {
+        return;
+    }
+
+    tMPI_Thread_mutex_lock(&cw->mutex);
+    cw->bStop = TRUE;
+    tMPI_Thread_cond_broadcast(&cw->cond);
+    tMPI_Thread_mutex_unlock(&cw->mutex);
+    tMPI_Thread_join(cw->thread, NULL);
+
+    tMPI_Thread_cond_destroy(&cw->cond);
+    tMPI_Thread_mutex_destroy(&cw->mutex);
+    sfree(cw);
+}
+
+void write_checkpoint(const char *fn, gmx_bool bNumberAndKeep,
+                      FILE *fplog, t_commrec *cr,
+                      int eIntegrator, int simulation_part,
+                      gmx_bool bExpanded, int elamstats,
+                      gmx_int64_t step, double t, t_state *state,
+                      int nparts, gmx_checkpoint_writer_t cw)
+{
+    t_cpt_job *job;
+    int        p;
+    time_t     now;
+    char       buf[1024], suffix[5+STEPSTRSIZE], sbuf[STEPSTRSIZE];
+    gmx_bool   bAsync;
+
+    /* Only finish the previous checkpoint now, so it overlaps with
+     * the MD steps in between. This also ensures that the checkpoint
+     * files are renamed in order.
+     */
+    wait_checkpoint_writer(cw);
+
+    /* Expanded ensemble, essential dynamics and position swapping
+     * history contain nested data that is not copied.
+     */
+    bAsync = (cw != NULL && !bExpanded &&
+              state->edsamstate.nED <= 0 &&
+              state->swapstate.eSwapCoords == eswapNO);
+
+    snew(job, 1);
+    job->fn              = gmx_strdup(fn);
+    job->bNumberAndKeep  = bNumberAndKeep;
+    job->eIntegrator     = eIntegrator;
+    job->simulation_part = simulation_part;
+    job->step            = step;
+    job->t               = t;
+    job->nparts          = nparts;
+    snew(job->partfiles, nparts);
+    for (p = 0; p < nparts; p++)
+    {
+        job->partfiles[p] = cpt_part_filename(fn, step, p);
+    }
+
+    if (DOMAINDECOMP(cr))
+    {
+        job->nppnodes  = cr->dd->nnodes;
+        job->npmenodes = cr->npmenodes;
+        job->bDomDec   = TRUE;
+        copy_ivec(cr->dd->nc, job->dd_nc);
+    }
+    else
+    {
+        job->nppnodes  = 1;
+        job->npmenodes = 0;
+        job->bDomDec   = FALSE;
+    }
+
+#ifndef GMX_NO_RENAME
+    /* make the new temporary filename */
+    snew(job->fntemp, strlen(fn)+5+STEPSTRSIZE);
+    strcpy(job->fntemp, fn);
+    job->fntemp[strlen(fn) - strlen(ftp2ext(fn2ftp(fn))) - 1] = '\0';
+    sprintf(suffix, "_%s%s", "step", gmx_step_str(step, sbuf));
+    strcat(job->fntemp, suffix);
+    strcat(job->fntemp, fn+strlen(fn) - strlen(ftp2ext(fn2ftp(fn))) - 1);
+#else
+    /* if we can't rename, we just overwrite the cpt file.
+     * dangerous if interrupted.
+     */
+    snew(job->fntemp, strlen(fn)+1);
+    strcpy(job->fntemp, fn);
+#endif
+    time(&now);
+    gmx_ctime_r(&now, job->timebuf, STRLEN);
+
+    if (fplog)
+    {
+        fprintf(fplog, "Writing checkpoint, step %s at %s\n\n",
+                gmx_step_str(step, buf), job->timebuf);
+    }
+
+    /* Get offsets for open files. When writing asynchronously,
+     * the checksums are computed later by the writer thread.
+     */
+    if (bAsync)
+    {
+        gmx_fio_get_output_file_offsets(&job->outputfiles, &job->noutputfiles);
+    }
+    else
+    {
+        gmx_fio_get_output_file_positions(&job->outputfiles, &job->noutputfiles);
+    }
+
+    if (state->ekinstate.bUpToDate)
+    {
+        job->flags_eks =
+            ((1<<eeksEKIN_N) | (1<<eeksEKINH) | (1<<eeksEKINF) |
+             (1<<eeksEKINO) | (1<<eeksEKINSCALEF) | (1<<eeksEKINSCALEH) |
+             (1<<eeksVSCALE) | (1<<eeksDEKINDL) | (1<<eeksMVCOS));
+    }
+    else
+    {
+        job->flags_eks = 0;
+    }
+
+    job->flags_enh = 0;
+    if (state->enerhist.nsum > 0 || state->enerhist.nsum_sim > 0)
+    {
+        job->flags_enh |= (1<<eenhENERGY_N);
+        if (state->enerhist.nsum > 0)
+        {
+            job->flags_enh |= ((1<<eenhENERGY_AVER) | (1<<eenhENERGY_SUM) |
+                               (1<<eenhENERGY_NSTEPS) | (1<<eenhENERGY_NSUM));
+        }
+        if (state->enerhist.nsum_sim > 0)
+        {
+            job->flags_enh |= ((1<<eenhENERGY_SUM_SIM) | (1<<eenhENERGY_NSTEPS_SIM) |
+                               (1<<eenhENERGY_NSUM_SIM));
+        }
+        if (state->enerhist.dht)
+        {
+            job->flags_enh |= ( (1<< eenhENERGY_DELTA_H_NN) |
+                                (1<< eenhENERGY_DELTA_H_LIST) |
+                                (1<< eenhENERGY_DELTA_H_STARTTIME) |
+                                (1<< eenhENERGY_DELTA_H_STARTLAMBDA) );
+        }
+    }
+
+    if (bExpanded)
+    {
+        job->flags_dfh = ((1<<edfhBEQUIL) | (1<<edfhNATLAMBDA) | (1<<edfhSUMWEIGHTS) |  (1<<edfhSUMDG)  |
+                          (1<<edfhTIJ) | (1<<edfhTIJEMP));
+        if (EWL(elamstats))
+        {
+            job->flags_dfh |= ((1<<edfhWLDELTA) | (1<<edfhWLHISTO));
+        }
+        if ((elamstats == elamstatsMINVAR) || (elamstats == elamstatsBARKER) || (elamstats == elamstatsMETROPOLIS))
+        {
+            job->flags_dfh |= ((1<<edfhACCUMP) | (1<<edfhACCUMM) | (1<<edfhACCUMP2) | (1<<edfhACCUMM2)
+                               | (1<<edfhSUMMINVAR) | (1<<edfhSUMVAR));
+        }
+    }
+    else
+    {
+        job->flags_dfh = 0;
+    }
+
+    if (bAsync)
+    {
+        /* Take a snapshot of the state, MD continues with the original */
+        job->state = copy_state_for_checkpoint(state, nparts == 0);
+        job->bCopy = TRUE;
+
+        tMPI_Thread_mutex_lock(&cw->mutex);
+        cw->job = job;
+        tMPI_Thread_cond_broadcast(&cw->cond);
+        tMPI_Thread_mutex_unlock(&cw->mutex);
+    }
+    else
+    {
+        job->state = state;
+        job->bCopy = FALSE;
+
+        write_checkpoint_job(job);
+        free_cpt_job(job);
+    }
 
 #ifdef GMX_FAHCORE
     /*code for alternate checkpointing scheme.  moved from top of loop over
@@ -1854,6 +2560,8 @@ static void read_checkpoint(const char *fn, FILE **pfplog,
     int                  ret;
     gmx_file_position_t *outputfiles;
     int                  nfiles;
+    int                  nparts;
+    char               **partfiles;
     t_fileio            *chksum_file;
     FILE               * fplog = *pfplog;
     unsigned char        digest[16];
@@ -1881,7 +2589,9 @@ static void read_checkpoint(const char *fn, FILE **pfplog,
                   &nppnodes_f, dd_nc_f, &npmenodes_f,
                   &natoms, &ngtc, &nnhpres, &nhchainlength, &nlambda,
                   &fflags, &flags_eks, &flags_enh, &flags_dfh,
-                  &state->edsamstate.nED, &state->swapstate.eSwapCoords, NULL);
+                  &state->edsamstate.nED, &state->swapstate.eSwapCoords,
+                  &nparts, NULL);
+    do_cpt_parts(gmx_fio_getxdr(fp), TRUE, nparts, &partfiles, NULL);
 
     if (bAppendOutputFiles &&
         file_version >= 13 && double_prec != GMX_CPT_BUILD_DP)
@@ -2019,7 +2729,9 @@ static void read_checkpoint(const char *fn, FILE **pfplog,
                         cr, nppnodes_f, npmenodes_f, dd_nc, dd_nc_f);
         }
     }
-    ret             = do_cpt_state(gmx_fio_getxdr(fp), TRUE, fflags, state, NULL);
+    ret             = do_cpt_state(gmx_fio_getxdr(fp), TRUE,
+                                   nparts > 0 ? fflags & ~cpt_part_flags(fflags) : fflags,
+                                   state, NULL);
     *init_fep_state = state->fep_state;  /* there should be a better way to do this than setting it here.
                                             Investigate for 5.0. */
     if (ret)
@@ -2088,6 +2800,15 @@ static void read_checkpoint(const char *fn, FILE **pfplog,
         gmx_file("Cannot read/write checkpoint; corrupt file, or maybe you are out of disk space?");
     }
 
+    if (nparts > 0)
+    {
+        /* The per-atom state was written by the ranks of the run
+         * that wrote the checkpoint, which can differ from ours.
+         */
+        read_checkpoint_parts(fn, nparts, partfiles, *step, state);
+    }
+    free_cpt_parts(nparts, partfiles);
+
     sfree(fprog);
     sfree(ftime);
     sfree(btime);
@@ -2285,6 +3006,8 @@ static void read_checkpoint_data(t_fileio *fp, int *simulation_part,
     int                  flags_eks, flags_enh, flags_dfh;
     int                  nfiles_loc;
     gmx_file_position_t *files_loc = NULL;
+    int                  nparts;
+    char               **partfiles;
     int                  ret;
 
     do_cpt_header(gmx_fio_getxdr(fp), TRUE, &file_version,
@@ -2292,9 +3015,13 @@ static void read_checkpoint_data(t_fileio *fp, int *simulation_part,
                   &eIntegrator, simulation_part, step, t, &nppnodes, dd_nc, &npme,
                   &state->natoms, &state->ngtc, &state->nnhpres, &state->nhchainlength,
                   &(state->dfhist.nlambda), &state->flags, &flags_eks, &flags_enh, &flags_dfh,
-                  &state->edsamstate.nED, &state->swapstate.eSwapCoords, NULL);
+                  &state->edsamstate.nED, &state->swapstate.eSwapCoords,
+                  &nparts, NULL);
+    do_cpt_parts(gmx_fio_getxdr(fp), TRUE, nparts, &partfiles, NULL);
     ret =
-        do_cpt_state(gmx_fio_getxdr(fp), TRUE, state->flags, state, NULL);
+        do_cpt_state(gmx_fio_getxdr(fp), TRUE,
+                     nparts > 0 ? state->flags & ~cpt_part_flags(state->flags) : state->flags,
+                     state, NULL);
     if (ret)
     {
         cp_error();
@@ -2348,6 +3075,12 @@ static void read_checkpoint_data(t_fileio *fp, int *simulation_part,
         cp_error();
     }
 
+    if (nparts > 0)
+    {
+        read_checkpoint_parts(gmx_fio_getname(fp), nparts, partfiles, *step, state);
+    }
+    free_cpt_parts(nparts, partfiles);
+
     sfree(fprog);
     sfree(ftime);
     sfree(btime);
@@ -2433,6 +3166,8 @@ void list_checkpoint(const char *fn, FILE *out)
     int                  ret;
     gmx_file_position_t *outputfiles;
     int                  nfiles;
+    int                  nparts;
+    char               **partfiles;
 
     init_state(&state, -1, -1, -1, -1, 0);
 
@@ -2443,8 +3178,11 @@ void list_checkpoint(const char *fn, FILE *out)
                   &state.natoms, &state.ngtc, &state.nnhpres, &state.nhchainlength,
                   &(state.dfhist.nlambda), &state.flags,
                   &flags_eks, &flags_enh, &flags_dfh, &state.edsamstate.nED,
-                  &state.swapstate.eSwapCoords, out);
-    ret = do_cpt_state(gmx_fio_getxdr(fp), TRUE, state.flags, &state, out);
+                  &state.swapstate.eSwapCoords, &nparts, out);
+    do_cpt_parts(gmx_fio_getxdr(fp), TRUE, nparts, &partfiles, out);
+    ret = do_cpt_state(gmx_fio_getxdr(fp), TRUE,
+                       nparts > 0 ? state.flags & ~cpt_part_flags(state.flags) : state.flags,
+                       &state, out);
     if (ret)
     {
         cp_error();
@@ -2492,6 +3230,8 @@ void list_checkpoint(const char *fn, FILE *out)
         gmx_file("Cannot read/write checkpoint; corrupt file, or maybe you are out of disk space?");
     }
 
+    /* The part file names have been freed after listing */
+    sfree(partfiles);
     done_state(&state);
 }
 
@@ -101,6 +101,7 @@ gmx_cpuid_feature_string[GMX_CPUID_NFEATURES] =
     "apic",
     "avx",
     "avx2",
+    "avx512f",
     "clfsh",
     "cmov",
     "cx8",
@@ -144,6 +145,7 @@ gmx_cpuid_simd_string[GMX_CPUID_NSIMD] =
     "AVX_128_FMA",
     "AVX_256",
     "AVX2_256",
+    "AVX_512",
     "Sparc64 HPC-ACE",
     "IBM_QPX"
 };
@@ -224,7 +226,9 @@ gmx_cpuid_feature           (gmx_cpuid_t                cpuid,
 
 
 /* What type of SIMD was compiled in, if any? */
-#ifdef GMX_SIMD_X86_AVX2_256
+#ifdef GMX_SIMD_X86_AVX_512
+static const enum gmx_cpuid_simd compiled_simd = GMX_CPUID_SIMD_X86_AVX_512;
+#elif defined GMX_SIMD_X86_AVX2_256
 static const enum gmx_cpuid_simd compiled_simd = GMX_CPUID_SIMD_X86_AVX2_256;
 #elif defined GMX_SIMD_X86_AVX_256
 static const enum gmx_cpuid_simd compiled_simd = GMX_CPUID_SIMD_X86_AVX_256;
@@ -648,7 +652,8 @@ cpuid_check_intel_x86(gmx_cpuid_t                cpuid)
     if (max_stdfn >= 7)
     {
         execute_x86cpuid(0x7, 0, &eax, &ebx, &ecx, &edx);
-        cpuid->feature[GMX_CPUID_FEATURE_X86_AVX2]    = (ebx & (1 << 5))  != 0;
+        cpuid->feature[GMX_CPUID_FEATURE_X86_AVX2]     = (ebx & (1 << 5))  != 0;
+        cpuid->feature[GMX_CPUID_FEATURE_X86_AVX_512F] = (ebx & (1 << 16)) != 0;
     }
 
     /* Check whether Hyper-Threading is enabled, not only supported */
@@ -1046,7 +1051,11 @@ gmx_cpuid_simd_suggest  (gmx_cpuid_t                 cpuid)
 
     if (gmx_cpuid_vendor(cpuid) == GMX_CPUID_VENDOR_INTEL)
     {
-        if (gmx_cpuid_feature(cpuid, GMX_CPUID_FEATURE_X86_AVX2))
+        if (gmx_cpuid_feature(cpuid, GMX_CPUID_FEATURE_X86_AVX_512F))
+        {
+            tmpsimd = GMX_CPUID_SIMD_X86_AVX_512;
+        }
+        else if (gmx_cpuid_feature(cpuid, GMX_CPUID_FEATURE_X86_AVX2))
         {
             tmpsimd = GMX_CPUID_SIMD_X86_AVX2_256;
         }
@@ -59,6 +59,25 @@ gmx_nb_free_energy_kernel(const t_nblist * gmx_restrict    nlist,
                           nb_kernel_data_t * gmx_restrict  kernel_data,
                           t_nrnb * gmx_restrict            nrnb)
 {
+    if (gmx_nb_free_energy_kernel_simd_supported(fr))
+    {
+        gmx_nb_free_energy_kernel_simd(nlist, xx, ff, fr, mdatoms, kernel_data, nrnb);
+    }
+    else
+    {
+        gmx_nb_free_energy_kernel_ref(nlist, xx, ff, fr, mdatoms, kernel_data, nrnb);
+    }
+}
+
+void
+gmx_nb_free_energy_kernel_ref(const t_nblist * gmx_restrict    nlist,
+                              rvec * gmx_restrict              xx,
+                              rvec * gmx_restrict              ff,
+                              t_forcerec * gmx_restrict        fr,
+                              const t_mdatoms * gmx_restrict   mdatoms,
+                              nb_kernel_data_t * gmx_restrict  kernel_data,
+                              t_nrnb * gmx_restrict            nrnb)
+{
 
 #define  STATE_A  0
 #define  STATE_B  1
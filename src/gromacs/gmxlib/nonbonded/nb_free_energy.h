@@ -41,6 +41,13 @@
 #include "nb_kernel.h"
 #include "typedefs.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Soft-core free-energy kernel, calls the SIMD kernel when supported,
+ * otherwise the plain C kernel.
+ */
 void
 gmx_nb_free_energy_kernel(const t_nblist * gmx_restrict    nlist,
                           rvec * gmx_restrict              xx,
@@ -50,6 +57,35 @@ gmx_nb_free_energy_kernel(const t_nblist * gmx_restrict    nlist,
                           nb_kernel_data_t * gmx_restrict  kernel_data,
                           t_nrnb * gmx_restrict            nrnb);
 
+/* The plain C soft-core free-energy kernel, supports all setups */
+void
+gmx_nb_free_energy_kernel_ref(const t_nblist * gmx_restrict    nlist,
+                              rvec * gmx_restrict              xx,
+                              rvec * gmx_restrict              ff,
+                              t_forcerec * gmx_restrict        fr,
+                              const t_mdatoms * gmx_restrict   mdatoms,
+                              nb_kernel_data_t * gmx_restrict  kernel_data,
+                              t_nrnb * gmx_restrict            nrnb);
+
+/* Returns whether gmx_nb_free_energy_kernel_simd supports the setup in fr:
+ * the Verlet scheme with reaction-field or Ewald electrostatics, plain or
+ * potential-shifted LJ and sc-r-power=6.
+ */
+gmx_bool
+gmx_nb_free_energy_kernel_simd_supported(const t_forcerec *fr);
+
+/* The SIMD soft-core free-energy kernel, only call when
+ * gmx_nb_free_energy_kernel_simd_supported returns TRUE.
+ */
+void
+gmx_nb_free_energy_kernel_simd(const t_nblist * gmx_restrict    nlist,
+                               rvec * gmx_restrict              xx,
+                               rvec * gmx_restrict              ff,
+                               t_forcerec * gmx_restrict        fr,
+                               const t_mdatoms * gmx_restrict   mdatoms,
+                               nb_kernel_data_t * gmx_restrict  kernel_data,
+                               t_nrnb * gmx_restrict            nrnb);
+
 real
     nb_free_energy_evaluate_single(real r2, real sc_r_power, real alpha_coul,
                                    real alpha_vdw, real tabscale, real *vftab,
@@ -60,4 +96,8 @@ real
                                    real sigma2_def, real sigma2_min,
                                    real *velectot, real *vvdwtot, real *dvdl);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
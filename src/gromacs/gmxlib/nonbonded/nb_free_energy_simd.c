@@ -0,0 +1,597 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "typedefs.h"
+#include "nonbonded.h"
+#include "nb_kernel.h"
+#include "nrnb.h"
+#include "macros.h"
+#include "nb_free_energy.h"
+
+#include "gromacs/pbcutil/ishift.h"
+#include "gromacs/simd/simd.h"
+#include "gromacs/simd/simd_math.h"
+#include "gromacs/simd/vector_operations.h"
+#include "gromacs/utility/fatalerror.h"
+
+gmx_bool
+gmx_nb_free_energy_kernel_simd_supported(const t_forcerec *fr)
+{
+#ifdef GMX_SIMD_HAVE_REAL
+    const interaction_const_t *ic = fr->ic;
+
+    /* Only the most common Verlet setups are supported, the cubic spline
+     * tables, potential-switch modifiers, LJ-PME and soft-core powers
+     * other than 6 are left to the plain C kernel.
+     */
+    return (fr->use_simd_kernels &&
+            fr->cutoff_scheme == ecutsVERLET &&
+            fr->sc_r_power == 6.0 &&
+            (ic->eeltype == eelCUT || EEL_RF(ic->eeltype) ||
+             EEL_PME_EWALD(ic->eeltype)) &&
+            !EVDW_PME(ic->vdwtype) &&
+            fr->coulomb_modifier != eintmodPOTSWITCH &&
+            (fr->vdw_modifier == eintmodNONE ||
+             fr->vdw_modifier == eintmodPOTSHIFT));
+#else
+    GMX_UNUSED_VALUE(fr);
+
+    return FALSE;
+#endif
+}
+
+/* Soft-core free-energy kernel using SIMD for GMX_SIMD_REAL_WIDTH
+ * j-particles at once. The physics is identical to the plain C kernel,
+ * except that the Ewald correction is computed analytically instead of
+ * with the quadratic spline tables.
+ * Energies, dV/dlambda and shift forces are accumulated locally and only
+ * reduced to the shared output at the end (energies when the energy group
+ * pair changes), which avoids most of the atomics in the plain C kernel.
+ */
+void
+gmx_nb_free_energy_kernel_simd(const t_nblist * gmx_restrict    nlist,
+                               rvec * gmx_restrict              xx,
+                               rvec * gmx_restrict              ff,
+                               t_forcerec * gmx_restrict        fr,
+                               const t_mdatoms * gmx_restrict   mdatoms,
+                               nb_kernel_data_t * gmx_restrict  kernel_data,
+                               t_nrnb * gmx_restrict            nrnb)
+#ifdef GMX_SIMD_HAVE_REAL
+{
+#define  STATE_A  0
+#define  STATE_B  1
+#define  NSTATES  2
+    /* Indices into the packed, aligned j-particle buffer */
+    enum {
+        jbX, jbY, jbZ, jbQA, jbQB, jbC6A, jbC6B, jbC12A, jbC12B,
+        jbIncl, jbSelf, jbNR
+    };
+    const interaction_const_t *ic;
+    int             n, s, st, k, nj0, nj1, ii, ii3, is3, jnr, ntiA, ntiB, ggid, ggid_prev;
+    int             jnr_s[GMX_SIMD_REAL_WIDTH];
+    real            jbuf_array[(jbNR + 1)*GMX_SIMD_REAL_WIDTH], *jbuf;
+    real            fbuf_array[(DIM + 1)*GMX_SIMD_REAL_WIDTH], *fbuf;
+    real            fshift_loc[SHIFTS*DIM];
+    const int      *iinr, *jindex, *jjnr, *shift, *gid, *typeA, *typeB;
+    const real     *x, *shiftvec, *chargeA, *chargeB, *nbfp;
+    real           *f, *fshift, *Vc, *Vv, *dvdl;
+    real            facel, iqA, iqB, ix, iy, iz, fix, fiy, fiz;
+    real            vctot_grp, vvtot_grp;
+    double          dvdl_coul, dvdl_vdw;
+    real            lambda_coul, lambda_vdw, lam_power, sc_r_power;
+    real            LFC[NSTATES], LFV[NSTATES], DLF[NSTATES];
+    real            lfac_coul[NSTATES], dlfac_coul[NSTATES], lfac_vdw[NSTATES], dlfac_vdw[NSTATES];
+    real            rcutoff_max, rcutoff_max2, rvdw, rcoulomb, beta;
+    gmx_bool        bDoForces, bDoShiftForces, bDoPotential, bEwald, bRF, bAnyInRange;
+
+    gmx_simd_real_t zero_S, half_S, one_S, rcutoff_max2_S, rcoulomb2_S;
+    gmx_simd_real_t rcoulomb6inv_S, rvdw6inv_S;
+    gmx_simd_real_t sigma6_def_S, sigma6_min_S, alpha_coul_S, alpha_vdw_S;
+    gmx_simd_real_t krf_S, crf_S, two_krf_S, sh_ewald_S, sh_invrc6_S, sh_invrc12_S;
+    gmx_simd_real_t beta_S, beta2_S, minus_beta3_S, sixth_S, twelfth_S, inv_sc_r_power_S;
+    gmx_simd_real_t LFC_S[NSTATES], LFV_S[NSTATES], DLF_S[NSTATES];
+    gmx_simd_real_t lfac_coul_S[NSTATES], dlfac_coul_S[NSTATES];
+    gmx_simd_real_t lfac_vdw_S[NSTATES], dlfac_vdw_S[NSTATES];
+    gmx_simd_real_t iqA_S, iqB_S, ix_S, iy_S, iz_S;
+    gmx_simd_real_t fix_S, fiy_S, fiz_S, vctot_S, vvtot_S, dvdl_coul_S, dvdl_vdw_S;
+    gmx_simd_real_t dx_S, dy_S, dz_S, rsq_S, rsq_sc_S, rp_S, rpm2_S;
+    gmx_simd_real_t qq_S[NSTATES], c6_S[NSTATES], c12_S[NSTATES], sigma6_S[NSTATES];
+    gmx_simd_real_t alpha_coul_eff_S, alpha_vdw_eff_S, incl_S, self_S;
+    gmx_simd_real_t rpinvC_S, rinvC_S, rC2_S, rpinvV_S, rinv6_S, vvdw6_S, vvdw12_S;
+    gmx_simd_real_t vcoul_S, vvdw_S, fscalC_S, fscalV_S, fscal_S, vctot_pair_S, vvtot_pair_S;
+    gmx_simd_real_t dvdl_coul_pair_S, dvdl_vdw_pair_S, qqlfc_S, qqdlf_S, VV_S, FF_S, brsq_S;
+    gmx_simd_real_t tx_S, ty_S, tz_S;
+    gmx_simd_bool_t wco_S, wco_coul_S, wco_vdw_S, incl_B, ljpair_B, nosc_B, zero_B;
+
+    ic                  = fr->ic;
+
+    x                   = xx[0];
+    f                   = ff[0];
+    fshift              = fr->fshift[0];
+
+    iinr                = nlist->iinr;
+    jindex              = nlist->jindex;
+    jjnr                = nlist->jjnr;
+    shift               = nlist->shift;
+    gid                 = nlist->gid;
+
+    shiftvec            = fr->shift_vec[0];
+    chargeA             = mdatoms->chargeA;
+    chargeB             = mdatoms->chargeB;
+    typeA               = mdatoms->typeA;
+    typeB               = mdatoms->typeB;
+    nbfp                = fr->nbfp;
+    facel               = fr->epsfac;
+    Vc                  = kernel_data->energygrp_elec;
+    Vv                  = kernel_data->energygrp_vdw;
+    dvdl                = kernel_data->dvdl;
+    lambda_coul         = kernel_data->lambda[efptCOUL];
+    lambda_vdw          = kernel_data->lambda[efptVDW];
+    lam_power           = fr->sc_power;
+    sc_r_power          = fr->sc_r_power;
+    bDoForces           = kernel_data->flags & GMX_NONBONDED_DO_FORCE;
+    bDoShiftForces      = kernel_data->flags & GMX_NONBONDED_DO_SHIFTFORCE;
+    bDoPotential        = kernel_data->flags & GMX_NONBONDED_DO_POTENTIAL;
+
+    rcoulomb            = fr->rcoulomb;
+    rvdw                = fr->rvdw;
+    rcutoff_max         = max(rcoulomb, rvdw);
+    rcutoff_max2        = rcutoff_max*rcutoff_max;
+    bEwald              = EEL_PME_EWALD(ic->eeltype);
+    bRF                 = !bEwald;
+    beta                = ic->ewaldcoeff_q;
+
+    jbuf                = gmx_simd_align_r(jbuf_array);
+    fbuf                = gmx_simd_align_r(fbuf_array);
+
+    /* Lambda factors and their derivatives, as in the plain C kernel */
+    LFC[STATE_A] = 1.0 - lambda_coul;
+    LFV[STATE_A] = 1.0 - lambda_vdw;
+    LFC[STATE_B] = lambda_coul;
+    LFV[STATE_B] = lambda_vdw;
+    DLF[STATE_A] = -1;
+    DLF[STATE_B] = 1;
+    for (st = 0; st < NSTATES; st++)
+    {
+        lfac_coul[st]    = (lam_power == 2 ? (1-LFC[st])*(1-LFC[st]) : (1-LFC[st]));
+        dlfac_coul[st]   = DLF[st]*lam_power/sc_r_power*(lam_power == 2 ? (1-LFC[st]) : 1);
+        lfac_vdw[st]     = (lam_power == 2 ? (1-LFV[st])*(1-LFV[st]) : (1-LFV[st]));
+        dlfac_vdw[st]    = DLF[st]*lam_power/sc_r_power*(lam_power == 2 ? (1-LFV[st]) : 1);
+
+        LFC_S[st]        = gmx_simd_set1_r(LFC[st]);
+        LFV_S[st]        = gmx_simd_set1_r(LFV[st]);
+        DLF_S[st]        = gmx_simd_set1_r(DLF[st]);
+        lfac_coul_S[st]  = gmx_simd_set1_r(lfac_coul[st]);
+        dlfac_coul_S[st] = gmx_simd_set1_r(dlfac_coul[st]);
+        lfac_vdw_S[st]   = gmx_simd_set1_r(lfac_vdw[st]);
+        dlfac_vdw_S[st]  = gmx_simd_set1_r(dlfac_vdw[st]);
+    }
+
+    zero_S           = gmx_simd_setzero_r();
+    half_S           = gmx_simd_set1_r(0.5);
+    one_S            = gmx_simd_set1_r(1.0);
+    sixth_S          = gmx_simd_set1_r(1.0/6.0);
+    twelfth_S        = gmx_simd_set1_r(1.0/12.0);
+    inv_sc_r_power_S = gmx_simd_set1_r(1.0/sc_r_power);
+    rcutoff_max2_S   = gmx_simd_set1_r(rcutoff_max2);
+    rcoulomb2_S      = gmx_simd_set1_r(rcoulomb*rcoulomb);
+    /* With sc-r-power=6, rC < rc is equivalent to 1/rC^6 > 1/rc^6 */
+    rcoulomb6inv_S   = gmx_simd_set1_r(1.0/(rcoulomb*rcoulomb*rcoulomb*rcoulomb*rcoulomb*rcoulomb));
+    rvdw6inv_S       = gmx_simd_set1_r(1.0/(rvdw*rvdw*rvdw*rvdw*rvdw*rvdw));
+    sigma6_def_S     = gmx_simd_set1_r(fr->sc_sigma6_def);
+    sigma6_min_S     = gmx_simd_set1_r(fr->sc_sigma6_min);
+    alpha_coul_S     = gmx_simd_set1_r(fr->sc_alphacoul);
+    alpha_vdw_S      = gmx_simd_set1_r(fr->sc_alphavdw);
+    krf_S            = gmx_simd_set1_r(bRF ? fr->k_rf : 0);
+    two_krf_S        = gmx_simd_set1_r(bRF ? 2*fr->k_rf : 0);
+    crf_S            = gmx_simd_set1_r(bRF ? fr->c_rf : 0);
+    sh_ewald_S       = gmx_simd_set1_r(bEwald ? ic->sh_ewald : 0);
+    if (fr->vdw_modifier == eintmodPOTSHIFT)
+    {
+        sh_invrc6_S  = gmx_simd_set1_r(ic->sh_invrc6);
+        sh_invrc12_S = gmx_simd_set1_r(ic->sh_invrc6*ic->sh_invrc6);
+    }
+    else
+    {
+        sh_invrc6_S  = zero_S;
+        sh_invrc12_S = zero_S;
+    }
+    beta_S           = gmx_simd_set1_r(beta);
+    beta2_S          = gmx_simd_set1_r(beta*beta);
+    minus_beta3_S    = gmx_simd_set1_r(-beta*beta*beta);
+
+    for (k = 0; k < SHIFTS*DIM; k++)
+    {
+        fshift_loc[k] = 0;
+    }
+
+    dvdl_coul  = 0;
+    dvdl_vdw   = 0;
+    vctot_grp  = 0;
+    vvtot_grp  = 0;
+    ggid_prev  = -1;
+
+    for (n = 0; n < nlist->nri; n++)
+    {
+        is3              = 3*shift[n];
+        nj0              = jindex[n];
+        nj1              = jindex[n+1];
+        ii               = iinr[n];
+        ii3              = 3*ii;
+        ix               = shiftvec[is3]   + x[ii3+0];
+        iy               = shiftvec[is3+1] + x[ii3+1];
+        iz               = shiftvec[is3+2] + x[ii3+2];
+        iqA              = facel*chargeA[ii];
+        iqB              = facel*chargeB[ii];
+        ntiA             = 2*fr->ntype*typeA[ii];
+        ntiB             = 2*fr->ntype*typeB[ii];
+
+        ix_S             = gmx_simd_set1_r(ix);
+        iy_S             = gmx_simd_set1_r(iy);
+        iz_S             = gmx_simd_set1_r(iz);
+        iqA_S            = gmx_simd_set1_r(iqA);
+        iqB_S            = gmx_simd_set1_r(iqB);
+
+        fix_S            = zero_S;
+        fiy_S            = zero_S;
+        fiz_S            = zero_S;
+        vctot_S          = zero_S;
+        vvtot_S          = zero_S;
+        dvdl_coul_S      = zero_S;
+        dvdl_vdw_S       = zero_S;
+        bAnyInRange      = FALSE;
+
+        for (k = nj0; k < nj1; k += GMX_SIMD_REAL_WIDTH)
+        {
+            /* Pack the j-particle data. Padding entries are put far
+             * outside the cut-off and have zero parameters.
+             */
+            for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+            {
+                if (k + s < nj1)
+                {
+                    int tjA, tjB;
+
+                    jnr                                  = jjnr[k + s];
+                    jnr_s[s]                             = jnr;
+                    tjA                                  = ntiA + 2*typeA[jnr];
+                    tjB                                  = ntiB + 2*typeB[jnr];
+                    jbuf[jbX*GMX_SIMD_REAL_WIDTH + s]    = x[3*jnr];
+                    jbuf[jbY*GMX_SIMD_REAL_WIDTH + s]    = x[3*jnr+1];
+                    jbuf[jbZ*GMX_SIMD_REAL_WIDTH + s]    = x[3*jnr+2];
+                    jbuf[jbQA*GMX_SIMD_REAL_WIDTH + s]   = chargeA[jnr];
+                    jbuf[jbQB*GMX_SIMD_REAL_WIDTH + s]   = chargeB[jnr];
+                    jbuf[jbC6A*GMX_SIMD_REAL_WIDTH + s]  = nbfp[tjA];
+                    jbuf[jbC6B*GMX_SIMD_REAL_WIDTH + s]  = nbfp[tjB];
+                    jbuf[jbC12A*GMX_SIMD_REAL_WIDTH + s] = nbfp[tjA+1];
+                    jbuf[jbC12B*GMX_SIMD_REAL_WIDTH + s] = nbfp[tjB+1];
+                    jbuf[jbIncl*GMX_SIMD_REAL_WIDTH + s] =
+                        (nlist->excl_fep == NULL || nlist->excl_fep[k + s]) ? 1 : 0;
+                    /* The self-interaction only contributes half the energy */
+                    jbuf[jbSelf*GMX_SIMD_REAL_WIDTH + s] = (jnr == ii) ? 0.5 : 1;
+                }
+                else
+                {
+                    jnr_s[s]                             = -1;
+                    jbuf[jbX*GMX_SIMD_REAL_WIDTH + s]    = ix + 2*rcutoff_max + 1;
+                    jbuf[jbY*GMX_SIMD_REAL_WIDTH + s]    = iy;
+                    jbuf[jbZ*GMX_SIMD_REAL_WIDTH + s]    = iz;
+                    jbuf[jbQA*GMX_SIMD_REAL_WIDTH + s]   = 0;
+                    jbuf[jbQB*GMX_SIMD_REAL_WIDTH + s]   = 0;
+                    jbuf[jbC6A*GMX_SIMD_REAL_WIDTH + s]  = 0;
+                    jbuf[jbC6B*GMX_SIMD_REAL_WIDTH + s]  = 0;
+                    jbuf[jbC12A*GMX_SIMD_REAL_WIDTH + s] = 0;
+                    jbuf[jbC12B*GMX_SIMD_REAL_WIDTH + s] = 0;
+                    jbuf[jbIncl*GMX_SIMD_REAL_WIDTH + s] = 0;
+                    jbuf[jbSelf*GMX_SIMD_REAL_WIDTH + s] = 1;
+                }
+            }
+
+            dx_S   = gmx_simd_sub_r(ix_S, gmx_simd_load_r(jbuf + jbX*GMX_SIMD_REAL_WIDTH));
+            dy_S   = gmx_simd_sub_r(iy_S, gmx_simd_load_r(jbuf + jbY*GMX_SIMD_REAL_WIDTH));
+            dz_S   = gmx_simd_sub_r(iz_S, gmx_simd_load_r(jbuf + jbZ*GMX_SIMD_REAL_WIDTH));
+            rsq_S  = gmx_simd_norm2_r(dx_S, dy_S, dz_S);
+
+            /* As in the plain C kernel, checking on r is safe, since the
+             * soft-core distance is always larger than r.
+             */
+            wco_S  = gmx_simd_cmplt_r(rsq_S, rcutoff_max2_S);
+            if (!gmx_simd_anytrue_b(wco_S))
+            {
+                continue;
+            }
+            bAnyInRange = TRUE;
+
+            qq_S[STATE_A]  = gmx_simd_mul_r(iqA_S, gmx_simd_load_r(jbuf + jbQA*GMX_SIMD_REAL_WIDTH));
+            qq_S[STATE_B]  = gmx_simd_mul_r(iqB_S, gmx_simd_load_r(jbuf + jbQB*GMX_SIMD_REAL_WIDTH));
+            c6_S[STATE_A]  = gmx_simd_load_r(jbuf + jbC6A*GMX_SIMD_REAL_WIDTH);
+            c6_S[STATE_B]  = gmx_simd_load_r(jbuf + jbC6B*GMX_SIMD_REAL_WIDTH);
+            c12_S[STATE_A] = gmx_simd_load_r(jbuf + jbC12A*GMX_SIMD_REAL_WIDTH);
+            c12_S[STATE_B] = gmx_simd_load_r(jbuf + jbC12B*GMX_SIMD_REAL_WIDTH);
+            incl_S         = gmx_simd_load_r(jbuf + jbIncl*GMX_SIMD_REAL_WIDTH);
+            self_S         = gmx_simd_load_r(jbuf + jbSelf*GMX_SIMD_REAL_WIDTH);
+            incl_B         = gmx_simd_cmplt_r(zero_S, incl_S);
+
+            /* Excluded pairs, which can be at r=0, don't use soft-core.
+             * Set their distance to 1 for the soft-core part to avoid
+             * floating-point exceptions, the results are masked out anyhow.
+             */
+            rsq_sc_S       = gmx_simd_blendv_r(one_S, rsq_S, incl_B);
+            rpm2_S         = gmx_simd_mul_r(rsq_sc_S, rsq_sc_S);
+            rp_S           = gmx_simd_mul_r(rpm2_S, rsq_sc_S);
+
+            /* Only use soft-core when one of the states has zero c12 */
+            nosc_B           = gmx_simd_and_b(gmx_simd_cmplt_r(zero_S, c12_S[STATE_A]),
+                                              gmx_simd_cmplt_r(zero_S, c12_S[STATE_B]));
+            alpha_coul_eff_S = gmx_simd_blendnotzero_r(alpha_coul_S, nosc_B);
+            alpha_vdw_eff_S  = gmx_simd_blendnotzero_r(alpha_vdw_S, nosc_B);
+
+            fscal_S          = zero_S;
+            vctot_pair_S     = zero_S;
+            vvtot_pair_S     = zero_S;
+            dvdl_coul_pair_S = zero_S;
+            dvdl_vdw_pair_S  = zero_S;
+
+            for (st = 0; st < NSTATES; st++)
+            {
+                /* c12 is stored scaled with 12.0 and c6 with 6.0,
+                 * so sigma^6 = 0.5*c12/c6.
+                 */
+                ljpair_B     = gmx_simd_and_b(gmx_simd_cmplt_r(zero_S, c6_S[st]),
+                                              gmx_simd_cmplt_r(zero_S, c12_S[st]));
+                sigma6_S[st] = gmx_simd_mul_r(gmx_simd_mul_r(half_S, c12_S[st]),
+                                              gmx_simd_inv_r(gmx_simd_blendv_r(one_S, c6_S[st], ljpair_B)));
+                sigma6_S[st] = gmx_simd_max_r(sigma6_S[st], sigma6_min_S);
+                sigma6_S[st] = gmx_simd_blendv_r(sigma6_def_S, sigma6_S[st], ljpair_B);
+
+                /* Zero parameters in this state: no contribution */
+                zero_B       = gmx_simd_and_b(gmx_simd_cmpeq_r(qq_S[st], zero_S),
+                                              gmx_simd_and_b(gmx_simd_cmpeq_r(c6_S[st], zero_S),
+                                                             gmx_simd_cmpeq_r(c12_S[st], zero_S)));
+
+                rpinvC_S     = gmx_simd_inv_r(gmx_simd_fmadd_r(gmx_simd_mul_r(alpha_coul_eff_S, lfac_coul_S[st]),
+                                                               sigma6_S[st], rp_S));
+                rpinvV_S     = gmx_simd_inv_r(gmx_simd_fmadd_r(gmx_simd_mul_r(alpha_vdw_eff_S, lfac_vdw_S[st]),
+                                                               sigma6_S[st], rp_S));
+                /* rinvC = rpinvC^(1/6), done as exp(log(rpinvC)/6) */
+                rinvC_S      = gmx_simd_exp_r(gmx_simd_mul_r(inv_sc_r_power_S, gmx_simd_log_r(rpinvC_S)));
+
+                /* With Ewald we put the cut-off on r, otherwise on rC */
+                if (bEwald)
+                {
+                    wco_coul_S = gmx_simd_cmplt_r(rsq_S, rcoulomb2_S);
+                    vcoul_S    = gmx_simd_mul_r(qq_S[st], gmx_simd_sub_r(rinvC_S, sh_ewald_S));
+                    fscalC_S   = gmx_simd_mul_r(qq_S[st], rinvC_S);
+                }
+                else
+                {
+                    wco_coul_S = gmx_simd_cmplt_r(rcoulomb6inv_S, rpinvC_S);
+                    rC2_S      = gmx_simd_inv_r(gmx_simd_mul_r(rinvC_S, rinvC_S));
+                    vcoul_S    = gmx_simd_mul_r(qq_S[st],
+                                                gmx_simd_sub_r(gmx_simd_fmadd_r(krf_S, rC2_S, rinvC_S), crf_S));
+                    fscalC_S   = gmx_simd_mul_r(qq_S[st], gmx_simd_fnmadd_r(two_krf_S, rC2_S, rinvC_S));
+                }
+                wco_coul_S   = gmx_simd_and_b(wco_coul_S,
+                                              gmx_simd_cmplt_r(zero_S, gmx_simd_fabs_r(qq_S[st])));
+                vcoul_S      = gmx_simd_blendzero_r(vcoul_S, wco_coul_S);
+                fscalC_S     = gmx_simd_blendzero_r(fscalC_S, wco_coul_S);
+
+                wco_vdw_S    = gmx_simd_cmplt_r(rvdw6inv_S, rpinvV_S);
+                rinv6_S      = rpinvV_S;
+                vvdw6_S      = gmx_simd_mul_r(c6_S[st], rinv6_S);
+                vvdw12_S     = gmx_simd_mul_r(c12_S[st], gmx_simd_mul_r(rinv6_S, rinv6_S));
+                vvdw_S       = gmx_simd_fmsub_r(gmx_simd_fnmadd_r(c12_S[st], sh_invrc12_S, vvdw12_S), twelfth_S,
+                                                gmx_simd_mul_r(gmx_simd_fnmadd_r(c6_S[st], sh_invrc6_S, vvdw6_S), sixth_S));
+                fscalV_S     = gmx_simd_sub_r(vvdw12_S, vvdw6_S);
+                vvdw_S       = gmx_simd_blendzero_r(vvdw_S, wco_vdw_S);
+                fscalV_S     = gmx_simd_blendzero_r(fscalV_S, wco_vdw_S);
+
+                /* Convert dV/drC * rC to dV/drC * rC^1-p */
+                fscalC_S     = gmx_simd_blendnotzero_r(gmx_simd_mul_r(fscalC_S, rpinvC_S), zero_B);
+                fscalV_S     = gmx_simd_blendnotzero_r(gmx_simd_mul_r(fscalV_S, rpinvV_S), zero_B);
+                vcoul_S      = gmx_simd_blendnotzero_r(vcoul_S, zero_B);
+                vvdw_S       = gmx_simd_blendnotzero_r(vvdw_S, zero_B);
+
+                /* Assemble the A and B states */
+                vctot_pair_S     = gmx_simd_fmadd_r(LFC_S[st], vcoul_S, vctot_pair_S);
+                vvtot_pair_S     = gmx_simd_fmadd_r(LFV_S[st], vvdw_S, vvtot_pair_S);
+                fscal_S          = gmx_simd_fmadd_r(gmx_simd_fmadd_r(LFC_S[st], fscalC_S,
+                                                                     gmx_simd_mul_r(LFV_S[st], fscalV_S)),
+                                                    rpm2_S, fscal_S);
+                dvdl_coul_pair_S = gmx_simd_fmadd_r(vcoul_S, DLF_S[st], dvdl_coul_pair_S);
+                dvdl_coul_pair_S = gmx_simd_fmadd_r(gmx_simd_mul_r(gmx_simd_mul_r(LFC_S[st], alpha_coul_eff_S),
+                                                                   gmx_simd_mul_r(dlfac_coul_S[st], fscalC_S)),
+                                                    sigma6_S[st], dvdl_coul_pair_S);
+                dvdl_vdw_pair_S  = gmx_simd_fmadd_r(vvdw_S, DLF_S[st], dvdl_vdw_pair_S);
+                dvdl_vdw_pair_S  = gmx_simd_fmadd_r(gmx_simd_mul_r(gmx_simd_mul_r(LFV_S[st], alpha_vdw_eff_S),
+                                                                   gmx_simd_mul_r(dlfac_vdw_S[st], fscalV_S)),
+                                                    sigma6_S[st], dvdl_vdw_pair_S);
+            }
+
+            /* Only included pairs get the soft-core interactions */
+            fscal_S          = gmx_simd_blendzero_r(fscal_S, incl_B);
+            vctot_pair_S     = gmx_simd_blendzero_r(vctot_pair_S, incl_B);
+            vvtot_pair_S     = gmx_simd_blendzero_r(vvtot_pair_S, incl_B);
+            dvdl_coul_pair_S = gmx_simd_blendzero_r(dvdl_coul_pair_S, incl_B);
+            dvdl_vdw_pair_S  = gmx_simd_blendzero_r(dvdl_vdw_pair_S, incl_B);
+
+            /* Sums over states of lambda*qq and dlambda*qq */
+            qqlfc_S = gmx_simd_fmadd_r(LFC_S[STATE_A], qq_S[STATE_A],
+                                       gmx_simd_mul_r(LFC_S[STATE_B], qq_S[STATE_B]));
+            qqdlf_S = gmx_simd_sub_r(qq_S[STATE_B], qq_S[STATE_A]);
+
+            if (bRF)
+            {
+                /* Excluded pairs within the cut-off get the reaction-field
+                 * correction without soft-core.
+                 */
+                VV_S             = gmx_simd_mul_r(self_S, gmx_simd_fmsub_r(krf_S, rsq_S, crf_S));
+                VV_S             = gmx_simd_blendnotzero_r(VV_S, incl_B);
+                FF_S             = gmx_simd_blendnotzero_r(gmx_simd_fneg_r(two_krf_S), incl_B);
+                vctot_pair_S     = gmx_simd_fmadd_r(qqlfc_S, VV_S, vctot_pair_S);
+                fscal_S          = gmx_simd_fmadd_r(qqlfc_S, FF_S, fscal_S);
+                dvdl_coul_pair_S = gmx_simd_fmadd_r(qqdlf_S, VV_S, dvdl_coul_pair_S);
+            }
+            else
+            {
+                /* Remove the Ewald long-range part from all pairs, which
+                 * doesn't depend on the soft-core radius.
+                 */
+                brsq_S           = gmx_simd_mul_r(beta2_S, rsq_S);
+                VV_S             = gmx_simd_mul_r(self_S, gmx_simd_mul_r(beta_S, gmx_simd_pmecorrV_r(brsq_S)));
+                FF_S             = gmx_simd_mul_r(minus_beta3_S, gmx_simd_pmecorrF_r(brsq_S));
+                wco_coul_S       = gmx_simd_cmplt_r(rsq_S, rcoulomb2_S);
+                VV_S             = gmx_simd_blendzero_r(VV_S, wco_coul_S);
+                FF_S             = gmx_simd_blendzero_r(FF_S, wco_coul_S);
+                vctot_pair_S     = gmx_simd_fnmadd_r(qqlfc_S, VV_S, vctot_pair_S);
+                fscal_S          = gmx_simd_fnmadd_r(qqlfc_S, FF_S, fscal_S);
+                dvdl_coul_pair_S = gmx_simd_fnmadd_r(qqdlf_S, VV_S, dvdl_coul_pair_S);
+            }
+
+            fscal_S     = gmx_simd_blendzero_r(fscal_S, wco_S);
+            vctot_S     = gmx_simd_add_r(vctot_S, gmx_simd_blendzero_r(vctot_pair_S, wco_S));
+            vvtot_S     = gmx_simd_add_r(vvtot_S, gmx_simd_blendzero_r(vvtot_pair_S, wco_S));
+            dvdl_coul_S = gmx_simd_add_r(dvdl_coul_S, gmx_simd_blendzero_r(dvdl_coul_pair_S, wco_S));
+            dvdl_vdw_S  = gmx_simd_add_r(dvdl_vdw_S, gmx_simd_blendzero_r(dvdl_vdw_pair_S, wco_S));
+
+            if (bDoForces)
+            {
+                tx_S  = gmx_simd_mul_r(fscal_S, dx_S);
+                ty_S  = gmx_simd_mul_r(fscal_S, dy_S);
+                tz_S  = gmx_simd_mul_r(fscal_S, dz_S);
+                fix_S = gmx_simd_add_r(fix_S, tx_S);
+                fiy_S = gmx_simd_add_r(fiy_S, ty_S);
+                fiz_S = gmx_simd_add_r(fiz_S, tz_S);
+
+                gmx_simd_store_r(fbuf + XX*GMX_SIMD_REAL_WIDTH, tx_S);
+                gmx_simd_store_r(fbuf + YY*GMX_SIMD_REAL_WIDTH, ty_S);
+                gmx_simd_store_r(fbuf + ZZ*GMX_SIMD_REAL_WIDTH, tz_S);
+                /* Other threads can update the same j-atoms */
+                for (s = 0; s < GMX_SIMD_REAL_WIDTH && jnr_s[s] >= 0; s++)
+                {
+                    jnr = jnr_s[s];
+#pragma omp atomic
+                    f[3*jnr]   -= fbuf[XX*GMX_SIMD_REAL_WIDTH + s];
+#pragma omp atomic
+                    f[3*jnr+1] -= fbuf[YY*GMX_SIMD_REAL_WIDTH + s];
+#pragma omp atomic
+                    f[3*jnr+2] -= fbuf[ZZ*GMX_SIMD_REAL_WIDTH + s];
+                }
+            }
+        }
+
+        if (!bAnyInRange)
+        {
+            continue;
+        }
+
+        dvdl_coul += gmx_simd_reduce_r(dvdl_coul_S);
+        dvdl_vdw  += gmx_simd_reduce_r(dvdl_vdw_S);
+
+        if (bDoForces || bDoShiftForces)
+        {
+            fix = gmx_simd_reduce_r(fix_S);
+            fiy = gmx_simd_reduce_r(fiy_S);
+            fiz = gmx_simd_reduce_r(fiz_S);
+        }
+        if (bDoForces)
+        {
+#pragma omp atomic
+            f[ii3]   += fix;
+#pragma omp atomic
+            f[ii3+1] += fiy;
+#pragma omp atomic
+            f[ii3+2] += fiz;
+        }
+        if (bDoShiftForces)
+        {
+            fshift_loc[is3]   += fix;
+            fshift_loc[is3+1] += fiy;
+            fshift_loc[is3+2] += fiz;
+        }
+        if (bDoPotential)
+        {
+            ggid = gid[n];
+            if (ggid != ggid_prev && ggid_prev >= 0)
+            {
+#pragma omp atomic
+                Vc[ggid_prev] += vctot_grp;
+#pragma omp atomic
+                Vv[ggid_prev] += vvtot_grp;
+                vctot_grp      = 0;
+                vvtot_grp      = 0;
+            }
+            ggid_prev  = ggid;
+            vctot_grp += gmx_simd_reduce_r(vctot_S);
+            vvtot_grp += gmx_simd_reduce_r(vvtot_S);
+        }
+    }
+
+    if (bDoPotential && ggid_prev >= 0)
+    {
+#pragma omp atomic
+        Vc[ggid_prev] += vctot_grp;
+#pragma omp atomic
+        Vv[ggid_prev] += vvtot_grp;
+    }
+    if (bDoShiftForces)
+    {
+        for (k = 0; k < SHIFTS*DIM; k++)
+        {
+            if (fshift_loc[k] != 0)
+            {
+#pragma omp atomic
+                fshift[k] += fshift_loc[k];
+            }
+        }
+    }
+
+#pragma omp atomic
+    dvdl[efptCOUL]     += dvdl_coul;
+#pragma omp atomic
+    dvdl[efptVDW]      += dvdl_vdw;
+
+    /* Same flop estimate as for the plain C kernel */
+#pragma omp atomic
+    inc_nrnb(nrnb, eNR_NBKERNEL_FREE_ENERGY, nlist->nri*12 + nlist->jindex[nlist->nri]*150);
+}
+#else
+{
+    gmx_incons("gmx_nb_free_energy_kernel_simd called without SIMD support");
+}
+#endif
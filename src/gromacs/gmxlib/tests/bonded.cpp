@@ -0,0 +1,600 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the bonded interactions.
+ *
+ * The forces calculated without energies and virial, which use SIMD
+ * kernels when available, are compared with the forces of the plain C
+ * kernels, which are used when energies and the virial are requested.
+ * The reference forces are checked against finite differences of the
+ * energy and the shift forces against the virial of whole molecules.
+ * The reduction of the thread-local output buffers is checked by
+ * comparing with a single-thread calculation.
+ *
+ * \ingroup module_gmxlib
+ */
+#include <cmath>
+#include <cstring>
+
+#include <algorithm>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/legacyheaders/bondf.h"
+#include "gromacs/legacyheaders/force.h"
+#include "gromacs/legacyheaders/nrnb.h"
+#include "gromacs/legacyheaders/typedefs.h"
+#include "gromacs/math/units.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/pbcutil/ishift.h"
+#include "gromacs/pbcutil/pbc.h"
+#include "gromacs/utility/smalloc.h"
+
+namespace
+{
+
+//! Number of interactions, chosen to not be a multiple of any SIMD width.
+const int  c_numInteractions = 19;
+//! Box size, the last interactions are put across the box boundary.
+const real c_boxSize         = 1.6;
+//! Number of grid points per dimension for the CMAP grid.
+const int  c_cmapGridSpacing = 24;
+
+/*! \brief
+ * Returns the CMAP test energy, and its derivatives, at angles
+ * phi and psi given in radians.
+ */
+real cmapEnergy(real phi, real psi, real *dphi, real *dpsi, real *dphidpsi)
+{
+    *dphi     = -8*std::sin(phi) + 3*std::sin(psi - phi);
+    *dpsi     = 5*std::cos(psi + 0.3) - 3*std::sin(psi - phi);
+    *dphidpsi = 3*std::cos(psi - phi);
+
+    return 8*std::cos(phi) + 5*std::sin(psi + 0.3) + 3*std::cos(psi - phi);
+}
+
+/*! \brief
+ * Test fixture for the bonded interactions.
+ *
+ * Sets up chains of five atoms in different conformations and
+ * a single interaction of the tested type for each chain, using
+ * the first atoms of the chain.
+ */
+class BondedTest : public ::testing::Test
+{
+    public:
+        BondedTest() : xWhole_(c_numInteractions*c_atomsPerChain*DIM)
+        {
+            for (int i = 0; i < c_numInteractions; i++)
+            {
+                rvec origin;
+
+                origin[XX] = 0.4*(i % 4) + 0.1;
+                origin[YY] = 0.4*((i/4) % 4) + 0.1;
+                origin[ZZ] = 0.3*(i/16) + 0.4;
+                if (i >= c_numInteractions - 4)
+                {
+                    /* Put the start of the chain close to the edge,
+                     * so the chain crosses the box boundary.
+                     */
+                    origin[i % DIM] = c_boxSize - 0.12;
+                }
+                for (int a = 0; a < c_atomsPerChain; a++)
+                {
+                    const int atom = i*c_atomsPerChain + a;
+
+                    xWhole_[atom*DIM + XX] = origin[XX] + 0.1*a + 0.02*std::sin(1.9*i + 0.5*a);
+                    xWhole_[atom*DIM + YY] = origin[YY] + 0.11*std::sin(0.9*i + 1.7*a);
+                    xWhole_[atom*DIM + ZZ] = origin[ZZ] + 0.12*std::cos(1.3*i + 2.1*a);
+                }
+            }
+            x_ = xWhole_;
+
+            clear_mat(box_);
+            box_[XX][XX] = c_boxSize;
+            box_[YY][YY] = c_boxSize;
+            box_[ZZ][ZZ] = c_boxSize;
+
+            std::memset(&idef_, 0, sizeof(idef_));
+            std::memset(&fr_, 0, sizeof(fr_));
+            fr_.nthreads      = 1;
+            fr_.efep          = efepNO;
+            fr_.natoms_force  = numAtoms();
+            snew(fr_.fshift, SHIFTS);
+        }
+
+        ~BondedTest()
+        {
+            for (int t = 1; t < fr_.nthreads; t++)
+            {
+                sfree(fr_.f_t[t].f);
+                sfree(fr_.f_t[t].fshift);
+                for (int i = 0; i < egNR; i++)
+                {
+                    sfree(fr_.f_t[t].grpp.ener[i]);
+                }
+                sfree(fr_.f_t[t].red_mask);
+                sfree(fr_.f_t[t].red_block);
+            }
+            sfree(fr_.f_t);
+            sfree(fr_.red_block);
+            sfree(fr_.fshift);
+            sfree(idef_.il_thread_division);
+            if (idef_.cmap_grid.cmapdata != NULL)
+            {
+                sfree(idef_.cmap_grid.cmapdata[0].cmap);
+                sfree(idef_.cmap_grid.cmapdata);
+            }
+        }
+
+        //! Returns the number of atoms.
+        int numAtoms() const { return c_numInteractions*c_atomsPerChain; }
+
+        /*! \brief
+         * Sets up the thread-local output buffers for \p nthreads threads,
+         * as init_forcerec does, and divides the interactions over the threads.
+         */
+        void setNumThreads(int nthreads)
+        {
+            fr_.nthreads = nthreads;
+            snew(fr_.f_t, nthreads);
+            for (int t = 1; t < nthreads; t++)
+            {
+                snew(fr_.f_t[t].fshift, SHIFTS);
+                fr_.f_t[t].grpp.nener = 1;
+                for (int i = 0; i < egNR; i++)
+                {
+                    snew(fr_.f_t[t].grpp.ener[i], fr_.f_t[t].grpp.nener);
+                }
+            }
+            setup_bonded_threading(&fr_, &idef_);
+        }
+
+        //! Puts the atoms in the box, which breaks some chains.
+        void putAtomsInBox()
+        {
+            for (size_t i = 0; i < x_.size(); i++)
+            {
+                if (x_[i] < 0)
+                {
+                    x_[i] += c_boxSize;
+                }
+                else if (x_[i] >= c_boxSize)
+                {
+                    x_[i] -= c_boxSize;
+                }
+            }
+        }
+
+        //! Sets up the CMAP grid from cmapEnergy().
+        void setupCmapGrid()
+        {
+            const real dx = 2*M_PI/c_cmapGridSpacing;
+
+            idef_.cmap_grid.ngrid        = 1;
+            idef_.cmap_grid.grid_spacing = c_cmapGridSpacing;
+            snew(idef_.cmap_grid.cmapdata, 1);
+            snew(idef_.cmap_grid.cmapdata[0].cmap, 4*c_cmapGridSpacing*c_cmapGridSpacing);
+            for (int i = 0; i < c_cmapGridSpacing; i++)
+            {
+                for (int j = 0; j < c_cmapGridSpacing; j++)
+                {
+                    real *v = idef_.cmap_grid.cmapdata[0].cmap + 4*(i*c_cmapGridSpacing + j);
+                    real  dphi, dpsi, dphidpsi;
+
+                    /* The grid stores the derivatives with respect
+                     * to the angles in degrees.
+                     */
+                    v[0] = cmapEnergy(-M_PI + i*dx, -M_PI + j*dx, &dphi, &dpsi, &dphidpsi);
+                    v[1] = dphi*DEG2RAD;
+                    v[2] = dpsi*DEG2RAD;
+                    v[3] = dphidpsi*DEG2RAD*DEG2RAD;
+                }
+            }
+        }
+
+        //! Sets up one interaction of type \p ftype for each chain.
+        void setupInteractions(int ftype)
+        {
+            const int nral = interaction_function[ftype].nratoms;
+
+            for (int i = 0; i < c_numInteractions; i++)
+            {
+                t_iparams ip;
+
+                std::memset(&ip, 0, sizeof(ip));
+                switch (ftype)
+                {
+                    case F_ANGLES:
+                    case F_IDIHS:
+                    case F_RESTRANGLES:
+                        ip.harmonic.krA = 100 + 10*i;
+                        ip.harmonic.rA  = (ftype == F_IDIHS ? 15*i - 120 : 100 + i);
+                        break;
+                    case F_UREY_BRADLEY:
+                        ip.u_b.kthetaA = 100 + 10*i;
+                        ip.u_b.thetaA  = 100 + i;
+                        ip.u_b.kUBA    = 5000 + 100*i;
+                        ip.u_b.r13A    = 0.15 + 0.002*i;
+                        break;
+                    case F_PDIHS:
+                        ip.pdihs.cpA  = 5 + i;
+                        ip.pdihs.phiA = 20*i;
+                        ip.pdihs.mult = 1 + i % 3;
+                        break;
+                    case F_RBDIHS:
+                    {
+                        const real c[NR_RBDIHS] = { 9.28, 12.16, -13.12, -3.06, 26.24, -31.5 };
+
+                        for (int j = 0; j < NR_RBDIHS; j++)
+                        {
+                            ip.rbdihs.rbcA[j] = c[j]*(1 + 0.05*i);
+                        }
+                        break;
+                    }
+                    case F_CMAP:
+                        ip.cmap.cmapA = 0;
+                        break;
+                    default:
+                        FAIL() << "Interaction type not supported by the test";
+                }
+                /* Use B parameters equal to A, this is not a perturbed system */
+                switch (ftype)
+                {
+                    case F_ANGLES:
+                    case F_IDIHS:
+                    case F_RESTRANGLES:
+                        ip.harmonic.krB = ip.harmonic.krA;
+                        ip.harmonic.rB  = ip.harmonic.rA;
+                        break;
+                    case F_UREY_BRADLEY:
+                        ip.u_b.kthetaB = ip.u_b.kthetaA;
+                        ip.u_b.thetaB  = ip.u_b.thetaA;
+                        ip.u_b.kUBB    = ip.u_b.kUBA;
+                        ip.u_b.r13B    = ip.u_b.r13A;
+                        break;
+                    case F_PDIHS:
+                        ip.pdihs.cpB  = ip.pdihs.cpA;
+                        ip.pdihs.phiB = ip.pdihs.phiA;
+                        break;
+                    case F_RBDIHS:
+                        for (int j = 0; j < NR_RBDIHS; j++)
+                        {
+                            ip.rbdihs.rbcB[j] = ip.rbdihs.rbcA[j];
+                        }
+                        break;
+                    case F_CMAP:
+                        ip.cmap.cmapB = ip.cmap.cmapA;
+                        break;
+                }
+                iatoms_.push_back(iparams_.size());
+                for (int a = 0; a < nral; a++)
+                {
+                    iatoms_.push_back(i*c_atomsPerChain + a);
+                }
+                iparams_.push_back(ip);
+            }
+            if (ftype == F_CMAP)
+            {
+                setupCmapGrid();
+            }
+
+            idef_.ntypes         = iparams_.size();
+            idef_.iparams        = &iparams_[0];
+            idef_.il[ftype].nr     = iatoms_.size();
+            idef_.il[ftype].iatoms = &iatoms_[0];
+            setup_bonded_threading(&fr_, &idef_);
+        }
+
+        /*! \brief
+         * Calculates the bonded forces with \p forceFlags,
+         * returns the energy, the forces and the shift forces.
+         */
+        real calcBonds(int forceFlags, const t_pbc *pbc,
+                       std::vector<real> *x, std::vector<real> *f,
+                       rvec fshift[])
+        {
+            gmx_enerdata_t enerd;
+            real           grppEner[egNR];
+            t_nrnb         nrnb;
+            real           lambda[efptNR];
+
+            f->assign(numAtoms()*DIM, 0);
+            clear_rvecs(SHIFTS, fr_.fshift);
+            std::memset(&enerd, 0, sizeof(enerd));
+            /* A single energy group, as in setNumThreads */
+            enerd.grpp.nener = 1;
+            for (int i = 0; i < egNR; i++)
+            {
+                grppEner[i]        = 0;
+                enerd.grpp.ener[i] = &grppEner[i];
+            }
+            std::memset(lambda, 0, sizeof(lambda));
+            init_nrnb(&nrnb);
+            calc_bonds(NULL, NULL, &idef_, asRvec(x), NULL, asRvec(f), &fr_,
+                       pbc, NULL, &enerd, &nrnb, lambda, NULL, NULL, NULL,
+                       NULL, NULL, forceFlags, FALSE, 0);
+            if (fshift != NULL)
+            {
+                for (int s = 0; s < SHIFTS; s++)
+                {
+                    copy_rvec(fr_.fshift[s], fshift[s]);
+                }
+            }
+
+            real epot = 0;
+            for (int ftype = 0; ftype < F_NRE; ftype++)
+            {
+                epot += enerd.term[ftype];
+            }
+
+            return epot;
+        }
+
+        //! Returns the coordinate vector \p x as an rvec array.
+        static rvec *asRvec(std::vector<real> *x)
+        {
+            return reinterpret_cast<rvec *>(&(*x)[0]);
+        }
+
+        //! Tests interactions of type \p ftype, with PBC when \p bPbc is set.
+        void testInteractions(int ftype, bool bPbc)
+        {
+            t_pbc pbc, *pbcPtr = NULL;
+
+            if (bPbc)
+            {
+                putAtomsInBox();
+                set_pbc(&pbc, epbcXYZ, box_);
+                fr_.bMolPBC = TRUE;
+                pbcPtr      = &pbc;
+            }
+            setupInteractions(ftype);
+
+            const int         flagsEnerVir = GMX_FORCE_FORCES | GMX_FORCE_VIRIAL | GMX_FORCE_ENERGY;
+            std::vector<real> fRef, fTest;
+            rvec              fshift[SHIFTS];
+
+            calcBonds(flagsEnerVir, pbcPtr, &x_, &fRef, fshift);
+            calcBonds(GMX_FORCE_FORCES, pbcPtr, &x_, &fTest, NULL);
+
+            real fScale = 0;
+            for (size_t i = 0; i < fRef.size(); i++)
+            {
+                fScale = std::max(fScale, std::abs(fRef[i]));
+            }
+            ASSERT_GT(fScale, 1);
+
+            /* The forces without energies should match the reference
+             * and not generate a net force.
+             */
+            rvec fSum;
+            clear_rvec(fSum);
+            for (int i = 0; i < numAtoms(); i++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    EXPECT_NEAR(fRef[i*DIM + d], fTest[i*DIM + d], 1e-4*fScale)
+                    << "atom " << i << " dim " << d;
+                    fSum[d] += fTest[i*DIM + d];
+                }
+            }
+            for (int d = 0; d < DIM; d++)
+            {
+                EXPECT_NEAR(0, fSum[d], 1e-4*fScale);
+            }
+
+            /* The reference forces should be minus the derivative of
+             * the energy, which we obtain with a fourth order central
+             * difference. Each atom is only part of a single interaction,
+             * so we can use the total energy.
+             */
+            const real h = 1e-3;
+            for (int i = 0; i < numAtoms(); i++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    std::vector<real> xDisp(x_), fDum;
+                    real              e[4];
+
+                    for (int n = 0; n < 4; n++)
+                    {
+                        const real disp[4] = { -2*h, -h, h, 2*h };
+
+                        xDisp[i*DIM + d] = x_[i*DIM + d] + disp[n];
+                        e[n]             = calcBonds(flagsEnerVir, pbcPtr, &xDisp, &fDum, NULL);
+                    }
+                    EXPECT_NEAR(-(e[0] - 8*e[1] + 8*e[2] - e[3])/(12*h), fRef[i*DIM + d], 2e-3*fScale)
+                    << "atom " << i << " dim " << d;
+                }
+            }
+
+            /* The virial from the shift forces should match the virial
+             * of the whole chains with the forces without energies.
+             */
+            rvec shiftVec[SHIFTS];
+            calc_shifts(box_, shiftVec);
+            for (int d = 0; d < DIM; d++)
+            {
+                for (int d2 = 0; d2 < DIM; d2++)
+                {
+                    real virRef = 0, virTest = 0, virScale = 0;
+
+                    for (int i = 0; i < numAtoms(); i++)
+                    {
+                        virRef   += x_[i*DIM + d]*fRef[i*DIM + d2];
+                        virTest  += xWhole_[i*DIM + d]*fTest[i*DIM + d2];
+                        virScale += std::abs(xWhole_[i*DIM + d]*fTest[i*DIM + d2]);
+                    }
+                    for (int s = 0; s < SHIFTS; s++)
+                    {
+                        virRef += shiftVec[s][d]*fshift[s][d2];
+                    }
+                    EXPECT_NEAR(virRef, virTest, 1e-4*virScale)
+                    << "virial element " << d << " " << d2;
+                }
+            }
+        }
+
+        //! Number of atoms in each chain.
+        static const int       c_atomsPerChain = 5;
+
+        //! Coordinates, possibly put in the box.
+        std::vector<real>      x_;
+        //! Coordinates with whole chains.
+        std::vector<real>      xWhole_;
+        //! The interaction list.
+        std::vector<t_iatom>   iatoms_;
+        //! Interaction parameters, one type per interaction.
+        std::vector<t_iparams> iparams_;
+        //! The box.
+        matrix                 box_;
+        //! Local topology.
+        t_idef                 idef_;
+        //! Force record, only the fields used by calc_bonds are set.
+        t_forcerec             fr_;
+};
+
+TEST_F(BondedTest, ReducesThreadForces)
+{
+    const int         flagsEnerVir = GMX_FORCE_FORCES | GMX_FORCE_VIRIAL | GMX_FORCE_ENERGY;
+    std::vector<real> fRef, fTest;
+    rvec              fshiftRef[SHIFTS], fshiftTest[SHIFTS];
+
+    setupInteractions(F_PDIHS);
+    const real        eRef = calcBonds(flagsEnerVir, NULL, &x_, &fRef, fshiftRef);
+
+    real fScale = 0;
+    for (size_t i = 0; i < fRef.size(); i++)
+    {
+        fScale = std::max(fScale, std::abs(fRef[i]));
+    }
+
+    /* Run twice to check that the thread buffers are cleared */
+    setNumThreads(4);
+    for (int iter = 0; iter < 2; iter++)
+    {
+        const real eTest = calcBonds(flagsEnerVir, NULL, &x_, &fTest, fshiftTest);
+
+        EXPECT_NEAR(eRef, eTest, 1e-5*std::abs(eRef));
+        for (size_t i = 0; i < fRef.size(); i++)
+        {
+            EXPECT_NEAR(fRef[i], fTest[i], 1e-5*fScale) << "force element " << i;
+        }
+        for (int s = 0; s < SHIFTS; s++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                EXPECT_NEAR(fshiftRef[s][d], fshiftTest[s][d], 1e-5*fScale)
+                << "shift force " << s << " dim " << d;
+            }
+        }
+    }
+}
+
+TEST_F(BondedTest, AnglesWithoutPbc)
+{
+    testInteractions(F_ANGLES, false);
+}
+
+TEST_F(BondedTest, AnglesWithPbc)
+{
+    testInteractions(F_ANGLES, true);
+}
+
+TEST_F(BondedTest, UreyBradleyWithoutPbc)
+{
+    testInteractions(F_UREY_BRADLEY, false);
+}
+
+TEST_F(BondedTest, UreyBradleyWithPbc)
+{
+    testInteractions(F_UREY_BRADLEY, true);
+}
+
+TEST_F(BondedTest, RestrictedBendingWithoutPbc)
+{
+    testInteractions(F_RESTRANGLES, false);
+}
+
+TEST_F(BondedTest, RestrictedBendingWithPbc)
+{
+    testInteractions(F_RESTRANGLES, true);
+}
+
+TEST_F(BondedTest, ProperDihedralsWithoutPbc)
+{
+    testInteractions(F_PDIHS, false);
+}
+
+TEST_F(BondedTest, ProperDihedralsWithPbc)
+{
+    testInteractions(F_PDIHS, true);
+}
+
+TEST_F(BondedTest, ImproperDihedralsWithoutPbc)
+{
+    testInteractions(F_IDIHS, false);
+}
+
+TEST_F(BondedTest, ImproperDihedralsWithPbc)
+{
+    testInteractions(F_IDIHS, true);
+}
+
+TEST_F(BondedTest, RyckaertBellemansWithoutPbc)
+{
+    testInteractions(F_RBDIHS, false);
+}
+
+TEST_F(BondedTest, RyckaertBellemansWithPbc)
+{
+    testInteractions(F_RBDIHS, true);
+}
+
+TEST_F(BondedTest, CmapWithoutPbc)
+{
+    testInteractions(F_CMAP, false);
+}
+
+TEST_F(BondedTest, CmapWithPbc)
+{
+    testInteractions(F_CMAP, true);
+}
+
+} // namespace
@@ -0,0 +1,274 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Thread-scaling benchmark for the bonded interactions.
+ *
+ * The speed-up is reported relative to the single-thread time, so it
+ * needs as many idle cores as the largest thread count; the forces are
+ * checked in bonded.cpp in gmxlib-test. Run e.g.
+ *
+ *     gmxlib-bonded-benchmark -natoms 20000 -nsteps 1000 -nthreads 32
+ *
+ * to time the bonded forces, including the reduction of the
+ * thread-local force buffers, for 1, 2, 4, ... up to nthreads threads.
+ *
+ * \ingroup module_gmxlib
+ */
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/legacyheaders/bondf.h"
+#include "gromacs/legacyheaders/force.h"
+#include "gromacs/legacyheaders/nrnb.h"
+#include "gromacs/legacyheaders/typedefs.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/options/basicoptions.h"
+#include "gromacs/options/options.h"
+#include "gromacs/pbcutil/ishift.h"
+#include "gromacs/timing/walltime_accounting.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "testutils/testoptions.h"
+
+namespace
+{
+
+//! Number of atoms.
+int g_natoms   = 20000;
+//! Number of force calculations per thread count.
+int g_nsteps   = 200;
+//! Maximum number of OpenMP threads.
+int g_nthreads = 1;
+
+//! \cond
+GMX_TEST_OPTIONS(BondedBenchmarkOptions, options)
+{
+    options->addOption(::gmx::IntegerOption("natoms")
+                           .store(&g_natoms)
+                           .description("Number of atoms"));
+    options->addOption(::gmx::IntegerOption("nsteps")
+                           .store(&g_nsteps)
+                           .description("Number of force calculations per thread count"));
+    options->addOption(::gmx::IntegerOption("nthreads")
+                           .store(&g_nthreads)
+                           .description("Maximum number of OpenMP threads"));
+}
+//! \endcond
+
+//! Number of atoms per chain.
+const int c_chainLength = 100;
+
+/*! \brief
+ * Benchmark fixture with chains of atoms with bonds, angles
+ * and proper dihedrals along each chain.
+ */
+class BondedBenchmark : public ::testing::Test
+{
+    public:
+        BondedBenchmark() : x_(g_natoms*DIM), f_(g_natoms*DIM)
+        {
+            for (int i = 0; i < g_natoms; i++)
+            {
+                const int chain = i/c_chainLength;
+                const int a     = i % c_chainLength;
+
+                x_[i*DIM + XX] = 0.125*a;
+                x_[i*DIM + YY] = 0.5*(chain % 20) + 0.09*(a % 2);
+                x_[i*DIM + ZZ] = 0.5*(chain/20) + 0.05*std::sin(0.7*a);
+            }
+
+            std::memset(&iparams_, 0, sizeof(iparams_));
+            iparams_[0].harmonic.krA = 3e5;
+            iparams_[0].harmonic.rA  = 0.15;
+            iparams_[1].harmonic.krA = 400;
+            iparams_[1].harmonic.rA  = 110;
+            iparams_[2].pdihs.cpA    = 5;
+            iparams_[2].pdihs.phiA   = 0;
+            iparams_[2].pdihs.mult   = 3;
+
+            std::memset(&idef_, 0, sizeof(idef_));
+            idef_.ntypes  = 3;
+            idef_.iparams = iparams_;
+            addInteractions(F_BONDS, 0);
+            addInteractions(F_ANGLES, 1);
+            addInteractions(F_PDIHS, 2);
+
+            std::memset(&fr_, 0, sizeof(fr_));
+            fr_.efep         = efepNO;
+            fr_.natoms_force = g_natoms;
+            snew(fr_.fshift, SHIFTS);
+        }
+
+        ~BondedBenchmark()
+        {
+            freeThreads();
+            sfree(fr_.fshift);
+            sfree(idef_.il_thread_division);
+        }
+
+        //! Adds interactions of type \p ftype along all chains.
+        void addInteractions(int ftype, int type)
+        {
+            const int         nral = interaction_function[ftype].nratoms;
+            std::vector<int> &il   = iatoms_[ftype];
+
+            for (int i = 0; i + nral <= g_natoms; i++)
+            {
+                if (i % c_chainLength + nral <= c_chainLength)
+                {
+                    il.push_back(type);
+                    for (int a = 0; a < nral; a++)
+                    {
+                        il.push_back(i + a);
+                    }
+                }
+            }
+            idef_.il[ftype].nr     = il.size();
+            idef_.il[ftype].iatoms = &il[0];
+        }
+
+        //! Sets up the thread-local output buffers, as init_forcerec does.
+        void setNumThreads(int nthreads)
+        {
+            freeThreads();
+            fr_.nthreads = nthreads;
+            snew(fr_.f_t, nthreads);
+            for (int t = 1; t < nthreads; t++)
+            {
+                snew(fr_.f_t[t].fshift, SHIFTS);
+                fr_.f_t[t].grpp.nener = 1;
+                for (int i = 0; i < egNR; i++)
+                {
+                    snew(fr_.f_t[t].grpp.ener[i], fr_.f_t[t].grpp.nener);
+                }
+            }
+            setup_bonded_threading(&fr_, &idef_);
+        }
+
+        //! Frees the thread-local output buffers.
+        void freeThreads()
+        {
+            for (int t = 1; t < fr_.nthreads; t++)
+            {
+                sfree(fr_.f_t[t].f);
+                sfree(fr_.f_t[t].fshift);
+                for (int i = 0; i < egNR; i++)
+                {
+                    sfree(fr_.f_t[t].grpp.ener[i]);
+                }
+                sfree(fr_.f_t[t].red_mask);
+                sfree(fr_.f_t[t].red_block);
+            }
+            sfree(fr_.f_t);
+            fr_.f_t = NULL;
+            sfree(fr_.red_block);
+            fr_.red_block        = NULL;
+            fr_.red_block_nalloc = 0;
+        }
+
+        //! Returns the time per step in microseconds for \p nthreads threads.
+        double timeBonds(int nthreads)
+        {
+            gmx_enerdata_t enerd;
+            t_nrnb         nrnb;
+            real           lambda[efptNR];
+            double         t0;
+
+            setNumThreads(nthreads);
+            std::memset(&enerd, 0, sizeof(enerd));
+            std::memset(lambda, 0, sizeof(lambda));
+            init_nrnb(&nrnb);
+
+            t0 = 0;
+            for (int step = -1; step < g_nsteps; step++)
+            {
+                if (step == 0)
+                {
+                    /* The first step allocates the thread force buffers */
+                    t0 = gmx_gettime();
+                }
+                for (size_t i = 0; i < f_.size(); i++)
+                {
+                    f_[i] = 0;
+                }
+                calc_bonds(NULL, NULL, &idef_, reinterpret_cast<rvec *>(&x_[0]),
+                           NULL, reinterpret_cast<rvec *>(&f_[0]), &fr_,
+                           NULL, NULL, &enerd, &nrnb, lambda, NULL, NULL, NULL,
+                           NULL, NULL, GMX_FORCE_FORCES, FALSE, step);
+            }
+
+            return (gmx_gettime() - t0)*1e6/g_nsteps;
+        }
+
+        //! Coordinates.
+        std::vector<real>    x_;
+        //! Forces.
+        std::vector<real>    f_;
+        //! Interaction lists for each interaction type.
+        std::vector<int>     iatoms_[F_NRE];
+        //! Interaction parameters.
+        t_iparams            iparams_[3];
+        //! Local topology.
+        t_idef               idef_;
+        //! Force record, only the fields used by calc_bonds are set.
+        t_forcerec           fr_;
+};
+
+TEST_F(BondedBenchmark, ThreadScaling)
+{
+    double tSingle = 0;
+
+    for (int nthreads = 1; nthreads <= g_nthreads; nthreads *= 2)
+    {
+        double t = timeBonds(nthreads);
+
+        if (nthreads == 1)
+        {
+            tSingle = t;
+        }
+        std::printf("bondeds, %d atoms, %2d threads: %9.2f us/step, speed-up %5.2f,"
+                    " reducing %d of %d blocks\n",
+                    g_natoms, nthreads, t, tSingle/t,
+                    fr_.red_nblock_used, fr_.red_nblock);
+    }
+}
+
+} // namespace
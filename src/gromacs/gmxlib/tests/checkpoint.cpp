@@ -0,0 +1,443 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for writing and reading checkpoint files.
+ *
+ * The distributed checkpoint tests write the per-atom state in parts,
+ * as the ranks of a parallel run do, and check that reading collects
+ * the parts into the global state, also when continuing with a
+ * different number of parts.
+ *
+ * The asynchronous checkpoint test checks that the checkpoint writer
+ * thread writes the same files as synchronous writing, while the state
+ * and the output files change after write_checkpoint() returns.
+ *
+ * \ingroup module_gmxlib
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/legacyheaders/checkpoint.h"
+#include "gromacs/legacyheaders/network.h"
+#include "gromacs/legacyheaders/typedefs.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/utility/futil.h"
+#include "gromacs/utility/smalloc.h"
+#include "gromacs/utility/stringutil.h"
+
+#include "testutils/testfilemanager.h"
+
+namespace
+{
+
+//! Number of atoms, chosen to not be a multiple of the numbers of parts.
+const int c_natoms = 11;
+
+/*! \brief
+ * Test fixture for distributed checkpoints.
+ */
+class DistributedCheckpointTest : public ::testing::Test
+{
+    public:
+        DistributedCheckpointTest() : cr_(init_commrec())
+        {
+            int i, d;
+
+            fn_ = fileManager_.getTemporaryFilePath(".cpt");
+            fileManager_.getTemporaryFilePath("prev.cpt");
+
+            /* init_state() does not set all entries, mdrun zeroes them */
+            std::memset(&state_, 0, sizeof(state_));
+            init_state(&state_, c_natoms, 0, 0, 0, 0);
+            state_.flags = (1<<estX) | (1<<estV) | (1<<estBOX);
+            for (d = 0; d < DIM; d++)
+            {
+                state_.box[d][d] = 2.5;
+            }
+            for (i = 0; i < c_natoms; i++)
+            {
+                for (d = 0; d < DIM; d++)
+                {
+                    state_.x[i][d] = 0.1*i + 0.01*d;
+                    state_.v[i][d] = -0.2*i + 0.03*d;
+                }
+            }
+        }
+
+        ~DistributedCheckpointTest()
+        {
+            done_state(&state_);
+            sfree(cr_);
+        }
+
+        /*! \brief
+         * Returns the path of the part file of checkpoint fn_, which
+         * the file manager removes at the end of the test.
+         */
+        std::string partPath(gmx_int64_t step, int part)
+        {
+            char suffix[STRLEN], sbuf[STEPSTRSIZE];
+
+            sprintf(suffix, "step%s_part%d.cpt", gmx_step_str(step, sbuf), part);
+
+            return fileManager_.getTemporaryFilePath(suffix);
+        }
+
+        /*! \brief
+         * Writes checkpoint fn at step in nparts parts, as nparts
+         * ranks that each have every nparts'th atom as home atoms.
+         */
+        void writeCheckpoint(const char *fn, gmx_int64_t step, int nparts)
+        {
+            int              p, i;
+            std::vector<int> index;
+            t_state          state_local;
+
+            for (p = 0; p < nparts; p++)
+            {
+                partPath(step, p);
+                index.clear();
+                for (i = p; i < c_natoms; i += nparts)
+                {
+                    index.push_back(i);
+                }
+                std::memset(&state_local, 0, sizeof(state_local));
+                init_state(&state_local, index.size(), 0, 0, 0, 0);
+                state_local.flags = state_.flags;
+                for (i = 0; i < static_cast<int>(index.size()); i++)
+                {
+                    copy_rvec(state_.x[index[i]], state_local.x[i]);
+                    copy_rvec(state_.v[index[i]], state_local.v[i]);
+                }
+                write_checkpoint_part(fn, step, p, nparts, c_natoms,
+                                      index.size(), &index[0], &state_local);
+                done_state(&state_local);
+            }
+            write_checkpoint(fn, FALSE, NULL, cr_, eiMD, 1, FALSE, 0,
+                             step, step*0.002, &state_, nparts, NULL);
+        }
+
+        //! Reads checkpoint fn_ and checks that it matches the state at step.
+        void checkCheckpoint(gmx_int64_t step)
+        {
+            int          simulation_part, i, d;
+            gmx_int64_t  step_read;
+            double       t;
+            t_state      state;
+
+            std::memset(&state, 0, sizeof(state));
+            init_state(&state, 0, 0, 0, 0, 0);
+            read_checkpoint_state(fn_.c_str(), &simulation_part, &step_read, &t, &state);
+            EXPECT_EQ(step, step_read);
+            ASSERT_EQ(c_natoms, state.natoms);
+            ASSERT_TRUE(state.x != NULL);
+            ASSERT_TRUE(state.v != NULL);
+            for (i = 0; i < c_natoms; i++)
+            {
+                for (d = 0; d < DIM; d++)
+                {
+                    EXPECT_EQ(state_.x[i][d], state.x[i][d]) << "atom " << i;
+                    EXPECT_EQ(state_.v[i][d], state.v[i][d]) << "atom " << i;
+                }
+            }
+            done_state(&state);
+        }
+
+        gmx::test::TestFileManager fileManager_;
+        std::string                fn_;
+        t_commrec                 *cr_;
+        t_state                    state_;
+};
+
+TEST_F(DistributedCheckpointTest, ContinuesWithDifferentNumberOfParts)
+{
+    writeCheckpoint(fn_.c_str(), 0, 3);
+    checkCheckpoint(0);
+
+    /* Continue with two ranks */
+    writeCheckpoint(fn_.c_str(), 10, 2);
+    checkCheckpoint(10);
+    EXPECT_TRUE(gmx_fexist(partPath(0, 2).c_str()));
+
+    /* The parts of the checkpoint replaced by the previous one are removed */
+    writeCheckpoint(fn_.c_str(), 20, 4);
+    checkCheckpoint(20);
+    EXPECT_FALSE(gmx_fexist(partPath(0, 0).c_str()));
+    EXPECT_FALSE(gmx_fexist(partPath(0, 2).c_str()));
+    EXPECT_TRUE(gmx_fexist(partPath(10, 1).c_str()));
+}
+
+TEST_F(DistributedCheckpointTest, FindsPartsNextToCheckpointFile)
+{
+    char                   cwd[GMX_PATH_MAX];
+    std::string::size_type pos;
+
+    /* Write the checkpoint from its own directory, as mdrun does
+     * when started there, and read it from the original directory.
+     */
+    pos = fn_.find_last_of("/");
+    ASSERT_NE(std::string::npos, pos);
+    gmx_getcwd(cwd, sizeof(cwd));
+    gmx_chdir(fn_.substr(0, pos).c_str());
+    writeCheckpoint(fn_.substr(pos + 1).c_str(), 0, 3);
+    gmx_chdir(cwd);
+
+    checkCheckpoint(0);
+}
+
+//! Returns the contents of file \p fn.
+std::string fileContents(const std::string &fn)
+{
+    std::ifstream in(fn.c_str(), std::ios::in | std::ios::binary);
+
+    return std::string(std::istreambuf_iterator<char>(in),
+                       std::istreambuf_iterator<char>());
+}
+
+//! Sets or, with \p value NULL, unsets GMX_ASYNC_CHECKPOINT.
+void setAsyncCheckpointEnv(const char *value)
+{
+    // TODO fix this when we have an encapsulation layer for handling
+    // environment variables
+#ifdef GMX_NATIVE_WINDOWS
+    _putenv_s("GMX_ASYNC_CHECKPOINT", value != NULL ? value : "");
+#else
+    if (value != NULL)
+    {
+        setenv("GMX_ASYNC_CHECKPOINT", value, true);
+    }
+    else
+    {
+        unsetenv("GMX_ASYNC_CHECKPOINT");
+    }
+#endif
+}
+
+/*! \brief
+ * Test fixture for asynchronous checkpoint writing.
+ */
+class AsyncCheckpointTest : public ::testing::Test
+{
+    public:
+        //! Number of energy terms in the energy history.
+        static const int c_nener        = 3;
+        //! Number of output files.
+        static const int c_noutputFiles = 4;
+        //! Number of initial lines per output file, about 1.5 MB.
+        static const int c_noutputLines = 50000;
+
+        AsyncCheckpointTest() : cr_(init_commrec())
+        {
+            fn_         = fileManager_.getTemporaryFilePath(".cpt");
+            fnPrev_     = fileManager_.getTemporaryFilePath("prev.cpt");
+            fnSync_     = fileManager_.getTemporaryFilePath("sync.cpt");
+            fnSyncPrev_ = fileManager_.getTemporaryFilePath("sync_prev.cpt");
+            for (int f = 0; f < c_noutputFiles; f++)
+            {
+                fnOut_[f] = fileManager_.getTemporaryFilePath(gmx::formatString("out%d.log", f));
+            }
+            fileManager_.getTemporaryFilePath("step1.cpt");
+            fileManager_.getTemporaryFilePath("step2.cpt");
+        }
+
+        ~AsyncCheckpointTest()
+        {
+            sfree(cr_);
+            setAsyncCheckpointEnv(NULL);
+        }
+
+        //! Sets the state that changes during the run to that of \p step.
+        void setState(t_state *state, int step)
+        {
+            int i, d;
+
+            for (d = 0; d < DIM; d++)
+            {
+                state->box[d][d] = 2.5 + 0.1*step;
+            }
+            for (i = 0; i < c_natoms; i++)
+            {
+                for (d = 0; d < DIM; d++)
+                {
+                    state->x[i][d] = 0.1*i + 0.01*d + 0.001*step;
+                    state->v[i][d] = -0.2*i + 0.03*d - 0.002*step;
+                }
+            }
+            state->lambda[efptFEP] = 0.1*step;
+            for (i = 0; i < state->nhchainlength*state->ngtc; i++)
+            {
+                state->nosehoover_xi[i]  = 0.5*i + step;
+                state->nosehoover_vxi[i] = -0.5*i + step;
+            }
+            for (i = 0; i < state->ngtc; i++)
+            {
+                state->therm_integral[i] = 3.0*i - step;
+            }
+            state->enerhist.nsum     = step;
+            state->enerhist.nsum_sim = step;
+            for (i = 0; i < c_nener; i++)
+            {
+                state->enerhist.ener_ave[i]     = 1.5*i + step;
+                state->enerhist.ener_sum[i]     = -1.5*i + step;
+                state->enerhist.ener_sum_sim[i] = 2.5*i + step;
+            }
+        }
+
+        /*! \brief
+         * Writes checkpoints at steps 1 and 2 of a run that appends
+         * to output files, using writer thread \p cw when not NULL.
+         *
+         * The state and the output files change directly after
+         * write_checkpoint() returns, as in mdrun. The output files
+         * are larger than the checksummed part, so the writer thread
+         * is still busy with the checksums when they change.
+         */
+        void runSteps(gmx_checkpoint_writer_t cw)
+        {
+            t_state state;
+            FILE   *out[c_noutputFiles];
+            int     step, f, i;
+
+            std::memset(&state, 0, sizeof(state));
+            init_state(&state, c_natoms, 2, 0, 2, 0);
+            state.flags = ((1<<estLAMBDA) | (1<<estBOX) | (1<<estNH_XI) |
+                           (1<<estNH_VXI) | (1<<estTC_INT) |
+                           (1<<estX) | (1<<estV));
+            state.enerhist.nener = c_nener;
+            snew(state.enerhist.ener_ave, c_nener);
+            snew(state.enerhist.ener_sum, c_nener);
+            snew(state.enerhist.ener_sum_sim, c_nener);
+
+            for (f = 0; f < c_noutputFiles; f++)
+            {
+                std::remove(fnOut_[f].c_str());
+                out[f] = gmx_fio_fopen(fnOut_[f].c_str(), "w");
+                for (i = 0; i < c_noutputLines; i++)
+                {
+                    fprintf(out[f], "output line %d of file %d\n", i, f);
+                }
+            }
+            for (step = 1; step <= 2; step++)
+            {
+                setState(&state, step);
+                for (f = 0; f < c_noutputFiles; f++)
+                {
+                    fprintf(out[f], "output of step %d\n", step);
+                }
+                write_checkpoint(fn_.c_str(), FALSE, NULL, cr_, eiMD, 1, FALSE, 0,
+                                 step, step*0.002, &state, 0, cw);
+                setState(&state, step + 10);
+                for (f = 0; f < c_noutputFiles; f++)
+                {
+                    fprintf(out[f], "output after checkpoint %d\n", step);
+                    fflush(out[f]);
+                }
+            }
+            wait_checkpoint_writer(cw);
+            for (f = 0; f < c_noutputFiles; f++)
+            {
+                gmx_fio_fclose(out[f]);
+            }
+
+            sfree(state.enerhist.ener_ave);
+            sfree(state.enerhist.ener_sum);
+            sfree(state.enerhist.ener_sum_sim);
+            done_state(&state);
+        }
+
+        gmx::test::TestFileManager fileManager_;
+        std::string                fn_;
+        std::string                fnPrev_;
+        std::string                fnOut_[c_noutputFiles];
+        std::string                fnSync_;
+        std::string                fnSyncPrev_;
+        t_commrec                 *cr_;
+};
+
+TEST_F(AsyncCheckpointTest, WritesSameFilesAsSynchronousWriting)
+{
+    gmx_checkpoint_writer_t cw;
+    time_t                  start;
+    int                     attempt;
+
+    setAsyncCheckpointEnv("1");
+    cw = init_checkpoint_writer();
+    ASSERT_TRUE(cw != NULL);
+
+    /* The checkpoint contains the time of writing in seconds,
+     * so we retry when a second boundary is crossed.
+     */
+    for (attempt = 0; attempt < 3; attempt++)
+    {
+        std::remove(fn_.c_str());
+        std::remove(fnPrev_.c_str());
+        start = time(NULL);
+
+        runSteps(NULL);
+        ASSERT_EQ(0, std::rename(fn_.c_str(), fnSync_.c_str()));
+        ASSERT_EQ(0, std::rename(fnPrev_.c_str(), fnSyncPrev_.c_str()));
+
+        /* Writing the checkpoint of step 2 has to wait for step 1,
+         * otherwise the previous checkpoint would not be step 1.
+         */
+        runSteps(cw);
+
+        if (time(NULL) == start)
+        {
+            break;
+        }
+    }
+    done_checkpoint_writer(cw);
+
+    std::string ref = fileContents(fnSync_);
+    ASSERT_FALSE(ref.empty());
+    EXPECT_TRUE(ref == fileContents(fn_)) << "checkpoint of step 2 differs";
+    std::string refPrev = fileContents(fnSyncPrev_);
+    ASSERT_FALSE(refPrev.empty());
+    EXPECT_TRUE(refPrev == fileContents(fnPrev_)) << "checkpoint of step 1 differs";
+    EXPECT_FALSE(ref == refPrev);
+}
+
+} // namespace
@@ -50,16 +50,55 @@ extern "C" {
 /* the name of the environment variable to disable fsync failure checks with */
 #define GMX_IGNORE_FSYNC_FAILURE_ENV "GMX_IGNORE_FSYNC_FAILURE"
 
+/* Abstract type for a thread that writes checkpoint files asynchronously */
+typedef struct gmx_checkpoint_writer *gmx_checkpoint_writer_t;
+
+/* Returns a checkpoint writer thread when the environment variable
+ * GMX_ASYNC_CHECKPOINT is set and threads are supported, NULL otherwise.
+ */
+gmx_checkpoint_writer_t init_checkpoint_writer(void);
+
+/* Waits until the checkpoint writer has finished the current checkpoint.
+ * Does nothing when cw is NULL.
+ */
+void wait_checkpoint_writer(gmx_checkpoint_writer_t cw);
+
+/* Finishes the current checkpoint, stops the thread and frees cw.
+ * Should be called before closing the output files.
+ */
+void done_checkpoint_writer(gmx_checkpoint_writer_t cw);
+
 /* Write a checkpoint to <fn>.cpt
  * Appends the _step<step>.cpt with bNumberAndKeep,
  * otherwise moves the previous <fn>.cpt to <fn>_prev.cpt
+ * With nparts > 0, the per-atom entries of state are not used, they
+ * should have been written by nparts ranks with write_checkpoint_part.
+ * With a checkpoint writer cw, a copy of state is made and writing,
+ * checksumming of the output files and fsync are done by the writer
+ * thread. Without cw, or with expanded ensemble, essential dynamics
+ * or position swapping, the checkpoint is written before returning.
  */
 void write_checkpoint(const char *fn, gmx_bool bNumberAndKeep,
                       FILE *fplog, t_commrec *cr,
                       int eIntegrator, int simulation_part,
                       gmx_bool bExpanded, int elamstats,
                       gmx_int64_t step, double t,
-                      t_state *state);
+                      t_state *state, int nparts,
+                      gmx_checkpoint_writer_t cw);
+
+/* Write part part of nparts of the checkpoint <fn>.cpt at step to
+ * <fn>_step<step>_part<part>.cpt, with the per-atom entries of
+ * the nhome home atoms in state_local, which have global atom indices
+ * index, of the natoms atoms in the system.
+ * The checkpoint stores the part file names without directory,
+ * parts are read from the directory of the checkpoint file.
+ * Reading the checkpoint collects the parts into the global state,
+ * so a run can be continued with any number of ranks.
+ * The parts of checkpoint files that are no longer needed are removed.
+ */
+void write_checkpoint_part(const char *fn, gmx_int64_t step,
+                           int part, int nparts, int natoms,
+                           int nhome, int *index, t_state *state_local);
 
 /* Loads a checkpoint from fn for run continuation.
  * Generates a fatal error on system size mismatch.
@@ -113,6 +113,24 @@ void csettle(gmx_settledata_t    settled,
              int                *xerror,
              t_vetavars         *vetavar           /* variables for pressure control */
              );
+/* Constrains the water molecules with SETTLE. When SIMD is supported,
+ * the settles are processed GMX_SIMD_REAL_WIDTH at a time with SIMD
+ * and the remainder with csettle_ref.
+ */
+
+void csettle_ref(gmx_settledata_t    settled,
+                 int                 nsettle,
+                 t_iatom             iatoms[],
+                 const struct t_pbc *pbc,
+                 real                b4[],
+                 real                after[],
+                 real                invdt,
+                 real               *v,
+                 int                 calcvir_atom_end,
+                 tensor              vir_r_m_dr,
+                 int                *xerror,
+                 t_vetavars         *vetavar);
+/* Plain C version of csettle, same arguments */
 
 void settle_proj(gmx_settledata_t settled, int econq,
                  int nsettle, t_iatom iatoms[],
@@ -157,6 +157,13 @@ void dd_collect_vec(gmx_domdec_t *dd,
 void dd_collect_state(gmx_domdec_t *dd,
                       t_state *state_local, t_state *state);
 
+void dd_collect_state_nonatomic(gmx_domdec_t *dd,
+                                t_state *state_local, t_state *state);
+/* Copies only the entries of state_local that are not per atom
+ * to state on the master, for checkpoints where each rank writes
+ * its own home atoms.
+ */
+
 enum {
     ddCyclStep, ddCyclPPduringPME, ddCyclF, ddCyclWaitGPU, ddCyclPME, ddCyclNr
 };
@@ -81,6 +81,7 @@ enum gmx_cpuid_feature
     GMX_CPUID_FEATURE_X86_APIC,          /* APIC support                                 */
     GMX_CPUID_FEATURE_X86_AVX,           /* Advanced vector extensions                   */
     GMX_CPUID_FEATURE_X86_AVX2,          /* AVX2 including gather support (not used yet) */
+    GMX_CPUID_FEATURE_X86_AVX_512F,      /* AVX-512 foundation instructions              */
     GMX_CPUID_FEATURE_X86_CLFSH,         /* Supports CLFLUSH instruction                 */
     GMX_CPUID_FEATURE_X86_CMOV,          /* Conditional move insn support                */
     GMX_CPUID_FEATURE_X86_CX8,           /* Supports CMPXCHG8B (8-byte compare-exchange) */
@@ -130,6 +131,7 @@ enum gmx_cpuid_simd
     GMX_CPUID_SIMD_X86_AVX_128_FMA,
     GMX_CPUID_SIMD_X86_AVX_256,
     GMX_CPUID_SIMD_X86_AVX2_256,
+    GMX_CPUID_SIMD_X86_AVX_512,
     GMX_CPUID_SIMD_SPARC64_HPC_ACE,
     GMX_CPUID_SIMD_IBM_QPX,
     GMX_CPUID_NSIMD
@@ -182,7 +182,11 @@ typedef struct ewald_tab *ewald_tab_t;
 typedef struct {
     rvec             *f;
     int               f_nalloc;
-    unsigned          red_mask; /* Mask for marking which parts of f are filled */
+    gmx_bool         *red_mask;         /* Marks which blocks of f are filled  */
+    int               red_mask_nalloc;  /* Allocation size of red_mask         */
+    int              *red_block;        /* Indices of the filled blocks of f   */
+    int               red_nblock;       /* The number of filled blocks         */
+    int               red_block_nalloc; /* Allocation size of red_block        */
     rvec             *fshift;
     real              ener[F_NRE];
     gmx_grppairener_t grpp;
@@ -476,8 +480,11 @@ typedef struct {
     /* Thread local force and energy data */
     /* FIXME move to bonded_thread_data_t */
     int         nthreads;
-    int         red_ashift;
-    int         red_nblock;
+    int         red_ashift;       /* The block size for reduction is 1<<red_ashift */
+    int         red_nblock;       /* The number of blocks that cover f             */
+    int        *red_block;        /* Blocks filled by any thread other than 0      */
+    int         red_nblock_used;  /* The number of blocks in red_block             */
+    int         red_block_nalloc; /* Allocation size of red_block                  */
     f_thread_t *f_t;
 
     /* Exclusion load distribution over the threads */
@@ -89,6 +89,10 @@ typedef struct {
     /* Cut-off */
     real rlist;
     real rlistlong;
+    /* Cut-off of the dynamically pruned inner pair list, equal to rlist
+     * when dynamic pruning is not used.
+     */
+    real rlist_inner;
 
     /* PME/Ewald */
     real ewaldcoeff_q;
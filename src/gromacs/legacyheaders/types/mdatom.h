@@ -60,6 +60,10 @@ typedef struct {
     int                    nTypePerturbed;
     gmx_bool               bOrires;
     real                  *massA, *massB, *massT, *invmass;
+    /* The inverse mass per dimension, zero for virtual sites, shells
+     * and frozen dimensions, used by the specialized update kernels
+     */
+    rvec                  *invmass_dim;
     real                  *chargeA, *chargeB;
     real                  *sqrt_c6A, *sqrt_c6B;
     real                  *sigmaA, *sigmaB, *sigma3A, *sigma3B;
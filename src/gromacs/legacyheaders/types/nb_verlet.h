@@ -105,6 +105,9 @@ typedef struct {
     nbnxn_cuda_ptr_t         cu_nbv;          /* pointer to CUDA nb verlet data     */
     int                      min_ci_balanced; /* pair list balancing parameter
                                                  used for the 8x8x8 CUDA kernels    */
+    gmx_bool                 bDynamicPruning; /* Prune the list every nstlist_prune steps */
+    int                      nstlist_prune;   /* The interval for dynamic pruning    */
+    gmx_int64_t              step_search;     /* The step of the last pair search    */
 } nonbonded_verlet_t;
 
 #ifdef __cplusplus
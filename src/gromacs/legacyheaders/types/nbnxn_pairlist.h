@@ -156,6 +156,16 @@ typedef struct {
     int                     excl_nalloc; /* The allocation size for excl             */
     int                     nci_tot;     /* The total number of i clusters           */
 
+    /* With dynamic pruning the list generated by the search is stored
+     * as the outer list, the pruned inner list is stored in ci and cj.
+     */
+    int                     nci_outer;       /* The number of i-clusters in the outer list */
+    nbnxn_ci_t             *ci_outer;        /* The outer i-cluster list, size nci_outer   */
+    int                     ci_outer_nalloc; /* The allocation size of ci_outer            */
+    int                     ncj_outer;       /* The number of j-clusters in the outer list */
+    nbnxn_cj_t             *cj_outer;        /* The outer j-cluster list, size ncj_outer   */
+    int                     cj_outer_nalloc; /* The allocation size of cj_outer            */
+
     struct nbnxn_list_work *work;
 
     gmx_cache_protect_t     cp1;
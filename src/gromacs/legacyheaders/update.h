@@ -56,6 +56,14 @@ typedef struct gmx_update *gmx_update_t;
 /* Initialize the stochastic dynamics struct */
 gmx_update_t init_update(t_inputrec *ir);
 
+/* Select the general update kernels instead of the specialized
+ * kernels that are used by default for simple setups, i.e. a single
+ * T-coupling group, no acceleration and no extended-ensemble coupling.
+ * The general kernels can also be selected by setting the environment
+ * variable GMX_UPDATE_GENERIC. Mainly useful for testing and benchmarking.
+ */
+void set_update_generic(gmx_update_t upd, gmx_bool bGeneric);
+
 /* Store the random state from sd in state */
 void get_stochd_state(gmx_update_t sd, t_state *state);
 
@@ -47,10 +47,27 @@
 extern "C" {
 #endif
 
+/* The vsites of one dependency level assigned to one thread.
+ * The vsites in ilist only have constructing atoms in the atom range
+ * of the thread and spread their forces directly. The vsites in id_ilist
+ * have constructing atoms outside this range, they spread their forces
+ * to the thread-local buffer f_id, which is reduced afterwards.
+ */
+typedef struct {
+    t_ilist ilist[F_NRE];     /* vsites with all atoms in our range      */
+    t_ilist id_ilist[F_NRE];  /* vsites with atoms outside our range     */
+    int     nid_atom;         /* The number of atoms in id_atom          */
+    int    *id_atom;          /* The constructing atoms of id_ilist      */
+    int     id_atom_nalloc;   /* Size of id_atom                         */
+} gmx_vsite_task_t;
+
 typedef struct {
-    t_ilist ilist[F_NRE];     /* vsite ilists for this thread            */
-    rvec    fshift[SHIFTS];   /* fshift accumulation buffer              */
-    matrix  dxdf;             /* virial dx*df accumulation buffer        */
+    gmx_vsite_task_t *task;        /* Tasks for each dependency level    */
+    int               task_nalloc; /* Size of task                       */
+    rvec             *f_id;        /* Force buffer for the id_ilist vsites */
+    int               f_id_nalloc; /* Size of f_id                       */
+    rvec              fshift[SHIFTS]; /* fshift accumulation buffer      */
+    matrix            dxdf;        /* virial dx*df accumulation buffer   */
 } gmx_vsite_thread_t;
 
 typedef struct {
@@ -61,9 +78,12 @@ typedef struct {
     int               **vsite_pbc_loc;        /* The local pbc atoms                     */
     int                *vsite_pbc_loc_nalloc; /* Sizes of vsite_pbc_loc                  */
     int                 nthreads;             /* Number of threads used for vsites       */
+    int                 natperthread;         /* The atom range size of each thread      */
+    int                 nlevel;               /* Number of vsite dependency levels       */
     gmx_vsite_thread_t *tdata;                /* Thread local vsites and work structs    */
-    int                *th_ind;               /* Work array                              */
-    int                 th_ind_nalloc;        /* Size of th_ind                          */
+    int                *at_level;             /* Work array, vsite level per atom        */
+    int                *at_mark;              /* Work array for marking atoms            */
+    int                 at_nalloc;            /* Size of at_level and at_mark            */
 } gmx_vsite_t;
 
 struct t_graph;
@@ -115,10 +135,14 @@ gmx_vsite_t *init_vsite(gmx_mtop_t *mtop, t_commrec *cr,
  */
 
 void split_vsites_over_threads(const t_ilist   *ilist,
+                               const t_iparams *ip,
                                const t_mdatoms *mdatoms,
                                gmx_bool         bLimitRange,
                                gmx_vsite_t     *vsite);
 /* Divide the vsite work-load over the threads.
+ * The vsites are sorted into levels, such that vsites only depend
+ * on vsites of lower levels. Within a level all threads construct
+ * vsites and spread forces concurrently.
  * Should be called at the end of the domain decomposition.
  */
 
@@ -92,6 +92,29 @@ sparse_eigensolver(gmx_sparsematrix_t *    A,
                    real *                  eigenvectors,
                    int                     maxiter);
 
+
+/*! \brief Partial eigensolver for the largest eigenvalues of a dense matrix.
+ *
+ *  This routine determines the neig largest eigenvalues, and if the
+ *  eigenvectors pointer is non-NULL also the corresponding eigenvectors,
+ *  of the symmetric n*n matrix a with the ARPACK Lanczos method.
+ *  Only matrix-vector products with a are needed, which are computed
+ *  with OpenMP threads, so for neig much smaller than n this is much
+ *  faster than eigensolver() and a is not changed.
+ *
+ *  As for eigensolver(), the eigenvalues are sorted in ascending order
+ *  and eigenvector j starts at offset j*n. neig should be smaller than n.
+ *
+ *  maxiter=100000 should suffice in most cases!
+ */
+void
+dense_partial_eigensolver(const real *    a,
+                          int             n,
+                          int             neig,
+                          real *          eigenvalues,
+                          real *          eigenvectors,
+                          int             maxiter);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1379,7 +1379,7 @@ F77_FUNC(dsconv, DSCONV) (int *     n,
                           double *  tol,
                           int *     nconv)
 {
-    double c_b3 = 2/3;
+    double c_b3 = 2.0/3.0;
     int    i__1;
     double d__2, d__3;
 
@@ -1836,7 +1836,7 @@ F77_FUNC(dsaup2, DSAUP2) (int *     ido,
                           int *     iwork,
                           int *     info)
 {
-    double c_b3 = 2/3;
+    double c_b3 = 2.0/3.0;
     int    c__1 = 1;
     int    c__0 = 0;
 
@@ -2403,13 +2403,13 @@ F77_FUNC(dseupd, DSEUPD) (int *     rvec,
                           int *     lworkl,
                           int *     info)
 {
-    double c_b21  = 2/3;
+    double c_b21  = 2.0/3.0;
     int    c__1   = 1;
     double c_b102 = 1.;
     int    v_dim1, v_offset, z_dim1, z_offset, i__1;
     double d__1, d__2, d__3;
 
-    int    j, k, ih, iq, iw, ibd, ihb, ihd, ldh, ilg, ldq, ism, irz;
+    int    j, k, ih, iq, iw, ibd, ihb, ihd, ldh, ldq, irz, jj, np;
     int    mode;
     double eps23;
     int    ierr;
@@ -2421,11 +2421,9 @@ F77_FUNC(dseupd, DSEUPD) (int *     rvec,
     int    nconv;
     double rnorm;
     double bnorm2;
-    double thres1 = 0, thres2 = 0;
     int    bounds;
-    int    ktrord;
-    double tempbnd;
     int    leftptr, rghtptr;
+    int    ishift, numcnv;
 
 
     --workd;
@@ -2563,103 +2561,48 @@ F77_FUNC(dseupd, DSEUPD) (int *     rvec,
     if (*rvec)
     {
 
-        if (!strncmp(which, "LM", 2) || !strncmp(which, "SM", 2) ||
-            !strncmp(which, "LA", 2) || !strncmp(which, "SA", 2))
+        /* Store the indices of the Ritz values in the bounds array, to
+         * mark the select array. Sort the Ritz values such that the wanted
+         * ones are at the end and select the nconv converged ones of those.
+         * The original ARPACK version selected with thresholds that were
+         * only set for "BE", which for the other cases could select more
+         * than nconv values and return the wrong Ritz vectors.
+         */
+        reord = 0;
+        i__1  = *ncv;
+        for (j = 1; j <= i__1; ++j)
         {
-
+            workl[bounds + j - 1] = (double)j;
+            select[j]             = 0;
         }
-        else if (!strncmp(which, "BE", 2))
-        {
-
-
-            ism    = (*nev > nconv) ? *nev : nconv;
-            ism   /= 2;
-            ilg    = ism + 1;
-            thres1 = workl[ism];
-            thres2 = workl[ilg];
 
+        np     = *ncv - *nev;
+        ishift = 0;
+        F77_FUNC(dsgets, DSGETS) (&ishift, which, nev, &np, &workl[irz], &workl[bounds], &workl[1]);
 
-        }
-
-        reord  = 0;
-        ktrord = 0;
-        i__1   = *ncv - 1;
-        for (j = 0; j <= i__1; ++j)
+        numcnv = 0;
+        i__1   = *ncv;
+        for (j = 1; j <= i__1; ++j)
         {
-            select[j + 1] = 0;
-            if (!strncmp(which, "LM", 2))
-            {
-                if (fabs(workl[irz + j]) >= fabs(thres1))
-                {
-                    d__2    = eps23;
-                    d__3    = fabs(workl[irz + j]);
-                    tempbnd = (d__2 > d__3) ? d__2 : d__3;
-                    if (workl[ibd + j] <= *tol * tempbnd)
-                    {
-                        select[j + 1] = 1;
-                    }
-                }
-            }
-            else if (!strncmp(which, "SM", 2))
-            {
-                if (fabs(workl[irz + j]) <= fabs(thres1))
-                {
-                    d__2    = eps23;
-                    d__3    = fabs(workl[irz + j]);
-                    tempbnd = (d__2 > d__3) ? d__2 : d__3;
-                    if (workl[ibd + j] <= *tol * tempbnd)
-                    {
-                        select[j + 1] = 1;
-                    }
-                }
-            }
-            else if (!strncmp(which, "LA", 2))
+            d__2 = eps23;
+            d__3 = fabs(workl[irz + *ncv - j]);
+            temp = (d__2 > d__3) ? d__2 : d__3;
+            jj   = (int)workl[bounds + *ncv - j];
+            if (numcnv < nconv && workl[ibd + jj - 1] <= *tol * temp)
             {
-                if (workl[irz + j] >= thres1)
+                select[jj] = 1;
+                ++numcnv;
+                if (jj > nconv)
                 {
-                    d__2    = eps23;
-                    d__3    = fabs(workl[irz + j]);
-                    tempbnd = (d__2 > d__3) ? d__2 : d__3;
-                    if (workl[ibd + j] <= *tol * tempbnd)
-                    {
-                        select[j + 1] = 1;
-                    }
+                    reord = 1;
                 }
             }
-            else if (!strncmp(which, "SA", 2))
-            {
-                if (workl[irz + j] <= thres1)
-                {
-                    d__2    = eps23;
-                    d__3    = fabs(workl[irz + j]);
-                    tempbnd = (d__2 > d__3) ? d__2 : d__3;
-                    if (workl[ibd + j] <= *tol * tempbnd)
-                    {
-                        select[j + 1] = 1;
-                    }
-                }
-            }
-            else if (!strncmp(which, "BE", 2))
-            {
-                if (workl[irz + j] <= thres1 || workl[irz + j] >= thres2)
-                {
-                    d__2    = eps23;
-                    d__3    = fabs(workl[irz + j]);
-                    tempbnd = (d__2 > d__3) ? d__2 : d__3;
-                    if (workl[ibd + j] <= *tol * tempbnd)
-                    {
-                        select[j + 1] = 1;
-                    }
-                }
-            }
-            if (j + 1 > nconv)
-            {
-                reord = select[j + 1] || reord;
-            }
-            if (select[j + 1])
-            {
-                ++ktrord;
-            }
+        }
+
+        if (numcnv != nconv)
+        {
+            *info = -17;
+            goto L9000;
         }
 
         i__1 = *ncv - 1;
@@ -4248,7 +4191,7 @@ F77_FUNC(ssconv, SSCONV) (int *     n,
                           float *  tol,
                           int *     nconv)
 {
-    float c_b3 = 2/3;
+    float c_b3 = 2.0/3.0;
     int   i__1;
     float d__2, d__3;
 
@@ -4705,7 +4648,7 @@ F77_FUNC(ssaup2, SSAUP2) (int *     ido,
                           int *     iwork,
                           int *     info)
 {
-    float c_b3 = 2/3;
+    float c_b3 = 2.0/3.0;
     int   c__1 = 1;
     int   c__0 = 0;
 
@@ -5273,13 +5216,13 @@ F77_FUNC(sseupd, SSEUPD) (int *     rvec,
                           int *     lworkl,
                           int *     info)
 {
-    float c_b21  = 2/3;
+    float c_b21  = 2.0/3.0;
     int   c__1   = 1;
     float c_b102 = 1.;
     int   v_dim1, v_offset, z_dim1, z_offset, i__1;
     float d__1, d__2, d__3;
 
-    int   j, k, ih, iq, iw, ibd, ihb, ihd, ldh, ilg, ldq, ism, irz;
+    int   j, k, ih, iq, iw, ibd, ihb, ihd, ldh, ldq, irz, jj, np;
     int   mode;
     float eps23;
     int   ierr;
@@ -5291,11 +5234,9 @@ F77_FUNC(sseupd, SSEUPD) (int *     rvec,
     int   nconv;
     float rnorm;
     float bnorm2;
-    float thres1 = 0, thres2 = 0;
     int   bounds;
-    int   ktrord;
-    float tempbnd;
     int   leftptr, rghtptr;
+    int   ishift, numcnv;
 
 
     --workd;
@@ -5433,103 +5374,48 @@ F77_FUNC(sseupd, SSEUPD) (int *     rvec,
     if (*rvec)
     {
 
-        if (!strncmp(which, "LM", 2) || !strncmp(which, "SM", 2) ||
-            !strncmp(which, "LA", 2) || !strncmp(which, "SA", 2))
+        /* Store the indices of the Ritz values in the bounds array, to
+         * mark the select array. Sort the Ritz values such that the wanted
+         * ones are at the end and select the nconv converged ones of those.
+         * The original ARPACK version selected with thresholds that were
+         * only set for "BE", which for the other cases could select more
+         * than nconv values and return the wrong Ritz vectors.
+         */
+        reord = 0;
+        i__1  = *ncv;
+        for (j = 1; j <= i__1; ++j)
         {
-
+            workl[bounds + j - 1] = (float)j;
+            select[j]             = 0;
         }
-        else if (!strncmp(which, "BE", 2))
-        {
-
-
-            ism    = (*nev > nconv) ? *nev : nconv;
-            ism   /= 2;
-            ilg    = ism + 1;
-            thres1 = workl[ism];
-            thres2 = workl[ilg];
 
+        np     = *ncv - *nev;
+        ishift = 0;
+        F77_FUNC(ssgets, SSGETS) (&ishift, which, nev, &np, &workl[irz], &workl[bounds], &workl[1]);
 
-        }
-
-        reord  = 0;
-        ktrord = 0;
-        i__1   = *ncv - 1;
-        for (j = 0; j <= i__1; ++j)
+        numcnv = 0;
+        i__1   = *ncv;
+        for (j = 1; j <= i__1; ++j)
         {
-            select[j + 1] = 0;
-            if (!strncmp(which, "LM", 2))
-            {
-                if (fabs(workl[irz + j]) >= fabs(thres1))
-                {
-                    d__2    = eps23;
-                    d__3    = fabs(workl[irz + j]);
-                    tempbnd = (d__2 > d__3) ? d__2 : d__3;
-                    if (workl[ibd + j] <= *tol * tempbnd)
-                    {
-                        select[j + 1] = 1;
-                    }
-                }
-            }
-            else if (!strncmp(which, "SM", 2))
-            {
-                if (fabs(workl[irz + j]) <= fabs(thres1))
-                {
-                    d__2    = eps23;
-                    d__3    = fabs(workl[irz + j]);
-                    tempbnd = (d__2 > d__3) ? d__2 : d__3;
-                    if (workl[ibd + j] <= *tol * tempbnd)
-                    {
-                        select[j + 1] = 1;
-                    }
-                }
-            }
-            else if (!strncmp(which, "LA", 2))
+            d__2 = eps23;
+            d__3 = fabs(workl[irz + *ncv - j]);
+            temp = (d__2 > d__3) ? d__2 : d__3;
+            jj   = (int)workl[bounds + *ncv - j];
+            if (numcnv < nconv && workl[ibd + jj - 1] <= *tol * temp)
             {
-                if (workl[irz + j] >= thres1)
+                select[jj] = 1;
+                ++numcnv;
+                if (jj > nconv)
                 {
-                    d__2    = eps23;
-                    d__3    = fabs(workl[irz + j]);
-                    tempbnd = (d__2 > d__3) ? d__2 : d__3;
-                    if (workl[ibd + j] <= *tol * tempbnd)
-                    {
-                        select[j + 1] = 1;
-                    }
+                    reord = 1;
                 }
             }
-            else if (!strncmp(which, "SA", 2))
-            {
-                if (workl[irz + j] <= thres1)
-                {
-                    d__2    = eps23;
-                    d__3    = fabs(workl[irz + j]);
-                    tempbnd = (d__2 > d__3) ? d__2 : d__3;
-                    if (workl[ibd + j] <= *tol * tempbnd)
-                    {
-                        select[j + 1] = 1;
-                    }
-                }
-            }
-            else if (!strncmp(which, "BE", 2))
-            {
-                if (workl[irz + j] <= thres1 || workl[irz + j] >= thres2)
-                {
-                    d__2    = eps23;
-                    d__3    = fabs(workl[irz + j]);
-                    tempbnd = (d__2 > d__3) ? d__2 : d__3;
-                    if (workl[ibd + j] <= *tol * tempbnd)
-                    {
-                        select[j + 1] = 1;
-                    }
-                }
-            }
-            if (j + 1 > nconv)
-            {
-                reord = select[j + 1] || reord;
-            }
-            if (select[j + 1])
-            {
-                ++ktrord;
-            }
+        }
+
+        if (numcnv != nconv)
+        {
+            *info = -17;
+            goto L9000;
         }
 
         i__1 = *ncv - 1;
@@ -0,0 +1,128 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the dense partial eigensolver.
+ *
+ * The largest eigenvalues and eigenvectors from dense_partial_eigensolver()
+ * are compared with those of the full LAPACK eigensolver() on a symmetric
+ * matrix with known structure.
+ */
+#include <cmath>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/linearalgebra/eigensolver.h"
+
+namespace
+{
+
+/*! \brief
+ * Returns a symmetric n*n matrix with distinct eigenvalues.
+ *
+ * The off-diagonal elements decay with the distance from the diagonal,
+ * the increasing diagonal separates the eigenvalues.
+ */
+std::vector<real> symmetricTestMatrix(int n)
+{
+    std::vector<real> a(n*n);
+
+    for (int i = 0; i < n; i++)
+    {
+        for (int j = 0; j < n; j++)
+        {
+            a[i*n + j] = 1.0/(1 + std::abs(i - j));
+        }
+        a[i*n + i] += 0.1*i;
+    }
+
+    return a;
+}
+
+//! Compares the \p neig largest eigenpairs of the two solvers for size \p n.
+void compareWithFullSolver(int n, int neig)
+{
+    std::vector<real> a = symmetricTestMatrix(n);
+    std::vector<real> aCopy(a);
+    std::vector<real> valFull(n), vecFull(n*n);
+    std::vector<real> valPart(neig), vecPart(neig*n);
+
+    eigensolver(&aCopy[0], n, 0, n, &valFull[0], &vecFull[0]);
+    dense_partial_eigensolver(&a[0], n, neig, &valPart[0], &vecPart[0], 100000);
+
+    /* The input matrix should not be changed */
+    std::vector<real> aRef = symmetricTestMatrix(n);
+    for (int i = 0; i < n*n; i++)
+    {
+        EXPECT_EQ(aRef[i], a[i]) << "Matrix changed at element " << i;
+    }
+
+    const real tolerance = (sizeof(real) == sizeof(float) ? 1e-4 : 1e-10);
+    for (int k = 0; k < neig; k++)
+    {
+        /* Both solvers return the eigenvalues in ascending order */
+        int  kFull = n - neig + k;
+        EXPECT_NEAR(valFull[kFull], valPart[k], tolerance*std::fabs(valFull[kFull]))
+        << "Eigenvalue " << k << " of the " << neig << " largest differs";
+
+        /* The eigenvectors are normalized, but their sign is arbitrary */
+        double dot = 0;
+        for (int i = 0; i < n; i++)
+        {
+            dot += vecFull[kFull*n + i]*vecPart[k*n + i];
+        }
+        EXPECT_NEAR(1.0, std::fabs(dot), 10*tolerance)
+        << "Eigenvector " << k << " of the " << neig << " largest differs";
+    }
+}
+
+TEST(DensePartialEigensolverTest, MatchesFullSolverForFewEigenvectors)
+{
+    compareWithFullSolver(60, 3);
+}
+
+TEST(DensePartialEigensolverTest, MatchesFullSolverForManyEigenvectors)
+{
+    compareWithFullSolver(60, 25);
+}
+
+TEST(DensePartialEigensolverTest, MatchesFullSolverForSmallMatrix)
+{
+    compareWithFullSolver(8, 7);
+}
+
+} // namespace
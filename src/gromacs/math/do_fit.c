@@ -285,6 +285,132 @@ void do_fit(int natoms, real *w_rls, rvec *xp, rvec *x)
     do_fit_ndim(3, natoms, w_rls, xp, x);
 }
 
+/* Returns the determinant of the 4x4 matrix a */
+static double det4(double a[4][4])
+{
+    double s0, s1, s2, s3, s4, s5, c0, c1, c2, c3, c4, c5;
+
+    s0 = a[0][0]*a[1][1] - a[1][0]*a[0][1];
+    s1 = a[0][0]*a[1][2] - a[1][0]*a[0][2];
+    s2 = a[0][0]*a[1][3] - a[1][0]*a[0][3];
+    s3 = a[0][1]*a[1][2] - a[1][1]*a[0][2];
+    s4 = a[0][1]*a[1][3] - a[1][1]*a[0][3];
+    s5 = a[0][2]*a[1][3] - a[1][2]*a[0][3];
+
+    c5 = a[2][2]*a[3][3] - a[3][2]*a[2][3];
+    c4 = a[2][1]*a[3][3] - a[3][1]*a[2][3];
+    c3 = a[2][1]*a[3][2] - a[3][1]*a[2][2];
+    c2 = a[2][0]*a[3][3] - a[3][0]*a[2][3];
+    c1 = a[2][0]*a[3][2] - a[3][0]*a[2][2];
+    c0 = a[2][0]*a[3][1] - a[3][0]*a[2][1];
+
+    return s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0;
+}
+
+real rmsdev_fit(int natoms, real *w_rls, rvec *xp, rvec *x)
+{
+    double S[DIM][DIM], K[4][4];
+    double wsum, g, c0, c1, c2, lambda, lambda_prev, l2, p, dp, msd;
+    int    i, d, e, iter;
+
+    /* The weighted correlation matrix and the sum of the inner products */
+    for (d = 0; d < DIM; d++)
+    {
+        for (e = 0; e < DIM; e++)
+        {
+            S[d][e] = 0;
+        }
+    }
+    wsum = 0;
+    g    = 0;
+    /* We need double precision, since for similar structures the mean
+     * squared deviation is a small difference of large numbers.
+     */
+    for (i = 0; i < natoms; i++)
+    {
+        double w = w_rls[i];
+        dvec   wx;
+
+        for (d = 0; d < DIM; d++)
+        {
+            wx[d] = w*x[i][d];
+            for (e = 0; e < DIM; e++)
+            {
+                S[d][e] += wx[d]*xp[i][e];
+            }
+            g += wx[d]*x[i][d] + w*xp[i][d]*xp[i][d];
+        }
+        wsum += w;
+    }
+    if (wsum == 0)
+    {
+        return 0;
+    }
+
+    /* The largest eigenvalue of the symmetric key matrix K gives
+     * the maximal inner product of xp and rotated x.
+     * We obtain it with Newton-Raphson iterations on the characteristic
+     * polynomial of K, using the quaternion characteristic polynomial
+     * (QCP) method, D. L. Theobald, Acta Cryst. A61, 478 (2005).
+     */
+    K[0][0] =  S[XX][XX] + S[YY][YY] + S[ZZ][ZZ];
+    K[0][1] =  S[YY][ZZ] - S[ZZ][YY];
+    K[0][2] =  S[ZZ][XX] - S[XX][ZZ];
+    K[0][3] =  S[XX][YY] - S[YY][XX];
+    K[1][1] =  S[XX][XX] - S[YY][YY] - S[ZZ][ZZ];
+    K[1][2] =  S[XX][YY] + S[YY][XX];
+    K[1][3] =  S[ZZ][XX] + S[XX][ZZ];
+    K[2][2] = -S[XX][XX] + S[YY][YY] - S[ZZ][ZZ];
+    K[2][3] =  S[YY][ZZ] + S[ZZ][YY];
+    K[3][3] = -S[XX][XX] - S[YY][YY] + S[ZZ][ZZ];
+    for (d = 0; d < 4; d++)
+    {
+        for (e = d + 1; e < 4; e++)
+        {
+            K[e][d] = K[d][e];
+        }
+    }
+
+    /* K is traceless, so the polynomial is l^4 + c2 l^2 + c1 l + c0 */
+    c2 = 0;
+    for (d = 0; d < DIM; d++)
+    {
+        for (e = 0; e < DIM; e++)
+        {
+            c2 -= 2*S[d][e]*S[d][e];
+        }
+    }
+    c1 = -8*(S[XX][XX]*(S[YY][YY]*S[ZZ][ZZ] - S[YY][ZZ]*S[ZZ][YY])
+             - S[XX][YY]*(S[YY][XX]*S[ZZ][ZZ] - S[YY][ZZ]*S[ZZ][XX])
+             + S[XX][ZZ]*(S[YY][XX]*S[ZZ][YY] - S[YY][YY]*S[ZZ][XX]));
+    c0 = det4(K);
+
+    /* Half the sum of the inner products is an upper bound for the
+     * largest eigenvalue, so Newton-Raphson converges to it from there.
+     */
+    lambda = 0.5*g;
+    for (iter = 0; iter < 50; iter++)
+    {
+        lambda_prev = lambda;
+        l2          = lambda*lambda;
+        p           = (l2 + c2)*l2 + c1*lambda + c0;
+        dp          = 2*(2*l2 + c2)*lambda + c1;
+        if (dp == 0)
+        {
+            break;
+        }
+        lambda -= p/dp;
+        if (fabs(lambda - lambda_prev) <= 1e-14*fabs(lambda))
+        {
+            break;
+        }
+    }
+
+    msd = (g - 2*lambda)/wsum;
+
+    return (msd > 0 ? sqrt(msd) : 0);
+}
+
 void reset_x_ndim(int ndim, int ncm, const atom_id *ind_cm,
                   int nreset, const atom_id *ind_reset,
                   rvec x[], const real mass[])
@@ -87,6 +87,13 @@ void do_fit_ndim(int ndim, int natoms, real *w_rls, rvec *xp, rvec *x);
 void do_fit(int natoms, real *w_rls, rvec *xp, rvec *x);
 /* Calls do_fit with ndim=3, thus fitting in 3D */
 
+real rmsdev_fit(int natoms, real *w_rls, rvec *xp, rvec *x);
+/* Returns the weighted RMS deviation between xp and x after a least
+ * squares rotational fit of x to xp, as do_fit followed by rmsdev,
+ * but without computing the rotation or modifying x.
+ * Both xp and x should be centered round the origin.
+ */
+
 void reset_x_ndim(int ndim, int ncm, const atom_id *ind_cm,
                   int nreset, const atom_id *ind_reset,
                   rvec x[], const real mass[]);
@@ -0,0 +1,230 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the fit-free RMSD in do_fit.
+ *
+ * rmsdev_fit() computes the RMSD after an optimal rotation from the
+ * largest eigenvalue of the quaternion key matrix, without rotating.
+ * These tests compare it with do_fit() followed by rmsdev() for
+ * rotated, noisy and reflected coordinates. A reflection cannot be
+ * undone by a proper rotation and flips the sign of the determinant
+ * of the correlation matrix, which enters the characteristic
+ * polynomial through its linear coefficient.
+ */
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/math/do_fit.h"
+#include "gromacs/math/vec.h"
+
+namespace
+{
+
+//! Number of atoms in the test structures.
+const int c_numAtoms = 23;
+
+/*! \brief
+ * Sets an irregular structure \p x and non-uniform weights \p w.
+ *
+ * One weight is zero, such an atom should not contribute to the fit
+ * nor to the RMSD. The structure is centered on its weighted center.
+ */
+void referenceStructure(rvec x[], real w[])
+{
+    rvec xc;
+    real wsum = 0;
+
+    clear_rvec(xc);
+    for (int i = 0; i < c_numAtoms; i++)
+    {
+        x[i][XX] = 1.5*std::sin(1.3*i);
+        x[i][YY] = std::cos(0.7*i) + 0.3*std::sin(2.9*i);
+        x[i][ZZ] = 0.15*i - 1.2;
+        w[i]     = (i == 5 ? 0 : 1 + (i % 4));
+        for (int d = 0; d < DIM; d++)
+        {
+            xc[d] += w[i]*x[i][d];
+        }
+        wsum += w[i];
+    }
+    for (int i = 0; i < c_numAtoms; i++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            x[i][d] -= xc[d]/wsum;
+        }
+    }
+}
+
+//! Returns the rotation about x by \p a, then y by \p b, then z by \p c.
+void rotationMatrix(real a, real b, real c, matrix R)
+{
+    matrix Rx, Ry, Rz, tmp;
+
+    clear_mat(Rx);
+    clear_mat(Ry);
+    clear_mat(Rz);
+    Rx[XX][XX] = 1;
+    Rx[YY][YY] = std::cos(a);
+    Rx[YY][ZZ] = -std::sin(a);
+    Rx[ZZ][YY] = std::sin(a);
+    Rx[ZZ][ZZ] = std::cos(a);
+    Ry[YY][YY] = 1;
+    Ry[XX][XX] = std::cos(b);
+    Ry[XX][ZZ] = std::sin(b);
+    Ry[ZZ][XX] = -std::sin(b);
+    Ry[ZZ][ZZ] = std::cos(b);
+    Rz[ZZ][ZZ] = 1;
+    Rz[XX][XX] = std::cos(c);
+    Rz[XX][YY] = -std::sin(c);
+    Rz[YY][XX] = std::sin(c);
+    Rz[YY][YY] = std::cos(c);
+    mmul(Ry, Rx, tmp);
+    mmul(Rz, tmp, R);
+}
+
+/*! \brief
+ * Sets \p x to \p xref rotated by \p R, with a deterministic
+ * displacement of size \p noise added and optionally mirrored in the
+ * xy-plane.
+ *
+ * The result is centered again with the weights \p w, as the fitting
+ * routines require.
+ */
+void transformedStructure(rvec xref[], const real w[], matrix R, real noise,
+                          bool bReflect, rvec x[])
+{
+    rvec xc;
+    real wsum = 0;
+
+    clear_rvec(xc);
+    for (int i = 0; i < c_numAtoms; i++)
+    {
+        rvec xi;
+
+        copy_rvec(xref[i], xi);
+        if (bReflect)
+        {
+            xi[ZZ] = -xi[ZZ];
+        }
+        xi[XX] += noise*std::sin(3.1*i);
+        xi[YY] += noise*std::cos(1.7*i);
+        xi[ZZ] += noise*std::sin(0.9*i + 1);
+        mvmul(R, xi, x[i]);
+        for (int d = 0; d < DIM; d++)
+        {
+            xc[d] += w[i]*x[i][d];
+        }
+        wsum += w[i];
+    }
+    for (int i = 0; i < c_numAtoms; i++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            x[i][d] -= xc[d]/wsum;
+        }
+    }
+}
+
+/*! \brief
+ * Checks that rmsdev_fit() agrees with do_fit() and rmsdev().
+ *
+ * Also checks that rmsdev_fit() does not modify its arguments and
+ * returns \p expected, when that is not negative.
+ */
+void checkFitFreeRmsd(real a, real b, real c, real noise, bool bReflect,
+                      real expected)
+{
+    rvec   xref[c_numAtoms], x[c_numAtoms], xcpy[c_numAtoms];
+    real   w[c_numAtoms];
+    matrix R;
+
+    referenceStructure(xref, w);
+    rotationMatrix(a, b, c, R);
+    transformedStructure(xref, w, R, noise, bReflect, x);
+    for (int i = 0; i < c_numAtoms; i++)
+    {
+        copy_rvec(x[i], xcpy[i]);
+    }
+
+    real rmsdFitFree = rmsdev_fit(c_numAtoms, w, xref, x);
+    for (int i = 0; i < c_numAtoms; i++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            EXPECT_EQ(xcpy[i][d], x[i][d]) << "rmsdev_fit changed x";
+        }
+    }
+
+    do_fit(c_numAtoms, w, xref, x);
+    real rmsdFit = rmsdev(c_numAtoms, w, x, xref);
+
+    const real tolerance = (sizeof(real) == sizeof(float) ? 1e-5 : 1e-10);
+    EXPECT_NEAR(rmsdFit, rmsdFitFree, tolerance*(1 + rmsdFit));
+    if (expected >= 0)
+    {
+        EXPECT_NEAR(expected, rmsdFitFree, 10*tolerance);
+    }
+}
+
+TEST(RmsdevFitTest, ZeroForIdenticalStructures)
+{
+    checkFitFreeRmsd(0, 0, 0, 0, false, 0);
+}
+
+TEST(RmsdevFitTest, ZeroForRotatedStructures)
+{
+    checkFitFreeRmsd(0.3, -1.1, 2.0, 0, false, 0);
+    checkFitFreeRmsd(M_PI, 0, 0, 0, false, 0);
+    checkFitFreeRmsd(0.5*M_PI, 0.5*M_PI, 0.5*M_PI, 0, false, 0);
+}
+
+TEST(RmsdevFitTest, MatchesDoFitForRotatedNoisyStructures)
+{
+    checkFitFreeRmsd(0.3, -1.1, 2.0, 0.01, false, -1);
+    checkFitFreeRmsd(2.5, 0.4, -0.7, 0.2, false, -1);
+    checkFitFreeRmsd(M_PI, 0.1, 0, 0.5, false, -1);
+}
+
+TEST(RmsdevFitTest, MatchesDoFitForReflectedStructures)
+{
+    checkFitFreeRmsd(0, 0, 0, 0, true, -1);
+    checkFitFreeRmsd(0.3, -1.1, 2.0, 0, true, -1);
+    checkFitFreeRmsd(2.5, 0.4, -0.7, 0.05, true, -1);
+}
+
+} // namespace
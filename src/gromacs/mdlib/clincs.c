@@ -53,13 +53,32 @@
 #include "domdec.h"
 #include "mtop_util.h"
 #include "gmx_omp_nthreads.h"
+#include "macros.h"
 
 #include "gromacs/fileio/gmxfio.h"
+#include "gromacs/simd/simd.h"
+#include "gromacs/simd/simd_math.h"
+#include "gromacs/simd/vector_operations.h"
 #include "gromacs/topology/block.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/smalloc.h"
 
+/* The constraints are processed in blocks of LINCS_SIMD_WIDTH.
+ * All per-constraint arrays are padded to a multiple of this width and
+ * the constraint couplings are stored per block in an interleaved layout,
+ * see set_lincs_block_couplings. Without SIMD the width is 1, which
+ * gives the plain compressed row layout.
+ */
+#ifdef GMX_SIMD_HAVE_REAL
+#define LINCS_SIMD
+#define LINCS_SIMD_WIDTH  GMX_SIMD_REAL_WIDTH
+#else
+#define LINCS_SIMD_WIDTH  1
+#endif
+/* The alignment of the arrays that are accessed with SIMD loads */
+#define LINCS_ALIGNMENT   64
+
 typedef struct {
     int    b0;         /* first constraint for this thread */
     int    b1;         /* b1-1 is the last constraint for this thread */
@@ -89,6 +108,11 @@ typedef struct gmx_lincsdata {
     real           *blc1;         /* as blc, but with all masses 1 */
     int            *blnr;         /* index into blbnb and blmf */
     int            *blbnb;        /* list of constraint connections */
+    int             nblock;       /* the number of LINCS_SIMD_WIDTH constraint blocks */
+    int            *sblnr;        /* row index per block into sblbnb, sblmf and tmpncc */
+    int            *sblbnb;       /* blbnb in the interleaved block layout */
+    int             sncc;         /* the number of couplings in the block layout */
+    int             sncc_alloc;   /* the number we allocated memory for */
     int             ntriangle;    /* the local number of constraints in triangles */
     int            *triangle;     /* the list of triangle constraints */
     int            *tri_bits;     /* the bits tell if the matrix element should be used */
@@ -96,14 +120,16 @@ typedef struct gmx_lincsdata {
     gmx_bool        bCommIter;    /* communicate before each LINCS interation */
     real           *blmf;         /* matrix of mass factors for constraint connections */
     real           *blmf1;        /* as blmf, but with all masses 1 */
+    real           *sblmf;        /* blmf in the interleaved block layout */
+    real           *sblmf1;       /* blmf1 in the interleaved block layout */
     real           *bllen;        /* the reference bond length */
     int             nth;          /* The number of threads doing LINCS */
     lincs_thread_t *th;           /* LINCS thread division */
     unsigned       *atf;          /* atom flags for thread parallelization */
     int             atf_nalloc;   /* allocation size of atf */
     /* arrays for temporary storage in the LINCS algorithm */
-    rvec           *tmpv;
-    real           *tmpncc;
+    real           *tmpr[DIM];    /* the constraint directions per dimension */
+    real           *tmpncc;       /* the couplings in the block layout */
     real           *tmp1;
     real           *tmp2;
     real           *tmp3;
@@ -130,6 +156,80 @@ real lincs_rmsd(struct gmx_lincsdata *lincsd, gmx_bool bSD2)
     }
 }
 
+/* Returns the end of the constraint range b0-b1 rounded up to a whole
+ * number of constraint blocks, the padding constraints have zero
+ * constraint coefficients and no couplings.
+ */
+static gmx_inline int lincs_block_end(int b1)
+{
+    return ((b1 + LINCS_SIMD_WIDTH - 1)/LINCS_SIMD_WIDTH)*LINCS_SIMD_WIDTH;
+}
+
+#ifdef LINCS_SIMD
+/* Gathers LINCS_SIMD_WIDTH elements with indices ind from a into buf */
+static gmx_inline void gather_lincs_r(const real *a, const int *ind, real *buf)
+{
+    int i;
+
+    for (i = 0; i < LINCS_SIMD_WIDTH; i++)
+    {
+        buf[i] = a[ind[i]];
+    }
+}
+#endif
+
+/* Computes the coupling coefficients blcc for constraints b0 to b1
+ * from the constraint directions r and the mass factors blmf,
+ * both blmf and blcc are in the interleaved block layout.
+ */
+static void lincs_calc_blcc(const struct gmx_lincsdata *lincsd,
+                            int b0, int b1,
+                            const real *blmf, real **r, real *blcc)
+{
+    const int      *sblnr  = lincsd->sblnr;
+    const int      *sblbnb = lincsd->sblbnb;
+    int             bs, n;
+#ifdef LINCS_SIMD
+    real            buf_array[(DIM + 1)*LINCS_SIMD_WIDTH], *buf;
+    gmx_simd_real_t rx_S, ry_S, rz_S, ip_S;
+
+    buf = gmx_simd_align_r(buf_array);
+
+    for (bs = b0; bs < b1; bs += LINCS_SIMD_WIDTH)
+    {
+        int bl = bs/LINCS_SIMD_WIDTH;
+
+        rx_S = gmx_simd_load_r(r[XX] + bs);
+        ry_S = gmx_simd_load_r(r[YY] + bs);
+        rz_S = gmx_simd_load_r(r[ZZ] + bs);
+        for (n = sblnr[bl]*LINCS_SIMD_WIDTH; n < sblnr[bl+1]*LINCS_SIMD_WIDTH; n += LINCS_SIMD_WIDTH)
+        {
+            gather_lincs_r(r[XX], sblbnb + n, buf + XX*LINCS_SIMD_WIDTH);
+            gather_lincs_r(r[YY], sblbnb + n, buf + YY*LINCS_SIMD_WIDTH);
+            gather_lincs_r(r[ZZ], sblbnb + n, buf + ZZ*LINCS_SIMD_WIDTH);
+            ip_S = gmx_simd_iprod_r(rx_S, ry_S, rz_S,
+                                    gmx_simd_load_r(buf + XX*LINCS_SIMD_WIDTH),
+                                    gmx_simd_load_r(buf + YY*LINCS_SIMD_WIDTH),
+                                    gmx_simd_load_r(buf + ZZ*LINCS_SIMD_WIDTH));
+            gmx_simd_store_r(blcc + n, gmx_simd_mul_r(gmx_simd_load_r(blmf + n), ip_S));
+        }
+    }
+#else
+    for (bs = b0; bs < b1; bs++)
+    {
+        int k;
+
+        for (n = sblnr[bs]; n < sblnr[bs+1]; n++)
+        {
+            k       = sblbnb[n];
+            blcc[n] = blmf[n]*(r[XX][bs]*r[XX][k] +
+                               r[YY][bs]*r[YY][k] +
+                               r[ZZ][bs]*r[ZZ][k]);
+        } /* 6 nr flops */
+    }
+#endif
+}
+
 /* Do a set of nrec LINCS matrix multiplications.
  * This function will return with up to date thread-local
  * constraint data, without an OpenMP barrier.
@@ -139,11 +239,19 @@ static void lincs_matrix_expand(const struct gmx_lincsdata *lincsd,
                                 const real *blcc,
                                 real *rhs1, real *rhs2, real *sol)
 {
-    int        nrec, rec, b, j, n, nr0, nr1;
+    int        nrec, rec, b, j, k, n, nr0, nr1;
     real       mvb, *swap;
     int        ntriangle, tb, bits;
-    const int *blnr     = lincsd->blnr, *blbnb = lincsd->blbnb;
+    const int *blnr     = lincsd->blnr;
+    const int *sblnr    = lincsd->sblnr, *sblbnb = lincsd->sblbnb;
     const int *triangle = lincsd->triangle, *tri_bits = lincsd->tri_bits;
+#ifdef LINCS_SIMD
+    int             bs;
+    real            buf_array[2*LINCS_SIMD_WIDTH], *buf;
+    gmx_simd_real_t mvb_S;
+
+    buf = gmx_simd_align_r(buf_array);
+#endif
 
     ntriangle = lincsd->ntriangle;
     nrec      = lincsd->nOrder;
@@ -151,17 +259,34 @@ static void lincs_matrix_expand(const struct gmx_lincsdata *lincsd,
     for (rec = 0; rec < nrec; rec++)
     {
 #pragma omp barrier
+#ifdef LINCS_SIMD
+        for (bs = b0; bs < b1; bs += LINCS_SIMD_WIDTH)
+        {
+            int bl = bs/LINCS_SIMD_WIDTH;
+
+            mvb_S = gmx_simd_setzero_r();
+            for (n = sblnr[bl]*LINCS_SIMD_WIDTH; n < sblnr[bl+1]*LINCS_SIMD_WIDTH; n += LINCS_SIMD_WIDTH)
+            {
+                gather_lincs_r(rhs1, sblbnb + n, buf);
+                mvb_S = gmx_simd_fmadd_r(gmx_simd_load_r(blcc + n),
+                                         gmx_simd_load_r(buf), mvb_S);
+            }
+            gmx_simd_store_r(rhs2 + bs, mvb_S);
+            gmx_simd_store_r(sol + bs, gmx_simd_add_r(gmx_simd_load_r(sol + bs), mvb_S));
+        }
+#else
         for (b = b0; b < b1; b++)
         {
             mvb = 0;
-            for (n = blnr[b]; n < blnr[b+1]; n++)
+            for (n = sblnr[b]; n < sblnr[b+1]; n++)
             {
-                j   = blbnb[n];
+                j   = sblbnb[n];
                 mvb = mvb + blcc[n]*rhs1[j];
             }
             rhs2[b] = mvb;
             sol[b]  = sol[b] + mvb;
         }
+#endif
         swap = rhs1;
         rhs1 = rhs2;
         rhs2 = swap;
@@ -196,13 +321,15 @@ static void lincs_matrix_expand(const struct gmx_lincsdata *lincsd,
                     b    = triangle[tb];
                     bits = tri_bits[tb];
                     mvb  = 0;
-                    nr0  = blnr[b];
-                    nr1  = blnr[b+1];
-                    for (n = nr0; n < nr1; n++)
+                    /* The couplings of b are strided in the block layout */
+                    nr0  = sblnr[b/LINCS_SIMD_WIDTH]*LINCS_SIMD_WIDTH + b % LINCS_SIMD_WIDTH;
+                    nr1  = blnr[b+1] - blnr[b];
+                    for (k = 0; k < nr1; k++)
                     {
-                        if (bits & (1<<(n-nr0)))
+                        if (bits & (1<<k))
                         {
-                            j   = blbnb[n];
+                            n   = nr0 + k*LINCS_SIMD_WIDTH;
+                            j   = sblbnb[n];
                             mvb = mvb + blcc[n]*rhs1[j];
                         }
                     }
@@ -224,7 +351,7 @@ static void lincs_matrix_expand(const struct gmx_lincsdata *lincsd,
 
 static void lincs_update_atoms_noind(int ncons, const int *bla,
                                      real prefac,
-                                     const real *fac, rvec *r,
+                                     const real *fac, real **r,
                                      const real *invmass,
                                      rvec *x)
 {
@@ -240,9 +367,9 @@ static void lincs_update_atoms_noind(int ncons, const int *bla,
             mvb      = prefac*fac[b];
             im1      = invmass[i];
             im2      = invmass[j];
-            tmp0     = r[b][0]*mvb;
-            tmp1     = r[b][1]*mvb;
-            tmp2     = r[b][2]*mvb;
+            tmp0     = r[XX][b]*mvb;
+            tmp1     = r[YY][b]*mvb;
+            tmp2     = r[ZZ][b]*mvb;
             x[i][0] -= tmp0*im1;
             x[i][1] -= tmp1*im1;
             x[i][2] -= tmp2*im1;
@@ -258,9 +385,9 @@ static void lincs_update_atoms_noind(int ncons, const int *bla,
             i        = bla[2*b];
             j        = bla[2*b+1];
             mvb      = prefac*fac[b];
-            tmp0     = r[b][0]*mvb;
-            tmp1     = r[b][1]*mvb;
-            tmp2     = r[b][2]*mvb;
+            tmp0     = r[XX][b]*mvb;
+            tmp1     = r[YY][b]*mvb;
+            tmp2     = r[ZZ][b]*mvb;
             x[i][0] -= tmp0;
             x[i][1] -= tmp1;
             x[i][2] -= tmp2;
@@ -273,7 +400,7 @@ static void lincs_update_atoms_noind(int ncons, const int *bla,
 
 static void lincs_update_atoms_ind(int ncons, const int *ind, const int *bla,
                                    real prefac,
-                                   const real *fac, rvec *r,
+                                   const real *fac, real **r,
                                    const real *invmass,
                                    rvec *x)
 {
@@ -290,9 +417,9 @@ static void lincs_update_atoms_ind(int ncons, const int *ind, const int *bla,
             mvb      = prefac*fac[b];
             im1      = invmass[i];
             im2      = invmass[j];
-            tmp0     = r[b][0]*mvb;
-            tmp1     = r[b][1]*mvb;
-            tmp2     = r[b][2]*mvb;
+            tmp0     = r[XX][b]*mvb;
+            tmp1     = r[YY][b]*mvb;
+            tmp2     = r[ZZ][b]*mvb;
             x[i][0] -= tmp0*im1;
             x[i][1] -= tmp1*im1;
             x[i][2] -= tmp2*im1;
@@ -309,9 +436,9 @@ static void lincs_update_atoms_ind(int ncons, const int *ind, const int *bla,
             i        = bla[2*b];
             j        = bla[2*b+1];
             mvb      = prefac*fac[b];
-            tmp0     = r[b][0]*mvb;
-            tmp1     = r[b][1]*mvb;
-            tmp2     = r[b][2]*mvb;
+            tmp0     = r[XX][b]*mvb;
+            tmp1     = r[YY][b]*mvb;
+            tmp2     = r[ZZ][b]*mvb;
             x[i][0] -= tmp0;
             x[i][1] -= tmp1;
             x[i][2] -= tmp2;
@@ -324,7 +451,7 @@ static void lincs_update_atoms_ind(int ncons, const int *ind, const int *bla,
 
 static void lincs_update_atoms(struct gmx_lincsdata *li, int th,
                                real prefac,
-                               const real *fac, rvec *r,
+                               const real *fac, real **r,
                                const real *invmass,
                                rvec *x)
 {
@@ -365,78 +492,72 @@ static void do_lincsp(rvec *x, rvec *f, rvec *fp, t_pbc *pbc,
                       int econq, real *dvdlambda,
                       gmx_bool bCalcVir, tensor rmdf)
 {
-    int      b0, b1, b, i, j, k, n;
-    real     tmp0, tmp1, tmp2, im1, im2, mvb, rlen, len, wfac, lam;
-    rvec     dx;
-    int     *bla, *blnr, *blbnb;
-    rvec    *r;
+    int      b0, b1, b1_block, b, i, j;
+    real     tmp1, mvb;
+    rvec     dx, rb;
+    int     *bla;
+    real   **r;
     real    *blc, *blmf, *blcc, *rhs1, *rhs2, *sol;
 
-    b0 = lincsd->th[th].b0;
-    b1 = lincsd->th[th].b1;
+    b0       = lincsd->th[th].b0;
+    b1       = lincsd->th[th].b1;
+    b1_block = lincs_block_end(b1);
 
     bla    = lincsd->bla;
-    r      = lincsd->tmpv;
-    blnr   = lincsd->blnr;
-    blbnb  = lincsd->blbnb;
+    r      = lincsd->tmpr;
     if (econq != econqForce)
     {
         /* Use mass-weighted parameters */
         blc  = lincsd->blc;
-        blmf = lincsd->blmf;
+        blmf = lincsd->sblmf;
     }
     else
     {
         /* Use non mass-weighted parameters */
         blc  = lincsd->blc1;
-        blmf = lincsd->blmf1;
+        blmf = lincsd->sblmf1;
     }
     blcc   = lincsd->tmpncc;
     rhs1   = lincsd->tmp1;
     rhs2   = lincsd->tmp2;
     sol    = lincsd->tmp3;
 
-    /* Compute normalized i-j vectors */
-    if (pbc)
+    /* Compute normalized i-j vectors, including the padding
+     * constraints, which are used in the block-wise coupling loops.
+     */
+    for (b = b0; b < b1_block; b++)
     {
-        for (b = b0; b < b1; b++)
+        if (pbc)
         {
             pbc_dx_aiuc(pbc, x[bla[2*b]], x[bla[2*b+1]], dx);
-            unitv(dx, r[b]);
         }
-    }
-    else
-    {
-        for (b = b0; b < b1; b++)
+        else
         {
             rvec_sub(x[bla[2*b]], x[bla[2*b+1]], dx);
-            unitv(dx, r[b]);
-        } /* 16 ncons flops */
-    }
+        }
+        unitv(dx, rb);
+        r[XX][b] = rb[XX];
+        r[YY][b] = rb[YY];
+        r[ZZ][b] = rb[ZZ];
+    } /* 16 ncons flops */
 
 #pragma omp barrier
-    for (b = b0; b < b1; b++)
+    lincs_calc_blcc(lincsd, b0, b1_block, blmf, r, blcc);
+
+    for (b = b0; b < b1_block; b++)
     {
-        tmp0 = r[b][0];
-        tmp1 = r[b][1];
-        tmp2 = r[b][2];
-        i    = bla[2*b];
-        j    = bla[2*b+1];
-        for (n = blnr[b]; n < blnr[b+1]; n++)
-        {
-            k       = blbnb[n];
-            blcc[n] = blmf[n]*(tmp0*r[k][0] + tmp1*r[k][1] + tmp2*r[k][2]);
-        } /* 6 nr flops */
-        mvb = blc[b]*(tmp0*(f[i][0] - f[j][0]) +
-                      tmp1*(f[i][1] - f[j][1]) +
-                      tmp2*(f[i][2] - f[j][2]));
+        i   = bla[2*b];
+        j   = bla[2*b+1];
+        mvb = blc[b]*(r[XX][b]*(f[i][0] - f[j][0]) +
+                      r[YY][b]*(f[i][1] - f[j][1]) +
+                      r[ZZ][b]*(f[i][2] - f[j][2]));
         rhs1[b] = mvb;
         sol[b]  = mvb;
         /* 7 flops */
     }
     /* Together: 23*ncons + 6*nrtot flops */
 
-    lincs_matrix_expand(lincsd, b0, b1, blcc, rhs1, rhs2, sol);
+    lincs_matrix_expand(lincsd, b0, b1_block, blcc, rhs1, rhs2, sol);
     /* nrec*(ncons+2*nrtot) flops */
 
     if (econq == econqDeriv_FlexCon)
@@ -487,16 +608,194 @@ static void do_lincsp(rvec *x, rvec *f, rvec *fp, t_pbc *pbc,
             mvb = lincsd->bllen[b]*sol[b];
             for (i = 0; i < DIM; i++)
             {
-                tmp1 = mvb*r[b][i];
+                tmp1 = mvb*r[i][b];
                 for (j = 0; j < DIM; j++)
                 {
-                    rmdf[i][j] += tmp1*r[b][j];
+                    rmdf[i][j] += tmp1*r[j][b];
                 }
             }
         } /* 23 ncons flops */
     }
 }
 
+#ifdef LINCS_SIMD
+/* Gathers the pbc corrected i-j vectors of x for the block of
+ * constraints starting at bs into buf, stored per dimension.
+ */
+static gmx_inline void gather_lincs_dx(const int *bla, int bs,
+                                       const rvec *x, const t_pbc *pbc,
+                                       real *buf)
+{
+    int  i, d;
+    rvec dx;
+
+    for (i = 0; i < LINCS_SIMD_WIDTH; i++)
+    {
+        if (pbc)
+        {
+            pbc_dx_aiuc(pbc, x[bla[2*(bs + i)]], x[bla[2*(bs + i) + 1]], dx);
+        }
+        else
+        {
+            rvec_sub(x[bla[2*(bs + i)]], x[bla[2*(bs + i) + 1]], dx);
+        }
+        for (d = 0; d < DIM; d++)
+        {
+            buf[d*LINCS_SIMD_WIDTH + i] = dx[d];
+        }
+    }
+}
+
+/* Calculates the constraint directions r and the right hand side
+ * rhs and solution sol of the matrix equation for blocks b0 to b1.
+ */
+static void calc_dr_x_xp_simd(int b0, int b1, const int *bla,
+                              const rvec *x, const rvec *xp,
+                              const real *bllen, const real *blc,
+                              const t_pbc *pbc,
+                              real **r, real *rhs, real *sol)
+{
+    real            buf_array[(2*DIM + 1)*LINCS_SIMD_WIDTH], *buf;
+    int             bs;
+    gmx_simd_real_t rx_S, ry_S, rz_S, rlen_S, ip_S, mvb_S;
+
+    buf = gmx_simd_align_r(buf_array);
+
+    for (bs = b0; bs < b1; bs += LINCS_SIMD_WIDTH)
+    {
+        gather_lincs_dx(bla, bs, x, pbc, buf);
+        gather_lincs_dx(bla, bs, xp, pbc, buf + DIM*LINCS_SIMD_WIDTH);
+
+        rx_S   = gmx_simd_load_r(buf + XX*LINCS_SIMD_WIDTH);
+        ry_S   = gmx_simd_load_r(buf + YY*LINCS_SIMD_WIDTH);
+        rz_S   = gmx_simd_load_r(buf + ZZ*LINCS_SIMD_WIDTH);
+        rlen_S = gmx_simd_invsqrt_r(gmx_simd_norm2_r(rx_S, ry_S, rz_S));
+        rx_S   = gmx_simd_mul_r(rx_S, rlen_S);
+        ry_S   = gmx_simd_mul_r(ry_S, rlen_S);
+        rz_S   = gmx_simd_mul_r(rz_S, rlen_S);
+        gmx_simd_store_r(r[XX] + bs, rx_S);
+        gmx_simd_store_r(r[YY] + bs, ry_S);
+        gmx_simd_store_r(r[ZZ] + bs, rz_S);
+
+        ip_S   = gmx_simd_iprod_r(rx_S, ry_S, rz_S,
+                                  gmx_simd_load_r(buf + (DIM + XX)*LINCS_SIMD_WIDTH),
+                                  gmx_simd_load_r(buf + (DIM + YY)*LINCS_SIMD_WIDTH),
+                                  gmx_simd_load_r(buf + (DIM + ZZ)*LINCS_SIMD_WIDTH));
+        mvb_S  = gmx_simd_mul_r(gmx_simd_load_r(blc + bs),
+                                gmx_simd_sub_r(ip_S, gmx_simd_load_r(bllen + bs)));
+        gmx_simd_store_r(rhs + bs, mvb_S);
+        gmx_simd_store_r(sol + bs, mvb_S);
+    }
+}
+
+/* Determines the rhs and sol for the rotational correction of
+ * blocks b0 to b1 from the updated coordinates xp.
+ * Sets *warn when a constraint rotated more than allowed by wfac.
+ */
+static void calc_dist_iter_simd(int b0, int b1, const int *bla,
+                                const rvec *xp,
+                                const real *bllen, const real *blc,
+                                const t_pbc *pbc, real wfac,
+                                int nc, const int *nlocat,
+                                real *rhs, real *sol, int *warn)
+{
+    real            buf_array[(DIM + 1)*LINCS_SIMD_WIDTH], *buf;
+    int             bs, i;
+    gmx_simd_real_t zero_S, one_S, wfac_S, len_S, len2_S, dlen2_S, lc_S, mvb_S;
+    gmx_simd_bool_t warn_B, pos_B;
+
+    buf = gmx_simd_align_r(buf_array);
+
+    zero_S = gmx_simd_setzero_r();
+    one_S  = gmx_simd_set1_r(1.0);
+    wfac_S = gmx_simd_set1_r(wfac);
+
+    for (bs = b0; bs < b1; bs += LINCS_SIMD_WIDTH)
+    {
+        gather_lincs_dx(bla, bs, xp, pbc, buf);
+
+        len_S   = gmx_simd_load_r(bllen + bs);
+        len2_S  = gmx_simd_mul_r(len_S, len_S);
+        dlen2_S = gmx_simd_fmsub_r(gmx_simd_set1_r(2.0), len2_S,
+                                   gmx_simd_norm2_r(gmx_simd_load_r(buf + XX*LINCS_SIMD_WIDTH),
+                                                    gmx_simd_load_r(buf + YY*LINCS_SIMD_WIDTH),
+                                                    gmx_simd_load_r(buf + ZZ*LINCS_SIMD_WIDTH)));
+
+        warn_B  = gmx_simd_cmplt_r(dlen2_S, gmx_simd_mul_r(wfac_S, len2_S));
+        if (gmx_simd_anytrue_b(warn_B))
+        {
+            /* Check the lanes, the padding constraints always end up here */
+            gmx_simd_store_r(buf, gmx_simd_blendzero_r(one_S, warn_B));
+            for (i = 0; i < LINCS_SIMD_WIDTH; i++)
+            {
+                if (buf[i] != 0 && bs + i < nc &&
+                    (nlocat == NULL || nlocat[bs + i]))
+                {
+                    *warn = bs + i;
+                }
+            }
+        }
+
+        /* lc = sqrt(dlen2) when dlen2 > 0, 0 otherwise */
+        pos_B   = gmx_simd_cmplt_r(zero_S, dlen2_S);
+        dlen2_S = gmx_simd_blendv_r(one_S, dlen2_S, pos_B);
+        lc_S    = gmx_simd_blendzero_r(gmx_simd_mul_r(dlen2_S, gmx_simd_invsqrt_r(dlen2_S)), pos_B);
+        mvb_S   = gmx_simd_mul_r(gmx_simd_load_r(blc + bs), gmx_simd_sub_r(len_S, lc_S));
+        gmx_simd_store_r(rhs + bs, mvb_S);
+        gmx_simd_store_r(sol + bs, mvb_S);
+    }
+}
+
+/* Adds the constraint virial of blocks b0 to b1 to vir_r_m_dr */
+static void do_lincs_virial_simd(int b0, int b1,
+                                 const real *bllen, const real *mlambda,
+                                 real **r, tensor vir_r_m_dr)
+{
+    int             bs, i, j;
+    real            vir;
+    gmx_simd_real_t r_S[DIM], mvb_S, tmp_S, vir_S[DIM][DIM];
+
+    for (i = 0; i < DIM; i++)
+    {
+        for (j = i; j < DIM; j++)
+        {
+            vir_S[i][j] = gmx_simd_setzero_r();
+        }
+    }
+
+    for (bs = b0; bs < b1; bs += LINCS_SIMD_WIDTH)
+    {
+        mvb_S = gmx_simd_mul_r(gmx_simd_load_r(bllen + bs), gmx_simd_load_r(mlambda + bs));
+        for (i = 0; i < DIM; i++)
+        {
+            r_S[i] = gmx_simd_load_r(r[i] + bs);
+        }
+        for (i = 0; i < DIM; i++)
+        {
+            tmp_S = gmx_simd_mul_r(mvb_S, r_S[i]);
+            for (j = i; j < DIM; j++)
+            {
+                vir_S[i][j] = gmx_simd_fmadd_r(tmp_S, r_S[j], vir_S[i][j]);
+            }
+        }
+    }
+
+    /* The virial is symmetric */
+    for (i = 0; i < DIM; i++)
+    {
+        for (j = i; j < DIM; j++)
+        {
+            vir               = gmx_simd_reduce_r(vir_S[i][j]);
+            vir_r_m_dr[i][j] += vir;
+            if (j > i)
+            {
+                vir_r_m_dr[j][i] += vir;
+            }
+        }
+    }
+}
+#endif /* LINCS_SIMD */
+
 static void do_lincs(rvec *x, rvec *xp, matrix box, t_pbc *pbc,
                      struct gmx_lincsdata *lincsd, int th,
                      real *invmass,
@@ -506,23 +805,20 @@ static void do_lincs(rvec *x, rvec *xp, matrix box, t_pbc *pbc,
                      real invdt, rvec *v,
                      gmx_bool bCalcVir, tensor vir_r_m_dr)
 {
-    int      b0, b1, b, i, j, k, n, iter;
-    real     tmp0, tmp1, tmp2, im1, im2, mvb, rlen, len, len2, dlen2, wfac;
-    rvec     dx;
-    int     *bla, *blnr, *blbnb;
-    rvec    *r;
-    real    *blc, *blmf, *bllen, *blcc, *rhs1, *rhs2, *sol, *blc_sol, *mlambda;
+    int      b0, b1, b1_block, b, i, j, iter;
+    real     tmp0, tmp1, mvb, wfac;
+    int     *bla;
+    real   **r;
+    real    *blc, *bllen, *blcc, *rhs1, *rhs2, *sol, *blc_sol, *mlambda;
     int     *nlocat;
 
-    b0 = lincsd->th[th].b0;
-    b1 = lincsd->th[th].b1;
+    b0       = lincsd->th[th].b0;
+    b1       = lincsd->th[th].b1;
+    b1_block = lincs_block_end(b1);
 
     bla     = lincsd->bla;
-    r       = lincsd->tmpv;
-    blnr    = lincsd->blnr;
-    blbnb   = lincsd->blbnb;
+    r       = lincsd->tmpr;
     blc     = lincsd->blc;
-    blmf    = lincsd->blmf;
     bllen   = lincsd->bllen;
     blcc    = lincsd->tmpncc;
     rhs1    = lincsd->tmp1;
@@ -540,71 +836,48 @@ static void do_lincs(rvec *x, rvec *xp, matrix box, t_pbc *pbc,
         nlocat = NULL;
     }
 
-    if (pbc)
+    /* Compute normalized i-j vectors and the right hand side.
+     * We also process the padding constraints up to b1_block,
+     * these have zero blc and bllen and therefore zero rhs.
+     */
+#ifdef LINCS_SIMD
+    calc_dr_x_xp_simd(b0, b1_block, bla, (const rvec *)x, (const rvec *)xp,
+                      bllen, blc, pbc, r, rhs1, sol);
+#else
+    for (b = b0; b < b1_block; b++)
     {
-        /* Compute normalized i-j vectors */
-        for (b = b0; b < b1; b++)
+        rvec dx, dxp;
+
+        if (pbc)
         {
             pbc_dx_aiuc(pbc, x[bla[2*b]], x[bla[2*b+1]], dx);
-            unitv(dx, r[b]);
+            pbc_dx_aiuc(pbc, xp[bla[2*b]], xp[bla[2*b+1]], dxp);
         }
-#pragma omp barrier
-        for (b = b0; b < b1; b++)
+        else
         {
-            for (n = blnr[b]; n < blnr[b+1]; n++)
-            {
-                blcc[n] = blmf[n]*iprod(r[b], r[blbnb[n]]);
-            }
-            pbc_dx_aiuc(pbc, xp[bla[2*b]], xp[bla[2*b+1]], dx);
-            mvb     = blc[b]*(iprod(r[b], dx) - bllen[b]);
-            rhs1[b] = mvb;
-            sol[b]  = mvb;
+            rvec_sub(x[bla[2*b]], x[bla[2*b+1]], dx);
+            rvec_sub(xp[bla[2*b]], xp[bla[2*b+1]], dxp);
         }
-    }
-    else
-    {
-        /* Compute normalized i-j vectors */
-        for (b = b0; b < b1; b++)
-        {
-            i       = bla[2*b];
-            j       = bla[2*b+1];
-            tmp0    = x[i][0] - x[j][0];
-            tmp1    = x[i][1] - x[j][1];
-            tmp2    = x[i][2] - x[j][2];
-            rlen    = gmx_invsqrt(tmp0*tmp0+tmp1*tmp1+tmp2*tmp2);
-            r[b][0] = rlen*tmp0;
-            r[b][1] = rlen*tmp1;
-            r[b][2] = rlen*tmp2;
-        } /* 16 ncons flops */
+        tmp0     = gmx_invsqrt(norm2(dx));
+        r[XX][b] = tmp0*dx[XX];
+        r[YY][b] = tmp0*dx[YY];
+        r[ZZ][b] = tmp0*dx[ZZ];
+        mvb      = blc[b]*(r[XX][b]*dxp[XX] +
+                           r[YY][b]*dxp[YY] +
+                           r[ZZ][b]*dxp[ZZ] - bllen[b]);
+        rhs1[b]  = mvb;
+        sol[b]   = mvb;
+    } /* 26 ncons flops */
+#endif
 
 #pragma omp barrier
-        for (b = b0; b < b1; b++)
-        {
-            tmp0 = r[b][0];
-            tmp1 = r[b][1];
-            tmp2 = r[b][2];
-            len  = bllen[b];
-            i    = bla[2*b];
-            j    = bla[2*b+1];
-            for (n = blnr[b]; n < blnr[b+1]; n++)
-            {
-                k       = blbnb[n];
-                blcc[n] = blmf[n]*(tmp0*r[k][0] + tmp1*r[k][1] + tmp2*r[k][2]);
-            } /* 6 nr flops */
-            mvb = blc[b]*(tmp0*(xp[i][0] - xp[j][0]) +
-                          tmp1*(xp[i][1] - xp[j][1]) +
-                          tmp2*(xp[i][2] - xp[j][2]) - len);
-            rhs1[b] = mvb;
-            sol[b]  = mvb;
-            /* 10 flops */
-        }
-        /* Together: 26*ncons + 6*nrtot flops */
-    }
+    lincs_calc_blcc(lincsd, b0, b1_block, lincsd->sblmf, r, blcc);
+    /* Together: 26*ncons + 6*nrtot flops */
 
-    lincs_matrix_expand(lincsd, b0, b1, blcc, rhs1, rhs2, sol);
+    lincs_matrix_expand(lincsd, b0, b1_block, blcc, rhs1, rhs2, sol);
     /* nrec*(ncons+2*nrtot) flops */
 
-    for (b = b0; b < b1; b++)
+    for (b = b0; b < b1_block; b++)
     {
         mlambda[b] = blc[b]*sol[b];
     }
@@ -635,8 +908,15 @@ static void do_lincs(rvec *x, rvec *xp, matrix box, t_pbc *pbc,
         }
 
 #pragma omp barrier
-        for (b = b0; b < b1; b++)
+#ifdef LINCS_SIMD
+        calc_dist_iter_simd(b0, b1_block, bla, (const rvec *)xp, bllen, blc,
+                            pbc, wfac, lincsd->nc, nlocat, rhs1, sol, warn);
+#else
+        for (b = b0; b < b1_block; b++)
         {
+            real len, len2, dlen2;
+            rvec dx;
+
             len = bllen[b];
             if (pbc)
             {
@@ -648,7 +928,8 @@ static void do_lincs(rvec *x, rvec *xp, matrix box, t_pbc *pbc,
             }
             len2  = len*len;
             dlen2 = 2*len2 - norm2(dx);
-            if (dlen2 < wfac*len2 && (nlocat == NULL || nlocat[b]))
+            if (dlen2 < wfac*len2 && b < lincsd->nc &&
+                (nlocat == NULL || nlocat[b]))
             {
                 *warn = b;
             }
@@ -663,11 +944,12 @@ static void do_lincs(rvec *x, rvec *xp, matrix box, t_pbc *pbc,
             rhs1[b] = mvb;
             sol[b]  = mvb;
         } /* 20*ncons flops */
+#endif
 
-        lincs_matrix_expand(lincsd, b0, b1, blcc, rhs1, rhs2, sol);
+        lincs_matrix_expand(lincsd, b0, b1_block, blcc, rhs1, rhs2, sol);
         /* nrec*(ncons+2*nrtot) flops */
 
-        for (b = b0; b < b1; b++)
+        for (b = b0; b < b1_block; b++)
         {
             mvb         = blc[b]*sol[b];
             blc_sol[b]  = mvb;
@@ -701,18 +983,22 @@ static void do_lincs(rvec *x, rvec *xp, matrix box, t_pbc *pbc,
     if (bCalcVir)
     {
         /* Constraint virial */
+#ifdef LINCS_SIMD
+        do_lincs_virial_simd(b0, b1_block, bllen, mlambda, r, vir_r_m_dr);
+#else
         for (b = b0; b < b1; b++)
         {
-            tmp0 = -bllen[b]*mlambda[b];
+            tmp0 = bllen[b]*mlambda[b];
             for (i = 0; i < DIM; i++)
             {
-                tmp1 = tmp0*r[b][i];
+                tmp1 = tmp0*r[i][b];
                 for (j = 0; j < DIM; j++)
                 {
-                    vir_r_m_dr[i][j] -= tmp1*r[b][j];
+                    vir_r_m_dr[i][j] += tmp1*r[j][b];
                 }
             }
         } /* 22 ncons flops */
+#endif
     }
 
     /* Total:
@@ -726,6 +1012,83 @@ static void do_lincs(rvec *x, rvec *xp, matrix box, t_pbc *pbc,
      */
 }
 
+/* Copies the coupling data csr, with the layout of blbnb, to blocks,
+ * with the interleaved block layout of sblbnb, padding with zeros.
+ */
+static void lincs_copy_to_blocks(const struct gmx_lincsdata *li,
+                                 const real *csr, real *blocks)
+{
+    int bl, i, b, row, nrow;
+
+    for (bl = 0; bl < li->nblock; bl++)
+    {
+        nrow = li->sblnr[bl+1] - li->sblnr[bl];
+        for (i = 0; i < LINCS_SIMD_WIDTH; i++)
+        {
+            b = bl*LINCS_SIMD_WIDTH + i;
+            for (row = 0; row < nrow; row++)
+            {
+                blocks[(li->sblnr[bl] + row)*LINCS_SIMD_WIDTH + i] =
+                    (row < li->blnr[b+1] - li->blnr[b] ? csr[li->blnr[b] + row] : 0);
+            }
+        }
+    }
+}
+
+/* Sets up the constraint couplings in the block layout.
+ * For each block of LINCS_SIMD_WIDTH constraints the couplings are
+ * stored row-wise, with each row containing one coupling for each
+ * constraint in the block. Rows are padded with couplings of
+ * a constraint to itself, which get zero coefficients.
+ * This allows for processing a block of constraints with SIMD.
+ */
+static void set_lincs_block_couplings(struct gmx_lincsdata *li)
+{
+    int bl, i, b, row, nrow;
+
+    li->nblock = lincs_block_end(li->nc)/LINCS_SIMD_WIDTH;
+    srenew(li->sblnr, li->nblock + 1);
+
+    li->sblnr[0] = 0;
+    for (bl = 0; bl < li->nblock; bl++)
+    {
+        nrow = 0;
+        for (i = 0; i < LINCS_SIMD_WIDTH; i++)
+        {
+            b    = bl*LINCS_SIMD_WIDTH + i;
+            nrow = max(nrow, li->blnr[b+1] - li->blnr[b]);
+        }
+        li->sblnr[bl+1] = li->sblnr[bl] + nrow;
+    }
+
+    li->sncc = li->sblnr[li->nblock]*LINCS_SIMD_WIDTH;
+    if (li->sncc > li->sncc_alloc)
+    {
+        li->sncc_alloc = over_alloc_small(li->sncc);
+        srenew(li->sblbnb, li->sncc_alloc);
+        sfree_aligned(li->sblmf);
+        sfree_aligned(li->sblmf1);
+        sfree_aligned(li->tmpncc);
+        snew_aligned(li->sblmf, li->sncc_alloc, LINCS_ALIGNMENT);
+        snew_aligned(li->sblmf1, li->sncc_alloc, LINCS_ALIGNMENT);
+        snew_aligned(li->tmpncc, li->sncc_alloc, LINCS_ALIGNMENT);
+    }
+
+    for (bl = 0; bl < li->nblock; bl++)
+    {
+        nrow = li->sblnr[bl+1] - li->sblnr[bl];
+        for (i = 0; i < LINCS_SIMD_WIDTH; i++)
+        {
+            b = bl*LINCS_SIMD_WIDTH + i;
+            for (row = 0; row < nrow; row++)
+            {
+                li->sblbnb[(li->sblnr[bl] + row)*LINCS_SIMD_WIDTH + i] =
+                    (row < li->blnr[b+1] - li->blnr[b] ? li->blbnb[li->blnr[b] + row] : b);
+            }
+        }
+    }
+}
+
 void set_lincs_matrix(struct gmx_lincsdata *li, real *invmass, real lambda)
 {
     int        i, a1, a2, n, k, sign, center;
@@ -739,6 +1102,12 @@ void set_lincs_matrix(struct gmx_lincsdata *li, real *invmass, real lambda)
         li->blc[i]  = gmx_invsqrt(invmass[a1] + invmass[a2]);
         li->blc1[i] = invsqrt2;
     }
+    /* The padding constraints should not have any effect */
+    for (i = li->nc; i < lincs_block_end(li->nc); i++)
+    {
+        li->blc[i]  = 0;
+        li->blc1[i] = 0;
+    }
 
     /* Construct the coupling coefficient matrix blmf */
     li->ntriangle    = 0;
@@ -801,6 +1170,9 @@ void set_lincs_matrix(struct gmx_lincsdata *li, real *invmass, real lambda)
         }
     }
 
+    lincs_copy_to_blocks(li, li->blmf, li->sblmf);
+    lincs_copy_to_blocks(li, li->blmf1, li->sblmf1);
+
     if (debug)
     {
         fprintf(debug, "Of the %d constraints %d participate in triangles\n",
@@ -1013,6 +1385,13 @@ gmx_lincsdata_t init_lincs(FILE *fplog, gmx_mtop_t *mtop,
     return li;
 }
 
+/* Reallocates an aligned array, the contents are not preserved */
+static void lincs_realloc_aligned(real **ptr, int n)
+{
+    sfree_aligned(*ptr);
+    snew_aligned(*ptr, n, LINCS_ALIGNMENT);
+}
+
 /* Sets up the work division over the threads */
 static void lincs_thread_setup(struct gmx_lincsdata *li, int natoms)
 {
@@ -1041,9 +1420,9 @@ static void lincs_thread_setup(struct gmx_lincsdata *li, int natoms)
 
         li_th = &li->th[th];
 
-        /* The constraints are divided equally over the threads */
-        li_th->b0 = (li->nc* th   )/li->nth;
-        li_th->b1 = (li->nc*(th+1))/li->nth;
+        /* The constraint blocks are divided equally over the threads */
+        li_th->b0 = min(li->nc, ((li->nblock* th   )/li->nth)*LINCS_SIMD_WIDTH);
+        li_th->b1 = min(li->nc, ((li->nblock*(th+1))/li->nth)*LINCS_SIMD_WIDTH);
 
         if (th < sizeof(*atf)*8)
         {
@@ -1208,22 +1587,28 @@ void set_lincs(t_idef *idef, t_mdatoms *md,
                          &nflexcon);
 
 
-    if (idef->il[F_CONSTR].nr/3 > li->nc_alloc || li->nc_alloc == 0)
+    if (lincs_block_end(idef->il[F_CONSTR].nr/3) > li->nc_alloc || li->nc_alloc == 0)
     {
-        li->nc_alloc = over_alloc_dd(idef->il[F_CONSTR].nr/3);
+        /* The arrays that are accessed with SIMD loads need to be aligned,
+         * their contents do not need to be preserved, as we set all below.
+         */
+        li->nc_alloc = lincs_block_end(over_alloc_dd(idef->il[F_CONSTR].nr/3));
         srenew(li->bllen0, li->nc_alloc);
         srenew(li->ddist, li->nc_alloc);
         srenew(li->bla, 2*li->nc_alloc);
-        srenew(li->blc, li->nc_alloc);
-        srenew(li->blc1, li->nc_alloc);
         srenew(li->blnr, li->nc_alloc+1);
-        srenew(li->bllen, li->nc_alloc);
-        srenew(li->tmpv, li->nc_alloc);
-        srenew(li->tmp1, li->nc_alloc);
-        srenew(li->tmp2, li->nc_alloc);
-        srenew(li->tmp3, li->nc_alloc);
-        srenew(li->tmp4, li->nc_alloc);
-        srenew(li->mlambda, li->nc_alloc);
+        lincs_realloc_aligned(&li->blc, li->nc_alloc);
+        lincs_realloc_aligned(&li->blc1, li->nc_alloc);
+        lincs_realloc_aligned(&li->bllen, li->nc_alloc);
+        for (i = 0; i < DIM; i++)
+        {
+            lincs_realloc_aligned(&li->tmpr[i], li->nc_alloc);
+        }
+        lincs_realloc_aligned(&li->tmp1, li->nc_alloc);
+        lincs_realloc_aligned(&li->tmp2, li->nc_alloc);
+        lincs_realloc_aligned(&li->tmp3, li->nc_alloc);
+        lincs_realloc_aligned(&li->tmp4, li->nc_alloc);
+        lincs_realloc_aligned(&li->mlambda, li->nc_alloc);
         if (li->ncg_triangle > 0)
         {
             /* This is allocating too much, but it is difficult to improve */
@@ -1306,6 +1691,20 @@ void set_lincs(t_idef *idef, t_mdatoms *md,
      */
     li->nc = con;
 
+    /* Add padding constraints up to a whole number of blocks,
+     * these use the atoms of the last constraint, so we can safely
+     * compute distances, but have zero length and no couplings.
+     */
+    for (con = li->nc; con < lincs_block_end(li->nc); con++)
+    {
+        li->bllen0[con]  = 0;
+        li->ddist[con]   = 0;
+        li->bllen[con]   = 0;
+        li->bla[2*con]   = li->bla[2*(li->nc - 1)];
+        li->bla[2*con+1] = li->bla[2*(li->nc - 1) + 1];
+        li->blnr[con+1]  = nconnect;
+    }
+
     li->ncc = li->blnr[con];
     if (cr->dd == NULL)
     {
@@ -1319,9 +1718,10 @@ void set_lincs(t_idef *idef, t_mdatoms *md,
         li->ncc_alloc = ncc_alloc;
         srenew(li->blmf, li->ncc_alloc);
         srenew(li->blmf1, li->ncc_alloc);
-        srenew(li->tmpncc, li->ncc_alloc);
     }
 
+    set_lincs_block_couplings(li);
+
     if (debug)
     {
         fprintf(debug, "Number of constraints is %d, couplings %d\n",
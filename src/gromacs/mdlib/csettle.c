@@ -46,6 +46,9 @@
 #include "gromacs/math/vec.h"
 #include "gromacs/pbcutil/ishift.h"
 #include "gromacs/pbcutil/pbc.h"
+#include "gromacs/simd/simd.h"
+#include "gromacs/simd/simd_math.h"
+#include "gromacs/simd/vector_operations.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/smalloc.h"
 
@@ -311,14 +314,14 @@ void settle_proj(gmx_settledata_t settled, int econq,
 }
 
 
-void csettle(gmx_settledata_t settled,
-             int nsettle, t_iatom iatoms[],
-             const t_pbc *pbc,
-             real b4[], real after[],
-             real invdt, real *v, int CalcVirAtomEnd,
-             tensor vir_r_m_dr,
-             int *error,
-             t_vetavars *vetavar)
+void csettle_ref(gmx_settledata_t settled,
+                 int nsettle, t_iatom iatoms[],
+                 const t_pbc *pbc,
+                 real b4[], real after[],
+                 real invdt, real *v, int CalcVirAtomEnd,
+                 tensor vir_r_m_dr,
+                 int *error,
+                 t_vetavars *vetavar)
 {
     /* ***************************************************************** */
     /*                                                               ** */
@@ -645,3 +648,387 @@ void csettle(gmx_settledata_t settled,
 #endif
     }
 }
+
+#ifdef GMX_SIMD_HAVE_REAL
+
+/* Indices into the aligned buffer used by the SIMD SETTLE to gather
+ * and scatter the data of GMX_SIMD_REAL_WIDTH water molecules.
+ * Each index is followed by its DIM components, except for sbVir and sbOK.
+ */
+enum {
+    sbB0   = 0,           /* H2 - O before the update            */
+    sbC0   = sbB0  + DIM, /* H3 - O before the update            */
+    sbOH2  = sbC0  + DIM, /* H2 - O after the update             */
+    sbOH3  = sbOH2 + DIM, /* H3 - O after the update             */
+    sbA1   = sbOH3 + DIM, /* O after the update                  */
+    sbB1   = sbA1  + DIM, /* H2 after the update, pbc shifted    */
+    sbC1   = sbB1  + DIM, /* H3 after the update, pbc shifted    */
+    sbB4O  = sbC1  + DIM, /* O before the update, for the virial */
+    sbVir  = sbB4O + DIM, /* 1 when the virial is computed       */
+    sbA3   = sbVir + 1,   /* Settled O                           */
+    sbB3   = sbA3  + DIM, /* Settled H2                          */
+    sbC3   = sbB3  + DIM, /* Settled H3                          */
+    sbDA   = sbC3  + DIM, /* Displacement of O                   */
+    sbDB   = sbDA  + DIM, /* Displacement of H2                  */
+    sbDC   = sbDB  + DIM, /* Displacement of H3                  */
+    sbOK   = sbDC  + DIM, /* 1 when SETTLE succeeded             */
+    sbNR   = sbOK  + 1
+};
+
+/* SIMD version of the SETTLE loop of csettle_ref, processes nsettle
+ * settles, nsettle should be a multiple of GMX_SIMD_REAL_WIDTH.
+ * The atom data is gathered into and scattered from an aligned buffer
+ * with plain C, since that also handles the pbc, all the SETTLE math
+ * is done with SIMD for GMX_SIMD_REAL_WIDTH water molecules at once.
+ */
+static void csettle_simd(const settleparam_t *p,
+                         int nsettle, const t_iatom iatoms[],
+                         const t_pbc *pbc,
+                         const real b4[], real after[],
+                         real invdts, real mOs, real mHs,
+                         real *v, int calcvir_atom_end,
+                         tensor vir_r_m_dr,
+                         int *error)
+{
+#define W GMX_SIMD_REAL_WIDTH
+    real            buf_array[(sbNR + 1)*W], *buf;
+    real            sh_hw2[DIM][W], sh_hw3[DIM][W];
+    int             i, s, d, d2, ow1, hw2, hw3, is;
+    rvec            dx;
+    gmx_bool        bAnyVir;
+
+    gmx_simd_real_t zero_S, one_S, minus_wh_S, ra_S, rb_S, rc_S, irc2_S, invra_S;
+    gmx_simd_real_t mO_S, mH_S;
+    gmx_simd_real_t b0_S[DIM], c0_S[DIM], doh2_S[DIM], doh3_S[DIM];
+    gmx_simd_real_t a1_S[DIM], b1_S[DIM], c1_S[DIM], com_S[DIM];
+    gmx_simd_real_t aksz_S[DIM], aksx_S[DIM], aksy_S[DIM];
+    gmx_simd_real_t axlng_S, aylng_S, azlng_S;
+    gmx_simd_real_t trns1_S[DIM], trns2_S[DIM], trns3_S[DIM];
+    gmx_simd_real_t xb0d_S, yb0d_S, xc0d_S, yc0d_S, za1d_S;
+    gmx_simd_real_t xb1d_S, yb1d_S, zb1d_S, xc1d_S, yc1d_S, zc1d_S;
+    gmx_simd_real_t sinphi_S, cosphi_S, sinpsi_S, cospsi_S, tmp_S, tmp2_S;
+    gmx_simd_real_t ya2d_S, xb2d_S, yb2d_S, yc2d_S, t1_S, t2_S;
+    gmx_simd_real_t alpa_S, beta_S, gama_S, al2be2_S, sinthe_S, costhe_S;
+    gmx_simd_real_t xa3d_S, ya3d_S, xb3d_S, yb3d_S, xc3d_S, yc3d_S;
+    gmx_simd_real_t a3_S, b3_S, c3_S, da_S, db_S, dc_S, virfac_S;
+    gmx_simd_real_t mda_S[DIM], mdb_S[DIM], mdc_S[DIM], b4o_S;
+    gmx_simd_real_t vir_S[DIM][DIM];
+    gmx_simd_bool_t ok_B;
+
+    buf = gmx_simd_align_r(buf_array);
+
+    zero_S     = gmx_simd_setzero_r();
+    one_S      = gmx_simd_set1_r(1.0);
+    minus_wh_S = gmx_simd_set1_r(-p->wh);
+    ra_S       = gmx_simd_set1_r(p->ra);
+    rb_S       = gmx_simd_set1_r(p->rb);
+    rc_S       = gmx_simd_set1_r(p->rc);
+    irc2_S     = gmx_simd_set1_r(p->irc2);
+    invra_S    = gmx_simd_set1_r(gmx_invsqrt(p->ra*p->ra));
+    mO_S       = gmx_simd_set1_r(mOs);
+    mH_S       = gmx_simd_set1_r(mHs);
+
+    for (d = 0; d < DIM; d++)
+    {
+        for (d2 = 0; d2 < DIM; d2++)
+        {
+            vir_S[d][d2] = zero_S;
+        }
+    }
+    bAnyVir = FALSE;
+
+    for (i = 0; i < nsettle; i += W)
+    {
+        /* Gather the coordinates, this is where we deal with pbc */
+        for (s = 0; s < W; s++)
+        {
+            ow1 = iatoms[(i + s)*4 + 1]*3;
+            hw2 = iatoms[(i + s)*4 + 2]*3;
+            hw3 = iatoms[(i + s)*4 + 3]*3;
+
+            for (d = 0; d < DIM; d++)
+            {
+                if (pbc == NULL)
+                {
+                    buf[(sbB0  + d)*W + s] = b4[hw2 + d] - b4[ow1 + d];
+                    buf[(sbC0  + d)*W + s] = b4[hw3 + d] - b4[ow1 + d];
+                    buf[(sbOH2 + d)*W + s] = after[hw2 + d] - after[ow1 + d];
+                    buf[(sbOH3 + d)*W + s] = after[hw3 + d] - after[ow1 + d];
+                }
+                buf[(sbA1  + d)*W + s] = after[ow1 + d];
+                buf[(sbB4O + d)*W + s] = b4[ow1 + d];
+                sh_hw2[d][s]           = 0;
+                sh_hw3[d][s]           = 0;
+            }
+            if (pbc != NULL)
+            {
+                pbc_dx_aiuc(pbc, b4+hw2, b4+ow1, dx);
+                for (d = 0; d < DIM; d++)
+                {
+                    buf[(sbB0 + d)*W + s] = dx[d];
+                }
+                pbc_dx_aiuc(pbc, b4+hw3, b4+ow1, dx);
+                for (d = 0; d < DIM; d++)
+                {
+                    buf[(sbC0 + d)*W + s] = dx[d];
+                }
+                is = pbc_dx_aiuc(pbc, after+hw2, after+ow1, dx);
+                for (d = 0; d < DIM; d++)
+                {
+                    buf[(sbOH2 + d)*W + s] = dx[d];
+                    if (is != CENTRAL)
+                    {
+                        sh_hw2[d][s] = after[hw2 + d] - (after[ow1 + d] + dx[d]);
+                    }
+                }
+                is = pbc_dx_aiuc(pbc, after+hw3, after+ow1, dx);
+                for (d = 0; d < DIM; d++)
+                {
+                    buf[(sbOH3 + d)*W + s] = dx[d];
+                    if (is != CENTRAL)
+                    {
+                        sh_hw3[d][s] = after[hw3 + d] - (after[ow1 + d] + dx[d]);
+                    }
+                }
+            }
+            for (d = 0; d < DIM; d++)
+            {
+                buf[(sbB1 + d)*W + s] = after[hw2 + d] - sh_hw2[d][s];
+                buf[(sbC1 + d)*W + s] = after[hw3 + d] - sh_hw3[d][s];
+            }
+            buf[sbVir*W + s] = (ow1 < calcvir_atom_end ? 1 : 0);
+            bAnyVir          = (bAnyVir || ow1 < calcvir_atom_end);
+        }
+
+        for (d = 0; d < DIM; d++)
+        {
+            b0_S[d]   = gmx_simd_load_r(buf + (sbB0  + d)*W);
+            c0_S[d]   = gmx_simd_load_r(buf + (sbC0  + d)*W);
+            doh2_S[d] = gmx_simd_load_r(buf + (sbOH2 + d)*W);
+            doh3_S[d] = gmx_simd_load_r(buf + (sbOH3 + d)*W);
+        }
+
+        /* Compute the center of mass from the O-H distances,
+         * see the comment in csettle_ref.
+         */
+        for (d = 0; d < DIM; d++)
+        {
+            a1_S[d]  = gmx_simd_mul_r(gmx_simd_add_r(doh2_S[d], doh3_S[d]), minus_wh_S);
+            com_S[d] = gmx_simd_sub_r(gmx_simd_load_r(buf + (sbA1 + d)*W), a1_S[d]);
+            b1_S[d]  = gmx_simd_sub_r(gmx_simd_load_r(buf + (sbB1 + d)*W), com_S[d]);
+            c1_S[d]  = gmx_simd_sub_r(gmx_simd_load_r(buf + (sbC1 + d)*W), com_S[d]);
+        }
+
+        gmx_simd_cprod_r(b0_S[XX], b0_S[YY], b0_S[ZZ],
+                         c0_S[XX], c0_S[YY], c0_S[ZZ],
+                         &aksz_S[XX], &aksz_S[YY], &aksz_S[ZZ]);
+        gmx_simd_cprod_r(a1_S[XX], a1_S[YY], a1_S[ZZ],
+                         aksz_S[XX], aksz_S[YY], aksz_S[ZZ],
+                         &aksx_S[XX], &aksx_S[YY], &aksx_S[ZZ]);
+        gmx_simd_cprod_r(aksz_S[XX], aksz_S[YY], aksz_S[ZZ],
+                         aksx_S[XX], aksx_S[YY], aksx_S[ZZ],
+                         &aksy_S[XX], &aksy_S[YY], &aksy_S[ZZ]);
+
+        axlng_S = gmx_simd_invsqrt_r(gmx_simd_norm2_r(aksx_S[XX], aksx_S[YY], aksx_S[ZZ]));
+        aylng_S = gmx_simd_invsqrt_r(gmx_simd_norm2_r(aksy_S[XX], aksy_S[YY], aksy_S[ZZ]));
+        azlng_S = gmx_simd_invsqrt_r(gmx_simd_norm2_r(aksz_S[XX], aksz_S[YY], aksz_S[ZZ]));
+
+        for (d = 0; d < DIM; d++)
+        {
+            trns1_S[d] = gmx_simd_mul_r(aksx_S[d], axlng_S);
+            trns2_S[d] = gmx_simd_mul_r(aksy_S[d], aylng_S);
+            trns3_S[d] = gmx_simd_mul_r(aksz_S[d], azlng_S);
+        }
+
+        xb0d_S = gmx_simd_iprod_r(trns1_S[XX], trns1_S[YY], trns1_S[ZZ], b0_S[XX], b0_S[YY], b0_S[ZZ]);
+        yb0d_S = gmx_simd_iprod_r(trns2_S[XX], trns2_S[YY], trns2_S[ZZ], b0_S[XX], b0_S[YY], b0_S[ZZ]);
+        xc0d_S = gmx_simd_iprod_r(trns1_S[XX], trns1_S[YY], trns1_S[ZZ], c0_S[XX], c0_S[YY], c0_S[ZZ]);
+        yc0d_S = gmx_simd_iprod_r(trns2_S[XX], trns2_S[YY], trns2_S[ZZ], c0_S[XX], c0_S[YY], c0_S[ZZ]);
+        za1d_S = gmx_simd_iprod_r(trns3_S[XX], trns3_S[YY], trns3_S[ZZ], a1_S[XX], a1_S[YY], a1_S[ZZ]);
+        xb1d_S = gmx_simd_iprod_r(trns1_S[XX], trns1_S[YY], trns1_S[ZZ], b1_S[XX], b1_S[YY], b1_S[ZZ]);
+        yb1d_S = gmx_simd_iprod_r(trns2_S[XX], trns2_S[YY], trns2_S[ZZ], b1_S[XX], b1_S[YY], b1_S[ZZ]);
+        zb1d_S = gmx_simd_iprod_r(trns3_S[XX], trns3_S[YY], trns3_S[ZZ], b1_S[XX], b1_S[YY], b1_S[ZZ]);
+        xc1d_S = gmx_simd_iprod_r(trns1_S[XX], trns1_S[YY], trns1_S[ZZ], c1_S[XX], c1_S[YY], c1_S[ZZ]);
+        yc1d_S = gmx_simd_iprod_r(trns2_S[XX], trns2_S[YY], trns2_S[ZZ], c1_S[XX], c1_S[YY], c1_S[ZZ]);
+        zc1d_S = gmx_simd_iprod_r(trns3_S[XX], trns3_S[YY], trns3_S[ZZ], c1_S[XX], c1_S[YY], c1_S[ZZ]);
+
+        /* Molecules that can not be settled are flagged in ok_B,
+         * we continue with harmless values for those to avoid
+         * floating-point exceptions.
+         */
+        sinphi_S = gmx_simd_mul_r(za1d_S, invra_S);
+        tmp_S    = gmx_simd_fnmadd_r(sinphi_S, sinphi_S, one_S);
+        ok_B     = gmx_simd_cmplt_r(zero_S, tmp_S);
+        tmp_S    = gmx_simd_blendv_r(one_S, tmp_S, ok_B);
+        tmp2_S   = gmx_simd_invsqrt_r(tmp_S);
+        cosphi_S = gmx_simd_mul_r(tmp_S, tmp2_S);
+        sinpsi_S = gmx_simd_mul_r(gmx_simd_mul_r(gmx_simd_sub_r(zb1d_S, zc1d_S), irc2_S), tmp2_S);
+        tmp2_S   = gmx_simd_fnmadd_r(sinpsi_S, sinpsi_S, one_S);
+        ok_B     = gmx_simd_and_b(ok_B, gmx_simd_cmplt_r(zero_S, tmp2_S));
+        tmp2_S   = gmx_simd_blendv_r(one_S, tmp2_S, ok_B);
+        cospsi_S = gmx_simd_mul_r(tmp2_S, gmx_simd_invsqrt_r(tmp2_S));
+        sinphi_S = gmx_simd_blendzero_r(sinphi_S, ok_B);
+        cosphi_S = gmx_simd_blendv_r(one_S, cosphi_S, ok_B);
+        sinpsi_S = gmx_simd_blendzero_r(sinpsi_S, ok_B);
+
+        ya2d_S   = gmx_simd_mul_r(ra_S, cosphi_S);
+        xb2d_S   = gmx_simd_sub_r(zero_S, gmx_simd_mul_r(rc_S, cospsi_S));
+        t1_S     = gmx_simd_sub_r(zero_S, gmx_simd_mul_r(rb_S, cosphi_S));
+        t2_S     = gmx_simd_mul_r(gmx_simd_mul_r(rc_S, sinpsi_S), sinphi_S);
+        yb2d_S   = gmx_simd_sub_r(t1_S, t2_S);
+        yc2d_S   = gmx_simd_add_r(t1_S, t2_S);
+
+        /*     --- Step3  al,be,ga            --- */
+        alpa_S   = gmx_simd_fmadd_r(xb2d_S, gmx_simd_sub_r(xb0d_S, xc0d_S),
+                                    gmx_simd_fmadd_r(yb0d_S, yb2d_S, gmx_simd_mul_r(yc0d_S, yc2d_S)));
+        beta_S   = gmx_simd_fmadd_r(xb2d_S, gmx_simd_sub_r(yc0d_S, yb0d_S),
+                                    gmx_simd_fmadd_r(xb0d_S, yb2d_S, gmx_simd_mul_r(xc0d_S, yc2d_S)));
+        gama_S   = gmx_simd_sub_r(gmx_simd_fmsub_r(xb0d_S, yb1d_S, gmx_simd_mul_r(xb1d_S, yb0d_S)),
+                                  gmx_simd_fmsub_r(xc1d_S, yc0d_S, gmx_simd_mul_r(xc0d_S, yc1d_S)));
+        al2be2_S = gmx_simd_fmadd_r(alpa_S, alpa_S, gmx_simd_mul_r(beta_S, beta_S));
+        tmp2_S   = gmx_simd_fnmadd_r(gama_S, gama_S, al2be2_S);
+        tmp2_S   = gmx_simd_blendv_r(one_S, tmp2_S, ok_B);
+        sinthe_S = gmx_simd_mul_r(gmx_simd_fmsub_r(alpa_S, gama_S,
+                                                   gmx_simd_mul_r(beta_S, gmx_simd_mul_r(tmp2_S, gmx_simd_invsqrt_r(tmp2_S)))),
+                                  gmx_simd_inv_r(al2be2_S));
+
+        /*  --- Step4  A3' --- */
+        tmp2_S   = gmx_simd_fnmadd_r(sinthe_S, sinthe_S, one_S);
+        costhe_S = gmx_simd_mul_r(tmp2_S, gmx_simd_invsqrt_r(tmp2_S));
+        xa3d_S   = gmx_simd_sub_r(zero_S, gmx_simd_mul_r(ya2d_S, sinthe_S));
+        ya3d_S   = gmx_simd_mul_r(ya2d_S, costhe_S);
+        xb3d_S   = gmx_simd_fmsub_r(xb2d_S, costhe_S, gmx_simd_mul_r(yb2d_S, sinthe_S));
+        yb3d_S   = gmx_simd_fmadd_r(xb2d_S, sinthe_S, gmx_simd_mul_r(yb2d_S, costhe_S));
+        xc3d_S   = gmx_simd_sub_r(zero_S, gmx_simd_fmadd_r(xb2d_S, costhe_S, gmx_simd_mul_r(yc2d_S, sinthe_S)));
+        yc3d_S   = gmx_simd_fmsub_r(yc2d_S, costhe_S, gmx_simd_mul_r(xb2d_S, sinthe_S));
+
+        /*    --- Step5  A3 --- */
+        virfac_S = gmx_simd_blendzero_r(gmx_simd_load_r(buf + sbVir*W), ok_B);
+        for (d = 0; d < DIM; d++)
+        {
+            a3_S = gmx_simd_fmadd_r(trns1_S[d], xa3d_S,
+                                    gmx_simd_fmadd_r(trns2_S[d], ya3d_S,
+                                                     gmx_simd_mul_r(trns3_S[d], za1d_S)));
+            b3_S = gmx_simd_fmadd_r(trns1_S[d], xb3d_S,
+                                    gmx_simd_fmadd_r(trns2_S[d], yb3d_S,
+                                                     gmx_simd_mul_r(trns3_S[d], zb1d_S)));
+            c3_S = gmx_simd_fmadd_r(trns1_S[d], xc3d_S,
+                                    gmx_simd_fmadd_r(trns2_S[d], yc3d_S,
+                                                     gmx_simd_mul_r(trns3_S[d], zc1d_S)));
+            gmx_simd_store_r(buf + (sbA3 + d)*W, gmx_simd_add_r(com_S[d], a3_S));
+            gmx_simd_store_r(buf + (sbB3 + d)*W, gmx_simd_add_r(com_S[d], b3_S));
+            gmx_simd_store_r(buf + (sbC3 + d)*W, gmx_simd_add_r(com_S[d], c3_S));
+
+            da_S = gmx_simd_sub_r(a3_S, a1_S[d]);
+            db_S = gmx_simd_sub_r(b3_S, b1_S[d]);
+            dc_S = gmx_simd_sub_r(c3_S, c1_S[d]);
+            gmx_simd_store_r(buf + (sbDA + d)*W, da_S);
+            gmx_simd_store_r(buf + (sbDB + d)*W, db_S);
+            gmx_simd_store_r(buf + (sbDC + d)*W, dc_S);
+
+            mda_S[d] = gmx_simd_mul_r(gmx_simd_mul_r(mO_S, virfac_S), da_S);
+            mdb_S[d] = gmx_simd_mul_r(gmx_simd_mul_r(mH_S, virfac_S), db_S);
+            mdc_S[d] = gmx_simd_mul_r(gmx_simd_mul_r(mH_S, virfac_S), dc_S);
+        }
+        gmx_simd_store_r(buf + sbOK*W, gmx_simd_blendzero_r(one_S, ok_B));
+
+        for (d = 0; d < DIM; d++)
+        {
+            b4o_S = gmx_simd_load_r(buf + (sbB4O + d)*W);
+            for (d2 = 0; d2 < DIM; d2++)
+            {
+                vir_S[d][d2] =
+                    gmx_simd_fnmadd_r(b4o_S, mda_S[d2],
+                                      gmx_simd_fnmadd_r(gmx_simd_add_r(b4o_S, b0_S[d]), mdb_S[d2],
+                                                        gmx_simd_fnmadd_r(gmx_simd_add_r(b4o_S, c0_S[d]), mdc_S[d2],
+                                                                          vir_S[d][d2])));
+            }
+        }
+
+        /* Scatter the settled coordinates and velocity corrections */
+        for (s = 0; s < W; s++)
+        {
+            if (buf[sbOK*W + s] == 0)
+            {
+                *error = i + s;
+                continue;
+            }
+
+            ow1 = iatoms[(i + s)*4 + 1]*3;
+            hw2 = iatoms[(i + s)*4 + 2]*3;
+            hw3 = iatoms[(i + s)*4 + 3]*3;
+
+            for (d = 0; d < DIM; d++)
+            {
+                after[ow1 + d] = buf[(sbA3 + d)*W + s];
+                after[hw2 + d] = buf[(sbB3 + d)*W + s] + sh_hw2[d][s];
+                after[hw3 + d] = buf[(sbC3 + d)*W + s] + sh_hw3[d][s];
+            }
+            if (v != NULL)
+            {
+                for (d = 0; d < DIM; d++)
+                {
+                    v[ow1 + d] += buf[(sbDA + d)*W + s]*invdts;
+                    v[hw2 + d] += buf[(sbDB + d)*W + s]*invdts;
+                    v[hw3 + d] += buf[(sbDC + d)*W + s]*invdts;
+                }
+            }
+        }
+    }
+
+    if (bAnyVir)
+    {
+        for (d = 0; d < DIM; d++)
+        {
+            for (d2 = 0; d2 < DIM; d2++)
+            {
+                vir_r_m_dr[d][d2] += gmx_simd_reduce_r(vir_S[d][d2]);
+            }
+        }
+    }
+#undef W
+}
+
+#endif /* GMX_SIMD_HAVE_REAL */
+
+void csettle(gmx_settledata_t settled,
+             int nsettle, t_iatom iatoms[],
+             const t_pbc *pbc,
+             real b4[], real after[],
+             real invdt, real *v, int CalcVirAtomEnd,
+             tensor vir_r_m_dr,
+             int *error,
+             t_vetavars *vetavar)
+{
+    int nsettle_simd, error_rem;
+
+    *error       = -1;
+    nsettle_simd = 0;
+
+#ifdef GMX_SIMD_HAVE_REAL
+    /* Settle all full SIMD blocks with SIMD, the remainder below */
+    nsettle_simd = (nsettle/GMX_SIMD_REAL_WIDTH)*GMX_SIMD_REAL_WIDTH;
+
+    if (nsettle_simd > 0)
+    {
+        settleparam_t *p = &settled->massw;
+
+        csettle_simd(p, nsettle_simd, iatoms, pbc, b4, after,
+                     invdt/vetavar->rscale,
+                     p->mO/vetavar->rvscale, p->mH/vetavar->rvscale,
+                     v, CalcVirAtomEnd*DIM, vir_r_m_dr, error);
+    }
+#endif
+
+    if (nsettle_simd < nsettle)
+    {
+        csettle_ref(settled, nsettle - nsettle_simd,
+                    iatoms + nsettle_simd*(1 + NRAL(F_SETTLE)),
+                    pbc, b4, after, invdt, v, CalcVirAtomEnd, vir_r_m_dr,
+                    &error_rem, vetavar);
+        if (error_rem >= 0)
+        {
+            *error = nsettle_simd + error_rem;
+        }
+    }
+}
@@ -1539,10 +1539,10 @@ void dd_collect_vec(gmx_domdec_t *dd,
 }
 
 
-void dd_collect_state(gmx_domdec_t *dd,
-                      t_state *state_local, t_state *state)
+void dd_collect_state_nonatomic(gmx_domdec_t *dd,
+                                t_state *state_local, t_state *state)
 {
-    int est, i, j, nh;
+    int i, j, nh;
 
     nh = state->nhchainlength;
 
@@ -1579,6 +1579,15 @@ void dd_collect_state(gmx_domdec_t *dd,
             }
         }
     }
+}
+
+void dd_collect_state(gmx_domdec_t *dd,
+                      t_state *state_local, t_state *state)
+{
+    int est;
+
+    dd_collect_state_nonatomic(dd, state_local, state);
+
     for (est = 0; est < estNR; est++)
     {
         if (EST_DISTR(est) && (state_local->flags & (1<<est)))
@@ -9758,7 +9767,8 @@ void dd_partition_system(FILE                *fplog,
     if (vsite != NULL)
     {
         /* Now we have updated mdatoms, we can do the last vsite bookkeeping */
-        split_vsites_over_threads(top_local->idef.il, mdatoms, FALSE, vsite);
+        split_vsites_over_threads(top_local->idef.il, top_local->idef.iparams,
+                                  mdatoms, FALSE, vsite);
     }
 
     if (shellfc)
@@ -71,6 +71,7 @@
 #include "gmx_detect_hardware.h"
 #include "inputrec.h"
 
+#include "gromacs/gmxpreprocess/calc_verletbuf.h"
 #include "gromacs/pbcutil/ishift.h"
 #include "gromacs/pbcutil/pbc.h"
 #include "gromacs/utility/fatalerror.h"
@@ -1705,6 +1706,8 @@ const char *lookup_nbnxn_kernel_name(int kernel_type)
             returnvalue = "AVX_256";
 #elif defined GMX_SIMD_X86_AVX2_256
             returnvalue = "AVX2_256";
+#elif defined GMX_SIMD_X86_AVX_512
+            returnvalue = "AVX_512";
 #else
             returnvalue = "SIMD";
 #endif
@@ -1983,6 +1986,8 @@ init_interaction_const(FILE                       *fp,
 
     ic->rlist           = fr->rlist;
     ic->rlistlong       = fr->rlistlong;
+    /* Without dynamic pruning the inner list is the list */
+    ic->rlist_inner     = fr->rlist;
 
     /* Lennard-Jones */
     ic->vdwtype         = fr->vdwtype;
@@ -2302,6 +2307,79 @@ static void init_nb_verlet(FILE                *fp,
     }
 }
 
+/* The default interval, in steps, for dynamic pruning of the pair list */
+static const int nbnxn_dynamic_prune_nstlist = 4;
+
+/* Sets up dynamic pruning of the pair list when this is supported and
+ * useful: with the Verlet buffer tolerance set, CPU kernels only and
+ * nstlist at least twice the pruning interval. The inner cut-off is
+ * determined with the same buffer estimate as rlist.
+ */
+static void init_nb_verlet_pruning(FILE                *fp,
+                                   nonbonded_verlet_t  *nbv,
+                                   interaction_const_t *ic,
+                                   const t_inputrec    *ir,
+                                   const gmx_mtop_t    *mtop,
+                                   matrix               box)
+{
+    char                  *env;
+    int                    i;
+    t_inputrec             ir_prune;
+    verletbuf_list_setup_t ls;
+    real                   rlist_inner;
+
+    nbv->bDynamicPruning = FALSE;
+    nbv->nstlist_prune   = nbnxn_dynamic_prune_nstlist;
+    nbv->step_search     = 0;
+
+    if ((env = getenv("GMX_NSTLIST_DYNAMICPRUNING")) != NULL)
+    {
+        char *end;
+
+        nbv->nstlist_prune = strtol(env, &end, 10);
+        if (!end || (*end != 0) || nbv->nstlist_prune < 0)
+        {
+            gmx_fatal(FARGS, "Invalid value passed in GMX_NSTLIST_DYNAMICPRUNING=%s, non-negative integer required", env);
+        }
+    }
+
+    if (nbv->nstlist_prune == 0 ||
+        ir->nstlist < 2*nbv->nstlist_prune ||
+        !EI_DYNAMICS(ir->eI) ||
+        (EI_MD(ir->eI) && ir->etc == etcNO) ||
+        ir->verletbuf_tol <= 0)
+    {
+        return;
+    }
+    for (i = 0; i < nbv->ngrp; i++)
+    {
+        if (!nbnxn_kernel_pairlist_simple(nbv->grp[i].kernel_type))
+        {
+            return;
+        }
+    }
+
+    ir_prune         = *ir;
+    ir_prune.nstlist = nbv->nstlist_prune;
+    verletbuf_get_list_setup(FALSE, &ls);
+    calc_verlet_buffer_size(mtop, det(box), &ir_prune, -1, &ls, NULL,
+                            &rlist_inner);
+
+    if (rlist_inner >= ic->rlist)
+    {
+        return;
+    }
+
+    nbv->bDynamicPruning = TRUE;
+    ic->rlist_inner      = rlist_inner;
+
+    if (fp != NULL)
+    {
+        fprintf(fp, "Using dynamic pair-list pruning every %d steps, rlist %g, rlist_inner %g\n\n",
+                nbv->nstlist_prune, ic->rlist, ic->rlist_inner);
+    }
+}
+
 void init_forcerec(FILE              *fp,
                    const output_env_t oenv,
                    t_forcerec        *fr,
@@ -3214,6 +3292,11 @@ void init_forcerec(FILE              *fp,
     /* fr->ic is used both by verlet and group kernels (to some extent) now */
     init_interaction_const(fp, cr, &fr->ic, fr, rtab);
 
+    if (fr->cutoff_scheme == ecutsVERLET)
+    {
+        init_nb_verlet_pruning(fp, fr->nbv, fr->ic, ir, mtop, box);
+    }
+
     if (ir->eDispCorr != edispcNO)
     {
         calc_enervirdiff(fp, ir->eDispCorr, fr);
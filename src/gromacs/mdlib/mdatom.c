@@ -153,6 +153,7 @@ void atoms2md(gmx_mtop_t *mtop, t_inputrec *ir,
         }
         srenew(md->massT, md->nalloc);
         srenew(md->invmass, md->nalloc);
+        srenew(md->invmass_dim, md->nalloc);
         srenew(md->chargeA, md->nalloc);
         if (bLJPME)
         {
@@ -359,6 +360,18 @@ void atoms2md(gmx_mtop_t *mtop, t_inputrec *ir,
             }
         }
         md->ptype[i]    = atom->ptype;
+        for (g = 0; g < DIM; g++)
+        {
+            if (atom->ptype == eptVSite || atom->ptype == eptShell ||
+                (md->cFREEZE && opts->nFreeze[md->cFREEZE[i]][g]))
+            {
+                md->invmass_dim[i][g] = 0;
+            }
+            else
+            {
+                md->invmass_dim[i][g] = md->invmass[i];
+            }
+        }
         if (md->cTC)
         {
             md->cTC[i]    = groups->grpnr[egcTC][ag];
@@ -429,7 +442,7 @@ void atoms2md(gmx_mtop_t *mtop, t_inputrec *ir,
 
 void update_mdatoms(t_mdatoms *md, real lambda)
 {
-    int    al, end;
+    int    al, end, d;
     real   L1 = 1.0-lambda;
 
     end = md->nr;
@@ -444,6 +457,13 @@ void update_mdatoms(t_mdatoms *md, real lambda)
                 if (md->invmass[al] > 1.1*ALMOST_ZERO)
                 {
                     md->invmass[al] = 1.0/md->massT[al];
+                    for (d = 0; d < DIM; d++)
+                    {
+                        if (md->invmass_dim[al][d] != 0)
+                        {
+                            md->invmass_dim[al][d] = md->invmass[al];
+                        }
+                    }
                 }
             }
         }
@@ -0,0 +1,206 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <assert.h>
+
+#include "typedefs.h"
+#include "gmx_omp_nthreads.h"
+
+#include "gromacs/utility/fatalerror.h"
+
+#include "nbnxn_kernel_prune.h"
+#include "../nbnxn_consts.h"
+
+/* Returns the index in nbat->x of the x-coordinate of atom a,
+ * *stride_d is set to the index distance between the x, y and z
+ * coordinates of an atom.
+ */
+static gmx_inline int nbat_x_index(const nbnxn_atomdata_t *nbat, int a,
+                                   int *stride_d)
+{
+    switch (nbat->XFormat)
+    {
+        case nbatX4:
+            *stride_d = PACK_X4;
+            return X4_IND_A(a);
+        case nbatX8:
+            *stride_d = PACK_X8;
+            return X8_IND_A(a);
+        default:
+            *stride_d = 1;
+            return a*nbat->xstride;
+    }
+}
+
+void
+nbnxn_kernel_prune_ref(nbnxn_pairlist_t         *nbl,
+                       const nbnxn_atomdata_t   *nbat,
+                       const rvec               *shift_vec,
+                       real                      rlist_inner)
+{
+    const nbnxn_ci_t *ci_outer;
+    const nbnxn_cj_t *cj_outer;
+    const real       *x;
+    real              rlist2;
+    real              xi[NBNXN_CPU_CLUSTER_I_SIZE*DIM];
+    int               na_ci, na_cj;
+    int               n, nci, ncj, ci, cj, ish, cjind;
+    int               i, j, d, ind, stride_d;
+    gmx_bool          bInRange;
+
+    assert(nbl->na_ci <= NBNXN_CPU_CLUSTER_I_SIZE);
+
+    ci_outer = nbl->ci_outer;
+    cj_outer = nbl->cj_outer;
+    x        = nbat->x;
+    na_ci    = nbl->na_ci;
+    na_cj    = nbl->na_cj;
+    rlist2   = rlist_inner*rlist_inner;
+
+    nci = 0;
+    ncj = 0;
+    for (n = 0; n < nbl->nci_outer; n++)
+    {
+        ci  = ci_outer[n].ci;
+        ish = (ci_outer[n].shift & NBNXN_CI_SHIFT);
+
+        for (i = 0; i < na_ci; i++)
+        {
+            ind = nbat_x_index(nbat, ci*na_ci + i, &stride_d);
+            for (d = 0; d < DIM; d++)
+            {
+                xi[i*DIM + d] = x[ind + d*stride_d] + shift_vec[ish][d];
+            }
+        }
+
+        nbl->ci[nci]              = ci_outer[n];
+        nbl->ci[nci].cj_ind_start = ncj;
+
+        for (cjind = ci_outer[n].cj_ind_start; cjind < ci_outer[n].cj_ind_end; cjind++)
+        {
+            cj       = cj_outer[cjind].cj;
+
+            bInRange = FALSE;
+            for (j = 0; j < na_cj && !bInRange; j++)
+            {
+                rvec xj;
+
+                ind = nbat_x_index(nbat, cj*na_cj + j, &stride_d);
+                for (d = 0; d < DIM; d++)
+                {
+                    xj[d] = x[ind + d*stride_d];
+                }
+
+                for (i = 0; i < na_ci; i++)
+                {
+                    real dx, dy, dz;
+
+                    dx = xi[i*DIM + XX] - xj[XX];
+                    dy = xi[i*DIM + YY] - xj[YY];
+                    dz = xi[i*DIM + ZZ] - xj[ZZ];
+
+                    if (dx*dx + dy*dy + dz*dz < rlist2)
+                    {
+                        bInRange = TRUE;
+                    }
+                }
+            }
+
+            if (bInRange)
+            {
+                nbl->cj[ncj++] = cj_outer[cjind];
+            }
+        }
+
+        /* Only keep the i-entry when some j-clusters remain */
+        if (ncj > nbl->ci[nci].cj_ind_start)
+        {
+            nbl->ci[nci].cj_ind_end = ncj;
+            nci++;
+        }
+    }
+
+    nbl->nci = nci;
+    nbl->ncj = ncj;
+}
+
+/*! \brief Function pointer type for the prune kernels */
+typedef void (*p_nbk_prune_func)(nbnxn_pairlist_t         *nbl,
+                                 const nbnxn_atomdata_t   *nbat,
+                                 const rvec               *shift_vec,
+                                 real                      rlist_inner);
+
+void
+nbnxn_kernel_prune(nbnxn_pairlist_set_t     *nbl_list,
+                   const nbnxn_atomdata_t   *nbat,
+                   const rvec               *shift_vec,
+                   real                      rlist_inner,
+                   int                       nb_kernel_type)
+{
+    p_nbk_prune_func   prune_func = NULL;
+    nbnxn_pairlist_t **nbl;
+    int                nb;
+
+    if (!nbl_list->bSimple)
+    {
+        gmx_incons("Dynamic pruning is only supported for simple pair lists");
+    }
+
+    switch (nb_kernel_type)
+    {
+        case nbnxnk4x4_PlainC:
+            prune_func = nbnxn_kernel_prune_ref;
+            break;
+        case nbnxnk4xN_SIMD_4xN:
+            prune_func = nbnxn_kernel_prune_4xn;
+            break;
+        case nbnxnk4xN_SIMD_2xNN:
+            prune_func = nbnxn_kernel_prune_2xnn;
+            break;
+        default:
+            gmx_incons("Invalid nonbonded kernel type passed!");
+    }
+
+    nbl = nbl_list->nbl;
+
+#pragma omp parallel for schedule(static) num_threads(gmx_omp_nthreads_get(emntNonbonded))
+    for (nb = 0; nb < nbl_list->nnbl; nb++)
+    {
+        prune_func(nbl[nb], nbat, shift_vec, rlist_inner);
+    }
+}
@@ -0,0 +1,91 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#ifndef _nbnxn_kernel_prune_h
+#define _nbnxn_kernel_prune_h
+
+#include "typedefs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Dynamic pruning of simple cluster pair lists.
+ *
+ * With dynamic pruning the pair search produces an outer list with
+ * a buffer for nstlist steps, see nbnxn_pairlist_set_outer().
+ * Every nstlist_prune steps the outer list is pruned, using the current
+ * coordinates, to an inner list which only contains the cluster pairs
+ * that have at least one atom pair within rlist_inner.
+ * The inner list is stored in the normal ci and cj arrays of the list,
+ * so the non-bonded kernels do not need to know about pruning.
+ */
+
+/* Plain C prune kernel, works with all coordinate formats */
+void
+nbnxn_kernel_prune_ref(nbnxn_pairlist_t         *nbl,
+                       const nbnxn_atomdata_t   *nbat,
+                       const rvec               *shift_vec,
+                       real                      rlist_inner);
+
+/* SIMD prune kernel for lists for the 4xN SIMD kernels */
+void
+nbnxn_kernel_prune_4xn(nbnxn_pairlist_t         *nbl,
+                       const nbnxn_atomdata_t   *nbat,
+                       const rvec               *shift_vec,
+                       real                      rlist_inner);
+
+/* SIMD prune kernel for lists for the 2xNN SIMD kernels */
+void
+nbnxn_kernel_prune_2xnn(nbnxn_pairlist_t         *nbl,
+                        const nbnxn_atomdata_t   *nbat,
+                        const rvec               *shift_vec,
+                        real                      rlist_inner);
+
+/* Prune all outer lists in nbl_list to inner lists with cut-off
+ * rlist_inner, using the prune kernel matching nb_kernel_type.
+ * The lists are pruned in parallel with OpenMP.
+ */
+void
+nbnxn_kernel_prune(nbnxn_pairlist_set_t     *nbl_list,
+                   const nbnxn_atomdata_t   *nbat,
+                   const rvec               *shift_vec,
+                   real                      rlist_inner,
+                   int                       nb_kernel_type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -67,7 +67,7 @@ prepare_table_load_buffer(const int gmx_unused *array)
 
 #else /* GMX_SIMD_REFERENCE */
 
-#if defined  GMX_TARGET_X86 && !defined __MIC__
+#if defined  GMX_TARGET_X86 && !(defined __MIC__ || defined GMX_SIMD_X86_AVX_512)
 /* Include x86 SSE2 compatible SIMD functions */
 
 /* Set the stride for the lookup of the two LJ parameters from their
@@ -108,7 +108,7 @@ prepare_table_load_buffer(int gmx_unused *array)
 #endif
 #endif /* GMX_DOUBLE */
 
-#else  /* GMX_TARGET_X86 && !__MIC__ */
+#else  /* GMX_TARGET_X86 && !(__MIC__ || GMX_SIMD_X86_AVX_512) */
 
 #if GMX_SIMD_REAL_WIDTH > 4
 /* For width>4 we use unaligned loads. And thus we can use the minimal stride */
@@ -130,7 +130,15 @@ static const int nbfp_stride = GMX_SIMD_REAL_WIDTH;
 #include "nbnxn_kernel_simd_utils_x86_mic.h"
 #endif
 
-#endif /* GMX_TARGET_X86 && !__MIC__ */
+#if defined GMX_SIMD_X86_AVX_512 && !defined __MIC__
+#ifdef GMX_DOUBLE
+#include "nbnxn_kernel_simd_utils_x86_512d.h"
+#else
+#include "nbnxn_kernel_simd_utils_x86_512s.h"
+#endif
+#endif
+
+#endif /* GMX_TARGET_X86 && !(__MIC__ || GMX_SIMD_X86_AVX_512) */
 
 #endif /* GMX_SIMD_REFERENCE */
 
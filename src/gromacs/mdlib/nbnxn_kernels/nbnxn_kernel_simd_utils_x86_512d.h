@@ -0,0 +1,237 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#ifndef _nbnxn_kernel_simd_utils_x86_512d_h_
+#define _nbnxn_kernel_simd_utils_x86_512d_h_
+
+/* This files contains all functions/macros for the SIMD kernels
+ * which have explicit dependencies on the j-cluster size and/or SIMD-width.
+ * The functionality which depends on the j-cluster size is:
+ *   LJ-parameter lookup
+ *   force table lookup
+ *   energy group pair energy storage
+ *
+ * With 8-wide double precision AVX-512 both the 4xN kernels, with a 4x8
+ * cluster setup, and the 2x(N+N) kernels, with a 4x4 cluster setup, are
+ * supported. Table and LJ parameter lookups use the AVX-512F gathers.
+ */
+
+/* Sum the elements within each input register and return the sums */
+static gmx_inline __m256d
+gmx_mm256_transpose_sum4_pd(__m256d in0, __m256d in1,
+                            __m256d in2, __m256d in3)
+{
+    in0 = _mm256_hadd_pd(in0, in1);
+    in2 = _mm256_hadd_pd(in2, in3);
+
+    return _mm256_add_pd(_mm256_permute2f128_pd(in0, in2, 0x20), _mm256_permute2f128_pd(in0, in2, 0x31));
+}
+
+/* Sum the upper and lower 256-bit halves of a */
+static gmx_inline __m256d
+gmx_mm512_sum_halves_pd(__m512d a)
+{
+    return _mm256_add_pd(_mm512_castpd512_pd256(a), _mm512_extractf64x4_pd(a, 0x1));
+}
+
+/* Sum the elements within each input register and return the sums */
+static gmx_inline __m256d
+gmx_mm_transpose_sum4_pr(__m512d in0, __m512d in1,
+                         __m512d in2, __m512d in3)
+{
+    return gmx_mm256_transpose_sum4_pd(gmx_mm512_sum_halves_pd(in0),
+                                       gmx_mm512_sum_halves_pd(in1),
+                                       gmx_mm512_sum_halves_pd(in2),
+                                       gmx_mm512_sum_halves_pd(in3));
+}
+
+#ifdef GMX_NBNXN_SIMD_2XNN
+/* Half-width operations are required for the 2xnn kernels */
+
+/* Half-width SIMD real type */
+#define gmx_mm_hpr  __m256d
+
+/* Half-width SIMD operations */
+/* Load reals at half-width aligned pointer b into half-width SIMD register a */
+#define gmx_load_hpr(a, b)    *(a) = _mm256_load_pd(b)
+/* Set all entries in half-width SIMD register *a to b */
+#define gmx_set1_hpr(a, b)   *(a) = _mm256_set1_pd(b)
+/* To half-width SIMD register b into half width aligned memory a */
+#define gmx_store_hpr(a, b)          _mm256_store_pd(a, b)
+#define gmx_add_hpr                  _mm256_add_pd
+#define gmx_sub_hpr                  _mm256_sub_pd
+
+/* Load one real at b and one real at b+1 into halves of a, respectively */
+static gmx_inline void
+gmx_load1p1_pr(gmx_simd_real_t *a, const real *b)
+{
+    *a = _mm512_insertf64x4(_mm512_set1_pd(b[0]), _mm256_set1_pd(b[1]), 0x1);
+}
+
+/* Load reals at half-width aligned pointer b into two halves of a */
+static gmx_inline void
+gmx_loaddh_pr(gmx_simd_real_t *a, const real *b)
+{
+    *a = _mm512_broadcast_f64x4(_mm256_load_pd(b));
+}
+
+/* Sum over 4 half SIMD registers */
+static gmx_inline __m256d
+gmx_sum4_hpr(__m512d x, __m512d y)
+{
+    return gmx_mm512_sum_halves_pd(_mm512_add_pd(x, y));
+}
+
+static gmx_inline void
+gmx_pr_to_2hpr(gmx_simd_real_t a, gmx_mm_hpr *b, gmx_mm_hpr *c)
+{
+    *b = _mm512_castpd512_pd256(a);
+    *c = _mm512_extractf64x4_pd(a, 0x1);
+}
+
+/* Store half width SIMD registers a and b in full width register *c */
+static gmx_inline void
+gmx_2hpr_to_pr(gmx_mm_hpr a, gmx_mm_hpr b, gmx_simd_real_t *c)
+{
+    *c = _mm512_insertf64x4(_mm512_castpd256_pd512(a), b, 0x1);
+}
+
+/* Sum the elements of halfs of each input register and return the sums */
+static gmx_inline __m256d
+gmx_mm_transpose_sum4h_pr(__m512d in0, __m512d in2)
+{
+    return gmx_mm256_transpose_sum4_pd(_mm512_castpd512_pd256(in0),
+                                       _mm512_extractf64x4_pd(in0, 0x1),
+                                       _mm512_castpd512_pd256(in2),
+                                       _mm512_extractf64x4_pd(in2, 0x1));
+}
+
+#endif /* GMX_NBNXN_SIMD_2XNN */
+
+#if UNROLLJ == 8
+static gmx_inline void
+load_lj_pair_params(const real *nbfp, const int *type, int aj,
+                    __m512d *c6_S, __m512d *c12_S)
+{
+    __m256i idx;
+
+    /* nbfp_stride=2, so we multiply the type indices by 2 with a shift */
+    idx    = _mm256_slli_epi32(_mm256_loadu_si256((const __m256i *)(type + aj)), 1);
+
+    *c6_S  = _mm512_i32gather_pd(idx, nbfp, sizeof(real));
+    *c12_S = _mm512_i32gather_pd(idx, nbfp + 1, sizeof(real));
+}
+#endif
+
+#if UNROLLJ == 4
+/* Load the LJ parameters for 4 j-atoms for two i-atoms, the low half
+ * of the output registers contains the parameters for i-atom type nbfp0,
+ * the high half those for nbfp1.
+ */
+static gmx_inline void
+load_lj_pair_params2(const real *nbfp0, const real *nbfp1,
+                     const int *type, int aj,
+                     __m512d *c6_S, __m512d *c12_S)
+{
+    const __mmask8 mask_lo = 0x0F;
+    const __mmask8 mask_hi = 0xF0;
+    __m128i        idx4;
+    __m256i        idx;
+
+    /* Load the 4 j-types into both halves, nbfp_stride=2 is a shift by 1 */
+    idx4   = _mm_slli_epi32(_mm_loadu_si128((const __m128i *)(type + aj)), 1);
+    idx    = _mm256_inserti128_si256(_mm256_castsi128_si256(idx4), idx4, 0x1);
+
+    *c6_S  = _mm512_mask_i32gather_pd(_mm512_undefined_pd(), mask_lo, idx, nbfp0, sizeof(real));
+    *c6_S  = _mm512_mask_i32gather_pd(*c6_S, mask_hi, idx, nbfp1, sizeof(real));
+    *c12_S = _mm512_mask_i32gather_pd(_mm512_undefined_pd(), mask_lo, idx, nbfp0 + 1, sizeof(real));
+    *c12_S = _mm512_mask_i32gather_pd(*c12_S, mask_hi, idx, nbfp1 + 1, sizeof(real));
+}
+#endif
+
+/* Align a stack-based thread-local working array. The gather based
+ * table loads do not need the array.
+ */
+static gmx_inline int *
+prepare_table_load_buffer(int gmx_unused *array)
+{
+    return NULL;
+}
+
+/* The table loads use gathers on the F table with indices ti and ti+1 */
+static gmx_inline void
+load_table_f(const real *tab_coul_F, gmx_simd_int32_t ti_S, int gmx_unused *ti,
+             __m512d *ctab0_S, __m512d *ctab1_S)
+{
+    *ctab0_S = _mm512_i32gather_pd(ti_S, tab_coul_F, sizeof(real));
+    *ctab1_S = _mm512_i32gather_pd(ti_S, tab_coul_F + 1, sizeof(real));
+    /* The second force table entry should contain the difference */
+    *ctab1_S = _mm512_sub_pd(*ctab1_S, *ctab0_S);
+}
+
+static gmx_inline void
+load_table_f_v(const real *tab_coul_F, const real *tab_coul_V,
+               gmx_simd_int32_t ti_S, int *ti,
+               __m512d *ctab0_S, __m512d *ctab1_S, __m512d *ctabv_S)
+{
+    load_table_f(tab_coul_F, ti_S, ti, ctab0_S, ctab1_S);
+    *ctabv_S = _mm512_i32gather_pd(ti_S, tab_coul_V, sizeof(real));
+}
+
+/* Code for handling loading exclusions and converting them into
+ * interactions. The exclusion filters use the 256-bit dint32 type,
+ * the interaction masks are AVX-512 mask registers.
+ */
+typedef gmx_simd_int32_t gmx_exclfilter;
+static const int filter_stride = GMX_SIMD_INT32_WIDTH/GMX_SIMD_REAL_WIDTH;
+
+static gmx_inline gmx_exclfilter
+gmx_load1_exclfilter(int e)
+{
+    return _mm256_set1_epi32(e);
+}
+
+static gmx_inline gmx_exclfilter
+gmx_load_exclusion_filter(const unsigned *i)
+{
+    return gmx_simd_load_i(i);
+}
+
+static gmx_inline gmx_simd_bool_t
+gmx_checkbitmask_pb(gmx_exclfilter m0, gmx_exclfilter m1)
+{
+    return (__mmask8)_mm512_mask_test_epi32_mask(0xFF, _mm512_castsi256_si512(m0), _mm512_castsi256_si512(m1));
+}
+
+#endif /* _nbnxn_kernel_simd_utils_x86_512d_h_ */
@@ -183,9 +183,10 @@ static void nbs_cycle_print(FILE *fp, const nbnxn_search_t nbs)
     int t;
 
     fprintf(fp, "\n");
-    fprintf(fp, "ns %4d grid %4.1f search %4.1f red.f %5.3f",
+    fprintf(fp, "ns %4d grid %4.1f (%d threads) search %4.1f red.f %5.3f",
             nbs->cc[enbsCCgrid].count,
             Mcyc_av(&nbs->cc[enbsCCgrid]),
+            gmx_omp_nthreads_get(emntPairsearch),
             Mcyc_av(&nbs->cc[enbsCCsearch]),
             Mcyc_av(&nbs->cc[enbsCCreducef]));
 
@@ -952,11 +953,12 @@ static void calc_bounding_box_xxxx_simd4(int na, const float *x,
 
 
 /* Combines pairs of consecutive bounding boxes */
-static void combine_bounding_box_pairs(nbnxn_grid_t *grid, const nbnxn_bb_t *bb)
+static void combine_bounding_box_pairs(nbnxn_grid_t *grid, const nbnxn_bb_t *bb,
+                                       int cxy_start, int cxy_end)
 {
     int    i, j, sc2, nc2, c2;
 
-    for (i = 0; i < grid->ncx*grid->ncy; i++)
+    for (i = cxy_start; i < cxy_end; i++)
     {
         /* Starting bb in a column is expected to be 2-aligned */
         sc2 = grid->cxy_ind[i]>>1;
@@ -1575,6 +1577,47 @@ static void calc_column_indices(nbnxn_grid_t *grid,
     }
 }
 
+/* Returns the first column of the column range for thread, when
+ * distributing the columns over nthread threads such that each thread
+ * gets approximately the same number of cells.
+ */
+static int column_range_start(const nbnxn_grid_t *grid,
+                              int thread, int nthread)
+{
+    int ncxy, target, lo, hi, mid;
+
+    ncxy = grid->ncx*grid->ncy;
+
+    if (thread == 0)
+    {
+        return 0;
+    }
+    if (thread == nthread)
+    {
+        return ncxy;
+    }
+
+    target = grid->cxy_ind[0] + (int)(((gmx_int64_t)thread*grid->nc)/nthread);
+
+    /* Binary search for the first column starting at or after target */
+    lo = 0;
+    hi = ncxy;
+    while (lo < hi)
+    {
+        mid = (lo + hi) >> 1;
+        if (grid->cxy_ind[mid] < target)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
 /* Determine in which grid cells the atoms should go */
 static void calc_cell_indices(const nbnxn_search_t nbs,
                               int dd_zone,
@@ -1586,12 +1629,13 @@ static void calc_cell_indices(const nbnxn_search_t nbs,
                               nbnxn_atomdata_t *nbat)
 {
     int   n0, n1, i;
-    int   cx, cy, cxy, ncz_max, ncz;
+    int   cx, cy, ncxy, ncz_max;
     int   nthread, thread;
-    int  *cxy_na, cxy_na_i;
 
     nthread = gmx_omp_nthreads_get(emntPairsearch);
 
+    ncxy    = grid->ncx*grid->ncy;
+
 #pragma omp parallel for num_threads(nthread) schedule(static)
     for (thread = 0; thread < nthread; thread++)
     {
@@ -1599,36 +1643,55 @@ static void calc_cell_indices(const nbnxn_search_t nbs,
                             nbs->cell, nbs->work[thread].cxy_na);
     }
 
-    /* Make the cell index as a function of x and y */
-    ncz_max          = 0;
-    ncz              = 0;
-    grid->cxy_ind[0] = 0;
-    for (i = 0; i < grid->ncx*grid->ncy+1; i++)
+    /* Sum the atom counts per column over the threads, in parallel over
+     * the columns. We convert the thread-local counts into thread-local
+     * offsets within each column, so the threads can fill the grid
+     * independently below. cxy_ind[i+1] temporarily holds the number
+     * of cells in column i. The extra column ncxy holds moved particles.
+     */
+#pragma omp parallel for num_threads(nthread) schedule(static)
+    for (thread = 0; thread < nthread; thread++)
     {
-        /* We set ncz_max at the beginning of the loop iso at the end
-         * to skip i=grid->ncx*grid->ncy which are moved particles
-         * that do not need to be ordered on the grid.
-         */
-        if (ncz > ncz_max)
-        {
-            ncz_max = ncz;
-        }
-        cxy_na_i = nbs->work[0].cxy_na[i];
-        for (thread = 1; thread < nthread; thread++)
+        int c0, c1, c, t, na, na_t, ncz;
+
+        c0 = ((thread + 0)*(ncxy + 1))/nthread;
+        c1 = ((thread + 1)*(ncxy + 1))/nthread;
+        for (c = c0; c < c1; c++)
         {
-            cxy_na_i += nbs->work[thread].cxy_na[i];
+            na = 0;
+            for (t = 0; t < nthread; t++)
+            {
+                na_t                   = nbs->work[t].cxy_na[c];
+                nbs->work[t].cxy_na[c] = na;
+                na                    += na_t;
+            }
+            grid->cxy_na[c] = na;
+
+            ncz = (na + grid->na_sc - 1)/grid->na_sc;
+            if (nbat->XFormat == nbatX8)
+            {
+                /* Make the number of cell a multiple of 2 */
+                ncz = (ncz + 1) & ~1;
+            }
+            grid->cxy_ind[c+1] = ncz;
         }
-        ncz = (cxy_na_i + grid->na_sc - 1)/grid->na_sc;
-        if (nbat->XFormat == nbatX8)
+    }
+
+    /* Make the cell index as a function of x and y with a prefix sum.
+     * ncz_max excludes the last column, which contains moved particles
+     * that do not need to be ordered on the grid.
+     */
+    ncz_max          = 0;
+    grid->cxy_ind[0] = 0;
+    for (i = 0; i < ncxy+1; i++)
+    {
+        if (i < ncxy && grid->cxy_ind[i+1] > ncz_max)
         {
-            /* Make the number of cell a multiple of 2 */
-            ncz = (ncz + 1) & ~1;
+            ncz_max = grid->cxy_ind[i+1];
         }
-        grid->cxy_ind[i+1] = grid->cxy_ind[i] + ncz;
-        /* Clear cxy_na, so we can reuse the array below */
-        grid->cxy_na[i] = 0;
+        grid->cxy_ind[i+1] += grid->cxy_ind[i];
     }
-    grid->nc = grid->cxy_ind[grid->ncx*grid->ncy] - grid->cxy_ind[0];
+    grid->nc = grid->cxy_ind[ncxy] - grid->cxy_ind[0];
 
     nbat->natoms = (grid->cell0 + grid->nc)*grid->na_sc;
 
@@ -1672,12 +1735,29 @@ static void calc_cell_indices(const nbnxn_search_t nbs,
 
     /* Now we know the dimensions we can fill the grid.
      * This is the first, unsorted fill. We sort the columns after this.
+     * Each thread fills in the atoms it assigned to columns above,
+     * starting at its own offset, which gives the same order as
+     * a serial fill.
      */
-    for (i = a0; i < a1; i++)
+#pragma omp parallel for num_threads(nthread) schedule(static)
+    for (thread = 0; thread < nthread; thread++)
     {
-        /* At this point nbs->cell contains the local grid x,y indices */
-        cxy = nbs->cell[i];
-        nbs->a[(grid->cell0 + grid->cxy_ind[cxy])*grid->na_sc + grid->cxy_na[cxy]++] = i;
+        int *cxy_offset;
+        int  a_start, a_end, a, cxy;
+
+        cxy_offset = nbs->work[thread].cxy_na;
+
+        /* Note that we need to use the same atom ranges as in
+         * calc_column_indices, since the offsets are thread-local.
+         */
+        a_start = a0 + (int)((thread+0)*(a1 - a0))/nthread;
+        a_end   = a0 + (int)((thread+1)*(a1 - a0))/nthread;
+        for (a = a_start; a < a_end; a++)
+        {
+            /* At this point nbs->cell contains the local grid x,y indices */
+            cxy = nbs->cell[a];
+            nbs->a[(grid->cell0 + grid->cxy_ind[cxy])*grid->na_sc + cxy_offset[cxy]++] = a;
+        }
     }
 
     if (dd_zone == 0)
@@ -1694,31 +1774,38 @@ static void calc_cell_indices(const nbnxn_search_t nbs,
         }
     }
 
-    /* Sort the super-cell columns along z into the sub-cells. */
-#pragma omp parallel for num_threads(nbs->nthread_max) schedule(static)
-    for (thread = 0; thread < nbs->nthread_max; thread++)
+    /* Sort the super-cell columns along z into the sub-cells.
+     * We divide the columns over the threads such that each thread
+     * gets about the same number of cells, which balances the sorting
+     * and bounding box work also for inhomogeneous systems.
+     */
+#pragma omp parallel for num_threads(nthread) schedule(static)
+    for (thread = 0; thread < nthread; thread++)
     {
+        int cxy_start, cxy_end;
+
+        cxy_start = column_range_start(grid, thread, nthread);
+        cxy_end   = column_range_start(grid, thread + 1, nthread);
+
         if (grid->bSimple)
         {
             sort_columns_simple(nbs, dd_zone, grid, a0, a1, atinfo, x, nbat,
-                                ((thread+0)*grid->ncx*grid->ncy)/nthread,
-                                ((thread+1)*grid->ncx*grid->ncy)/nthread,
+                                cxy_start, cxy_end,
                                 nbs->work[thread].sort_work);
+
+            if (nbat->XFormat == nbatX8)
+            {
+                combine_bounding_box_pairs(grid, grid->bb, cxy_start, cxy_end);
+            }
         }
         else
         {
             sort_columns_supersub(nbs, dd_zone, grid, a0, a1, atinfo, x, nbat,
-                                  ((thread+0)*grid->ncx*grid->ncy)/nthread,
-                                  ((thread+1)*grid->ncx*grid->ncy)/nthread,
+                                  cxy_start, cxy_end,
                                   nbs->work[thread].sort_work);
         }
     }
 
-    if (grid->bSimple && nbat->XFormat == nbatX8)
-    {
-        combine_bounding_box_pairs(grid, grid->bb);
-    }
-
     if (!grid->bSimple)
     {
         grid->nsubc_tot = 0;
@@ -1988,7 +2075,8 @@ void nbnxn_grid_add_simple(nbnxn_search_t    nbs,
 
     if (grid->bSimple && nbat->XFormat == nbatX8)
     {
-        combine_bounding_box_pairs(grid, grid->bb_simple);
+        combine_bounding_box_pairs(grid, grid->bb_simple,
+                                   0, grid->ncx*grid->ncy);
     }
 }
 
@@ -2503,6 +2591,13 @@ static void nbnxn_init_pairlist(nbnxn_pairlist_t *nbl,
     nbl->cj4         = NULL;
     nbl->nci_tot     = 0;
 
+    nbl->nci_outer       = 0;
+    nbl->ci_outer        = NULL;
+    nbl->ci_outer_nalloc = 0;
+    nbl->ncj_outer       = 0;
+    nbl->cj_outer        = NULL;
+    nbl->cj_outer_nalloc = 0;
+
     if (!nbl->bSimple)
     {
         nbl->excl        = NULL;
@@ -5843,3 +5938,52 @@ void nbnxn_make_pairlist(const nbnxn_search_t  nbs,
         }
     }
 }
+
+void nbnxn_pairlist_set_outer(nbnxn_pairlist_set_t *nbl_list)
+{
+    int th;
+
+    if (!nbl_list->bSimple)
+    {
+        gmx_incons("Dynamic pruning is only supported for simple pair lists");
+    }
+
+#pragma omp parallel for num_threads(nbl_list->nnbl) schedule(static)
+    for (th = 0; th < nbl_list->nnbl; th++)
+    {
+        nbnxn_pairlist_t *nbl;
+        nbnxn_ci_t       *ci_tmp;
+        nbnxn_cj_t       *cj_tmp;
+        int               nalloc_tmp;
+
+        nbl = nbl_list->nbl[th];
+
+        /* Swap the list buffers, so the list just generated becomes
+         * the outer list without copying it.
+         */
+        ci_tmp               = nbl->ci_outer;
+        nbl->ci_outer        = nbl->ci;
+        nbl->ci              = ci_tmp;
+        nalloc_tmp           = nbl->ci_outer_nalloc;
+        nbl->ci_outer_nalloc = nbl->ci_nalloc;
+        nbl->ci_nalloc       = nalloc_tmp;
+        nbl->nci_outer       = nbl->nci;
+        nbl->nci             = 0;
+
+        cj_tmp               = nbl->cj_outer;
+        nbl->cj_outer        = nbl->cj;
+        nbl->cj              = cj_tmp;
+        nalloc_tmp           = nbl->cj_outer_nalloc;
+        nbl->cj_outer_nalloc = nbl->cj_nalloc;
+        nbl->cj_nalloc       = nalloc_tmp;
+        nbl->ncj_outer       = nbl->ncj;
+        nbl->ncj             = 0;
+
+        /* The pruned inner list is never longer than the outer list */
+        if (nbl->nci_outer > nbl->ci_nalloc)
+        {
+            nb_realloc_ci(nbl, nbl->nci_outer);
+        }
+        check_subcell_list_space_simple(nbl, nbl->ncj_outer);
+    }
+}
@@ -130,6 +130,13 @@ void nbnxn_make_pairlist(const nbnxn_search_t  nbs,
                          int                   nb_kernel_type,
                          t_nrnb               *nrnb);
 
+/* Make the lists in nbl_list, just generated by nbnxn_make_pairlist,
+ * the outer lists for dynamic pruning. Only the outer lists are valid
+ * after this call, the lists should be pruned with nbnxn_kernel_prune
+ * before calling the non-bonded kernels.
+ */
+void nbnxn_pairlist_set_outer(nbnxn_pairlist_set_t *nbl_list);
+
 #ifdef __cplusplus
 }
 #endif
@@ -97,6 +97,16 @@
 #    define PME_SIMD_SOLVE
 #endif
 
+#ifdef GMX_DOUBLE
+/* In double precision we can compute the influence function, the most
+ * expensive part of the solve, in single precision, see bFloatInfluence.
+ */
+#    define PME_FLOAT_INFLUENCE
+#    ifdef GMX_SIMD_HAVE_FLOAT
+#        define PME_SIMD_SOLVE_FLOAT
+#    endif
+#endif
+
 #define PME_GRID_QA    0 /* Gridindex for A-state for Q */
 #define PME_GRID_C6A   2 /* Gridindex for A-state for LJ */
 #define DO_Q           2 /* Electrostatic grids have index q<2 */
@@ -281,6 +291,12 @@ typedef struct {
     real *   tmp2;
     real *   eterm;
     real *   m2inv;
+#ifdef PME_FLOAT_INFLUENCE
+    /* Single precision work arrays for the float influence function */
+    float *  denom_f;
+    float *  tmp1_f;
+    float *  tmp2_f;
+#endif
 
     real     energy_q;
     matrix   vir_q;
@@ -305,6 +321,9 @@ typedef struct gmx_pme {
 
     gmx_bool   bUseThreads;   /* Does any of the PME ranks have nthread>1 ?  */
     int        nthread;       /* The number of threads doing PME on our rank */
+    gmx_bool   bSpreadTiles;  /* Spread directly on the FFT grid tiles      */
+    gmx_bool   bFloatInfluence; /* Compute the solve influence function in
+                                 * single precision in a double build     */
 
     gmx_bool   bPPnode;       /* Node also does particle-particle forces */
     gmx_bool   bFEP;          /* Compute Free energy contribution */
@@ -1368,23 +1387,35 @@ static void unwrap_periodic_pmegrid(gmx_pme_t pme, real *pmegrid)
     }
 
 
-static void spread_coefficients_bsplines_thread(pmegrid_t                    *pmegrid,
-                                                pme_atomcomm_t               *atc,
-                                                splinedata_t                 *spline,
-                                                pme_spline_work_t gmx_unused *work)
-{
+/* Atom selection for spreading, see spread_coefficients_bsplines */
+enum {
+    espreadAll, espreadInterior, espreadBoundary
+};
 
-    /* spread coefficients from home atoms to local grid */
-    real          *grid;
-    pme_overlap_t *ol;
-    int            b, i, nn, n, ithx, ithy, ithz, i0, j0, k0;
+/* Spreads the coefficients of the atoms in spline on grid, which has
+ * y and z strides pny*pnz and pnz and starts at index grid_offset of
+ * the local node grid.
+ * With select!=espreadAll only the atoms whose spreading stencil is
+ * fully inside (espreadInterior) or not fully inside (espreadBoundary)
+ * the tile with size tile_n starting at grid_offset are spread.
+ */
+static void spread_coefficients_bsplines(real                         *grid,
+                                         int                           pny,
+                                         int                           pnz,
+                                         const ivec                    grid_offset,
+                                         int                           order,
+                                         int                           select,
+                                         const ivec                    tile_n,
+                                         pme_atomcomm_t               *atc,
+                                         splinedata_t                 *spline,
+                                         pme_spline_work_t gmx_unused *work)
+{
+    int            i, nn, n, ithx, ithy, ithz, i0, j0, k0;
     int       *    idxptr;
-    int            order, norder, index_x, index_xy, index_xyz;
+    int            norder, index_x, index_xy, index_xyz;
     real           valx, valxy, coefficient;
     real          *thx, *thy, *thz;
-    int            localsize, bndsize;
-    int            pnx, pny, pnz, ndatatot;
-    int            offx, offy, offz;
+    gmx_bool       bInterior;
 
 #if defined PME_SIMD4_SPREAD_GATHER && !defined PME_SIMD4_UNALIGNED
     real           thz_buffer[GMX_SIMD4_WIDTH*3], *thz_aligned;
@@ -1392,23 +1423,6 @@ static void spread_coefficients_bsplines_thread(pmegrid_t                    *pm
     thz_aligned = gmx_simd4_align_r(thz_buffer);
 #endif
 
-    pnx = pmegrid->s[XX];
-    pny = pmegrid->s[YY];
-    pnz = pmegrid->s[ZZ];
-
-    offx = pmegrid->offset[XX];
-    offy = pmegrid->offset[YY];
-    offz = pmegrid->offset[ZZ];
-
-    ndatatot = pnx*pny*pnz;
-    grid     = pmegrid->grid;
-    for (i = 0; i < ndatatot; i++)
-    {
-        grid[i] = 0;
-    }
-
-    order = pmegrid->order;
-
     for (nn = 0; nn < spline->n; nn++)
     {
         n           = spline->ind[nn];
@@ -1419,9 +1433,20 @@ static void spread_coefficients_bsplines_thread(pmegrid_t                    *pm
             idxptr = atc->idx[n];
             norder = nn*order;
 
-            i0   = idxptr[XX] - offx;
-            j0   = idxptr[YY] - offy;
-            k0   = idxptr[ZZ] - offz;
+            i0   = idxptr[XX] - grid_offset[XX];
+            j0   = idxptr[YY] - grid_offset[YY];
+            k0   = idxptr[ZZ] - grid_offset[ZZ];
+
+            if (select != espreadAll)
+            {
+                bInterior = (i0 + order <= tile_n[XX] &&
+                             j0 + order <= tile_n[YY] &&
+                             k0 + order <= tile_n[ZZ]);
+                if (bInterior != (select == espreadInterior))
+                {
+                    continue;
+                }
+            }
 
             thx = spline->theta[XX] + norder;
             thy = spline->theta[YY] + norder;
@@ -1459,6 +1484,28 @@ static void spread_coefficients_bsplines_thread(pmegrid_t                    *pm
     }
 }
 
+static void spread_coefficients_bsplines_thread(pmegrid_t                    *pmegrid,
+                                                pme_atomcomm_t               *atc,
+                                                splinedata_t                 *spline,
+                                                pme_spline_work_t gmx_unused *work)
+{
+    /* spread coefficients from home atoms to local grid */
+    real          *grid;
+    int            i, ndatatot;
+
+    ndatatot = pmegrid->s[XX]*pmegrid->s[YY]*pmegrid->s[ZZ];
+    grid     = pmegrid->grid;
+    for (i = 0; i < ndatatot; i++)
+    {
+        grid[i] = 0;
+    }
+
+    spread_coefficients_bsplines(grid, pmegrid->s[YY], pmegrid->s[ZZ],
+                                 pmegrid->offset, pmegrid->order,
+                                 espreadAll, NULL,
+                                 atc, spline, work);
+}
+
 static void set_grid_alignment(int gmx_unused *pmegrid_nz, int gmx_unused pme_order)
 {
 #ifdef PME_SIMD4_SPREAD_GATHER
@@ -1726,20 +1773,24 @@ static void pmegrids_init(pmegrids_t *grids,
 
 static void pmegrids_destroy(pmegrids_t *grids)
 {
-    int t;
+    int d;
 
     if (grids->grid.grid != NULL)
     {
-        sfree(grids->grid.grid);
+        sfree_aligned(grids->grid.grid);
 
-        if (grids->nthread > 0)
+        /* The thread-local grids all point into grid_all */
+        if (grids->grid_th != NULL)
         {
-            for (t = 0; t < grids->nthread; t++)
-            {
-                sfree(grids->grid_th[t].grid);
-            }
+            sfree_aligned(grids->grid_all);
             sfree(grids->grid_th);
         }
+
+        for (d = 0; d < DIM; d++)
+        {
+            sfree(grids->g2t[d]);
+        }
+        sfree(grids->g2t);
     }
 }
 
@@ -1747,6 +1798,9 @@ static void pmegrids_destroy(pmegrids_t *grids)
 static void realloc_work(pme_work_t *work, int nkx)
 {
     int simd_width;
+#ifdef PME_FLOAT_INFLUENCE
+    int simd_width_f;
+#endif
 
     if (nkx > work->nalloc)
     {
@@ -1773,6 +1827,19 @@ static void realloc_work(pme_work_t *work, int nkx)
         snew_aligned(work->tmp2,  work->nalloc+simd_width, simd_width*sizeof(real));
         snew_aligned(work->eterm, work->nalloc+simd_width, simd_width*sizeof(real));
         srenew(work->m2inv, work->nalloc);
+#ifdef PME_FLOAT_INFLUENCE
+#ifdef PME_SIMD_SOLVE_FLOAT
+        simd_width_f = GMX_SIMD_FLOAT_WIDTH;
+#else
+        simd_width_f = 4;
+#endif
+        sfree_aligned(work->denom_f);
+        sfree_aligned(work->tmp1_f);
+        sfree_aligned(work->tmp2_f);
+        snew_aligned(work->denom_f, work->nalloc+simd_width_f, simd_width_f*sizeof(float));
+        snew_aligned(work->tmp1_f,  work->nalloc+simd_width_f, simd_width_f*sizeof(float));
+        snew_aligned(work->tmp2_f,  work->nalloc+simd_width_f, simd_width_f*sizeof(float));
+#endif
     }
 }
 
@@ -1788,6 +1855,11 @@ static void free_work(pme_work_t *work)
     sfree_aligned(work->tmp2);
     sfree_aligned(work->eterm);
     sfree(work->m2inv);
+#ifdef PME_FLOAT_INFLUENCE
+    sfree_aligned(work->denom_f);
+    sfree_aligned(work->tmp1_f);
+    sfree_aligned(work->tmp2_f);
+#endif
 }
 
 
@@ -1882,6 +1954,94 @@ gmx_inline static void calc_exponentials_lj(int start, int end, real *r, real *t
 }
 #endif
 
+#ifdef PME_FLOAT_INFLUENCE
+/* Calculate the Coulomb influence function in single precision.
+ * The double precision input in d and r is converted to float,
+ * the result is returned in double precision in e.
+ */
+static void calc_exponentials_q_float(int start, int end, real f,
+                                      const real *d, const real *r, real *e,
+                                      float *d_f, float *r_f)
+{
+    int kx;
+
+    /* As in the SIMD kernels above, we start at 0 for aligned access */
+    for (kx = 0; kx < end; kx++)
+    {
+        d_f[kx] = d[kx];
+        r_f[kx] = r[kx];
+    }
+#ifdef PME_SIMD_SOLVE_FLOAT
+    {
+        const gmx_simd_float_t f_S = gmx_simd_set1_f(f);
+        gmx_simd_float_t       d_inv_S, r_S, e_S;
+
+        for (kx = 0; kx < end; kx += GMX_SIMD_FLOAT_WIDTH)
+        {
+            d_inv_S = gmx_simd_inv_f(gmx_simd_load_f(d_f+kx));
+            r_S     = gmx_simd_exp_f(gmx_simd_load_f(r_f+kx));
+            e_S     = gmx_simd_mul_f(gmx_simd_mul_f(f_S, d_inv_S), r_S);
+            gmx_simd_store_f(r_f+kx, e_S);
+        }
+    }
+#else
+    for (kx = start; kx < end; kx++)
+    {
+        r_f[kx] = (float)f*(float)exp(r_f[kx])/d_f[kx];
+    }
+#endif
+    for (kx = start; kx < end; kx++)
+    {
+        e[kx] = r_f[kx];
+    }
+}
+
+/* Calculate the LJ influence function terms in single precision,
+ * the in- and output is double precision, as for calc_exponentials_lj.
+ */
+static void calc_exponentials_lj_float(int start, int end,
+                                       real *r, real *factor, real *d,
+                                       float *r_f, float *factor_f, float *d_f)
+{
+    int kx;
+
+    for (kx = 0; kx < end; kx++)
+    {
+        r_f[kx]      = r[kx];
+        factor_f[kx] = factor[kx];
+        d_f[kx]      = d[kx];
+    }
+#ifdef PME_SIMD_SOLVE_FLOAT
+    {
+        const gmx_simd_float_t sqr_PI = gmx_simd_sqrt_f(gmx_simd_set1_f(M_PI));
+        gmx_simd_float_t       mk_S;
+
+        for (kx = 0; kx < end; kx += GMX_SIMD_FLOAT_WIDTH)
+        {
+            gmx_simd_store_f(d_f+kx, gmx_simd_inv_f(gmx_simd_load_f(d_f+kx)));
+            gmx_simd_store_f(r_f+kx, gmx_simd_exp_f(gmx_simd_load_f(r_f+kx)));
+            mk_S = gmx_simd_load_f(factor_f+kx);
+            gmx_simd_store_f(factor_f+kx,
+                             gmx_simd_mul_f(sqr_PI, gmx_simd_mul_f(mk_S, gmx_simd_erfc_f(mk_S))));
+        }
+    }
+#else
+    for (kx = start; kx < end; kx++)
+    {
+        d_f[kx]      = 1.0f/d_f[kx];
+        r_f[kx]      = (float)exp(r_f[kx]);
+        factor_f[kx] = (float)(sqrt(M_PI)*factor_f[kx]*gmx_erfc(factor_f[kx]));
+    }
+#endif
+    for (kx = start; kx < end; kx++)
+    {
+        r[kx]      = r_f[kx];
+        factor[kx] = factor_f[kx];
+        d[kx]      = d_f[kx];
+    }
+}
+#endif
+
 static int solve_pme_yzx(gmx_pme_t pme, t_complex *grid,
                          real ewaldcoeff, real vol,
                          gmx_bool bEnerVir,
@@ -2036,7 +2196,17 @@ static int solve_pme_yzx(gmx_pme_t pme, t_complex *grid,
                 m2inv[kx] = 1.0/m2[kx];
             }
 
-            calc_exponentials_q(kxstart, kxend, elfac, denom, tmp1, eterm);
+#ifdef PME_FLOAT_INFLUENCE
+            if (pme->bFloatInfluence)
+            {
+                calc_exponentials_q_float(kxstart, kxend, elfac, denom, tmp1, eterm,
+                                          work->denom_f, work->tmp1_f);
+            }
+            else
+#endif
+            {
+                calc_exponentials_q(kxstart, kxend, elfac, denom, tmp1, eterm);
+            }
 
             for (kx = kxstart; kx < kxend; kx++, p0++)
             {
@@ -2098,7 +2268,17 @@ static int solve_pme_yzx(gmx_pme_t pme, t_complex *grid,
                 tmp1[kx]  = -factor*m2k;
             }
 
-            calc_exponentials_q(kxstart, kxend, elfac, denom, tmp1, eterm);
+#ifdef PME_FLOAT_INFLUENCE
+            if (pme->bFloatInfluence)
+            {
+                calc_exponentials_q_float(kxstart, kxend, elfac, denom, tmp1, eterm,
+                                          work->denom_f, work->tmp1_f);
+            }
+            else
+#endif
+            {
+                calc_exponentials_q(kxstart, kxend, elfac, denom, tmp1, eterm);
+            }
 
             for (kx = kxstart; kx < kxend; kx++, p0++)
             {
@@ -2267,7 +2447,17 @@ static int solve_pme_lj_yzx(gmx_pme_t pme, t_complex **grid, gmx_bool bLB,
                 tmp2[kx]  = sqrt(factor*m2k);
             }
 
-            calc_exponentials_lj(kxstart, kxend, tmp1, tmp2, denom);
+#ifdef PME_FLOAT_INFLUENCE
+            if (pme->bFloatInfluence)
+            {
+                calc_exponentials_lj_float(kxstart, kxend, tmp1, tmp2, denom,
+                                           work->tmp1_f, work->tmp2_f, work->denom_f);
+            }
+            else
+#endif
+            {
+                calc_exponentials_lj(kxstart, kxend, tmp1, tmp2, denom);
+            }
 
             for (kx = kxstart; kx < kxend; kx++)
             {
@@ -2400,7 +2590,17 @@ static int solve_pme_lj_yzx(gmx_pme_t pme, t_complex **grid, gmx_bool bLB,
                 tmp2[kx]  = sqrt(factor*m2k);
             }
 
-            calc_exponentials_lj(kxstart, kxend, tmp1, tmp2, denom);
+#ifdef PME_FLOAT_INFLUENCE
+            if (pme->bFloatInfluence)
+            {
+                calc_exponentials_lj_float(kxstart, kxend, tmp1, tmp2, denom,
+                                           work->tmp1_f, work->tmp2_f, work->denom_f);
+            }
+            else
+#endif
+            {
+                calc_exponentials_lj(kxstart, kxend, tmp1, tmp2, denom);
+            }
 
             for (kx = kxstart; kx < kxend; kx++)
             {
@@ -2989,8 +3189,7 @@ int gmx_pme_destroy(FILE *log, gmx_pme_t *pmedata)
     for (i = 0; i < (*pmedata)->ngrids; ++i)
     {
         pmegrids_destroy(&(*pmedata)->pmegrid[i]);
-        sfree((*pmedata)->fftgrid[i]);
-        sfree((*pmedata)->cfftgrid[i]);
+        /* This also frees fftgrid and cfftgrid, which are owned by the setup */
         gmx_parallel_3dfft_destroy((*pmedata)->pfft_setup[i]);
     }
 
@@ -3509,6 +3708,41 @@ int gmx_pme_init(gmx_pme_t *         pmedata,
     pme->bP3M        = (ir->coulombtype == eelP3M_AD || getenv("GMX_PME_P3M") != NULL);
     pme->pme_order   = ir->pme_order;
 
+    /* With threads we spread directly on the FFT grid tiles, unless
+     * disabled. This requires a spreading kernel without alignment
+     * requirements, which with SIMD we only have for order 4.
+     */
+    pme->bSpreadTiles = (pme->bUseThreads &&
+                         getenv("GMX_PME_NO_SPREAD_TILES") == NULL);
+#ifdef PME_SIMD4_SPREAD_GATHER
+#ifdef PME_SIMD4_UNALIGNED
+    pme->bSpreadTiles = (pme->bSpreadTiles && pme->pme_order == 4);
+#else
+    pme->bSpreadTiles = FALSE;
+#endif
+#endif
+    if (debug)
+    {
+        fprintf(debug, "PME spreading on FFT grid tiles: %s\n",
+                pme->bSpreadTiles ? "yes" : "no");
+    }
+
+    /* In double precision, the influence function in the solve can be
+     * computed in single precision, which doubles the SIMD width.
+     * The grid multiplication and the energy and virial accumulation
+     * are still done in double precision.
+     */
+#ifdef PME_FLOAT_INFLUENCE
+    pme->bFloatInfluence = (getenv("GMX_PME_FLOAT_INFLUENCE") != NULL);
+#else
+    pme->bFloatInfluence = FALSE;
+#endif
+    if (debug)
+    {
+        fprintf(debug, "PME solve influence function in single precision: %s\n",
+                pme->bFloatInfluence ? "yes" : "no");
+    }
+
     /* Always constant electrostatics coefficients */
     pme->epsilon_r   = ir->epsilon_r;
 
@@ -3826,6 +4060,129 @@ static void copy_local_grid(gmx_pme_t pme, pmegrids_t *pmegrids,
     }
 }
 
+/* Returns in tile_n the size of the part of the FFT grid owned by
+ * the thread with grid pmegrid, i.e. the non-overlapping part of
+ * the thread-local grid, and the y and z strides of the FFT grid.
+ */
+static void get_threadgrid_tile(gmx_pme_t pme, const pmegrid_t *pmegrid,
+                                int grid_index,
+                                ivec tile_n, int *fft_my, int *fft_mz)
+{
+    ivec local_fft_ndata, local_fft_offset, local_fft_size;
+    int  d;
+
+    gmx_parallel_3dfft_real_limits(pme->pfft_setup[grid_index],
+                                   local_fft_ndata,
+                                   local_fft_offset,
+                                   local_fft_size);
+    *fft_my = local_fft_size[YY];
+    *fft_mz = local_fft_size[ZZ];
+
+    for (d = 0; d < DIM; d++)
+    {
+        tile_n[d] = min(pmegrid->n[d] - (pmegrid->order - 1),
+                        local_fft_ndata[d] - pmegrid->offset[d]);
+        tile_n[d] = max(tile_n[d], 0);
+    }
+}
+
+/* Spreads the coefficients of our thread with FFT grid tiles.
+ * Each thread owns the tile of the FFT grid which corresponds to
+ * the non-overlapping part of its thread-local grid. The atoms with
+ * spreading stencils fully inside our tile are spread directly on
+ * the FFT grid. Only the remaining atoms are spread on the thread-local
+ * grid, of which we then only clear and add the shell of width
+ * pme_order-1 at the upper tile edges, including the overlap.
+ * Compared to copy_local_grid this avoids clearing and copying
+ * the full thread-local grids. The overlap is reduced as usual.
+ */
+static void spread_on_grid_tiles(gmx_pme_t pme, pmegrids_t *pmegrids,
+                                 int grid_index, int thread,
+                                 pme_atomcomm_t *atc, splinedata_t *spline,
+                                 real *fftgrid)
+{
+    pmegrid_t *pmegrid;
+    ivec       tile_n, shell0;
+    int        fft_my, fft_mz;
+    int        nsy, nsz;
+    int        offx, offy, offz, x, y, z, z0, i0, i0t;
+    int        d;
+    real      *grid_th;
+
+    pmegrid = &pmegrids->grid_th[thread];
+
+    get_threadgrid_tile(pme, pmegrid, grid_index, tile_n, &fft_my, &fft_mz);
+
+    nsy  = pmegrid->s[YY];
+    nsz  = pmegrid->s[ZZ];
+
+    offx = pmegrid->offset[XX];
+    offy = pmegrid->offset[YY];
+    offz = pmegrid->offset[ZZ];
+
+    for (d = 0; d < DIM; d++)
+    {
+        shell0[d] = max(tile_n[d] - (pmegrid->order - 1), 0);
+    }
+
+    /* Clear our tile of the FFT grid */
+    for (x = 0; x < tile_n[XX]; x++)
+    {
+        for (y = 0; y < tile_n[YY]; y++)
+        {
+            i0  = ((offx + x)*fft_my + (offy + y))*fft_mz + offz;
+            for (z = 0; z < tile_n[ZZ]; z++)
+            {
+                fftgrid[i0+z] = 0;
+            }
+        }
+    }
+
+    /* Spread the interior atoms directly on our tile,
+     * the FFT grid indices are the local node grid indices.
+     */
+    spread_coefficients_bsplines(fftgrid + (offx*fft_my + offy)*fft_mz + offz,
+                                 fft_my, fft_mz,
+                                 pmegrid->offset, pmegrid->order,
+                                 espreadInterior, tile_n,
+                                 atc, spline, pme->spline_work);
+
+    /* Clear the shell of the thread-local grid, including the overlap */
+    grid_th = pmegrid->grid;
+    for (x = 0; x < pmegrid->n[XX]; x++)
+    {
+        for (y = 0; y < pmegrid->n[YY]; y++)
+        {
+            z0  = ((x >= shell0[XX] || y >= shell0[YY]) ? 0 : shell0[ZZ]);
+            i0t = (x*nsy + y)*nsz;
+            for (z = z0; z < pmegrid->n[ZZ]; z++)
+            {
+                grid_th[i0t+z] = 0;
+            }
+        }
+    }
+
+    spread_coefficients_bsplines(grid_th, nsy, nsz,
+                                 pmegrid->offset, pmegrid->order,
+                                 espreadBoundary, tile_n,
+                                 atc, spline, pme->spline_work);
+
+    /* Add the part of the shell inside our tile to the FFT grid */
+    for (x = 0; x < tile_n[XX]; x++)
+    {
+        for (y = 0; y < tile_n[YY]; y++)
+        {
+            z0  = ((x >= shell0[XX] || y >= shell0[YY]) ? 0 : shell0[ZZ]);
+            i0  = ((offx + x)*fft_my + (offy + y))*fft_mz + offz;
+            i0t = (x*nsy + y)*nsz;
+            for (z = z0; z < tile_n[ZZ]; z++)
+            {
+                fftgrid[i0+z] += grid_th[i0t+z];
+            }
+        }
+    }
+}
+
 static void
 reduce_threadgrid_overlap(gmx_pme_t pme,
                           const pmegrids_t *pmegrids, int thread,
@@ -4301,11 +4658,19 @@ static void spread_on_grid(gmx_pme_t pme,
 #ifdef PME_TIME_SPREAD
             ct1a = omp_cyc_start();
 #endif
-            spread_coefficients_bsplines_thread(grid, atc, spline, pme->spline_work);
-
-            if (pme->bUseThreads)
+            if (pme->bSpreadTiles)
             {
-                copy_local_grid(pme, grids, grid_index, thread, fftgrid);
+                spread_on_grid_tiles(pme, grids, grid_index, thread,
+                                     atc, spline, fftgrid);
+            }
+            else
+            {
+                spread_coefficients_bsplines_thread(grid, atc, spline, pme->spline_work);
+
+                if (pme->bUseThreads)
+                {
+                    copy_local_grid(pme, grids, grid_index, thread, fftgrid);
+                }
             }
 #ifdef PME_TIME_SPREAD
             ct1a          = omp_cyc_end(ct1a);
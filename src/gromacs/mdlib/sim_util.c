@@ -76,6 +76,7 @@
 #include "nbnxn_kernels/simd_4xn/nbnxn_kernel_simd_4xn.h"
 #include "nbnxn_kernels/simd_2xnn/nbnxn_kernel_simd_2xnn.h"
 #include "nbnxn_kernels/nbnxn_kernel_gpu_ref.h"
+#include "nbnxn_kernels/nbnxn_kernel_prune.h"
 #include "nonbonded.h"
 #include "../gmxlib/nonbonded/nb_kernel.h"
 #include "../gmxlib/nonbonded/nb_free_energy.h"
@@ -691,6 +692,29 @@ static void do_nb_verlet(t_forcerec *fr,
     }
 }
 
+/* With dynamic pruning, prunes the outer pair list of locality ilocality
+ * to the inner list with cut-off ic->rlist_inner using the current
+ * coordinates. With bOuter the list was just generated by the search.
+ */
+static void do_nb_prune(nonbonded_verlet_t        *nbv,
+                        const interaction_const_t *ic,
+                        int                        ilocality,
+                        gmx_bool                   bOuter,
+                        gmx_wallcycle_t            wcycle)
+{
+    nonbonded_verlet_group_t *nbvg = &nbv->grp[ilocality];
+
+    wallcycle_sub_start(wcycle, ewcsNONBONDED_PRUNING);
+    if (bOuter)
+    {
+        nbnxn_pairlist_set_outer(&nbvg->nbl_lists);
+    }
+    nbnxn_kernel_prune(&nbvg->nbl_lists, nbvg->nbat,
+                       (const rvec *)nbvg->nbat->shift_vec,
+                       ic->rlist_inner, nbvg->kernel_type);
+    wallcycle_sub_stop(wcycle, ewcsNONBONDED_PRUNING);
+}
+
 static void do_nb_verlet_fep(nbnxn_pairlist_set_t *nbl_lists,
                              t_forcerec           *fr,
                              rvec                  x[],
@@ -823,6 +847,7 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
     gmx_bool            bSepDVDL, bStateChanged, bNS, bFillGrid, bCalcCGCM, bBS;
     gmx_bool            bDoLongRange, bDoForces, bSepLRF, bUseGPU, bUseOrEmulGPU;
     gmx_bool            bDiffKernels = FALSE;
+    gmx_bool            bPruneStep;
     matrix              boxs;
     rvec                vzero, box_diag;
     real                e, v, dvdl;
@@ -864,6 +889,11 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
     bSepLRF       = (bDoLongRange && bDoForces && (flags & GMX_FORCE_SEPLRF));
     bUseGPU       = fr->nbv->bUseGPU;
     bUseOrEmulGPU = bUseGPU || (nbv->grp[0].kernel_type == nbnxnk8x8x8_PlainC);
+    /* With dynamic pruning we prune right after search, see below,
+     * and every nbv->nstlist_prune steps after that.
+     */
+    bPruneStep    = (nbv->bDynamicPruning && !bNS &&
+                     (step - nbv->step_search) % nbv->nstlist_prune == 0);
 
     if (bStateChanged)
     {
@@ -1025,6 +1055,12 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
                             nrnb);
         wallcycle_sub_stop(wcycle, ewcsNBS_SEARCH_LOCAL);
 
+        if (nbv->bDynamicPruning)
+        {
+            nbv->step_search = step;
+            do_nb_prune(nbv, ic, eintLocal, TRUE, wcycle);
+        }
+
         if (bUseGPU)
         {
             /* initialize local pair-list on the GPU */
@@ -1042,6 +1078,13 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
                                         nbv->grp[eintLocal].nbat);
         wallcycle_sub_stop(wcycle, ewcsNB_X_BUF_OPS);
         wallcycle_stop(wcycle, ewcNB_XF_BUF_OPS);
+
+        if (bPruneStep)
+        {
+            wallcycle_start_nocount(wcycle, ewcFORCE);
+            do_nb_prune(nbv, ic, eintLocal, FALSE, wcycle);
+            cycles_force += wallcycle_stop(wcycle, ewcFORCE);
+        }
     }
 
     if (bUseGPU)
@@ -1096,6 +1139,11 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
 
             wallcycle_sub_stop(wcycle, ewcsNBS_SEARCH_NONLOCAL);
 
+            if (nbv->bDynamicPruning)
+            {
+                do_nb_prune(nbv, ic, eintNonlocal, TRUE, wcycle);
+            }
+
             if (nbv->grp[eintNonlocal].kernel_type == nbnxnk8x8x8_CUDA)
             {
                 /* initialize non-local pair-list on the GPU */
@@ -1123,6 +1171,13 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
                                             nbv->grp[eintNonlocal].nbat);
             wallcycle_sub_stop(wcycle, ewcsNB_X_BUF_OPS);
             cycles_force += wallcycle_stop(wcycle, ewcNB_XF_BUF_OPS);
+
+            if (bPruneStep)
+            {
+                wallcycle_start_nocount(wcycle, ewcFORCE);
+                do_nb_prune(nbv, ic, eintNonlocal, FALSE, wcycle);
+                cycles_force += wallcycle_stop(wcycle, ewcFORCE);
+            }
         }
 
         if (bUseGPU && !bDiffKernels)
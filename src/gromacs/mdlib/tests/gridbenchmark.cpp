@@ -0,0 +1,231 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Benchmark for the nbnxn pair-search grid construction.
+ *
+ * Puts a homogeneous system of atoms on the nbnxn grid with
+ * nbnxn_put_on_grid() for 1, 2, 4, ... pair-search threads and prints
+ * the time per call, so the thread scaling of the grid construction can
+ * be measured without running mdrun. It also checks that the atom
+ * order on the grid does not depend on the number of threads. Run e.g.
+ *
+ *     mdlib-grid-benchmark -natoms 1000000 -ncalls 20 -nthreads 8
+ *
+ * on an otherwise idle machine.
+ *
+ * \ingroup module_mdlib
+ */
+#include <cmath>
+#include <cstdio>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/legacyheaders/gmx_omp_nthreads.h"
+#include "gromacs/legacyheaders/typedefs.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/mdlib/nbnxn_atomdata.h"
+#include "gromacs/mdlib/nbnxn_search.h"
+#include "gromacs/mdlib/nbnxn_simd.h"
+#include "gromacs/options/basicoptions.h"
+#include "gromacs/options/options.h"
+#include "gromacs/timing/walltime_accounting.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "testutils/testoptions.h"
+
+namespace
+{
+
+//! Number of atoms.
+int g_natoms   = 100000;
+//! Number of grid constructions per thread count.
+int g_ncalls   = 20;
+//! Maximum number of pair-search threads.
+int g_nthreads = 4;
+
+//! \cond
+GMX_TEST_OPTIONS(GridBenchmarkOptions, options)
+{
+    options->addOption(::gmx::IntegerOption("natoms")
+                           .store(&g_natoms)
+                           .description("Number of atoms"));
+    options->addOption(::gmx::IntegerOption("ncalls")
+                           .store(&g_ncalls)
+                           .description("Number of grid constructions per thread count"));
+    options->addOption(::gmx::IntegerOption("nthreads")
+                           .store(&g_nthreads)
+                           .description("Maximum number of pair-search threads"));
+}
+//! \endcond
+
+//! Returns the kernel type mdrun would use for the grid layout.
+int gridKernelType()
+{
+#if defined GMX_NBNXN_SIMD_4XN
+    return nbnxnk4xN_SIMD_4xN;
+#elif defined GMX_NBNXN_SIMD_2XNN
+    return nbnxnk4xN_SIMD_2xNN;
+#else
+    return nbnxnk4x4_PlainC;
+#endif
+}
+
+/*! \brief
+ * Benchmark fixture with atoms at the density of water, with
+ * pseudo-random positions in a cubic box.
+ */
+class GridBenchmark : public ::testing::Test
+{
+    public:
+        GridBenchmark() : x_(g_natoms*DIM), atinfo_(g_natoms)
+        {
+            /* About 100 atoms per nm^3, as in water */
+            real         length = std::pow(g_natoms/100.0, 1.0/3.0);
+            unsigned int seed   = 1993;
+
+            clear_mat(box_);
+            for (int d = 0; d < DIM; d++)
+            {
+                box_[d][d] = length;
+            }
+            for (int i = 0; i < g_natoms; i++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    /* Linear congruential generator, reproducible on all platforms */
+                    seed          = seed*1664525U + 1013904223U;
+                    x_[i*DIM + d] = length*(seed >> 8)/static_cast<real>(1U << 24);
+                }
+                atinfo_[i] = 0;
+                SET_CGINFO_HAS_VDW(atinfo_[i]);
+                SET_CGINFO_HAS_Q(atinfo_[i]);
+            }
+
+            gmx_omp_nthreads_set(emntDefault, g_nthreads);
+            gmx_omp_nthreads_set(emntNonbonded, g_nthreads);
+            gmx_omp_nthreads_set(emntPairsearch, g_nthreads);
+            nbnxn_init_search(&nbs_, NULL, NULL, FALSE, g_nthreads);
+
+            const real nbfp[2] = { 0.0026, 2.6e-6 };
+            snew(nbat_, 1);
+            nbnxn_atomdata_init(NULL, nbat_, gridKernelType(),
+                                enbnxninitcombruleNONE, 1, nbfp, 1, 1,
+                                NULL, NULL);
+        }
+
+        //! Returns the time per grid construction in ms with \p nthreads threads.
+        double timeGrid(int nthreads)
+        {
+            rvec   corner0, corner1;
+            double t0;
+
+            clear_rvec(corner0);
+            for (int d = 0; d < DIM; d++)
+            {
+                corner1[d] = box_[d][d];
+            }
+            gmx_omp_nthreads_set(emntPairsearch, nthreads);
+
+            /* One call to allocate the grid and work arrays */
+            putOnGrid(corner0, corner1);
+            t0 = gmx_gettime();
+            for (int call = 0; call < g_ncalls; call++)
+            {
+                putOnGrid(corner0, corner1);
+            }
+
+            return (gmx_gettime() - t0)*1e3/g_ncalls;
+        }
+
+        //! Puts all atoms on the local grid, as in do_force().
+        void putOnGrid(rvec corner0, rvec corner1)
+        {
+            nbnxn_put_on_grid(nbs_, epbcXYZ, box_, 0, corner0, corner1,
+                              0, g_natoms, -1, &atinfo_[0],
+                              reinterpret_cast<rvec *>(&x_[0]),
+                              0, NULL, gridKernelType(), nbat_);
+        }
+
+        //! Returns the order of the atoms on the grid.
+        std::vector<int> atomOrder()
+        {
+            int *a, n;
+
+            nbnxn_get_atomorder(nbs_, &a, &n);
+
+            return std::vector<int>(a, a + n);
+        }
+
+        //! Atom coordinates.
+        std::vector<real>  x_;
+        //! Atom information flags.
+        std::vector<int>   atinfo_;
+        //! Cubic box.
+        matrix             box_;
+        //! Pair search data.
+        nbnxn_search_t     nbs_;
+        //! Non-bonded atom data.
+        nbnxn_atomdata_t  *nbat_;
+};
+
+TEST_F(GridBenchmark, ThreadScaling)
+{
+    std::vector<int> orderSerial;
+    double           tSerial = 0;
+
+    std::printf("Grid construction for %d atoms, for the %s kernels\n",
+                g_natoms, lookup_nbnxn_kernel_name(gridKernelType()));
+    for (int nthreads = 1; nthreads <= g_nthreads; nthreads *= 2)
+    {
+        double t = timeGrid(nthreads);
+        if (nthreads == 1)
+        {
+            tSerial     = t;
+            orderSerial = atomOrder();
+        }
+        else
+        {
+            EXPECT_EQ(orderSerial, atomOrder())
+            << "Atom order differs with " << nthreads << " threads";
+        }
+        std::printf("%3d threads: %8.3f ms per grid construction, speed-up %5.2f\n",
+                    nthreads, t, tSerial/t);
+    }
+}
+
+} // namespace
@@ -0,0 +1,342 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for LINCS.
+ *
+ * The constraints are set up such that the number of constraints is not
+ * a multiple of the SIMD width, with coupled constraints and a triangle,
+ * and the results are checked against the properties the LINCS solution
+ * should have.
+ *
+ * \ingroup module_mdlib
+ */
+#include <cmath>
+#include <cstring>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/legacyheaders/constr.h"
+#include "gromacs/legacyheaders/gmx_omp_nthreads.h"
+#include "gromacs/legacyheaders/nrnb.h"
+#include "gromacs/legacyheaders/typedefs.h"
+#include "gromacs/legacyheaders/types/commrec.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/topology/block.h"
+#include "gromacs/utility/smalloc.h"
+
+namespace
+{
+
+//! Time step.
+const real c_dt = 0.002;
+
+/*! \brief
+ * Test fixture for LINCS.
+ *
+ * Sets up a few methane-like molecules, chains, a constraint triangle
+ * and single constraints, all in one molecule type.
+ */
+class LincsTest : public ::testing::Test
+{
+    public:
+        LincsTest()
+        {
+            addMethane(0.3, 0.3, 0.3);
+            addMethane(0.8, 0.3, 0.3);
+            addMethane(0.3, 0.8, 0.3);
+            addChain(0.3, 0.3, 0.8, 5);
+            addChain(0.8, 0.8, 0.8, 5);
+            addTriangle(1.3, 0.3, 0.3);
+            addChain(1.3, 0.8, 0.3, 2);
+            addChain(1.3, 0.3, 0.8, 2);
+            addChain(1.3, 0.8, 0.8, 2);
+
+            const int natoms = numAtoms();
+            for (int i = 0; i < natoms*DIM; i++)
+            {
+                real disp = 0.003*std::sin(1.3*i + 0.2);
+
+                xprime_.push_back(x_[i] + disp);
+                v_.push_back(disp/c_dt);
+            }
+
+            std::memset(&ir_, 0, sizeof(ir_));
+            ir_.eI             = eiMD;
+            ir_.efep           = efepNO;
+            ir_.delta_t        = c_dt;
+            ir_.LincsWarnAngle = 30;
+
+            std::memset(&md_, 0, sizeof(md_));
+            md_.nr      = natoms;
+            md_.homenr  = natoms;
+            md_.invmass = &invmass_[0];
+
+            std::memset(&cr_, 0, sizeof(cr_));
+            cr_.nnodes = 1;
+
+            std::memset(ilist_, 0, sizeof(ilist_));
+            ilist_[F_CONSTR].nr     = iatoms_.size();
+            ilist_[F_CONSTR].iatoms = &iatoms_[0];
+
+            std::memset(&idef_, 0, sizeof(idef_));
+            idef_.ntypes       = iparams_.size();
+            idef_.iparams      = &iparams_[0];
+            idef_.il[F_CONSTR] = ilist_[F_CONSTR];
+
+            std::memset(&moltype_, 0, sizeof(moltype_));
+            moltype_.ilist[F_CONSTR] = ilist_[F_CONSTR];
+            std::memset(&molblock_, 0, sizeof(molblock_));
+            molblock_.type = 0;
+            molblock_.nmol = 1;
+            std::memset(&mtop_, 0, sizeof(mtop_));
+            mtop_.nmoltype  = 1;
+            mtop_.moltype   = &moltype_;
+            mtop_.nmolblock = 1;
+            mtop_.molblock  = &molblock_;
+        }
+
+        //! Returns the number of atoms.
+        int numAtoms() const { return invmass_.size(); }
+
+        //! Adds an atom with position (x, y, z) and mass m.
+        int addAtom(real x, real y, real z, real m)
+        {
+            x_.push_back(x);
+            x_.push_back(y);
+            x_.push_back(z);
+            invmass_.push_back(1/m);
+
+            return numAtoms() - 1;
+        }
+
+        //! Adds a constraint with the current distance of atoms a1 and a2.
+        void addConstraint(int a1, int a2)
+        {
+            t_iparams ip;
+            rvec      dx;
+
+            for (int d = 0; d < DIM; d++)
+            {
+                dx[d] = x_[a1*DIM + d] - x_[a2*DIM + d];
+            }
+            std::memset(&ip, 0, sizeof(ip));
+            ip.constr.dA = norm(dx);
+            ip.constr.dB = ip.constr.dA;
+            iatoms_.push_back(iparams_.size());
+            iatoms_.push_back(a1);
+            iatoms_.push_back(a2);
+            iparams_.push_back(ip);
+        }
+
+        //! Adds a methane-like molecule with the carbon at (x, y, z).
+        void addMethane(real x, real y, real z)
+        {
+            const real b = 0.109/std::sqrt(3.0);
+            int        c = addAtom(x, y, z, 12.011);
+
+            addConstraint(c, addAtom(x + b, y + b, z + b, 1.008));
+            addConstraint(c, addAtom(x - b, y - b, z + b, 1.008));
+            addConstraint(c, addAtom(x - b, y + b, z - b, 1.008));
+            addConstraint(c, addAtom(x + b, y - b, z - b, 1.008));
+        }
+
+        //! Adds a zig-zag chain of n atoms starting at (x, y, z).
+        void addChain(real x, real y, real z, int n)
+        {
+            int prev = addAtom(x, y, z, 14.027);
+
+            for (int i = 1; i < n; i++)
+            {
+                int a = addAtom(x + 0.125*i, y + 0.09*(i % 2), z + 0.01*i, 14.027);
+
+                addConstraint(prev, a);
+                prev = a;
+            }
+        }
+
+        //! Adds a rigid triangle of constraints with the first atom at (x, y, z).
+        void addTriangle(real x, real y, real z)
+        {
+            int a1 = addAtom(x, y, z, 14.007);
+            int a2 = addAtom(x + 0.1, y, z, 1.008);
+            int a3 = addAtom(x + 0.05, y + 0.09, z, 1.008);
+
+            addConstraint(a1, a2);
+            addConstraint(a1, a3);
+            addConstraint(a2, a3);
+        }
+
+        //! Returns the coordinate vector \p x as an rvec array.
+        static rvec *asRvec(std::vector<real> *x)
+        {
+            return reinterpret_cast<rvec *>(&(*x)[0]);
+        }
+
+        /*! \brief
+         * Constrains xprime and v with LINCS using \p nthreads threads.
+         */
+        void runLincs(int nthreads, int nOrder, int nIter,
+                      std::vector<real> *xp, std::vector<real> *v,
+                      tensor vir_r_m_dr)
+        {
+            const int natoms = numAtoms();
+            t_blocka  at2con;
+            int       nflexcon, warncount = 0;
+            real      dvdlambda = 0;
+            matrix    box;
+            t_nrnb    nrnb;
+
+            gmx_omp_nthreads_set(emntLINCS, nthreads);
+
+            at2con = make_at2con(0, natoms, ilist_, &iparams_[0], TRUE, &nflexcon);
+            gmx_lincsdata_t lincsd = init_lincs(NULL, &mtop_, nflexcon, &at2con,
+                                                FALSE, nIter, nOrder);
+            set_lincs(&idef_, &md_, TRUE, &cr_, lincsd);
+
+            std::vector<real> x(x_);
+            *xp = xprime_;
+            *v  = v_;
+
+            clear_mat(box);
+            clear_mat(vir_r_m_dr);
+            init_nrnb(&nrnb);
+            EXPECT_TRUE(constrain_lincs(NULL, FALSE, FALSE, &ir_, 0, lincsd, &md_, &cr_,
+                                        asRvec(&x), asRvec(xp), NULL, box, NULL,
+                                        0, &dvdlambda, 1/c_dt, asRvec(v),
+                                        TRUE, vir_r_m_dr, econqCoord, &nrnb,
+                                        -1, &warncount));
+
+            done_blocka(&at2con);
+        }
+
+        //! Checks the LINCS solution for the given expansion order and iterations.
+        void checkLincs(int nthreads, int nOrder, int nIter, real relTolerance)
+        {
+            std::vector<real> xp, v;
+            tensor            vir_r_m_dr, vir_ref;
+            rvec              momentum;
+
+            runLincs(nthreads, nOrder, nIter, &xp, &v, vir_r_m_dr);
+
+            for (size_t c = 0; c < iparams_.size(); c++)
+            {
+                rvec dx;
+
+                rvec_sub(asRvec(&xp)[iatoms_[c*3 + 1]], asRvec(&xp)[iatoms_[c*3 + 2]], dx);
+                EXPECT_NEAR(1, norm(dx)/iparams_[c].constr.dA, relTolerance)
+                << "constraint " << c;
+            }
+
+            /* The constraint displacements should not change the momentum,
+             * should match the velocity changes and give the virial.
+             */
+            clear_rvec(momentum);
+            clear_mat(vir_ref);
+            for (int i = 0; i < numAtoms(); i++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    real dx  = xp[i*DIM + d] - xprime_[i*DIM + d];
+                    real mdx = dx/invmass_[i];
+
+                    momentum[d] += mdx;
+                    EXPECT_NEAR(v_[i*DIM + d] + dx/c_dt, v[i*DIM + d], 1e-5/c_dt)
+                    << "atom " << i;
+                    for (int d2 = 0; d2 < DIM; d2++)
+                    {
+                        vir_ref[d2][d] -= x_[i*DIM + d2]*mdx;
+                    }
+                }
+            }
+            for (int d = 0; d < DIM; d++)
+            {
+                EXPECT_NEAR(0, momentum[d], 1e-5);
+                for (int d2 = 0; d2 < DIM; d2++)
+                {
+                    EXPECT_NEAR(vir_ref[d][d2], vir_r_m_dr[d][d2], 1e-5)
+                    << "virial element " << d << " " << d2;
+                }
+            }
+        }
+
+        //! Coordinates satisfying the constraints.
+        std::vector<real>                   x_;
+        //! Unconstrained updated coordinates.
+        std::vector<real>                   xprime_;
+        //! Unconstrained velocities.
+        std::vector<real>                   v_;
+        //! Inverse masses.
+        std::vector<real>                   invmass_;
+        //! Constraint interaction list.
+        std::vector<t_iatom>                iatoms_;
+        //! Constraint parameters, one type per constraint.
+        std::vector<t_iparams>              iparams_;
+        //! Interaction lists for the molecule type.
+        t_ilist                             ilist_[F_NRE];
+        //! Local topology.
+        t_idef                              idef_;
+        //! The molecule type.
+        gmx_moltype_t                       moltype_;
+        //! The molecule block.
+        gmx_molblock_t                      molblock_;
+        //! The global topology.
+        gmx_mtop_t                          mtop_;
+        //! Input parameters.
+        t_inputrec                          ir_;
+        //! Atom data.
+        t_mdatoms                           md_;
+        //! Communication record.
+        t_commrec                           cr_;
+};
+
+TEST_F(LincsTest, ConstrainsAccurately)
+{
+    checkLincs(1, 8, 4, 1e-5);
+}
+
+TEST_F(LincsTest, ConstrainsWithDefaultSettings)
+{
+    checkLincs(1, 4, 1, 1e-3);
+}
+
+TEST_F(LincsTest, ConstrainsWithThreads)
+{
+    checkLincs(3, 8, 4, 1e-5);
+}
+
+} // namespace
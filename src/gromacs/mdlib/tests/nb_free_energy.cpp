@@ -0,0 +1,380 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the SIMD soft-core free-energy kernel, comparing it with the
+ * plain C reference kernel.
+ *
+ * The SIMD kernel computes the Ewald correction analytically, whereas the
+ * reference kernel uses quadratic spline tables, so with Ewald the results
+ * only agree within the table accuracy of about 1e-4 relative in the force.
+ *
+ * \ingroup module_mdlib
+ */
+#include <cmath>
+#include <cstring>
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/gmxlib/nonbonded/nb_free_energy.h"
+#include "gromacs/legacyheaders/coulomb.h"
+#include "gromacs/legacyheaders/nonbonded.h"
+#include "gromacs/legacyheaders/nrnb.h"
+#include "gromacs/legacyheaders/tables.h"
+#include "gromacs/legacyheaders/typedefs.h"
+#include "gromacs/math/units.h"
+#include "gromacs/math/utilities.h"
+#include "gromacs/pbcutil/ishift.h"
+#include "gromacs/utility/smalloc.h"
+
+namespace
+{
+
+//! Output of a free-energy kernel call.
+struct FreeEnergyKernelOutput
+{
+    //! Forces.
+    std::vector<real> f;
+    //! Shift forces.
+    std::vector<real> fshift;
+    //! Coulomb energies per energy group pair.
+    std::vector<real> vCoul;
+    //! Van der Waals energies per energy group pair.
+    std::vector<real> vVdw;
+    //! dV/dlambda for the Coulomb and Van der Waals components.
+    real              dvdl[efptNR];
+};
+
+/*! \brief
+ * Test fixture with a small system containing perturbed atoms that
+ * appear, disappear and change charge, with the pair list as generated
+ * for the Verlet scheme.
+ */
+class FreeEnergyKernelTest : public ::testing::Test
+{
+    public:
+        //! Number of atoms in the test system.
+        static const int c_numAtoms     = 16;
+        //! Number of perturbed atoms, the first atoms in the system.
+        static const int c_numPerturbed = 3;
+        //! Number of atom types.
+        static const int c_numTypes     = 3;
+        //! Number of energy group pairs.
+        static const int c_numEnergyGroupPairs = 2;
+
+        FreeEnergyKernelTest()
+        {
+            const real rc      = 0.9;
+            const real sigma[] = { 0.3, 0.0, 0.25 };
+            const real eps[]   = { 0.5, 0.0, 0.3 };
+
+            std::memset(&fr_, 0, sizeof(fr_));
+            std::memset(&ic_, 0, sizeof(ic_));
+            std::memset(&mdatoms_, 0, sizeof(mdatoms_));
+            std::memset(&nlist_, 0, sizeof(nlist_));
+
+            // Atoms on a distorted lattice with spacing 0.3 nm
+            x_.resize(c_numAtoms*DIM);
+            qA_.resize(c_numAtoms);
+            qB_.resize(c_numAtoms);
+            typeA_.resize(c_numAtoms);
+            typeB_.resize(c_numAtoms);
+            for (int i = 0; i < c_numAtoms; i++)
+            {
+                x_[i*DIM + XX] = 0.3*(i % 4) + 0.1*std::fmod(i*0.618033988749895, 1.0);
+                x_[i*DIM + YY] = 0.3*((i/4) % 2) + 0.1*std::fmod(i*0.754877666246693, 1.0);
+                x_[i*DIM + ZZ] = 0.3*(i/8) + 0.1*std::fmod(i*0.569840290998053, 1.0);
+                qA_[i]         = (i % 2 == 0 ? 0.3 : -0.3);
+                qB_[i]         = qA_[i];
+                typeA_[i]      = (i % 3 == 0 ? 2 : 0);
+                typeB_[i]      = typeA_[i];
+            }
+            // A disappearing atom
+            qA_[0]    = -0.5;
+            qB_[0]    = 0;
+            typeA_[0] = 0;
+            typeB_[0] = 1;
+            // An atom changing charge
+            qA_[1]    = 0.4;
+            qB_[1]    = -0.2;
+            typeA_[1] = 2;
+            typeB_[1] = 2;
+            // An appearing atom
+            qA_[2]    = 0;
+            qB_[2]    = 0.3;
+            typeA_[2] = 1;
+            typeB_[2] = 0;
+
+            // Geometric combination rule, c6 and c12 stored with factors 6 and 12
+            nbfp_.resize(2*c_numTypes*c_numTypes);
+            for (int ti = 0; ti < c_numTypes; ti++)
+            {
+                for (int tj = 0; tj < c_numTypes; tj++)
+                {
+                    real sig = std::sqrt(sigma[ti]*sigma[tj]);
+                    real ep  = std::sqrt(eps[ti]*eps[tj]);
+                    real c6  = 4*ep*std::pow(sig, 6);
+
+                    nbfp_[2*(ti*c_numTypes + tj)]     = 6*c6;
+                    nbfp_[2*(ti*c_numTypes + tj) + 1] = 12*c6*std::pow(sig, 6);
+                }
+            }
+
+            // Each perturbed atom interacts with itself (excluded), with
+            // the perturbed atoms after it and with all other atoms.
+            // The pair 0-1 is excluded.
+            for (int i = 0; i < c_numPerturbed; i++)
+            {
+                iinr_.push_back(i);
+                shift_.push_back(CENTRAL);
+                gid_.push_back(i == 0 ? 0 : 1);
+                jindex_.push_back(jjnr_.size());
+                for (int j = i; j < c_numAtoms; j++)
+                {
+                    jjnr_.push_back(j);
+                    exclFep_.push_back((j == i || (i == 0 && j == 1)) ? 0 : 1);
+                }
+            }
+            jindex_.push_back(jjnr_.size());
+
+            nlist_.nri      = iinr_.size();
+            nlist_.iinr     = &iinr_[0];
+            nlist_.jindex   = &jindex_[0];
+            nlist_.jjnr     = &jjnr_[0];
+            nlist_.shift    = &shift_[0];
+            nlist_.gid      = &gid_[0];
+            nlist_.excl_fep = &exclFep_[0];
+
+            mdatoms_.chargeA = &qA_[0];
+            mdatoms_.chargeB = &qB_[0];
+            mdatoms_.typeA   = &typeA_[0];
+            mdatoms_.typeB   = &typeB_[0];
+
+            shiftVec_.assign(SHIFTS*DIM, 0);
+
+            fr_.ic               = &ic_;
+            fr_.use_simd_kernels = TRUE;
+            fr_.cutoff_scheme    = ecutsVERLET;
+            fr_.epsfac           = ONE_4PI_EPS0;
+            fr_.ntype            = c_numTypes;
+            fr_.nbfp             = &nbfp_[0];
+            fr_.shift_vec        = reinterpret_cast<rvec *>(&shiftVec_[0]);
+            fr_.rcoulomb         = rc;
+            fr_.rvdw             = rc;
+            fr_.coulomb_modifier = eintmodPOTSHIFT;
+            fr_.vdw_modifier     = eintmodPOTSHIFT;
+            fr_.sc_alphacoul     = 0.5;
+            fr_.sc_alphavdw      = 0.5;
+            fr_.sc_power         = 1;
+            fr_.sc_r_power       = 6.0;
+            fr_.sc_sigma6_def    = std::pow(0.3, 6);
+            fr_.sc_sigma6_min    = std::pow(0.28, 6);
+
+            ic_.rcoulomb         = rc;
+            ic_.rvdw             = rc;
+            ic_.vdwtype          = evdwCUT;
+            ic_.vdw_modifier     = eintmodPOTSHIFT;
+            ic_.coulomb_modifier = eintmodPOTSHIFT;
+            ic_.sh_invrc6        = 1/std::pow(rc, 6);
+        }
+        ~FreeEnergyKernelTest()
+        {
+            sfree_aligned(ic_.tabq_coul_FDV0);
+            sfree_aligned(ic_.tabq_coul_F);
+            sfree_aligned(ic_.tabq_coul_V);
+        }
+
+        //! Sets up reaction-field electrostatics with infinite epsilon-rf.
+        void setReactionField()
+        {
+            const real rc = fr_.rcoulomb;
+
+            fr_.eeltype  = eelRF;
+            ic_.eeltype  = eelRF;
+            fr_.k_rf     = 1/(2*rc*rc*rc);
+            fr_.c_rf     = 1/rc + fr_.k_rf*rc*rc;
+        }
+        //! Sets up PME electrostatics with Ewald correction tables.
+        void setEwald()
+        {
+            const real rc = fr_.rcoulomb;
+
+            fr_.eeltype       = eelPME;
+            ic_.eeltype       = eelPME;
+            ic_.ewaldcoeff_q  = calc_ewaldcoeff_q(rc, 1e-5);
+            ic_.sh_ewald      = gmx_erfc(ic_.ewaldcoeff_q*rc)/rc;
+            ic_.tabq_scale    = ewald_spline3_table_scale(ic_.ewaldcoeff_q, rc);
+            ic_.tabq_size     = static_cast<int>(rc*ic_.tabq_scale) + 2;
+            snew_aligned(ic_.tabq_coul_FDV0, ic_.tabq_size*4, 32);
+            snew_aligned(ic_.tabq_coul_F, ic_.tabq_size, 32);
+            snew_aligned(ic_.tabq_coul_V, ic_.tabq_size, 32);
+            table_spline3_fill_ewald_lr(ic_.tabq_coul_F, ic_.tabq_coul_V, ic_.tabq_coul_FDV0,
+                                        ic_.tabq_size, 1/ic_.tabq_scale, ic_.ewaldcoeff_q,
+                                        v_q_ewald_lr);
+        }
+
+        /*! \brief
+         * Runs one of the kernels.
+         *
+         * \param[in]  bSimd   Whether to run the SIMD or the reference kernel.
+         * \param[in]  lambda  Coulomb and Van der Waals lambda.
+         * \param[out] out     Kernel output.
+         */
+        void runKernel(bool bSimd, real lambda, FreeEnergyKernelOutput *out)
+        {
+            nb_kernel_data_t kernelData;
+            t_nrnb           nrnb;
+            real             lambdas[efptNR];
+
+            out->f.assign(c_numAtoms*DIM, 0);
+            out->fshift.assign(SHIFTS*DIM, 0);
+            out->vCoul.assign(c_numEnergyGroupPairs, 0);
+            out->vVdw.assign(c_numEnergyGroupPairs, 0);
+            for (int i = 0; i < efptNR; i++)
+            {
+                lambdas[i]   = lambda;
+                out->dvdl[i] = 0;
+            }
+            fr_.fshift = reinterpret_cast<rvec *>(&out->fshift[0]);
+            init_nrnb(&nrnb);
+
+            std::memset(&kernelData, 0, sizeof(kernelData));
+            kernelData.flags          = GMX_NONBONDED_DO_FORCE | GMX_NONBONDED_DO_SHIFTFORCE | GMX_NONBONDED_DO_POTENTIAL;
+            kernelData.lambda         = lambdas;
+            kernelData.dvdl           = out->dvdl;
+            kernelData.energygrp_elec = &out->vCoul[0];
+            kernelData.energygrp_vdw  = &out->vVdw[0];
+
+            rvec *x = reinterpret_cast<rvec *>(&x_[0]);
+            rvec *f = reinterpret_cast<rvec *>(&out->f[0]);
+            if (bSimd)
+            {
+                gmx_nb_free_energy_kernel_simd(&nlist_, x, f, &fr_, &mdatoms_, &kernelData, &nrnb);
+            }
+            else
+            {
+                gmx_nb_free_energy_kernel_ref(&nlist_, x, f, &fr_, &mdatoms_, &kernelData, &nrnb);
+            }
+        }
+
+        /*! \brief
+         * Checks that the SIMD kernel reproduces the reference kernel.
+         *
+         * \param[in] relTolerance  Tolerance relative to the maximum
+         *     energy and force.
+         */
+        void testAgainstReference(real relTolerance)
+        {
+            if (!gmx_nb_free_energy_kernel_simd_supported(&fr_))
+            {
+                // Nothing to compare without SIMD support
+                return;
+            }
+            const real lambdas[] = { 0, 0.3, 1 };
+            for (size_t l = 0; l < sizeof(lambdas)/sizeof(lambdas[0]); l++)
+            {
+                FreeEnergyKernelOutput ref, simd;
+
+                SCOPED_TRACE(testing::Message() << "lambda " << lambdas[l]);
+                runKernel(false, lambdas[l], &ref);
+                runKernel(true, lambdas[l], &simd);
+
+                real vMax = 0;
+                for (int g = 0; g < c_numEnergyGroupPairs; g++)
+                {
+                    vMax = std::max(vMax, std::fabs(ref.vCoul[g]));
+                    vMax = std::max(vMax, std::fabs(ref.vVdw[g]));
+                }
+                ASSERT_NE(0, vMax);
+                for (int g = 0; g < c_numEnergyGroupPairs; g++)
+                {
+                    EXPECT_NEAR(ref.vCoul[g], simd.vCoul[g], relTolerance*vMax);
+                    EXPECT_NEAR(ref.vVdw[g], simd.vVdw[g], relTolerance*vMax);
+                }
+                EXPECT_NEAR(ref.dvdl[efptCOUL], simd.dvdl[efptCOUL], relTolerance*vMax);
+                EXPECT_NEAR(ref.dvdl[efptVDW], simd.dvdl[efptVDW], relTolerance*vMax);
+
+                real fMax = 0;
+                for (size_t i = 0; i < ref.f.size(); i++)
+                {
+                    fMax = std::max(fMax, std::fabs(ref.f[i]));
+                }
+                ASSERT_NE(0, fMax);
+                for (size_t i = 0; i < ref.f.size(); i++)
+                {
+                    EXPECT_NEAR(ref.f[i], simd.f[i], relTolerance*fMax);
+                }
+                for (size_t i = 0; i < ref.fshift.size(); i++)
+                {
+                    EXPECT_NEAR(ref.fshift[i], simd.fshift[i], relTolerance*fMax);
+                }
+            }
+        }
+
+        t_forcerec          fr_;
+        interaction_const_t ic_;
+        t_mdatoms           mdatoms_;
+        t_nblist            nlist_;
+        std::vector<real>   x_;
+        std::vector<real>   qA_;
+        std::vector<real>   qB_;
+        std::vector<int>    typeA_;
+        std::vector<int>    typeB_;
+        std::vector<real>   nbfp_;
+        std::vector<real>   shiftVec_;
+        std::vector<int>    iinr_;
+        std::vector<int>    jindex_;
+        std::vector<int>    jjnr_;
+        std::vector<int>    shift_;
+        std::vector<int>    gid_;
+        std::vector<char>   exclFep_;
+};
+
+TEST_F(FreeEnergyKernelTest, ReactionFieldMatchesReference)
+{
+    setReactionField();
+    testAgainstReference(1e-5);
+}
+
+TEST_F(FreeEnergyKernelTest, EwaldMatchesReference)
+{
+    setEwald();
+    testAgainstReference(2e-4);
+}
+
+} // namespace
@@ -0,0 +1,338 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the dynamic pruning kernels of the nbnxn pair lists.
+ *
+ * Builds an outer pair list for a small system with pseudo-random
+ * coordinates and checks that the SIMD prune kernels produce exactly
+ * the same inner list as the plain C reference kernel.
+ *
+ * \ingroup module_mdlib
+ */
+#include <cmath>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/legacyheaders/gmx_omp_nthreads.h"
+#include "gromacs/legacyheaders/nrnb.h"
+#include "gromacs/legacyheaders/typedefs.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/mdlib/nbnxn_atomdata.h"
+#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_prune.h"
+#include "gromacs/mdlib/nbnxn_search.h"
+#include "gromacs/mdlib/nbnxn_simd.h"
+#include "gromacs/pbcutil/ishift.h"
+#include "gromacs/pbcutil/pbc.h"
+#include "gromacs/utility/smalloc.h"
+
+namespace
+{
+
+//! Number of atoms in the test system, as 3-atom molecules.
+const int  c_natoms     = 3000;
+//! Number of non-bonded threads, and thus of pair lists.
+const int  c_nthreads   = 2;
+//! Cut-off of the outer list.
+const real c_rlistOuter = 1.0;
+//! Cut-off of the inner list.
+const real c_rlistInner = 0.8;
+
+//! The i-cluster entries of a pruned list.
+typedef std::vector<nbnxn_ci_t> CiList;
+//! The j-cluster entries, with exclusion masks, of a pruned list.
+typedef std::vector<nbnxn_cj_t> CjList;
+
+/*! \brief
+ * Test fixture with a system of 3-atom molecules at the density of water,
+ * with pseudo-random positions in a cubic box and exclusions within
+ * molecules.
+ */
+class NbnxnPruneTest : public ::testing::Test
+{
+    public:
+        NbnxnPruneTest() : x_(c_natoms*DIM), atinfo_(c_natoms)
+        {
+            real         length = std::pow(c_natoms/100.0, 1.0/3.0);
+            unsigned int seed   = 1993;
+
+            clear_mat(box_);
+            for (int d = 0; d < DIM; d++)
+            {
+                box_[d][d] = length;
+            }
+            for (int i = 0; i < c_natoms; i++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    /* Linear congruential generator, reproducible on all platforms */
+                    seed          = seed*1664525U + 1013904223U;
+                    x_[i*DIM + d] = length*(seed >> 8)/static_cast<real>(1U << 24);
+                    if (i % 3 != 0)
+                    {
+                        /* Put the other atoms of a molecule close to the first */
+                        x_[i*DIM + d] = x_[(i - i % 3)*DIM + d] + 0.1*(seed >> 8)/static_cast<real>(1U << 24);
+                    }
+                }
+                atinfo_[i] = 0;
+                SET_CGINFO_HAS_VDW(atinfo_[i]);
+                SET_CGINFO_HAS_Q(atinfo_[i]);
+            }
+
+            /* Each atom excludes itself and the other atoms in its molecule */
+            excls_.nr           = c_natoms;
+            excls_.nra          = c_natoms*3;
+            excls_.nalloc_index = c_natoms + 1;
+            excls_.nalloc_a     = c_natoms*3;
+            snew(excls_.index, excls_.nalloc_index);
+            snew(excls_.a, excls_.nalloc_a);
+            for (int i = 0; i < c_natoms; i++)
+            {
+                excls_.index[i] = i*3;
+                for (int j = 0; j < 3; j++)
+                {
+                    excls_.a[i*3 + j] = i - i % 3 + j;
+                }
+            }
+            excls_.index[c_natoms] = c_natoms*3;
+
+            gmx_omp_nthreads_set(emntDefault, c_nthreads);
+            gmx_omp_nthreads_set(emntNonbonded, c_nthreads);
+            gmx_omp_nthreads_set(emntPairsearch, c_nthreads);
+        }
+
+        ~NbnxnPruneTest()
+        {
+            sfree(excls_.index);
+            sfree(excls_.a);
+        }
+
+        /*! \brief
+         * Builds the outer pair lists for the layout of \p kernelType
+         * in nbl_list_ and the atom data in nbat_.
+         */
+        void makeOuterList(int kernelType)
+        {
+            nbnxn_search_t nbs;
+            rvec           corner0, corner1;
+            rvec           shift_vec[SHIFTS];
+            t_nrnb         nrnb;
+
+            nbnxn_init_search(&nbs, NULL, NULL, FALSE, c_nthreads);
+
+            const real nbfp[2] = { 0.0026, 2.6e-6 };
+            snew(nbat_, 1);
+            nbnxn_atomdata_init(NULL, nbat_, kernelType,
+                                enbnxninitcombruleNONE, 1, nbfp, 1, 1,
+                                NULL, NULL);
+
+            clear_rvec(corner0);
+            for (int d = 0; d < DIM; d++)
+            {
+                corner1[d] = box_[d][d];
+            }
+            nbnxn_put_on_grid(nbs, epbcXYZ, box_, 0, corner0, corner1,
+                              0, c_natoms, -1, &atinfo_[0],
+                              reinterpret_cast<rvec *>(&x_[0]),
+                              0, NULL, kernelType, nbat_);
+
+            calc_shifts(box_, shift_vec);
+            nbnxn_atomdata_copy_shiftvec(FALSE, shift_vec, nbat_);
+
+            nbnxn_init_pairlist_set(&nbl_list_, TRUE, FALSE, NULL, NULL);
+            init_nrnb(&nrnb);
+            nbnxn_make_pairlist(nbs, nbat_, &excls_, c_rlistOuter, 0,
+                                &nbl_list_, eintLocal, kernelType, &nrnb);
+            nbnxn_pairlist_set_outer(&nbl_list_);
+        }
+
+        //! Prunes list \p l with \p pruneKernel and returns the inner list.
+        void prune(int l,
+                   void (*pruneKernel)(nbnxn_pairlist_t *,
+                                       const nbnxn_atomdata_t *,
+                                       const rvec *, real),
+                   CiList *ci, CjList *cj)
+        {
+            nbnxn_pairlist_t *nbl = nbl_list_.nbl[l];
+
+            pruneKernel(nbl, nbat_, reinterpret_cast<const rvec *>(nbat_->shift_vec),
+                        c_rlistInner);
+            ci->assign(nbl->ci, nbl->ci + nbl->nci);
+            cj->assign(nbl->cj, nbl->cj + nbl->ncj);
+        }
+
+        /*! \brief
+         * Checks that \p pruneKernel gives the same inner lists as
+         * the reference kernel for the list layout of \p kernelType.
+         */
+        void runTest(int kernelType,
+                     void (*pruneKernel)(nbnxn_pairlist_t *,
+                                         const nbnxn_atomdata_t *,
+                                         const rvec *, real))
+        {
+            int ncjOuter = 0, ncjInner = 0;
+
+            makeOuterList(kernelType);
+            ASSERT_EQ(c_nthreads, nbl_list_.nnbl);
+            for (int l = 0; l < nbl_list_.nnbl; l++)
+            {
+                CiList ciRef, ciTest;
+                CjList cjRef, cjTest;
+
+                prune(l, nbnxn_kernel_prune_ref, &ciRef, &cjRef);
+                prune(l, pruneKernel, &ciTest, &cjTest);
+
+                ASSERT_EQ(ciRef.size(), ciTest.size()) << "in list " << l;
+                for (size_t i = 0; i < ciRef.size(); i++)
+                {
+                    EXPECT_EQ(ciRef[i].ci, ciTest[i].ci) << "for entry " << i;
+                    EXPECT_EQ(ciRef[i].shift, ciTest[i].shift) << "for entry " << i;
+                    EXPECT_EQ(ciRef[i].cj_ind_start, ciTest[i].cj_ind_start) << "for entry " << i;
+                    EXPECT_EQ(ciRef[i].cj_ind_end, ciTest[i].cj_ind_end) << "for entry " << i;
+                }
+                ASSERT_EQ(cjRef.size(), cjTest.size()) << "in list " << l;
+                for (size_t j = 0; j < cjRef.size(); j++)
+                {
+                    EXPECT_EQ(cjRef[j].cj, cjTest[j].cj) << "for entry " << j;
+                    EXPECT_EQ(cjRef[j].excl, cjTest[j].excl) << "for entry " << j;
+                    for (int m = 0; m < 4; m++)
+                    {
+                        EXPECT_EQ(cjRef[j].interaction_mask_indices[m],
+                                  cjTest[j].interaction_mask_indices[m]) << "for entry " << j;
+                    }
+                }
+
+                ncjOuter += nbl_list_.nbl[l]->ncj_outer;
+                ncjInner += cjRef.size();
+            }
+            /* The test is only useful when some, but not all, pairs are pruned */
+            EXPECT_GT(ncjInner, 0);
+            EXPECT_LT(ncjInner, ncjOuter);
+        }
+
+        //! Atom coordinates.
+        std::vector<real>      x_;
+        //! Atom information flags.
+        std::vector<int>       atinfo_;
+        //! Exclusions.
+        t_blocka               excls_;
+        //! Cubic box.
+        matrix                 box_;
+        //! Non-bonded atom data.
+        nbnxn_atomdata_t      *nbat_;
+        //! The pair lists, one per thread.
+        nbnxn_pairlist_set_t   nbl_list_;
+};
+
+TEST_F(NbnxnPruneTest, ReferenceKernelKeepsPairsWithinInnerCutoff)
+{
+    int ncjOuter = 0, ncjInner = 0;
+
+    makeOuterList(nbnxnk4x4_PlainC);
+    /* The plain C layout stores the coordinates of each atom contiguously */
+    ASSERT_TRUE(nbat_->XFormat == nbatXYZ || nbat_->XFormat == nbatXYZQ);
+    for (int l = 0; l < nbl_list_.nnbl; l++)
+    {
+        nbnxn_pairlist_t *nbl = nbl_list_.nbl[l];
+        const rvec       *shift_vec;
+        int               n, cjind, inner;
+
+        shift_vec = reinterpret_cast<const rvec *>(nbat_->shift_vec);
+        nbnxn_kernel_prune_ref(nbl, nbat_, shift_vec, c_rlistInner);
+
+        /* Check each outer cluster pair with all its atom pairs */
+        inner = 0;
+        for (n = 0; n < nbl->nci_outer; n++)
+        {
+            const nbnxn_ci_t &ci = nbl->ci_outer[n];
+
+            for (cjind = ci.cj_ind_start; cjind < ci.cj_ind_end; cjind++)
+            {
+                int  cj       = nbl->cj_outer[cjind].cj;
+                bool bInRange = false;
+
+                for (int i = 0; i < nbl->na_ci; i++)
+                {
+                    for (int j = 0; j < nbl->na_cj; j++)
+                    {
+                        const real *xi = nbat_->x + (ci.ci*nbl->na_ci + i)*nbat_->xstride;
+                        const real *xj = nbat_->x + (cj*nbl->na_cj + j)*nbat_->xstride;
+                        rvec        dx;
+
+                        for (int d = 0; d < DIM; d++)
+                        {
+                            dx[d] = xi[d] + shift_vec[ci.shift & NBNXN_CI_SHIFT][d] - xj[d];
+                        }
+                        if (norm2(dx) < c_rlistInner*c_rlistInner)
+                        {
+                            bInRange = true;
+                        }
+                    }
+                }
+                if (bInRange)
+                {
+                    ASSERT_LT(inner, nbl->ncj);
+                    EXPECT_EQ(cj, nbl->cj[inner].cj);
+                    EXPECT_EQ(nbl->cj_outer[cjind].excl, nbl->cj[inner].excl);
+                    inner++;
+                }
+            }
+        }
+        EXPECT_EQ(inner, nbl->ncj);
+
+        ncjOuter += nbl->ncj_outer;
+        ncjInner += nbl->ncj;
+    }
+    EXPECT_GT(ncjInner, 0);
+    EXPECT_LT(ncjInner, ncjOuter);
+}
+
+#ifdef GMX_NBNXN_SIMD_4XN
+TEST_F(NbnxnPruneTest, Simd4xNMatchesReference)
+{
+    runTest(nbnxnk4xN_SIMD_4xN, nbnxn_kernel_prune_4xn);
+}
+#endif
+
+#ifdef GMX_NBNXN_SIMD_2XNN
+TEST_F(NbnxnPruneTest, Simd2xNNMatchesReference)
+{
+    runTest(nbnxnk4xN_SIMD_2xNN, nbnxn_kernel_prune_2xnn);
+}
+#endif
+
+} // namespace
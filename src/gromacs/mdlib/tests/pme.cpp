@@ -0,0 +1,279 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for PME.
+ *
+ * Compares the solve with the influence function computed in single
+ * precision with the full precision solve, and spreading directly on
+ * the FFT grid tiles with spreading on thread-local grids and serial PME.
+ *
+ * The float influence function is only available, and only tested, in
+ * double precision builds.
+ *
+ * \ingroup module_mdlib
+ */
+#include <cmath>
+#include <cstdlib>
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/legacyheaders/coulomb.h"
+#include "gromacs/legacyheaders/network.h"
+#include "gromacs/legacyheaders/nrnb.h"
+#include "gromacs/legacyheaders/pme.h"
+#include "gromacs/legacyheaders/typedefs.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/utility/real.h"
+#include "gromacs/utility/smalloc.h"
+
+namespace
+{
+
+//! Sets or clears the PME environment variable \p name.
+void setPmeEnv(const char *name, bool bSet)
+{
+    // TODO fix this when we have an encapsulation layer for handling
+    // environment variables
+#ifdef GMX_NATIVE_WINDOWS
+    _putenv_s(name, bSet ? "1" : "");
+#else
+    if (bSet)
+    {
+        setenv(name, "1", true);
+    }
+    else
+    {
+        unsetenv(name);
+    }
+#endif
+}
+
+//! Test fixture computing PME energies and forces for a set of charges.
+class PmeTest : public ::testing::Test
+{
+    public:
+        //! Number of charges in the test system.
+        static const int c_numAtoms = 300;
+
+        PmeTest() : cr_(init_commrec())
+        {
+            const real boxSize = 3.0;
+            const real rc      = 0.9;
+
+            init_inputrec(&ir_);
+            ir_.ePBC        = epbcXYZ;
+            ir_.coulombtype = eelPME;
+            ir_.vdwtype     = evdwCUT;
+            ir_.efep        = efepNO;
+            ir_.epsilon_r   = 1;
+            ir_.nkx         = 28;
+            ir_.nky         = 28;
+            ir_.nkz         = 28;
+            ir_.pme_order   = 4;
+
+            ewaldcoeff_ = calc_ewaldcoeff_q(rc, 1e-5);
+
+            clear_mat(box_);
+            box_[XX][XX] = boxSize;
+            box_[YY][YY] = boxSize;
+            box_[ZZ][ZZ] = boxSize;
+
+            // A neutral set of charges on quasi-random positions
+            x_.resize(c_numAtoms*DIM);
+            q_.resize(c_numAtoms);
+            for (int i = 0; i < c_numAtoms; i++)
+            {
+                x_[i*DIM + XX] = boxSize*std::fmod(0.5 + i*0.618033988749895, 1.0);
+                x_[i*DIM + YY] = boxSize*std::fmod(0.5 + i*0.754877666246693, 1.0);
+                x_[i*DIM + ZZ] = boxSize*std::fmod(0.5 + i*0.569840290998053, 1.0);
+                q_[i]          = (i % 2 == 0 ? 1 : -1);
+            }
+        }
+        ~PmeTest()
+        {
+            setPmeEnv("GMX_PME_FLOAT_INFLUENCE", false);
+            setPmeEnv("GMX_PME_NO_SPREAD_TILES", false);
+            done_inputrec(&ir_);
+            sfree(cr_);
+        }
+
+        /*! \brief Computes the PME mesh energy, virial and forces.
+         *
+         * The code paths are selected with environment variables,
+         * which should be set before calling this method.
+         *
+         * \param[in]  nthread  The number of OpenMP threads for PME
+         * \param[out] energy   The reciprocal space energy
+         * \param[out] vir      The reciprocal space virial
+         * \param[out] f        The reciprocal space forces
+         */
+        void calcPme(int nthread,
+                     real *energy, matrix vir, std::vector<real> *f)
+        {
+            gmx_pme_t pme;
+            t_nrnb    nrnb;
+            matrix    vir_lj;
+            real      energy_lj, dvdl_q, dvdl_lj;
+
+            ASSERT_EQ(0, gmx_pme_init(&pme, cr_, 1, 1, &ir_, c_numAtoms,
+                                      FALSE, FALSE, FALSE, nthread));
+            init_nrnb(&nrnb);
+
+            f->assign(c_numAtoms*DIM, 0);
+            clear_mat(vir);
+            clear_mat(vir_lj);
+            *energy   = 0;
+            energy_lj = 0;
+            dvdl_q    = 0;
+            dvdl_lj   = 0;
+            EXPECT_EQ(0, gmx_pme_do(pme, 0, c_numAtoms,
+                                    reinterpret_cast<rvec *>(&x_[0]),
+                                    reinterpret_cast<rvec *>(&(*f)[0]),
+                                    &q_[0], NULL, NULL, NULL, NULL, NULL,
+                                    box_, cr_, 0, 0, &nrnb, NULL,
+                                    vir, ewaldcoeff_, vir_lj, 0,
+                                    energy, &energy_lj, 0, 0,
+                                    &dvdl_q, &dvdl_lj,
+                                    GMX_PME_DO_ALL_F | GMX_PME_CALC_ENER_VIR | GMX_PME_DO_COULOMB));
+
+            gmx_pme_destroy(NULL, &pme);
+        }
+
+        /*! \brief Checks the energy, virial and forces against a reference.
+         *
+         * The tolerance is relative to the reference energy for the
+         * energy and virial, and relative to the largest reference force
+         * component for the forces.
+         */
+        void compare(real energyRef, const matrix virRef,
+                     const std::vector<real> &fRef,
+                     real energy, const matrix vir,
+                     const std::vector<real> &f,
+                     real relTolerance)
+        {
+            ASSERT_NE(0, energyRef);
+            EXPECT_NEAR(energyRef, energy, relTolerance*std::fabs(energyRef));
+            for (int d1 = 0; d1 < DIM; d1++)
+            {
+                for (int d2 = 0; d2 < DIM; d2++)
+                {
+                    EXPECT_NEAR(virRef[d1][d2], vir[d1][d2], relTolerance*std::fabs(energyRef));
+                }
+            }
+
+            real fMax = 0;
+            for (size_t i = 0; i < fRef.size(); i++)
+            {
+                fMax = std::max(fMax, std::fabs(fRef[i]));
+            }
+            ASSERT_EQ(fRef.size(), f.size());
+            for (size_t i = 0; i < fRef.size(); i++)
+            {
+                EXPECT_NEAR(fRef[i], f[i], relTolerance*fMax) << "for force component " << i;
+            }
+        }
+
+        t_commrec         *cr_;
+        t_inputrec         ir_;
+        real               ewaldcoeff_;
+        matrix             box_;
+        std::vector<real>  x_;
+        std::vector<real>  q_;
+};
+
+#ifdef GMX_DOUBLE
+//! Test fixture for the influence function computed in single precision.
+class PmeFloatInfluenceTest : public PmeTest
+{
+};
+
+TEST_F(PmeFloatInfluenceTest, ReproducesDoublePrecisionEnergies)
+{
+    real              energyRef, energyFloat;
+    matrix            virRef, virFloat;
+    std::vector<real> fRef, fFloat;
+
+    setPmeEnv("GMX_PME_FLOAT_INFLUENCE", false);
+    calcPme(1, &energyRef, virRef, &fRef);
+    setPmeEnv("GMX_PME_FLOAT_INFLUENCE", true);
+    calcPme(1, &energyFloat, virFloat, &fFloat);
+
+    /* The influence function is computed in single precision, which
+     * gives relative errors of the order of float epsilon. These are well
+     * above double epsilon, so we can also check that the float path is used.
+     */
+    compare(energyRef, virRef, fRef, energyFloat, virFloat, fFloat, 4*GMX_FLOAT_EPS);
+    EXPECT_GT(std::fabs(energyFloat - energyRef), 1000*GMX_DOUBLE_EPS*std::fabs(energyRef));
+}
+#endif
+
+//! Test fixture for spreading directly on the FFT grid tiles with OpenMP.
+class PmeSpreadTilesTest : public PmeTest
+{
+};
+
+TEST_F(PmeSpreadTilesTest, ThreadedSpreadingReproducesSerial)
+{
+    real              energyRef;
+    matrix            virRef;
+    std::vector<real> fRef;
+
+    calcPme(1, &energyRef, virRef, &fRef);
+
+    /* 3 threads do not divide the grid evenly */
+    for (int nthread = 2; nthread <= 4; nthread++)
+    {
+        for (int tiles = 0; tiles < 2; tiles++)
+        {
+            real              energy;
+            matrix            vir;
+            std::vector<real> f;
+
+            SCOPED_TRACE(::testing::Message() << nthread << " threads, "
+                         << (tiles ? "with" : "without") << " spreading on tiles");
+            setPmeEnv("GMX_PME_NO_SPREAD_TILES", tiles == 0);
+            calcPme(nthread, &energy, vir, &f);
+            /* Only the summation order of the grid contributions differs */
+            compare(energyRef, virRef, fRef, energy, vir, f,
+                    100*GMX_REAL_EPS);
+        }
+    }
+}
+
+} // namespace
@@ -0,0 +1,298 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for SETTLE, comparing csettle, which uses SIMD when available,
+ * with the plain C csettle_ref.
+ *
+ * \ingroup module_mdlib
+ */
+#include <cmath>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/legacyheaders/constr.h"
+#include "gromacs/legacyheaders/typedefs.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/pbcutil/pbc.h"
+#include "gromacs/utility/smalloc.h"
+
+namespace
+{
+
+//! Number of water molecules, chosen to not be a multiple of any SIMD width.
+const int  c_numWaters = 19;
+//! O-H distance.
+const real c_dOH       = 0.09572;
+//! H-H distance.
+const real c_dHH       = 0.15139;
+//! Oxygen mass.
+const real c_mO        = 15.9994;
+//! Hydrogen mass.
+const real c_mH        = 1.008;
+//! Time step.
+const real c_dt        = 0.002;
+//! Box size, the last molecules are put across the box boundary.
+const real c_boxSize   = 1.86;
+
+//! Output of a SETTLE call.
+struct SettleOutput
+{
+    //! Settled coordinates.
+    std::vector<real> x;
+    //! Corrected velocities.
+    std::vector<real> v;
+    //! Constraint virial contribution.
+    tensor            virial;
+    //! Index of the settle that failed, -1 when all succeeded.
+    int               error;
+};
+
+/*! \brief
+ * Test fixture for SETTLE.
+ *
+ * Sets up water molecules in varying orientations, with coordinates
+ * before the update that satisfy the constraints and updated coordinates
+ * with random-like displacements.
+ */
+class SettleTest : public ::testing::Test
+{
+    public:
+        SettleTest() : x_(c_numWaters*3*DIM), xprime_(c_numWaters*3*DIM),
+                       v_(c_numWaters*3*DIM), iatoms_(c_numWaters*4)
+        {
+            settled_ = settle_init(c_mO, c_mH, 1/c_mO, 1/c_mH, c_dOH, c_dHH);
+
+            /* Water geometry in the molecular frame, O at the origin */
+            const real yH = std::sqrt(c_dOH*c_dOH - 0.25*c_dHH*c_dHH);
+            const real ref[3][DIM] = {
+                { 0, 0, 0 }, { -0.5*c_dHH, yH, 0 }, { 0.5*c_dHH, yH, 0 }
+            };
+
+            for (int i = 0; i < c_numWaters; i++)
+            {
+                /* Rotate around z and then x with molecule dependent angles */
+                const real a   = 0.7*i;
+                const real b   = 1.3*i + 0.4;
+                matrix     rot = {
+                    { std::cos(a), -std::sin(a), 0 },
+                    { std::cos(b)*std::sin(a), std::cos(b)*std::cos(a), -std::sin(b) },
+                    { std::sin(b)*std::sin(a), std::sin(b)*std::cos(a), std::cos(b) }
+                };
+                rvec       origin;
+
+                origin[XX] = 0.3*(i % 5) + 0.2;
+                origin[YY] = 0.3*((i/5) % 5) + 0.2;
+                origin[ZZ] = 0.25*(i/25) + 0.3;
+                if (i >= c_numWaters - 3)
+                {
+                    /* Put the O at the edge, so the H's are across the box */
+                    origin[i % DIM] = 0.01;
+                }
+
+                iatoms_[i*4] = 0;
+                for (int a3 = 0; a3 < 3; a3++)
+                {
+                    const int atom = i*3 + a3;
+                    rvec      xa;
+
+                    iatoms_[i*4 + 1 + a3] = atom;
+                    mvmul(rot, ref[a3], xa);
+                    for (int d = 0; d < DIM; d++)
+                    {
+                        real disp = 0.004*std::sin(1.7*atom + 2.9*d + 0.3);
+
+                        x_[atom*DIM + d]      = origin[d] + xa[d];
+                        xprime_[atom*DIM + d] = x_[atom*DIM + d] + disp;
+                        v_[atom*DIM + d]      = disp/c_dt;
+                    }
+                }
+            }
+
+            clear_mat(box_);
+            box_[XX][XX] = c_boxSize;
+            box_[YY][YY] = c_boxSize;
+            box_[ZZ][ZZ] = c_boxSize;
+
+            vscaleNhc_          = 1;
+            vetavar_.veta       = 0;
+            vetavar_.rscale     = 1;
+            vetavar_.vscale     = 1;
+            vetavar_.rvscale    = 1;
+            vetavar_.alpha      = 1;
+            vetavar_.vscale_nhc = &vscaleNhc_;
+        }
+
+        ~SettleTest()
+        {
+            sfree(settled_);
+        }
+
+        /*! \brief
+         * Puts the atoms of the last molecules in the box, which moves
+         * hydrogens away from their oxygen by a box vector.
+         */
+        void putAtomsInBox()
+        {
+            for (int i = 0; i < c_numWaters*3*DIM; i++)
+            {
+                if (x_[i] < 0)
+                {
+                    x_[i]      += c_boxSize;
+                    xprime_[i] += c_boxSize;
+                }
+            }
+        }
+
+        //! Runs csettle, or csettle_ref when \p bRef is true.
+        void runSettle(bool bRef, const t_pbc *pbc, SettleOutput *out)
+        {
+            out->x = xprime_;
+            out->v = v_;
+            clear_mat(out->virial);
+            if (bRef)
+            {
+                csettle_ref(settled_, c_numWaters, &iatoms_[0], pbc,
+                            &x_[0], &out->x[0],
+                            1/c_dt, &out->v[0], c_numWaters*3,
+                            out->virial, &out->error, &vetavar_);
+            }
+            else
+            {
+                csettle(settled_, c_numWaters, &iatoms_[0], pbc,
+                        &x_[0], &out->x[0],
+                        1/c_dt, &out->v[0], c_numWaters*3,
+                        out->virial, &out->error, &vetavar_);
+            }
+        }
+
+        //! Checks that csettle reproduces csettle_ref and satisfies the constraints.
+        void testAgainstReference(const t_pbc *pbc)
+        {
+            SettleOutput ref, test;
+
+            runSettle(true, pbc, &ref);
+            runSettle(false, pbc, &test);
+
+            EXPECT_EQ(-1, ref.error);
+            EXPECT_EQ(-1, test.error);
+
+            const real xTolerance = 1e-5;
+            for (size_t i = 0; i < ref.x.size(); i++)
+            {
+                EXPECT_NEAR(ref.x[i], test.x[i], xTolerance) << "coordinate " << i;
+                EXPECT_NEAR(ref.v[i], test.v[i], xTolerance/c_dt) << "velocity " << i;
+            }
+
+            /* The virial is a sum of r m delta r terms over absolute
+             * coordinates which largely cancel, so we compare relative
+             * to the magnitude of the terms instead of the result.
+             */
+            real virScale = 0;
+            for (size_t i = 0; i < ref.x.size(); i++)
+            {
+                real mass = ((i/DIM) % 3 == 0 ? c_mO : c_mH);
+
+                virScale += mass*std::abs(x_[i]*(ref.x[i] - xprime_[i]));
+            }
+            for (int d = 0; d < DIM; d++)
+            {
+                for (int d2 = 0; d2 < DIM; d2++)
+                {
+                    EXPECT_NEAR(ref.virial[d][d2], test.virial[d][d2], 1e-5*virScale)
+                    << "virial element " << d << " " << d2;
+                }
+            }
+
+            for (int i = 0; i < c_numWaters; i++)
+            {
+                const real *xO  = &test.x[iatoms_[i*4 + 1]*DIM];
+                const real *xH1 = &test.x[iatoms_[i*4 + 2]*DIM];
+                const real *xH2 = &test.x[iatoms_[i*4 + 3]*DIM];
+                rvec        dOH1, dOH2, dHH;
+
+                if (pbc == NULL)
+                {
+                    rvec_sub(xH1, xO, dOH1);
+                    rvec_sub(xH2, xO, dOH2);
+                    rvec_sub(xH2, xH1, dHH);
+                }
+                else
+                {
+                    pbc_dx_aiuc(pbc, xH1, xO, dOH1);
+                    pbc_dx_aiuc(pbc, xH2, xO, dOH2);
+                    pbc_dx_aiuc(pbc, xH2, xH1, dHH);
+                }
+                EXPECT_NEAR(c_dOH, norm(dOH1), xTolerance) << "water " << i;
+                EXPECT_NEAR(c_dOH, norm(dOH2), xTolerance) << "water " << i;
+                EXPECT_NEAR(c_dHH, norm(dHH), xTolerance) << "water " << i;
+            }
+        }
+
+        //! SETTLE parameters.
+        gmx_settledata_t   settled_;
+        //! Coordinates before the update.
+        std::vector<real>  x_;
+        //! Updated coordinates.
+        std::vector<real>  xprime_;
+        //! Velocities.
+        std::vector<real>  v_;
+        //! SETTLE interaction list.
+        std::vector<int>   iatoms_;
+        //! The box.
+        matrix             box_;
+        //! Nose-Hoover velocity scaling factor.
+        double             vscaleNhc_;
+        //! Pressure-coupling variables.
+        t_vetavars         vetavar_;
+};
+
+TEST_F(SettleTest, MatchesReferenceWithoutPbc)
+{
+    testAgainstReference(NULL);
+}
+
+TEST_F(SettleTest, MatchesReferenceWithPbc)
+{
+    t_pbc pbc;
+
+    putAtomsInBox();
+    set_pbc(&pbc, epbcXYZ, box_);
+    testAgainstReference(&pbc);
+}
+
+} // namespace
@@ -0,0 +1,270 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the leap-frog, SD and BD update, comparing the specialized
+ * update kernels with the general kernels.
+ *
+ * The system has virtual sites and a partially frozen group, which the
+ * specialized kernels handle through t_mdatoms::invmass_dim, and a number
+ * of atoms that is not a multiple of the atom block or any SIMD width.
+ *
+ * \ingroup module_mdlib
+ */
+#include <cmath>
+#include <cstring>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/legacyheaders/gmx_omp_nthreads.h"
+#include "gromacs/legacyheaders/nrnb.h"
+#include "gromacs/legacyheaders/typedefs.h"
+#include "gromacs/legacyheaders/update.h"
+#include "gromacs/legacyheaders/types/commrec.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/utility/smalloc.h"
+
+namespace
+{
+
+//! Number of atoms.
+const int  c_numAtoms = 203;
+//! Time step.
+const real c_dt       = 0.002;
+
+/*! \brief
+ * Test fixture for the update.
+ *
+ * Every fifth atom is a virtual site, the atoms in freeze group 1 are
+ * frozen along y.
+ */
+class UpdateTest : public ::testing::Test
+{
+    public:
+        UpdateTest() : invmass_(c_numAtoms), invmassDim_(c_numAtoms*DIM),
+                       ptype_(c_numAtoms), cFREEZE_(c_numAtoms),
+                       x_(c_numAtoms*DIM), v_(c_numAtoms*DIM),
+                       f_(c_numAtoms*DIM)
+        {
+            std::memset(&ir_, 0, sizeof(ir_));
+            ir_.delta_t      = c_dt;
+            ir_.ld_seed      = 1993;
+            ir_.opts.ngtc    = 1;
+            ir_.opts.ngacc   = 1;
+            ir_.opts.ngfrz   = 2;
+            refT_            = 300;
+            tauT_            = 1;
+            clear_rvec(acc_);
+            ir_.opts.ref_t   = &refT_;
+            ir_.opts.tau_t   = &tauT_;
+            ir_.opts.acc     = &acc_;
+            clear_ivec(nFreeze_[0]);
+            clear_ivec(nFreeze_[1]);
+            nFreeze_[1][YY]  = 1;
+            ir_.opts.nFreeze = nFreeze_;
+
+            for (int i = 0; i < c_numAtoms; i++)
+            {
+                ptype_[i]   = (i % 5 == 4 ? eptVSite : eptAtom);
+                invmass_[i] = (ptype_[i] == eptVSite ? 0 : 1/(1.0 + (i % 7)));
+                cFREEZE_[i] = (i % 11 == 3 ? 1 : 0);
+                for (int d = 0; d < DIM; d++)
+                {
+                    const int k = i*DIM + d;
+
+                    invmassDim_[k] = (nFreeze_[cFREEZE_[i]][d] ? 0 : invmass_[i]);
+                    x_[k]          = 0.1*i + 0.3*d + 0.01*std::sin(1.1*k);
+                    v_[k]          = (ptype_[i] == eptVSite ? 0 : std::cos(0.7*k));
+                    f_[k]          = 800*std::sin(2.3*k + 0.5);
+                }
+            }
+
+            std::memset(&md_, 0, sizeof(md_));
+            md_.nr          = c_numAtoms;
+            md_.homenr      = c_numAtoms;
+            md_.invmass     = &invmass_[0];
+            md_.invmass_dim = reinterpret_cast<rvec *>(&invmassDim_[0]);
+            md_.ptype       = &ptype_[0];
+            md_.cFREEZE     = &cFREEZE_[0];
+
+            std::memset(&tcstat_, 0, sizeof(tcstat_));
+            tcstat_.lambda  = 0.98;
+            std::memset(&grpstat_, 0, sizeof(grpstat_));
+            std::memset(&ekind_, 0, sizeof(ekind_));
+            ekind_.ngtc     = 1;
+            ekind_.tcstat   = &tcstat_;
+            ekind_.ngacc    = 1;
+            ekind_.grpstat  = &grpstat_;
+
+            std::memset(&cr_, 0, sizeof(cr_));
+            cr_.nnodes = 1;
+        }
+
+        /*! \brief
+         * Runs one update step with \p nthreads threads and returns the
+         * updated coordinates and velocities.
+         */
+        void runUpdate(bool bGeneric, int nthreads,
+                       std::vector<real> *x, std::vector<real> *v)
+        {
+            t_state      state;
+            t_nrnb       nrnb;
+            tensor       vir;
+            real         dvdlambda = 0;
+            matrix       M;
+            gmx_update_t upd;
+
+            gmx_omp_nthreads_set(emntUpdate, nthreads);
+
+            init_state(&state, c_numAtoms, 1, 0, 0, 0);
+            std::memcpy(state.x, &x_[0], c_numAtoms*sizeof(rvec));
+            std::memcpy(state.v, &v_[0], c_numAtoms*sizeof(rvec));
+            init_nrnb(&nrnb);
+            clear_mat(M);
+
+            upd = init_update(&ir_);
+            set_update_generic(upd, bGeneric);
+            update_coords(NULL, 7, &ir_, &md_, &state, FALSE,
+                          reinterpret_cast<rvec *>(&f_[0]), FALSE, NULL, NULL,
+                          &ekind_, M, upd, FALSE, etrtPOSITION, &cr_, &nrnb,
+                          NULL, NULL);
+            update_constraints(NULL, 7, &dvdlambda, &ir_, &ekind_, &md_, &state,
+                               FALSE, NULL, reinterpret_cast<rvec *>(&f_[0]),
+                               NULL, vir, &cr_, &nrnb, NULL, upd, NULL,
+                               FALSE, FALSE, 0);
+
+            x->assign(state.x[0], state.x[0] + c_numAtoms*DIM);
+            v->assign(state.v[0], state.v[0] + c_numAtoms*DIM);
+            done_state(&state);
+        }
+
+        //! Checks that the specialized kernels reproduce the general ones.
+        void testAgainstGeneric(int nthreads)
+        {
+            std::vector<real> xRef, vRef, x, v;
+
+            runUpdate(true, 1, &xRef, &vRef);
+            runUpdate(false, nthreads, &x, &v);
+
+            for (int i = 0; i < c_numAtoms*DIM; i++)
+            {
+                EXPECT_NEAR(vRef[i], v[i], 1e-5*(1 + std::abs(vRef[i])))
+                << "atom " << i/DIM << " dim " << i % DIM;
+                EXPECT_NEAR(xRef[i], x[i], 1e-5*(1 + std::abs(xRef[i])))
+                << "atom " << i/DIM << " dim " << i % DIM;
+                if (invmassDim_[i] == 0)
+                {
+                    EXPECT_EQ(0, v[i]);
+                    EXPECT_EQ(x_[i], x[i]);
+                }
+            }
+        }
+
+        //! Input parameters.
+        t_inputrec                  ir_;
+        //! Reference temperature.
+        real                        refT_;
+        //! Temperature coupling time.
+        real                        tauT_;
+        //! Acceleration, zero.
+        rvec                        acc_;
+        //! Freeze dimensions for the two freeze groups.
+        ivec                        nFreeze_[2];
+        //! Inverse masses.
+        std::vector<real>           invmass_;
+        //! Inverse masses per dimension.
+        std::vector<real>           invmassDim_;
+        //! Particle types.
+        std::vector<unsigned short> ptype_;
+        //! Freeze group indices.
+        std::vector<unsigned short> cFREEZE_;
+        //! Coordinates.
+        std::vector<real>           x_;
+        //! Velocities.
+        std::vector<real>           v_;
+        //! Forces.
+        std::vector<real>           f_;
+        //! Atom data.
+        t_mdatoms                   md_;
+        //! Temperature coupling data.
+        t_grp_tcstat                tcstat_;
+        //! Acceleration group data.
+        t_grp_acc                   grpstat_;
+        //! Kinetic energy data.
+        gmx_ekindata_t              ekind_;
+        //! Communication record.
+        t_commrec                   cr_;
+};
+
+TEST_F(UpdateTest, LeapFrogMatchesGeneric)
+{
+    ir_.eI = eiMD;
+    testAgainstGeneric(1);
+}
+
+TEST_F(UpdateTest, LeapFrogMatchesGenericWithThreads)
+{
+    ir_.eI = eiMD;
+    testAgainstGeneric(3);
+}
+
+TEST_F(UpdateTest, StochasticDynamicsMatchesGeneric)
+{
+    ir_.eI = eiSD1;
+    testAgainstGeneric(1);
+}
+
+TEST_F(UpdateTest, StochasticDynamicsMatchesGenericWithThreads)
+{
+    ir_.eI = eiSD1;
+    testAgainstGeneric(3);
+}
+
+TEST_F(UpdateTest, BrownianDynamicsMatchesGeneric)
+{
+    ir_.eI      = eiBD;
+    ir_.bd_fric = 5000;
+    testAgainstGeneric(1);
+}
+
+TEST_F(UpdateTest, BrownianDynamicsWithoutFrictionMatchesGeneric)
+{
+    ir_.eI = eiBD;
+    testAgainstGeneric(1);
+}
+
+} // namespace
@@ -0,0 +1,250 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Microbenchmark for the leap-frog, SD and BD update kernels.
+ *
+ * Each integrator is timed with the general and with the specialized kernel
+ * on the same synthetic system; the printed ratio is what matters, and the
+ * results themselves are covered by update.cpp in mdlib-test. Run e.g.
+ *
+ *     mdlib-update-benchmark -natoms 1000000 -nsteps 100 -nthreads 4
+ *
+ * to compare the specialized and the general update kernels.
+ *
+ * \ingroup module_mdlib
+ */
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/legacyheaders/gmx_omp_nthreads.h"
+#include "gromacs/legacyheaders/nrnb.h"
+#include "gromacs/legacyheaders/typedefs.h"
+#include "gromacs/legacyheaders/update.h"
+#include "gromacs/legacyheaders/types/commrec.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/options/basicoptions.h"
+#include "gromacs/options/options.h"
+#include "gromacs/timing/walltime_accounting.h"
+
+#include "testutils/testoptions.h"
+
+namespace
+{
+
+//! Number of atoms.
+int g_natoms   = 100000;
+//! Number of update steps per kernel.
+int g_nsteps   = 200;
+//! Number of OpenMP threads for the update.
+int g_nthreads = 1;
+
+//! \cond
+GMX_TEST_OPTIONS(UpdateBenchmarkOptions, options)
+{
+    options->addOption(::gmx::IntegerOption("natoms")
+                           .store(&g_natoms)
+                           .description("Number of atoms"));
+    options->addOption(::gmx::IntegerOption("nsteps")
+                           .store(&g_nsteps)
+                           .description("Number of update steps per kernel"));
+    options->addOption(::gmx::IntegerOption("nthreads")
+                           .store(&g_nthreads)
+                           .description("Number of OpenMP threads"));
+}
+//! \endcond
+
+/*! \brief
+ * Benchmark fixture with a system of atoms with a single T-coupling
+ * group, no acceleration and no freeze groups.
+ */
+class UpdateBenchmark : public ::testing::Test
+{
+    public:
+        UpdateBenchmark() : invmass_(g_natoms), invmassDim_(g_natoms*DIM),
+                            ptype_(g_natoms, eptAtom), f_(g_natoms*DIM)
+        {
+            std::memset(&ir_, 0, sizeof(ir_));
+            ir_.delta_t      = 0.002;
+            ir_.ld_seed      = 1993;
+            ir_.bd_fric      = 5000;
+            ir_.opts.ngtc    = 1;
+            ir_.opts.ngacc   = 1;
+            ir_.opts.ngfrz   = 1;
+            refT_            = 300;
+            tauT_            = 1;
+            clear_rvec(acc_);
+            clear_ivec(nFreeze_);
+            ir_.opts.ref_t   = &refT_;
+            ir_.opts.tau_t   = &tauT_;
+            ir_.opts.acc     = &acc_;
+            ir_.opts.nFreeze = &nFreeze_;
+
+            init_state(&state_, g_natoms, 1, 0, 0, 0);
+            for (int i = 0; i < g_natoms; i++)
+            {
+                invmass_[i] = 1/(1.0 + (i % 16));
+                for (int d = 0; d < DIM; d++)
+                {
+                    invmassDim_[i*DIM + d] = invmass_[i];
+                    state_.x[i][d]         = 0.01*(i % 1000) + d;
+                    state_.v[i][d]         = 0.1*((i + d) % 7) - 0.3;
+                    f_[i*DIM + d]          = 100.0*((i + 2*d) % 13) - 600;
+                }
+            }
+
+            std::memset(&md_, 0, sizeof(md_));
+            md_.nr          = g_natoms;
+            md_.homenr      = g_natoms;
+            md_.invmass     = &invmass_[0];
+            md_.invmass_dim = reinterpret_cast<rvec *>(&invmassDim_[0]);
+            md_.ptype       = &ptype_[0];
+
+            std::memset(&tcstat_, 0, sizeof(tcstat_));
+            tcstat_.lambda  = 1;
+            std::memset(&grpstat_, 0, sizeof(grpstat_));
+            std::memset(&ekind_, 0, sizeof(ekind_));
+            ekind_.ngtc     = 1;
+            ekind_.tcstat   = &tcstat_;
+            ekind_.ngacc    = 1;
+            ekind_.grpstat  = &grpstat_;
+
+            std::memset(&cr_, 0, sizeof(cr_));
+            cr_.nnodes = 1;
+
+            gmx_omp_nthreads_set(emntUpdate, g_nthreads);
+        }
+
+        ~UpdateBenchmark()
+        {
+            done_state(&state_);
+        }
+
+        //! Returns the time per atom and step in ns for the update.
+        double timeUpdate(bool bGeneric)
+        {
+            t_nrnb       nrnb;
+            matrix       M;
+            gmx_update_t upd;
+            double       t0;
+
+            init_nrnb(&nrnb);
+            clear_mat(M);
+            upd = init_update(&ir_);
+            set_update_generic(upd, bGeneric);
+
+            /* One step to allocate the xprime buffer */
+            update_coords(NULL, 0, &ir_, &md_, &state_, FALSE,
+                          reinterpret_cast<rvec *>(&f_[0]), FALSE, NULL, NULL,
+                          &ekind_, M, upd, FALSE, etrtPOSITION, &cr_, &nrnb,
+                          NULL, NULL);
+            t0 = gmx_gettime();
+            for (int step = 1; step <= g_nsteps; step++)
+            {
+                update_coords(NULL, step, &ir_, &md_, &state_, FALSE,
+                              reinterpret_cast<rvec *>(&f_[0]), FALSE, NULL, NULL,
+                              &ekind_, M, upd, FALSE, etrtPOSITION, &cr_, &nrnb,
+                              NULL, NULL);
+            }
+
+            return (gmx_gettime() - t0)*1e9/(static_cast<double>(g_natoms)*g_nsteps);
+        }
+
+        //! Times the general and specialized kernels for integrator \p eI.
+        void compareKernels(int eI, const char *name)
+        {
+            ir_.eI = eI;
+
+            double tGeneric = timeUpdate(true);
+            double tSimple  = timeUpdate(false);
+
+            std::printf("%-4s update, %d atoms, %d threads: general %.3f ns/atom/step,"
+                        " specialized %.3f ns/atom/step\n",
+                        name, g_natoms, g_nthreads, tGeneric, tSimple);
+        }
+
+        //! Input parameters.
+        t_inputrec                  ir_;
+        //! Reference temperature.
+        real                        refT_;
+        //! Temperature coupling time.
+        real                        tauT_;
+        //! Acceleration, zero.
+        rvec                        acc_;
+        //! Freeze dimensions, none.
+        ivec                        nFreeze_;
+        //! Inverse masses.
+        std::vector<real>           invmass_;
+        //! Inverse masses per dimension.
+        std::vector<real>           invmassDim_;
+        //! Particle types.
+        std::vector<unsigned short> ptype_;
+        //! Forces.
+        std::vector<real>           f_;
+        //! Coordinates and velocities.
+        t_state                     state_;
+        //! Atom data.
+        t_mdatoms                   md_;
+        //! Temperature coupling data.
+        t_grp_tcstat                tcstat_;
+        //! Acceleration group data.
+        t_grp_acc                   grpstat_;
+        //! Kinetic energy data.
+        gmx_ekindata_t              ekind_;
+        //! Communication record.
+        t_commrec                   cr_;
+};
+
+TEST_F(UpdateBenchmark, LeapFrog)
+{
+    compareKernels(eiMD, "md");
+}
+
+TEST_F(UpdateBenchmark, StochasticDynamics)
+{
+    compareKernels(eiSD1, "sd");
+}
+
+TEST_F(UpdateBenchmark, BrownianDynamics)
+{
+    compareKernels(eiBD, "bd");
+}
+
+} // namespace
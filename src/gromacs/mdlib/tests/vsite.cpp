@@ -0,0 +1,345 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the multi-threaded virtual site construction and force
+ * spreading, comparing with the single-thread results.
+ *
+ * The vsites use all construction types, include vsites constructed
+ * from vsites and vsites with constructing atoms in the atom ranges
+ * of other threads.
+ *
+ * \ingroup module_mdlib
+ */
+#include <cmath>
+#include <cstring>
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/legacyheaders/gmx_omp_nthreads.h"
+#include "gromacs/legacyheaders/nrnb.h"
+#include "gromacs/legacyheaders/typedefs.h"
+#include "gromacs/legacyheaders/types/commrec.h"
+#include "gromacs/legacyheaders/vsite.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/pbcutil/ishift.h"
+
+namespace
+{
+
+//! Number of molecules, chosen to not divide the atoms evenly over threads.
+const int c_numMolecules     = 11;
+//! Number of normal atoms per molecule.
+const int c_numRealAtoms     = 4;
+//! Number of atoms per molecule, including vsites.
+const int c_atomsPerMolecule = 13;
+
+//! Output of construction and spreading.
+struct VsiteOutput
+{
+    //! Coordinates including the constructed vsites.
+    std::vector<real> x;
+    //! Forces after spreading.
+    std::vector<real> f;
+    //! Shift forces.
+    rvec              fshift[SHIFTS];
+    //! Virial correction.
+    matrix            virial;
+};
+
+/*! \brief
+ * Test fixture for virtual sites.
+ *
+ * Each molecule has four normal atoms and nine vsites. One vsite
+ * is constructed from a vsite, which is used for constructing another
+ * vsite, and one vsite uses an atom of a molecule halfway the system.
+ */
+class VsiteTest : public ::testing::Test
+{
+    public:
+        VsiteTest() : x_(c_numMolecules*c_atomsPerMolecule*DIM),
+                      f_(c_numMolecules*c_atomsPerMolecule*DIM)
+        {
+            const real base[c_numRealAtoms][DIM] = {
+                { 0, 0, 0 }, { 0.1, 0.02, 0 }, { 0.13, 0.11, 0.01 }, { 0.02, 0.08, 0.09 }
+            };
+
+            for (int m = 0; m < c_numMolecules; m++)
+            {
+                const int a0    = m*c_atomsPerMolecule;
+                const int other = ((m + c_numMolecules/2) % c_numMolecules)*c_atomsPerMolecule;
+
+                for (int a = 0; a < c_numRealAtoms; a++)
+                {
+                    for (int d = 0; d < DIM; d++)
+                    {
+                        x_[(a0 + a)*DIM + d] = 0.4*((m >> d) & 1) + 0.3*d*(m % 3) +
+                            base[a][d] + 0.02*std::sin(1.3*(a0 + a) + 2.1*d);
+                    }
+                }
+
+                addVsite(F_VSITE2, 0.3, 0, 0, a0 + 4, a0, a0 + 1);
+                addVsite(F_VSITE3, 0.3, 0.2, 0, a0 + 5, a0, a0 + 1, a0 + 2);
+                addVsite(F_VSITE3FD, 0.4, 0.1, 0, a0 + 6, a0, a0 + 1, a0 + 2);
+                addVsite(F_VSITE3FAD, 0.05, 0.08, 0, a0 + 7, a0, a0 + 1, a0 + 2);
+                /* Constructed from vsite a0 + 4 */
+                addVsite(F_VSITE3OUT, 0.2, 0.3, 5, a0 + 8, a0 + 4, a0 + 1, a0 + 2);
+                /* Constructed from vsite a0 + 8 */
+                addVsite(F_VSITE4FDN, 0.8, 0.7, 0.05, a0 + 9, a0, a0 + 1, a0 + 2, a0 + 8);
+                addVsite(F_VSITE4FD, 0.3, 0.4, 0.06, a0 + 10, a0, a0 + 1, a0 + 2, a0 + 3);
+                /* Uses an atom of another molecule */
+                addVsite(F_VSITE3, 0.2, 0.1, 0, a0 + 11, a0, other + 1, a0 + 2);
+                addVsiteN(a0 + 12, a0);
+            }
+
+            for (int i = 0; i < numAtoms()*DIM; i++)
+            {
+                f_[i] = std::sin(0.7*i + 0.3);
+            }
+
+            std::memset(&idef_, 0, sizeof(idef_));
+            std::memset(&moltype_, 0, sizeof(moltype_));
+            for (int ftype = 0; ftype < F_NRE; ftype++)
+            {
+                if (!iatoms_[ftype].empty())
+                {
+                    idef_.il[ftype].nr        = iatoms_[ftype].size();
+                    idef_.il[ftype].iatoms    = &iatoms_[ftype][0];
+                    moltype_.ilist[ftype]     = idef_.il[ftype];
+                }
+            }
+            idef_.ntypes  = iparams_.size();
+            idef_.iparams = &iparams_[0];
+
+            /* One charge group per atom, so without charge groups */
+            for (int i = 0; i <= numAtoms(); i++)
+            {
+                cgsIndex_.push_back(i);
+            }
+            moltype_.atoms.nr  = numAtoms();
+            moltype_.cgs.nr    = numAtoms();
+            moltype_.cgs.index = &cgsIndex_[0];
+            std::memset(&molblock_, 0, sizeof(molblock_));
+            molblock_.type = 0;
+            molblock_.nmol = 1;
+            std::memset(&mtop_, 0, sizeof(mtop_));
+            mtop_.nmoltype  = 1;
+            mtop_.moltype   = &moltype_;
+            mtop_.nmolblock = 1;
+            mtop_.molblock  = &molblock_;
+
+            std::memset(&md_, 0, sizeof(md_));
+            md_.nr     = numAtoms();
+            md_.homenr = numAtoms();
+
+            std::memset(&cr_, 0, sizeof(cr_));
+            cr_.nnodes = 1;
+
+            clear_mat(box_);
+        }
+
+        //! Returns the number of atoms.
+        int numAtoms() const { return c_numMolecules*c_atomsPerMolecule; }
+
+        //! Adds a vsite \p av of type \p ftype with parameters a, b, c.
+        void addVsite(int ftype, real a, real b, real c,
+                      int av, int ai, int aj, int ak = -1, int al = -1)
+        {
+            t_iparams ip;
+
+            std::memset(&ip, 0, sizeof(ip));
+            ip.vsite.a = a;
+            ip.vsite.b = b;
+            ip.vsite.c = c;
+            iatoms_[ftype].push_back(iparams_.size());
+            iatoms_[ftype].push_back(av);
+            iatoms_[ftype].push_back(ai);
+            iatoms_[ftype].push_back(aj);
+            if (ak >= 0)
+            {
+                iatoms_[ftype].push_back(ak);
+            }
+            if (al >= 0)
+            {
+                iatoms_[ftype].push_back(al);
+            }
+            iparams_.push_back(ip);
+        }
+
+        //! Adds an F_VSITEN vsite \p av with weights for the atoms from \p a0.
+        void addVsiteN(int av, int a0)
+        {
+            for (int a = 0; a < c_numRealAtoms; a++)
+            {
+                t_iparams ip;
+
+                std::memset(&ip, 0, sizeof(ip));
+                ip.vsiten.n = c_numRealAtoms;
+                ip.vsiten.a = 0.1*(a + 1);
+                iatoms_[F_VSITEN].push_back(iparams_.size());
+                iatoms_[F_VSITEN].push_back(av);
+                iatoms_[F_VSITEN].push_back(a0 + a);
+                iparams_.push_back(ip);
+            }
+        }
+
+        //! Returns the coordinate vector \p x as an rvec array.
+        static rvec *asRvec(std::vector<real> *x)
+        {
+            return reinterpret_cast<rvec *>(&(*x)[0]);
+        }
+
+        //! Constructs vsites and spreads forces using \p nthreads threads.
+        void runVsites(int nthreads, bool bLimitRange, VsiteOutput *out)
+        {
+            t_nrnb nrnb;
+
+            gmx_omp_nthreads_set(emntVSITE, nthreads);
+            gmx_vsite_t *vsite = init_vsite(&mtop_, &cr_, FALSE);
+            ASSERT_TRUE(vsite != NULL);
+            split_vsites_over_threads(idef_.il, idef_.iparams, &md_,
+                                      bLimitRange, vsite);
+
+            out->x = x_;
+            construct_vsites(vsite, asRvec(&out->x), 0, NULL,
+                             idef_.iparams, idef_.il, epbcNONE, FALSE,
+                             NULL, box_);
+
+            out->f = f_;
+            clear_rvecs(SHIFTS, out->fshift);
+            clear_mat(out->virial);
+            init_nrnb(&nrnb);
+            spread_vsite_f(vsite, asRvec(&out->x), asRvec(&out->f),
+                           out->fshift, TRUE, out->virial, &nrnb, &idef_,
+                           epbcNONE, FALSE, NULL, box_, &cr_);
+        }
+
+        //! Checks that \p nthreads threads reproduce the single-thread results.
+        void checkThreads(int nthreads, bool bLimitRange)
+        {
+            VsiteOutput ref, test;
+
+            runVsites(1, true, &ref);
+            runVsites(nthreads, bLimitRange, &test);
+
+            real fScale = 0;
+            for (size_t i = 0; i < f_.size(); i++)
+            {
+                fScale = std::max(fScale, std::abs(ref.f[i]));
+            }
+            for (size_t i = 0; i < ref.x.size(); i++)
+            {
+                EXPECT_NEAR(ref.x[i], test.x[i], 1e-6) << "coordinate " << i;
+                EXPECT_NEAR(ref.f[i], test.f[i], 1e-5*fScale) << "force " << i;
+            }
+            for (int d = 0; d < DIM; d++)
+            {
+                EXPECT_NEAR(ref.fshift[CENTRAL][d], test.fshift[CENTRAL][d], 1e-4*fScale);
+                for (int d2 = 0; d2 < DIM; d2++)
+                {
+                    EXPECT_NEAR(ref.virial[d][d2], test.virial[d][d2], 1e-5*fScale)
+                    << "virial element " << d << " " << d2;
+                }
+            }
+        }
+
+        //! Coordinates, zero for the vsites.
+        std::vector<real>      x_;
+        //! Forces before spreading.
+        std::vector<real>      f_;
+        //! Vsite interaction lists.
+        std::vector<t_iatom>   iatoms_[F_NRE];
+        //! Vsite parameters, one type per vsite.
+        std::vector<t_iparams> iparams_;
+        //! Charge group index.
+        std::vector<int>       cgsIndex_;
+        //! Local topology.
+        t_idef                 idef_;
+        //! The molecule type.
+        gmx_moltype_t          moltype_;
+        //! The molecule block.
+        gmx_molblock_t         molblock_;
+        //! The global topology.
+        gmx_mtop_t             mtop_;
+        //! Atom data.
+        t_mdatoms              md_;
+        //! Communication record.
+        t_commrec              cr_;
+        //! The box, unused without PBC.
+        matrix                 box_;
+};
+
+TEST_F(VsiteTest, ConstructsAndConservesForce)
+{
+    VsiteOutput out;
+
+    runVsites(1, true, &out);
+
+    rvec fRef, fTest;
+    clear_rvec(fRef);
+    clear_rvec(fTest);
+    for (int i = 0; i < numAtoms(); i++)
+    {
+        const bool bVsite = (i % c_atomsPerMolecule >= c_numRealAtoms);
+
+        if (bVsite)
+        {
+            EXPECT_GT(norm2(asRvec(&out.x)[i]), 0) << "vsite " << i;
+            EXPECT_EQ(0, norm2(asRvec(&out.f)[i])) << "vsite " << i;
+        }
+        rvec_inc(fRef, asRvec(&f_)[i]);
+        rvec_inc(fTest, asRvec(&out.f)[i]);
+    }
+    for (int d = 0; d < DIM; d++)
+    {
+        EXPECT_NEAR(fRef[d], fTest[d], 1e-4);
+    }
+}
+
+TEST_F(VsiteTest, ThreadsReproduceSerial)
+{
+    checkThreads(2, true);
+    checkThreads(4, true);
+}
+
+TEST_F(VsiteTest, ThreadsReproduceSerialWithHomeRange)
+{
+    checkThreads(3, false);
+}
+
+} // namespace
@@ -41,6 +41,7 @@
 
 #include <stdio.h>
 #include <math.h>
+#include <stdlib.h>
 
 #include "types/commrec.h"
 #include "typedefs.h"
@@ -64,6 +65,7 @@
 #include "gromacs/pbcutil/mshift.h"
 #include "gromacs/pbcutil/pbc.h"
 #include "gromacs/pulling/pull.h"
+#include "gromacs/simd/simd.h"
 #include "gromacs/timing/wallcycle.h"
 #include "gromacs/utility/futil.h"
 #include "gromacs/utility/gmxomp.h"
@@ -72,6 +74,17 @@
 /*For debugging, start at v(-dt/2) for velolcity verlet -- uncomment next line */
 /*#define STARTFROMDT2*/
 
+#if defined GMX_SIMD_HAVE_REAL && defined GMX_SIMD_HAVE_LOADU && defined GMX_SIMD_HAVE_STOREU
+/* The specialized update kernels work on unaligned flat x/v/f arrays */
+#define UPDATE_SIMD
+#endif
+
+/* The number of atoms in a block for the thread ranges and for generating
+ * random numbers in the specialized SD and BD kernels. This is a multiple
+ * of all SIMD widths, so the flat thread ranges start at SIMD boundaries.
+ */
+#define UPDATE_ATOM_BLOCK 64
+
 typedef struct {
     double gdt;
     double eph;
@@ -112,9 +125,98 @@ typedef struct gmx_update
     /* Variables for the deform algorithm */
     gmx_int64_t     deformref_step;
     matrix          deformref_box;
+
+    /* Can the specialized update kernels be used with this setup? */
+    gmx_bool        bSimpleSetup;
+    /* Use the general update kernels, even when bSimpleSetup is TRUE */
+    gmx_bool        bGeneric;
 } t_gmx_update;
 
 
+/* Specialized leap-frog type update over the flat arrays of atoms
+ * start to nrend, used for a single T-coupling group without
+ * acceleration or extended-ensemble coupling:
+ *   v' = a v + (b invmass + c) f + s rnd,  x' = x + v' dt.
+ * With rnd=NULL there is no random term. rnd is indexed from atom start.
+ * Dimensions with invmass_dim=0, i.e. virtual sites, shells and
+ * frozen dimensions, get v'=0 and x'=x, as in the general kernels.
+ */
+static void do_update_simple(int start, int nrend, real dt,
+                             real a, real b, real c, real s,
+                             rvec invmass_dim[], const real *rnd,
+                             rvec x[], rvec xprime[], rvec v[], rvec f[])
+{
+    const real *im  = invmass_dim[start];
+    const real *xr  = x[start];
+    const real *fr  = f[start];
+    real       *vr  = v[start];
+    real       *xpr = xprime[start];
+    int         n   = (nrend - start)*DIM;
+    int         i   = 0;
+    real        vn;
+
+#ifdef UPDATE_SIMD
+    gmx_simd_real_t a_S, b_S, c_S, s_S, dt_S, zero_S;
+    gmx_simd_real_t im_S, v_S;
+
+    a_S    = gmx_simd_set1_r(a);
+    b_S    = gmx_simd_set1_r(b);
+    c_S    = gmx_simd_set1_r(c);
+    s_S    = gmx_simd_set1_r(s);
+    dt_S   = gmx_simd_set1_r(dt);
+    zero_S = gmx_simd_setzero_r();
+
+    for (; i + GMX_SIMD_REAL_WIDTH <= n; i += GMX_SIMD_REAL_WIDTH)
+    {
+        im_S = gmx_simd_loadu_r(im + i);
+        v_S  = gmx_simd_mul_r(a_S, gmx_simd_loadu_r(vr + i));
+        v_S  = gmx_simd_fmadd_r(gmx_simd_fmadd_r(b_S, im_S, c_S),
+                                gmx_simd_loadu_r(fr + i), v_S);
+        if (rnd != NULL)
+        {
+            v_S = gmx_simd_fmadd_r(s_S, gmx_simd_loadu_r(rnd + i), v_S);
+        }
+        v_S  = gmx_simd_blendzero_r(v_S, gmx_simd_cmplt_r(zero_S, im_S));
+
+        gmx_simd_storeu_r(vr + i, v_S);
+        gmx_simd_storeu_r(xpr + i,
+                          gmx_simd_fmadd_r(v_S, dt_S, gmx_simd_loadu_r(xr + i)));
+    }
+#endif
+
+    for (; i < n; i++)
+    {
+        if (im[i] > 0)
+        {
+            vn = a*vr[i] + (b*im[i] + c)*fr[i];
+            if (rnd != NULL)
+            {
+                vn += s*rnd[i];
+            }
+        }
+        else
+        {
+            vn = 0;
+        }
+        vr[i]  = vn;
+        xpr[i] = xr[i] + vn*dt;
+    }
+}
+
+/* Returns the atom range for thread th out of nth,
+ * aligned to blocks of UPDATE_ATOM_BLOCK atoms.
+ */
+static void get_update_thread_range(int start, int nrend, int nth, int th,
+                                    int *start_th, int *end_th)
+{
+    int nblock;
+
+    nblock    = (nrend - start + UPDATE_ATOM_BLOCK - 1)/UPDATE_ATOM_BLOCK;
+    *start_th = start + min(nrend - start, ((nblock*th)/nth)*UPDATE_ATOM_BLOCK);
+    *end_th   = start + min(nrend - start, ((nblock*(th + 1))/nth)*UPDATE_ATOM_BLOCK);
+}
+
+
 static void do_update_md(int start, int nrend, double dt,
                          t_grp_tcstat *tcstat,
                          double nh_vxi[],
@@ -570,9 +672,38 @@ gmx_update_t init_update(t_inputrec *ir)
     upd->xp        = NULL;
     upd->xp_nalloc = 0;
 
+    /* The specialized kernels handle freeze groups, virtual sites and
+     * shells through mdatoms->invmass_dim, but only a single T-coupling
+     * lambda and no acceleration.
+     */
+    upd->bSimpleSetup = (ir->opts.ngtc == 1 &&
+                         ir->opts.ngacc <= 1 &&
+                         (ir->opts.ngacc == 0 || norm2(ir->opts.acc[0]) == 0));
+    switch (ir->eI)
+    {
+        case eiMD:
+            upd->bSimpleSetup = (upd->bSimpleSetup &&
+                                 ir->etc != etcNOSEHOOVER &&
+                                 ir->epc != epcPARRINELLORAHMAN &&
+                                 ir->epc != epcMTTK &&
+                                 ir->cos_accel == 0);
+            break;
+        case eiSD1:
+        case eiBD:
+            break;
+        default:
+            upd->bSimpleSetup = FALSE;
+    }
+    upd->bGeneric = (getenv("GMX_UPDATE_GENERIC") != NULL);
+
     return upd;
 }
 
+void set_update_generic(gmx_update_t upd, gmx_bool bGeneric)
+{
+    upd->bGeneric = bGeneric;
+}
+
 static void do_update_sd1(gmx_stochd_t *sd,
                           int start, int nrend, double dt,
                           rvec accel[], ivec nFreeze[],
@@ -640,6 +771,45 @@ static void do_update_sd1(gmx_stochd_t *sd,
     }
 }
 
+/* Specialized SD1 update for a single T-coupling group without acceleration.
+ * The random numbers are generated per atom with the same counter-based
+ * generator as do_update_sd1, so both kernels give the same trajectory.
+ */
+static void do_update_sd1_simple(gmx_stochd_t *sd,
+                                 int start, int nrend, double dt,
+                                 real invmass[], rvec invmass_dim[],
+                                 rvec x[], rvec xprime[], rvec v[], rvec f[],
+                                 real tau_t, real ref_t,
+                                 gmx_int64_t step, int seed, int* gatindex)
+{
+    real em, sig_V, ism;
+    real rnd[UPDATE_ATOM_BLOCK*DIM];
+    int  b0, b1, n, d;
+
+    em    = sd->sdc[0].em;
+    sig_V = sqrt(BOLTZ*ref_t*(1 - em*em));
+
+    for (b0 = start; b0 < nrend; b0 += UPDATE_ATOM_BLOCK)
+    {
+        b1 = min(b0 + UPDATE_ATOM_BLOCK, nrend);
+        for (n = b0; n < b1; n++)
+        {
+            int ng = gatindex ? gatindex[n] : n;
+
+            gmx_rng_cycle_3gaussian_table(step, ng, seed, RND_SEED_UPDATE,
+                                          rnd + (n - b0)*DIM);
+            ism = sqrt(invmass[n]);
+            for (d = 0; d < DIM; d++)
+            {
+                rnd[(n - b0)*DIM + d] *= ism;
+            }
+        }
+
+        do_update_simple(b0, b1, dt, em, tau_t*(1 - em), 0, sig_V,
+                         invmass_dim, rnd, x, xprime, v, f);
+    }
+}
+
 static void check_sd2_work_data_allocation(gmx_stochd_t *sd, int nrend)
 {
     if (nrend > sd->sd_V_nalloc)
@@ -863,6 +1033,52 @@ static void do_update_bd(int start, int nrend, double dt,
     }
 }
 
+/* Specialized BD update for a single T-coupling group,
+ * see do_update_sd1_simple.
+ */
+static void do_update_bd_simple(int start, int nrend, double dt,
+                                real invmass[], rvec invmass_dim[],
+                                rvec x[], rvec xprime[], rvec v[], rvec f[],
+                                real friction_coefficient, real rf,
+                                gmx_int64_t step, int seed, int* gatindex)
+{
+    real rnd[UPDATE_ATOM_BLOCK*DIM];
+    real fac;
+    int  b0, b1, n, d;
+
+    for (b0 = start; b0 < nrend; b0 += UPDATE_ATOM_BLOCK)
+    {
+        b1 = min(b0 + UPDATE_ATOM_BLOCK, nrend);
+        for (n = b0; n < b1; n++)
+        {
+            int ng = gatindex ? gatindex[n] : n;
+
+            gmx_rng_cycle_3gaussian_table(step, ng, seed, RND_SEED_UPDATE,
+                                          rnd + (n - b0)*DIM);
+            if (friction_coefficient == 0)
+            {
+                /* NOTE: invmass = 2/(mass*friction_constant*dt) */
+                fac = sqrt(0.5*invmass[n]);
+                for (d = 0; d < DIM; d++)
+                {
+                    rnd[(n - b0)*DIM + d] *= fac;
+                }
+            }
+        }
+
+        if (friction_coefficient != 0)
+        {
+            do_update_simple(b0, b1, dt, 0, 0, 1.0/friction_coefficient, rf,
+                             invmass_dim, rnd, x, xprime, v, f);
+        }
+        else
+        {
+            do_update_simple(b0, b1, dt, 0, 0.5*dt, 0, rf,
+                             invmass_dim, rnd, x, xprime, v, f);
+        }
+    }
+}
+
 static void dump_it_all(FILE gmx_unused *fp, const char gmx_unused *title,
                         int gmx_unused natoms, rvec gmx_unused x[], rvec gmx_unused xp[],
                         rvec gmx_unused v[], rvec gmx_unused f[])
@@ -1550,8 +1766,7 @@ void update_constraints(FILE             *fplog,
         {
             int start_th, end_th;
 
-            start_th = start + ((nrend-start)* th   )/nth;
-            end_th   = start + ((nrend-start)*(th+1))/nth;
+            get_update_thread_range(start, nrend, nth, th, &start_th, &end_th);
 
             /* The second part of the SD integration */
             do_update_sd2(upd->sd,
@@ -1737,7 +1952,7 @@ void update_coords(FILE             *fplog,
                    gmx_constr_t      constr,
                    t_idef           *idef)
 {
-    gmx_bool          bNH, bPR, bLastStep, bLog = FALSE, bEner = FALSE;
+    gmx_bool          bNH, bPR, bSimple, bLastStep, bLog = FALSE, bEner = FALSE;
     double            dt, alpha;
     real             *imass, *imassin;
     rvec             *force;
@@ -1819,18 +2034,26 @@ void update_coords(FILE             *fplog,
 
     nth = gmx_omp_nthreads_get(emntUpdate);
 
+    bSimple = (upd->bSimpleSetup && !upd->bGeneric);
+
 #pragma omp parallel for num_threads(nth) schedule(static) private(alpha)
     for (th = 0; th < nth; th++)
     {
         int start_th, end_th;
 
-        start_th = start + ((nrend-start)* th   )/nth;
-        end_th   = start + ((nrend-start)*(th+1))/nth;
+        get_update_thread_range(start, nrend, nth, th, &start_th, &end_th);
 
         switch (inputrec->eI)
         {
             case (eiMD):
-                if (ekind->cosacc.cos_accel == 0)
+                if (bSimple)
+                {
+                    do_update_simple(start_th, end_th, dt,
+                                     ekind->tcstat[0].lambda, dt, 0, 0,
+                                     md->invmass_dim, NULL,
+                                     state->x, xprime, state->v, force);
+                }
+                else if (ekind->cosacc.cos_accel == 0)
                 {
                     do_update_md(start_th, end_th, dt,
                                  ekind->tcstat, state->nosehoover_vxi,
@@ -1854,6 +2077,16 @@ void update_coords(FILE             *fplog,
                 }
                 break;
             case (eiSD1):
+                if (bSimple)
+                {
+                    do_update_sd1_simple(upd->sd,
+                                         start_th, end_th, dt,
+                                         md->invmass, md->invmass_dim,
+                                         state->x, xprime, state->v, force,
+                                         inputrec->opts.tau_t[0], inputrec->opts.ref_t[0],
+                                         step, inputrec->ld_seed, DOMAINDECOMP(cr) ? cr->dd->gatindex : NULL);
+                    break;
+                }
                 do_update_sd1(upd->sd,
                               start_th, end_th, dt,
                               inputrec->opts.acc, inputrec->opts.nFreeze,
@@ -1878,6 +2111,15 @@ void update_coords(FILE             *fplog,
                               DOMAINDECOMP(cr) ? cr->dd->gatindex : NULL);
                 break;
             case (eiBD):
+                if (bSimple)
+                {
+                    do_update_bd_simple(start_th, end_th, dt,
+                                        md->invmass, md->invmass_dim,
+                                        state->x, xprime, state->v, force,
+                                        inputrec->bd_fric, upd->sd->bd_rf[0],
+                                        step, inputrec->ld_seed, DOMAINDECOMP(cr) ? cr->dd->gatindex : NULL);
+                    break;
+                }
                 do_update_bd(start_th, end_th, dt,
                              inputrec->opts.nFreeze, md->invmass, md->ptype,
                              md->cFREEZE, md->cTC,
@@ -39,6 +39,7 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
 
 #include "typedefs.h"
 #include "types/commrec.h"
@@ -525,16 +526,30 @@ void construct_vsites(gmx_vsite_t *vsite,
     {
 #pragma omp parallel num_threads(vsite->nthreads)
         {
-            construct_vsites_thread(vsite,
-                                    x, dt, v,
-                                    ip, vsite->tdata[gmx_omp_get_thread_num()].ilist,
-                                    pbc_null);
+            gmx_vsite_thread_t *tdata;
+            int                 level;
+
+            tdata = &vsite->tdata[gmx_omp_get_thread_num()];
+
+            /* The vsites of a level only depend on vsites of lower levels,
+             * so we only need to synchronize between levels.
+             */
+            for (level = 0; level < vsite->nlevel; level++)
+            {
+                construct_vsites_thread(vsite,
+                                        x, dt, v,
+                                        ip, tdata->task[level].ilist,
+                                        pbc_null);
+                construct_vsites_thread(vsite,
+                                        x, dt, v,
+                                        ip, tdata->task[level].id_ilist,
+                                        pbc_null);
+                if (level + 1 < vsite->nlevel)
+                {
+#pragma omp barrier
+                }
+            }
         }
-        /* Now we can construct the vsites that might depend on other vsites */
-        construct_vsites_thread(vsite,
-                                x, dt, v,
-                                ip, vsite->tdata[vsite->nthreads].ilist,
-                                pbc_null);
     }
 }
 
@@ -1319,11 +1334,6 @@ static void spread_vsite_f_thread(gmx_vsite_t *vsite,
     t_pbc     *pbc_null2;
     int       *vsite_pbc;
 
-    if (VirCorr)
-    {
-        clear_mat(dxdf);
-    }
-
     bPBCAll = (pbc_null != NULL && !vsite->bHaveChargeGroups);
 
     /* this loop goes backwards to be able to build *
@@ -1417,6 +1427,88 @@ static void spread_vsite_f_thread(gmx_vsite_t *vsite,
     }
 }
 
+/* Returns the number of iatoms entries used by the vsite starting at ia */
+static gmx_inline int vsite_nr_iatoms(int ftype, const t_iatom *ia,
+                                      const t_iparams *ip)
+{
+    if (ftype == F_VSITEN)
+    {
+        return 3*ip[ia[0]].vsiten.n;
+    }
+    else
+    {
+        return 1 + interaction_function[ftype].nratoms;
+    }
+}
+
+/* Returns the stride of the constructing atoms in the iatoms of a vsite,
+ * the first constructing atom is at index 2.
+ */
+static gmx_inline int vsite_construct_stride(int ftype)
+{
+    return (ftype == F_VSITEN ? 3 : 1);
+}
+
+/* Returns the thread whose atom range contains atom a */
+static gmx_inline int vsite_atom_thread(const gmx_vsite_t *vsite, int a)
+{
+    return min(a/vsite->natperthread, vsite->nthreads - 1);
+}
+
+/* Clears the thread-local force buffer f_id for the constructing atoms
+ * of the id vsites of task and moves the vsite forces from f to f_id.
+ */
+static void prepare_vsite_id_forces(const gmx_vsite_task_t *task,
+                                    const t_iparams *ip,
+                                    rvec f[], rvec f_id[])
+{
+    int            i, ftype, nr, av;
+    const t_iatom *ia;
+
+    for (i = 0; i < task->nid_atom; i++)
+    {
+        clear_rvec(f_id[task->id_atom[i]]);
+    }
+
+    for (ftype = 0; ftype < F_NRE; ftype++)
+    {
+        if (interaction_function[ftype].flags & IF_VSITE)
+        {
+            nr = task->id_ilist[ftype].nr;
+            ia = task->id_ilist[ftype].iatoms;
+            for (i = 0; i < nr; i += vsite_nr_iatoms(ftype, ia + i, ip))
+            {
+                av = ia[i+1];
+                copy_rvec(f[av], f_id[av]);
+                clear_rvec(f[av]);
+            }
+        }
+    }
+}
+
+/* Adds the forces on the atoms in the range of thread
+ * that all threads spread to their buffers f_id for level.
+ */
+static void reduce_vsite_id_forces(const gmx_vsite_t *vsite,
+                                   int level, int thread, rvec f[])
+{
+    int                     th, i, a;
+    const gmx_vsite_task_t *task;
+
+    for (th = 0; th < vsite->nthreads; th++)
+    {
+        task = &vsite->tdata[th].task[level];
+        for (i = 0; i < task->nid_atom; i++)
+        {
+            a = task->id_atom[i];
+            if (vsite_atom_thread(vsite, a) == thread)
+            {
+                rvec_inc(f[a], vsite->tdata[th].f_id[a]);
+            }
+        }
+    }
+}
+
 void spread_vsite_f(gmx_vsite_t *vsite,
                     rvec x[], rvec f[], rvec *fshift,
                     gmx_bool VirCorr, matrix vir,
@@ -1447,6 +1539,10 @@ void spread_vsite_f(gmx_vsite_t *vsite,
 
     if (vsite->nthreads == 1)
     {
+        if (VirCorr)
+        {
+            clear_mat(vsite->tdata[0].dxdf);
+        }
         spread_vsite_f_thread(vsite,
                               x, f, fshift,
                               VirCorr, vsite->tdata[0].dxdf,
@@ -1455,20 +1551,14 @@ void spread_vsite_f(gmx_vsite_t *vsite,
     }
     else
     {
-        /* First spread the vsites that might depend on other vsites */
-        spread_vsite_f_thread(vsite,
-                              x, f, fshift,
-                              VirCorr, vsite->tdata[vsite->nthreads].dxdf,
-                              idef->iparams,
-                              vsite->tdata[vsite->nthreads].ilist,
-                              g, pbc_null);
-
 #pragma omp parallel num_threads(vsite->nthreads)
         {
-            int   thread;
-            rvec *fshift_t;
+            int                 thread, level;
+            gmx_vsite_thread_t *tdata;
+            rvec               *fshift_t;
 
             thread = gmx_omp_get_thread_num();
+            tdata  = &vsite->tdata[thread];
 
             if (thread == 0 || fshift == NULL)
             {
@@ -1478,20 +1568,50 @@ void spread_vsite_f(gmx_vsite_t *vsite,
             {
                 int i;
 
-                fshift_t = vsite->tdata[thread].fshift;
+                fshift_t = tdata->fshift;
 
                 for (i = 0; i < SHIFTS; i++)
                 {
                     clear_rvec(fshift_t[i]);
                 }
             }
+            if (VirCorr)
+            {
+                clear_mat(tdata->dxdf);
+            }
 
-            spread_vsite_f_thread(vsite,
-                                  x, f, fshift_t,
-                                  VirCorr, vsite->tdata[thread].dxdf,
-                                  idef->iparams,
-                                  vsite->tdata[thread].ilist,
-                                  g, pbc_null);
+            /* Spread the forces starting at the highest level, since
+             * vsites of a level can be constructed from lower level vsites.
+             */
+            for (level = vsite->nlevel - 1; level >= 0; level--)
+            {
+                gmx_vsite_task_t *task = &tdata->task[level];
+
+                spread_vsite_f_thread(vsite,
+                                      x, f, fshift_t,
+                                      VirCorr, tdata->dxdf,
+                                      idef->iparams, task->ilist,
+                                      g, pbc_null);
+
+                if (task->nid_atom > 0)
+                {
+                    prepare_vsite_id_forces(task, idef->iparams, f, tdata->f_id);
+
+                    spread_vsite_f_thread(vsite,
+                                          x, tdata->f_id, fshift_t,
+                                          VirCorr, tdata->dxdf,
+                                          idef->iparams, task->id_ilist,
+                                          g, pbc_null);
+                }
+
+                /* Add the forces that other threads spread to our atoms */
+#pragma omp barrier
+                reduce_vsite_id_forces(vsite, level, thread, f);
+                if (level > 0)
+                {
+#pragma omp barrier
+                }
+            }
         }
 
         if (fshift != NULL)
@@ -1512,7 +1632,7 @@ void spread_vsite_f(gmx_vsite_t *vsite,
     {
         int i, j;
 
-        for (th = 0; th < (vsite->nthreads == 1 ? 1 : vsite->nthreads+1); th++)
+        for (th = 0; th < vsite->nthreads; th++)
         {
             for (i = 0; i < DIM; i++)
             {
@@ -1812,48 +1932,146 @@ gmx_vsite_t *init_vsite(gmx_mtop_t *mtop, t_commrec *cr,
     }
     if (!bSerial_NoPBC)
     {
-        /* We need one extra thread data structure for the overlap vsites */
-        snew(vsite->tdata, vsite->nthreads+1);
+        snew(vsite->tdata, vsite->nthreads);
     }
 
-    vsite->th_ind        = NULL;
-    vsite->th_ind_nalloc = 0;
+    vsite->natperthread = 0;
+    vsite->nlevel       = 0;
+    vsite->at_level     = NULL;
+    vsite->at_mark      = NULL;
+    vsite->at_nalloc    = 0;
 
     return vsite;
 }
 
 static void prepare_vsite_thread(const t_ilist      *ilist,
+                                 int                 nlevel,
                                  gmx_vsite_thread_t *vsite_th)
 {
-    int ftype;
+    int               level, ftype, t;
+    gmx_vsite_task_t *task;
+
+    if (nlevel > vsite_th->task_nalloc)
+    {
+        srenew(vsite_th->task, nlevel);
+        for (t = vsite_th->task_nalloc; t < nlevel; t++)
+        {
+            memset(&vsite_th->task[t], 0, sizeof(vsite_th->task[t]));
+        }
+        vsite_th->task_nalloc = nlevel;
+    }
+
+    for (level = 0; level < nlevel; level++)
+    {
+        task = &vsite_th->task[level];
+
+        for (ftype = 0; ftype < F_NRE; ftype++)
+        {
+            if (interaction_function[ftype].flags & IF_VSITE)
+            {
+                if (ilist[ftype].nr > task->ilist[ftype].nalloc)
+                {
+                    task->ilist[ftype].nalloc = over_alloc_large(ilist[ftype].nr);
+                    srenew(task->ilist[ftype].iatoms, task->ilist[ftype].nalloc);
+                }
+                if (ilist[ftype].nr > task->id_ilist[ftype].nalloc)
+                {
+                    task->id_ilist[ftype].nalloc = over_alloc_large(ilist[ftype].nr);
+                    srenew(task->id_ilist[ftype].iatoms, task->id_ilist[ftype].nalloc);
+                }
+
+                task->ilist[ftype].nr    = 0;
+                task->id_ilist[ftype].nr = 0;
+            }
+        }
+        task->nid_atom = 0;
+    }
+}
+
+/* Determines the dependency level of each vsite, stored in at_level,
+ * and returns the number of levels. Vsites constructed from normal
+ * atoms only have level 0, other vsites have a level one higher than
+ * the highest level of their constructing vsites.
+ */
+static int set_vsite_levels(const t_ilist *ilist, const t_iparams *ip,
+                            int *at_level)
+{
+    int            ftype, i, j, inc, stride, nr, nvsite, npass, level, nlevel;
+    const t_iatom *ia;
+    gmx_bool       bChanged;
 
+    nvsite = 0;
     for (ftype = 0; ftype < F_NRE; ftype++)
     {
         if (interaction_function[ftype].flags & IF_VSITE)
         {
-            if (ilist[ftype].nr > vsite_th->ilist[ftype].nalloc)
+            ia = ilist[ftype].iatoms;
+            for (i = 0; i < ilist[ftype].nr; i += vsite_nr_iatoms(ftype, ia + i, ip))
             {
-                vsite_th->ilist[ftype].nalloc = over_alloc_large(ilist[ftype].nr);
-                srenew(vsite_th->ilist[ftype].iatoms, vsite_th->ilist[ftype].nalloc);
+                at_level[ia[i+1]] = 0;
+                nvsite++;
             }
+        }
+    }
 
-            vsite_th->ilist[ftype].nr = 0;
+    /* Vsites can be constructed from vsites of any type, so we iterate
+     * until the levels no longer change. The number of passes is
+     * the maximum level plus two, so usually only one or two passes.
+     */
+    nlevel = (nvsite > 0 ? 1 : 0);
+    npass  = 0;
+    do
+    {
+        bChanged = FALSE;
+        for (ftype = 0; ftype < F_NRE; ftype++)
+        {
+            if (interaction_function[ftype].flags & IF_VSITE)
+            {
+                nr     = ilist[ftype].nr;
+                ia     = ilist[ftype].iatoms;
+                stride = vsite_construct_stride(ftype);
+                for (i = 0; i < nr; i += inc)
+                {
+                    inc   = vsite_nr_iatoms(ftype, ia + i, ip);
+                    level = 0;
+                    for (j = i + 2; j < i + inc; j += stride)
+                    {
+                        level = max(level, at_level[ia[j]] + 1);
+                    }
+                    if (level != at_level[ia[i+1]])
+                    {
+                        at_level[ia[i+1]] = level;
+                        nlevel            = max(nlevel, level + 1);
+                        bChanged          = TRUE;
+                    }
+                }
+            }
+        }
+        npass++;
+        if (npass > nvsite + 1)
+        {
+            gmx_fatal(FARGS, "Virtual sites are constructed from each other in a circular way");
         }
     }
+    while (bChanged);
+
+    return nlevel;
 }
 
 void split_vsites_over_threads(const t_ilist   *ilist,
+                               const t_iparams *ip,
                                const t_mdatoms *mdatoms,
                                gmx_bool         bLimitRange,
                                gmx_vsite_t     *vsite)
 {
-    int      th;
-    int      vsite_atom_range, natperthread;
-    int     *th_ind;
-    int      ftype;
-    t_iatom *iat;
-    t_ilist *il_th;
-    int      nral1, inc, i, j;
+    int               th;
+    int               vsite_atom_range, natperthread;
+    int               ftype, level, key;
+    t_iatom          *iat;
+    t_ilist          *il_th;
+    gmx_vsite_task_t *task;
+    int               inc, stride, i, j;
+    gmx_bool          bOwnRange;
 
     if (vsite->nthreads == 1)
     {
@@ -1861,17 +2079,7 @@ void split_vsites_over_threads(const t_ilist   *ilist,
         return;
     }
 
-#pragma omp parallel for num_threads(vsite->nthreads) schedule(static)
-    for (th = 0; th < vsite->nthreads; th++)
-    {
-        prepare_vsite_thread(ilist, &vsite->tdata[th]);
-    }
-    /* Master threads does the (potential) overlap vsites */
-    prepare_vsite_thread(ilist, &vsite->tdata[vsite->nthreads]);
-
-    /* The current way of distributing the vsites over threads in primitive.
-     * We divide the atom range 0 - natoms_in_vsite uniformly over threads,
-     * without taking into account how the vsites are distributed.
+    /* We divide the atom range 0 - natoms_in_vsite uniformly over threads.
      * Without domain decomposition we bLimitRange=TRUE and we at least
      * tighten the upper bound of the range (useful for common systems
      * such as a vsite-protein in 3-site water).
@@ -1881,14 +2089,15 @@ void split_vsites_over_threads(const t_ilist   *ilist,
         vsite_atom_range = -1;
         for (ftype = 0; ftype < F_NRE; ftype++)
         {
-            if ((interaction_function[ftype].flags & IF_VSITE) &&
-                ftype != F_VSITEN)
+            if (interaction_function[ftype].flags & IF_VSITE)
             {
-                nral1 = 1 + NRAL(ftype);
-                iat   = ilist[ftype].iatoms;
-                for (i = 0; i < ilist[ftype].nr; i += nral1)
+                iat    = ilist[ftype].iatoms;
+                stride = vsite_construct_stride(ftype);
+                for (i = 0; i < ilist[ftype].nr; i += inc)
                 {
-                    for (j = i+1; j < i+nral1; j++)
+                    inc              = vsite_nr_iatoms(ftype, iat + i, ip);
+                    vsite_atom_range = max(vsite_atom_range, iat[i+1]);
+                    for (j = i+2; j < i+inc; j += stride)
                     {
                         vsite_atom_range = max(vsite_atom_range, iat[j]);
                     }
@@ -1901,108 +2110,137 @@ void split_vsites_over_threads(const t_ilist   *ilist,
     {
         vsite_atom_range = mdatoms->homenr;
     }
-    natperthread = (vsite_atom_range + vsite->nthreads - 1)/vsite->nthreads;
+    natperthread        = (vsite_atom_range + vsite->nthreads - 1)/vsite->nthreads;
+    vsite->natperthread = max(natperthread, 1);
 
     if (debug)
     {
         fprintf(debug, "virtual site thread dist: natoms %d, range %d, natperthread %d\n", mdatoms->nr, vsite_atom_range, natperthread);
     }
 
-    /* To simplify the vsite assignment, we make an index which tells us
-     * to which thread particles, both non-vsites and vsites, are assigned.
-     */
-    if (mdatoms->nr > vsite->th_ind_nalloc)
+    if (mdatoms->nr > vsite->at_nalloc)
     {
-        vsite->th_ind_nalloc = over_alloc_large(mdatoms->nr);
-        srenew(vsite->th_ind, vsite->th_ind_nalloc);
+        vsite->at_nalloc = over_alloc_large(mdatoms->nr);
+        srenew(vsite->at_level, vsite->at_nalloc);
+        srenew(vsite->at_mark, vsite->at_nalloc);
     }
-    th_ind = vsite->th_ind;
-    th     = 0;
     for (i = 0; i < mdatoms->nr; i++)
     {
-        if (mdatoms->ptype[i] == eptVSite)
-        {
-            /* vsites are not assigned to a thread yet */
-            th_ind[i] = -1;
-        }
-        else
-        {
-            /* assign non-vsite particles to thread th */
-            th_ind[i] = th;
-        }
-        if (i == (th + 1)*natperthread && th < vsite->nthreads)
-        {
-            th++;
-        }
+        /* Non-vsites, and vsites constructed on other ranks, are ready */
+        vsite->at_level[i] = -1;
+        vsite->at_mark[i]  = -1;
+    }
+    vsite->nlevel = set_vsite_levels(ilist, ip, vsite->at_level);
+
+#pragma omp parallel for num_threads(vsite->nthreads) schedule(static)
+    for (th = 0; th < vsite->nthreads; th++)
+    {
+        prepare_vsite_thread(ilist, vsite->nlevel, &vsite->tdata[th]);
     }
 
+    /* Assign each vsite to the thread of the vsite atom, at its level.
+     * When all constructing atoms are in the atom range of that thread,
+     * the thread can spread the force directly, otherwise the force
+     * goes through the thread-local buffer.
+     */
     for (ftype = 0; ftype < F_NRE; ftype++)
     {
-        if ((interaction_function[ftype].flags & IF_VSITE) &&
-            ftype != F_VSITEN)
+        if (interaction_function[ftype].flags & IF_VSITE)
         {
-            nral1 = 1 + NRAL(ftype);
-            inc   = nral1;
-            iat   = ilist[ftype].iatoms;
-            for (i = 0; i < ilist[ftype].nr; )
+            iat    = ilist[ftype].iatoms;
+            stride = vsite_construct_stride(ftype);
+            for (i = 0; i < ilist[ftype].nr; i += inc)
             {
-                th = iat[1+i]/natperthread;
-                /* We would like to assign this vsite the thread th,
-                 * but it might depend on atoms outside the atom range of th
-                 * or on another vsite not assigned to thread th.
-                 */
-                if (ftype != F_VSITEN)
+                inc       = vsite_nr_iatoms(ftype, iat + i, ip);
+                th        = vsite_atom_thread(vsite, iat[i+1]);
+                bOwnRange = TRUE;
+                for (j = i+2; j < i+inc; j += stride)
                 {
-                    for (j = i+2; j < i+nral1; j++)
+                    if (vsite_atom_thread(vsite, iat[j]) != th)
                     {
-                        if (th_ind[iat[j]] != th)
-                        {
-                            /* Some constructing atoms are not assigned to
-                             * thread th, move this vsite to a separate batch.
-                             */
-                            th = vsite->nthreads;
-                        }
+                        bOwnRange = FALSE;
                     }
                 }
+
+                task = &vsite->tdata[th].task[vsite->at_level[iat[i+1]]];
+                if (bOwnRange)
+                {
+                    il_th = &task->ilist[ftype];
+                }
                 else
                 {
-                    inc = iat[i];
-                    for (j = i+2; j < i+inc; j += 3)
-                    {
-                        if (th_ind[iat[j]] != th)
-                        {
-                            th = vsite->nthreads;
-                        }
-                    }
+                    il_th = &task->id_ilist[ftype];
                 }
-                /* Copy this vsite to the thread data struct of thread th */
-                il_th = &vsite->tdata[th].ilist[ftype];
                 for (j = i; j < i+inc; j++)
                 {
                     il_th->iatoms[il_th->nr++] = iat[j];
                 }
-                /* Update this vsite's thread index entry */
-                th_ind[iat[1+i]] = th;
+            }
+        }
+    }
+
+    /* Make the list of atoms each task spreads to through its buffer */
+    for (th = 0; th < vsite->nthreads; th++)
+    {
+        gmx_vsite_thread_t *tdata = &vsite->tdata[th];
 
-                i += inc;
+        for (level = 0; level < vsite->nlevel; level++)
+        {
+            task = &tdata->task[level];
+            key  = th*vsite->nlevel + level;
+            for (ftype = 0; ftype < F_NRE; ftype++)
+            {
+                if (interaction_function[ftype].flags & IF_VSITE)
+                {
+                    il_th  = &task->id_ilist[ftype];
+                    iat    = il_th->iatoms;
+                    stride = vsite_construct_stride(ftype);
+                    for (i = 0; i < il_th->nr; i += inc)
+                    {
+                        inc = vsite_nr_iatoms(ftype, iat + i, ip);
+                        for (j = i+2; j < i+inc; j += stride)
+                        {
+                            if (vsite->at_mark[iat[j]] != key)
+                            {
+                                vsite->at_mark[iat[j]] = key;
+                                if (task->nid_atom >= task->id_atom_nalloc)
+                                {
+                                    task->id_atom_nalloc = over_alloc_large(task->nid_atom + 1);
+                                    srenew(task->id_atom, task->id_atom_nalloc);
+                                }
+                                task->id_atom[task->nid_atom++] = iat[j];
+                            }
+                        }
+                    }
+                }
+            }
+            if (task->nid_atom > 0 && mdatoms->nr > tdata->f_id_nalloc)
+            {
+                tdata->f_id_nalloc = over_alloc_large(mdatoms->nr);
+                srenew(tdata->f_id, tdata->f_id_nalloc);
             }
         }
     }
 
     if (debug)
     {
-        for (ftype = 0; ftype < F_NRE; ftype++)
+        for (level = 0; level < vsite->nlevel; level++)
         {
-            if ((interaction_function[ftype].flags & IF_VSITE) &&
-                ilist[ftype].nr > 0)
+            for (ftype = 0; ftype < F_NRE; ftype++)
             {
-                fprintf(debug, "%-20s thread dist:",
-                        interaction_function[ftype].longname);
-                for (th = 0; th < vsite->nthreads+1; th++)
+                if ((interaction_function[ftype].flags & IF_VSITE) &&
+                    ilist[ftype].nr > 0)
                 {
-                    fprintf(debug, " %4d", vsite->tdata[th].ilist[ftype].nr);
+                    fprintf(debug, "%-20s level %d thread dist:",
+                            interaction_function[ftype].longname, level);
+                    for (th = 0; th < vsite->nthreads; th++)
+                    {
+                        fprintf(debug, " %4d %4d",
+                                vsite->tdata[th].task[level].ilist[ftype].nr,
+                                vsite->tdata[th].task[level].id_ilist[ftype].nr);
+                    }
+                    fprintf(debug, "\n");
                 }
-                fprintf(debug, "\n");
             }
         }
     }
@@ -2034,6 +2272,7 @@ void set_vsite_top(gmx_vsite_t *vsite, gmx_localtop_t *top, t_mdatoms *md,
             gmx_fatal(FARGS, "The combination of threading, virtual sites and charge groups is not implemented");
         }
 
-        split_vsites_over_threads(top->idef.il, md, !DOMAINDECOMP(cr), vsite);
+        split_vsites_over_threads(top->idef.il, top->idef.iparams, md,
+                                  !DOMAINDECOMP(cr), vsite);
     }
 }
@@ -330,8 +330,17 @@ void AnalysisNeighborhoodSearchImpl::initGridCellNeighborList()
                   + sqr(recipcell_[ZZ][XX]));
     maxx   = static_cast<int>(cutoff_ * rvnorm) + 1;
 
+    /* With few cells along a dimension, the periodic wrapping would map
+     * several offsets to the same cell and return pairs more than once,
+     * so then we use each cell along that dimension only once.
+     */
+    const int minx = -maxx, miny = -maxy, minz = -maxz;
+    maxx = std::min(maxx, minx + ncelldim_[XX] - 1);
+    maxy = std::min(maxy, miny + ncelldim_[YY] - 1);
+    maxz = std::min(maxz, minz + ncelldim_[ZZ] - 1);
+
     /* Calculate the number of cells and reallocate if necessary */
-    ngridnb_ = (2 * maxx + 1) * (2 * maxy + 1) * (2 * maxz + 1);
+    ngridnb_ = (maxx - minx + 1) * (maxy - miny + 1) * (maxz - minz + 1);
     if (gnboffs_nalloc_ < ngridnb_)
     {
         gnboffs_nalloc_ = ngridnb_;
@@ -341,11 +350,11 @@ void AnalysisNeighborhoodSearchImpl::initGridCellNeighborList()
     /* Store the whole cube */
     /* TODO: Prune off corners that are not needed */
     int i = 0;
-    for (int x = -maxx; x <= maxx; ++x)
+    for (int x = minx; x <= maxx; ++x)
     {
-        for (int y = -maxy; y <= maxy; ++y)
+        for (int y = miny; y <= maxy; ++y)
         {
-            for (int z = -maxz; z <= maxz; ++z)
+            for (int z = minz; z <= maxz; ++z)
             {
                 gnboffs_[i][XX] = x;
                 gnboffs_[i][YY] = y;
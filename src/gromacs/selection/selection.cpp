@@ -41,7 +41,10 @@
  */
 #include "selection.h"
 
+#include <cstring>
+
 #include "gromacs/topology/topology.h"
+#include "gromacs/utility/smalloc.h"
 
 #include "nbsearch.h"
 #include "position.h"
@@ -105,6 +108,31 @@ SelectionData::SelectionData(SelectionTreeElement *elem,
 }
 
 
+SelectionData::SelectionData(const SelectionData &other)
+    : name_(other.name_), selectionText_(other.selectionText_),
+      posMass_(other.posMass_), posCharge_(other.posCharge_),
+      flags_(other.flags_), rootElement_(other.rootElement_),
+      coveredFractionType_(other.coveredFractionType_),
+      coveredFraction_(other.coveredFraction_),
+      averageCoveredFraction_(other.averageCoveredFraction_),
+      bDynamic_(other.bDynamic_),
+      bDynamicCoveredFraction_(other.bDynamicCoveredFraction_)
+{
+    gmx_ana_pos_copy(&rawPositions_,
+                     const_cast<gmx_ana_pos_t *>(&other.rawPositions_), true);
+    // The atoms of a dynamic selection can point to evaluation buffers that
+    // are overwritten for the next frame, so these need a private copy.
+    gmx_ana_indexmap_t &m = rawPositions_.m;
+    if (m.mapb.nalloc_a == 0 && m.mapb.nra > 0)
+    {
+        const atom_id *atoms = m.mapb.a;
+        snew(m.mapb.a, m.mapb.nra);
+        std::memcpy(m.mapb.a, atoms, m.mapb.nra*sizeof(*m.mapb.a));
+        m.mapb.nalloc_a = m.mapb.nra;
+    }
+}
+
+
 SelectionData::~SelectionData()
 {
 }
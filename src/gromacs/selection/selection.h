@@ -58,6 +58,7 @@ struct t_topology;
 namespace gmx
 {
 
+class SelectionFrameCopy;
 class SelectionOptionStorage;
 class SelectionTreeElement;
 
@@ -94,6 +95,19 @@ class SelectionData
          * \throws    std::bad_alloc if out of memory.
          */
         SelectionData(SelectionTreeElement *elem, const char *selstr);
+        /*! \brief
+         * Creates a frame-local copy of a selection.
+         *
+         * \param[in] other  Selection to copy.
+         * \throws    std::bad_alloc if out of memory.
+         *
+         * The copy has its own copy of the positions, masses, charges, and
+         * the covered fraction of \p other for the current frame, such that
+         * it is not affected when \p other is evaluated for another frame.
+         * The evaluation tree is shared, so the copy cannot be evaluated.
+         * Used by SelectionFrameCopy.
+         */
+        explicit SelectionData(const SelectionData &other);
         ~SelectionData();
 
         //! Returns the name for this selection.
@@ -218,7 +232,7 @@ class SelectionData
          */
         friend class gmx::SelectionPosition;
 
-        GMX_DISALLOW_COPY_AND_ASSIGN(SelectionData);
+        GMX_DISALLOW_ASSIGN(SelectionData);
 };
 
 }   // namespace internal
@@ -537,6 +551,10 @@ class Selection
          * Needed to access the data to adjust flags.
          */
         friend class SelectionOptionStorage;
+        /*! \brief
+         * Needed to map selections to their frame-local copies.
+         */
+        friend class SelectionFrameCopy;
 };
 
 /*! \brief
@@ -377,6 +377,10 @@ class SelectionCollection
          * Needed for the evaluator to freely modify the collection.
          */
         friend class SelectionEvaluator;
+        /*! \brief
+         * Needed to access all the selections for making copies.
+         */
+        friend class SelectionFrameCopy;
 };
 
 } // namespace gmx
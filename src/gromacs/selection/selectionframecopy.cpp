@@ -0,0 +1,113 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Implements gmx::SelectionFrameCopy.
+ *
+ * \ingroup module_selection
+ */
+#include "selectionframecopy.h"
+
+#include <map>
+
+#include "gromacs/selection/selection.h"
+#include "gromacs/selection/selectioncollection.h"
+#include "gromacs/utility/uniqueptr.h"
+
+#include "selectioncollection-impl.h"
+
+namespace gmx
+{
+
+/********************************************************************
+ * SelectionFrameCopy::Impl
+ */
+
+/*! \internal \brief
+ * Private implementation class for SelectionFrameCopy.
+ *
+ * \ingroup module_selection
+ */
+class SelectionFrameCopy::Impl
+{
+    public:
+        //! Container that associates a copy with the original selection.
+        typedef std::map<const internal::SelectionData *, SelectionDataPointer>
+            CopyContainer;
+
+        //! Copies of the selections, indexed by the original selection.
+        CopyContainer           copies_;
+};
+
+/********************************************************************
+ * SelectionFrameCopy
+ */
+
+SelectionFrameCopy::SelectionFrameCopy()
+    : impl_(new Impl)
+{
+}
+
+
+SelectionFrameCopy::~SelectionFrameCopy()
+{
+}
+
+
+void
+SelectionFrameCopy::copyFrom(const SelectionCollection &selections)
+{
+    const SelectionDataList          &sel = selections.impl_->sc_.sel;
+    SelectionDataList::const_iterator i;
+    for (i = sel.begin(); i != sel.end(); ++i)
+    {
+        impl_->copies_[i->get()].reset(new internal::SelectionData(**i));
+    }
+}
+
+
+Selection
+SelectionFrameCopy::find(const Selection &selection) const
+{
+    Impl::CopyContainer::const_iterator i
+        = impl_->copies_.find(&selection.data());
+    if (i == impl_->copies_.end())
+    {
+        return selection;
+    }
+    return Selection(i->second.get());
+}
+
+} // namespace gmx
@@ -0,0 +1,102 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \libinternal \file
+ * \brief
+ * Declares gmx::SelectionFrameCopy.
+ *
+ * \inlibraryapi
+ * \ingroup module_selection
+ */
+#ifndef GMX_SELECTION_SELECTIONFRAMECOPY_H
+#define GMX_SELECTION_SELECTIONFRAMECOPY_H
+
+#include "../utility/common.h"
+
+namespace gmx
+{
+
+class Selection;
+class SelectionCollection;
+
+/*! \libinternal \brief
+ * Frame-local copies of the selections in a collection.
+ *
+ * A SelectionCollection can only hold the evaluated selections for one frame
+ * at a time.  This class keeps a copy of the positions and other per-frame
+ * data of each selection, such that a frame can still be analyzed after the
+ * collection has been evaluated for the next frame.
+ * This is used to analyze several frames concurrently.
+ *
+ * \inlibraryapi
+ * \ingroup module_selection
+ */
+class SelectionFrameCopy
+{
+    public:
+        //! Creates an object without any copies.
+        SelectionFrameCopy();
+        ~SelectionFrameCopy();
+
+        /*! \brief
+         * Copies the current state of all selections in a collection.
+         *
+         * \param[in] selections  Selection collection to copy.
+         * \throws    std::bad_alloc if out of memory.
+         *
+         * Should be called after \p selections has been evaluated.
+         * Replaces any earlier copies.
+         */
+        void copyFrom(const SelectionCollection &selections);
+        /*! \brief
+         * Returns the frame-local copy of a selection.
+         *
+         * \param[in] selection  Selection from the collection given to
+         *      copyFrom().
+         * \returns   The copy of \p selection, or \p selection itself if no
+         *      copy has been made.
+         *
+         * Does not throw.
+         */
+        Selection find(const Selection &selection) const;
+
+    private:
+        class Impl;
+
+        PrivateImplPointer<Impl> impl_;
+};
+
+} // namespace gmx
+
+#endif
@@ -375,6 +375,32 @@ class RandomBoxFullPBCData
         NeighborhoodSearchTestData data_;
 };
 
+class RandomBoxSmallCellsData
+{
+    public:
+        static const NeighborhoodSearchTestData &get()
+        {
+            static RandomBoxSmallCellsData singleton;
+            return singleton.data_;
+        }
+
+        RandomBoxSmallCellsData() : data_(12345, 1.0)
+        {
+            // The grid cells are smaller than the cutoff, and there are so
+            // few of them that the cutoff sphere wraps around the box.
+            data_.box_[XX][XX] = 3.0;
+            data_.box_[YY][YY] = 3.0;
+            data_.box_[ZZ][ZZ] = 3.0;
+            data_.generateRandomRefPositions(1000);
+            data_.generateRandomTestPositions(100);
+            set_pbc(&data_.pbc_, epbcXYZ, data_.box_);
+            data_.computeReferences(&data_.pbc_);
+        }
+
+    private:
+        NeighborhoodSearchTestData data_;
+};
+
 class RandomTriclinicFullPBCData
 {
     public:
@@ -466,6 +492,22 @@ TEST_F(NeighborhoodSearchTest, GridSearchBox)
     testPairSearch(&search, data);
 }
 
+TEST_F(NeighborhoodSearchTest, GridSearchSmallCells)
+{
+    const NeighborhoodSearchTestData &data = RandomBoxSmallCellsData::get();
+
+    nb_.setCutoff(data.cutoff_);
+    nb_.setMode(gmx::AnalysisNeighborhood::eSearchMode_Grid);
+    gmx::AnalysisNeighborhoodSearch search =
+        nb_.initSearch(&data.pbc_, data.refPositions());
+    ASSERT_EQ(gmx::AnalysisNeighborhood::eSearchMode_Grid, search.mode());
+
+    testIsWithin(&search, data);
+    testMinimumDistance(&search, data);
+    testNearestPoint(&search, data);
+    testPairSearch(&search, data);
+}
+
 TEST_F(NeighborhoodSearchTest, GridSearchTriclinic)
 {
     const NeighborhoodSearchTestData &data = RandomTriclinicFullPBCData::get();
@@ -0,0 +1,470 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#ifndef GMX_SIMD_IMPL_X86_AVX_512_H
+#define GMX_SIMD_IMPL_X86_AVX_512_H
+
+#include <math.h>
+#include <immintrin.h>
+
+/* As for AVX_256 we start from scratch rather than inheriting from the
+ * 256-bit implementation, since nearly all types and instructions change.
+ * The capabilities still form a superset of AVX2_256.
+ */
+#define GMX_SIMD_X86_SSE2_OR_HIGHER
+#define GMX_SIMD_X86_SSE4_1_OR_HIGHER
+#define GMX_SIMD_X86_AVX_256_OR_HIGHER
+#define GMX_SIMD_X86_AVX2_256_OR_HIGHER
+#define GMX_SIMD_X86_AVX_512_OR_HIGHER
+
+
+/* x86 512-bit AVX-512 SIMD instruction wrappers
+ *
+ * Please see documentation in gromacs/simd/simd.h for defines.
+ *
+ * Only the AVX-512F foundation subset is used, which is present on all
+ * AVX-512 capable hardware. Booleans are stored in the AVX-512 mask
+ * registers, so comparisons, blends and masked moves never touch the
+ * floating-point data registers. Since AVX-512 hardware also supports
+ * AVX2 and FMA, the SIMD4 and half-width integer types use those.
+ */
+
+/* Capability definitions for 512-bit AVX-512F */
+#define GMX_SIMD_HAVE_FLOAT
+#define GMX_SIMD_HAVE_DOUBLE
+#define GMX_SIMD_HAVE_SIMD_HARDWARE
+#define GMX_SIMD_HAVE_LOADU
+#define GMX_SIMD_HAVE_STOREU
+#define GMX_SIMD_HAVE_LOGICAL
+#define GMX_SIMD_HAVE_FMA
+#undef  GMX_SIMD_HAVE_FRACTION
+#define GMX_SIMD_HAVE_FINT32
+#define GMX_SIMD_HAVE_FINT32_EXTRACT     /* Emulated */
+#define GMX_SIMD_HAVE_FINT32_LOGICAL
+#define GMX_SIMD_HAVE_FINT32_ARITHMETICS
+#define GMX_SIMD_HAVE_DINT32
+#define GMX_SIMD_HAVE_DINT32_EXTRACT     /* Emulated, dint uses 256-bit AVX2 */
+#define GMX_SIMD_HAVE_DINT32_LOGICAL
+#define GMX_SIMD_HAVE_DINT32_ARITHMETICS
+#define GMX_SIMD4_HAVE_FLOAT
+#define GMX_SIMD4_HAVE_DOUBLE
+
+/* Implementation details */
+#define GMX_SIMD_FLOAT_WIDTH        16
+#define GMX_SIMD_DOUBLE_WIDTH        8
+#define GMX_SIMD_FINT32_WIDTH       16
+#define GMX_SIMD_DINT32_WIDTH        8
+#define GMX_SIMD_RSQRT_BITS         14
+#define GMX_SIMD_RCP_BITS           14
+
+/****************************************************
+ *      SINGLE PRECISION SIMD IMPLEMENTATION        *
+ ****************************************************/
+#define gmx_simd_float_t           __m512
+#define gmx_simd_load_f            _mm512_load_ps
+#define gmx_simd_load1_f(m)        _mm512_set1_ps(*(m))
+#define gmx_simd_set1_f            _mm512_set1_ps
+#define gmx_simd_store_f           _mm512_store_ps
+#define gmx_simd_loadu_f           _mm512_loadu_ps
+#define gmx_simd_storeu_f          _mm512_storeu_ps
+#define gmx_simd_setzero_f         _mm512_setzero_ps
+#define gmx_simd_add_f             _mm512_add_ps
+#define gmx_simd_sub_f             _mm512_sub_ps
+#define gmx_simd_mul_f             _mm512_mul_ps
+#define gmx_simd_fmadd_f           _mm512_fmadd_ps
+#define gmx_simd_fmsub_f           _mm512_fmsub_ps
+#define gmx_simd_fnmadd_f          _mm512_fnmadd_ps
+#define gmx_simd_fnmsub_f          _mm512_fnmsub_ps
+#define gmx_simd_and_f(a, b)        _mm512_castsi512_ps(_mm512_and_epi32(_mm512_castps_si512(a), _mm512_castps_si512(b)))
+#define gmx_simd_andnot_f(a, b)     _mm512_castsi512_ps(_mm512_andnot_epi32(_mm512_castps_si512(a), _mm512_castps_si512(b)))
+#define gmx_simd_or_f(a, b)         _mm512_castsi512_ps(_mm512_or_epi32(_mm512_castps_si512(a), _mm512_castps_si512(b)))
+#define gmx_simd_xor_f(a, b)        _mm512_castsi512_ps(_mm512_xor_epi32(_mm512_castps_si512(a), _mm512_castps_si512(b)))
+#define gmx_simd_rsqrt_f           _mm512_rsqrt14_ps
+#define gmx_simd_rcp_f             _mm512_rcp14_ps
+#define gmx_simd_fabs_f(x)         gmx_simd_andnot_f(_mm512_set1_ps(-0.0), x)
+#define gmx_simd_fneg_f(x)         gmx_simd_xor_f(x, _mm512_set1_ps(-0.0))
+#define gmx_simd_max_f             _mm512_max_ps
+#define gmx_simd_min_f             _mm512_min_ps
+#define gmx_simd_round_f(x)        _mm512_roundscale_ps(x, _MM_FROUND_TO_NEAREST_INT)
+#define gmx_simd_trunc_f(x)        _mm512_roundscale_ps(x, _MM_FROUND_TO_ZERO)
+#define gmx_simd_fraction_f(x)     _mm512_sub_ps(x, gmx_simd_trunc_f(x))
+#define gmx_simd_get_exponent_f(x) _mm512_getexp_ps(x)
+#define gmx_simd_get_mantissa_f(x) _mm512_getmant_ps(x, _MM_MANT_NORM_1_2, _MM_MANT_SIGN_zero)
+#define gmx_simd_set_exponent_f    gmx_simd_set_exponent_f_avx_512
+/* integer datatype corresponding to float: gmx_simd_fint32_t */
+#define gmx_simd_fint32_t          __m512i
+#define gmx_simd_load_fi(m)        _mm512_load_si512((const void *)(m))
+#define gmx_simd_set1_fi           _mm512_set1_epi32
+#define gmx_simd_store_fi(m, x)     _mm512_store_si512((void *)(m), x)
+#define gmx_simd_loadu_fi(m)       _mm512_loadu_si512((const void *)(m))
+#define gmx_simd_storeu_fi(m, x)    _mm512_storeu_si512((void *)(m), x)
+#define gmx_simd_setzero_fi        _mm512_setzero_si512
+#define gmx_simd_cvt_f2i           _mm512_cvtps_epi32
+#define gmx_simd_cvtt_f2i          _mm512_cvttps_epi32
+#define gmx_simd_cvt_i2f           _mm512_cvtepi32_ps
+#define gmx_simd_extract_fi(x, i)   _mm_extract_epi32(_mm512_extracti32x4_epi32(x, (i)>>2), (i)&0x3)
+/* Integer logical ops on gmx_simd_fint32_t */
+#define gmx_simd_slli_fi           _mm512_slli_epi32
+#define gmx_simd_srli_fi           _mm512_srli_epi32
+#define gmx_simd_and_fi            _mm512_and_epi32
+#define gmx_simd_andnot_fi         _mm512_andnot_epi32
+#define gmx_simd_or_fi             _mm512_or_epi32
+#define gmx_simd_xor_fi            _mm512_xor_epi32
+/* Integer arithmetic ops on gmx_simd_fint32_t */
+#define gmx_simd_add_fi            _mm512_add_epi32
+#define gmx_simd_sub_fi            _mm512_sub_epi32
+#define gmx_simd_mul_fi            _mm512_mullo_epi32
+/* Boolean & comparison operations on gmx_simd_float_t */
+#define gmx_simd_fbool_t           __mmask16
+#define gmx_simd_cmpeq_f(a, b)      _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ)
+#define gmx_simd_cmplt_f(a, b)      _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ)
+#define gmx_simd_cmple_f(a, b)      _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ)
+#define gmx_simd_and_fb            _mm512_kand
+#define gmx_simd_or_fb             _mm512_kor
+#define gmx_simd_anytrue_fb        _mm512_mask2int
+#define gmx_simd_blendzero_f(a, sel)     _mm512_maskz_mov_ps(sel, a)
+#define gmx_simd_blendnotzero_f(a, sel)  _mm512_maskz_mov_ps(_mm512_knot(sel), a)
+#define gmx_simd_blendv_f(a, b, sel)     _mm512_mask_blend_ps(sel, a, b)
+#define gmx_simd_reduce_f(a)       _mm512_reduce_add_ps(a)
+/* Boolean & comparison operations on gmx_simd_fint32_t */
+#define gmx_simd_fibool_t          __mmask16
+#define gmx_simd_cmpeq_fi(a, b)     _mm512_cmp_epi32_mask(a, b, _MM_CMPINT_EQ)
+#define gmx_simd_cmplt_fi(a, b)     _mm512_cmp_epi32_mask(a, b, _MM_CMPINT_LT)
+#define gmx_simd_and_fib           _mm512_kand
+#define gmx_simd_or_fib            _mm512_kor
+#define gmx_simd_anytrue_fib       _mm512_mask2int
+#define gmx_simd_blendzero_fi(a, sel)    _mm512_maskz_mov_epi32(sel, a)
+#define gmx_simd_blendnotzero_fi(a, sel) _mm512_maskz_mov_epi32(_mm512_knot(sel), a)
+#define gmx_simd_blendv_fi(a, b, sel)    _mm512_mask_blend_epi32(sel, a, b)
+/* Conversions between different booleans */
+#define gmx_simd_cvt_fb2fib(x)     (x)
+#define gmx_simd_cvt_fib2fb(x)     (x)
+
+/****************************************************
+ *      DOUBLE PRECISION SIMD IMPLEMENTATION        *
+ ****************************************************/
+#define gmx_simd_double_t          __m512d
+#define gmx_simd_load_d            _mm512_load_pd
+#define gmx_simd_load1_d(m)        _mm512_set1_pd(*(m))
+#define gmx_simd_set1_d            _mm512_set1_pd
+#define gmx_simd_store_d           _mm512_store_pd
+#define gmx_simd_loadu_d           _mm512_loadu_pd
+#define gmx_simd_storeu_d          _mm512_storeu_pd
+#define gmx_simd_setzero_d         _mm512_setzero_pd
+#define gmx_simd_add_d             _mm512_add_pd
+#define gmx_simd_sub_d             _mm512_sub_pd
+#define gmx_simd_mul_d             _mm512_mul_pd
+#define gmx_simd_fmadd_d           _mm512_fmadd_pd
+#define gmx_simd_fmsub_d           _mm512_fmsub_pd
+#define gmx_simd_fnmadd_d          _mm512_fnmadd_pd
+#define gmx_simd_fnmsub_d          _mm512_fnmsub_pd
+#define gmx_simd_and_d(a, b)        _mm512_castsi512_pd(_mm512_and_epi64(_mm512_castpd_si512(a), _mm512_castpd_si512(b)))
+#define gmx_simd_andnot_d(a, b)     _mm512_castsi512_pd(_mm512_andnot_epi64(_mm512_castpd_si512(a), _mm512_castpd_si512(b)))
+#define gmx_simd_or_d(a, b)         _mm512_castsi512_pd(_mm512_or_epi64(_mm512_castpd_si512(a), _mm512_castpd_si512(b)))
+#define gmx_simd_xor_d(a, b)        _mm512_castsi512_pd(_mm512_xor_epi64(_mm512_castpd_si512(a), _mm512_castpd_si512(b)))
+#define gmx_simd_rsqrt_d           _mm512_rsqrt14_pd
+#define gmx_simd_rcp_d             _mm512_rcp14_pd
+#define gmx_simd_fabs_d(x)         gmx_simd_andnot_d(_mm512_set1_pd(-0.0), x)
+#define gmx_simd_fneg_d(x)         gmx_simd_xor_d(x, _mm512_set1_pd(-0.0))
+#define gmx_simd_max_d             _mm512_max_pd
+#define gmx_simd_min_d             _mm512_min_pd
+#define gmx_simd_round_d(x)        _mm512_roundscale_pd(x, _MM_FROUND_TO_NEAREST_INT)
+#define gmx_simd_trunc_d(x)        _mm512_roundscale_pd(x, _MM_FROUND_TO_ZERO)
+#define gmx_simd_fraction_d(x)     _mm512_sub_pd(x, gmx_simd_trunc_d(x))
+#define gmx_simd_get_exponent_d(x) _mm512_getexp_pd(x)
+#define gmx_simd_get_mantissa_d(x) _mm512_getmant_pd(x, _MM_MANT_NORM_1_2, _MM_MANT_SIGN_zero)
+#define gmx_simd_set_exponent_d    gmx_simd_set_exponent_d_avx_512
+/* integer datatype corresponding to double: gmx_simd_dint32_t */
+#define gmx_simd_dint32_t          __m256i
+#define gmx_simd_load_di(m)        _mm256_load_si256((const __m256i *)(m))
+#define gmx_simd_set1_di           _mm256_set1_epi32
+#define gmx_simd_store_di(m, x)     _mm256_store_si256((__m256i *)(m), x)
+#define gmx_simd_loadu_di(m)       _mm256_loadu_si256((const __m256i *)(m))
+#define gmx_simd_storeu_di(m, x)    _mm256_storeu_si256((__m256i *)(m), x)
+#define gmx_simd_setzero_di        _mm256_setzero_si256
+#define gmx_simd_cvt_d2i           _mm512_cvtpd_epi32
+#define gmx_simd_cvtt_d2i          _mm512_cvttpd_epi32
+#define gmx_simd_cvt_i2d           _mm512_cvtepi32_pd
+#define gmx_simd_extract_di(x, i)   _mm_extract_epi32(_mm256_extracti128_si256(x, (i)>>2), (i)&0x3)
+/* Integer logical ops on gmx_simd_dint32_t */
+#define gmx_simd_slli_di           _mm256_slli_epi32
+#define gmx_simd_srli_di           _mm256_srli_epi32
+#define gmx_simd_and_di            _mm256_and_si256
+#define gmx_simd_andnot_di         _mm256_andnot_si256
+#define gmx_simd_or_di             _mm256_or_si256
+#define gmx_simd_xor_di            _mm256_xor_si256
+/* Integer arithmetic ops on integer datatype corresponding to double */
+#define gmx_simd_add_di            _mm256_add_epi32
+#define gmx_simd_sub_di            _mm256_sub_epi32
+#define gmx_simd_mul_di            _mm256_mullo_epi32
+/* Boolean & comparison operations on gmx_simd_double_t */
+#define gmx_simd_dbool_t           __mmask8
+#define gmx_simd_cmpeq_d(a, b)      _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ)
+#define gmx_simd_cmplt_d(a, b)      _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ)
+#define gmx_simd_cmple_d(a, b)      _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ)
+#define gmx_simd_and_db(a, b)       ((__mmask8)_mm512_kand(a, b))
+#define gmx_simd_or_db(a, b)        ((__mmask8)_mm512_kor(a, b))
+#define gmx_simd_anytrue_db(x)      (_mm512_mask2int(x) & 0xFF)
+#define gmx_simd_blendzero_d(a, sel)     _mm512_maskz_mov_pd(sel, a)
+#define gmx_simd_blendnotzero_d(a, sel)  _mm512_maskz_mov_pd((__mmask8)_mm512_knot(sel), a)
+#define gmx_simd_blendv_d(a, b, sel)     _mm512_mask_blend_pd(sel, a, b)
+#define gmx_simd_reduce_d(a)       _mm512_reduce_add_pd(a)
+/* Boolean & comparison operations on gmx_simd_dint32_t.
+ * The 8 dint32 elements live in the lower half of a 512-bit register for
+ * the mask operations, so the mask bits match those of gmx_simd_dbool_t.
+ */
+#define gmx_simd_dibool_t          __mmask8
+#define gmx_simd_cmpeq_di(a, b)     ((__mmask8)_mm512_mask_cmp_epi32_mask(0xFF, _mm512_castsi256_si512(a), _mm512_castsi256_si512(b), _MM_CMPINT_EQ))
+#define gmx_simd_cmplt_di(a, b)     ((__mmask8)_mm512_mask_cmp_epi32_mask(0xFF, _mm512_castsi256_si512(a), _mm512_castsi256_si512(b), _MM_CMPINT_LT))
+#define gmx_simd_and_dib(a, b)      ((__mmask8)_mm512_kand(a, b))
+#define gmx_simd_or_dib(a, b)       ((__mmask8)_mm512_kor(a, b))
+#define gmx_simd_anytrue_dib(x)     (_mm512_mask2int(x) & 0xFF)
+#define gmx_simd_blendzero_di(a, sel)    _mm512_castsi512_si256(_mm512_maskz_mov_epi32(sel, _mm512_castsi256_si512(a)))
+#define gmx_simd_blendnotzero_di(a, sel) _mm512_castsi512_si256(_mm512_maskz_mov_epi32(_mm512_knot(sel), _mm512_castsi256_si512(a)))
+#define gmx_simd_blendv_di(a, b, sel)    _mm512_castsi512_si256(_mm512_mask_blend_epi32(sel, _mm512_castsi256_si512(a), _mm512_castsi256_si512(b)))
+/* Conversions between different booleans */
+#define gmx_simd_cvt_db2dib(x)     (x)
+#define gmx_simd_cvt_dib2db(x)     (x)
+/* Float/double conversion */
+#define gmx_simd_cvt_f2dd          gmx_simd_cvt_f2dd_avx_512
+#define gmx_simd_cvt_dd2f          gmx_simd_cvt_dd2f_avx_512
+
+/****************************************************
+ *      SINGLE PRECISION SIMD4 IMPLEMENTATION       *
+ ****************************************************/
+/* SIMD4 uses 128-bit SSE/AVX registers with FMA, since masked 512-bit
+ * operations would only add latency for 4-wide work like PME spreading.
+ */
+#define gmx_simd4_float_t          __m128
+#define gmx_simd4_load_f           _mm_load_ps
+#define gmx_simd4_load1_f          _mm_broadcast_ss
+#define gmx_simd4_set1_f           _mm_set1_ps
+#define gmx_simd4_store_f          _mm_store_ps
+#define gmx_simd4_loadu_f          _mm_loadu_ps
+#define gmx_simd4_storeu_f         _mm_storeu_ps
+#define gmx_simd4_setzero_f        _mm_setzero_ps
+#define gmx_simd4_add_f            _mm_add_ps
+#define gmx_simd4_sub_f            _mm_sub_ps
+#define gmx_simd4_mul_f            _mm_mul_ps
+#define gmx_simd4_fmadd_f          _mm_fmadd_ps
+#define gmx_simd4_fmsub_f          _mm_fmsub_ps
+#define gmx_simd4_fnmadd_f         _mm_fnmadd_ps
+#define gmx_simd4_fnmsub_f         _mm_fnmsub_ps
+#define gmx_simd4_and_f            _mm_and_ps
+#define gmx_simd4_andnot_f         _mm_andnot_ps
+#define gmx_simd4_or_f             _mm_or_ps
+#define gmx_simd4_xor_f            _mm_xor_ps
+#define gmx_simd4_rsqrt_f(x)       _mm512_castps512_ps128(_mm512_rsqrt14_ps(_mm512_castps128_ps512(x)))
+#define gmx_simd4_fabs_f(x)        _mm_andnot_ps(_mm_set1_ps(-0.0), x)
+#define gmx_simd4_fneg_f(x)        _mm_xor_ps(x, _mm_set1_ps(-0.0))
+#define gmx_simd4_max_f            _mm_max_ps
+#define gmx_simd4_min_f            _mm_min_ps
+#define gmx_simd4_round_f(x)       _mm_round_ps(x, _MM_FROUND_NINT)
+#define gmx_simd4_trunc_f(x)       _mm_round_ps(x, _MM_FROUND_TRUNC)
+#define gmx_simd4_dotproduct3_f    gmx_simd4_dotproduct3_f_avx_512
+#define gmx_simd4_fbool_t          __m128
+#define gmx_simd4_cmpeq_f          _mm_cmpeq_ps
+#define gmx_simd4_cmplt_f          _mm_cmplt_ps
+#define gmx_simd4_cmple_f          _mm_cmple_ps
+#define gmx_simd4_and_fb           _mm_and_ps
+#define gmx_simd4_or_fb            _mm_or_ps
+#define gmx_simd4_anytrue_fb       _mm_movemask_ps
+#define gmx_simd4_blendzero_f      _mm_and_ps
+#define gmx_simd4_blendnotzero_f(a, sel)  _mm_andnot_ps(sel, a)
+#define gmx_simd4_blendv_f         _mm_blendv_ps
+#define gmx_simd4_reduce_f         gmx_simd4_reduce_f_avx_512
+
+/****************************************************
+ *      DOUBLE PRECISION SIMD4 IMPLEMENTATION       *
+ ****************************************************/
+#define gmx_simd4_double_t          __m256d
+#define gmx_simd4_load_d            _mm256_load_pd
+#define gmx_simd4_load1_d           _mm256_broadcast_sd
+#define gmx_simd4_set1_d            _mm256_set1_pd
+#define gmx_simd4_store_d           _mm256_store_pd
+#define gmx_simd4_loadu_d           _mm256_loadu_pd
+#define gmx_simd4_storeu_d          _mm256_storeu_pd
+#define gmx_simd4_setzero_d         _mm256_setzero_pd
+#define gmx_simd4_add_d             _mm256_add_pd
+#define gmx_simd4_sub_d             _mm256_sub_pd
+#define gmx_simd4_mul_d             _mm256_mul_pd
+#define gmx_simd4_fmadd_d           _mm256_fmadd_pd
+#define gmx_simd4_fmsub_d           _mm256_fmsub_pd
+#define gmx_simd4_fnmadd_d          _mm256_fnmadd_pd
+#define gmx_simd4_fnmsub_d          _mm256_fnmsub_pd
+#define gmx_simd4_and_d             _mm256_and_pd
+#define gmx_simd4_andnot_d          _mm256_andnot_pd
+#define gmx_simd4_or_d              _mm256_or_pd
+#define gmx_simd4_xor_d             _mm256_xor_pd
+#define gmx_simd4_rsqrt_d(x)        _mm512_castpd512_pd256(_mm512_rsqrt14_pd(_mm512_castpd256_pd512(x)))
+#define gmx_simd4_fabs_d(x)         _mm256_andnot_pd(_mm256_set1_pd(-0.0), x)
+#define gmx_simd4_fneg_d(x)         _mm256_xor_pd(x, _mm256_set1_pd(-0.0))
+#define gmx_simd4_max_d             _mm256_max_pd
+#define gmx_simd4_min_d             _mm256_min_pd
+#define gmx_simd4_round_d(x)        _mm256_round_pd(x, _MM_FROUND_NINT)
+#define gmx_simd4_trunc_d(x)        _mm256_round_pd(x, _MM_FROUND_TRUNC)
+#define gmx_simd4_dotproduct3_d     gmx_simd4_dotproduct3_d_avx_512
+#define gmx_simd4_dbool_t           __m256d
+#define gmx_simd4_cmpeq_d(a, b)      _mm256_cmp_pd(a, b, _CMP_EQ_OQ)
+#define gmx_simd4_cmplt_d(a, b)      _mm256_cmp_pd(a, b, _CMP_LT_OQ)
+#define gmx_simd4_cmple_d(a, b)      _mm256_cmp_pd(a, b, _CMP_LE_OQ)
+#define gmx_simd4_and_db            _mm256_and_pd
+#define gmx_simd4_or_db             _mm256_or_pd
+#define gmx_simd4_anytrue_db        _mm256_movemask_pd
+#define gmx_simd4_blendzero_d       _mm256_and_pd
+#define gmx_simd4_blendnotzero_d(a, sel)  _mm256_andnot_pd(sel, a)
+#define gmx_simd4_blendv_d          _mm256_blendv_pd
+#define gmx_simd4_reduce_d          gmx_simd4_reduce_d_avx_512
+/* SIMD4 float/double conversion */
+#define gmx_simd4_cvt_f2d           _mm256_cvtps_pd
+#define gmx_simd4_cvt_d2f           _mm256_cvtpd_ps
+
+/*********************************************************
+ * SIMD SINGLE PRECISION IMPLEMENTATION HELPER FUNCTIONS *
+ *********************************************************/
+static gmx_inline __m512
+gmx_simd_set_exponent_f_avx_512(__m512 x)
+{
+    const __m512i expbias      = _mm512_set1_epi32(127);
+    __m512i       iexp         = _mm512_cvtps_epi32(x);
+
+    iexp = _mm512_slli_epi32(_mm512_add_epi32(iexp, expbias), 23);
+    return _mm512_castsi512_ps(iexp);
+}
+
+/*********************************************************
+ * SIMD DOUBLE PRECISION IMPLEMENTATION HELPER FUNCTIONS *
+ *********************************************************/
+static gmx_inline __m512d
+gmx_simd_set_exponent_d_avx_512(__m512d x)
+{
+    const __m512i expbias      = _mm512_set1_epi64(1023);
+    __m512i       iexp         = _mm512_cvtepi32_epi64(_mm512_cvtpd_epi32(x));
+
+    iexp = _mm512_slli_epi64(_mm512_add_epi64(iexp, expbias), 52);
+    return _mm512_castsi512_pd(iexp);
+}
+
+static gmx_inline void
+gmx_simd_cvt_f2dd_avx_512(__m512 f, __m512d *d0, __m512d *d1)
+{
+    *d0 = _mm512_cvtps_pd(_mm512_castps512_ps256(f));
+    *d1 = _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(f), 0x1)));
+}
+
+static gmx_inline __m512
+gmx_simd_cvt_dd2f_avx_512(__m512d d0, __m512d d1)
+{
+    __m256 f0 = _mm512_cvtpd_ps(d0);
+    __m256 f1 = _mm512_cvtpd_ps(d1);
+    return _mm512_castpd_ps(_mm512_insertf64x4(_mm512_castpd256_pd512(_mm256_castps_pd(f0)), _mm256_castps_pd(f1), 0x1));
+}
+
+/* SIMD4 reduce helpers */
+static gmx_inline float
+gmx_simd4_reduce_f_avx_512(__m128 a)
+{
+    float f;
+    a = _mm_hadd_ps(a, a);
+    a = _mm_hadd_ps(a, a);
+    _mm_store_ss(&f, a);
+    return f;
+}
+
+static gmx_inline double
+gmx_simd4_reduce_d_avx_512(__m256d a)
+{
+    double  f;
+    __m128d a0, a1;
+    a  = _mm256_hadd_pd(a, a);
+    a0 = _mm256_castpd256_pd128(a);
+    a1 = _mm256_extractf128_pd(a, 0x1);
+    a0 = _mm_add_sd(a0, a1);
+    _mm_store_sd(&f, a0);
+    return f;
+}
+
+/* SIMD4 Dotproduct helper functions */
+static gmx_inline float
+gmx_simd4_dotproduct3_f_avx_512(__m128 a, __m128 b)
+{
+    float  f;
+    __m128 c;
+    a = _mm_mul_ps(a, b);
+    c = _mm_add_ps(a, _mm_permute_ps(a, _MM_SHUFFLE(0, 3, 2, 1)));
+    c = _mm_add_ps(c, _mm_permute_ps(a, _MM_SHUFFLE(1, 0, 3, 2)));
+    _mm_store_ss(&f, c);
+    return f;
+}
+
+static gmx_inline double
+gmx_simd4_dotproduct3_d_avx_512(__m256d a, __m256d b)
+{
+    double  d;
+    __m128d tmp1, tmp2;
+    a    = _mm256_mul_pd(a, b);
+    tmp1 = _mm256_castpd256_pd128(a);
+    tmp2 = _mm256_extractf128_pd(a, 0x1);
+
+    tmp1 = _mm_add_pd(tmp1, _mm_permute_pd(tmp1, _MM_SHUFFLE2(0, 1)));
+    tmp1 = _mm_add_pd(tmp1, tmp2);
+    _mm_store_sd(&d, tmp1);
+    return d;
+}
+
+/* Function to check whether SIMD operations have resulted in overflow */
+static int
+gmx_simd_check_and_reset_overflow(void)
+{
+    int MXCSR;
+    int sse_overflow;
+
+    MXCSR = _mm_getcsr();
+    /* The overflow flag is bit 3 in the register */
+    if (MXCSR & 0x0008)
+    {
+        sse_overflow = 1;
+        /* Set the overflow flag to zero */
+        MXCSR = MXCSR & 0xFFF7;
+        _mm_setcsr(MXCSR);
+    }
+    else
+    {
+        sse_overflow = 0;
+    }
+    return sse_overflow;
+}
+
+
+#endif /* GMX_SIMD_IMPL_X86_AVX_512_H */
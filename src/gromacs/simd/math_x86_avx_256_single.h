@@ -35,6 +35,16 @@
 #ifndef GMX_SIMD_MATH_AVX_256_SINGLE_H
 #define GMX_SIMD_MATH_AVX_256_SINGLE_H
 
+/* The group kernels are written for 256-bit AVX. When configured for
+ * AVX-512, the build system compiles them with
+ * GMX_SIMD_X86_AVX_512_USE_256BIT, which makes simd.h select the AVX2_256
+ * module. All functions in the SIMD module are static, so this is fine
+ * even though other files use the AVX-512 definitions.
+ */
+#if defined GMX_SIMD_X86_AVX_512 && !defined GMX_SIMD_X86_AVX_512_USE_256BIT
+#error "The 256-bit AVX group kernels need GMX_SIMD_X86_AVX_512_USE_256BIT with AVX-512"
+#endif
+
 #include "simd_math.h"
 
 /* Temporary:
@@ -112,10 +112,14 @@ static gmx_inline double * gmx_simd4_align_d(double *p);
  * while the part running on the coprocessor defines __MIC__. All functions in
  * this SIMD module are static, so it will work perfectly fine to include this
  * file with different SIMD definitions for different files.
+ * The same holds for AVX-512: the build system compiles the 256-bit group
+ * kernels with GMX_SIMD_X86_AVX_512_USE_256BIT, which selects AVX2_256.
  */
 #if defined __MIC__
 #    include "gromacs/simd/impl_intel_mic/impl_intel_mic.h"
-#elif defined GMX_SIMD_X86_AVX2_256
+#elif defined GMX_SIMD_X86_AVX_512 && !defined GMX_SIMD_X86_AVX_512_USE_256BIT
+#    include "gromacs/simd/impl_x86_avx_512/impl_x86_avx_512.h"
+#elif defined GMX_SIMD_X86_AVX2_256 || defined GMX_SIMD_X86_AVX_512
 #    include "gromacs/simd/impl_x86_avx2_256/impl_x86_avx2_256.h"
 #elif defined GMX_SIMD_X86_AVX_256
 #    include "gromacs/simd/impl_x86_avx_256/impl_x86_avx_256.h"
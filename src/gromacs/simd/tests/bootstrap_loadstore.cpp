@@ -47,7 +47,8 @@
  *
  * - gmx_simd_align_r(),gmx_simd_align_i(),gmx_simd4_align_r(),
  * - gmx_simd_load_r(),gmx_simd_store_r(),gmx_simd_loadu_r(),gmx_simd_storeu_r()
- * - gmx_simd_load_i(),gmx_simd_store_i(), gmx_simd_loadu_i(),gmx_simd_storeu_i()
+ * - gmx_simd_load_i(),gmx_simd_store_i(), gmx_simd_loadu_i(),gmx_simd_storeu_i(),
+ *   also with pointer arithmetic in the macro argument
  * - gmx_simd4_load_r(),gmx_simd4_store_r(), gmx_simd4_loadu_r(),gmx_simd4_storeu_r()
  *
  * \author Erik Lindahl <erik.lindahl@scilifelab.se>
@@ -233,6 +234,54 @@ TEST(SimdBootstrapTest, gmxSimdStoreUI)
     }
 }
 #    endif
+
+/*! \brief Test integer load/store with pointer arithmetic in the argument.
+ *
+ * Some implementations cast the pointer argument of the integer load/store
+ * macros, so an argument like ptr + offset must be offset in elements,
+ * not in bytes. The tests above only pass plain pointer variables.
+ */
+TEST(SimdBootstrapTest, gmxSimdLoadStoreIPointerArithmetic)
+{
+    const int        width = GMX_SIMD_INT32_WIDTH;
+    std::vector<int> src(width*5);
+    std::vector<int> dst(width*5);
+    int             *pSrc = gmx_simd_align_i(&src[0]);
+    int             *pDst = gmx_simd_align_i(&dst[0]);
+    int              offset, i;
+
+    for (offset = 0; offset < 2*width; offset++)
+    {
+        for (i = 0; i < width*5; i++)
+        {
+            src[i] =  1+i;
+            dst[i] = -1-i;
+        }
+        if (offset % width == 0)
+        {
+            gmx_simd_store_i(pDst + offset, gmx_simd_load_i(pSrc + offset));
+        }
+        else
+        {
+#    if (defined GMX_SIMD_HAVE_LOADU) && (defined GMX_SIMD_HAVE_STOREU)
+            gmx_simd_storeu_i(pDst + offset, gmx_simd_loadu_i(pSrc + offset));
+#    else
+            continue;
+#    endif
+        }
+        for (i = 0; i < width; i++)
+        {
+            EXPECT_EQ(pSrc[offset + i], pDst[offset + i]) << "Data not moved correctly for element " << i << " with offset " << offset;
+        }
+        for (i = 0; i < width*5; i++)
+        {
+            if (&dst[0]+i < pDst + offset || &dst[0]+i >= pDst + offset + width)
+            {
+                EXPECT_EQ(dst[i], -1-i) << "Side effect on destination memory, i = " << i << " with offset " << offset;
+            }
+        }
+    }
+}
 #endif
 
 #ifdef GMX_SIMD4_HAVE_REAL
@@ -110,8 +110,8 @@ static const char *wcsn[ewcsNR] =
     "DD redist.", "DD NS grid + sort", "DD setup comm.",
     "DD make top.", "DD make constr.", "DD top. other",
     "NS grid local", "NS grid non-loc.", "NS search local", "NS search non-loc.",
-    "Bonded F", "Nonbonded F", "Ewald F correction",
-    "NB X buffer ops.", "NB F buffer ops."
+    "Bonded F", "Nonbonded F", "Nonbonded pruning", "Ewald F correction",
+    "NB X buffer ops.", "NB F buffer ops.", "PME 3D-FFT comm. wait"
 };
 
 gmx_bool wallcycle_have_counter(void)
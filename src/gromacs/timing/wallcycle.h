@@ -65,8 +65,8 @@ enum {
     ewcsDD_MAKETOP, ewcsDD_MAKECONSTR, ewcsDD_TOPOTHER,
     ewcsNBS_GRID_LOCAL, ewcsNBS_GRID_NONLOCAL,
     ewcsNBS_SEARCH_LOCAL, ewcsNBS_SEARCH_NONLOCAL,
-    ewcsBONDED, ewcsNONBONDED, ewcsEWALD_CORRECTION,
-    ewcsNB_X_BUF_OPS, ewcsNB_F_BUF_OPS,
+    ewcsBONDED, ewcsNONBONDED, ewcsNONBONDED_PRUNING, ewcsEWALD_CORRECTION,
+    ewcsNB_X_BUF_OPS, ewcsNB_F_BUF_OPS, ewcsPME_FFTCOMM_WAIT,
     ewcsNR
 };
 
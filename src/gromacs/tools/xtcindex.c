@@ -0,0 +1,110 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "xtcindex.h"
+
+#include <stdio.h>
+
+#include "macros.h"
+#include "gromacs/commandline/pargs.h"
+#include "gromacs/fileio/filenm.h"
+#include "gromacs/fileio/xtcindex.h"
+#include "gromacs/utility/fatalerror.h"
+
+int gmx_xtcindex(int argc, char *argv[])
+{
+    const char  *desc[] = {
+        "[THISMODULE] builds a frame index for an [TT].xtc[tt] trajectory.",
+        "The index is written to a file with the name of the trajectory",
+        "with [TT].idx[tt] appended and contains the file offset, step,",
+        "time and number of atoms of each frame. Only the frame headers",
+        "are read, so building the index is much faster than reading",
+        "the trajectory.[PAR]",
+        "When an index file is present, seeking in the trajectory,",
+        "e.g. with the [TT]-b[tt] option of analysis tools, uses",
+        "the index instead of searching the compressed trajectory.",
+        "An index that does not match the trajectory is not used.",
+        "When the environment variable [TT]GMX_XTC_INDEX[tt] is set,",
+        "[TT]mdrun[tt] and other tools write the index while writing",
+        "[TT].xtc[tt] files, also when appending."
+    };
+    t_filenm     fnm[] = {
+        { efXTC, "-f", NULL, ffREAD }
+    };
+#define NFILE asize(fnm)
+
+    output_env_t oenv;
+    const char  *fn;
+    t_xtc_index *index;
+    gmx_off_t    offset;
+    int          nframes, natoms, step;
+    real         t0, t1;
+
+    if (!parse_common_args(&argc, argv, 0, NFILE, fnm, 0, NULL,
+                           asize(desc), desc, 0, NULL, &oenv))
+    {
+        return 0;
+    }
+
+    fn    = ftp2fn(efXTC, NFILE, fnm);
+    index = xtc_index_build(fn);
+    if (index == NULL)
+    {
+        gmx_fatal(FARGS, "Could not read trajectory file %s", fn);
+    }
+    if (!xtc_index_write(index, fn))
+    {
+        gmx_fatal(FARGS, "Could not write the frame index %s%s", fn, XTC_INDEX_EXT);
+    }
+
+    nframes = xtc_index_nframes(index);
+    if (nframes > 0)
+    {
+        xtc_index_get_frame(index, 0, &offset, &natoms, &step, &t0);
+        xtc_index_get_frame(index, nframes - 1, &offset, &natoms, &step, &t1);
+        fprintf(stderr, "Wrote the index of %d frames of %s, time %g to %g, to %s%s\n",
+                nframes, fn, t0, t1, fn, XTC_INDEX_EXT);
+    }
+    else
+    {
+        fprintf(stderr, "WARNING: No complete frames found in %s\n", fn);
+    }
+    xtc_index_destroy(index);
+
+    return 0;
+}
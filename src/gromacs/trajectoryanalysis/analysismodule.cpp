@@ -45,6 +45,7 @@
 
 #include "gromacs/analysisdata/analysisdata.h"
 #include "gromacs/selection/selection.h"
+#include "gromacs/selection/selectionframecopy.h"
 #include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/gmxassert.h"
 
@@ -118,6 +119,8 @@ class TrajectoryAnalysisModuleData::Impl
         HandleContainer            handles_;
         //! Stores thread-local selections.
         const SelectionCollection &selections_;
+        //! Frame-local copies of \a selections_ (empty if not used).
+        SelectionFrameCopy         frameSelections_;
 };
 
 TrajectoryAnalysisModuleData::Impl::Impl(
@@ -200,8 +203,13 @@ TrajectoryAnalysisModuleData::dataHandle(const AnalysisData &data)
 
 Selection TrajectoryAnalysisModuleData::parallelSelection(const Selection &selection)
 {
-    // TODO: Implement properly.
-    return selection;
+    return impl_->frameSelections_.find(selection);
+}
+
+
+void TrajectoryAnalysisModuleData::copySelectionsForFrame()
+{
+    impl_->frameSelections_.copyFrom(impl_->selections_);
 }
 
 
@@ -64,6 +64,7 @@ class AnalysisDataParallelOptions;
 class Options;
 class SelectionCollection;
 class TopologyInformation;
+class TrajectoryAnalysisCommandLineRunner;
 class TrajectoryAnalysisModule;
 class TrajectoryAnalysisSettings;
 
@@ -124,7 +125,9 @@ class TrajectoryAnalysisModuleData
          * \p selection is the selection object that was obtained from
          * SelectionOption.  The return value is the corresponding selection
          * in the selection collection with which this data object was
-         * constructed with.
+         * constructed with.  If the runner analyzes several frames
+         * concurrently, the returned selection is a copy that holds the
+         * evaluated values for the frame that this data object is used for.
          *
          * Does not throw.
          */
@@ -171,9 +174,29 @@ class TrajectoryAnalysisModuleData
         void finishDataHandles();
 
     private:
+        /*! \brief
+         * Stores copies of the current selections for the frame to analyze.
+         *
+         * \throws  std::bad_alloc if out of memory.
+         *
+         * Called by the runner after the selections have been evaluated when
+         * several frames are analyzed concurrently.  After the call,
+         * parallelSelection() returns the copies instead of the selections
+         * in the collection.
+         */
+        void copySelectionsForFrame();
+
         class Impl;
 
         PrivateImplPointer<Impl> impl_;
+
+        /*! \brief
+         * Needed to copy the selections for each frame.
+         *
+         * \todo
+         * Consider a cleaner mechanism if other runners need this.
+         */
+        friend class TrajectoryAnalysisCommandLineRunner;
 };
 
 //! Smart pointer to manage a TrajectoryAnalysisModuleData object.
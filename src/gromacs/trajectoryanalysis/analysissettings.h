@@ -115,6 +115,22 @@ class TrajectoryAnalysisSettings
              * \see setRmPBC()
              */
             efNoUserRmPBC    = 1<<5,
+            /*! \brief
+             * Allows analyzing several frames concurrently.
+             *
+             * If this flag is specified, the user can request several threads
+             * for the analysis with -nt (the default is one), and TrajectoryAnalysisModule::analyzeFrame()
+             * may then be called concurrently for different frames, each
+             * with its own TrajectoryAnalysisModuleData.
+             * The module should then only modify data through the
+             * TrajectoryAnalysisModuleData object, and should access the
+             * selections through
+             * TrajectoryAnalysisModuleData::parallelSelection().
+             * The flag can be cleared in
+             * TrajectoryAnalysisModule::optionsFinished() if the options
+             * selected by the user do not support it.
+             */
+            efParallelFrames = 1<<6,
         };
 
         //! Initializes default settings.
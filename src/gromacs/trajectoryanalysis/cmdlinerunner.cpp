@@ -45,6 +45,10 @@
 #include "config.h"
 #endif
 
+#include <cstring>
+
+#include <vector>
+
 #include "gromacs/analysisdata/paralleloptions.h"
 #include "gromacs/commandline/cmdlinehelpcontext.h"
 #include "gromacs/commandline/cmdlinehelpwriter.h"
@@ -62,10 +66,80 @@
 #include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/file.h"
 #include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/smalloc.h"
 
 namespace gmx
 {
 
+namespace
+{
+
+/*! \internal \brief
+ * Data for one frame when several frames are analyzed concurrently.
+ *
+ * \ingroup module_trajectoryanalysis
+ */
+class AnalysisFrameSlot
+{
+    public:
+        AnalysisFrameSlot()
+        {
+            std::memset(&frame_, 0, sizeof(frame_));
+        }
+        ~AnalysisFrameSlot()
+        {
+            sfree(frame_.x);
+            sfree(frame_.v);
+            sfree(frame_.f);
+        }
+
+        /*! \brief
+         * Copies \p fr to \a frame_.
+         *
+         * The coordinate, velocity and force arrays are copied to buffers
+         * owned by this object.
+         */
+        void copyFrame(const t_trxframe &fr)
+        {
+            rvec *x = frame_.x;
+            rvec *v = frame_.v;
+            rvec *f = frame_.f;
+            frame_   = fr;
+            frame_.x = copyArray(x, fr.natoms, fr.bX ? fr.x : NULL);
+            frame_.v = copyArray(v, fr.natoms, fr.bV ? fr.v : NULL);
+            frame_.f = copyArray(f, fr.natoms, fr.bF ? fr.f : NULL);
+        }
+
+        //! Copy of the frame to analyze.
+        t_trxframe                           frame_;
+        //! PBC information for \a frame_.
+        t_pbc                                pbc_;
+        //! Thread-local data for the module.
+        TrajectoryAnalysisModuleDataPointer  pdata_;
+        //! Exception thrown while analyzing the frame, if any.
+        boost::exception_ptr                 error_;
+
+    private:
+        static rvec *copyArray(rvec *buffer, int natoms, const rvec *src)
+        {
+            if (src == NULL)
+            {
+                sfree(buffer);
+                return NULL;
+            }
+            srenew(buffer, natoms);
+            std::memcpy(buffer, src, natoms*sizeof(*buffer));
+            return buffer;
+        }
+
+        GMX_DISALLOW_COPY_AND_ASSIGN(AnalysisFrameSlot);
+};
+
+//! Smart pointer to manage an AnalysisFrameSlot.
+typedef gmx_unique_ptr<AnalysisFrameSlot>::type AnalysisFrameSlotPointer;
+
+}   // namespace
+
 /********************************************************************
  * TrajectoryAnalysisCommandLineRunner::Impl
  */
@@ -196,34 +270,104 @@ TrajectoryAnalysisCommandLineRunner::run(int argc, char *argv[])
     common.initFirstFrame();
     module->initAfterFirstFrame(common.frame());
 
-    t_pbc  pbc;
-    t_pbc *ppbc = settings.hasPBC() ? &pbc : NULL;
-
-    int    nframes = 0;
-    AnalysisDataParallelOptions         dataOptions;
-    TrajectoryAnalysisModuleDataPointer pdata(
-            module->startFrames(dataOptions, selections));
-    do
+    int          nframes  = 0;
+    const int    nthreads = common.threadCount();
+    if (nthreads == 1)
     {
-        common.initFrame();
-        t_trxframe &frame = common.frame();
-        if (ppbc != NULL)
+        t_pbc  pbc;
+        t_pbc *ppbc = settings.hasPBC() ? &pbc : NULL;
+
+        AnalysisDataParallelOptions         dataOptions;
+        TrajectoryAnalysisModuleDataPointer pdata(
+                module->startFrames(dataOptions, selections));
+        do
         {
-            set_pbc(ppbc, topology.ePBC(), frame.box);
-        }
+            common.initFrame();
+            t_trxframe &frame = common.frame();
+            if (ppbc != NULL)
+            {
+                set_pbc(ppbc, topology.ePBC(), frame.box);
+            }
 
-        selections.evaluate(&frame, ppbc);
-        module->analyzeFrame(nframes, frame, ppbc, pdata.get());
+            selections.evaluate(&frame, ppbc);
+            module->analyzeFrame(nframes, frame, ppbc, pdata.get());
 
-        nframes++;
+            nframes++;
+        }
+        while (common.readNextFrame());
+        module->finishFrames(pdata.get());
+        if (pdata.get() != NULL)
+        {
+            pdata->finish();
+        }
+        pdata.reset();
     }
-    while (common.readNextFrame());
-    module->finishFrames(pdata.get());
-    if (pdata.get() != NULL)
+    else
     {
-        pdata->finish();
+        // Reading the frames and evaluating the selections is done serially
+        // in batches of nthreads frames; the selections are copied for each
+        // frame, and the frames of a batch are then analyzed concurrently.
+        AnalysisDataParallelOptions           dataOptions(nthreads);
+        std::vector<AnalysisFrameSlotPointer> slots;
+        for (int i = 0; i < nthreads; ++i)
+        {
+            slots.push_back(AnalysisFrameSlotPointer(new AnalysisFrameSlot));
+            slots.back()->pdata_ = module->startFrames(dataOptions, selections);
+        }
+        bool bMoreFrames = true;
+        while (bMoreFrames)
+        {
+            int nbatch = 0;
+            while (bMoreFrames && nbatch < nthreads)
+            {
+                AnalysisFrameSlot &slot = *slots[nbatch];
+                common.initFrame();
+                slot.copyFrame(common.frame());
+                t_pbc *ppbc = settings.hasPBC() ? &slot.pbc_ : NULL;
+                if (ppbc != NULL)
+                {
+                    set_pbc(ppbc, topology.ePBC(), slot.frame_.box);
+                }
+                selections.evaluate(&slot.frame_, ppbc);
+                slot.pdata_->copySelectionsForFrame();
+                ++nbatch;
+                bMoreFrames = common.readNextFrame();
+            }
+
+#pragma omp parallel for num_threads(nbatch) schedule(static, 1)
+            for (int i = 0; i < nbatch; ++i)
+            {
+                AnalysisFrameSlot &slot = *slots[i];
+                try
+                {
+                    t_pbc *ppbc = settings.hasPBC() ? &slot.pbc_ : NULL;
+                    module->analyzeFrame(nframes + i, slot.frame_, ppbc,
+                                         slot.pdata_.get());
+                }
+                catch (...)
+                {
+                    slot.error_ = boost::current_exception();
+                }
+            }
+            for (int i = 0; i < nbatch; ++i)
+            {
+                if (slots[i]->error_)
+                {
+                    boost::rethrow_exception(slots[i]->error_);
+                }
+            }
+            nframes += nbatch;
+        }
+        for (int i = 0; i < nthreads; ++i)
+        {
+            module->finishFrames(slots[i]->pdata_.get());
+            if (slots[i]->pdata_.get() != NULL)
+            {
+                slots[i]->pdata_->finish();
+            }
+            slots[i]->pdata_.reset();
+        }
     }
-    pdata.reset();
 
     if (common.hasTrajectory())
     {
@@ -313,7 +313,7 @@ Angle::~Angle()
 
 
 void
-Angle::initOptions(Options *options, TrajectoryAnalysisSettings * /*settings*/)
+Angle::initOptions(Options *options, TrajectoryAnalysisSettings *settings)
 {
     static const char *const desc[] = {
         "[THISMODULE] computes different types of angles between vectors.",
@@ -397,11 +397,13 @@ Angle::initOptions(Options *options, TrajectoryAnalysisSettings * /*settings*/)
                                        .dynamicMask().storeVector(&sel2_)
                                        .multiValue()
                                        .description("Second analysis/vector selection"));
+
+    settings->setFlag(TrajectoryAnalysisSettings::efParallelFrames);
 }
 
 
 void
-Angle::optionsFinished(Options *options, TrajectoryAnalysisSettings * /* settings */)
+Angle::optionsFinished(Options *options, TrajectoryAnalysisSettings *settings)
 {
     const bool bSingle = (g1type_[0] == 'a' || g1type_[0] == 'd');
 
@@ -446,6 +448,11 @@ Angle::optionsFinished(Options *options, TrajectoryAnalysisSettings * /* setting
     {
         GMX_THROW(InconsistentInputError("Cannot provide a second selection (-group2) with -g2 t0 or z"));
     }
+    // The reference vectors for -g2 t0 are set from the first frame.
+    if (g2type_[0] == 't')
+    {
+        settings->setFlag(TrajectoryAnalysisSettings::efParallelFrames, false);
+    }
     // TODO: If bSingle is not set, the second selection option should be
     // required.
 }
@@ -703,7 +710,7 @@ Angle::analyzeFrame(int frnr, const t_trxframe &fr, t_pbc *pbc,
                 clear_rvec(c2);
                 break;
             case 's':
-                copy_rvec(sel2_[g].position(0).x(), c2);
+                copy_rvec(sel2[g].position(0).x(), c2);
                 break;
         }
         dh.selectDataSet(g);
@@ -130,7 +130,7 @@ Distance::Distance()
 
 
 void
-Distance::initOptions(Options *options, TrajectoryAnalysisSettings * /*settings*/)
+Distance::initOptions(Options *options, TrajectoryAnalysisSettings *settings)
 {
     static const char *const desc[] = {
         "[THISMODULE] calculates distances between pairs of positions",
@@ -179,6 +179,8 @@ Distance::initOptions(Options *options, TrajectoryAnalysisSettings * /*settings*
                            .description("Width of full distribution as fraction of [TT]-len[tt]"));
     options->addOption(DoubleOption("binw").store(&binWidth_)
                            .description("Bin width for histogramming"));
+
+    settings->setFlag(TrajectoryAnalysisSettings::efParallelFrames);
 }
 
 
@@ -51,6 +51,8 @@
 #include "gromacs/utility/smalloc.h"
 #include "nsc.h"
 
+#include "thread_mpi/threads.h"
+
 #define TEST_NSC 0
 
 #define TEST_ARC 0
@@ -64,6 +66,8 @@ real   *xpunsp = NULL;
 real    del_cube;
 int     n_dot, ico_cube, last_n_dot = 0, last_densit = 0, last_unsp = 0;
 int     last_cubus = 0;
+/* Protects the unit sphere above */
+static tMPI_Thread_mutex_t unsp_mutex = TMPI_THREAD_MUTEX_INITIALIZER;
 
 #define FOURPI (4.*M_PI)
 #define TORAD(A)     ((A)*0.017453293)
@@ -571,7 +575,8 @@ int make_unsp(int densit, int mode, int * num_dot, int cubus)
     /* determine distribution of points in elementary cubes */
     if (cubus)
     {
-        ico_cube = cubus;
+        ico_cube   = cubus;
+        last_cubus = cubus;
     }
     else
     {
@@ -667,7 +672,7 @@ int nsc_dclm_pbc(const rvec *coords, real *radius, int nat,
 {
     int         iat, i, ii, iii, ix, iy, iz, ixe, ixs, iye, iys, ize, izs, i_ac;
     int         jat, j, jj, jjj, jx, jy, jz;
-    int         distribution;
+    int         distribution, ndot;
     int         l;
     int         maxnei, nnei, last, maxdots = 0;
     int        *wkdot = NULL, *wkbox = NULL, *wkat1 = NULL, *wkatm = NULL;
@@ -685,23 +690,32 @@ int nsc_dclm_pbc(const rvec *coords, real *radius, int nat,
     rvec        ddx, *x = NULL;
     int         iat_xx, jat_xx;
 
+    /* The unit sphere is cached in global variables, so only access it
+     * while holding the lock, and work on a private copy such that the
+     * surface of different structures can be computed concurrently.
+     */
     distribution = unsp_type(densit);
+    tMPI_Thread_mutex_lock(&unsp_mutex);
     if (distribution != -last_unsp || last_cubus != 4 ||
         (densit != last_densit && densit != last_n_dot))
     {
         if (make_unsp(densit, (-distribution), &n_dot, 4))
         {
+            tMPI_Thread_mutex_unlock(&unsp_mutex);
             return 1;
         }
     }
-    xus = xpunsp;
+    ndot = n_dot;
+    snew(xus, 3*ndot);
+    memcpy(xus, xpunsp, 3*ndot*sizeof(*xus));
+    tMPI_Thread_mutex_unlock(&unsp_mutex);
 
-    dotarea = FOURPI/(real) n_dot;
+    dotarea = FOURPI/(real) ndot;
     area    = 0.;
 
     if (debug)
     {
-        fprintf(debug, "nsc_dclm: n_dot=%5d %9.3f\n", n_dot, dotarea);
+        fprintf(debug, "nsc_dclm: ndot=%5d %9.3f\n", ndot, dotarea);
     }
 
     /* start with neighbour list */
@@ -709,6 +723,7 @@ int nsc_dclm_pbc(const rvec *coords, real *radius, int nat,
     if (nat == 0)
     {
         WARNING("nsc_dclm: no surface atoms selected");
+        sfree(xus);
         return 1;
     }
     if (mode & FLAG_VOLUME)
@@ -717,7 +732,7 @@ int nsc_dclm_pbc(const rvec *coords, real *radius, int nat,
     }
     if (mode & FLAG_DOTS)
     {
-        maxdots = (3*n_dot*nat)/10;
+        maxdots = (3*ndot*nat)/10;
         /* should be set to NULL on first user call */
         if (dots == NULL)
         {
@@ -794,7 +809,7 @@ int nsc_dclm_pbc(const rvec *coords, real *radius, int nat,
         zs = zs/ (real) nat;
         if (debug)
         {
-            fprintf(debug, "nsc_dclm: n_dot=%5d ra2max=%9.3f %9.3f\n", n_dot, ra2max, dotarea);
+            fprintf(debug, "nsc_dclm: ndot=%5d ra2max=%9.3f %9.3f\n", ndot, ra2max, dotarea);
         }
 
         d    = xmax-xmin; nxbox = (int) max(ceil(d/ra2max), 1.);
@@ -814,7 +829,7 @@ int nsc_dclm_pbc(const rvec *coords, real *radius, int nat,
     /* box number of atoms */
     snew(wkatm, nat);
     snew(wkat1, nat);
-    snew(wkdot, n_dot);
+    snew(wkdot, ndot);
     snew(wkbox, nxyz+1);
 
     if (box)
@@ -886,8 +901,8 @@ int nsc_dclm_pbc(const rvec *coords, real *radius, int nat,
 
     if (debug)
     {
-        fprintf(debug, "nsc_dclm: n_dot=%5d ra2max=%9.3f %9.3f\n",
-                n_dot, ra2max, dotarea);
+        fprintf(debug, "nsc_dclm: ndot=%5d ra2max=%9.3f %9.3f\n",
+                ndot, ra2max, dotarea);
         fprintf(debug, "neighbour list calculated/box(xyz):%d %d %d\n",
                 nxbox, nybox, nzbox);
 
@@ -976,7 +991,7 @@ int nsc_dclm_pbc(const rvec *coords, real *radius, int nat,
                     aisq = ai*ai;
                     pco  = coords[i_at];
                     xi   = pco[XX]; yi = pco[YY]; zi = pco[ZZ];
-                    for (i = 0; i < n_dot; i++)
+                    for (i = 0; i < ndot; i++)
                     {
                         wkdot[i] = 0;
                     }
@@ -1032,7 +1047,7 @@ int nsc_dclm_pbc(const rvec *coords, real *radius, int nat,
                     if (nnei)
                     {
                         last = 0; i_ac = 0;
-                        for (l = 0; l < n_dot; l++)
+                        for (l = 0; l < ndot; l++)
                         {
                             if (xus[3*l]*(wknb+last)->x+
                                 xus[1+3*l]*(wknb+last)->y+
@@ -1057,8 +1072,8 @@ int nsc_dclm_pbc(const rvec *coords, real *radius, int nat,
                     }
                     else
                     {
-                        i_ac  = n_dot;
-                        for (l = 0; l < n_dot; l++)
+                        i_ac  = ndot;
+                        for (l = 0; l < ndot; l++)
                         {
                             wkdot[l] = 1;
                         }
@@ -1079,14 +1094,14 @@ int nsc_dclm_pbc(const rvec *coords, real *radius, int nat,
                     }
                     if (mode & FLAG_DOTS)
                     {
-                        for (l = 0; l < n_dot; l++)
+                        for (l = 0; l < ndot; l++)
                         {
                             if (wkdot[l])
                             {
                                 lfnr++;
                                 if (maxdots <= 3*lfnr+1)
                                 {
-                                    maxdots = maxdots+n_dot*3;
+                                    maxdots = maxdots+ndot*3;
                                     srenew(dots, maxdots);
                                 }
                                 dots[3*lfnr-3] = ai*xus[3*l]+xi;
@@ -1098,7 +1113,7 @@ int nsc_dclm_pbc(const rvec *coords, real *radius, int nat,
                     if (mode & FLAG_VOLUME)
                     {
                         dx = 0.; dy = 0.; dz = 0.;
-                        for (l = 0; l < n_dot; l++)
+                        for (l = 0; l < ndot; l++)
                         {
                             if (wkdot[l])
                             {
@@ -1120,13 +1135,14 @@ int nsc_dclm_pbc(const rvec *coords, real *radius, int nat,
     sfree(wkdot);
     sfree(wkbox);
     sfree(wknb);
+    sfree(xus);
     if (box)
     {
         sfree(x);
     }
     if (mode & FLAG_VOLUME)
     {
-        vol           = vol*FOURPI/(3.* (real) n_dot);
+        vol           = vol*FOURPI/(3.* (real) ndot);
         *value_of_vol = vol;
     }
     if (mode & FLAG_DOTS)
@@ -488,6 +488,7 @@ Sasa::initOptions(Options *options, TrajectoryAnalysisSettings *settings)
 
     // Atom names etc. are required for the VdW radii lookup.
     settings->setFlag(TrajectoryAnalysisSettings::efRequireTop);
+    settings->setFlag(TrajectoryAnalysisSettings::efParallelFrames);
 }
 
 void
@@ -63,6 +63,7 @@
 #include "gromacs/trajectoryanalysis/analysissettings.h"
 #include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/programcontext.h"
 #include "gromacs/utility/smalloc.h"
 #include "gromacs/utility/stringutil.h"
@@ -92,6 +93,8 @@ class TrajectoryAnalysisRunnerCommon::Impl
         double                      startTime_;
         double                      endTime_;
         double                      deltaTime_;
+        //! Number of threads requested for analyzing frames (0 = OpenMP default).
+        int                         nthreads_;
 
         gmx_ana_indexgrps_t        *grps_;
         bool                        bTrajOpen_;
@@ -106,7 +109,7 @@ class TrajectoryAnalysisRunnerCommon::Impl
 
 TrajectoryAnalysisRunnerCommon::Impl::Impl(TrajectoryAnalysisSettings *settings)
     : settings_(*settings),
-      startTime_(0.0), endTime_(0.0), deltaTime_(0.0),
+      startTime_(0.0), endTime_(0.0), deltaTime_(0.0), nthreads_(1),
       grps_(NULL),
       bTrajOpen_(false), fr(NULL), gpbc_(NULL), status_(NULL), oenv_(NULL)
 {
@@ -214,6 +217,13 @@ TrajectoryAnalysisRunnerCommon::initOptions(Options *options)
                                .description("Use periodic boundary conditions for distance calculation"));
     }
 
+    if (settings.hasFlag(TrajectoryAnalysisSettings::efParallelFrames))
+    {
+        // Frames are analyzed serially unless requested.
+        options->addOption(IntegerOption("nt").store(&impl_->nthreads_)
+                               .description("Number of threads for analyzing frames concurrently (0 = OpenMP default)"));
+    }
+
     options->addOption(SelectionFileOption("sf"));
 }
 
@@ -248,6 +258,10 @@ TrajectoryAnalysisRunnerCommon::optionsFinished(Options *options)
     {
         setTimeValue(TDELTA, impl_->deltaTime_);
     }
+    if (impl_->nthreads_ < 0)
+    {
+        GMX_THROW(InvalidInputError("Number of threads (-nt) must not be negative"));
+    }
 }
 
 
@@ -440,6 +454,21 @@ TrajectoryAnalysisRunnerCommon::initFrame()
 }
 
 
+int
+TrajectoryAnalysisRunnerCommon::threadCount() const
+{
+    if (!impl_->settings_.hasFlag(TrajectoryAnalysisSettings::efParallelFrames))
+    {
+        return 1;
+    }
+    if (impl_->nthreads_ > 0)
+    {
+        return impl_->nthreads_;
+    }
+    return gmx_omp_get_max_threads();
+}
+
+
 bool
 TrajectoryAnalysisRunnerCommon::hasTrajectory() const
 {
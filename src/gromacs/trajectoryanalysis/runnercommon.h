@@ -116,6 +116,13 @@ class TrajectoryAnalysisRunnerCommon
          */
         void initFrame();
 
+        /*! \brief
+         * Returns the number of frames to analyze concurrently.
+         *
+         * Returns one unless the module has set
+         * TrajectoryAnalysisSettings::efParallelFrames.
+         */
+        int threadCount() const;
         //! Returns true if input data comes from a trajectory.
         bool hasTrajectory() const;
         //! Returns the topology information object.
@@ -201,4 +201,44 @@ TEST_F(AngleModuleTest, HandlesOneVsMultipleVectorGroupsAngles)
     runTest(CommandLine(cmdline));
 }
 
+TEST_F(AngleModuleTest, ComputesMultipleAnglesOverTrajectory)
+{
+    const char *const cmdline[] = {
+        "angle",
+        "-g1", "vector",
+        "-group1",
+        "resname RV1 RV2 and name A1 A2",
+        "resname RV3 RV4 and name A1 A2",
+        "-g2", "plane",
+        "-group2",
+        "resname RP1 RP2 and name A1 A2 A3",
+        "resname RP1 RP2 and name A1 A2 A3",
+        "-binw", "60"
+    };
+    setTopology("angle.gro");
+    setTrajectory("angle.gro");
+    runTest(CommandLine(cmdline));
+}
+
+// The reference data should be identical to
+// ComputesMultipleAnglesOverTrajectory, except for the command line.
+TEST_F(AngleModuleTest, ComputesMultipleAnglesOverTrajectoryInParallel)
+{
+    const char *const cmdline[] = {
+        "angle",
+        "-g1", "vector",
+        "-group1",
+        "resname RV1 RV2 and name A1 A2",
+        "resname RV3 RV4 and name A1 A2",
+        "-g2", "plane",
+        "-group2",
+        "resname RP1 RP2 and name A1 A2 A3",
+        "resname RP1 RP2 and name A1 A2 A3",
+        "-binw", "60", "-nt", "2"
+    };
+    setTopology("angle.gro");
+    setTrajectory("angle.gro");
+    runTest(CommandLine(cmdline));
+}
+
 } // namespace
@@ -94,4 +94,30 @@ TEST_F(DistanceModuleTest, HandlesDynamicSelections)
     runTest(CommandLine(cmdline));
 }
 
+TEST_F(DistanceModuleTest, ComputesDistancesOverTrajectory)
+{
+    const char *const cmdline[] = {
+        "distance",
+        "-select", "atomname S1 S2 and res_cog x < 2.8",
+        "-len", "2", "-binw", "0.5"
+    };
+    setTopology("simple.gro");
+    setTrajectory("simple-traj.gro");
+    runTest(CommandLine(cmdline));
+}
+
+// The reference data should be identical to ComputesDistancesOverTrajectory,
+// except for the command line.
+TEST_F(DistanceModuleTest, ComputesDistancesOverTrajectoryInParallel)
+{
+    const char *const cmdline[] = {
+        "distance",
+        "-select", "atomname S1 S2 and res_cog x < 2.8",
+        "-len", "2", "-binw", "0.5", "-nt", "3"
+    };
+    setTopology("simple.gro");
+    setTrajectory("simple-traj.gro");
+    runTest(CommandLine(cmdline));
+}
+
 } // namespace
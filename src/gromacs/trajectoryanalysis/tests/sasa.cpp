@@ -160,4 +160,44 @@ TEST_F(SasaModuleTest, HandlesDynamicCalculationGroup)
     runTest(CommandLine(cmdline));
 }
 
+TEST_F(SasaModuleTest, HandlesDynamicOutputGroupOverTrajectory)
+{
+    const char *const cmdline[] = {
+        "sasa",
+        "-surface", "all",
+        "-output", "y > 1.5"
+    };
+    setTopology("lysozyme.gro");
+    setTrajectory("lysozyme-traj.gro");
+    setOutputFileNoTest("-o", "xvg");
+    setOutputFileNoTest("-or", "xvg");
+    setOutputFileNoTest("-oa", "xvg");
+    setOutputFileNoTest("-tv", "xvg");
+    excludeDataset("dgsolv");
+    setDatasetTolerance("area", gmx::test::ulpTolerance(8));
+    setDatasetTolerance("volume", gmx::test::ulpTolerance(8));
+    runTest(CommandLine(cmdline));
+}
+
+// The reference data should be identical to
+// HandlesDynamicOutputGroupOverTrajectory, except for the command line.
+TEST_F(SasaModuleTest, HandlesDynamicOutputGroupOverTrajectoryInParallel)
+{
+    const char *const cmdline[] = {
+        "sasa",
+        "-surface", "all",
+        "-output", "y > 1.5", "-nt", "3"
+    };
+    setTopology("lysozyme.gro");
+    setTrajectory("lysozyme-traj.gro");
+    setOutputFileNoTest("-o", "xvg");
+    setOutputFileNoTest("-or", "xvg");
+    setOutputFileNoTest("-oa", "xvg");
+    setOutputFileNoTest("-tv", "xvg");
+    excludeDataset("dgsolv");
+    setDatasetTolerance("area", gmx::test::ulpTolerance(8));
+    setDatasetTolerance("volume", gmx::test::ulpTolerance(8));
+    runTest(CommandLine(cmdline));
+}
+
 } // namespace
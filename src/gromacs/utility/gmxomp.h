@@ -62,7 +62,7 @@
  */
 #if (defined GMX_SIMD_X86_SSE2) || (defined GMX_SIMD_X86_SSE4_1) || \
     (defined GMX_SIMD_X86_AVX_128_FMA) || (defined GMX_SIMD_X86_AVX_256) || \
-    (defined GMX_SIMD_X86_AVX2_256)
+    (defined GMX_SIMD_X86_AVX2_256) || (defined GMX_SIMD_X86_AVX_512)
 #    include <xmmintrin.h>
 #endif
 #else
@@ -152,7 +152,7 @@ static gmx_inline void gmx_pause()
      */
 #if (defined GMX_SIMD_X86_SSE2) || (defined GMX_SIMD_X86_SSE4_1) || \
     (defined GMX_SIMD_X86_AVX_128_FMA) || (defined GMX_SIMD_X86_AVX_256) || \
-    (defined GMX_SIMD_X86_AVX2_256)
+    (defined GMX_SIMD_X86_AVX2_256) || (defined GMX_SIMD_X86_AVX_512)
     /* Replace with tbb::internal::atomic_backoff when/if we use TBB */
     _mm_pause();
 #elif defined __MIC__
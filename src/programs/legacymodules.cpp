@@ -55,6 +55,7 @@
 #include "gromacs/tools/check.h"
 #include "gromacs/tools/convert_tpr.h"
 #include "gromacs/tools/dump.h"
+#include "gromacs/tools/xtcindex.h"
 
 #include "mdrun/mdrun_main.h"
 #include "view/view.h"
@@ -147,6 +148,8 @@ void registerLegacyModules(gmx::CommandLineModuleManager *manager)
                    "Check and compare files");
     registerModule(manager, &gmx_dump, "dump",
                    "Make binary files human readable");
+    registerModule(manager, &gmx_xtcindex, "xtcindex",
+                   "Build a frame index for fast seeking in xtc files");
     registerModule(manager, &gmx_grompp, "grompp",
                    "Make a run input file");
     registerModule(manager, &gmx_pdb2gmx, "pdb2gmx",
@@ -394,6 +397,7 @@ void registerLegacyModules(gmx::CommandLineModuleManager *manager)
         group.addModule("wham");
         group.addModule("check");
         group.addModule("dump");
+        group.addModule("xtcindex");
         group.addModule("make_ndx");
         group.addModule("mk_angndx");
         group.addModule("trjorder");
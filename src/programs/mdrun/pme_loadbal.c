@@ -97,6 +97,7 @@ struct pme_load_balancing {
     int          nstcalclr_start;    /* Initial electrostatics cutoff */
     real         rbuf_coulomb;       /* the pairlist buffer size */
     real         rbuf_vdw;           /* the pairlist buffer size */
+    real         rbuf_inner;         /* the inner pairlist buffer size with dynamic pruning */
     matrix       box_start;          /* the initial simulation box */
     int          n;                  /* the count of setup as well as the allocation size */
     pme_setup_t *setup;              /* the PME+cutoff setups */
@@ -130,6 +131,7 @@ void pme_loadbal_init(pme_load_balancing_t *pme_lb_p,
     {
         pme_lb->rbuf_coulomb = ic->rlist - ic->rcoulomb;
         pme_lb->rbuf_vdw     = pme_lb->rbuf_coulomb;
+        pme_lb->rbuf_inner   = ic->rlist_inner - ic->rcoulomb;
     }
     else
     {
@@ -667,6 +669,15 @@ gmx_bool pme_load_balance(pme_load_balancing_t pme_lb,
     ic->rcoulomb     = set->rcut_coulomb;
     ic->rlist        = set->rlist;
     ic->rlistlong    = set->rlistlong;
+    if (pme_lb->cutoff_scheme == ecutsVERLET)
+    {
+        /* Keep the inner buffer for dynamic pruning, equal to rlist without */
+        ic->rlist_inner = min(set->rcut_coulomb + pme_lb->rbuf_inner, set->rlist);
+    }
+    else
+    {
+        ic->rlist_inner = set->rlist;
+    }
     ir->nstcalclr    = set->nstcalclr;
     ic->ewaldcoeff_q = set->ewaldcoeff_q;
     /* TODO: centralize the code that sets the potentials shifts */